@@ -1,4 +1,6 @@
+#include <mutex>
 #include "BasicBlock.h"
+#include "BlockCache.h"
 #include "MemStream.h"
 #include "offsetof_def.h"
 #include "MipsJitter.h"
@@ -57,6 +59,8 @@ CBasicBlock::CBasicBlock(CMIPS& context, uint32 begin, uint32 end)
 #endif
 		m_linkTargetAddress[i] = MIPS_INVALID_PC;
 		m_linkBlockTrampolineOffset[i] = INVALID_LINK_SLOT;
+		m_outgoingLinks[i].source = this;
+		m_outgoingLinks[i].slot = static_cast<LINK_SLOT>(i);
 	}
 }
 
@@ -79,6 +83,11 @@ void CBasicBlock::Compile()
 
 	Framework::CMemStream stream;
 	{
+		//Blocks can be compiled from the background compile thread, instruction
+		//factories and the jitter keep state while compiling and can't be shared.
+		static std::mutex compileMutex;
+		std::lock_guard<std::mutex> compileLock(compileMutex);
+
 		static
 #ifdef AOT_BUILD_CACHE
 		    __declspec(thread)
@@ -190,6 +199,54 @@ void CBasicBlock::Compile()
 #endif
 }
 
+bool CBasicBlock::CompileFromCache(CBlockCache& cache, const AOT_BLOCK_KEY& key)
+{
+#ifndef AOT_ENABLED
+	assert(!IsCompiled());
+	auto entry = cache.FindEntry(key);
+	if(!entry) return false;
+
+	auto code = entry->code;
+	for(const auto& relocation : entry->relocations)
+	{
+		auto symbol = CBlockCache::ResolveSymbolId(relocation.symbol);
+		*reinterpret_cast<uintptr_t*>(code.data() + relocation.offset) = symbol;
+		HandleExternalFunctionReference(symbol, relocation.offset, Jitter::CCodeGen::SYMBOL_REF_TYPE::NATIVE_POINTER);
+	}
+
+	m_function = CMemoryFunction(code.data(), code.size());
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CBasicBlock::StoreToCache(CBlockCache& cache, const AOT_BLOCK_KEY& key) const
+{
+#ifndef AOT_ENABLED
+	assert(IsCompiled());
+	if(!m_relocatable)
+	{
+		cache.RejectEntry();
+		return;
+	}
+
+	auto code = reinterpret_cast<const uint8*>(m_function.GetCode());
+
+	CBlockCache::ENTRY entry;
+	entry.code = std::vector<uint8>(code, code + m_function.GetSize());
+	entry.relocations.reserve(m_symbolReferences.size());
+	for(const auto& symbolReference : m_symbolReferences)
+	{
+		//Clear pointer in stored code, it might have been patched by block linking
+		*reinterpret_cast<uintptr_t*>(entry.code.data() + symbolReference.offset) = 0;
+		entry.relocations.push_back({symbolReference.offset, CBlockCache::MakeSymbolId(symbolReference.symbol)});
+	}
+
+	cache.InsertEntry(key, std::move(entry));
+#endif
+}
+
 void CBasicBlock::CompileRange(CMipsJitter* jitter)
 {
 	if(IsEmpty())
@@ -199,6 +256,8 @@ void CBasicBlock::CompileRange(CMipsJitter* jitter)
 	}
 
 	CompileProlog(jitter);
+	CompileEntryValidation(jitter);
+	CompileExecutionCounter(jitter);
 
 	for(uint32 address = m_begin; address <= m_end; address += 4)
 	{
@@ -232,6 +291,58 @@ void CBasicBlock::CompileProlog(CMipsJitter* jitter)
 #endif
 }
 
+void CBasicBlock::CompileEntryValidation(CMipsJitter* jitter)
+{
+	if(!m_entryValidationEnabled) return;
+
+	jitter->PushCtx();
+	jitter->PushCst(m_begin);
+	jitter->Call(reinterpret_cast<void*>(&BlockValidationHandler), 2, Jitter::CJitter::RETURN_VALUE_32);
+
+	//Code changed and block was thrown away, let the executor handle the new code
+	jitter->PushCst(0);
+	jitter->BeginIf(Jitter::CONDITION_EQ);
+	{
+		jitter->JumpTo(reinterpret_cast<void*>(&EmptyBlockHandler));
+	}
+	jitter->EndIf();
+}
+
+void CBasicBlock::CompileExecutionCounter(CMipsJitter* jitter)
+{
+	if(!m_context.m_blockExecutionCounters) return;
+
+	uint32 counterOffset = GetExecutionCounterIndex(m_begin) * sizeof(uint32);
+
+	//Increment counter
+	jitter->PushRelRef(offsetof(CMIPS, m_blockExecutionCounters));
+	jitter->PushCst(counterOffset);
+	jitter->AddRef();
+
+	jitter->PushRelRef(offsetof(CMIPS, m_blockExecutionCounters));
+	jitter->PushCst(counterOffset);
+	jitter->AddRef();
+	jitter->LoadFromRef();
+	jitter->PushCst(1);
+	jitter->Add();
+
+	jitter->StoreAtRef();
+
+	//Let the executor know when the block becomes hot
+	jitter->PushRelRef(offsetof(CMIPS, m_blockExecutionCounters));
+	jitter->PushCst(counterOffset);
+	jitter->AddRef();
+	jitter->LoadFromRef();
+	jitter->PushCst(HOT_EXECUTION_COUNT);
+	jitter->BeginIf(Jitter::CONDITION_EQ);
+	{
+		jitter->PushCtx();
+		jitter->PushCst(m_begin);
+		jitter->Call(reinterpret_cast<void*>(&HotBlockHandler), 2, Jitter::CJitter::RETURN_VALUE_NONE);
+	}
+	jitter->EndIf();
+}
+
 void CBasicBlock::CompileEpilog(CMipsJitter* jitter)
 {
 	//Update cycle quota
@@ -341,6 +452,17 @@ void CBasicBlock::SetRecycleCount(uint32 recycleCount)
 	m_recycleCount = recycleCount;
 }
 
+bool CBasicBlock::IsEntryValidationEnabled() const
+{
+	return m_entryValidationEnabled;
+}
+
+void CBasicBlock::SetEntryValidationEnabled(bool entryValidationEnabled)
+{
+	assert(!IsCompiled());
+	m_entryValidationEnabled = entryValidationEnabled;
+}
+
 uint32 CBasicBlock::GetLinkTargetAddress(LINK_SLOT linkSlot)
 {
 	assert(linkSlot < LINK_SLOT_MAX);
@@ -353,6 +475,22 @@ void CBasicBlock::SetLinkTargetAddress(LINK_SLOT linkSlot, uint32 address)
 	m_linkTargetAddress[linkSlot] = address;
 }
 
+CBasicBlock::LINK& CBasicBlock::GetOutgoingLink(LINK_SLOT linkSlot)
+{
+	assert(linkSlot < LINK_SLOT_MAX);
+	return m_outgoingLinks[linkSlot];
+}
+
+CBasicBlock::LINK_LIST& CBasicBlock::GetIncomingLinks()
+{
+	return m_incomingLinks;
+}
+
+uint32 CBasicBlock::GetExecutionCounterIndex(uint32 address)
+{
+	return (address / 4) & (EXECUTION_COUNTER_COUNT - 1);
+}
+
 void CBasicBlock::LinkBlock(LINK_SLOT linkSlot, CBasicBlock* otherBlock)
 {
 #ifndef AOT_ENABLED
@@ -392,6 +530,15 @@ void CBasicBlock::UnlinkBlock(LINK_SLOT linkSlot)
 
 void CBasicBlock::HandleExternalFunctionReference(uintptr_t symbol, uint32 offset, Jitter::CCodeGen::SYMBOL_REF_TYPE refType)
 {
+	if(refType == Jitter::CCodeGen::SYMBOL_REF_TYPE::NATIVE_POINTER)
+	{
+		m_symbolReferences.push_back({symbol, offset});
+	}
+	else
+	{
+		//We don't know how to relocate this, block can't be cached
+		m_relocatable = false;
+	}
 	if(symbol == reinterpret_cast<uintptr_t>(&NextBlockTrampoline))
 	{
 		assert(refType == Jitter::CCodeGen::SYMBOL_REF_TYPE::NATIVE_POINTER);
@@ -434,3 +581,13 @@ void EmptyBlockHandler(CMIPS* context)
 void NextBlockTrampoline(CMIPS* context)
 {
 }
+
+void HotBlockHandler(CMIPS* context, uint32 address)
+{
+	context->m_hotBlockHandler(context, address);
+}
+
+uint32 BlockValidationHandler(CMIPS* context, uint32 address)
+{
+	return context->m_blockValidationHandler(context, address) ? 1 : 0;
+}
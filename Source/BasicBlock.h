@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vector>
 #include "MIPS.h"
 #include "MemoryFunction.h"
 #ifdef AOT_BUILD_CACHE
@@ -40,10 +41,14 @@ namespace Jitter
 	class CJitter;
 };
 
+class CBlockCache;
+
 extern "C"
 {
 	void EmptyBlockHandler(CMIPS*);
 	void NextBlockTrampoline(CMIPS*);
+	void HotBlockHandler(CMIPS*, uint32);
+	uint32 BlockValidationHandler(CMIPS*, uint32);
 }
 
 class CBasicBlock
@@ -56,10 +61,36 @@ public:
 		LINK_SLOT_MAX,
 	};
 
+	struct LINK_LIST;
+
+	//Outgoing link of a block, also a node of the list of links that refer to the same address
+	struct LINK
+	{
+		CBasicBlock* source = nullptr;
+		LINK_SLOT slot = LINK_SLOT_NEXT;
+		LINK_LIST* list = nullptr;
+		LINK* prev = nullptr;
+		LINK* next = nullptr;
+	};
+
+	struct LINK_LIST
+	{
+		LINK* first = nullptr;
+	};
+
+	enum
+	{
+		//Execution counters are shared by blocks whose addresses hash to the same index
+		EXECUTION_COUNTER_COUNT = 0x10000,
+		HOT_EXECUTION_COUNT = 0x1000,
+	};
+
 	CBasicBlock(CMIPS&, uint32 = MIPS_INVALID_PC, uint32 = MIPS_INVALID_PC);
 	virtual ~CBasicBlock() = default;
 	void Execute();
 	void Compile();
+	bool CompileFromCache(CBlockCache&, const AOT_BLOCK_KEY&);
+	void StoreToCache(CBlockCache&, const AOT_BLOCK_KEY&) const;
 	virtual void CompileRange(CMipsJitter*);
 
 	uint32 GetBeginAddress() const;
@@ -70,11 +101,20 @@ public:
 	uint32 GetRecycleCount() const;
 	void SetRecycleCount(uint32);
 
+	//Blocks with entry validation ask the executor if their code is still valid before running
+	bool IsEntryValidationEnabled() const;
+	void SetEntryValidationEnabled(bool);
+
 	uint32 GetLinkTargetAddress(LINK_SLOT);
 	void SetLinkTargetAddress(LINK_SLOT, uint32);
 	void LinkBlock(LINK_SLOT, CBasicBlock*);
 	void UnlinkBlock(LINK_SLOT);
 
+	LINK& GetOutgoingLink(LINK_SLOT);
+	LINK_LIST& GetIncomingLinks();
+
+	static uint32 GetExecutionCounterIndex(uint32);
+
 #ifdef AOT_BUILD_CACHE
 	static void SetAotBlockOutputStream(Framework::CStdStream*);
 #endif
@@ -86,8 +126,16 @@ protected:
 
 	void CompileProlog(CMipsJitter*);
 	void CompileEpilog(CMipsJitter*);
+	void CompileExecutionCounter(CMipsJitter*);
+	void CompileEntryValidation(CMipsJitter*);
 
 private:
+	struct SYMBOL_REFERENCE
+	{
+		uintptr_t symbol;
+		uint32 offset;
+	};
+
 	void HandleExternalFunctionReference(uintptr_t, uint32, Jitter::CCodeGen::SYMBOL_REF_TYPE);
 
 #ifdef DEBUGGER_INCLUDED
@@ -107,8 +155,13 @@ private:
 	void (*m_function)(void*);
 #endif
 	uint32 m_recycleCount = 0;
+	bool m_entryValidationEnabled = false;
 	uint32 m_linkTargetAddress[LINK_SLOT_MAX];
 	uint32 m_linkBlockTrampolineOffset[LINK_SLOT_MAX];
+	LINK m_outgoingLinks[LINK_SLOT_MAX];
+	LINK_LIST m_incomingLinks;
+	std::vector<SYMBOL_REFERENCE> m_symbolReferences;
+	bool m_relocatable = true;
 #ifdef _DEBUG
 	CBasicBlock* m_linkBlock[LINK_SLOT_MAX];
 #endif
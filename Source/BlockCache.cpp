@@ -0,0 +1,187 @@
+#include <cstring>
+#include <zlib.h>
+#include "BlockCache.h"
+#include "MemoryUtils.h"
+#include "StdStreamUtils.h"
+#include "Jitter_CodeGenFactory.h"
+#include "Log.h"
+
+#define LOG_NAME ("blockcache")
+
+#ifdef PLAY_VERSION
+#define BLOCKCACHE_BUILD_ID PLAY_VERSION
+#else
+#define BLOCKCACHE_BUILD_ID "unknown"
+#endif
+
+#define BLOCKCACHE_MAGIC (0x4342504A) //'JPBC'
+
+CBlockCache::CBlockCache(const fs::path& path)
+    : m_path(path)
+{
+	Load();
+}
+
+const CBlockCache::ENTRY* CBlockCache::FindEntry(const AOT_BLOCK_KEY& key)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto entryIterator = m_entries.find(key);
+	if(entryIterator == std::end(m_entries))
+	{
+		m_stats.misses++;
+		return nullptr;
+	}
+	m_stats.hits++;
+	return &entryIterator->second;
+}
+
+bool CBlockCache::HasEntry(const AOT_BLOCK_KEY& key) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_entries.find(key) != std::end(m_entries);
+}
+
+void CBlockCache::InsertEntry(const AOT_BLOCK_KEY& key, ENTRY entry)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_entries[key] = std::move(entry);
+	m_stats.stores++;
+	m_dirty = true;
+}
+
+void CBlockCache::RejectEntry()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.rejects++;
+}
+
+CBlockCache::STATS CBlockCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto result = m_stats;
+	result.entryCount = static_cast<uint32>(m_entries.size());
+	return result;
+}
+
+int64 CBlockCache::MakeSymbolId(uintptr_t symbol)
+{
+	//Symbols are stored relative to a function that lives in the same image as the
+	//functions called by generated code. This keeps them valid when the image is relocated.
+	auto anchor = reinterpret_cast<uintptr_t>(&EmptyBlockHandler);
+	return static_cast<int64>(symbol) - static_cast<int64>(anchor);
+}
+
+uintptr_t CBlockCache::ResolveSymbolId(int64 symbolId)
+{
+	auto anchor = reinterpret_cast<uintptr_t>(&EmptyBlockHandler);
+	return static_cast<uintptr_t>(static_cast<int64>(anchor) + symbolId);
+}
+
+uint32 CBlockCache::ComputeFingerprint()
+{
+	//If any of these moved relative to each other, the binary (or the code generator)
+	//was rebuilt and cached code can't be trusted anymore.
+	int64 values[] =
+	    {
+	        CACHE_VERSION,
+	        sizeof(void*),
+	        MakeSymbolId(reinterpret_cast<uintptr_t>(&NextBlockTrampoline)),
+	        MakeSymbolId(reinterpret_cast<uintptr_t>(&MemoryUtils_GetWordProxy)),
+	        MakeSymbolId(reinterpret_cast<uintptr_t>(&MemoryUtils_SetWordProxy)),
+	        MakeSymbolId(reinterpret_cast<uintptr_t>(&Jitter::CreateCodeGen)),
+	    };
+	uint32 result = crc32(0, reinterpret_cast<const Bytef*>(values), sizeof(values));
+	result = crc32(result, reinterpret_cast<const Bytef*>(BLOCKCACHE_BUILD_ID), strlen(BLOCKCACHE_BUILD_ID));
+	return result;
+}
+
+void CBlockCache::Load()
+{
+	if(!fs::exists(m_path)) return;
+
+	try
+	{
+		auto stream = Framework::CreateInputStdStream(m_path.native());
+		uint32 magic = stream.Read32();
+		uint32 fingerprint = stream.Read32();
+		if((magic != BLOCKCACHE_MAGIC) || (fingerprint != ComputeFingerprint()))
+		{
+			CLog::GetInstance().Print(LOG_NAME, "Discarding stale block cache '%s'.\r\n", m_path.string().c_str());
+			m_dirty = true;
+			return;
+		}
+		uint32 entryCount = stream.Read32();
+		for(uint32 i = 0; i < entryCount; i++)
+		{
+			AOT_BLOCK_KEY key = {};
+			key.crc = stream.Read32();
+			key.begin = stream.Read32();
+			key.end = stream.Read32();
+			uint32 codeSize = stream.Read32();
+			uint32 relocationCount = stream.Read32();
+			ENTRY entry;
+			entry.code.resize(codeSize);
+			stream.Read(entry.code.data(), codeSize);
+			entry.relocations.resize(relocationCount);
+			for(auto& relocation : entry.relocations)
+			{
+				relocation.offset = stream.Read32();
+				relocation.symbol = static_cast<int64>(stream.Read64());
+				if((relocation.offset + sizeof(uintptr_t)) > codeSize)
+				{
+					throw std::runtime_error("Invalid relocation.");
+				}
+			}
+			if(stream.IsEOF())
+			{
+				throw std::runtime_error("Unexpected end of file.");
+			}
+			m_entries.emplace(key, std::move(entry));
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to load block cache '%s': %s\r\n", m_path.string().c_str(), exception.what());
+		m_entries.clear();
+		m_dirty = true;
+	}
+}
+
+void CBlockCache::Save()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	CLog::GetInstance().Print(LOG_NAME, "'%s': %d entries, %d hits, %d misses, %d stores, %d rejects.\r\n",
+	                          m_path.string().c_str(), static_cast<uint32>(m_entries.size()), m_stats.hits, m_stats.misses, m_stats.stores, m_stats.rejects);
+
+	if(!m_dirty) return;
+
+	try
+	{
+		auto stream = Framework::CreateOutputStdStream(m_path.native());
+		stream.Write32(BLOCKCACHE_MAGIC);
+		stream.Write32(ComputeFingerprint());
+		stream.Write32(static_cast<uint32>(m_entries.size()));
+		for(const auto& entryPair : m_entries)
+		{
+			const auto& key = entryPair.first;
+			const auto& entry = entryPair.second;
+			stream.Write32(key.crc);
+			stream.Write32(key.begin);
+			stream.Write32(key.end);
+			stream.Write32(static_cast<uint32>(entry.code.size()));
+			stream.Write32(static_cast<uint32>(entry.relocations.size()));
+			stream.Write(entry.code.data(), entry.code.size());
+			for(const auto& relocation : entry.relocations)
+			{
+				stream.Write32(relocation.offset);
+				stream.Write64(static_cast<uint64>(relocation.symbol));
+			}
+		}
+		m_dirty = false;
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to save block cache '%s': %s\r\n", m_path.string().c_str(), exception.what());
+	}
+}
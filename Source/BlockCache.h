@@ -0,0 +1,70 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include "filesystem_def.h"
+#include "Types.h"
+#include "BasicBlock.h"
+
+//Persistent storage for compiled basic blocks
+//Blocks are keyed by their checksum and address range. Code is stored without any absolute
+//pointers, those are kept in a relocation table and resolved when the block is loaded back.
+class CBlockCache
+{
+public:
+	struct RELOCATION
+	{
+		uint32 offset;
+		int64 symbol;
+	};
+	typedef std::vector<RELOCATION> RelocationArray;
+
+	struct ENTRY
+	{
+		std::vector<uint8> code;
+		RelocationArray relocations;
+	};
+
+	struct STATS
+	{
+		uint32 entryCount = 0;
+		uint32 hits = 0;
+		uint32 misses = 0;
+		uint32 stores = 0;
+		uint32 rejects = 0;
+	};
+
+	CBlockCache(const fs::path&);
+	virtual ~CBlockCache() = default;
+
+	const ENTRY* FindEntry(const AOT_BLOCK_KEY&);
+	bool HasEntry(const AOT_BLOCK_KEY&) const;
+	void InsertEntry(const AOT_BLOCK_KEY&, ENTRY);
+	void RejectEntry();
+
+	void Save();
+
+	STATS GetStats() const;
+
+	static int64 MakeSymbolId(uintptr_t);
+	static uintptr_t ResolveSymbolId(int64);
+
+private:
+	typedef std::map<AOT_BLOCK_KEY, ENTRY> EntryMap;
+
+	enum
+	{
+		//Increment this when the layout of the file or the way blocks are compiled changes
+		CACHE_VERSION = 1,
+	};
+
+	static uint32 ComputeFingerprint();
+	void Load();
+
+	fs::path m_path;
+	EntryMap m_entries;
+	STATS m_stats;
+	bool m_dirty = false;
+	mutable std::mutex m_mutex;
+};
@@ -0,0 +1,89 @@
+#include <cassert>
+#include "BlockCompileQueue.h"
+#include "BasicBlock.h"
+
+CBlockCompileQueue::CBlockCompileQueue()
+{
+	m_workerThread = std::thread([this]() { WorkerThreadProc(); });
+}
+
+CBlockCompileQueue::~CBlockCompileQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_terminating = true;
+	}
+	m_requestCondition.notify_one();
+	m_workerThread.join();
+}
+
+void CBlockCompileQueue::Enqueue(RequestPtr request)
+{
+	assert(request->state == REQUEST_STATE_PENDING);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_requests.push_back(std::move(request));
+		m_stats.enqueued++;
+	}
+	m_requestCondition.notify_one();
+}
+
+void CBlockCompileQueue::Cancel(const RequestPtr& request)
+{
+	//A request that's already being compiled can't be stopped, its result will be ignored
+	auto expected = REQUEST_STATE_PENDING;
+	if(request->state.compare_exchange_strong(expected, REQUEST_STATE_CANCELLED))
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.cancelled++;
+	}
+}
+
+void CBlockCompileQueue::CancelAll()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	for(auto& request : m_requests)
+	{
+		auto expected = REQUEST_STATE_PENDING;
+		if(request->state.compare_exchange_strong(expected, REQUEST_STATE_CANCELLED))
+		{
+			m_stats.cancelled++;
+		}
+	}
+	m_requests.clear();
+}
+
+CBlockCompileQueue::STATS CBlockCompileQueue::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void CBlockCompileQueue::WorkerThreadProc()
+{
+	while(1)
+	{
+		RequestPtr request;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_requestCondition.wait(lock, [this]() { return m_terminating || !m_requests.empty(); });
+			if(m_terminating) break;
+			request = std::move(m_requests.front());
+			m_requests.pop_front();
+		}
+
+		auto expected = REQUEST_STATE_PENDING;
+		if(!request->state.compare_exchange_strong(expected, REQUEST_STATE_COMPILING))
+		{
+			continue;
+		}
+
+		request->block->Compile();
+		request->state = REQUEST_STATE_DONE;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.compiled++;
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Types.h"
+
+class CBasicBlock;
+
+//Compiles basic blocks on a worker thread
+//Requests are owned by the executor, it polls their state and installs blocks once they are done.
+//Guest memory can change while a block is being compiled, the executor must validate the checksum
+//of the block before using it.
+//There is only one worker: CBasicBlock::Compile is serialized (instruction factories of a CPU context
+//keep decoding state while compiling), more workers would only wait on each other.
+class CBlockCompileQueue
+{
+public:
+	enum REQUEST_STATE
+	{
+		REQUEST_STATE_PENDING,
+		REQUEST_STATE_COMPILING,
+		REQUEST_STATE_DONE,
+		REQUEST_STATE_CANCELLED,
+	};
+
+	struct REQUEST
+	{
+		std::shared_ptr<CBasicBlock> block;
+		uint32 checksum = 0;
+		std::atomic<REQUEST_STATE> state = {REQUEST_STATE_PENDING};
+	};
+	typedef std::shared_ptr<REQUEST> RequestPtr;
+
+	struct STATS
+	{
+		uint32 enqueued = 0;
+		uint32 compiled = 0;
+		uint32 cancelled = 0;
+	};
+
+	CBlockCompileQueue();
+	virtual ~CBlockCompileQueue();
+
+	void Enqueue(RequestPtr);
+	void Cancel(const RequestPtr&);
+	void CancelAll();
+
+	STATS GetStats() const;
+
+private:
+	void WorkerThreadProc();
+
+	std::deque<RequestPtr> m_requests;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_requestCondition;
+	STATS m_stats;
+	bool m_terminating = false;
+	std::thread m_workerThread;
+};
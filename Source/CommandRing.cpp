@@ -0,0 +1,174 @@
+#include <cassert>
+#include "CommandRing.h"
+
+CCommandRing::CCommandRing(uint32 size)
+    : m_buffer(new uint8[size])
+    , m_size(size)
+{
+	//Size needs to be a power of 2
+	assert((size & (size - 1)) == 0);
+	assert(size >= (PACKET_HEADER_SIZE * 4));
+}
+
+uint32 CCommandRing::GetMaxPayloadSize() const
+{
+	//Keep packets small enough to let the producer write while the consumer is reading
+	return (m_size / 4) - PACKET_HEADER_SIZE;
+}
+
+uint32 CCommandRing::GetPacketSize(uint32 payloadSize)
+{
+	return PACKET_HEADER_SIZE + ((payloadSize + PACKET_ALIGNMENT - 1) & ~(PACKET_ALIGNMENT - 1));
+}
+
+const void* CCommandRing::GetPayload(const PACKET_HEADER* header)
+{
+	return reinterpret_cast<const uint8*>(header) + PACKET_HEADER_SIZE;
+}
+
+uint32 CCommandRing::GetRequiredSize(uint64 writeIndex, uint32 packetSize) const
+{
+	//Packets are contiguous, the end of the buffer is skipped if it doesn't fit
+	uint32 spaceToEnd = m_size - static_cast<uint32>(writeIndex & (m_size - 1));
+	return (packetSize > spaceToEnd) ? (packetSize + spaceToEnd) : packetSize;
+}
+
+bool CCommandRing::HasSpace(uint32 packetSize) const
+{
+	uint64 writeIndex = m_writeIndex.load();
+	uint64 readIndex = m_readIndex.load();
+	return (m_size - (writeIndex - readIndex)) >= GetRequiredSize(writeIndex, packetSize);
+}
+
+void CCommandRing::WaitForSpaceInternal(uint32 packetSize)
+{
+	if(HasSpace(packetSize)) return;
+
+	std::unique_lock<std::mutex> waitLock(m_waitMutex);
+	m_waitingProducerCount++;
+	m_waitCondition.wait(waitLock, [&]() { return HasSpace(packetSize); });
+	m_waitingProducerCount--;
+}
+
+void CCommandRing::WaitForSpace(uint32 payloadSize)
+{
+	assert(payloadSize <= GetMaxPayloadSize());
+	WaitForSpaceInternal(GetPacketSize(payloadSize));
+}
+
+void* CCommandRing::BeginPacket(uint32 type, uint32 payloadSize)
+{
+	assert(type != PACKET_TYPE_WRAP);
+	assert(payloadSize <= GetMaxPayloadSize());
+	assert(m_pendingPacketSize == 0);
+
+	uint32 packetSize = GetPacketSize(payloadSize);
+	WaitForSpaceInternal(packetSize);
+
+	//Only the producer moves the write index, the space waited for is still available
+	uint64 writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+	uint32 position = static_cast<uint32>(writeIndex & (m_size - 1));
+	uint32 spaceToEnd = m_size - position;
+
+	if(packetSize > spaceToEnd)
+	{
+		auto wrapHeader = reinterpret_cast<PACKET_HEADER*>(m_buffer.get() + position);
+		wrapHeader->type = PACKET_TYPE_WRAP;
+		wrapHeader->size = spaceToEnd - PACKET_HEADER_SIZE;
+		writeIndex += spaceToEnd;
+		position = 0;
+	}
+
+	auto header = reinterpret_cast<PACKET_HEADER*>(m_buffer.get() + position);
+	header->type = type;
+	header->size = payloadSize;
+
+	m_pendingWriteIndex = writeIndex + packetSize;
+	m_pendingPacketSize = packetSize;
+
+	return m_buffer.get() + position + PACKET_HEADER_SIZE;
+}
+
+void CCommandRing::EndPacket()
+{
+	assert(m_pendingPacketSize != 0);
+	m_pendingPacketSize = 0;
+	m_writeIndex.store(m_pendingWriteIndex);
+
+	//Only pay for a wake up if the consumer went to sleep
+	if(m_consumerWaiting)
+	{
+		std::lock_guard<std::mutex> waitLock(m_waitMutex);
+		m_waitCondition.notify_all();
+	}
+}
+
+void CCommandRing::EndPacket(uint32 payloadSize)
+{
+	assert(m_pendingPacketSize != 0);
+	uint32 packetSize = GetPacketSize(payloadSize);
+	assert(packetSize <= m_pendingPacketSize);
+
+	uint64 packetIndex = m_pendingWriteIndex - m_pendingPacketSize;
+	auto header = reinterpret_cast<PACKET_HEADER*>(m_buffer.get() + (packetIndex & (m_size - 1)));
+	header->size = payloadSize;
+	m_pendingWriteIndex = packetIndex + packetSize;
+	m_pendingPacketSize = packetSize;
+
+	EndPacket();
+}
+
+void CCommandRing::CancelPacket()
+{
+	//Nothing was published, the next packet will be written at the same place
+	assert(m_pendingPacketSize != 0);
+	m_pendingPacketSize = 0;
+}
+
+const CCommandRing::PACKET_HEADER* CCommandRing::PeekPacket()
+{
+	while(1)
+	{
+		uint64 readIndex = m_readIndex.load(std::memory_order_relaxed);
+		uint64 writeIndex = m_writeIndex.load(std::memory_order_acquire);
+		if(readIndex == writeIndex) return nullptr;
+
+		uint32 position = static_cast<uint32>(readIndex & (m_size - 1));
+		auto header = reinterpret_cast<const PACKET_HEADER*>(m_buffer.get() + position);
+		if(header->type != PACKET_TYPE_WRAP)
+		{
+			return header;
+		}
+		m_readIndex.store(readIndex + m_size - position, std::memory_order_release);
+	}
+}
+
+void CCommandRing::ReleasePacket()
+{
+	uint64 readIndex = m_readIndex.load(std::memory_order_relaxed);
+	uint32 position = static_cast<uint32>(readIndex & (m_size - 1));
+	auto header = reinterpret_cast<const PACKET_HEADER*>(m_buffer.get() + position);
+	assert(header->type != PACKET_TYPE_WRAP);
+	m_readIndex.store(readIndex + GetPacketSize(header->size));
+
+	if(m_waitingProducerCount != 0)
+	{
+		std::lock_guard<std::mutex> waitLock(m_waitMutex);
+		m_waitCondition.notify_all();
+	}
+}
+
+void CCommandRing::WaitForPackets()
+{
+	auto hasPackets =
+	    [&]() {
+		    return m_readIndex.load(std::memory_order_relaxed) != m_writeIndex.load();
+	    };
+
+	if(hasPackets()) return;
+
+	std::unique_lock<std::mutex> waitLock(m_waitMutex);
+	m_consumerWaiting = true;
+	m_waitCondition.wait(waitLock, hasPackets);
+	m_consumerWaiting = false;
+}
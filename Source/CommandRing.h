@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include "Types.h"
+
+//Single producer, single consumer ring buffer of variable sized packets
+//Packets are written in place by the producer and read in place by the consumer. Indices are
+//only touched with atomic operations, the mutex is only used to sleep when the ring is empty
+//(consumer) or full (producer), in which case the other side wakes it up once.
+class CCommandRing
+{
+public:
+	struct PACKET_HEADER
+	{
+		uint32 type;
+		uint32 size;
+	};
+
+	enum
+	{
+		PACKET_ALIGNMENT = 0x10,
+		PACKET_HEADER_SIZE = 0x10,
+	};
+
+	CCommandRing(uint32);
+	virtual ~CCommandRing() = default;
+
+	uint32 GetMaxPayloadSize() const;
+
+	//Producer side
+	//Waits until a packet of that payload size fits, can be called without holding the lock that
+	//serializes producers to let other producers send packets while waiting for the consumer
+	void WaitForSpace(uint32);
+	void* BeginPacket(uint32, uint32);
+	void EndPacket();
+	//Publishes the pending packet, shrunk to a payload size smaller or equal than the one it was begun with
+	void EndPacket(uint32);
+	void CancelPacket();
+
+	//Consumer side
+	const PACKET_HEADER* PeekPacket();
+	void ReleasePacket();
+	void WaitForPackets();
+
+	static const void* GetPayload(const PACKET_HEADER*);
+
+private:
+	enum : uint32
+	{
+		PACKET_TYPE_WRAP = ~0U,
+	};
+
+	static uint32 GetPacketSize(uint32);
+	uint32 GetRequiredSize(uint64, uint32) const;
+	bool HasSpace(uint32) const;
+	void WaitForSpaceInternal(uint32);
+
+	std::unique_ptr<uint8[]> m_buffer;
+	uint32 m_size = 0;
+
+	//Indices are never wrapped, their position in the buffer is obtained by masking
+	std::atomic<uint64> m_writeIndex = {0};
+	std::atomic<uint64> m_readIndex = {0};
+	uint64 m_pendingWriteIndex = 0;
+	uint32 m_pendingPacketSize = 0;
+
+	std::mutex m_waitMutex;
+	std::condition_variable m_waitCondition;
+	std::atomic<bool> m_consumerWaiting = {false};
+	//Producers can wait for space with and without holding the producer lock at the same time
+	std::atomic<uint32> m_waitingProducerCount = {0};
+};
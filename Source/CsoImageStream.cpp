@@ -8,8 +8,6 @@
 typedef uint32 uint32_le;
 typedef uint64 uint64_le;
 
-static const uint32 CSO_READ_BUFFER_SIZE = 256 * 1024;
-
 struct CsoHeader
 {
 	uint8 magic[4];
@@ -23,8 +21,6 @@ struct CsoHeader
 
 CCsoImageStream::CCsoImageStream(CStream* baseStream)
     : m_baseStream(baseStream)
-    , m_readBuffer(nullptr)
-    , m_zlibBuffer(nullptr)
     , m_index(nullptr)
     , m_position(0)
 {
@@ -35,13 +31,18 @@ CCsoImageStream::CCsoImageStream(CStream* baseStream)
 
 	ReadFileHeader();
 	InitializeBuffers();
+
+	uint32 numFrames = static_cast<uint32>((m_totalSize + m_frameSize - 1) / m_frameSize);
+	m_frameCache = std::make_unique<CFrameCache>(m_frameSize, numFrames,
+	                                             [this](uint32 frame, uint8* dest, std::vector<uint8>& readBuffer) { LoadFrame(frame, dest, readBuffer); });
 }
 
 CCsoImageStream::~CCsoImageStream()
 {
-	delete[] m_readBuffer;
-	delete[] m_zlibBuffer;
+	// Workers might still be decompressing, stop them before anything goes away.
+	m_frameCache.reset();
 	delete[] m_index;
+	delete m_baseStream;
 }
 
 void CCsoImageStream::ReadFileHeader()
@@ -88,18 +89,6 @@ void CCsoImageStream::InitializeBuffers()
 {
 	uint32 numFrames = static_cast<uint32>((m_totalSize + m_frameSize - 1) / m_frameSize);
 
-	// We might read a bit of alignment too, so be prepared.
-	if(m_frameSize + (1 << m_indexShift) < CSO_READ_BUFFER_SIZE)
-	{
-		m_readBuffer = new uint8[CSO_READ_BUFFER_SIZE];
-	}
-	else
-	{
-		m_readBuffer = new uint8[m_frameSize + (1 << m_indexShift)];
-	}
-	m_zlibBuffer = new uint8[m_frameSize + (1 << m_indexShift)];
-	m_zlibBufferFrame = numFrames;
-
 	const uint32 indexSize = numFrames + 1;
 	m_index = new uint32[indexSize];
 	if(m_baseStream->Read(m_index, sizeof(uint32) * indexSize) != sizeof(uint32) * indexSize)
@@ -170,6 +159,15 @@ uint32 CCsoImageStream::ReadFromNextFrame(uint8* dest, uint64 maxBytes)
 	// This is how many bytes we will actually be reading from this frame.
 	const uint32 bytes = static_cast<uint32>(std::min(maxBytes, static_cast<uint64>(m_frameSize - offset)));
 
+	// The cache decompresses the frame if it doesn't have it already (and upcoming ones in the background.)
+	m_frameCache->Read(frame, offset, dest, bytes);
+
+	return bytes;
+}
+
+void CCsoImageStream::LoadFrame(uint32 frame, uint8* dest, std::vector<uint8>& readBuffer)
+{
+	// This is called from the frame cache's workers too, only the index is shared.
 	// Grab the index data for the frame we're about to read.
 	const bool compressed = (m_index[frame + 0] & 0x80000000) == 0;
 	const uint32 index0 = m_index[frame + 0] & 0x7FFFFFFF;
@@ -177,35 +175,30 @@ uint32 CCsoImageStream::ReadFromNextFrame(uint8* dest, uint64 maxBytes)
 
 	// Calculate where the compressed payload is (if compressed.)
 	const uint64 frameRawPos = static_cast<uint64>(index0) << m_indexShift;
-	const uint64 frameRawSize = (index1 - index0) << m_indexShift;
+	const uint64 frameRawSize = static_cast<uint64>(index1 - index0) << m_indexShift;
 
 	if(!compressed)
 	{
-		// Just read directly, easy.
-		if(ReadBaseAt(frameRawPos + offset, dest, bytes) != bytes)
+		// Just read directly, easy. The last frame might be cut short.
+		const uint64 frameBytes = std::min<uint64>(m_frameSize, m_totalSize - (static_cast<uint64>(frame) << m_frameShift));
+		const uint64 readRawBytes = ReadBaseAt(frameRawPos, dest, std::min<uint64>(frameRawSize, m_frameSize));
+		if(readRawBytes < frameBytes)
 		{
 			throw std::runtime_error("Unable to read uncompressed bytes from CSO.");
 		}
+		memset(dest + readRawBytes, 0, static_cast<size_t>(m_frameSize - readRawBytes));
 	}
 	else
 	{
-		// We don't need to decompress if we already did this same frame last time.
-		if(m_zlibBufferFrame != frame)
-		{
-			// This might be less bytes than frameRawSize in case of padding on the last frame.
-			// This is because the index positions must be aligned.
-			const uint64 readRawBytes = ReadBaseAt(frameRawPos, m_readBuffer, frameRawSize);
-			DecompressFrame(frame, readRawBytes);
-		}
-
-		// Now we just copy the offset data from the cache.
-		memcpy(dest, m_zlibBuffer + offset, bytes);
+		// This might be less bytes than frameRawSize in case of padding on the last frame.
+		// This is because the index positions must be aligned.
+		readBuffer.resize(static_cast<size_t>(frameRawSize));
+		const uint64 readRawBytes = ReadBaseAt(frameRawPos, readBuffer.data(), frameRawSize);
+		DecompressFrame(dest, readBuffer.data(), readRawBytes);
 	}
-
-	return bytes;
 }
 
-void CCsoImageStream::DecompressFrame(uint32 frame, uint64 readBufferSize)
+void CCsoImageStream::DecompressFrame(uint8* dest, const uint8* src, uint64 srcSize)
 {
 	z_stream z;
 	z.zalloc = Z_NULL;
@@ -216,9 +209,9 @@ void CCsoImageStream::DecompressFrame(uint32 frame, uint64 readBufferSize)
 		throw std::runtime_error("Unable to initialize zlib for CSO decompression.");
 	}
 
-	z.next_in = m_readBuffer;
-	z.avail_in = static_cast<uint32>(readBufferSize);
-	z.next_out = m_zlibBuffer;
+	z.next_in = const_cast<uint8*>(src);
+	z.avail_in = static_cast<uint32>(srcSize);
+	z.next_out = dest;
 	z.avail_out = m_frameSize;
 
 	int status = inflate(&z, Z_FINISH);
@@ -228,13 +221,11 @@ void CCsoImageStream::DecompressFrame(uint32 frame, uint64 readBufferSize)
 		throw std::runtime_error("Unable to decompress CSO frame using zlib.");
 	}
 	inflateEnd(&z);
-
-	// Our buffer now contains this frame.
-	m_zlibBufferFrame = frame;
 }
 
 uint64 CCsoImageStream::ReadBaseAt(uint64 pos, uint8* dest, uint64 bytes)
 {
+	std::lock_guard<std::mutex> baseStreamLock(m_baseStreamMutex);
 	m_baseStream->Seek(pos, Framework::STREAM_SEEK_SET);
 	return m_baseStream->Read(dest, bytes);
 }
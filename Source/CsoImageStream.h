@@ -1,7 +1,11 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "Types.h"
 #include "Stream.h"
+#include "FrameCache.h"
 
 class CCsoImageStream : public Framework::CStream
 {
@@ -21,16 +25,16 @@ private:
 	uint64 GetTotalSize() const;
 	uint32 ReadFromNextFrame(uint8* dest, uint64 maxBytes);
 	uint64 ReadBaseAt(uint64 pos, uint8* dest, uint64 bytes);
-	void DecompressFrame(uint32 frame, uint64 readBufferSize);
+	void LoadFrame(uint32 frame, uint8* dest, std::vector<uint8>& readBuffer);
+	void DecompressFrame(uint8* dest, const uint8* src, uint64 srcSize);
 
 	Framework::CStream* m_baseStream;
+	std::mutex m_baseStreamMutex;
 	uint32 m_frameSize;
 	uint8 m_frameShift;
 	uint8 m_indexShift;
-	uint8* m_readBuffer;
-	uint8* m_zlibBuffer;
-	uint32 m_zlibBufferFrame;
 	uint32* m_index;
 	uint64 m_totalSize;
 	uint64 m_position;
+	std::unique_ptr<CFrameCache> m_frameCache;
 };
@@ -7,11 +7,15 @@
 #include "IszImageStream.h"
 #include "CsoImageStream.h"
 #include "MdsDiscImage.h"
+#include "SectorCacheStream.h"
 #include "StdStream.h"
 #include "StringUtils.h"
 #ifdef HAS_AMAZON_S3
 #include "s3stream/S3ObjectStream.h"
 #endif
+#ifdef HAS_ZSTD
+#include "ZsiImageStream.h"
+#endif
 #ifdef _WIN32
 #include "VolumeStream.h"
 #else
@@ -66,6 +70,14 @@ DiskUtils::OpticalMediaPtr DiskUtils::CreateOpticalMediaFromPath(const fs::path&
 	{
 		stream = std::make_shared<CCsoImageStream>(CreateImageStream(imagePath));
 	}
+	else if(!stricmp(extension.c_str(), ".zsi"))
+	{
+#ifdef HAS_ZSTD
+		stream = std::make_shared<CZsiImageStream>(CreateImageStream(imagePath));
+#else
+		throw std::runtime_error("ZSI support was disabled during build configuration.");
+#endif
+	}
 	else if(!stricmp(extension.c_str(), ".mds"))
 	{
 		auto imageStream = std::unique_ptr<Framework::CStream>(CreateImageStream(imagePath));
@@ -75,6 +87,7 @@ DiskUtils::OpticalMediaPtr DiskUtils::CreateOpticalMediaFromPath(const fs::path&
 		auto imageDataPath = imagePath;
 		imageDataPath.replace_extension("mdf");
 		auto imageDataStream = std::shared_ptr<Framework::CStream>(CreateImageStream(imageDataPath));
+		imageDataStream = std::make_shared<CSectorCacheStream>(imageDataStream);
 
 		return std::unique_ptr<COpticalMedia>(COpticalMedia::CreateDvd(imageDataStream, discImage.IsDualLayer(), discImage.GetLayerBreak()));
 	}
@@ -104,6 +117,9 @@ DiskUtils::OpticalMediaPtr DiskUtils::CreateOpticalMediaFromPath(const fs::path&
 		stream = std::shared_ptr<Framework::CStream>(CreateImageStream(imagePath));
 	}
 
+	//Every disc image format goes through the sector cache
+	stream = std::make_shared<CSectorCacheStream>(stream);
+
 	return std::unique_ptr<COpticalMedia>(COpticalMedia::CreateAuto(stream));
 }
 
@@ -0,0 +1,121 @@
+#include <cassert>
+#include <algorithm>
+#include "EventScheduler.h"
+
+typedef std::greater<> QueueEntryCompare;
+
+bool CEventScheduler::QUEUE_ENTRY::operator>(const QUEUE_ENTRY& rhs) const
+{
+	//Events due at the same time are dispatched in the order they were scheduled
+	if(time != rhs.time) return time > rhs.time;
+	return static_cast<int32>(order - rhs.order) > 0;
+}
+
+CEventScheduler::EventId CEventScheduler::RegisterEvent(const char* name, const EventHandler& handler)
+{
+	EVENT event;
+	event.name = name;
+	event.handler = handler;
+	m_events.push_back(event);
+	return static_cast<EventId>(m_events.size() - 1);
+}
+
+void CEventScheduler::Reset()
+{
+	for(auto& event : m_events)
+	{
+		event.generation++;
+		event.scheduled = false;
+	}
+	m_queue.clear();
+	m_currentTime = 0;
+	m_nextOrder = 0;
+}
+
+void CEventScheduler::Schedule(EventId eventId, int64 ticks)
+{
+	assert(eventId < m_events.size());
+	auto& event = m_events[eventId];
+	event.generation++;
+	event.scheduled = true;
+
+	QUEUE_ENTRY entry;
+	entry.time = m_currentTime + std::max<int64>(ticks, 0);
+	entry.order = m_nextOrder++;
+	entry.eventId = eventId;
+	entry.generation = event.generation;
+	m_queue.push_back(entry);
+	std::push_heap(m_queue.begin(), m_queue.end(), QueueEntryCompare());
+}
+
+void CEventScheduler::Cancel(EventId eventId)
+{
+	assert(eventId < m_events.size());
+	auto& event = m_events[eventId];
+	event.generation++;
+	event.scheduled = false;
+}
+
+bool CEventScheduler::IsScheduled(EventId eventId) const
+{
+	assert(eventId < m_events.size());
+	return m_events[eventId].scheduled;
+}
+
+uint64 CEventScheduler::GetCurrentTime() const
+{
+	return m_currentTime;
+}
+
+int64 CEventScheduler::GetTicksUntilNextEvent()
+{
+	DiscardStaleEntries();
+	if(m_queue.empty())
+	{
+		return NO_EVENT;
+	}
+	return static_cast<int64>(m_queue.front().time - m_currentTime);
+}
+
+void CEventScheduler::AdvanceTime(int64 ticks)
+{
+	assert(ticks >= 0);
+	m_currentTime += ticks;
+}
+
+void CEventScheduler::ProcessEvents()
+{
+	while(1)
+	{
+		DiscardStaleEntries();
+		if(m_queue.empty()) break;
+
+		auto entry = m_queue.front();
+		if(entry.time > m_currentTime) break;
+		PopEntry();
+
+		auto& event = m_events[entry.eventId];
+		event.scheduled = false;
+		//Handler might schedule the event again
+		event.handler(static_cast<int64>(m_currentTime - entry.time));
+	}
+}
+
+bool CEventScheduler::IsEntryStale(const QUEUE_ENTRY& entry) const
+{
+	return m_events[entry.eventId].generation != entry.generation;
+}
+
+void CEventScheduler::PopEntry()
+{
+	std::pop_heap(m_queue.begin(), m_queue.end(), QueueEntryCompare());
+	m_queue.pop_back();
+}
+
+void CEventScheduler::DiscardStaleEntries()
+{
+	while(!m_queue.empty() && IsEntryStale(m_queue.front()))
+	{
+		PopEntry();
+	}
+}
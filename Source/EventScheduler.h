@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Types.h"
+
+//Keeps timed events on a single clock. Instead of polling every device on fixed time slices,
+//the emulation loop asks for the time left before the next event, runs the CPUs for that long
+//and then dispatches whatever became due.
+class CEventScheduler
+{
+public:
+	typedef uint32 EventId;
+	//Handlers receive the amount of ticks elapsed since the event was due
+	typedef std::function<void(int64)> EventHandler;
+
+	enum : int64
+	{
+		NO_EVENT = INT64_MAX,
+	};
+
+	EventId RegisterEvent(const char*, const EventHandler&);
+
+	void Reset();
+
+	void Schedule(EventId, int64);
+	void Cancel(EventId);
+	bool IsScheduled(EventId) const;
+
+	uint64 GetCurrentTime() const;
+	int64 GetTicksUntilNextEvent();
+
+	void AdvanceTime(int64);
+	void ProcessEvents();
+
+private:
+	struct EVENT
+	{
+		const char* name = nullptr;
+		EventHandler handler;
+		uint32 generation = 0;
+		bool scheduled = false;
+	};
+
+	struct QUEUE_ENTRY
+	{
+		uint64 time;
+		uint32 order;
+		EventId eventId;
+		uint32 generation;
+
+		bool operator>(const QUEUE_ENTRY&) const;
+	};
+
+	bool IsEntryStale(const QUEUE_ENTRY&) const;
+	void PopEntry();
+	void DiscardStaleEntries();
+
+	std::vector<EVENT> m_events;
+	//Min heap, entries left behind by cancelled or rescheduled events are skipped when reached
+	std::vector<QUEUE_ENTRY> m_queue;
+	uint64 m_currentTime = 0;
+	uint32 m_nextOrder = 0;
+};
@@ -0,0 +1,263 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include "FrameCache.h"
+#include "Log.h"
+
+#define LOG_NAME ("framecache")
+
+double CFrameCache::STATS::GetHitRate() const
+{
+	uint64 totalCount = hitCount + missCount;
+	return (totalCount == 0) ? 0 : static_cast<double>(hitCount) / static_cast<double>(totalCount);
+}
+
+CFrameCache::CFrameCache(uint32 frameSize, uint32 frameCount, FrameLoader frameLoader, uint32 cacheSize, uint32 workerCount)
+    : m_frameSize(frameSize)
+    , m_frameCount(frameCount)
+    , m_frameLoader(std::move(frameLoader))
+{
+	if(m_frameSize == 0)
+	{
+		throw std::runtime_error("Invalid frame size.");
+	}
+
+	if(workerCount == 0)
+	{
+		workerCount = std::max<uint32>(std::thread::hardware_concurrency() / 2, 1);
+	}
+	workerCount = std::min<uint32>(workerCount, MAX_WORKER_COUNT);
+	m_prefetchFrameCount = std::max<uint32>(PREFETCH_SIZE / m_frameSize, workerCount);
+
+	//Leave room for the prefetched frames and for every thread loading a frame at the same time
+	uint32 cacheFrameCount = std::max<uint32>(cacheSize / m_frameSize, 1);
+	cacheFrameCount = std::max<uint32>(cacheFrameCount, m_prefetchFrameCount + workerCount + 2);
+	cacheFrameCount = std::min<uint32>(cacheFrameCount, std::max<uint32>(m_frameCount, workerCount + 2));
+
+	m_cacheData.resize(static_cast<size_t>(cacheFrameCount) * m_frameSize);
+	m_slots.resize(cacheFrameCount);
+	for(uint32 i = 0; i < cacheFrameCount; i++)
+	{
+		LinkBack(i);
+	}
+	m_frameMap.reserve(cacheFrameCount);
+
+	for(uint32 i = 0; i < workerCount; i++)
+	{
+		m_workers.emplace_back([this]() { WorkerProc(); });
+	}
+}
+
+CFrameCache::~CFrameCache()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_workersDone = true;
+		m_prefetchCondition.notify_all();
+	}
+	for(auto& worker : m_workers)
+	{
+		worker.join();
+	}
+
+	CLog::GetInstance().Print(LOG_NAME, "%llu hits, %llu misses (%.1f%% hit rate), %llu stalls, %llu frames prefetched.\r\n",
+	                          m_stats.hitCount, m_stats.missCount, m_stats.GetHitRate() * 100.0, m_stats.stallCount,
+	                          m_stats.prefetchCount);
+}
+
+uint32 CFrameCache::GetWorkerCount() const
+{
+	return static_cast<uint32>(m_workers.size());
+}
+
+void CFrameCache::Read(uint32 frame, uint32 offset, uint8* dest, uint32 size)
+{
+	if(frame >= m_frameCount)
+	{
+		throw std::runtime_error("Trying to read past eof.");
+	}
+	assert((offset + size) <= m_frameSize);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	UpdatePrefetch(frame);
+
+	while(1)
+	{
+		auto frameIterator = m_frameMap.find(frame);
+		if(frameIterator == std::end(m_frameMap)) break;
+
+		uint32 slotIndex = frameIterator->second;
+		const auto& slot = m_slots[slotIndex];
+		if(slot.state == SLOT_STATE_READY)
+		{
+			memcpy(dest, GetSlotData(slotIndex) + offset, size);
+			Unlink(slotIndex);
+			LinkFront(slotIndex);
+			m_stats.hitCount++;
+			return;
+		}
+
+		//A worker is loading it, wait for it to be done (or to fail)
+		assert(slot.state == SLOT_STATE_LOADING);
+		m_stats.stallCount++;
+		m_loadCondition.wait(lock, [&]() { return (slot.state != SLOT_STATE_LOADING) || (slot.frame != frame); });
+	}
+
+	uint32 slotIndex = AcquireSlot(frame);
+	lock.unlock();
+
+	try
+	{
+		m_frameLoader(frame, GetSlotData(slotIndex), m_readerScratch);
+	}
+	catch(...)
+	{
+		lock.lock();
+		CompleteSlot(slotIndex, false);
+		throw;
+	}
+
+	lock.lock();
+	CompleteSlot(slotIndex, true);
+	m_stats.missCount++;
+	memcpy(dest, GetSlotData(slotIndex) + offset, size);
+}
+
+CFrameCache::STATS CFrameCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+uint8* CFrameCache::GetSlotData(uint32 slotIndex)
+{
+	return m_cacheData.data() + (static_cast<size_t>(slotIndex) * m_frameSize);
+}
+
+uint32 CFrameCache::AcquireSlot(uint32 frame)
+{
+	//Must be called with m_mutex held
+	//Recycle the least recently used slot, it can't be loading since those are out of the list
+	uint32 slotIndex = m_lruTail;
+	assert(slotIndex != INVALID_SLOT);
+	auto& slot = m_slots[slotIndex];
+	assert(slot.state != SLOT_STATE_LOADING);
+	if(slot.state == SLOT_STATE_READY)
+	{
+		m_frameMap.erase(slot.frame);
+	}
+	slot.frame = frame;
+	slot.state = SLOT_STATE_LOADING;
+	m_frameMap.emplace(frame, slotIndex);
+	Unlink(slotIndex);
+	return slotIndex;
+}
+
+void CFrameCache::CompleteSlot(uint32 slotIndex, bool succeeded)
+{
+	//Must be called with m_mutex held
+	auto& slot = m_slots[slotIndex];
+	assert(slot.state == SLOT_STATE_LOADING);
+	if(succeeded)
+	{
+		slot.state = SLOT_STATE_READY;
+		LinkFront(slotIndex);
+	}
+	else
+	{
+		m_frameMap.erase(slot.frame);
+		slot.state = SLOT_STATE_FREE;
+		LinkBack(slotIndex);
+	}
+	m_loadCondition.notify_all();
+}
+
+void CFrameCache::UpdatePrefetch(uint32 frame)
+{
+	//Must be called with m_mutex held
+	bool sequential = (frame == m_lastFrame) || (frame == (m_lastFrame + 1));
+	m_lastFrame = frame;
+	if(!sequential)
+	{
+		//Whatever was queued won't be needed anytime soon
+		m_prefetchQueue.clear();
+		m_prefetchEnd = frame + 1;
+		return;
+	}
+
+	uint32 prefetchStart = std::max<uint32>(frame + 1, m_prefetchEnd);
+	uint32 prefetchEnd = std::min<uint32>(frame + 1 + m_prefetchFrameCount, m_frameCount);
+	if(prefetchStart >= prefetchEnd) return;
+
+	for(uint32 prefetchFrame = prefetchStart; prefetchFrame < prefetchEnd; prefetchFrame++)
+	{
+		m_prefetchQueue.push_back(prefetchFrame);
+	}
+	m_prefetchEnd = prefetchEnd;
+	m_prefetchCondition.notify_all();
+}
+
+void CFrameCache::Unlink(uint32 slotIndex)
+{
+	auto& slot = m_slots[slotIndex];
+	((slot.prev != INVALID_SLOT) ? m_slots[slot.prev].next : m_lruHead) = slot.next;
+	((slot.next != INVALID_SLOT) ? m_slots[slot.next].prev : m_lruTail) = slot.prev;
+	slot.prev = INVALID_SLOT;
+	slot.next = INVALID_SLOT;
+}
+
+void CFrameCache::LinkFront(uint32 slotIndex)
+{
+	auto& slot = m_slots[slotIndex];
+	slot.prev = INVALID_SLOT;
+	slot.next = m_lruHead;
+	((m_lruHead != INVALID_SLOT) ? m_slots[m_lruHead].prev : m_lruTail) = slotIndex;
+	m_lruHead = slotIndex;
+}
+
+void CFrameCache::LinkBack(uint32 slotIndex)
+{
+	auto& slot = m_slots[slotIndex];
+	slot.prev = m_lruTail;
+	slot.next = INVALID_SLOT;
+	((m_lruTail != INVALID_SLOT) ? m_slots[m_lruTail].next : m_lruHead) = slotIndex;
+	m_lruTail = slotIndex;
+}
+
+void CFrameCache::WorkerProc()
+{
+	std::vector<uint8> scratch;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(1)
+	{
+		m_prefetchCondition.wait(lock, [this]() { return !m_prefetchQueue.empty() || m_workersDone; });
+		if(m_workersDone) break;
+
+		uint32 frame = m_prefetchQueue.front();
+		m_prefetchQueue.pop_front();
+		if(m_frameMap.find(frame) != std::end(m_frameMap)) continue;
+
+		uint32 slotIndex = AcquireSlot(frame);
+		lock.unlock();
+
+		bool succeeded = true;
+		try
+		{
+			m_frameLoader(frame, GetSlotData(slotIndex), scratch);
+		}
+		catch(const std::exception& exception)
+		{
+			//Reader will retry and get the error itself if there's really something wrong
+			CLog::GetInstance().Warn(LOG_NAME, "Failed to prefetch frame 0x%X: %s\r\n", frame, exception.what());
+			succeeded = false;
+		}
+
+		lock.lock();
+		CompleteSlot(slotIndex, succeeded);
+		if(succeeded)
+		{
+			m_stats.prefetchCount++;
+		}
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Types.h"
+
+//Cache of decompressed frames for compressed disc image streams (CSO, ISZ)
+//Recently used frames are kept in a LRU cache. When frames are read sequentially, a pool of
+//worker threads decompresses the frames following the read cursor ahead of time. The frame loader
+//is called from the reader and from the workers, it must serialize its own base stream accesses.
+class CFrameCache
+{
+public:
+	//Loads a frame in the destination buffer, the vector can be used as scratch memory
+	typedef std::function<void(uint32, uint8*, std::vector<uint8>&)> FrameLoader;
+
+	struct STATS
+	{
+		uint64 hitCount = 0;      //Frames found in the cache
+		uint64 missCount = 0;     //Frames loaded by the reader
+		uint64 stallCount = 0;    //Times the reader waited for a worker to finish loading a frame
+		uint64 prefetchCount = 0; //Frames loaded by the workers
+
+		double GetHitRate() const;
+	};
+
+	enum
+	{
+		DEFAULT_CACHE_SIZE = 0x400000,
+		PREFETCH_SIZE = 0x40000,
+		MAX_WORKER_COUNT = 4,
+	};
+
+	//A worker count of 0 picks one from the number of hardware threads
+	CFrameCache(uint32 frameSize, uint32 frameCount, FrameLoader, uint32 cacheSize = DEFAULT_CACHE_SIZE, uint32 workerCount = 0);
+	~CFrameCache();
+
+	CFrameCache(const CFrameCache&) = delete;
+	CFrameCache& operator=(const CFrameCache&) = delete;
+
+	uint32 GetWorkerCount() const;
+
+	//Must not be called by more than one thread at a time
+	void Read(uint32 frame, uint32 offset, uint8* dest, uint32 size);
+	STATS GetStats();
+
+private:
+	enum : uint32
+	{
+		INVALID_SLOT = ~0U,
+	};
+
+	enum SLOT_STATE
+	{
+		SLOT_STATE_FREE,
+		SLOT_STATE_LOADING,
+		SLOT_STATE_READY,
+	};
+
+	struct SLOT
+	{
+		uint32 frame = 0;
+		uint32 prev = INVALID_SLOT;
+		uint32 next = INVALID_SLOT;
+		SLOT_STATE state = SLOT_STATE_FREE;
+	};
+
+	typedef std::unordered_map<uint32, uint32> FrameMap;
+
+	uint8* GetSlotData(uint32);
+	uint32 AcquireSlot(uint32);
+	void CompleteSlot(uint32, bool);
+	void UpdatePrefetch(uint32);
+
+	void Unlink(uint32);
+	void LinkFront(uint32);
+	void LinkBack(uint32);
+
+	void WorkerProc();
+
+	uint32 m_frameSize = 0;
+	uint32 m_frameCount = 0;
+	uint32 m_prefetchFrameCount = 0;
+	FrameLoader m_frameLoader;
+	std::vector<uint8> m_readerScratch;
+
+	//Everything below is protected by m_mutex
+	//Slots being loaded are out of the LRU list and can't be recycled
+	std::mutex m_mutex;
+	std::vector<uint8> m_cacheData;
+	std::vector<SLOT> m_slots;
+	FrameMap m_frameMap;
+	uint32 m_lruHead = INVALID_SLOT;
+	uint32 m_lruTail = INVALID_SLOT;
+	std::condition_variable m_loadCondition;
+	STATS m_stats;
+
+	uint32 m_lastFrame = ~0U;
+	uint32 m_prefetchEnd = 0;
+	std::deque<uint32> m_prefetchQueue;
+	std::condition_variable m_prefetchCondition;
+	std::vector<std::thread> m_workers;
+	bool m_workersDone = false;
+};
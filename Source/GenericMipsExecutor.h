@@ -1,8 +1,15 @@
 #pragma once
 
-#include <list>
+#include <unordered_map>
+#include <vector>
+#include <zlib.h>
 #include "MIPS.h"
 #include "BasicBlock.h"
+#include "BlockCache.h"
+#include "BlockCompileQueue.h"
+#include "MipsInterpreter.h"
+#include "PoolAllocator.h"
+#include "TraceBlock.h"
 
 #include "BlockLookupOneWay.h"
 #include "BlockLookupTwoWay.h"
@@ -17,6 +24,13 @@ static bool RangesOverlap(uint32 x1, uint32 x2, uint32 y1, uint32 y2)
 typedef uint32 (*TranslateFunctionType)(CMIPS*, uint32);
 typedef std::shared_ptr<CBasicBlock> BasicBlockPtr;
 
+//Blocks get created and destroyed a lot when code is invalidated, recycle their memory
+template <typename BlockType, typename... Args>
+static std::shared_ptr<BlockType> AllocateBlock(Args&&... args)
+{
+	return std::allocate_shared<BlockType>(CPoolAllocator<BlockType>(), std::forward<Args>(args)...);
+}
+
 template <typename BlockLookupType, uint32 instructionSize = 4>
 class CGenericMipsExecutor : public CMipsExecutor
 {
@@ -31,6 +45,11 @@ public:
 		RECYCLE_NOLINK_THRESHOLD = 16,
 	};
 
+	enum
+	{
+		MAX_TRACE_SEGMENTS = 8,
+	};
+
 	CGenericMipsExecutor(CMIPS& context, uint32 maxAddress)
 	    : m_emptyBlock(std::make_shared<CBasicBlock>(context, MIPS_INVALID_PC, MIPS_INVALID_PC))
 	    , m_context(context)
@@ -43,6 +62,7 @@ public:
 		context.m_emptyBlockHandler =
 		    [&](CMIPS* context) {
 			    uint32 address = m_context.m_State.nPC & m_addressMask;
+			    if(m_compileQueue && InterpretBlock(address)) return;
 			    PartitionFunction(address);
 			    auto block = FindBlockStartingAt(address);
 			    assert(!block->IsEmpty());
@@ -61,6 +81,10 @@ public:
 #endif
 		while(m_context.m_State.nHasException == 0)
 		{
+			if(!m_hotBlocks.empty())
+			{
+				PromoteHotBlocks();
+			}
 			uint32 address = m_context.m_State.nPC & m_addressMask;
 			auto block = m_blockLookup.FindBlockAt(address);
 			block->Execute();
@@ -84,9 +108,31 @@ public:
 
 	void Reset() override
 	{
+		if(m_compileQueue)
+		{
+			m_compileQueue->CancelAll();
+		}
+		m_compileRequests.clear();
+		m_hotBlocks.clear();
+		if(m_executionCounters)
+		{
+			std::fill(m_executionCounters.get(), m_executionCounters.get() + CBasicBlock::EXECUTION_COUNTER_COUNT, 0);
+		}
 		m_blockLookup.Clear();
+		//Blocks can be kept alive by other structures (ie.: recycling caches), make sure they don't refer to each other anymore
+		for(const auto& blockPair : m_blocks)
+		{
+			auto block = blockPair.first;
+			for(uint32 i = 0; i < CBasicBlock::LINK_SLOT_MAX; i++)
+			{
+				auto& link = block->GetOutgoingLink(static_cast<CBasicBlock::LINK_SLOT>(i));
+				link.list = nullptr;
+				link.prev = nullptr;
+				link.next = nullptr;
+			}
+			block->GetIncomingLinks().first = nullptr;
+		}
 		m_blocks.clear();
-		m_blockLinks.clear();
 		m_pendingBlockLinks.clear();
 	}
 
@@ -96,11 +142,58 @@ public:
 		if(executing)
 		{
 			currentBlock = FindBlockStartingAt(m_context.m_State.nPC);
-			assert(!currentBlock->IsEmpty());
+			//Block won't exist if it's being run by the interpreter
+			assert(!currentBlock->IsEmpty() || m_interpreter);
 		}
 		ClearActiveBlocksInRangeInternal(start, end, currentBlock);
 	}
 
+	void SetBlockCache(BlockCachePtr blockCache) override
+	{
+		m_blockCache = std::move(blockCache);
+	}
+
+	void SetBackgroundCompilationEnabled(bool enabled) override
+	{
+		if(enabled == (m_compileQueue != nullptr)) return;
+		if(enabled)
+		{
+			m_interpreter = std::make_unique<CMipsInterpreter>(m_context);
+			m_compileQueue = std::make_unique<CBlockCompileQueue>();
+		}
+		else
+		{
+			m_compileQueue.reset();
+			m_compileRequests.clear();
+			m_interpreter.reset();
+		}
+	}
+
+	void SetTieredCompilationEnabled(bool enabled) override
+	{
+		if(enabled == (m_executionCounters != nullptr)) return;
+		if(enabled)
+		{
+			m_executionCounters = std::make_unique<uint32[]>(CBasicBlock::EXECUTION_COUNTER_COUNT);
+			m_context.m_blockExecutionCounters = m_executionCounters.get();
+			m_context.m_hotBlockHandler =
+			    [&](CMIPS*, uint32 address) {
+				    m_hotBlocks.push_back(address & m_addressMask);
+			    };
+		}
+		else
+		{
+			m_context.m_blockExecutionCounters = nullptr;
+			m_context.m_hotBlockHandler = nullptr;
+		}
+		//Existing blocks were compiled with (or without) execution counters, get rid of them
+		Reset();
+		if(!enabled)
+		{
+			m_executionCounters.reset();
+		}
+	}
+
 #ifdef DEBUGGER_INCLUDED
 	bool MustBreak() const override
 	{
@@ -119,15 +212,11 @@ public:
 #endif
 
 protected:
-	//Outgoing block link
-	struct BLOCK_LINK
-	{
-		CBasicBlock::LINK_SLOT slot;
-		uint32 address;
-	};
-
-	typedef std::list<BasicBlockPtr> BlockList;
-	typedef std::multimap<uint32, BLOCK_LINK> BlockLinkMap;
+	//Blocks are owned by this map, links between blocks are kept in the blocks themselves
+	typedef std::unordered_map<CBasicBlock*, BasicBlockPtr> BlockMap;
+	//Links that refer to an address where there's no block yet, resolved when a block is created there
+	typedef std::unordered_map<uint32, CBasicBlock::LINK_LIST> PendingBlockLinkMap;
+	typedef std::unordered_map<uint32, CBlockCompileQueue::RequestPtr> CompileRequestMap;
 
 	bool HasBlockAt(uint32 address) const
 	{
@@ -140,73 +229,255 @@ protected:
 		assert(!HasBlockAt(start));
 		auto block = BlockFactory(m_context, start, end);
 		m_blockLookup.AddBlock(block.get());
-		m_blocks.push_back(std::move(block));
+		m_blocks.insert(std::make_pair(block.get(), std::move(block)));
 	}
 
 	virtual BasicBlockPtr BlockFactory(CMIPS& context, uint32 start, uint32 end)
 	{
-		auto result = std::make_shared<CBasicBlock>(context, start, end);
-		result->Compile();
+		if(m_compileQueue)
+		{
+			if(auto compiledBlock = TakeCompiledBlock(start, end, ComputeBlockChecksum(start, end)))
+			{
+				return compiledBlock;
+			}
+		}
+		auto result = AllocateBlock<CBasicBlock>(context, start, end);
+		if(m_blockCache)
+		{
+			CompileBlock(*result, ComputeBlockChecksum(start, end));
+		}
+		else
+		{
+			result->Compile();
+		}
 		return result;
 	}
 
+	uint32 ComputeBlockChecksum(uint32 start, uint32 end) const
+	{
+		uint32 checksum = crc32(0, Z_NULL, 0);
+		for(uint32 address = start; address <= end; address += 4)
+		{
+			uint32 opcode = m_context.m_pMemoryMap->GetInstruction(address);
+			checksum = crc32(checksum, reinterpret_cast<const Bytef*>(&opcode), 4);
+		}
+		return checksum;
+	}
+
+	//Compiles a block, going through the persistent block cache if there's one
+	void CompileBlock(CBasicBlock& block, uint32 checksum)
+	{
+		uint32 begin = block.GetBeginAddress();
+		uint32 end = block.GetEndAddress();
+		if(!CanUseBlockCache() || m_context.HasBreakpointInRange(begin, end))
+		{
+			block.Compile();
+			return;
+		}
+		AOT_BLOCK_KEY key = {checksum, begin, end};
+		if(block.CompileFromCache(*m_blockCache, key))
+		{
+			return;
+		}
+		block.Compile();
+		block.StoreToCache(*m_blockCache, key);
+	}
+
+	//Returns true if a compiled version of the block can be obtained without having to wait for the JIT
+	virtual bool IsBlockAvailable(uint32 start, uint32 end, uint32 checksum) const
+	{
+		return CanUseBlockCache() && m_blockCache->HasEntry(AOT_BLOCK_KEY{checksum, start, end});
+	}
+
+	//Called when a block is removed from the executor, it might get destroyed right after
+	virtual void OnBlockDeleted(CBasicBlock*)
+	{
+	}
+
+	//Generated code refers to execution counters when tiered compilation is enabled,
+	//those blocks are kept out of the persistent cache.
+	bool CanUseBlockCache() const
+	{
+		return m_blockCache && !m_executionCounters;
+	}
+
+	//Runs a block that hasn't been compiled yet in the interpreter and queues it for compilation.
+	//Returns false if the block needs to be created right away.
+	bool InterpretBlock(uint32 startAddress)
+	{
+		uint32 endAddress = 0;
+		uint32 branchAddress = 0;
+		FindBlockBounds(startAddress, endAddress, branchAddress);
+
+		auto requestIterator = m_compileRequests.find(startAddress);
+		if(requestIterator != std::end(m_compileRequests))
+		{
+			const auto& request = requestIterator->second;
+			if(request->block->GetEndAddress() == endAddress)
+			{
+				auto state = request->state.load();
+				if(state == CBlockCompileQueue::REQUEST_STATE_DONE)
+				{
+					//BlockFactory will pick it up
+					return false;
+				}
+				if((state != CBlockCompileQueue::REQUEST_STATE_CANCELLED) && m_interpreter->CanExecuteRange(startAddress, endAddress))
+				{
+					m_interpreter->ExecuteRange(startAddress, endAddress);
+					return true;
+				}
+			}
+			m_compileQueue->Cancel(request);
+			m_compileRequests.erase(requestIterator);
+		}
+
+		if(m_context.HasBreakpointInRange(startAddress, endAddress)) return false;
+		if(!m_interpreter->CanExecuteRange(startAddress, endAddress)) return false;
+
+		uint32 checksum = ComputeBlockChecksum(startAddress, endAddress);
+		if(IsBlockAvailable(startAddress, endAddress, checksum)) return false;
+
+		auto request = std::make_shared<CBlockCompileQueue::REQUEST>();
+		request->block = AllocateBlock<CBasicBlock>(m_context, startAddress, endAddress);
+		request->checksum = checksum;
+		m_compileRequests.insert(std::make_pair(startAddress, request));
+		m_compileQueue->Enqueue(std::move(request));
+
+		m_interpreter->ExecuteRange(startAddress, endAddress);
+		return true;
+	}
+
+	//Returns the block compiled in the background for that range if there's one and it's still valid
+	BasicBlockPtr TakeCompiledBlock(uint32 start, uint32 end, uint32 checksum)
+	{
+		auto requestIterator = m_compileRequests.find(start);
+		if(requestIterator == std::end(m_compileRequests)) return BasicBlockPtr();
+
+		auto request = std::move(requestIterator->second);
+		m_compileRequests.erase(requestIterator);
+
+		if(request->state != CBlockCompileQueue::REQUEST_STATE_DONE)
+		{
+			m_compileQueue->Cancel(request);
+			return BasicBlockPtr();
+		}
+
+		//Code might have been modified since the request was made
+		auto block = std::move(request->block);
+		if((block->GetEndAddress() != end) || (request->checksum != checksum))
+		{
+			return BasicBlockPtr();
+		}
+
+		if(CanUseBlockCache())
+		{
+			block->StoreToCache(*m_blockCache, AOT_BLOCK_KEY{checksum, start, end});
+		}
+		return block;
+	}
+
 	void SetupBlockLinks(uint32 startAddress, uint32 endAddress, uint32 branchAddress)
 	{
 		auto block = m_blockLookup.FindBlockAt(startAddress);
 
 		{
 			uint32 nextBlockAddress = (endAddress + 4) & m_addressMask;
-			block->SetLinkTargetAddress(CBasicBlock::LINK_SLOT_NEXT, nextBlockAddress);
-			auto link = std::make_pair(nextBlockAddress, BLOCK_LINK{CBasicBlock::LINK_SLOT_NEXT, startAddress});
-			auto nextBlock = m_blockLookup.FindBlockAt(nextBlockAddress);
-			if(!nextBlock->IsEmpty())
-			{
-				block->LinkBlock(CBasicBlock::LINK_SLOT_NEXT, nextBlock);
-				m_blockLinks.insert(link);
-			}
-			else
-			{
-				m_pendingBlockLinks.insert(link);
-			}
+			SetupBlockLink(block, CBasicBlock::LINK_SLOT_NEXT, nextBlockAddress);
 		}
 
 		if(branchAddress != 0)
 		{
 			branchAddress &= m_addressMask;
-			block->SetLinkTargetAddress(CBasicBlock::LINK_SLOT_BRANCH, branchAddress);
-			auto link = std::make_pair(branchAddress, BLOCK_LINK{CBasicBlock::LINK_SLOT_BRANCH, startAddress});
-			auto branchBlock = m_blockLookup.FindBlockAt(branchAddress);
-			if(!branchBlock->IsEmpty())
-			{
-				block->LinkBlock(CBasicBlock::LINK_SLOT_BRANCH, branchBlock);
-				m_blockLinks.insert(link);
-			}
-			else
-			{
-				m_pendingBlockLinks.insert(link);
-			}
+			SetupBlockLink(block, CBasicBlock::LINK_SLOT_BRANCH, branchAddress);
 		}
 
 		//Resolve any block links that could be valid now that block has been created
 		{
-			auto lowerBound = m_pendingBlockLinks.lower_bound(startAddress);
-			auto upperBound = m_pendingBlockLinks.upper_bound(startAddress);
-			for(auto blockLinkIterator = lowerBound; blockLinkIterator != upperBound; blockLinkIterator++)
+			auto pendingIterator = m_pendingBlockLinks.find(startAddress);
+			if(pendingIterator != std::end(m_pendingBlockLinks))
 			{
-				const auto& blockLink = blockLinkIterator->second;
-				auto referringBlock = m_blockLookup.FindBlockAt(blockLink.address);
-				if(referringBlock->IsEmpty()) continue;
-				referringBlock->LinkBlock(blockLink.slot, block);
-				m_blockLinks.insert(*blockLinkIterator);
+				for(auto link = pendingIterator->second.first; link; link = link->next)
+				{
+					link->source->LinkBlock(link->slot, block);
+				}
+				MoveLinks(pendingIterator->second, block->GetIncomingLinks());
+				m_pendingBlockLinks.erase(pendingIterator);
 			}
-			m_pendingBlockLinks.erase(lowerBound, upperBound);
 		}
 	}
 
-	virtual void PartitionFunction(uint32 startAddress)
+	void SetupBlockLink(CBasicBlock* block, CBasicBlock::LINK_SLOT slot, uint32 targetAddress)
 	{
-		uint32 endAddress = startAddress + MAX_BLOCK_SIZE;
-		uint32 branchAddress = 0;
+		block->SetLinkTargetAddress(slot, targetAddress);
+		auto& link = block->GetOutgoingLink(slot);
+		auto targetBlock = m_blockLookup.FindBlockAt(targetAddress);
+		if(!targetBlock->IsEmpty())
+		{
+			block->LinkBlock(slot, targetBlock);
+			InsertLink(targetBlock->GetIncomingLinks(), link);
+		}
+		else
+		{
+			InsertLink(m_pendingBlockLinks[targetAddress], link);
+		}
+	}
+
+	static void InsertLink(CBasicBlock::LINK_LIST& list, CBasicBlock::LINK& link)
+	{
+		assert(!link.list);
+		link.list = &list;
+		link.prev = nullptr;
+		link.next = list.first;
+		if(list.first)
+		{
+			list.first->prev = &link;
+		}
+		list.first = &link;
+	}
+
+	static void RemoveLink(CBasicBlock::LINK& link)
+	{
+		assert(link.list);
+		if(link.prev)
+		{
+			link.prev->next = link.next;
+		}
+		else
+		{
+			link.list->first = link.next;
+		}
+		if(link.next)
+		{
+			link.next->prev = link.prev;
+		}
+		link.list = nullptr;
+		link.prev = nullptr;
+		link.next = nullptr;
+	}
+
+	//Appends all links from a list to another one
+	static void MoveLinks(CBasicBlock::LINK_LIST& srcList, CBasicBlock::LINK_LIST& dstList)
+	{
+		if(!srcList.first) return;
+		CBasicBlock::LINK* lastLink = nullptr;
+		for(auto link = srcList.first; link; link = link->next)
+		{
+			link->list = &dstList;
+			lastLink = link;
+		}
+		lastLink->next = dstList.first;
+		if(dstList.first)
+		{
+			dstList.first->prev = lastLink;
+		}
+		dstList.first = srcList.first;
+		srcList.first = nullptr;
+	}
+
+	void FindBlockBounds(uint32 startAddress, uint32& endAddress, uint32& branchAddress) const
+	{
+		endAddress = startAddress + MAX_BLOCK_SIZE;
+		branchAddress = 0;
 		for(uint32 address = startAddress; address < endAddress; address += 4)
 		{
 			uint32 opcode = m_context.m_pMemoryMap->GetInstruction(address);
@@ -225,6 +496,13 @@ protected:
 		}
 		assert((endAddress - startAddress) <= MAX_BLOCK_SIZE);
 		assert(endAddress <= m_maxAddress);
+	}
+
+	virtual void PartitionFunction(uint32 startAddress)
+	{
+		uint32 endAddress = 0;
+		uint32 branchAddress = 0;
+		FindBlockBounds(startAddress, endAddress, branchAddress);
 		CreateBlock(startAddress, endAddress);
 		auto block = FindBlockStartingAt(startAddress);
 		if(block->GetRecycleCount() < RECYCLE_NOLINK_THRESHOLD)
@@ -233,55 +511,168 @@ protected:
 		}
 	}
 
+	uint32 GetExecutionCount(uint32 address) const
+	{
+		return m_executionCounters[CBasicBlock::GetExecutionCounterIndex(address)];
+	}
+
+	//Builds a trace starting at a hot block by following the most executed successors
+	std::shared_ptr<CTraceBlock> BuildTrace(uint32 startAddress)
+	{
+		CTraceBlock::SegmentArray segments;
+		bool isLoop = false;
+		uint32 address = startAddress;
+		while(segments.size() < MAX_TRACE_SEGMENTS)
+		{
+			auto block = m_blockLookup.FindBlockAt(address);
+			if(block->IsEmpty()) break;
+			if(dynamic_cast<CTraceBlock*>(block)) break;
+			if(block->IsEntryValidationEnabled()) break;
+
+			uint32 endAddress = 0;
+			uint32 branchAddress = 0;
+			FindBlockBounds(address, endAddress, branchAddress);
+
+			//Keep the whole trace within a block's maximum size, invalidation relies on this
+			if(endAddress != block->GetEndAddress()) break;
+			if(endAddress >= (startAddress + MAX_BLOCK_SIZE)) break;
+			if(m_context.HasBreakpointInRange(address, endAddress)) break;
+
+			branchAddress &= m_addressMask;
+			segments.push_back(CTraceBlock::SEGMENT{address, endAddress, branchAddress});
+
+			//Target not known statically (ie.: JR), can't go further
+			if(branchAddress == 0) break;
+
+			uint32 fallthroughAddress = (endAddress + 4) & m_addressMask;
+			uint32 nextAddress = (GetExecutionCount(branchAddress) >= GetExecutionCount(fallthroughAddress)) ? branchAddress : fallthroughAddress;
+			if(nextAddress == startAddress)
+			{
+				isLoop = true;
+				break;
+			}
+			if(nextAddress < startAddress) break;
+			bool alreadyInTrace = std::any_of(std::begin(segments), std::end(segments),
+			                                  [&](const CTraceBlock::SEGMENT& segment) { return segment.begin == nextAddress; });
+			if(alreadyInTrace) break;
+			address = nextAddress;
+		}
+
+		//Nothing to gain from a single block that doesn't loop
+		if(segments.empty()) return std::shared_ptr<CTraceBlock>();
+		if(!isLoop && (segments.size() < 2)) return std::shared_ptr<CTraceBlock>();
+
+		return AllocateBlock<CTraceBlock>(m_context, std::move(segments), isLoop);
+	}
+
+	void PromoteHotBlocks()
+	{
+		auto hotBlocks = std::move(m_hotBlocks);
+		m_hotBlocks.clear();
+		for(auto address : hotBlocks)
+		{
+			auto block = m_blockLookup.FindBlockAt(address);
+			if(block->IsEmpty()) continue;
+			if(dynamic_cast<CTraceBlock*>(block)) continue;
+			auto trace = BuildTrace(address);
+			if(!trace)
+			{
+				//Hot block handler only fires when the counter reaches the threshold, restart the count
+				//to try again later on, successors might have become hot by then
+				m_executionCounters[CBasicBlock::GetExecutionCounterIndex(address)] = 0;
+				continue;
+			}
+			trace->Compile();
+			ReplaceBlock(block, std::move(trace));
+		}
+	}
+
+	//Puts a new block in place of an existing one starting at the same address
+	void ReplaceBlock(CBasicBlock* oldBlock, BasicBlockPtr newBlock)
+	{
+		uint32 address = oldBlock->GetBeginAddress();
+		assert(newBlock->GetBeginAddress() == address);
+
+		OrphanBlock(oldBlock);
+		m_blockLookup.DeleteBlock(oldBlock);
+		m_blockLookup.AddBlock(newBlock.get());
+
+		//Redirect blocks that were linked to the old block
+		auto& incomingLinks = oldBlock->GetIncomingLinks();
+		for(auto link = incomingLinks.first; link; link = link->next)
+		{
+			link->source->UnlinkBlock(link->slot);
+			link->source->LinkBlock(link->slot, newBlock.get());
+		}
+		MoveLinks(incomingLinks, newBlock->GetIncomingLinks());
+
+		assert(m_blocks.find(oldBlock) != std::end(m_blocks));
+		OnBlockDeleted(oldBlock);
+		m_blocks.erase(oldBlock);
+		m_blocks.insert(std::make_pair(newBlock.get(), std::move(newBlock)));
+	}
+
 	//Unlink and removes block from all of our bookkeeping structures
 	void OrphanBlock(CBasicBlock* block)
 	{
-		auto orphanBlockLinkSlot =
-		    [&](CBasicBlock::LINK_SLOT linkSlot) {
-			    auto slotSearch =
-			        [&](const std::pair<uint32, BLOCK_LINK>& link) {
-				        return (link.second.address == block->GetBeginAddress()) &&
-				               (link.second.slot == linkSlot);
-			        };
-			    uint32 linkTargetAddress = block->GetLinkTargetAddress(linkSlot);
-			    //Check if block has this specific link slot
-			    if(linkTargetAddress != MIPS_INVALID_PC)
-			    {
-				    //If it has that link slot, it's either linked or pending to be linked
-				    auto slotIterator = std::find_if(m_blockLinks.begin(), m_blockLinks.end(), slotSearch);
-				    if(slotIterator != std::end(m_blockLinks))
-				    {
-					    block->UnlinkBlock(linkSlot);
-					    m_blockLinks.erase(slotIterator);
-				    }
-				    else
-				    {
-					    slotIterator = std::find_if(m_pendingBlockLinks.begin(), m_pendingBlockLinks.end(), slotSearch);
-					    assert(slotIterator != std::end(m_pendingBlockLinks));
-					    m_pendingBlockLinks.erase(slotIterator);
-				    }
-			    }
-			    block->SetLinkTargetAddress(linkSlot, MIPS_INVALID_PC);
-		    };
-		orphanBlockLinkSlot(CBasicBlock::LINK_SLOT_NEXT);
-		orphanBlockLinkSlot(CBasicBlock::LINK_SLOT_BRANCH);
+		for(uint32 i = 0; i < CBasicBlock::LINK_SLOT_MAX; i++)
+		{
+			auto linkSlot = static_cast<CBasicBlock::LINK_SLOT>(i);
+			uint32 linkTargetAddress = block->GetLinkTargetAddress(linkSlot);
+			//Check if block has this specific link slot
+			if(linkTargetAddress != MIPS_INVALID_PC)
+			{
+				//If it has that link slot, it's either linked or pending to be linked
+				auto& link = block->GetOutgoingLink(linkSlot);
+				auto pendingIterator = m_pendingBlockLinks.find(linkTargetAddress);
+				bool pending = (pendingIterator != std::end(m_pendingBlockLinks)) && (link.list == &pendingIterator->second);
+				RemoveLink(link);
+				if(pending)
+				{
+					if(!pendingIterator->second.first)
+					{
+						m_pendingBlockLinks.erase(pendingIterator);
+					}
+				}
+				else
+				{
+					block->UnlinkBlock(linkSlot);
+				}
+			}
+			block->SetLinkTargetAddress(linkSlot, MIPS_INVALID_PC);
+		}
 	}
 
 	void ClearActiveBlocksInRangeInternal(uint32 start, uint32 end, CBasicBlock* protectedBlock)
 	{
+		//Drop background compilation requests for code that's going away
+		for(auto requestIterator = std::begin(m_compileRequests); requestIterator != std::end(m_compileRequests);)
+		{
+			const auto& request = requestIterator->second;
+			if(RangesOverlap(request->block->GetBeginAddress(), request->block->GetEndAddress(), start, end))
+			{
+				m_compileQueue->Cancel(request);
+				requestIterator = m_compileRequests.erase(requestIterator);
+			}
+			else
+			{
+				requestIterator++;
+			}
+		}
+
 		//Widen scan range since blocks starting before the range can end in the range
 		uint32 scanStart = static_cast<uint32>(std::max<int64>(0, static_cast<uint64>(start) - MAX_BLOCK_SIZE));
 		uint32 scanEnd = end;
 		assert(scanEnd > scanStart);
 
-		std::set<CBasicBlock*> clearedBlocks;
+		std::vector<CBasicBlock*> clearedBlocks;
 		for(uint32 address = scanStart; address < scanEnd; address += instructionSize)
 		{
 			auto block = m_blockLookup.FindBlockAt(address);
 			if(block->IsEmpty()) continue;
 			if(block == protectedBlock) continue;
 			if(!RangesOverlap(block->GetBeginAddress(), block->GetEndAddress(), start, end)) continue;
-			clearedBlocks.insert(block);
+			clearedBlocks.push_back(block);
 			m_blockLookup.DeleteBlock(block);
 		}
 
@@ -291,38 +682,42 @@ protected:
 			OrphanBlock(block);
 		}
 
-		//Undo all stale links
+		//Undo all stale links, they will be resolved again when new blocks are created
 		for(auto& block : clearedBlocks)
 		{
-			auto lowerBound = m_blockLinks.lower_bound(block->GetBeginAddress());
-			auto upperBound = m_blockLinks.upper_bound(block->GetBeginAddress());
-			for(auto blockLinkIterator = lowerBound; blockLinkIterator != upperBound; blockLinkIterator++)
+			auto& incomingLinks = block->GetIncomingLinks();
+			if(!incomingLinks.first) continue;
+			for(auto link = incomingLinks.first; link; link = link->next)
 			{
-				const auto& blockLink = blockLinkIterator->second;
-				auto referringBlock = m_blockLookup.FindBlockAt(blockLink.address);
-				if(referringBlock->IsEmpty()) continue;
-				referringBlock->UnlinkBlock(blockLink.slot);
-				m_pendingBlockLinks.insert(*blockLinkIterator);
+				link->source->UnlinkBlock(link->slot);
 			}
-			m_blockLinks.erase(lowerBound, upperBound);
+			MoveLinks(incomingLinks, m_pendingBlockLinks[block->GetBeginAddress()]);
 		}
 
-		if(!clearedBlocks.empty())
+		for(auto& block : clearedBlocks)
 		{
-			m_blocks.remove_if([&](const BasicBlockPtr& block) { return clearedBlocks.find(block.get()) != std::end(clearedBlocks); });
+			OnBlockDeleted(block);
+			m_blocks.erase(block);
 		}
 	}
 
-	BlockList m_blocks;
+	BlockMap m_blocks;
 	BasicBlockPtr m_emptyBlock;
-	BlockLinkMap m_blockLinks;
-	BlockLinkMap m_pendingBlockLinks;
+	BlockCachePtr m_blockCache;
+	PendingBlockLinkMap m_pendingBlockLinks;
 	CMIPS& m_context;
 	uint32 m_maxAddress = 0;
 	uint32 m_addressMask = 0;
 
 	BlockLookupType m_blockLookup;
 
+	std::unique_ptr<uint32[]> m_executionCounters;
+	std::vector<uint32> m_hotBlocks;
+
+	std::unique_ptr<CMipsInterpreter> m_interpreter;
+	CompileRequestMap m_compileRequests;
+	std::unique_ptr<CBlockCompileQueue> m_compileQueue;
+
 #ifdef DEBUGGER_INCLUDED
 	bool m_mustBreak = false;
 	bool m_breakpointsDisabledOnce = false;
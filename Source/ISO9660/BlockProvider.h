@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "Types.h"
 #include "Stream.h"
 
@@ -14,8 +15,22 @@ namespace ISO9660
 			BLOCKSIZE = 0x800ULL
 		};
 
+		//Providers sharing a stream must share its mutex, reads can come from more than one thread
+		typedef std::shared_ptr<std::mutex> StreamMutexPtr;
+
 		virtual ~CBlockProvider() = default;
 		virtual void ReadBlock(uint32, void*) = 0;
+
+		//Reads consecutive blocks
+		virtual void ReadBlocks(uint32 address, uint32 count, void* blocks)
+		{
+			auto block = reinterpret_cast<uint8*>(blocks);
+			for(uint32 i = 0; i < count; i++)
+			{
+				ReadBlock(address + i, block);
+				block += BLOCKSIZE;
+			}
+		}
 	};
 
 	class CBlockProvider2048 : public CBlockProvider
@@ -23,21 +38,31 @@ namespace ISO9660
 	public:
 		typedef std::shared_ptr<Framework::CStream> StreamPtr;
 
-		CBlockProvider2048(const StreamPtr& stream, uint32 offset = 0)
+		CBlockProvider2048(const StreamPtr& stream, uint32 offset = 0, const StreamMutexPtr& streamMutex = std::make_shared<std::mutex>())
 		    : m_stream(stream)
 		    , m_offset(offset)
+		    , m_streamMutex(streamMutex)
 		{
 		}
 
 		void ReadBlock(uint32 address, void* block) override
 		{
+			std::lock_guard<std::mutex> streamLock(*m_streamMutex);
 			m_stream->Seek(static_cast<uint64>(address + m_offset) * BLOCKSIZE, Framework::STREAM_SEEK_SET);
 			m_stream->Read(block, BLOCKSIZE);
 		}
 
+		void ReadBlocks(uint32 address, uint32 count, void* blocks) override
+		{
+			std::lock_guard<std::mutex> streamLock(*m_streamMutex);
+			m_stream->Seek(static_cast<uint64>(address + m_offset) * BLOCKSIZE, Framework::STREAM_SEEK_SET);
+			m_stream->Read(blocks, static_cast<uint64>(count) * BLOCKSIZE);
+		}
+
 	private:
 		StreamPtr m_stream;
 		uint32 m_offset = 0;
+		StreamMutexPtr m_streamMutex;
 	};
 
 	class CBlockProviderCDROMXA : public CBlockProvider
@@ -45,13 +70,15 @@ namespace ISO9660
 	public:
 		typedef std::shared_ptr<Framework::CStream> StreamPtr;
 
-		CBlockProviderCDROMXA(const StreamPtr& stream)
+		CBlockProviderCDROMXA(const StreamPtr& stream, const StreamMutexPtr& streamMutex = std::make_shared<std::mutex>())
 		    : m_stream(stream)
+		    , m_streamMutex(streamMutex)
 		{
 		}
 
 		void ReadBlock(uint32 address, void* block) override
 		{
+			std::lock_guard<std::mutex> streamLock(*m_streamMutex);
 			m_stream->Seek((static_cast<uint64>(address) * INTERNAL_BLOCKSIZE) + BLOCKHEADER_SIZE, Framework::STREAM_SEEK_SET);
 			m_stream->Read(block, BLOCKSIZE);
 		}
@@ -64,5 +91,6 @@ namespace ISO9660
 		};
 
 		StreamPtr m_stream;
+		StreamMutexPtr m_streamMutex;
 	};
 }
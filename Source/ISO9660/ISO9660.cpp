@@ -25,10 +25,18 @@ void CISO9660::ReadBlock(uint32 address, void* data)
 	//are properly called as some system calls (ie.: ReadFile)
 	//won't generate an exception when trying to write to
 	//a write protected area
+	std::lock_guard<std::mutex> bufferLock(m_bufferMutex);
 	m_blockProvider->ReadBlock(address, m_blockBuffer);
 	memcpy(data, m_blockBuffer, CBlockProvider::BLOCKSIZE);
 }
 
+void CISO9660::ReadBlocks(uint32 address, uint32 count, void* data)
+{
+	//Reads straight into the destination, unlike ReadBlock, this must not be used to
+	//read into memory that can be write protected (ie.: guest memory)
+	m_blockProvider->ReadBlocks(address, count, data);
+}
+
 bool CISO9660::GetFileRecord(CDirectoryRecord* record, const char* filename)
 {
 	//Remove the first '/'
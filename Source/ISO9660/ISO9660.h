@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <mutex>
 #include "BlockProvider.h"
 #include "VolumeDescriptor.h"
 #include "PathTable.h"
@@ -15,6 +16,7 @@ public:
 	~CISO9660();
 
 	void ReadBlock(uint32, void*);
+	void ReadBlocks(uint32, uint32, void*);
 
 	Framework::CStream* Open(const char*);
 	bool GetFileRecord(ISO9660::CDirectoryRecord*, const char*);
@@ -26,5 +28,6 @@ private:
 	ISO9660::CVolumeDescriptor m_volumeDescriptor;
 	ISO9660::CPathTable m_pathTable;
 
+	std::mutex m_bufferMutex;
 	uint8 m_blockBuffer[ISO9660::CBlockProvider::BLOCKSIZE];
 };
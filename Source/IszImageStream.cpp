@@ -30,14 +30,14 @@ CIszImageStream::CIszImageStream(CStream* baseStream)
 	}
 
 	ReadBlockDescriptorTable();
-	m_cachedBlock = new uint8[m_header.blockSize];
-	m_readBuffer = new uint8[m_header.blockSize];
+	m_blockCache = std::make_unique<CFrameCache>(m_header.blockSize, m_header.blockNumber,
+	                                             [this](uint32 blockNumber, uint8* dest, std::vector<uint8>& readBuffer) { LoadBlock(blockNumber, dest, readBuffer); });
 }
 
 CIszImageStream::~CIszImageStream()
 {
-	delete[] m_cachedBlock;
-	delete[] m_readBuffer;
+	//Stop the cache's workers before anything they use goes away
+	m_blockCache.reset();
 	delete[] m_blockDescriptorTable;
 	delete m_baseStream;
 }
@@ -73,11 +73,12 @@ uint64 CIszImageStream::Read(void* buffer, uint64 size)
 		{
 			break;
 		}
-		SyncCache();
+		uint64 currentSector = (m_position / m_header.sectorSize);
+		uint64 neededBlock = (currentSector * m_header.sectorSize) / m_header.blockSize;
 		uint64 blockPosition = (m_position % m_header.blockSize);
 		uint64 sizeLeft = m_header.blockSize - blockPosition;
 		uint64 sizeToRead = std::min<uint64>(size, sizeLeft);
-		memcpy(inputBuffer, m_cachedBlock + blockPosition, static_cast<size_t>(sizeToRead));
+		m_blockCache->Read(static_cast<uint32>(neededBlock), static_cast<uint32>(blockPosition), inputBuffer, static_cast<uint32>(sizeToRead));
 		m_position += sizeToRead;
 		size -= sizeToRead;
 		inputBuffer += sizeToRead;
@@ -109,12 +110,20 @@ void CIszImageStream::ReadBlockDescriptorTable()
 	}
 
 	m_blockDescriptorTable = new BLOCKDESCRIPTOR[m_header.blockNumber];
+	m_blockOffsetTable.resize(m_header.blockNumber);
+	uint64 blockOffset = m_header.dataOffset;
 	for(unsigned int i = 0; i < m_header.blockNumber; i++)
 	{
 		uint32 value = *reinterpret_cast<uint32*>(&cryptedTable[i * m_header.blockPtrLength]);
 		value &= 0xFFFFFF;
 		m_blockDescriptorTable[i].size = value & 0x3FFFFF;
 		m_blockDescriptorTable[i].storageType = static_cast<uint8>(value >> 22);
+		m_blockOffsetTable[i] = blockOffset;
+		//Zero blocks aren't stored
+		if(m_blockDescriptorTable[i].storageType != ADI_ZERO)
+		{
+			blockOffset += m_blockDescriptorTable[i].size;
+		}
 	}
 
 	delete[] cryptedTable;
@@ -125,56 +134,38 @@ uint64 CIszImageStream::GetTotalSize() const
 	return static_cast<uint64>(m_header.totalSectors) * static_cast<uint64>(m_header.sectorSize);
 }
 
-const CIszImageStream::BLOCKDESCRIPTOR& CIszImageStream::SeekToBlock(uint64 blockNumber)
+void CIszImageStream::LoadBlock(uint32 blockNumber, uint8* dest, std::vector<uint8>& readBuffer)
 {
+	//Called from the block cache's workers too
 	assert(blockNumber < m_header.blockNumber);
-	uint64 seekPosition = m_header.dataOffset;
-	for(unsigned int i = 0; i < blockNumber; i++)
-	{
-		const BLOCKDESCRIPTOR& blockDescriptor = m_blockDescriptorTable[i];
-		if(blockDescriptor.storageType != ADI_ZERO)
-		{
-			seekPosition += blockDescriptor.size;
-		}
-	}
-	m_baseStream->Seek(seekPosition, Framework::STREAM_SEEK_SET);
-	return m_blockDescriptorTable[blockNumber];
-}
-
-void CIszImageStream::SyncCache()
-{
-	uint64 currentSector = (m_position / m_header.sectorSize);
-	uint64 neededBlock = (currentSector * m_header.sectorSize) / m_header.blockSize;
-	if(neededBlock == m_cachedBlockNumber)
-	{
-		return;
-	}
-	if(neededBlock >= m_header.blockNumber)
-	{
-		throw std::runtime_error("Trying to read past eof.");
-	}
-
-	const BLOCKDESCRIPTOR& blockDescriptor = SeekToBlock(neededBlock);
-	memset(m_cachedBlock, 0, m_header.blockSize);
+	const BLOCKDESCRIPTOR& blockDescriptor = m_blockDescriptorTable[blockNumber];
+	uint64 blockOffset = m_blockOffsetTable[blockNumber];
+	memset(dest, 0, m_header.blockSize);
 	switch(blockDescriptor.storageType)
 	{
 	case ADI_ZERO:
 		ReadZeroBlock(blockDescriptor.size);
 		break;
 	case ADI_DATA:
-		ReadDataBlock(blockDescriptor.size);
+		ReadDataBlock(blockOffset, blockDescriptor.size, dest);
 		break;
 	case ADI_ZLIB:
-		ReadGzipBlock(blockDescriptor.size);
+		ReadGzipBlock(blockOffset, blockDescriptor.size, dest, readBuffer);
 		break;
 	case ADI_BZ2:
-		ReadBz2Block(blockDescriptor.size);
+		ReadBz2Block(blockOffset, blockDescriptor.size, dest, readBuffer);
 		break;
 	default:
 		throw std::runtime_error("Unsupported block storage mode.");
 		break;
 	}
-	m_cachedBlockNumber = neededBlock;
+}
+
+void CIszImageStream::ReadBaseAt(uint64 position, uint8* dest, uint32 size)
+{
+	std::lock_guard<std::mutex> baseStreamLock(m_baseStreamMutex);
+	m_baseStream->Seek(position, Framework::STREAM_SEEK_SET);
+	m_baseStream->Read(dest, size);
 }
 
 void CIszImageStream::ReadZeroBlock(uint32 compressedBlockSize)
@@ -185,38 +176,40 @@ void CIszImageStream::ReadZeroBlock(uint32 compressedBlockSize)
 	}
 }
 
-void CIszImageStream::ReadDataBlock(uint32 compressedBlockSize)
+void CIszImageStream::ReadDataBlock(uint64 blockOffset, uint32 compressedBlockSize, uint8* dest)
 {
 	if(compressedBlockSize != m_header.blockSize)
 	{
 		throw std::runtime_error("Invalid data block.");
 	}
-	m_baseStream->Read(m_cachedBlock, compressedBlockSize);
+	ReadBaseAt(blockOffset, dest, compressedBlockSize);
 }
 
-void CIszImageStream::ReadGzipBlock(uint32 compressedBlockSize)
+void CIszImageStream::ReadGzipBlock(uint64 blockOffset, uint32 compressedBlockSize, uint8* dest, std::vector<uint8>& readBuffer)
 {
-	m_baseStream->Read(m_readBuffer, compressedBlockSize);
+	readBuffer.resize(compressedBlockSize);
+	ReadBaseAt(blockOffset, readBuffer.data(), compressedBlockSize);
 	uLongf destLength = m_header.blockSize;
 	if(uncompress(
-	       reinterpret_cast<Bytef*>(m_cachedBlock), &destLength,
-	       reinterpret_cast<Bytef*>(m_readBuffer), compressedBlockSize) != Z_OK)
+	       reinterpret_cast<Bytef*>(dest), &destLength,
+	       reinterpret_cast<Bytef*>(readBuffer.data()), compressedBlockSize) != Z_OK)
 	{
 		throw std::runtime_error("Error decompressing zlib block.");
 	}
 }
 
-void CIszImageStream::ReadBz2Block(uint32 compressedBlockSize)
+void CIszImageStream::ReadBz2Block(uint64 blockOffset, uint32 compressedBlockSize, uint8* dest, std::vector<uint8>& readBuffer)
 {
-	m_baseStream->Read(m_readBuffer, compressedBlockSize);
+	readBuffer.resize(std::max<uint32>(compressedBlockSize, 3));
+	ReadBaseAt(blockOffset, readBuffer.data(), compressedBlockSize);
 	//Force BZ2 header
-	m_readBuffer[0] = 'B';
-	m_readBuffer[1] = 'Z';
-	m_readBuffer[2] = 'h';
+	readBuffer[0] = 'B';
+	readBuffer[1] = 'Z';
+	readBuffer[2] = 'h';
 	unsigned int destLength = m_header.blockSize;
 	if(BZ2_bzBuffToBuffDecompress(
-	       reinterpret_cast<char*>(m_cachedBlock), &destLength,
-	       reinterpret_cast<char*>(m_readBuffer), compressedBlockSize, 0, 0) != BZ_OK)
+	       reinterpret_cast<char*>(dest), &destLength,
+	       reinterpret_cast<char*>(readBuffer.data()), compressedBlockSize, 0, 0) != BZ_OK)
 	{
 		throw std::runtime_error("Error decompressing bz2 block.");
 	}
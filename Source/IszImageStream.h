@@ -1,7 +1,11 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "Types.h"
 #include "Stream.h"
+#include "FrameCache.h"
 
 class CIszImageStream : public Framework::CStream
 {
@@ -70,19 +74,19 @@ private:
 
 	void ReadBlockDescriptorTable();
 	uint64 GetTotalSize() const;
-	const BLOCKDESCRIPTOR& SeekToBlock(uint64);
-	void SyncCache();
+	void LoadBlock(uint32, uint8*, std::vector<uint8>&);
+	void ReadBaseAt(uint64, uint8*, uint32);
 
 	void ReadZeroBlock(uint32);
-	void ReadDataBlock(uint32);
-	void ReadGzipBlock(uint32);
-	void ReadBz2Block(uint32);
+	void ReadDataBlock(uint64, uint32, uint8*);
+	void ReadGzipBlock(uint64, uint32, uint8*, std::vector<uint8>&);
+	void ReadBz2Block(uint64, uint32, uint8*, std::vector<uint8>&);
 
 	Framework::CStream* m_baseStream = nullptr;
+	std::mutex m_baseStreamMutex;
 	HEADER m_header;
 	BLOCKDESCRIPTOR* m_blockDescriptorTable = nullptr;
-	int64 m_cachedBlockNumber = -1;
-	uint8* m_cachedBlock = nullptr;
-	uint8* m_readBuffer = nullptr;
+	std::vector<uint64> m_blockOffsetTable;
 	uint64 m_position = 0;
+	std::unique_ptr<CFrameCache> m_blockCache;
 };
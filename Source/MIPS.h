@@ -148,6 +148,9 @@ public:
 	void** m_pageLookup = nullptr;
 
 	std::function<void(CMIPS*)> m_emptyBlockHandler;
+	std::function<void(CMIPS*, uint32)> m_hotBlockHandler;
+	std::function<bool(CMIPS*, uint32)> m_blockValidationHandler;
+	uint32* m_blockExecutionCounters = nullptr;
 
 	CMIPSArchitecture* m_pArch = nullptr;
 	CMIPSCoprocessor* m_pCOP[4];
@@ -10,6 +10,11 @@ CMIPSInstructionFactory::CMIPSInstructionFactory(MIPS_REGSIZE nRegSize)
 {
 }
 
+MIPS_REGSIZE CMIPSInstructionFactory::GetRegSize() const
+{
+	return m_regSize;
+}
+
 void CMIPSInstructionFactory::SetupQuickVariables(uint32 nAddress, CMipsJitter* codeGen, CMIPS* pCtx)
 {
 	m_pCtx = pCtx;
@@ -1,14 +1,22 @@
 #pragma once
 
+#include <memory>
 #include "Types.h"
 
+class CBlockCache;
+
 class CMipsExecutor
 {
 public:
+	typedef std::shared_ptr<CBlockCache> BlockCachePtr;
+
 	virtual ~CMipsExecutor() = default;
 	virtual void Reset() = 0;
 	virtual int Execute(int) = 0;
 	virtual void ClearActiveBlocksInRange(uint32 start, uint32 end, bool executing) = 0;
+	virtual void SetBlockCache(BlockCachePtr) = 0;
+	virtual void SetBackgroundCompilationEnabled(bool) = 0;
+	virtual void SetTieredCompilationEnabled(bool) = 0;
 
 #ifdef DEBUGGER_INCLUDED
 	virtual bool MustBreak() const = 0;
@@ -0,0 +1,757 @@
+#include <cassert>
+#include "MipsInterpreter.h"
+#include "MIPS.h"
+#include "MemoryUtils.h"
+#include "COP_SCU.h"
+
+extern "C"
+{
+	uint32 LWL_Proxy(uint32, uint32, CMIPS*);
+	uint32 LWR_Proxy(uint32, uint32, CMIPS*);
+	uint64 LDL_Proxy(uint32, uint64, CMIPS*);
+	uint64 LDR_Proxy(uint32, uint64, CMIPS*);
+	void SWL_Proxy(uint32, uint32, CMIPS*);
+	void SWR_Proxy(uint32, uint32, CMIPS*);
+	void SDL_Proxy(uint32, uint64, CMIPS*);
+	void SDR_Proxy(uint32, uint64, CMIPS*);
+}
+
+#define OP_RS(opcode) (((opcode) >> 21) & 0x1F)
+#define OP_RT(opcode) (((opcode) >> 16) & 0x1F)
+#define OP_RD(opcode) (((opcode) >> 11) & 0x1F)
+#define OP_SA(opcode) (((opcode) >> 6) & 0x1F)
+#define OP_IMM(opcode) (static_cast<uint16>((opcode)&0xFFFF))
+
+CMipsInterpreter::CMipsInterpreter(CMIPS& context)
+    : m_context(context)
+    , m_is64(context.m_pArch->GetRegSize() == MIPS_REGSIZE_64)
+{
+}
+
+bool CMipsInterpreter::CanExecuteRange(uint32 begin, uint32 end) const
+{
+	for(uint32 address = begin; address <= end; address += 4)
+	{
+		uint32 opcode = m_context.m_pMemoryMap->GetInstruction(address);
+		if(!IsInstructionSupported(opcode)) return false;
+	}
+	return true;
+}
+
+void CMipsInterpreter::ExecuteRange(uint32 begin, uint32 end)
+{
+	auto& state = m_context.m_State;
+
+	for(uint32 address = begin; address <= end; address += 4)
+	{
+		uint32 opcode = m_context.m_pMemoryMap->GetInstruction(address);
+		if(!ExecuteInstruction(address, opcode))
+		{
+			//Branch likely not taken, delay slot is skipped
+			break;
+		}
+	}
+
+	//Same as CBasicBlock::CompileEpilog
+	state.cycleQuota -= ((end - begin) / 4) + 1;
+	if(state.cycleQuota <= 0)
+	{
+		state.nHasException |= MIPS_EXECUTION_STATUS_QUOTADONE;
+	}
+
+	if(state.nDelayedJumpAddr != MIPS_INVALID_PC)
+	{
+		state.nPC = state.nDelayedJumpAddr;
+		state.nDelayedJumpAddr = MIPS_INVALID_PC;
+	}
+	else
+	{
+		state.nPC = end + 4;
+	}
+}
+
+bool CMipsInterpreter::IsInstructionSupported(uint32 opcode) const
+{
+	if(opcode == 0) return true;
+
+	uint32 general = opcode >> 26;
+	switch(general)
+	{
+	case 0x00:
+		//SPECIAL
+		switch(opcode & 0x3F)
+		{
+		case 0x00:
+		case 0x02:
+		case 0x03:
+		case 0x04:
+		case 0x06:
+		case 0x07:
+		case 0x08:
+		case 0x09:
+		case 0x0A:
+		case 0x0B:
+		case 0x0C:
+		case 0x0D:
+		case 0x0F:
+		case 0x10:
+		case 0x11:
+		case 0x12:
+		case 0x13:
+		case 0x18:
+		case 0x19:
+		case 0x1A:
+		case 0x1B:
+		case 0x20:
+		case 0x21:
+		case 0x22:
+		case 0x23:
+		case 0x24:
+		case 0x25:
+		case 0x26:
+		case 0x27:
+		case 0x2A:
+		case 0x2B:
+			return true;
+		case 0x14:
+		case 0x16:
+		case 0x17:
+		case 0x2C:
+		case 0x2D:
+		case 0x2E:
+		case 0x2F:
+		case 0x38:
+		case 0x3A:
+		case 0x3B:
+		case 0x3C:
+		case 0x3E:
+		case 0x3F:
+			return m_is64;
+		default:
+			return false;
+		}
+	case 0x01:
+		//REGIMM
+		switch(OP_RT(opcode))
+		{
+		case 0x00:
+		case 0x01:
+		case 0x02:
+		case 0x03:
+		case 0x10:
+		case 0x11:
+		case 0x12:
+		case 0x13:
+			return true;
+		default:
+			return false;
+		}
+	case 0x02:
+	case 0x03:
+	case 0x04:
+	case 0x05:
+	case 0x06:
+	case 0x07:
+	case 0x08:
+	case 0x09:
+	case 0x0A:
+	case 0x0B:
+	case 0x0C:
+	case 0x0D:
+	case 0x0E:
+	case 0x0F:
+	case 0x14:
+	case 0x15:
+	case 0x16:
+	case 0x17:
+	case 0x20:
+	case 0x21:
+	case 0x22:
+	case 0x23:
+	case 0x24:
+	case 0x25:
+	case 0x26:
+	case 0x28:
+	case 0x29:
+	case 0x2A:
+	case 0x2B:
+	case 0x2E:
+	case 0x2F:
+	case 0x33:
+		return true;
+	case 0x18:
+	case 0x19:
+	case 0x1A:
+	case 0x1B:
+	case 0x27:
+	case 0x2C:
+	case 0x2D:
+	case 0x37:
+	case 0x3F:
+		return m_is64;
+	default:
+		//Coprocessors, SPECIAL2, LQ/SQ, etc.
+		return false;
+	}
+}
+
+bool CMipsInterpreter::ExecuteInstruction(uint32 address, uint32 opcode)
+{
+	if(opcode == 0) return true;
+
+	auto& state = m_context.m_State;
+	unsigned int rs = OP_RS(opcode);
+	unsigned int rt = OP_RT(opcode);
+	uint16 immediate = OP_IMM(opcode);
+	const auto& rsReg = state.nGPR[rs];
+	const auto& rtReg = state.nGPR[rt];
+
+	switch(opcode >> 26)
+	{
+	case 0x00:
+		ExecuteSpecial(address, opcode);
+		break;
+	case 0x01:
+		return ExecuteRegImm(address, opcode);
+	case 0x02:
+		//J
+		state.nDelayedJumpAddr = (address & 0xF0000000) | ((opcode & 0x03FFFFFF) << 2);
+		break;
+	case 0x03:
+		//JAL
+		state.nGPR[CMIPS::RA].nV[0] = address + 8;
+		state.nDelayedJumpAddr = (address & 0xF0000000) | ((opcode & 0x03FFFFFF) << 2);
+		break;
+	case 0x04:
+	case 0x05:
+	case 0x14:
+	case 0x15:
+	{
+		//BEQ, BNE, BEQL, BNEL
+		bool equal = m_is64 ? (rsReg.nD0 == rtReg.nD0) : (rsReg.nV0 == rtReg.nV0);
+		bool isEqualBranch = ((opcode >> 26) & 1) == 0;
+		bool likely = (opcode >> 26) >= 0x14;
+		return Branch(address, opcode, equal == isEqualBranch, likely);
+	}
+	case 0x06:
+	case 0x07:
+	case 0x16:
+	case 0x17:
+	{
+		//BLEZ, BGTZ, BLEZL, BGTZL
+		bool lessEqual = m_is64 ? (static_cast<int64>(rsReg.nD0) <= 0) : (static_cast<int32>(rsReg.nV0) <= 0);
+		bool isLessEqualBranch = ((opcode >> 26) & 1) == 0;
+		bool likely = (opcode >> 26) >= 0x14;
+		return Branch(address, opcode, lessEqual == isLessEqualBranch, likely);
+	}
+	case 0x08:
+	case 0x09:
+		//ADDI, ADDIU
+		if((rt == 0) && (rs == 0) && ((opcode >> 26) == 0x09))
+		{
+			//Hack: PS2 IOP uses ADDIU R0, R0, $x for dynamic linking
+			state.nCOP0[CCOP_SCU::EPC] = address;
+			state.nHasException = MIPS_EXCEPTION_SYSCALL;
+		}
+		else
+		{
+			SetGpr32(rt, rsReg.nV0 + static_cast<int16>(immediate));
+		}
+		break;
+	case 0x0A:
+		//SLTI
+		if(rt != 0)
+		{
+			bool result = m_is64 ? (static_cast<int64>(rsReg.nD0) < static_cast<int16>(immediate)) : (static_cast<int32>(rsReg.nV0) < static_cast<int16>(immediate));
+			state.nGPR[rt].nV[0] = result ? 1 : 0;
+			if(m_is64) state.nGPR[rt].nV[1] = 0;
+		}
+		break;
+	case 0x0B:
+		//SLTIU
+		if(rt != 0)
+		{
+			bool result = m_is64 ? (rsReg.nD0 < static_cast<uint64>(static_cast<int64>(static_cast<int16>(immediate)))) : (rsReg.nV0 < static_cast<uint32>(static_cast<int32>(static_cast<int16>(immediate))));
+			state.nGPR[rt].nV[0] = result ? 1 : 0;
+			if(m_is64) state.nGPR[rt].nV[1] = 0;
+		}
+		break;
+	case 0x0C:
+		//ANDI
+		if(rt != 0)
+		{
+			state.nGPR[rt].nV[0] = rsReg.nV0 & immediate;
+			if(m_is64) state.nGPR[rt].nV[1] = 0;
+		}
+		break;
+	case 0x0D:
+		//ORI
+		if(rt != 0)
+		{
+			state.nGPR[rt].nV[0] = rsReg.nV0 | immediate;
+			if(m_is64) state.nGPR[rt].nV[1] = rsReg.nV1;
+		}
+		break;
+	case 0x0E:
+		//XORI
+		if(rt != 0)
+		{
+			state.nGPR[rt].nV[0] = rsReg.nV0 ^ immediate;
+			state.nGPR[rt].nV[1] = rsReg.nV1;
+		}
+		break;
+	case 0x0F:
+		//LUI
+		SetGpr32(rt, immediate << 16);
+		break;
+	case 0x18:
+	case 0x19:
+		//DADDI, DADDIU
+		SetGpr64(rt, rsReg.nD0 + static_cast<int64>(static_cast<int16>(immediate)));
+		break;
+	case 0x1A:
+		//LDL
+		if(rt != 0)
+		{
+			state.nGPR[rt].nD0 = LDL_Proxy(ComputeMemAccessAddr(opcode), rtReg.nD0, &m_context);
+		}
+		break;
+	case 0x1B:
+		//LDR
+		if(rt != 0)
+		{
+			state.nGPR[rt].nD0 = LDR_Proxy(ComputeMemAccessAddr(opcode), rtReg.nD0, &m_context);
+		}
+		break;
+	case 0x20:
+		//LB
+		if(rt != 0)
+		{
+			SetGpr32(rt, static_cast<int8>(MemoryUtils_GetByteProxy(&m_context, ComputeMemAccessAddr(opcode))));
+		}
+		break;
+	case 0x21:
+		//LH
+		if(rt != 0)
+		{
+			SetGpr32(rt, static_cast<int16>(MemoryUtils_GetHalfProxy(&m_context, ComputeMemAccessAddr(opcode))));
+		}
+		break;
+	case 0x22:
+		//LWL
+		if(rt != 0)
+		{
+			SetGpr32(rt, LWL_Proxy(ComputeMemAccessAddr(opcode), rtReg.nV0, &m_context));
+		}
+		break;
+	case 0x23:
+		//LW
+		if(rt != 0)
+		{
+			SetGpr32(rt, MemoryUtils_GetWordProxy(&m_context, ComputeMemAccessAddr(opcode)));
+		}
+		break;
+	case 0x24:
+		//LBU
+		if(rt != 0)
+		{
+			SetGpr32(rt, static_cast<uint8>(MemoryUtils_GetByteProxy(&m_context, ComputeMemAccessAddr(opcode))));
+		}
+		break;
+	case 0x25:
+		//LHU
+		if(rt != 0)
+		{
+			SetGpr32(rt, static_cast<uint16>(MemoryUtils_GetHalfProxy(&m_context, ComputeMemAccessAddr(opcode))));
+		}
+		break;
+	case 0x26:
+		//LWR
+		if(rt != 0)
+		{
+			SetGpr32(rt, LWR_Proxy(ComputeMemAccessAddr(opcode), rtReg.nV0, &m_context));
+		}
+		break;
+	case 0x27:
+		//LWU
+		if(rt != 0)
+		{
+			state.nGPR[rt].nV[0] = MemoryUtils_GetWordProxy(&m_context, ComputeMemAccessAddr(opcode));
+			state.nGPR[rt].nV[1] = 0;
+		}
+		break;
+	case 0x28:
+		//SB
+		MemoryUtils_SetByteProxy(&m_context, rtReg.nV0, ComputeMemAccessAddr(opcode));
+		break;
+	case 0x29:
+		//SH
+		MemoryUtils_SetHalfProxy(&m_context, rtReg.nV0, ComputeMemAccessAddr(opcode));
+		break;
+	case 0x2A:
+		//SWL
+		SWL_Proxy(ComputeMemAccessAddr(opcode), rtReg.nV0, &m_context);
+		break;
+	case 0x2B:
+		//SW
+		MemoryUtils_SetWordProxy(&m_context, rtReg.nV0, ComputeMemAccessAddr(opcode));
+		break;
+	case 0x2C:
+		//SDL
+		SDL_Proxy(ComputeMemAccessAddr(opcode), rtReg.nD0, &m_context);
+		break;
+	case 0x2D:
+		//SDR
+		SDR_Proxy(ComputeMemAccessAddr(opcode), rtReg.nD0, &m_context);
+		break;
+	case 0x2E:
+		//SWR
+		SWR_Proxy(ComputeMemAccessAddr(opcode), rtReg.nV0, &m_context);
+		break;
+	case 0x2F:
+	case 0x33:
+		//CACHE, PREF
+		break;
+	case 0x37:
+		//LD
+		if(rt != 0)
+		{
+			state.nGPR[rt].nD0 = MemoryUtils_GetDoubleProxy(&m_context, ComputeMemAccessAddr(opcode));
+		}
+		break;
+	case 0x3F:
+		//SD
+		MemoryUtils_SetDoubleProxy(&m_context, rtReg.nD0, ComputeMemAccessAddr(opcode));
+		break;
+	default:
+		assert(false);
+		break;
+	}
+	return true;
+}
+
+void CMipsInterpreter::ExecuteSpecial(uint32 address, uint32 opcode)
+{
+	auto& state = m_context.m_State;
+	unsigned int rs = OP_RS(opcode);
+	unsigned int rt = OP_RT(opcode);
+	unsigned int rd = OP_RD(opcode);
+	unsigned int sa = OP_SA(opcode);
+	const auto& rsReg = state.nGPR[rs];
+	const auto& rtReg = state.nGPR[rt];
+
+	switch(opcode & 0x3F)
+	{
+	case 0x00:
+		//SLL
+		SetGpr32(rd, rtReg.nV0 << sa);
+		break;
+	case 0x02:
+		//SRL
+		SetGpr32(rd, rtReg.nV0 >> sa);
+		break;
+	case 0x03:
+		//SRA
+		SetGpr32(rd, static_cast<int32>(rtReg.nV0) >> sa);
+		break;
+	case 0x04:
+		//SLLV
+		SetGpr32(rd, rtReg.nV0 << (rsReg.nV0 & 0x1F));
+		break;
+	case 0x06:
+		//SRLV
+		SetGpr32(rd, rtReg.nV0 >> (rsReg.nV0 & 0x1F));
+		break;
+	case 0x07:
+		//SRAV
+		SetGpr32(rd, static_cast<int32>(rtReg.nV0) >> (rsReg.nV0 & 0x1F));
+		break;
+	case 0x08:
+		//JR
+		state.nDelayedJumpAddr = rsReg.nV0;
+		break;
+	case 0x09:
+		//JALR
+		state.nDelayedJumpAddr = rsReg.nV0;
+		if(rd != 0)
+		{
+			state.nGPR[rd].nV[0] = address + 8;
+		}
+		break;
+	case 0x0A:
+	case 0x0B:
+	{
+		//MOVZ, MOVN
+		if(rd == 0) break;
+		bool isZero = m_is64 ? (rtReg.nD0 == 0) : (rtReg.nV0 == 0);
+		bool moveIfZero = (opcode & 0x3F) == 0x0A;
+		if(isZero == moveIfZero)
+		{
+			state.nGPR[rd].nV[0] = rsReg.nV0;
+			if(m_is64) state.nGPR[rd].nV[1] = rsReg.nV1;
+		}
+	}
+	break;
+	case 0x0C:
+		//SYSCALL
+		state.nCOP0[CCOP_SCU::EPC] = address;
+		state.nHasException = MIPS_EXCEPTION_SYSCALL;
+		break;
+	case 0x0D:
+	case 0x0F:
+		//BREAK, SYNC
+		break;
+	case 0x10:
+		//MFHI
+		if(rd == 0) break;
+		state.nGPR[rd].nV[0] = state.nHI[0];
+		state.nGPR[rd].nV[1] = state.nHI[1];
+		break;
+	case 0x11:
+		//MTHI
+		state.nHI[0] = rsReg.nV0;
+		state.nHI[1] = rsReg.nV1;
+		break;
+	case 0x12:
+		//MFLO
+		if(rd == 0) break;
+		state.nGPR[rd].nV[0] = state.nLO[0];
+		state.nGPR[rd].nV[1] = state.nLO[1];
+		break;
+	case 0x13:
+		//MTLO
+		state.nLO[0] = rsReg.nV0;
+		state.nLO[1] = rsReg.nV1;
+		break;
+	case 0x14:
+		//DSLLV
+		SetGpr64(rd, rtReg.nD0 << (rsReg.nV0 & 0x3F));
+		break;
+	case 0x16:
+		//DSRLV
+		SetGpr64(rd, rtReg.nD0 >> (rsReg.nV0 & 0x3F));
+		break;
+	case 0x17:
+		//DSRAV
+		SetGpr64(rd, static_cast<int64>(rtReg.nD0) >> (rsReg.nV0 & 0x3F));
+		break;
+	case 0x18:
+	case 0x19:
+	{
+		//MULT, MULTU
+		uint64 result = ((opcode & 0x3F) == 0x18)
+		                    ? static_cast<uint64>(static_cast<int64>(static_cast<int32>(rsReg.nV0)) * static_cast<int64>(static_cast<int32>(rtReg.nV0)))
+		                    : static_cast<uint64>(rsReg.nV0) * static_cast<uint64>(rtReg.nV0);
+		state.nLO[0] = static_cast<uint32>(result);
+		state.nHI[0] = static_cast<uint32>(result >> 32);
+		if(m_is64)
+		{
+			state.nLO[1] = static_cast<int32>(state.nLO[0]) >> 31;
+			state.nHI[1] = static_cast<int32>(state.nHI[0]) >> 31;
+		}
+		if(rd != 0)
+		{
+			//EE also writes the result in rd
+			state.nGPR[rd].nV[0] = state.nLO[0];
+			state.nGPR[rd].nV[1] = state.nLO[1];
+		}
+	}
+	break;
+	case 0x1A:
+	case 0x1B:
+	{
+		//DIV, DIVU
+		bool isSigned = (opcode & 0x3F) == 0x1A;
+		uint32 dividend = rsReg.nV0;
+		uint32 divisor = rtReg.nV0;
+		if(divisor == 0)
+		{
+			state.nLO[0] = (isSigned && (static_cast<int32>(dividend) < 0)) ? 1 : ~0U;
+			state.nHI[0] = dividend;
+		}
+		else if(isSigned && (dividend == 0x80000000) && (divisor == 0xFFFFFFFF))
+		{
+			state.nLO[0] = 0x80000000;
+			state.nHI[0] = 0;
+		}
+		else if(isSigned)
+		{
+			state.nLO[0] = static_cast<int32>(dividend) / static_cast<int32>(divisor);
+			state.nHI[0] = static_cast<int32>(dividend) % static_cast<int32>(divisor);
+		}
+		else
+		{
+			state.nLO[0] = dividend / divisor;
+			state.nHI[0] = dividend % divisor;
+		}
+		if(m_is64)
+		{
+			state.nHI[1] = static_cast<int32>(state.nHI[0]) >> 31;
+			state.nLO[1] = static_cast<int32>(state.nLO[0]) >> 31;
+		}
+	}
+	break;
+	case 0x20:
+	case 0x21:
+		//ADD, ADDU
+		SetGpr32(rd, rsReg.nV0 + rtReg.nV0);
+		break;
+	case 0x22:
+	case 0x23:
+		//SUB, SUBU
+		SetGpr32(rd, rsReg.nV0 - rtReg.nV0);
+		break;
+	case 0x24:
+		//AND
+		if(rd == 0) break;
+		if(m_is64)
+		{
+			state.nGPR[rd].nD0 = rsReg.nD0 & rtReg.nD0;
+		}
+		else
+		{
+			state.nGPR[rd].nV[0] = rsReg.nV0 & rtReg.nV0;
+		}
+		break;
+	case 0x25:
+	case 0x26:
+	case 0x27:
+	{
+		//OR, XOR, NOR
+		if(rd == 0) break;
+		unsigned int regCount = m_is64 ? 2 : 1;
+		for(unsigned int i = 0; i < regCount; i++)
+		{
+			uint32 result = 0;
+			switch(opcode & 0x3F)
+			{
+			case 0x25:
+				result = rsReg.nV[i] | rtReg.nV[i];
+				break;
+			case 0x26:
+				result = rsReg.nV[i] ^ rtReg.nV[i];
+				break;
+			case 0x27:
+				result = ~(rsReg.nV[i] | rtReg.nV[i]);
+				break;
+			}
+			state.nGPR[rd].nV[i] = result;
+		}
+	}
+	break;
+	case 0x2A:
+	case 0x2B:
+	{
+		//SLT, SLTU
+		if(rd == 0) break;
+		bool isSigned = (opcode & 0x3F) == 0x2A;
+		bool result = false;
+		if(m_is64)
+		{
+			result = isSigned ? (static_cast<int64>(rsReg.nD0) < static_cast<int64>(rtReg.nD0)) : (rsReg.nD0 < rtReg.nD0);
+		}
+		else
+		{
+			result = isSigned ? (static_cast<int32>(rsReg.nV0) < static_cast<int32>(rtReg.nV0)) : (rsReg.nV0 < rtReg.nV0);
+		}
+		state.nGPR[rd].nV[0] = result ? 1 : 0;
+		if(m_is64) state.nGPR[rd].nV[1] = 0;
+	}
+	break;
+	case 0x2C:
+	case 0x2D:
+		//DADD, DADDU
+		SetGpr64(rd, rsReg.nD0 + rtReg.nD0);
+		break;
+	case 0x2E:
+	case 0x2F:
+		//DSUB, DSUBU
+		SetGpr64(rd, rsReg.nD0 - rtReg.nD0);
+		break;
+	case 0x38:
+		//DSLL
+		SetGpr64(rd, rtReg.nD0 << sa);
+		break;
+	case 0x3A:
+		//DSRL
+		SetGpr64(rd, rtReg.nD0 >> sa);
+		break;
+	case 0x3B:
+		//DSRA
+		SetGpr64(rd, static_cast<int64>(rtReg.nD0) >> sa);
+		break;
+	case 0x3C:
+		//DSLL32
+		SetGpr64(rd, rtReg.nD0 << (sa + 32));
+		break;
+	case 0x3E:
+		//DSRL32
+		SetGpr64(rd, rtReg.nD0 >> (sa + 32));
+		break;
+	case 0x3F:
+		//DSRA32
+		SetGpr64(rd, static_cast<int64>(rtReg.nD0) >> (sa + 32));
+		break;
+	default:
+		assert(false);
+		break;
+	}
+}
+
+bool CMipsInterpreter::ExecuteRegImm(uint32 address, uint32 opcode)
+{
+	auto& state = m_context.m_State;
+	unsigned int rs = OP_RS(opcode);
+	unsigned int rt = OP_RT(opcode);
+
+	//BLTZAL, BGEZAL, BLTZALL, BGEZALL
+	if(rt & 0x10)
+	{
+		state.nGPR[CMIPS::RA].nV[0] = address + 8;
+	}
+
+	uint32 signWord = m_is64 ? state.nGPR[rs].nV[1] : state.nGPR[rs].nV[0];
+	bool greaterEqual = (signWord & 0x80000000) == 0;
+	bool isGreaterEqualBranch = (rt & 1) != 0;
+	bool likely = (rt & 2) != 0;
+	return Branch(address, opcode, greaterEqual == isGreaterEqualBranch, likely);
+}
+
+bool CMipsInterpreter::Branch(uint32 address, uint32 opcode, bool condition, bool likely)
+{
+	auto& state = m_context.m_State;
+	state.nDelayedJumpAddr = MIPS_INVALID_PC;
+	if(condition)
+	{
+		state.nDelayedJumpAddr = (address + 4) + CMIPS::GetBranch(OP_IMM(opcode));
+		return true;
+	}
+	if(likely)
+	{
+		state.nPC = address + 8;
+		return false;
+	}
+	return true;
+}
+
+uint32 CMipsInterpreter::ComputeMemAccessAddr(uint32 opcode) const
+{
+	return m_context.m_State.nGPR[OP_RS(opcode)].nV0 + static_cast<int16>(OP_IMM(opcode));
+}
+
+void CMipsInterpreter::SetGpr32(unsigned int reg, uint32 value)
+{
+	if(reg == 0) return;
+	auto& gpr = m_context.m_State.nGPR[reg];
+	gpr.nV[0] = value;
+	if(m_is64)
+	{
+		gpr.nV[1] = static_cast<int32>(value) >> 31;
+	}
+}
+
+void CMipsInterpreter::SetGpr64(unsigned int reg, uint64 value)
+{
+	if(reg == 0) return;
+	m_context.m_State.nGPR[reg].nD0 = value;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Types.h"
+
+class CMIPS;
+
+//Executes basic blocks without compiling them
+//Only the integer subset of MIPS IV that's shared by the EE and the IOP is supported, blocks using
+//anything else (coprocessors, MMI, etc.) must go through the JIT. Behavior matches what CBasicBlock
+//generates, including the cycle quota and PC updates done by the block epilog.
+class CMipsInterpreter
+{
+public:
+	CMipsInterpreter(CMIPS&);
+	virtual ~CMipsInterpreter() = default;
+
+	bool CanExecuteRange(uint32, uint32) const;
+	void ExecuteRange(uint32, uint32);
+
+private:
+	bool IsInstructionSupported(uint32) const;
+	bool ExecuteInstruction(uint32, uint32);
+
+	void ExecuteSpecial(uint32, uint32);
+	bool ExecuteRegImm(uint32, uint32);
+
+	bool Branch(uint32, uint32, bool, bool);
+
+	uint32 ComputeMemAccessAddr(uint32) const;
+
+	void SetGpr32(unsigned int, uint32);
+	void SetGpr64(unsigned int, uint64);
+
+	CMIPS& m_context;
+	bool m_is64 = false;
+};
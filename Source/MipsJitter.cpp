@@ -70,6 +70,8 @@ void CMipsJitter::MarkFinalBlockLabel()
 	if(m_lastBlockLabel != -1)
 	{
 		MarkLabel(m_lastBlockLabel);
+		//Allows another final label to be used if more instructions are compiled after this
+		m_lastBlockLabel = -1;
 	}
 }
 
@@ -10,14 +10,14 @@ COpticalMedia* COpticalMedia::CreateAuto(StreamPtr& stream)
 	//Simulate a disk with only one data track
 	try
 	{
-		auto blockProvider = std::make_shared<ISO9660::CBlockProvider2048>(stream);
+		auto blockProvider = std::make_shared<ISO9660::CBlockProvider2048>(stream, 0, result->m_streamMutex);
 		result->m_fileSystem = std::make_unique<CISO9660>(blockProvider);
 		result->m_track0DataType = TRACK_DATA_TYPE_MODE1_2048;
 	}
 	catch(...)
 	{
 		//Failed with block size 2048, try with CD-ROM XA
-		auto blockProvider = std::make_shared<ISO9660::CBlockProviderCDROMXA>(stream);
+		auto blockProvider = std::make_shared<ISO9660::CBlockProviderCDROMXA>(stream, result->m_streamMutex);
 		result->m_fileSystem = std::make_unique<CISO9660>(blockProvider);
 		result->m_track0DataType = TRACK_DATA_TYPE_MODE2_2352;
 	}
@@ -40,7 +40,7 @@ COpticalMedia* COpticalMedia::CreateAuto(StreamPtr& stream)
 COpticalMedia* COpticalMedia::CreateDvd(StreamPtr& stream, bool isDualLayer, uint32 secondLayerStart)
 {
 	auto result = new COpticalMedia();
-	auto blockProvider = std::make_shared<ISO9660::CBlockProvider2048>(stream);
+	auto blockProvider = std::make_shared<ISO9660::CBlockProvider2048>(stream, 0, result->m_streamMutex);
 	result->m_fileSystem = std::make_unique<CISO9660>(blockProvider);
 	result->m_track0DataType = TRACK_DATA_TYPE_MODE1_2048;
 	result->m_dvdIsDualLayer = isDualLayer;
@@ -127,6 +127,6 @@ void COpticalMedia::CheckDualLayerDvd(const StreamPtr& stream)
 void COpticalMedia::SetupSecondLayer(const StreamPtr& stream)
 {
 	if(!m_dvdIsDualLayer) return;
-	auto blockProvider = std::make_shared<ISO9660::CBlockProvider2048>(stream, GetDvdSecondLayerStart());
+	auto blockProvider = std::make_shared<ISO9660::CBlockProvider2048>(stream, GetDvdSecondLayerStart(), m_streamMutex);
 	m_fileSystemL1 = std::make_unique<CISO9660>(blockProvider);
 }
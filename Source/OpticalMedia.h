@@ -37,6 +37,8 @@ private:
 	TRACK_DATA_TYPE m_track0DataType = TRACK_DATA_TYPE_MODE1_2048;
 	bool m_dvdIsDualLayer = false;
 	uint32 m_dvdSecondLayerStart = 0;
+	//Both layers read from the same stream
+	ISO9660::CBlockProvider::StreamMutexPtr m_streamMutex = std::make_shared<std::mutex>();
 	Iso9660Ptr m_fileSystem;
 	Iso9660Ptr m_fileSystemL1;
 };
@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <algorithm>
+#include <chrono>
 #include <exception>
 #include <memory>
 #include <fenv.h>
@@ -9,11 +11,14 @@
 #include "PS2VM_Preferences.h"
 #include "ee/PS2OS.h"
 #include "ee/EeExecutor.h"
+#include "BlockCache.h"
 #include "Ps2Const.h"
 #include "iop/Iop_SifManPs2.h"
 #include "StdStream.h"
 #include "StdStreamUtils.h"
+#include "MemStream.h"
 #include "GZipStream.h"
+#include "states/DeltaState.h"
 #include "states/MemoryStateFile.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
@@ -47,16 +52,14 @@ CPS2VM::CPS2VM()
     , m_singleStepIop(false)
     , m_singleStepVu0(false)
     , m_singleStepVu1(false)
-    , m_vblankTicks(0)
-    , m_inVblank(false)
     , m_eeExecutionTicks(0)
     , m_iopExecutionTicks(0)
-    , m_spuUpdateTicks(SPU_UPDATE_TICKS)
     , m_eeProfilerZone(CProfiler::GetInstance().RegisterZone("EE"))
     , m_iopProfilerZone(CProfiler::GetInstance().RegisterZone("IOP"))
     , m_spuProfilerZone(CProfiler::GetInstance().RegisterZone("SPU"))
     , m_gsSyncProfilerZone(CProfiler::GetInstance().RegisterZone("GSSYNC"))
     , m_otherProfilerZone(CProfiler::GetInstance().RegisterZone("OTHER"))
+    , m_schedulerProfilerZone(CProfiler::GetInstance().RegisterZone("SCHED"))
 {
 	static const std::pair<const char*, const char*> basicDirectorySettings[] =
 	    {
@@ -83,6 +86,10 @@ CPS2VM::CPS2VM()
 
 	CAppConfig::GetInstance().RegisterPreferencePath(PREF_PS2_CDROM0_PATH, "");
 
+	m_vblankStartEvent = m_scheduler.RegisterEvent("VBlankStart", std::bind(&CPS2VM::OnVBlankStart, this, std::placeholders::_1));
+	m_vblankEndEvent = m_scheduler.RegisterEvent("VBlankEnd", std::bind(&CPS2VM::OnVBlankEnd, this, std::placeholders::_1));
+	m_spuUpdateEvent = m_scheduler.RegisterEvent("SpuUpdate", std::bind(&CPS2VM::OnSpuUpdate, this, std::placeholders::_1));
+
 	Framework::PathUtils::EnsurePathExists(GetStateDirectoryPath());
 
 	m_iop = std::make_unique<Iop::CSubSystem>(true);
@@ -90,8 +97,20 @@ CPS2VM::CPS2VM()
 
 	m_ee = std::make_unique<Ee::CSubSystem>(m_iop->m_ram, *iopOs);
 	m_OnRequestLoadExecutableConnection = m_ee->m_os->OnRequestLoadExecutable.Connect(std::bind(&CPS2VM::ReloadExecutable, this, std::placeholders::_1, std::placeholders::_2));
-
+	m_OnExecutableChangeConnection = m_ee->m_os->OnExecutableChange.Connect(std::bind(&CPS2VM::OpenBlockCaches, this));
+	m_OnExecutableUnloadingConnection = m_ee->m_os->OnExecutableUnloading.Connect(std::bind(&CPS2VM::CloseBlockCaches, this));
+
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_BLOCKCACHE_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_BACKGROUNDCOMPILE_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_TIEREDCOMPILE_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_FINEGRAINEDINVALIDATION_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_THREADEDVU1_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_FIXEDSLICES_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_REWIND_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_INTERVAL, 30);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_MEMORYBUDGET, 256);
 	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT, 100);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_AUDIO_SPUTHREAD_ENABLED, false);
 	m_spuBlockCount = CAppConfig::GetInstance().GetPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT);
 }
 
@@ -228,12 +247,17 @@ void CPS2VM::Initialize()
 	CreateVM();
 	m_nEnd = false;
 	m_thread = std::thread([&]() { EmuThread(); });
+	m_stateThreadEnd = false;
+	m_stateThread = std::thread([&]() { StateThread(); });
 }
 
 void CPS2VM::Destroy()
 {
 	m_mailBox.SendCall(std::bind(&CPS2VM::DestroyImpl, this));
 	m_thread.join();
+	//States that are still pending get written before the thread ends
+	m_stateMailBox.SendCall([this]() { m_stateThreadEnd = true; });
+	m_stateThread.join();
 	DestroyVM();
 }
 
@@ -242,31 +266,64 @@ fs::path CPS2VM::GetStateDirectoryPath()
 	return CAppConfig::GetBasePath() / fs::path("states/");
 }
 
+fs::path CPS2VM::GetBlockCacheDirectoryPath()
+{
+	return CAppConfig::GetBasePath() / fs::path("blockcache/");
+}
+
 fs::path CPS2VM::GenerateStatePath(unsigned int slot) const
 {
 	auto stateFileName = string_format("%s.st%d.zip", m_ee->m_os->GetExecutableName(), slot);
 	return GetStateDirectoryPath() / fs::path(stateFileName);
 }
 
-std::future<bool> CPS2VM::SaveState(const fs::path& statePath)
+std::future<bool> CPS2VM::SaveState(const fs::path& statePath, const fs::path& baseStatePath)
 {
 	auto promise = std::make_shared<std::promise<bool>>();
 	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise, statePath, baseStatePath]() {
+		    auto startTime = std::chrono::steady_clock::now();
+		    auto archive = SaveVMState();
+		    if(!archive)
+		    {
+			    promise->set_value(false);
+			    return;
+		    }
+		    float stagingTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		    m_stateMailBox.SendCall(
+		        [this, promise, archive, statePath, baseStatePath, startTime, stagingTime]() {
+			        auto result = WriteVMState(*archive, statePath, baseStatePath);
+			        {
+				        std::lock_guard<std::mutex> stateLatencyLock(m_stateLatencyMutex);
+				        m_stateLatency.lastSaveStagingTime = stagingTime;
+				        m_stateLatency.lastSaveTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+			        }
+			        promise->set_value(result);
+		        });
+	    });
+	return future;
+}
+
+std::future<CPS2VM::LOAD_STATE_RESULT> CPS2VM::LoadState(const fs::path& statePath)
+{
+	auto promise = std::make_shared<std::promise<LOAD_STATE_RESULT>>();
+	auto future = promise->get_future();
 	m_mailBox.SendCall(
 	    [this, promise, statePath]() {
-		    auto result = SaveVMState(statePath);
+		    auto result = LoadVMState(statePath);
 		    promise->set_value(result);
 	    });
 	return future;
 }
 
-std::future<bool> CPS2VM::LoadState(const fs::path& statePath)
+std::future<bool> CPS2VM::Rewind()
 {
 	auto promise = std::make_shared<std::promise<bool>>();
 	auto future = promise->get_future();
 	m_mailBox.SendCall(
-	    [this, promise, statePath]() {
-		    auto result = LoadVMState(statePath);
+	    [this, promise]() {
+		    auto result = RewindImpl();
 		    promise->set_value(result);
 	    });
 	return future;
@@ -288,6 +345,12 @@ CPS2VM::CPU_UTILISATION_INFO CPS2VM::GetCpuUtilisationInfo() const
 	return m_cpuUtilisation;
 }
 
+CPS2VM::STATE_LATENCY_INFO CPS2VM::GetStateLatencyInfo() const
+{
+	std::lock_guard<std::mutex> stateLatencyLock(m_stateLatencyMutex);
+	return m_stateLatency;
+}
+
 #ifdef DEBUGGER_INCLUDED
 
 #define TAGS_SECTION_TAGS ("tags")
@@ -375,9 +438,38 @@ void CPS2VM::CreateVM()
 
 void CPS2VM::ResetVM()
 {
+	//Memory is about to be cleared, possibly from another thread than the one catching writes
+	static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get())->SetWriteTrackingEnabled(false);
+
 	m_ee->Reset();
 	m_iop->Reset();
 
+	{
+		bool backgroundCompileEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_BACKGROUNDCOMPILE_ENABLED);
+		m_ee->m_EE.m_executor->SetBackgroundCompilationEnabled(backgroundCompileEnabled);
+		m_iop->m_cpu.m_executor->SetBackgroundCompilationEnabled(backgroundCompileEnabled);
+
+		bool tieredCompileEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_TIEREDCOMPILE_ENABLED);
+		m_ee->m_EE.m_executor->SetTieredCompilationEnabled(tieredCompileEnabled);
+		m_iop->m_cpu.m_executor->SetTieredCompilationEnabled(tieredCompileEnabled);
+
+		bool fineGrainedInvalidationEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_FINEGRAINEDINVALIDATION_ENABLED);
+		static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get())->SetFineGrainedInvalidationEnabled(fineGrainedInvalidationEnabled);
+
+		bool threadedVu1Enabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_THREADEDVU1_ENABLED);
+		m_ee->m_vpu1->SetThreaded(threadedVu1Enabled);
+
+		m_fixedSlicesEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_FIXEDSLICES_ENABLED);
+
+		bool spuThreadEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_AUDIO_SPUTHREAD_ENABLED);
+		m_iop->m_spuRenderThread.SetThreaded(spuThreadEnabled);
+
+		//Budget is in megabytes
+		m_rewindEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_REWIND_ENABLED);
+		m_rewindInterval = std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_INTERVAL), 1);
+		m_rewindBuffer.SetMemoryBudget(static_cast<size_t>(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_MEMORYBUDGET)) * 0x100000);
+	}
+
 	//LoadBIOS();
 
 	if(m_ee->m_gs != NULL)
@@ -402,16 +494,19 @@ void CPS2VM::ResetVM()
 
 	CDROM0_SyncPath();
 
-	m_vblankTicks = ONSCREEN_TICKS;
-	m_inVblank = false;
-
 	m_eeExecutionTicks = 0;
 	m_iopExecutionTicks = 0;
+	m_iopSliceTicksRemain = 0;
+
+	m_scheduler.Reset();
+	m_scheduler.Schedule(m_vblankStartEvent, ONSCREEN_TICKS);
+	m_scheduler.Schedule(m_spuUpdateEvent, SPU_UPDATE_TICKS);
 
-	m_spuUpdateTicks = SPU_UPDATE_TICKS;
 	m_currentSpuBlock = 0;
 
 	RegisterModulesInPadHandler();
+
+	ResetRewindBuffer();
 }
 
 void CPS2VM::DestroyVM()
@@ -419,24 +514,68 @@ void CPS2VM::DestroyVM()
 	CDROM0_Reset();
 }
 
-bool CPS2VM::SaveVMState(const fs::path& statePath)
+CPS2VM::ZipArchiveWriterPtr CPS2VM::SaveVMState(bool includeRam)
 {
 	if(m_ee->m_gs == NULL)
 	{
 		printf("PS2VM: GS Handler was not instancied. Cannot save state.\r\n");
-		return false;
+		return ZipArchiveWriterPtr();
+	}
+
+	//State files copy what they hold, the archive doesn't depend on the machine state anymore once this is done
+	try
+	{
+		auto archive = std::make_shared<Framework::CZipArchiveWriter>();
+
+		m_ee->SaveState(*archive, includeRam);
+		m_iop->SaveState(*archive, includeRam);
+		m_ee->m_gs->SaveState(*archive, includeRam);
+
+		return archive;
+	}
+	catch(...)
+	{
+		return ZipArchiveWriterPtr();
 	}
+}
 
+bool CPS2VM::WriteVMState(Framework::CZipArchiveWriter& archive, const fs::path& statePath, const fs::path& baseStatePath)
+{
 	try
 	{
-		auto stateStream = Framework::CreateOutputStdStream(statePath.native());
-		Framework::CZipArchiveWriter archive;
+		if(fs::exists(statePath))
+		{
+			RebuildDeltaStates(statePath);
+		}
 
-		m_ee->SaveState(archive);
-		m_iop->SaveState(archive);
-		m_ee->m_gs->SaveState(archive);
+		if(baseStatePath.empty())
+		{
+			auto stateStream = Framework::CreateOutputStdStream(statePath.native());
+			archive.Write(stateStream);
+			return true;
+		}
+
+		if(statePath == baseStatePath)
+		{
+			return false;
+		}
 
+		//Files can't be enumerated from the archive writer, the full state is compressed in memory and read back
+		Framework::CMemStream stateStream;
 		archive.Write(stateStream);
+		stateStream.Seek(0, Framework::STREAM_SEEK_DIRECTION::STREAM_SEEK_SET);
+		Framework::CZipArchiveReader stateArchive(stateStream);
+
+		auto baseStateStream = Framework::CreateInputStdStream(baseStatePath.native());
+		Framework::CZipArchiveReader baseStateArchive(baseStateStream);
+		if(CDeltaState::IsDeltaState(baseStateArchive))
+		{
+			CLog::GetInstance().Warn(LOG_NAME, "Base state '%s' is a delta state, cannot save a delta from it.\r\n", baseStatePath.string().c_str());
+			return false;
+		}
+
+		auto deltaStateStream = Framework::CreateOutputStdStream(statePath.native());
+		CDeltaState::Write(deltaStateStream, stateArchive, baseStateArchive, baseStatePath.filename().string());
 	}
 	catch(...)
 	{
@@ -446,34 +585,211 @@ bool CPS2VM::SaveVMState(const fs::path& statePath)
 	return true;
 }
 
-bool CPS2VM::LoadVMState(const fs::path& statePath)
+//Delta states made from a state that's about to be overwritten couldn't be loaded anymore, turn them into regular states
+void CPS2VM::RebuildDeltaStates(const fs::path& baseStatePath)
+{
+	auto baseStateName = baseStatePath.filename().string();
+	for(const auto& entry : fs::directory_iterator(baseStatePath.parent_path()))
+	{
+		const auto& statePath = entry.path();
+		if((statePath == baseStatePath) || (statePath.extension() != ".zip")) continue;
+		try
+		{
+			Framework::CMemStream rebuiltStateStream;
+			{
+				auto stateStream = Framework::CreateInputStdStream(statePath.native());
+				Framework::CZipArchiveReader stateArchive(stateStream);
+				if(!CDeltaState::IsDeltaState(stateArchive)) continue;
+				if(CDeltaState::GetBaseStateName(stateArchive) != baseStateName) continue;
+
+				auto baseStateStream = Framework::CreateInputStdStream(baseStatePath.native());
+				Framework::CZipArchiveReader baseStateArchive(baseStateStream);
+				CDeltaState::Rebuild(rebuiltStateStream, stateArchive, baseStateArchive);
+			}
+			auto rebuiltStateFileStream = Framework::CreateOutputStdStream(statePath.native());
+			rebuiltStateFileStream.Write(rebuiltStateStream.GetBuffer(), rebuiltStateStream.GetSize());
+			CLog::GetInstance().Print(LOG_NAME, "Rebuilt delta state '%s' before its base state is overwritten.\r\n", statePath.string().c_str());
+		}
+		catch(...)
+		{
+			CLog::GetInstance().Warn(LOG_NAME, "Failed to rebuild delta state '%s', it won't be loadable anymore.\r\n", statePath.string().c_str());
+		}
+	}
+}
+
+CPS2VM::LOAD_STATE_RESULT CPS2VM::LoadVMState(const fs::path& statePath)
 {
 	if(m_ee->m_gs == NULL)
 	{
 		printf("PS2VM: GS Handler was not instancied. Cannot load state.\r\n");
-		return false;
+		return LOAD_STATE_RESULT::FAILED;
 	}
 
+	//Saves that are still being written must be done before their files can be read
+	m_stateMailBox.FlushCalls();
+
+	auto startTime = std::chrono::steady_clock::now();
+
 	try
 	{
 		auto stateStream = Framework::CreateInputStdStream(statePath.native());
 		Framework::CZipArchiveReader archive(stateStream);
 
-		try
+		if(CDeltaState::IsDeltaState(archive))
 		{
-			m_ee->LoadState(archive);
-			m_iop->LoadState(archive);
-			m_ee->m_gs->LoadState(archive);
+			auto baseStatePath = statePath.parent_path() / fs::path(CDeltaState::GetBaseStateName(archive));
+			if(!fs::exists(baseStatePath))
+			{
+				CLog::GetInstance().Warn(LOG_NAME, "Base state '%s' of delta state is missing.\r\n", baseStatePath.string().c_str());
+				return LOAD_STATE_RESULT::BASE_STATE_CHANGED;
+			}
+			auto baseStateStream = Framework::CreateInputStdStream(baseStatePath.native());
+			Framework::CZipArchiveReader baseStateArchive(baseStateStream);
+
+			Framework::CMemStream rebuiltStateStream;
+			CDeltaState::Rebuild(rebuiltStateStream, archive, baseStateArchive);
+			rebuiltStateStream.Seek(0, Framework::STREAM_SEEK_DIRECTION::STREAM_SEEK_SET);
+			Framework::CZipArchiveReader rebuiltStateArchive(rebuiltStateStream);
+
+			LoadVMState(rebuiltStateArchive);
 		}
-		catch(...)
+		else
 		{
-			//Any error that occurs in the previous block is critical
-			PauseImpl();
-			throw;
+			LoadVMState(archive);
 		}
 	}
+	catch(const CDeltaState::CBaseStateMismatchException&)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Base state of delta state '%s' changed since it was saved.\r\n", statePath.string().c_str());
+		return LOAD_STATE_RESULT::BASE_STATE_CHANGED;
+	}
 	catch(...)
 	{
+		return LOAD_STATE_RESULT::FAILED;
+	}
+
+	{
+		std::lock_guard<std::mutex> stateLatencyLock(m_stateLatencyMutex);
+		m_stateLatency.lastLoadTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	//Snapshots taken before loading don't belong to this state's history
+	ResetRewindBuffer();
+
+	OnMachineStateChange();
+
+	return LOAD_STATE_RESULT::SUCCEEDED;
+}
+
+void CPS2VM::LoadVMState(Framework::CZipArchiveReader& archive, bool includeRam)
+{
+	try
+	{
+		m_ee->LoadState(archive, includeRam);
+		m_iop->LoadState(archive, includeRam);
+		m_ee->m_gs->LoadState(archive, includeRam);
+	}
+	catch(...)
+	{
+		//Any error that occurs in the previous block is critical
+		PauseImpl();
+		throw;
+	}
+}
+
+CRewindBuffer::MemoryRegionArray CPS2VM::GetRewindMemoryRegions() const
+{
+	//Writes to EE RAM are caught by the EE executor, other regions are small enough to be compared
+	auto eeExecutor = static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get());
+	CRewindBuffer::MemoryRegionArray regions;
+	regions.push_back({m_ee->m_ram, PS2::EE_RAM_SIZE,
+	                   [eeExecutor](uint32 pageIndex) { return eeExecutor->IsPageWritten(pageIndex * CRewindBuffer::PAGE_SIZE); }});
+	regions.push_back({m_iop->m_ram, PS2::IOP_RAM_SIZE});
+	regions.push_back({m_iop->m_spuRam, PS2::SPU_RAM_SIZE});
+	regions.push_back({m_ee->m_gs->GetRam(), CGSHandler::RAMSIZE});
+	return regions;
+}
+
+void CPS2VM::ResetRewindBuffer()
+{
+	auto eeExecutor = static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get());
+	if(!m_rewindEnabled || (m_ee->m_gs == NULL))
+	{
+		eeExecutor->SetWriteTrackingEnabled(false);
+		m_rewindBuffer.Clear();
+		return;
+	}
+	//Memory is copied once here, captures then only go through the pages written since the previous one.
+	//Writes aren't tracked if this isn't done on the emulation thread, the next capture compares every page then.
+	m_rewindBuffer.Reset(GetRewindMemoryRegions());
+	eeExecutor->SetWriteTrackingEnabled(true);
+}
+
+void CPS2VM::CaptureRewindSnapshot()
+{
+	//Only the memory pages that were written are compared and copied here, encoding is done on the state thread
+	auto startTime = std::chrono::steady_clock::now();
+	auto archive = SaveVMState(false);
+	if(!archive) return;
+	auto snapshot = m_rewindBuffer.Capture(GetRewindMemoryRegions());
+	//Memory matches the newest snapshot, next capture only needs to look at pages written after this
+	static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get())->SetWriteTrackingEnabled(true);
+	float captureTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+	m_stateMailBox.SendCall(
+	    [this, archive, snapshot, captureTime]() {
+		    try
+		    {
+			    Framework::CMemStream stateStream;
+			    archive->Write(stateStream);
+			    m_rewindBuffer.Encode(snapshot, CRewindBuffer::StateData(stateStream.GetBuffer(), stateStream.GetBuffer() + stateStream.GetSize()));
+		    }
+		    catch(const std::exception& exception)
+		    {
+			    //Snapshot can't be restored without its state
+			    m_rewindBuffer.Discard(snapshot);
+			    CLog::GetInstance().Warn(LOG_NAME, "Failed to encode rewind snapshot: %s.\r\n", exception.what());
+			    return;
+		    }
+		    std::lock_guard<std::mutex> stateLatencyLock(m_stateLatencyMutex);
+		    m_stateLatency.lastRewindCaptureTime = captureTime;
+	    });
+}
+
+bool CPS2VM::RewindImpl()
+{
+	if(m_ee->m_gs == NULL) return false;
+
+	//Snapshots are complete once the state thread has encoded them
+	m_stateMailBox.FlushCalls();
+
+	//Memory is restored before the rest of the state, the IOP BIOS rebuilds parts of its state from RAM.
+	//Threads working with memory must be done and the EE executor mustn't keep blocks compiled from old code.
+	m_ee->m_vpu1->Sync();
+	m_iop->m_spuRenderThread.Sync();
+	m_ee->m_EE.m_executor->Reset();
+
+	try
+	{
+		CRewindBuffer::StateData state;
+		if(!m_rewindBuffer.Restore(GetRewindMemoryRegions(), state))
+		{
+			return false;
+		}
+		static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get())->SetWriteTrackingEnabled(true);
+
+		Framework::CMemStream stateStream;
+		stateStream.Write(state.data(), state.size());
+		stateStream.Seek(0, Framework::STREAM_SEEK_DIRECTION::STREAM_SEEK_SET);
+		Framework::CZipArchiveReader archive(stateStream);
+		LoadVMState(archive, false);
+	}
+	catch(const std::exception& exception)
+	{
+		//Memory might have been overwritten already, the machine can't keep running
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to rewind: %s.\r\n", exception.what());
+		ResetRewindBuffer();
+		PauseImpl();
 		return false;
 	}
 
@@ -499,6 +815,7 @@ void CPS2VM::ResumeImpl()
 
 void CPS2VM::DestroyImpl()
 {
+	CloseBlockCaches();
 	DestroyGsHandlerImpl();
 	DestroyPadHandlerImpl();
 	DestroySoundHandlerImpl();
@@ -560,7 +877,13 @@ void CPS2VM::DestroySoundHandlerImpl()
 
 void CPS2VM::OnGsNewFrame()
 {
-#ifdef DEBUGGER_INCLUDED
+	//Called on the GS thread, the snapshot is captured on the emulation thread before the next slice
+	if(m_rewindEnabled && (++m_rewindFrameCount >= m_rewindInterval))
+	{
+		m_rewindFrameCount = 0;
+		m_mailBox.SendCall(std::bind(&CPS2VM::CaptureRewindSnapshot, this));
+	}
+
 	std::unique_lock<std::mutex> dumpFrameCallbackMutexLock(m_frameDumpCallbackMutex);
 	if(m_dumpingFrame && !m_frameDump.GetPackets().empty())
 	{
@@ -578,7 +901,6 @@ void CPS2VM::OnGsNewFrame()
 		m_ee->m_gs->SetFrameDump(&m_frameDump);
 		m_dumpingFrame = true;
 	}
-#endif
 }
 
 void CPS2VM::UpdateEe()
@@ -606,7 +928,7 @@ void CPS2VM::UpdateEe()
 
 		m_eeExecutionTicks -= executed;
 		m_ee->CountTicks(executed);
-		m_vblankTicks -= executed;
+		m_scheduler.AdvanceTime(executed);
 
 #ifdef DEBUGGER_INCLUDED
 		if(m_singleStepEe) break;
@@ -636,7 +958,6 @@ void CPS2VM::UpdateIop()
 #endif
 
 		m_iopExecutionTicks -= executed;
-		m_spuUpdateTicks -= executed;
 		m_iop->CountTicks(executed);
 
 #ifdef DEBUGGER_INCLUDED
@@ -646,44 +967,109 @@ void CPS2VM::UpdateIop()
 	}
 }
 
-void CPS2VM::UpdateSpu()
+int CPS2VM::GetExecutionSliceTicks()
+{
+	//Slices of the loop used before the scheduler, kept to compare profiles with
+	if(m_fixedSlicesEnabled) return MAX_SLICE_TICKS;
+
+	//Run until the next scheduled event, without going over the longest slice
+	int64 sliceTicks = std::min<int64>(MAX_SLICE_TICKS, m_scheduler.GetTicksUntilNextEvent());
+
+	//Timer registers are written all the time, they're polled for their next interrupt instead of
+	//being scheduled. Very short timer periods are bounded to keep the slice overhead in check.
+	int64 timerTicks = m_ee->m_timer.GetTicksUntilNextInterrupt();
+	int64 counterTicks = static_cast<int64>(m_iop->m_counters.GetTicksUntilNextInterrupt()) * 8;
+	int64 timerSliceTicks = std::max<int64>(std::min(timerTicks, counterTicks), MIN_TIMER_SLICE_TICKS);
+	sliceTicks = std::min(sliceTicks, timerSliceTicks);
+
+	return static_cast<int>(std::max<int64>(sliceTicks, 1));
+}
+
+void CPS2VM::OnVBlankStart(int64 lateTicks)
 {
+	m_scheduler.Schedule(m_vblankEndEvent, VBLANK_TICKS - lateTicks);
+
+	m_ee->NotifyVBlankStart();
+	m_iop->NotifyVBlankStart();
+
+	if(m_ee->m_gs != NULL)
+	{
 #ifdef PROFILE
-	CProfilerZone profilerZone(m_spuProfilerZone);
+		CProfilerZone profilerZone(m_gsSyncProfilerZone);
 #endif
+		m_ee->m_gs->SetVBlank();
+	}
 
-	unsigned int blockOffset = (BLOCK_SIZE * m_currentSpuBlock);
-	int16* samplesSpu0 = m_samples + blockOffset;
+	if(m_pad != NULL)
+	{
+		m_pad->Update(m_ee->m_ram);
+	}
+#ifdef PROFILE
+	{
+		CProfiler::GetInstance().CountCurrentZone();
+		auto stats = CProfiler::GetInstance().GetStats();
+		ProfileFrameDone(stats);
+		CProfiler::GetInstance().Reset();
+	}
 
-	m_iop->m_spuCore0.Render(samplesSpu0, BLOCK_SIZE, DST_SAMPLE_RATE);
+	m_cpuUtilisation = CPU_UTILISATION_INFO();
+#endif
+}
+
+void CPS2VM::OnVBlankEnd(int64 lateTicks)
+{
+	m_scheduler.Schedule(m_vblankStartEvent, ONSCREEN_TICKS - lateTicks);
 
-	if(m_iop->m_spuCore1.IsEnabled())
+	m_ee->NotifyVBlankEnd();
+	m_iop->NotifyVBlankEnd();
+	if(m_ee->m_gs != NULL)
 	{
-		int16 samplesSpu1[BLOCK_SIZE];
-		m_iop->m_spuCore1.Render(samplesSpu1, BLOCK_SIZE, DST_SAMPLE_RATE);
+		m_ee->m_gs->ResetVBlank();
+	}
+}
 
-		for(unsigned int i = 0; i < BLOCK_SIZE; i++)
-		{
-			int32 resultSample = static_cast<int32>(samplesSpu0[i]) + static_cast<int32>(samplesSpu1[i]);
-			resultSample = std::max<int32>(resultSample, SHRT_MIN);
-			resultSample = std::min<int32>(resultSample, SHRT_MAX);
-			samplesSpu0[i] = static_cast<int16>(resultSample);
-		}
+void CPS2VM::OnSpuUpdate(int64 lateTicks)
+{
+	m_scheduler.Schedule(m_spuUpdateEvent, SPU_UPDATE_TICKS - lateTicks);
+	UpdateSpu();
+}
+
+void CPS2VM::UpdateSpu()
+{
+#ifdef PROFILE
+	CProfilerZone profilerZone(m_spuProfilerZone);
+#endif
+
+	auto& spuRenderThread = m_iop->m_spuRenderThread;
+
+	if(m_currentSpuBlock == m_spuBlockCount)
+	{
+		//Last block of the buffer was rendered on the SPU thread, it's complete once synced
+		spuRenderThread.Sync();
+		WriteSpuSamples();
 	}
 
+	unsigned int blockOffset = (BLOCK_SIZE * m_currentSpuBlock);
+	spuRenderThread.Render(m_samples + blockOffset, BLOCK_SIZE, DST_SAMPLE_RATE);
+
 	m_currentSpuBlock++;
-	if(m_currentSpuBlock == m_spuBlockCount)
+	if((m_currentSpuBlock == m_spuBlockCount) && !spuRenderThread.IsRendering())
 	{
-		if(m_soundHandler)
+		WriteSpuSamples();
+	}
+}
+
+void CPS2VM::WriteSpuSamples()
+{
+	if(m_soundHandler)
+	{
+		if(m_soundHandler->HasFreeBuffers())
 		{
-			if(m_soundHandler->HasFreeBuffers())
-			{
-				m_soundHandler->RecycleBuffers();
-			}
-			m_soundHandler->Write(m_samples, BLOCK_SIZE * m_spuBlockCount, DST_SAMPLE_RATE);
+			m_soundHandler->RecycleBuffers();
 		}
-		m_currentSpuBlock = 0;
+		m_soundHandler->Write(m_samples, BLOCK_SIZE * m_spuBlockCount, DST_SAMPLE_RATE);
 	}
+	m_currentSpuBlock = 0;
 }
 
 void CPS2VM::CDROM0_SyncPath()
@@ -741,6 +1127,43 @@ void CPS2VM::ReloadExecutable(const char* executablePath, const CPS2OS::Argument
 	m_ee->m_os->BootFromVirtualPath(executablePath, arguments);
 }
 
+void CPS2VM::OpenBlockCaches()
+{
+	CloseBlockCaches();
+
+	if(!CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_BLOCKCACHE_ENABLED)) return;
+
+	const std::pair<const char*, CMIPS*> cacheTargets[] =
+	    {
+	        std::make_pair("ee", &m_ee->m_EE),
+	        std::make_pair("vu0", &m_ee->m_VU0),
+	        std::make_pair("vu1", &m_ee->m_VU1),
+	        std::make_pair("iop", &m_iop->m_cpu),
+	    };
+
+	auto cacheDirectoryPath = GetBlockCacheDirectoryPath();
+	Framework::PathUtils::EnsurePathExists(cacheDirectoryPath);
+
+	for(const auto& cacheTarget : cacheTargets)
+	{
+		auto cacheFileName = string_format("%s.%s.blockcache", m_ee->m_os->GetExecutableName(), cacheTarget.first);
+		auto blockCache = std::make_shared<CBlockCache>(cacheDirectoryPath / fs::path(cacheFileName));
+		auto context = cacheTarget.second;
+		context->m_executor->SetBlockCache(blockCache);
+		m_blockCaches.push_back(std::make_pair(context, blockCache));
+	}
+}
+
+void CPS2VM::CloseBlockCaches()
+{
+	for(auto& blockCacheBinding : m_blockCaches)
+	{
+		blockCacheBinding.first->m_executor->SetBlockCache(CMipsExecutor::BlockCachePtr());
+		blockCacheBinding.second->Save();
+	}
+	m_blockCaches.clear();
+}
+
 void CPS2VM::EmuThread()
 {
 	fesetround(FE_TOWARDZERO);
@@ -763,67 +1186,27 @@ void CPS2VM::EmuThread()
 		}
 		if(m_nStatus == RUNNING)
 		{
-			if(m_spuUpdateTicks <= 0)
+			int sliceTicks = 0;
 			{
-				UpdateSpu();
-				m_spuUpdateTicks += SPU_UPDATE_TICKS;
-			}
-
-			//EE execution
-			{
-				//Check vblank stuff
-				if(m_vblankTicks <= 0)
-				{
-					m_inVblank = !m_inVblank;
-					if(m_inVblank)
-					{
-						m_vblankTicks += VBLANK_TICKS;
-						m_ee->NotifyVBlankStart();
-						m_iop->NotifyVBlankStart();
-
-						if(m_ee->m_gs != NULL)
-						{
 #ifdef PROFILE
-							CProfilerZone profilerZone(m_gsSyncProfilerZone);
+				CProfilerZone schedulerProfilerZone(m_schedulerProfilerZone);
 #endif
-							m_ee->m_gs->SetVBlank();
-						}
+				//Vblank and SPU updates
+				m_scheduler.ProcessEvents();
+				sliceTicks = GetExecutionSliceTicks();
+			}
 
-						if(m_pad != NULL)
-						{
-							m_pad->Update(m_ee->m_ram);
-						}
+			//EE CPU is 8 times faster than the IOP CPU
+			m_eeExecutionTicks += sliceTicks;
+			m_iopSliceTicksRemain += sliceTicks;
+			m_iopExecutionTicks += m_iopSliceTicksRemain / 8;
+			m_iopSliceTicksRemain %= 8;
 #ifdef PROFILE
-						{
-							CProfiler::GetInstance().CountCurrentZone();
-							auto stats = CProfiler::GetInstance().GetStats();
-							ProfileFrameDone(stats);
-							CProfiler::GetInstance().Reset();
-						}
-
-						m_cpuUtilisation = CPU_UTILISATION_INFO();
+			m_cpuUtilisation.sliceCount++;
 #endif
-					}
-					else
-					{
-						m_vblankTicks += ONSCREEN_TICKS;
-						m_ee->NotifyVBlankEnd();
-						m_iop->NotifyVBlankEnd();
-						if(m_ee->m_gs != NULL)
-						{
-							m_ee->m_gs->ResetVBlank();
-						}
-					}
-				}
-
-				//EE CPU is 8 times faster than the IOP CPU
-				static const int tickStep = 4800;
-				m_eeExecutionTicks += tickStep;
-				m_iopExecutionTicks += tickStep / 8;
-
-				UpdateEe();
-				UpdateIop();
-			}
+
+			UpdateEe();
+			UpdateIop();
 #ifdef DEBUGGER_INCLUDED
 			if(
 			    m_ee->m_EE.m_executor->MustBreak() ||
@@ -844,3 +1227,15 @@ void CPS2VM::EmuThread()
 	}
 	static_cast<CEeExecutor*>(m_ee->m_EE.m_executor.get())->RemoveExceptionHandler();
 }
+
+void CPS2VM::StateThread()
+{
+	while(!m_stateThreadEnd)
+	{
+		m_stateMailBox.WaitForCall();
+		while(m_stateMailBox.IsPending())
+		{
+			m_stateMailBox.ReceiveCall();
+		}
+	}
+}
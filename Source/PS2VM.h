@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <thread>
 #include <future>
 #include "filesystem_def.h"
@@ -14,6 +15,8 @@
 #include "iop/Iop_SubSystem.h"
 #include "../tools/PsfPlayer/Source/SoundHandler.h"
 #include "FrameDump.h"
+#include "states/RewindBuffer.h"
+#include "EventScheduler.h"
 #include "Profiler.h"
 
 class CPS2VM : public CVirtualMachine
@@ -26,6 +29,25 @@ public:
 
 		int32 iopTotalTicks = 0;
 		int32 iopIdleTicks = 0;
+
+		int32 sliceCount = 0;
+	};
+
+	//Times are in milliseconds
+	struct STATE_LATENCY_INFO
+	{
+		float lastSaveStagingTime = 0;
+		float lastSaveTime = 0;
+		float lastLoadTime = 0;
+		float lastRewindCaptureTime = 0;
+	};
+
+	enum class LOAD_STATE_RESULT
+	{
+		SUCCEEDED,
+		FAILED,
+		//Base state of a delta state changed or went away since the delta state was saved
+		BASE_STATE_CHANGED,
 	};
 
 	typedef std::unique_ptr<Ee::CSubSystem> EeSubSystemPtr;
@@ -67,14 +89,24 @@ public:
 	void ReloadSpuBlockCount();
 
 	static fs::path GetStateDirectoryPath();
+	static fs::path GetBlockCacheDirectoryPath();
 	fs::path GenerateStatePath(unsigned int) const;
 
-	std::future<bool> SaveState(const fs::path&);
-	std::future<bool> LoadState(const fs::path&);
+	//The emulation is only stopped while the state is copied, it's compressed and written on another thread.
+	//With a base state, only the memory pages that changed since that state are saved. The base state must be
+	//a regular state and stay in the same directory for the delta state to be loadable. Delta states made from
+	//a state that gets overwritten are rebuilt into regular states beforehand.
+	std::future<bool> SaveState(const fs::path&, const fs::path& = fs::path());
+	std::future<LOAD_STATE_RESULT> LoadState(const fs::path&);
+
+	//When enabled, snapshots are captured every few frames and kept in memory. Rewinding restores the newest
+	//snapshot and drops it, the next call goes back to the one before.
+	std::future<bool> Rewind();
 
 	void TriggerFrameDump(const FrameDumpCallback&);
 
 	CPU_UTILISATION_INFO GetCpuUtilisationInfo() const;
+	STATE_LATENCY_INFO GetStateLatencyInfo() const;
 
 #ifdef DEBUGGER_INCLUDED
 	std::string MakeDebugTagsPackagePath(const char*);
@@ -91,15 +123,27 @@ public:
 
 private:
 	typedef std::unique_ptr<COpticalMedia> OpticalMediaPtr;
+	typedef std::shared_ptr<Framework::CZipArchiveWriter> ZipArchiveWriterPtr;
 
 	void CreateVM();
 	void ResetVM();
 	void DestroyVM();
-	bool SaveVMState(const fs::path&);
-	bool LoadVMState(const fs::path&);
+	ZipArchiveWriterPtr SaveVMState(bool = true);
+	bool WriteVMState(Framework::CZipArchiveWriter&, const fs::path&, const fs::path&);
+	void RebuildDeltaStates(const fs::path&);
+	LOAD_STATE_RESULT LoadVMState(const fs::path&);
+	void LoadVMState(Framework::CZipArchiveReader&, bool = true);
+
+	CRewindBuffer::MemoryRegionArray GetRewindMemoryRegions() const;
+	void ResetRewindBuffer();
+	void CaptureRewindSnapshot();
+	bool RewindImpl();
 
 	void ReloadExecutable(const char*, const CPS2OS::ArgumentList&);
 
+	void OpenBlockCaches();
+	void CloseBlockCaches();
+
 	void ResumeImpl();
 	void PauseImpl();
 	void DestroyImpl();
@@ -117,6 +161,12 @@ private:
 	void UpdateIop();
 	void UpdateSpu();
 
+	int GetExecutionSliceTicks();
+	void OnVBlankStart(int64);
+	void OnVBlankEnd(int64);
+	void OnSpuUpdate(int64);
+	void WriteSpuSamples();
+
 	void OnGsNewFrame();
 
 	void CDROM0_SyncPath();
@@ -126,17 +176,39 @@ private:
 	void RegisterModulesInPadHandler();
 
 	void EmuThread();
+	void StateThread();
 
 	std::thread m_thread;
 	CMailBox m_mailBox;
 	STATUS m_nStatus;
 	bool m_nEnd;
 
-	int m_vblankTicks = 0;
-	bool m_inVblank = 0;
-	int m_spuUpdateTicks = 0;
+	std::thread m_stateThread;
+	CMailBox m_stateMailBox;
+	bool m_stateThreadEnd = false;
+	STATE_LATENCY_INFO m_stateLatency;
+	mutable std::mutex m_stateLatencyMutex;
+
+	CRewindBuffer m_rewindBuffer;
+	//Read on the GS thread
+	std::atomic<bool> m_rewindEnabled = {false};
+	std::atomic<uint32> m_rewindInterval = {1};
+	uint32 m_rewindFrameCount = 0;
+
+	enum
+	{
+		MAX_SLICE_TICKS = 4800,
+		MIN_TIMER_SLICE_TICKS = 480,
+	};
+
+	CEventScheduler m_scheduler;
+	CEventScheduler::EventId m_vblankStartEvent = 0;
+	CEventScheduler::EventId m_vblankEndEvent = 0;
+	CEventScheduler::EventId m_spuUpdateEvent = 0;
 	int m_eeExecutionTicks = 0;
 	int m_iopExecutionTicks = 0;
+	int m_iopSliceTicksRemain = 0;
+	bool m_fixedSlicesEnabled = false;
 
 	CPU_UTILISATION_INFO m_cpuUtilisation;
 
@@ -152,12 +224,15 @@ private:
 
 	OpticalMediaPtr m_cdrom0;
 
+	typedef std::pair<CMIPS*, CMipsExecutor::BlockCachePtr> BlockCacheBinding;
+	std::vector<BlockCacheBinding> m_blockCaches;
+
 	//SPU update parameters
 	enum
 	{
 		DST_SAMPLE_RATE = 44100,
 		UPDATE_RATE = 1000, //Number of SPU updates per second (on PS2 time scale)
-		SPU_UPDATE_TICKS = PS2::IOP_CLOCK_OVER_FREQ / UPDATE_RATE,
+		SPU_UPDATE_TICKS = PS2::EE_CLOCK_FREQ / UPDATE_RATE, //In EE ticks
 		SAMPLE_COUNT = DST_SAMPLE_RATE / UPDATE_RATE,
 		BLOCK_SIZE = SAMPLE_COUNT * 2,
 		BLOCK_COUNT = 400,
@@ -173,7 +248,10 @@ private:
 	CProfiler::ZoneHandle m_spuProfilerZone = 0;
 	CProfiler::ZoneHandle m_gsSyncProfilerZone = 0;
 	CProfiler::ZoneHandle m_otherProfilerZone = 0;
+	CProfiler::ZoneHandle m_schedulerProfilerZone = 0;
 
 	CPS2OS::RequestLoadExecutableEvent::Connection m_OnRequestLoadExecutableConnection;
+	Framework::CSignal<void()>::Connection m_OnExecutableChangeConnection;
+	Framework::CSignal<void()>::Connection m_OnExecutableUnloadingConnection;
 	Framework::CSignal<void(uint32)>::Connection m_OnNewFrameConnection;
 };
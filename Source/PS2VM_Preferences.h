@@ -6,4 +6,16 @@
 #define PREF_PS2_MC0_DIRECTORY ("ps2.mc0.directory.v2")
 #define PREF_PS2_MC1_DIRECTORY ("ps2.mc1.directory.v2")
 
+#define PREF_PS2_BLOCKCACHE_ENABLED ("ps2.blockcache.enabled")
+#define PREF_PS2_BACKGROUNDCOMPILE_ENABLED ("ps2.backgroundcompile.enabled")
+#define PREF_PS2_TIEREDCOMPILE_ENABLED ("ps2.tieredcompile.enabled")
+#define PREF_PS2_FINEGRAINEDINVALIDATION_ENABLED ("ps2.finegrainedinvalidation.enabled")
+#define PREF_PS2_THREADEDVU1_ENABLED ("ps2.threadedvu1.enabled")
+#define PREF_PS2_FIXEDSLICES_ENABLED ("ps2.fixedslices.enabled")
+
+#define PREF_PS2_REWIND_ENABLED ("ps2.rewind.enabled")
+#define PREF_PS2_REWIND_INTERVAL ("ps2.rewind.interval")
+#define PREF_PS2_REWIND_MEMORYBUDGET ("ps2.rewind.memorybudget")
+
 #define PREF_AUDIO_SPUBLOCKCOUNT ("audio.spublockcount")
+#define PREF_AUDIO_SPUTHREAD_ENABLED ("audio.sputhread.enabled")
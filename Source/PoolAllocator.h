@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+//Allocator that keeps memory of freed objects around to be reused by later allocations
+//Meant to be used with std::allocate_shared for objects that are created and destroyed often.
+//Allocations of more than one object go straight to the global allocator.
+template <typename Type>
+class CPoolAllocator
+{
+public:
+	typedef Type value_type;
+
+	enum
+	{
+		MAX_FREE_ITEMS = 0x4000,
+	};
+
+	CPoolAllocator() = default;
+
+	template <typename OtherType>
+	CPoolAllocator(const CPoolAllocator<OtherType>&)
+	{
+	}
+
+	Type* allocate(size_t count)
+	{
+		if(count == 1)
+		{
+			auto& pool = GetPool();
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if(!pool.freeItems.empty())
+			{
+				void* item = pool.freeItems.back();
+				pool.freeItems.pop_back();
+				return static_cast<Type*>(item);
+			}
+		}
+		return static_cast<Type*>(::operator new(count * sizeof(Type)));
+	}
+
+	void deallocate(Type* item, size_t count)
+	{
+		if(count == 1)
+		{
+			auto& pool = GetPool();
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			if(pool.freeItems.size() < MAX_FREE_ITEMS)
+			{
+				pool.freeItems.push_back(item);
+				return;
+			}
+		}
+		::operator delete(item);
+	}
+
+	template <typename OtherType>
+	bool operator==(const CPoolAllocator<OtherType>&) const
+	{
+		return true;
+	}
+
+	template <typename OtherType>
+	bool operator!=(const CPoolAllocator<OtherType>&) const
+	{
+		return false;
+	}
+
+private:
+	struct POOL
+	{
+		std::mutex mutex;
+		std::vector<void*> freeItems;
+	};
+
+	static POOL& GetPool()
+	{
+		//Never destroyed since objects can be released after static destructors have run
+		static auto pool = new POOL();
+		return *pool;
+	}
+};
@@ -0,0 +1,353 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include "SectorCacheStream.h"
+#include "Log.h"
+
+#define LOG_NAME ("sectorcache")
+
+double CSectorCacheStream::STATS::GetHitRate() const
+{
+	uint64 totalCount = hitCount + missCount;
+	return (totalCount == 0) ? 0 : static_cast<double>(hitCount) / static_cast<double>(totalCount);
+}
+
+CSectorCacheStream::CSectorCacheStream(const StreamPtr& baseStream, uint32 cacheSectorCount)
+    : m_baseStream(baseStream)
+{
+	if(!m_baseStream)
+	{
+		throw std::runtime_error("Null base stream supplied.");
+	}
+
+	m_length = m_baseStream->GetLength();
+	m_sectorCount = static_cast<uint32>((m_length + SECTOR_SIZE - 1) / SECTOR_SIZE);
+
+	cacheSectorCount = std::max<uint32>(cacheSectorCount, MAX_BATCH_SECTOR_COUNT + READAHEAD_SECTOR_COUNT);
+	m_cacheData.resize(static_cast<size_t>(cacheSectorCount) * SECTOR_SIZE);
+	m_slots.resize(cacheSectorCount);
+	for(uint32 i = 0; i < cacheSectorCount; i++)
+	{
+		LinkFront(i);
+	}
+	m_sectorMap.reserve(cacheSectorCount);
+
+	m_readBuffer.resize(MAX_BATCH_SECTOR_COUNT * SECTOR_SIZE);
+	m_readAheadBuffer.resize(READAHEAD_CHUNK_SECTOR_COUNT * SECTOR_SIZE);
+
+	m_thread = std::thread([this]() { ThreadProc(); });
+}
+
+CSectorCacheStream::~CSectorCacheStream()
+{
+	{
+		std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+		m_threadDone = true;
+		m_requestCondition.notify_one();
+	}
+	m_thread.join();
+
+	CLog::GetInstance().Print(LOG_NAME, "%llu hits, %llu misses (%.1f%% hit rate), %llu readahead hits, %llu stalls (%llu us), %llu sectors read ahead, %llu readaheads cancelled, %llu base reads.\r\n",
+	                          m_stats.hitCount, m_stats.missCount, m_stats.GetHitRate() * 100.0, m_stats.readAheadHitCount, m_stats.stallCount,
+	                          m_stats.stallTime, m_stats.readAheadCount, m_stats.cancelCount, m_stats.baseReadCount);
+}
+
+void CSectorCacheStream::Seek(int64 position, Framework::STREAM_SEEK_DIRECTION origin)
+{
+	switch(origin)
+	{
+	case Framework::STREAM_SEEK_CUR:
+		m_position += position;
+		break;
+	case Framework::STREAM_SEEK_SET:
+		m_position = position;
+		break;
+	case Framework::STREAM_SEEK_END:
+		m_position = m_length + position;
+		break;
+	}
+	m_isEof = false;
+}
+
+uint64 CSectorCacheStream::Tell()
+{
+	return m_position;
+}
+
+bool CSectorCacheStream::IsEOF()
+{
+	return m_isEof;
+}
+
+uint64 CSectorCacheStream::Read(void* buffer, uint64 size)
+{
+	if(m_position >= m_length)
+	{
+		m_isEof = true;
+		return 0;
+	}
+
+	size = std::min<uint64>(size, m_length - m_position);
+	auto dest = reinterpret_cast<uint8*>(buffer);
+	uint64 remaining = size;
+
+	uint32 readStart = static_cast<uint32>(m_position / SECTOR_SIZE);
+	uint32 readEnd = static_cast<uint32>((m_position + size + SECTOR_SIZE - 1) / SECTOR_SIZE);
+	{
+		std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+		UpdateReadAhead(readStart, readEnd);
+	}
+
+	while(remaining != 0)
+	{
+		uint32 sector = static_cast<uint32>(m_position / SECTOR_SIZE);
+		uint32 offset = static_cast<uint32>(m_position % SECTOR_SIZE);
+		uint32 batchCount = 0;
+
+		{
+			std::unique_lock<std::mutex> cacheLock(m_cacheMutex);
+			uint32 copySize = static_cast<uint32>(std::min<uint64>(remaining, SECTOR_SIZE - offset));
+			if(CopyFromCache(sector, offset, dest, copySize))
+			{
+				m_stats.hitCount++;
+				m_position += copySize;
+				dest += copySize;
+				remaining -= copySize;
+				continue;
+			}
+			if(IsSectorPending(sector))
+			{
+				auto stallStartTime = std::chrono::steady_clock::now();
+				m_pendingCondition.wait(cacheLock, [&]() { return !IsSectorPending(sector); });
+				m_stats.stallCount++;
+				m_stats.stallTime += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - stallStartTime).count();
+				continue;
+			}
+			batchCount = CountMissingSectors(sector, std::min<uint32>(readEnd, sector + MAX_BATCH_SECTOR_COUNT));
+		}
+
+		assert(batchCount != 0);
+		std::lock_guard<std::mutex> baseLock(m_baseMutex);
+		ReadBaseSectors(sector, batchCount, m_readBuffer.data());
+
+		{
+			std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+			InsertSectors(sector, batchCount, m_readBuffer.data(), false);
+			m_stats.missCount += batchCount;
+		}
+
+		uint32 copySize = static_cast<uint32>(std::min<uint64>(remaining, (batchCount * SECTOR_SIZE) - offset));
+		memcpy(dest, m_readBuffer.data() + offset, copySize);
+		m_position += copySize;
+		dest += copySize;
+		remaining -= copySize;
+	}
+
+	return size;
+}
+
+uint64 CSectorCacheStream::Write(const void* buffer, uint64 size)
+{
+	throw std::runtime_error("Unable to write to sector cache, read only.");
+}
+
+CSectorCacheStream::STATS CSectorCacheStream::GetStats()
+{
+	std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+	return m_stats;
+}
+
+bool CSectorCacheStream::CopyFromCache(uint32 sector, uint32 offset, uint8* dest, uint32 size)
+{
+	auto sectorIterator = m_sectorMap.find(sector);
+	if(sectorIterator == std::end(m_sectorMap)) return false;
+
+	uint32 slotIndex = sectorIterator->second;
+	auto& slot = m_slots[slotIndex];
+	if(slot.readAhead)
+	{
+		m_stats.readAheadHitCount++;
+		slot.readAhead = false;
+	}
+	memcpy(dest, m_cacheData.data() + (static_cast<size_t>(slotIndex) * SECTOR_SIZE) + offset, size);
+	Unlink(slotIndex);
+	LinkFront(slotIndex);
+	return true;
+}
+
+void CSectorCacheStream::InsertSectors(uint32 firstSector, uint32 count, const uint8* data, bool readAhead)
+{
+	for(uint32 i = 0; i < count; i++)
+	{
+		uint32 sector = firstSector + i;
+		if(m_sectorMap.find(sector) != std::end(m_sectorMap)) continue;
+
+		//Recycle the least recently used slot
+		uint32 slotIndex = m_lruTail;
+		auto& slot = m_slots[slotIndex];
+		if(slot.live)
+		{
+			m_sectorMap.erase(slot.sector);
+		}
+		slot.sector = sector;
+		slot.live = true;
+		slot.readAhead = readAhead;
+		memcpy(m_cacheData.data() + (static_cast<size_t>(slotIndex) * SECTOR_SIZE), data + (i * SECTOR_SIZE), SECTOR_SIZE);
+		m_sectorMap.emplace(sector, slotIndex);
+		Unlink(slotIndex);
+		LinkFront(slotIndex);
+	}
+}
+
+uint32 CSectorCacheStream::CountMissingSectors(uint32 start, uint32 end) const
+{
+	uint32 count = 0;
+	for(uint32 sector = start; sector < end; sector++)
+	{
+		if(m_sectorMap.find(sector) != std::end(m_sectorMap)) break;
+		if(IsSectorPending(sector)) break;
+		count++;
+	}
+	return std::max<uint32>(count, 1);
+}
+
+bool CSectorCacheStream::IsSectorPending(uint32 sector) const
+{
+	return (sector >= m_pendingStart) && (sector < m_pendingEnd);
+}
+
+void CSectorCacheStream::ReadBaseSectors(uint32 firstSector, uint32 count, uint8* buffer)
+{
+	//Must be called with m_baseMutex held
+	uint64 position = static_cast<uint64>(firstSector) * SECTOR_SIZE;
+	uint64 size = std::min<uint64>(static_cast<uint64>(count) * SECTOR_SIZE, m_length - position);
+	m_baseStream->Seek(position, Framework::STREAM_SEEK_SET);
+	uint64 readSize = m_baseStream->Read(buffer, size);
+	//Last sector of the image might be incomplete
+	memset(buffer + readSize, 0, (count * SECTOR_SIZE) - readSize);
+	{
+		std::lock_guard<std::mutex> cacheLock(m_cacheMutex);
+		m_stats.baseReadCount++;
+	}
+}
+
+void CSectorCacheStream::UpdateReadAhead(uint32 readStart, uint32 readEnd)
+{
+	//Must be called with m_cacheMutex held
+	bool sequential = (readStart == m_lastReadEnd) || ((readStart + 1) == m_lastReadEnd);
+	m_lastReadEnd = readEnd;
+	if(!sequential)
+	{
+		//Sectors that were going to be read ahead won't be needed anytime soon
+		CancelReadAhead();
+		m_readAheadEnd = readEnd;
+		return;
+	}
+
+	//Only request more once half of the previous readahead was consumed
+	if(m_readAheadEnd >= (readEnd + (READAHEAD_SECTOR_COUNT / 2))) return;
+
+	uint32 requestStart = std::max<uint32>(readEnd, m_readAheadEnd);
+	uint32 requestEnd = std::min<uint32>(readEnd + READAHEAD_SECTOR_COUNT, m_sectorCount);
+	requestEnd = std::min<uint32>(requestEnd, requestStart + READAHEAD_SECTOR_COUNT);
+	if(requestStart >= requestEnd) return;
+
+	//Previous request might not have been picked up yet, extend it instead of replacing it
+	if(m_requestStart != m_requestEnd)
+	{
+		requestStart = std::min<uint32>(requestStart, m_requestStart);
+	}
+	m_requestStart = requestStart;
+	m_requestEnd = requestEnd;
+	m_readAheadEnd = requestEnd;
+	m_requestCondition.notify_one();
+}
+
+void CSectorCacheStream::CancelReadAhead()
+{
+	//Must be called with m_cacheMutex held
+	bool hasRequest = (m_requestStart != m_requestEnd);
+	bool hasPending = (m_pendingStart != m_pendingEnd);
+	if(!hasRequest && !hasPending) return;
+	m_stats.cancelCount++;
+	m_requestStart = 0;
+	m_requestEnd = 0;
+	//Worker stops after the chunk it's reading
+	m_readAheadCancelled = hasPending;
+}
+
+void CSectorCacheStream::Unlink(uint32 slotIndex)
+{
+	auto& slot = m_slots[slotIndex];
+	((slot.prev != INVALID_SLOT) ? m_slots[slot.prev].next : m_lruHead) = slot.next;
+	((slot.next != INVALID_SLOT) ? m_slots[slot.next].prev : m_lruTail) = slot.prev;
+	slot.prev = INVALID_SLOT;
+	slot.next = INVALID_SLOT;
+}
+
+void CSectorCacheStream::LinkFront(uint32 slotIndex)
+{
+	auto& slot = m_slots[slotIndex];
+	slot.prev = INVALID_SLOT;
+	slot.next = m_lruHead;
+	((m_lruHead != INVALID_SLOT) ? m_slots[m_lruHead].prev : m_lruTail) = slotIndex;
+	m_lruHead = slotIndex;
+}
+
+void CSectorCacheStream::ThreadProc()
+{
+	std::unique_lock<std::mutex> cacheLock(m_cacheMutex);
+	while(1)
+	{
+		m_requestCondition.wait(cacheLock, [this]() { return (m_requestStart != m_requestEnd) || m_threadDone; });
+		if(m_threadDone) break;
+
+		//Skip what's already there
+		uint32 start = m_requestStart;
+		uint32 end = m_requestEnd;
+		m_requestStart = 0;
+		m_requestEnd = 0;
+		while((start < end) && (m_sectorMap.find(start) != std::end(m_sectorMap)))
+		{
+			start++;
+		}
+		if(start == end) continue;
+
+		m_pendingStart = start;
+		m_pendingEnd = end;
+		m_readAheadCancelled = false;
+		while((m_pendingStart != m_pendingEnd) && !m_readAheadCancelled && !m_threadDone)
+		{
+			uint32 chunkStart = m_pendingStart;
+			uint32 count = std::min<uint32>(m_pendingEnd - chunkStart, READAHEAD_CHUNK_SECTOR_COUNT);
+			cacheLock.unlock();
+
+			bool succeeded = true;
+			try
+			{
+				std::lock_guard<std::mutex> baseLock(m_baseMutex);
+				ReadBaseSectors(chunkStart, count, m_readAheadBuffer.data());
+			}
+			catch(const std::exception& exception)
+			{
+				//Reader will retry and get the error itself if there's really something wrong
+				CLog::GetInstance().Warn(LOG_NAME, "Failed to read ahead sectors 0x%X-0x%X: %s\r\n", chunkStart, chunkStart + count, exception.what());
+				succeeded = false;
+			}
+
+			cacheLock.lock();
+			if(!succeeded) break;
+			InsertSectors(chunkStart, count, m_readAheadBuffer.data(), true);
+			m_stats.readAheadCount += count;
+			//Let readers waiting on this chunk go
+			m_pendingStart = chunkStart + count;
+			m_pendingCondition.notify_all();
+		}
+		m_pendingStart = 0;
+		m_pendingEnd = 0;
+		m_readAheadCancelled = false;
+		m_pendingCondition.notify_all();
+	}
+}
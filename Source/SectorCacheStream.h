@@ -0,0 +1,120 @@
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+
+//Read only stream that caches sectors of a disc image stream
+//Recently used sectors are kept in a LRU cache. When reads are sequential, the sectors following
+//the last read are fetched ahead of time by a worker thread, in chunks so that a readahead made
+//useless by a seek can be cancelled. Missing sectors are read from the base stream in batches,
+//the base stream is never accessed by more than one thread at a time.
+class CSectorCacheStream : public Framework::CStream
+{
+public:
+	typedef std::shared_ptr<Framework::CStream> StreamPtr;
+
+	struct STATS
+	{
+		uint64 hitCount = 0;          //Sectors read from the cache
+		uint64 missCount = 0;         //Sectors read from the base stream by the reader
+		uint64 readAheadHitCount = 0; //Sectors read ahead that were used by the reader
+		uint64 stallCount = 0;        //Times the reader waited for a readahead to complete
+		uint64 stallTime = 0;         //Time spent by the reader waiting for readaheads, in microseconds
+		uint64 readAheadCount = 0;    //Sectors read from the base stream by the readahead worker
+		uint64 cancelCount = 0;       //Readaheads dropped because the reader went elsewhere
+		uint64 baseReadCount = 0;     //Read operations done on the base stream
+
+		double GetHitRate() const;
+	};
+
+	enum
+	{
+		SECTOR_SIZE = 0x800,
+		DEFAULT_CACHE_SECTOR_COUNT = 0x1000,
+		READAHEAD_SECTOR_COUNT = 0x80,
+		READAHEAD_CHUNK_SECTOR_COUNT = 0x20,
+		MAX_BATCH_SECTOR_COUNT = 0x80,
+	};
+
+	CSectorCacheStream(const StreamPtr&, uint32 = DEFAULT_CACHE_SECTOR_COUNT);
+	virtual ~CSectorCacheStream();
+
+	void Seek(int64, Framework::STREAM_SEEK_DIRECTION) override;
+	uint64 Tell() override;
+	bool IsEOF() override;
+	uint64 Read(void*, uint64) override;
+	uint64 Write(const void*, uint64) override;
+
+	STATS GetStats();
+
+private:
+	enum : uint32
+	{
+		INVALID_SLOT = ~0U,
+	};
+
+	struct SLOT
+	{
+		uint32 sector = 0;
+		uint32 prev = INVALID_SLOT;
+		uint32 next = INVALID_SLOT;
+		bool live = false;
+		//Read by the readahead worker and not used by the reader yet
+		bool readAhead = false;
+	};
+
+	typedef std::unordered_map<uint32, uint32> SectorMap;
+
+	bool CopyFromCache(uint32, uint32, uint8*, uint32);
+	void InsertSectors(uint32, uint32, const uint8*, bool);
+	uint32 CountMissingSectors(uint32, uint32) const;
+	bool IsSectorPending(uint32) const;
+	void ReadBaseSectors(uint32, uint32, uint8*);
+	void UpdateReadAhead(uint32, uint32);
+	void CancelReadAhead();
+
+	void Unlink(uint32);
+	void LinkFront(uint32);
+
+	void ThreadProc();
+
+	StreamPtr m_baseStream;
+	uint64 m_length = 0;
+	uint32 m_sectorCount = 0;
+	uint64 m_position = 0;
+	bool m_isEof = false;
+
+	//Cache, protected by m_cacheMutex
+	std::mutex m_cacheMutex;
+	std::vector<uint8> m_cacheData;
+	std::vector<SLOT> m_slots;
+	SectorMap m_sectorMap;
+	uint32 m_lruHead = INVALID_SLOT;
+	uint32 m_lruTail = INVALID_SLOT;
+	STATS m_stats;
+
+	//Base stream access, protected by m_baseMutex
+	std::mutex m_baseMutex;
+	std::vector<uint8> m_readBuffer;
+
+	//Sequential read detection and readahead requests, protected by m_cacheMutex
+	uint32 m_lastReadEnd = 0;
+	uint32 m_readAheadEnd = 0;
+	uint32 m_requestStart = 0;
+	uint32 m_requestEnd = 0;
+	uint32 m_pendingStart = 0;
+	uint32 m_pendingEnd = 0;
+	bool m_readAheadCancelled = false;
+	std::vector<uint8> m_readAheadBuffer;
+
+	std::thread m_thread;
+	std::condition_variable m_requestCondition;
+	std::condition_variable m_pendingCondition;
+	bool m_threadDone = false;
+};
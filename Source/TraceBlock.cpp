@@ -0,0 +1,163 @@
+#include <algorithm>
+#include "TraceBlock.h"
+#include "MipsJitter.h"
+#include "offsetof_def.h"
+
+CTraceBlock::CTraceBlock(CMIPS& context, SegmentArray segments, bool isLoop)
+    : CBasicBlock(context, segments.front().begin, GetTraceEnd(segments))
+    , m_segments(std::move(segments))
+    , m_isLoop(isLoop)
+{
+}
+
+const CTraceBlock::SegmentArray& CTraceBlock::GetSegments() const
+{
+	return m_segments;
+}
+
+bool CTraceBlock::IsLoop() const
+{
+	return m_isLoop;
+}
+
+uint32 CTraceBlock::GetTraceEnd(const SegmentArray& segments)
+{
+	assert(!segments.empty());
+	uint32 result = 0;
+	for(const auto& segment : segments)
+	{
+		result = std::max(result, segment.end);
+	}
+	return result;
+}
+
+void CTraceBlock::CompileRange(CMipsJitter* jitter)
+{
+	CompileProlog(jitter);
+
+	auto loopLabel = jitter->CreateLabel();
+	auto endLabel = jitter->CreateLabel();
+
+	std::vector<std::pair<Jitter::CJitter::LABEL, const SEGMENT*>> exits;
+
+	jitter->MarkLabel(loopLabel);
+
+	for(uint32 segmentIndex = 0; segmentIndex < m_segments.size(); segmentIndex++)
+	{
+		const auto& segment = m_segments[segmentIndex];
+
+		for(uint32 address = segment.begin; address <= segment.end; address += 4)
+		{
+			m_context.m_pArch->CompileInstruction(
+			    address,
+			    jitter,
+			    &m_context);
+			//Sanity check
+			assert(jitter->IsStackEmpty());
+		}
+
+		//Branch likely instructions jump here when not taken
+		jitter->MarkFinalBlockLabel();
+
+		CompileQuotaUpdate(jitter, segment);
+
+		bool isLastSegment = (segmentIndex + 1) == m_segments.size();
+		if(isLastSegment && !m_isLoop)
+		{
+			CompileSegmentExit(jitter, segment);
+			jitter->Goto(endLabel);
+			break;
+		}
+
+		uint32 nextAddress = isLastSegment ? m_begin : m_segments[segmentIndex + 1].begin;
+		auto exitLabel = jitter->CreateLabel();
+		exits.push_back(std::make_pair(exitLabel, &segment));
+
+		//Leave the trace if execution doesn't follow the path we expect
+		jitter->PushRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+		jitter->PushCst((nextAddress == segment.branchAddress) ? nextAddress : MIPS_INVALID_PC);
+		jitter->BeginIf(Jitter::CONDITION_NE);
+		{
+			jitter->Goto(exitLabel);
+		}
+		jitter->EndIf();
+
+		//Leave if we ran out of cycles or if something needs to be handled outside
+		jitter->PushRel(offsetof(CMIPS, m_State.cycleQuota));
+		jitter->PushCst(0);
+		jitter->BeginIf(Jitter::CONDITION_LE);
+		{
+			jitter->Goto(exitLabel);
+		}
+		jitter->EndIf();
+
+		jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
+		jitter->PushCst(0);
+		jitter->BeginIf(Jitter::CONDITION_NE);
+		{
+			jitter->Goto(exitLabel);
+		}
+		jitter->EndIf();
+
+		jitter->PushCst(MIPS_INVALID_PC);
+		jitter->PullRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+
+		//The running block is identified by PC when handling invalidations, keep it on the trace
+		jitter->PushCst(m_begin);
+		jitter->PullRel(offsetof(CMIPS, m_State.nPC));
+
+		if(isLastSegment)
+		{
+			jitter->Goto(loopLabel);
+		}
+	}
+
+	for(const auto& exit : exits)
+	{
+		jitter->MarkLabel(exit.first);
+		CompileSegmentExit(jitter, *exit.second);
+		jitter->Goto(endLabel);
+	}
+
+	jitter->MarkLabel(endLabel);
+}
+
+void CTraceBlock::CompileQuotaUpdate(CMipsJitter* jitter, const SEGMENT& segment)
+{
+	jitter->PushRel(offsetof(CMIPS, m_State.cycleQuota));
+	jitter->PushCst(((segment.end - segment.begin) / 4) + 1);
+	jitter->Sub();
+	jitter->PullRel(offsetof(CMIPS, m_State.cycleQuota));
+}
+
+void CTraceBlock::CompileSegmentExit(CMipsJitter* jitter, const SEGMENT& segment)
+{
+	//Same as CBasicBlock::CompileEpilog, but we always go back to the dispatcher
+	jitter->PushRel(offsetof(CMIPS, m_State.cycleQuota));
+	jitter->PushCst(0);
+	jitter->BeginIf(Jitter::CONDITION_LE);
+	{
+		jitter->PushRel(offsetof(CMIPS, m_State.nHasException));
+		jitter->PushCst(MIPS_EXECUTION_STATUS_QUOTADONE);
+		jitter->Or();
+		jitter->PullRel(offsetof(CMIPS, m_State.nHasException));
+	}
+	jitter->EndIf();
+
+	jitter->PushCst(MIPS_INVALID_PC);
+	jitter->PushRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+	jitter->BeginIf(Jitter::CONDITION_NE);
+	{
+		jitter->PushRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+		jitter->PullRel(offsetof(CMIPS, m_State.nPC));
+
+		jitter->PushCst(MIPS_INVALID_PC);
+		jitter->PullRel(offsetof(CMIPS, m_State.nDelayedJumpAddr));
+	}
+	jitter->Else();
+	{
+		jitter->PushCst(segment.end + 4);
+		jitter->PullRel(offsetof(CMIPS, m_State.nPC));
+	}
+	jitter->EndIf();
+}
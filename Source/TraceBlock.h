@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include "BasicBlock.h"
+
+//Block made of several basic blocks following a frequently executed path
+//Execution stays inside the trace as long as it follows the expected path, which avoids going
+//through the block epilog, the dispatcher and link trampolines at every branch. The last segment
+//can jump back to the first one to run loops without leaving the generated code.
+//Each segment is still compiled as its own unit: guest registers are written back at every segment
+//exit check and aren't kept in host registers across segments. Loops are found by BuildTrace when
+//the path leads back to the trace's first block, not by CMIPSAnalysis (which only finds subroutines).
+class CTraceBlock : public CBasicBlock
+{
+public:
+	struct SEGMENT
+	{
+		uint32 begin;
+		uint32 end;
+		uint32 branchAddress;
+	};
+	typedef std::vector<SEGMENT> SegmentArray;
+
+	CTraceBlock(CMIPS&, SegmentArray, bool);
+	virtual ~CTraceBlock() = default;
+
+	void CompileRange(CMipsJitter*) override;
+
+	const SegmentArray& GetSegments() const;
+	bool IsLoop() const;
+
+private:
+	static uint32 GetTraceEnd(const SegmentArray&);
+
+	void CompileQuotaUpdate(CMipsJitter*, const SEGMENT&);
+	void CompileSegmentExit(CMipsJitter*, const SEGMENT&);
+
+	SegmentArray m_segments;
+	bool m_isLoop = false;
+};
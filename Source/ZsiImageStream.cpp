@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include "ZsiImageStream.h"
+#include "zstd.h"
+
+CZsiImageStream::CZsiImageStream(CStream* baseStream)
+    : m_baseStream(baseStream)
+{
+	if(baseStream == nullptr)
+	{
+		throw std::runtime_error("Null base stream supplied.");
+	}
+
+	try
+	{
+		ReadFileHeader();
+		ReadDictionary();
+		ReadIndex();
+	}
+	catch(...)
+	{
+		ZSTD_freeDDict(m_dictionary);
+		delete m_baseStream;
+		throw;
+	}
+
+	m_frameCache = std::make_unique<CFrameCache>(m_header.frameSize, m_frameCount,
+	                                             [this](uint32 frame, uint8* dest, std::vector<uint8>& readBuffer) { LoadFrame(frame, dest, readBuffer); });
+}
+
+CZsiImageStream::~CZsiImageStream()
+{
+	//Workers might still be decompressing, stop them before anything goes away
+	m_frameCache.reset();
+	for(auto context : m_contextPool)
+	{
+		ZSTD_freeDCtx(context);
+	}
+	ZSTD_freeDDict(m_dictionary);
+	delete m_baseStream;
+}
+
+void CZsiImageStream::ReadFileHeader()
+{
+	m_baseStream->Seek(0, Framework::STREAM_SEEK_SET);
+	if(m_baseStream->Read(&m_header, sizeof(ZSI_HEADER)) != sizeof(ZSI_HEADER))
+	{
+		throw std::runtime_error("Could not read full ZSI header.");
+	}
+
+	if(m_header.magic[0] != 'Z' || m_header.magic[1] != 'S' || m_header.magic[2] != 'I' || m_header.magic[3] != 0)
+	{
+		throw std::runtime_error("Not a valid ZSI file.");
+	}
+	if(m_header.version > ZSI_VERSION)
+	{
+		throw std::runtime_error("Unsupported ZSI version.");
+	}
+	if(m_header.headerSize < sizeof(ZSI_HEADER))
+	{
+		throw std::runtime_error("Invalid ZSI header size.");
+	}
+
+	uint32 frameSize = m_header.frameSize;
+	if((frameSize & (frameSize - 1)) != 0)
+	{
+		throw std::runtime_error("ZSI frame size must be a power of two.");
+	}
+	if(frameSize < 0x800)
+	{
+		throw std::runtime_error("ZSI frame size must be at least one sector.");
+	}
+
+	m_frameShift = 0;
+	for(uint32 i = frameSize; i > 1; i >>= 1)
+	{
+		m_frameShift++;
+	}
+
+	uint64 frameCount = (m_header.totalBytes + frameSize - 1) >> m_frameShift;
+	if(frameCount > UINT32_MAX)
+	{
+		throw std::runtime_error("Too many frames in ZSI file.");
+	}
+	m_frameCount = static_cast<uint32>(frameCount);
+}
+
+void CZsiImageStream::ReadDictionary()
+{
+	if(m_header.dictionarySize == 0) return;
+
+	std::vector<uint8> dictionary(m_header.dictionarySize);
+	if(ReadBaseAt(m_header.headerSize, dictionary.data(), dictionary.size()) != dictionary.size())
+	{
+		throw std::runtime_error("Unable to read ZSI dictionary.");
+	}
+
+	m_dictionary = ZSTD_createDDict(dictionary.data(), dictionary.size());
+	if(m_dictionary == nullptr)
+	{
+		throw std::runtime_error("Invalid ZSI dictionary.");
+	}
+}
+
+void CZsiImageStream::ReadIndex()
+{
+	uint64 indexPos = static_cast<uint64>(m_header.headerSize) + m_header.dictionarySize;
+	uint64 indexSize = static_cast<uint64>(m_frameCount + 1) * sizeof(uint64);
+	m_index.resize(m_frameCount + 1);
+	if(ReadBaseAt(indexPos, reinterpret_cast<uint8*>(m_index.data()), indexSize) != indexSize)
+	{
+		throw std::runtime_error("Unable to read ZSI index.");
+	}
+}
+
+void CZsiImageStream::Seek(int64 position, Framework::STREAM_SEEK_DIRECTION origin)
+{
+	switch(origin)
+	{
+	case Framework::STREAM_SEEK_CUR:
+		m_position += position;
+		break;
+	case Framework::STREAM_SEEK_SET:
+		m_position = position;
+		break;
+	case Framework::STREAM_SEEK_END:
+		m_position = m_header.totalBytes + position;
+		break;
+	}
+}
+
+uint64 CZsiImageStream::Tell()
+{
+	return m_position;
+}
+
+bool CZsiImageStream::IsEOF()
+{
+	return m_position >= m_header.totalBytes;
+}
+
+uint64 CZsiImageStream::Read(void* buffer, uint64 size)
+{
+	uint64 remaining = std::min(size, IsEOF() ? 0 : m_header.totalBytes - m_position);
+	uint64 readSize = remaining;
+	uint8* dest = reinterpret_cast<uint8*>(buffer);
+
+	while(remaining > 0)
+	{
+		uint32 frame = static_cast<uint32>(m_position >> m_frameShift);
+		uint32 offset = static_cast<uint32>(m_position & (m_header.frameSize - 1));
+		uint32 bytes = static_cast<uint32>(std::min<uint64>(remaining, m_header.frameSize - offset));
+		m_frameCache->Read(frame, offset, dest, bytes);
+		remaining -= bytes;
+		m_position += bytes;
+		dest += bytes;
+	}
+
+	return readSize;
+}
+
+uint64 CZsiImageStream::Write(const void* buffer, uint64 size)
+{
+	throw std::runtime_error("Unable to write to ZSI, read only.");
+}
+
+uint64 CZsiImageStream::ReadBaseAt(uint64 pos, uint8* dest, uint64 bytes)
+{
+	std::lock_guard<std::mutex> baseStreamLock(m_baseStreamMutex);
+	m_baseStream->Seek(pos, Framework::STREAM_SEEK_SET);
+	return m_baseStream->Read(dest, bytes);
+}
+
+void CZsiImageStream::LoadFrame(uint32 frame, uint8* dest, std::vector<uint8>& readBuffer)
+{
+	//Called from the frame cache's workers too, only the index and the dictionary are shared
+	uint64 frameRawPos = m_index[frame + 0] & INDEX_OFFSET_MASK;
+	uint64 frameRawEnd = m_index[frame + 1] & INDEX_OFFSET_MASK;
+	bool compressed = (m_index[frame] & INDEX_UNCOMPRESSED_BIT) == 0;
+	if(frameRawEnd < frameRawPos)
+	{
+		throw std::runtime_error("Corrupted ZSI index.");
+	}
+	uint64 frameRawSize = frameRawEnd - frameRawPos;
+
+	if(!compressed)
+	{
+		uint64 readRawBytes = ReadBaseAt(frameRawPos, dest, std::min<uint64>(frameRawSize, m_header.frameSize));
+		if(readRawBytes != frameRawSize)
+		{
+			throw std::runtime_error("Unable to read uncompressed bytes from ZSI.");
+		}
+		memset(dest + readRawBytes, 0, static_cast<size_t>(m_header.frameSize - readRawBytes));
+		return;
+	}
+
+	readBuffer.resize(static_cast<size_t>(frameRawSize));
+	if(ReadBaseAt(frameRawPos, readBuffer.data(), frameRawSize) != frameRawSize)
+	{
+		throw std::runtime_error("Unable to read compressed bytes from ZSI.");
+	}
+
+	auto context = AcquireContext();
+	size_t result = m_dictionary ? ZSTD_decompress_usingDDict(context, dest, m_header.frameSize, readBuffer.data(), readBuffer.size(), m_dictionary)
+	                             : ZSTD_decompressDCtx(context, dest, m_header.frameSize, readBuffer.data(), readBuffer.size());
+	ReleaseContext(context);
+
+	if(ZSTD_isError(result) || (result != m_header.frameSize))
+	{
+		throw std::runtime_error("Unable to decompress ZSI frame using zstd.");
+	}
+}
+
+CZsiImageStream::DecompressionContext CZsiImageStream::AcquireContext()
+{
+	{
+		std::lock_guard<std::mutex> contextPoolLock(m_contextPoolMutex);
+		if(!m_contextPool.empty())
+		{
+			auto context = m_contextPool.back();
+			m_contextPool.pop_back();
+			return context;
+		}
+	}
+	auto context = ZSTD_createDCtx();
+	if(context == nullptr)
+	{
+		throw std::runtime_error("Unable to create zstd decompression context.");
+	}
+	return context;
+}
+
+void CZsiImageStream::ReleaseContext(DecompressionContext context)
+{
+	std::lock_guard<std::mutex> contextPoolLock(m_contextPoolMutex);
+	m_contextPool.push_back(context);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+#include "FrameCache.h"
+
+struct ZSTD_DCtx_s;
+struct ZSTD_DDict_s;
+
+//ZSI (zstd seekable image) layout, everything is little endian:
+//- Header (ZSI_HEADER)
+//- Dictionary (dictionarySize bytes, optional)
+//- Frame index, (frameCount + 1) 64-bit offsets into the file. The top bit is set for frames stored uncompressed.
+//- Frames, each frame is a self-contained zstd frame that decompresses to frameSize bytes
+class CZsiImageStream : public Framework::CStream
+{
+public:
+	enum
+	{
+		ZSI_VERSION = 1,
+	};
+
+	enum : uint64
+	{
+		INDEX_UNCOMPRESSED_BIT = 0x8000000000000000ULL,
+		INDEX_OFFSET_MASK = ~INDEX_UNCOMPRESSED_BIT,
+	};
+
+#pragma pack(push, 1)
+	struct ZSI_HEADER
+	{
+		uint8 magic[4];
+		uint32 headerSize;
+		uint64 totalBytes;
+		uint32 frameSize;
+		uint32 dictionarySize;
+		uint8 version;
+		uint8 reserved[7];
+	};
+#pragma pack(pop)
+	static_assert(sizeof(ZSI_HEADER) == 0x20, "ZSI_HEADER size must be 0x20 bytes.");
+
+	CZsiImageStream(Framework::CStream* baseStream);
+	virtual ~CZsiImageStream();
+
+	virtual void Seek(int64 pos, Framework::STREAM_SEEK_DIRECTION whence) override;
+	virtual uint64 Tell() override;
+	virtual bool IsEOF() override;
+	virtual uint64 Read(void* dest, uint64 bytes) override;
+	virtual uint64 Write(const void* src, uint64 bytes) override;
+
+private:
+	typedef ZSTD_DCtx_s* DecompressionContext;
+
+	void ReadFileHeader();
+	void ReadDictionary();
+	void ReadIndex();
+	uint64 ReadBaseAt(uint64 pos, uint8* dest, uint64 bytes);
+	void LoadFrame(uint32 frame, uint8* dest, std::vector<uint8>& readBuffer);
+
+	DecompressionContext AcquireContext();
+	void ReleaseContext(DecompressionContext);
+
+	Framework::CStream* m_baseStream = nullptr;
+	std::mutex m_baseStreamMutex;
+	ZSI_HEADER m_header = {};
+	uint32 m_frameShift = 0;
+	uint32 m_frameCount = 0;
+	std::vector<uint64> m_index;
+	ZSTD_DDict_s* m_dictionary = nullptr;
+	uint64 m_position = 0;
+
+	//Contexts are reused since the frame cache's workers decompress at the same time as the reader
+	std::mutex m_contextPoolMutex;
+	std::vector<DecompressionContext> m_contextPool;
+
+	std::unique_ptr<CFrameCache> m_frameCache;
+};
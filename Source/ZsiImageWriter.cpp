@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "ZsiImageWriter.h"
+#include "ZsiImageStream.h"
+#include "zstd.h"
+#include "zdict.h"
+
+//Each thread gets this many frames per batch, enough to keep them busy between reads and writes
+#define BATCH_FRAMES_PER_THREAD 16
+//zstd's trainer wants about 100 times the dictionary size worth of samples
+#define DICTIONARY_SAMPLE_FACTOR 100
+#define DICTIONARY_MIN_SAMPLE_COUNT 16
+
+static uint64 ReadFrames(Framework::CStream& input, uint8* dest, uint64 size)
+{
+	uint64 readSize = 0;
+	while(readSize < size)
+	{
+		uint64 result = input.Read(dest + readSize, size - readSize);
+		if(result == 0) break;
+		readSize += result;
+	}
+	//Last frame is padded with zeroes
+	memset(dest + readSize, 0, static_cast<size_t>(size - readSize));
+	return readSize;
+}
+
+static std::vector<uint8> TrainDictionary(Framework::CStream& input, uint32 frameSize, uint32 frameCount, uint32 dictionarySize)
+{
+	//Take frames spread over the whole image, blank frames would only skew the training
+	uint32 sampleCount = std::min<uint32>(frameCount, (dictionarySize * DICTIONARY_SAMPLE_FACTOR) / frameSize);
+	sampleCount = std::max<uint32>(sampleCount, DICTIONARY_MIN_SAMPLE_COUNT);
+	sampleCount = std::min<uint32>(sampleCount, frameCount);
+
+	std::vector<uint8> samples;
+	std::vector<size_t> sampleSizes;
+	std::vector<uint8> frameData(frameSize);
+	for(uint32 i = 0; i < sampleCount; i++)
+	{
+		uint32 frame = static_cast<uint32>((static_cast<uint64>(i) * frameCount) / sampleCount);
+		input.Seek(static_cast<uint64>(frame) * frameSize, Framework::STREAM_SEEK_SET);
+		ReadFrames(input, frameData.data(), frameSize);
+		bool blank = std::all_of(std::begin(frameData), std::end(frameData), [](uint8 value) { return value == 0; });
+		if(blank) continue;
+		samples.insert(std::end(samples), std::begin(frameData), std::end(frameData));
+		sampleSizes.push_back(frameSize);
+	}
+	input.Seek(0, Framework::STREAM_SEEK_SET);
+
+	if(sampleSizes.size() < DICTIONARY_MIN_SAMPLE_COUNT)
+	{
+		return std::vector<uint8>();
+	}
+
+	std::vector<uint8> dictionary(dictionarySize);
+	size_t result = ZDICT_trainFromBuffer(dictionary.data(), dictionary.size(), samples.data(),
+	                                      sampleSizes.data(), static_cast<unsigned int>(sampleSizes.size()));
+	if(ZDICT_isError(result))
+	{
+		//Not enough redundancy in the samples, frames will be compressed on their own
+		return std::vector<uint8>();
+	}
+	dictionary.resize(result);
+	return dictionary;
+}
+
+void CZsiImageWriter::Write(Framework::CStream& output, Framework::CStream& input, const OPTIONS& options, const ProgressCallback& progressCallback)
+{
+	uint32 frameSize = options.frameSize;
+	if(((frameSize & (frameSize - 1)) != 0) || (frameSize < 0x800))
+	{
+		throw std::runtime_error("ZSI frame size must be a power of two and at least one sector.");
+	}
+
+	uint32 threadCount = options.threadCount;
+	if(threadCount == 0)
+	{
+		threadCount = std::max<uint32>(std::thread::hardware_concurrency(), 1);
+	}
+
+	input.Seek(0, Framework::STREAM_SEEK_END);
+	uint64 totalBytes = input.Tell();
+	input.Seek(0, Framework::STREAM_SEEK_SET);
+
+	uint64 frameCount64 = (totalBytes + frameSize - 1) / frameSize;
+	if(frameCount64 > UINT32_MAX)
+	{
+		throw std::runtime_error("Input is too large for this frame size.");
+	}
+	uint32 frameCount = static_cast<uint32>(frameCount64);
+
+	std::vector<uint8> dictionary;
+	if((options.dictionarySize != 0) && (frameCount != 0))
+	{
+		dictionary = TrainDictionary(input, frameSize, frameCount, options.dictionarySize);
+	}
+
+	CZsiImageStream::ZSI_HEADER header = {};
+	header.magic[0] = 'Z';
+	header.magic[1] = 'S';
+	header.magic[2] = 'I';
+	header.magic[3] = 0;
+	header.headerSize = sizeof(CZsiImageStream::ZSI_HEADER);
+	header.totalBytes = totalBytes;
+	header.frameSize = frameSize;
+	header.dictionarySize = static_cast<uint32>(dictionary.size());
+	header.version = CZsiImageStream::ZSI_VERSION;
+
+	std::vector<uint64> index(frameCount + 1);
+	uint64 indexSize = index.size() * sizeof(uint64);
+	uint64 framePosition = header.headerSize + dictionary.size() + indexSize;
+
+	output.Seek(0, Framework::STREAM_SEEK_SET);
+	output.Write(&header, sizeof(header));
+	output.Write(dictionary.data(), dictionary.size());
+	//Placeholder, actual index is written at the end
+	output.Write(index.data(), indexSize);
+
+	ZSTD_CDict* compressionDictionary = nullptr;
+	if(!dictionary.empty())
+	{
+		compressionDictionary = ZSTD_createCDict(dictionary.data(), dictionary.size(), options.compressionLevel);
+		if(compressionDictionary == nullptr)
+		{
+			throw std::runtime_error("Unable to create zstd compression dictionary.");
+		}
+	}
+
+	std::vector<ZSTD_CCtx*> contexts(threadCount);
+	for(auto& context : contexts)
+	{
+		context = ZSTD_createCCtx();
+	}
+
+	uint32 batchFrameCount = threadCount * BATCH_FRAMES_PER_THREAD;
+	size_t compressedFrameCapacity = ZSTD_compressBound(frameSize);
+	std::vector<uint8> batchData(static_cast<size_t>(batchFrameCount) * frameSize);
+	std::vector<uint8> compressedData(static_cast<size_t>(batchFrameCount) * compressedFrameCapacity);
+	std::vector<size_t> compressedSizes(batchFrameCount);
+
+	try
+	{
+		if(std::find(std::begin(contexts), std::end(contexts), nullptr) != std::end(contexts))
+		{
+			throw std::runtime_error("Unable to create zstd compression context.");
+		}
+
+		for(uint32 batchStart = 0; batchStart < frameCount; batchStart += batchFrameCount)
+		{
+			uint32 batchSize = std::min<uint32>(batchFrameCount, frameCount - batchStart);
+			ReadFrames(input, batchData.data(), static_cast<uint64>(batchSize) * frameSize);
+
+			std::atomic<uint32> nextFrame(0);
+			std::atomic<bool> failed(false);
+			auto compressProc =
+			    [&](ZSTD_CCtx* context) {
+				    while(1)
+				    {
+					    uint32 frame = nextFrame++;
+					    if(frame >= batchSize) break;
+					    const uint8* src = batchData.data() + (static_cast<size_t>(frame) * frameSize);
+					    uint8* dst = compressedData.data() + (static_cast<size_t>(frame) * compressedFrameCapacity);
+					    size_t result = compressionDictionary ? ZSTD_compress_usingCDict(context, dst, compressedFrameCapacity, src, frameSize, compressionDictionary)
+					                                          : ZSTD_compressCCtx(context, dst, compressedFrameCapacity, src, frameSize, options.compressionLevel);
+					    if(ZSTD_isError(result))
+					    {
+						    failed = true;
+						    break;
+					    }
+					    compressedSizes[frame] = result;
+				    }
+			    };
+
+			std::vector<std::thread> threads;
+			for(uint32 i = 1; i < threadCount; i++)
+			{
+				threads.emplace_back(compressProc, contexts[i]);
+			}
+			compressProc(contexts[0]);
+			for(auto& thread : threads)
+			{
+				thread.join();
+			}
+
+			if(failed)
+			{
+				throw std::runtime_error("Failed to compress frame using zstd.");
+			}
+
+			for(uint32 i = 0; i < batchSize; i++)
+			{
+				uint32 frame = batchStart + i;
+				index[frame] = framePosition;
+				if(compressedSizes[i] < frameSize)
+				{
+					output.Write(compressedData.data() + (static_cast<size_t>(i) * compressedFrameCapacity), compressedSizes[i]);
+					framePosition += compressedSizes[i];
+				}
+				else
+				{
+					//Doesn't compress, store it as is
+					index[frame] |= CZsiImageStream::INDEX_UNCOMPRESSED_BIT;
+					output.Write(batchData.data() + (static_cast<size_t>(i) * frameSize), frameSize);
+					framePosition += frameSize;
+				}
+			}
+
+			if(progressCallback)
+			{
+				uint64 processedBytes = std::min<uint64>(static_cast<uint64>(batchStart + batchSize) * frameSize, totalBytes);
+				progressCallback(processedBytes, totalBytes);
+			}
+		}
+		index[frameCount] = framePosition;
+
+		output.Seek(header.headerSize + dictionary.size(), Framework::STREAM_SEEK_SET);
+		output.Write(index.data(), indexSize);
+		output.Seek(framePosition, Framework::STREAM_SEEK_SET);
+	}
+	catch(...)
+	{
+		for(auto context : contexts)
+		{
+			ZSTD_freeCCtx(context);
+		}
+		ZSTD_freeCDict(compressionDictionary);
+		throw;
+	}
+
+	for(auto context : contexts)
+	{
+		ZSTD_freeCCtx(context);
+	}
+	ZSTD_freeCDict(compressionDictionary);
+}
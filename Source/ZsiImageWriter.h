@@ -0,0 +1,33 @@
+#pragma once
+
+#include <functional>
+#include "Types.h"
+#include "Stream.h"
+
+//Compresses a disc image into a ZSI image (see CZsiImageStream for the layout)
+//Frames are compressed on multiple threads, the input is read and the output is written in order
+class CZsiImageWriter
+{
+public:
+	enum
+	{
+		DEFAULT_FRAME_SIZE = 0x8000,
+		DEFAULT_COMPRESSION_LEVEL = 12,
+		DEFAULT_DICTIONARY_SIZE = 0x10000,
+	};
+
+	struct OPTIONS
+	{
+		uint32 frameSize = DEFAULT_FRAME_SIZE;
+		int compressionLevel = DEFAULT_COMPRESSION_LEVEL;
+		//Dictionary is trained on frames sampled over the whole input, 0 to disable
+		uint32 dictionarySize = 0;
+		//0 to use as many threads as there are hardware threads
+		uint32 threadCount = 0;
+	};
+
+	typedef std::function<void(uint64, uint64)> ProgressCallback;
+
+	//Image is written from the start of the output, which needs to be seekable since the index is written last
+	static void Write(Framework::CStream& output, Framework::CStream& input, const OPTIONS&, const ProgressCallback& = ProgressCallback());
+};
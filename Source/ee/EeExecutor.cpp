@@ -37,12 +37,20 @@ CEeExecutor::CEeExecutor(CMIPS& context, uint8* ram)
     , m_ram(ram)
 {
 	m_pageSize = framework_getpagesize();
+	m_pages.resize(PS2::EE_RAM_SIZE / m_pageSize);
+	m_writtenPages.resize(PS2::EE_RAM_SIZE / m_pageSize);
+	assert(!context.m_blockValidationHandler);
+	context.m_blockValidationHandler =
+	    [&](CMIPS*, uint32 address) {
+		    return ValidateBlock(address);
+	    };
 }
 
 void CEeExecutor::AddExceptionHandler()
 {
 	assert(g_eeExecutor == nullptr);
 	g_eeExecutor = this;
+	m_exceptionHandlerThreadId = std::this_thread::get_id();
 
 #ifdef DISABLE_PROTECTION
 	return;
@@ -79,6 +87,10 @@ void CEeExecutor::AddExceptionHandler()
 
 void CEeExecutor::RemoveExceptionHandler()
 {
+	//Writes can't be caught anymore
+	SetWriteTrackingEnabled(false);
+	m_exceptionHandlerThreadId = std::thread::id();
+
 #ifndef DISABLE_PROTECTION
 
 #if defined(_WIN32)
@@ -95,16 +107,83 @@ void CEeExecutor::RemoveExceptionHandler()
 
 void CEeExecutor::Reset()
 {
-	SetMemoryProtected(m_ram, PS2::EE_RAM_SIZE, false);
 	m_cachedBlocks.clear();
+	m_validatedBlockChecksums.clear();
+	m_retiredBlocks.clear();
+	std::fill(std::begin(m_pages), std::end(m_pages), PAGE_STATE());
+	//Pages that haven't been written yet stay protected
+	UpdateMemoryProtection(0, PS2::EE_RAM_SIZE);
 	CGenericMipsExecutor::Reset();
 }
 
 void CEeExecutor::ClearActiveBlocksInRange(uint32 start, uint32 end, bool executing)
 {
-	uint32 rangeSize = end - start;
-	SetMemoryProtected(m_ram + start, rangeSize, false);
+	for(uint32 address = start & ~(m_pageSize - 1); (address < end) && (address < PS2::EE_RAM_SIZE); address += m_pageSize)
+	{
+		auto& page = m_pages[address / m_pageSize];
+		page.codeProtected = false;
+		page.stats.invalidations++;
+		//Blocks in this range are going away
+		if((address >= start) && ((address + m_pageSize) <= end))
+		{
+			page.codeMask = 0;
+		}
+	}
+	UpdateMemoryProtection(start, end);
 	CGenericMipsExecutor::ClearActiveBlocksInRange(start, end, executing);
+	if(executing)
+	{
+		//Running block was kept
+		auto currentBlock = FindBlockStartingAt(m_context.m_State.nPC);
+		if(!currentBlock->IsEmpty())
+		{
+			MarkCodeRange(currentBlock->GetBeginAddress(), currentBlock->GetEndAddress());
+		}
+	}
+}
+
+void CEeExecutor::SetFineGrainedInvalidationEnabled(bool enabled)
+{
+	if(m_fineGrainedInvalidationEnabled == enabled) return;
+	m_fineGrainedInvalidationEnabled = enabled;
+	//Get rid of checked pages and blocks
+	Reset();
+}
+
+size_t CEeExecutor::GetPageSize() const
+{
+	return m_pageSize;
+}
+
+CEeExecutor::PageStatsArray CEeExecutor::GetPageStats() const
+{
+	PageStatsArray result;
+	result.reserve(m_pages.size());
+	for(const auto& page : m_pages)
+	{
+		result.push_back(page.stats);
+		result.back().checked = page.checked;
+	}
+	return result;
+}
+
+void CEeExecutor::SetWriteTrackingEnabled(bool enabled)
+{
+#ifdef DISABLE_PROTECTION
+	enabled = false;
+#endif
+	//Exception handler might only catch faults happening on the thread that installed it, other threads
+	//write to memory while the machine is reset or an executable is loaded
+	m_writeTrackingEnabled = enabled && (std::this_thread::get_id() == m_exceptionHandlerThreadId);
+	std::fill(std::begin(m_writtenPages), std::end(m_writtenPages), 0);
+	UpdateMemoryProtection(0, PS2::EE_RAM_SIZE);
+}
+
+//Every page is reported as written when writes aren't tracked
+bool CEeExecutor::IsPageWritten(uint32 address) const
+{
+	if(!m_writeTrackingEnabled) return true;
+	return m_writtenPages[address / m_pageSize] != 0;
 }
 
 BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end)
@@ -114,9 +193,20 @@ BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end
 	//Kernel area is below 0x100000 and isn't protected. Some games will write code in there
 	//but it is safe to assume that it won't change (code writes some data just besides itself
 	//so it keeps generating exceptions, making the game slower)
+	bool isRam = (start < PS2::EE_RAM_SIZE) && (end < PS2::EE_RAM_SIZE);
+	bool validate = isRam && IsRangeChecked(start, end);
 	if(start >= 0x100000 && start < PS2::EE_RAM_SIZE)
 	{
-		SetMemoryProtected(m_ram + start, blockSize, true);
+		ProtectCodeRange(start, end);
+	}
+	if(isRam)
+	{
+		auto& page = m_pages[start / m_pageSize];
+		if(page.stats.invalidations != 0)
+		{
+			page.stats.recompiles++;
+		}
+		MarkCodeRange(start, end);
 	}
 
 	auto blockMemory = reinterpret_cast<uint32*>(alloca(blockSize));
@@ -136,10 +226,16 @@ BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end
 		for(; equalRange.first != equalRange.second; ++equalRange.first)
 		{
 			const auto& basicBlock(equalRange.first->second);
+			if(basicBlock->IsEntryValidationEnabled() != validate) continue;
 			if(basicBlock->GetBeginAddress() == start)
 			{
 				if(basicBlock->GetEndAddress() == end)
 				{
+					if(validate)
+					{
+						//Entry was removed when the block was cleared, code matches since checksums are the same
+						m_validatedBlockChecksums[basicBlock.get()] = checksum;
+					}
 					uint32 recycleCount = basicBlock->GetRecycleCount();
 					basicBlock->SetRecycleCount(std::min<uint32>(RECYCLE_NOLINK_THRESHOLD, recycleCount + 1));
 					return basicBlock;
@@ -148,8 +244,31 @@ BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end
 		}
 	}
 
-	auto result = std::make_shared<CBasicBlock>(context, start, end);
-	result->Compile();
+	BasicBlockPtr result;
+	if(m_compileQueue)
+	{
+		result = TakeCompiledBlock(start, end, checksum);
+		//Blocks compiled in the background don't validate their code
+		if(validate)
+		{
+			result.reset();
+		}
+	}
+	if(!result)
+	{
+		result = AllocateBlock<CBasicBlock>(context, start, end);
+		if(validate)
+		{
+			//Kept out of the block cache, cached code doesn't know about validation
+			result->SetEntryValidationEnabled(true);
+			result->Compile();
+			m_validatedBlockChecksums[result.get()] = checksum;
+		}
+		else
+		{
+			CompileBlock(*result, checksum);
+		}
+	}
 	if(!hasBreakpoint)
 	{
 		m_cachedBlocks.insert(std::make_pair(checksum, result));
@@ -157,11 +276,68 @@ BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end
 	return result;
 }
 
+bool CEeExecutor::IsBlockAvailable(uint32 start, uint32 end, uint32 checksum) const
+{
+	auto equalRange = m_cachedBlocks.equal_range(checksum);
+	for(; equalRange.first != equalRange.second; ++equalRange.first)
+	{
+		const auto& basicBlock(equalRange.first->second);
+		if((basicBlock->GetBeginAddress() == start) && (basicBlock->GetEndAddress() == end))
+		{
+			return true;
+		}
+	}
+	return CGenericMipsExecutor::IsBlockAvailable(start, end, checksum);
+}
+
+void CEeExecutor::OnBlockDeleted(CBasicBlock* block)
+{
+	//Block might not outlive this, make sure another one allocated at the same address doesn't pick up its checksum
+	m_validatedBlockChecksums.erase(block);
+}
+
 bool CEeExecutor::HandleAccessFault(intptr_t ptr)
 {
 	ptrdiff_t addr = reinterpret_cast<uint8*>(ptr) - m_ram;
 	if(addr >= 0 && addr < PS2::EE_RAM_SIZE)
 	{
+		uint32 pageIndex = addr / m_pageSize;
+		auto& page = m_pages[pageIndex];
+		if(m_writeTrackingEnabled && !m_writtenPages[pageIndex])
+		{
+			m_writtenPages[pageIndex] = 1;
+			//Page was only protected to catch this write
+			if(!page.codeProtected)
+			{
+				UpdateMemoryProtection(pageIndex * m_pageSize, (pageIndex + 1) * m_pageSize);
+				return true;
+			}
+		}
+		page.stats.faults++;
+		if(m_fineGrainedInvalidationEnabled)
+		{
+			//Check if the write hit a range that holds code or if it's only data living beside code
+			uint32 pageAddress = addr & ~(m_pageSize - 1);
+			uint32 granuleIndex = (addr & (m_pageSize - 1)) / (m_pageSize / CODE_GRANULE_COUNT);
+			if((page.codeMask & (1ULL << granuleIndex)) != 0)
+			{
+				ClearCodeGranule(pageAddress, granuleIndex);
+				//Page keeps faulting, have blocks compiled there check their code instead
+				if(page.stats.faults >= CHECKED_PAGE_FAULT_THRESHOLD)
+				{
+					page.checked = true;
+				}
+			}
+			else
+			{
+				//Code living in this page isn't touched by this write, blocks are kept and blocks compiled
+				//there from now on check their code since the page won't be protected anymore
+				page.checked = true;
+			}
+			page.codeProtected = false;
+			UpdateMemoryProtection(pageAddress, pageAddress + m_pageSize);
+			return true;
+		}
 		addr &= ~(m_pageSize - 1);
 		ClearActiveBlocksInRange(addr, addr + m_pageSize, true);
 		return true;
@@ -169,6 +345,80 @@ bool CEeExecutor::HandleAccessFault(intptr_t ptr)
 	return false;
 }
 
+//Only blocks covering the range that was written to need to go away
+void CEeExecutor::ClearCodeGranule(uint32 pageAddress, uint32 granuleIndex)
+{
+	auto& page = m_pages[pageAddress / m_pageSize];
+	page.codeMask &= ~(1ULL << granuleIndex);
+	page.stats.invalidations++;
+
+	uint32 granuleSize = m_pageSize / CODE_GRANULE_COUNT;
+	uint32 granuleStart = pageAddress + (granuleIndex * granuleSize);
+	auto currentBlock = FindBlockStartingAt(m_context.m_State.nPC);
+	ClearActiveBlocksInRangeInternal(granuleStart, granuleStart + granuleSize - 4, currentBlock);
+
+	//Running block was kept
+	if(!currentBlock->IsEmpty())
+	{
+		MarkCodeRange(currentBlock->GetBeginAddress(), currentBlock->GetEndAddress());
+	}
+}
+
+bool CEeExecutor::IsRangeChecked(uint32 start, uint32 end) const
+{
+	for(uint32 address = start & ~(m_pageSize - 1); address <= end; address += m_pageSize)
+	{
+		if(m_pages[address / m_pageSize].checked) return true;
+	}
+	return false;
+}
+
+void CEeExecutor::ProtectCodeRange(uint32 start, uint32 end)
+{
+	for(uint32 address = start & ~(m_pageSize - 1); (address <= end) && (address < PS2::EE_RAM_SIZE); address += m_pageSize)
+	{
+		auto& page = m_pages[address / m_pageSize];
+		if(page.checked) continue;
+		page.codeProtected = true;
+		SetMemoryProtected(m_ram + address, m_pageSize, true);
+	}
+}
+
+void CEeExecutor::MarkCodeRange(uint32 start, uint32 end)
+{
+	uint32 granuleSize = m_pageSize / CODE_GRANULE_COUNT;
+	for(uint32 address = start & ~(granuleSize - 1); (address <= end) && (address < PS2::EE_RAM_SIZE); address += granuleSize)
+	{
+		auto& page = m_pages[address / m_pageSize];
+		uint32 granuleIndex = (address & (m_pageSize - 1)) / granuleSize;
+		page.codeMask |= (1ULL << granuleIndex);
+	}
+}
+
+bool CEeExecutor::ValidateBlock(uint32 address)
+{
+	//Blocks retired by a previous validation have been left by now
+	m_retiredBlocks.clear();
+
+	auto block = FindBlockStartingAt(address);
+	auto checksumIterator = m_validatedBlockChecksums.find(block);
+	if(checksumIterator == std::end(m_validatedBlockChecksums)) return true;
+
+	uint32 begin = block->GetBeginAddress();
+	uint32 end = block->GetEndAddress();
+	uint32 checksum = crc32(0, reinterpret_cast<Bytef*>(m_ram + begin), (end - begin) + 4);
+	if(checksum == checksumIterator->second) return true;
+
+	//Block is still running, keep it alive until we've left it
+	auto blockIterator = m_blocks.find(block);
+	assert(blockIterator != std::end(m_blocks));
+	m_retiredBlocks.push_back(blockIterator->second);
+
+	m_pages[begin / m_pageSize].stats.invalidations++;
+	ClearActiveBlocksInRangeInternal(begin, end, nullptr);
+	return false;
+}
+
 void CEeExecutor::SetMemoryProtected(void* addr, size_t size, bool protect)
 {
 #ifdef DISABLE_PROTECTION
@@ -190,6 +440,28 @@ void CEeExecutor::SetMemoryProtected(void* addr, size_t size, bool protect)
 #endif
 }
 
+bool CEeExecutor::IsPageProtected(uint32 pageIndex) const
+{
+	return m_pages[pageIndex].codeProtected || (m_writeTrackingEnabled && !m_writtenPages[pageIndex]);
+}
+
+//Applies the protection every page of the range needs, neighbouring pages needing the same one are updated together
+void CEeExecutor::UpdateMemoryProtection(uint32 start, uint32 end)
+{
+	uint32 pageIndex = start / m_pageSize;
+	uint32 endPageIndex = static_cast<uint32>(std::min<uint64>((static_cast<uint64>(end) + m_pageSize - 1) / m_pageSize, m_pages.size()));
+	while(pageIndex < endPageIndex)
+	{
+		uint32 runStart = pageIndex;
+		bool protect = IsPageProtected(pageIndex);
+		while((pageIndex < endPageIndex) && (IsPageProtected(pageIndex) == protect))
+		{
+			pageIndex++;
+		}
+		SetMemoryProtected(m_ram + (runStart * m_pageSize), (pageIndex - runStart) * m_pageSize, protect);
+	}
+}
+
 #if defined(_WIN32)
 
 LONG WINAPI CEeExecutor::HandleException(_EXCEPTION_POINTERS* exceptionInfo)
@@ -9,11 +9,23 @@
 #include <signal.h>
 #endif
 
+#include <thread>
+
 #include "../GenericMipsExecutor.h"
 
 class CEeExecutor : public CGenericMipsExecutor<BlockLookupTwoWay>
 {
 public:
+	struct PAGE_STATS
+	{
+		uint32 faults = 0;
+		uint32 invalidations = 0;
+		uint32 recompiles = 0;
+		//Blocks compiled in this page validate their code on entry
+		bool checked = false;
+	};
+	typedef std::vector<PAGE_STATS> PageStatsArray;
+
 	CEeExecutor(CMIPS&, uint8*);
 	virtual ~CEeExecutor() = default;
 
@@ -25,15 +37,63 @@ public:
 
 	BasicBlockPtr BlockFactory(CMIPS&, uint32, uint32) override;
 
+	void SetFineGrainedInvalidationEnabled(bool);
+
+	size_t GetPageSize() const;
+	PageStatsArray GetPageStats() const;
+
+	//Pages are protected to catch the first write done to them since tracking was last enabled
+	void SetWriteTrackingEnabled(bool);
+	bool IsPageWritten(uint32) const;
+
+protected:
+	bool IsBlockAvailable(uint32, uint32, uint32) const override;
+	void OnBlockDeleted(CBasicBlock*) override;
+
 private:
+	enum
+	{
+		//Number of sub-page ranges we keep track of in every page
+		CODE_GRANULE_COUNT = 64,
+		//Pages where code keeps being written to are switched to blocks that validate their code on entry
+		CHECKED_PAGE_FAULT_THRESHOLD = 8,
+	};
+
+	struct PAGE_STATE
+	{
+		PAGE_STATS stats;
+		uint64 codeMask = 0;
+		bool checked = false;
+		bool codeProtected = false;
+	};
+	typedef std::vector<PAGE_STATE> PageStateArray;
+	typedef std::vector<uint8> WrittenPageArray;
+
 	typedef std::unordered_multimap<uint32, BasicBlockPtr> CachedBlockMap;
+	typedef std::unordered_map<CBasicBlock*, uint32> BlockChecksumMap;
 	CachedBlockMap m_cachedBlocks;
 
 	uint8* m_ram = nullptr;
 	size_t m_pageSize = 0;
+	std::thread::id m_exceptionHandlerThreadId;
+
+	bool m_fineGrainedInvalidationEnabled = false;
+	PageStateArray m_pages;
+	bool m_writeTrackingEnabled = false;
+	WrittenPageArray m_writtenPages;
+	BlockChecksumMap m_validatedBlockChecksums;
+	std::vector<BasicBlockPtr> m_retiredBlocks;
 
 	bool HandleAccessFault(intptr_t);
+	void ClearCodeGranule(uint32, uint32);
 	void SetMemoryProtected(void*, size_t, bool);
+	bool IsPageProtected(uint32) const;
+	void UpdateMemoryProtection(uint32, uint32);
+
+	bool IsRangeChecked(uint32, uint32) const;
+	void ProtectCodeRange(uint32, uint32);
+	void MarkCodeRange(uint32, uint32);
+	bool ValidateBlock(uint32);
 
 #if defined(_WIN32)
 	static LONG CALLBACK HandleException(_EXCEPTION_POINTERS*);
@@ -74,7 +74,7 @@ CSubSystem::CSubSystem(uint8* iopRam, CIopBios& iopBios)
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::MICROMEM0ADDR, PS2::MICROMEM0ADDR + PS2::MICROMEM0SIZE - 1, m_microMem0, 0x03);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM0ADDR, PS2::VUMEM0ADDR + PS2::VUMEM0SIZE - 1, m_vuMem0, 0x04);
 		m_EE.m_pMemoryMap->InsertReadMap(PS2::MICROMEM1ADDR, PS2::MICROMEM1ADDR + PS2::MICROMEM1SIZE - 1, m_microMem1, 0x05);
-		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM1ADDR, PS2::VUMEM1ADDR + PS2::VUMEM1SIZE - 1, m_vuMem1, 0x06);
+		m_EE.m_pMemoryMap->InsertReadMap(PS2::VUMEM1ADDR, PS2::VUMEM1ADDR + PS2::VUMEM1SIZE - 1, std::bind(&CSubSystem::Vu1MemReadHandler, this, PLACEHOLDER_1), 0x06);
 		m_EE.m_pMemoryMap->InsertReadMap(0x12000000, 0x12FFFFFF, std::bind(&CSubSystem::IOPortReadHandler, this, PLACEHOLDER_1), 0x07);
 		m_EE.m_pMemoryMap->InsertReadMap(0x1C000000, 0x1C001000, m_fakeIopRam, 0x08);
 		m_EE.m_pMemoryMap->InsertReadMap(0x1FC00000, 0x1FFFFFFF, m_bios, 0x09);
@@ -350,12 +350,16 @@ void CSubSystem::NotifyVBlankEnd()
 	m_intc.AssertLine(CINTC::INTC_LINE_VBLANK_END);
 }
 
-void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
+void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive, bool includeRam)
 {
+	m_vpu1->Sync();
 	archive.InsertFile(new CMemoryStateFile(STATE_EE, &m_EE.m_State, sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU0, &m_VU0.m_State, sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU1, &m_VU1.m_State, sizeof(MIPSSTATE)));
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_ram, PS2::EE_RAM_SIZE));
+	if(includeRam)
+	{
+		archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_ram, PS2::EE_RAM_SIZE));
+	}
 	archive.InsertFile(new CMemoryStateFile(STATE_SPR, m_spr, PS2::EE_SPR_SIZE));
 	archive.InsertFile(new CMemoryStateFile(STATE_VUMEM0, m_vuMem0, PS2::VUMEM0SIZE));
 	archive.InsertFile(new CMemoryStateFile(STATE_MICROMEM0, m_microMem0, PS2::MICROMEM0SIZE));
@@ -371,14 +375,18 @@ void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 	m_gif.SaveState(archive);
 }
 
-void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
+void CSubSystem::LoadState(Framework::CZipArchiveReader& archive, bool includeRam)
 {
+	m_vpu1->Sync();
 	m_EE.m_executor->Reset();
 
 	archive.BeginReadFile(STATE_EE)->Read(&m_EE.m_State, sizeof(MIPSSTATE));
 	archive.BeginReadFile(STATE_VU0)->Read(&m_VU0.m_State, sizeof(MIPSSTATE));
 	archive.BeginReadFile(STATE_VU1)->Read(&m_VU1.m_State, sizeof(MIPSSTATE));
-	archive.BeginReadFile(STATE_RAM)->Read(m_ram, PS2::EE_RAM_SIZE);
+	if(includeRam)
+	{
+		archive.BeginReadFile(STATE_RAM)->Read(m_ram, PS2::EE_RAM_SIZE);
+	}
 	archive.BeginReadFile(STATE_SPR)->Read(m_spr, PS2::EE_SPR_SIZE);
 	archive.BeginReadFile(STATE_VUMEM0)->Read(m_vuMem0, PS2::VUMEM0SIZE);
 	archive.BeginReadFile(STATE_MICROMEM0)->Read(m_microMem0, PS2::MICROMEM0SIZE);
@@ -423,6 +431,8 @@ uint32 CSubSystem::IOPortReadHandler(uint32 nAddress)
 	}
 	else if(nAddress >= CVif::REGS1_START && nAddress < CVif::REGS1_END)
 	{
+		//EE is looking at VIF1/VU1 state, threaded VU1 needs to catch up
+		m_vpu1->Sync();
 		nReturn = m_vpu1->GetVif().GetRegister(nAddress);
 	}
 	else if(nAddress >= 0x10008000 && nAddress <= 0x1000EFFC)
@@ -485,6 +495,8 @@ uint32 CSubSystem::IOPortWriteHandler(uint32 nAddress, uint32 nData)
 	}
 	else if(nAddress >= CVif::REGS1_START && nAddress < CVif::REGS1_END)
 	{
+		//FBRST and friends can reset or stop VIF1 while VU1 is running
+		m_vpu1->Sync();
 		m_vpu1->GetVif().SetRegister(nAddress, nData);
 	}
 	else if(nAddress >= CVif::VIF0_FIFO_START && nAddress < CVif::VIF0_FIFO_END)
@@ -521,6 +533,7 @@ uint32 CSubSystem::IOPortWriteHandler(uint32 nAddress, uint32 nData)
 	else if(nAddress == CVpu::VU_CMSAR1)
 	{
 		bool validAddress = (nData & 0x7) == 0;
+		m_vpu1->Sync();
 		if(!m_vpu1->IsVuRunning() && validAddress)
 		{
 			m_vpu1->ExecuteMicroProgram(nData);
@@ -597,9 +610,19 @@ void CSubSystem::Vu0StateChanged(bool running)
 	}
 }
 
+uint32 CSubSystem::Vu1MemReadHandler(uint32 address)
+{
+	//Threaded VU1 might still be writing to its memory
+	m_vpu1->Sync();
+	uint32 baseAddress = address - PS2::VUMEM1ADDR;
+	uint32 value = *reinterpret_cast<uint32*>(m_vuMem1 + (baseAddress & ~0x03));
+	return value >> ((baseAddress & 0x03) * 8);
+}
+
 uint32 CSubSystem::Vu1MicroMemWriteHandler(uint32 address, uint32 value)
 {
 	uint32 baseAddress = address - PS2::MICROMEM1ADDR;
+	m_vpu1->Sync();
 	*reinterpret_cast<uint32*>(m_microMem1 + baseAddress) = value;
 	m_vpu1->InvalidateMicroProgram(baseAddress, baseAddress + 4);
 	return 0;
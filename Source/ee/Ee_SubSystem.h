@@ -35,8 +35,9 @@ namespace Ee
 		void NotifyVBlankStart();
 		void NotifyVBlankEnd();
 
-		void SaveState(Framework::CZipArchiveWriter&);
-		void LoadState(Framework::CZipArchiveReader&);
+		//RAM can be left out for it to be saved and restored separately (ie.: rewind snapshots)
+		void SaveState(Framework::CZipArchiveWriter&, bool = true);
+		void LoadState(Framework::CZipArchiveReader&, bool = true);
 
 		void SetVpu0(std::shared_ptr<CVpu>);
 		void SetVpu1(std::shared_ptr<CVpu>);
@@ -92,6 +93,7 @@ namespace Ee
 		uint32 Vu0IoPortWriteHandler(uint32, uint32);
 		void Vu0StateChanged(bool);
 
+		uint32 Vu1MemReadHandler(uint32);
 		uint32 Vu1MicroMemWriteHandler(uint32, uint32);
 
 		uint32 Vu1IoPortReadHandler(uint32);
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <algorithm>
+#include <new>
 #include "../uint128.h"
 #include "../Ps2Const.h"
 #include "../Log.h"
@@ -7,6 +8,11 @@
 #include "../states/RegisterStateFile.h"
 #include "GIF.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define GIF_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 #define QTEMP_INIT (0x3F800000)
 
 #define LOG_NAME ("ee_gif")
@@ -74,97 +80,168 @@ void CGIF::SaveState(Framework::CZipArchiveWriter& archive)
 	archive.InsertFile(registerFile);
 }
 
-uint32 CGIF::ProcessPacked(CGSHandler::RegisterWriteList& writeList, const uint8* memory, uint32 address, uint32 end)
+static inline uint64 DecodePackedRgba(const uint128& packet, uint32 qtemp)
+{
+#ifdef GIF_USE_SSE2
+	__m128i color = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&packet));
+	color = _mm_and_si128(color, _mm_set1_epi32(0xFF));
+	color = _mm_packs_epi32(color, color);
+	color = _mm_packus_epi16(color, color);
+	uint64 result = static_cast<uint32>(_mm_cvtsi128_si32(color));
+#else
+	uint64 result = (packet.nV[0] & 0xFF);
+	result |= (packet.nV[1] & 0xFF) << 8;
+	result |= (packet.nV[2] & 0xFF) << 16;
+	result |= (packet.nV[3] & 0xFF) << 24;
+#endif
+	return result | (static_cast<uint64>(qtemp) << 32);
+}
+
+static inline uint64 DecodePackedXy(const uint128& packet)
+{
+	//X and Y are the low 16 bits of the first two words
+	return (packet.nD0 & 0xFFFF) | ((packet.nD0 >> 16) & 0xFFFF0000);
+}
+
+//Decodes PACKED registers that map to a single GS register write, everything except A+D and NOP
+static inline CGSHandler::RegisterWrite DecodePackedRegister(uint32 regDesc, const uint128& packet, uint32& qtemp)
+{
+	switch(regDesc)
+	{
+	case 0x00:
+		//PRIM
+		return CGSHandler::RegisterWrite(GS_REG_PRIM, packet.nV0);
+	case 0x01:
+		//RGBA
+		return CGSHandler::RegisterWrite(GS_REG_RGBAQ, DecodePackedRgba(packet, qtemp));
+	case 0x02:
+		//ST
+		qtemp = packet.nV2;
+		return CGSHandler::RegisterWrite(GS_REG_ST, packet.nD0);
+	case 0x03:
+		//UV
+		return CGSHandler::RegisterWrite(GS_REG_UV, (packet.nV[0] & 0x7FFF) | ((packet.nV[1] & 0x7FFF) << 16));
+	case 0x04:
+		//XYZF2
+		{
+			uint64 temp = DecodePackedXy(packet);
+			temp |= static_cast<uint64>(packet.nV[2] & 0x0FFFFFF0) << 28;
+			temp |= static_cast<uint64>(packet.nV[3] & 0x00000FF0) << 52;
+			uint8 reg = (packet.nV[3] & 0x8000) ? GS_REG_XYZF3 : GS_REG_XYZF2;
+			return CGSHandler::RegisterWrite(reg, temp);
+		}
+	case 0x05:
+		//XYZ2
+		{
+			uint64 temp = DecodePackedXy(packet);
+			temp |= static_cast<uint64>(packet.nV[2]) << 32;
+			uint8 reg = (packet.nV[3] & 0x8000) ? GS_REG_XYZ3 : GS_REG_XYZ2;
+			return CGSHandler::RegisterWrite(reg, temp);
+		}
+	case 0x0A:
+		//FOG
+		return CGSHandler::RegisterWrite(GS_REG_FOG, (packet.nD1 >> 36) << 56);
+	default:
+		//TEX0_1, TEX0_2, CLAMP_1, CLAMP_2 and XYZ3 are written as is
+		assert(((regDesc >= 0x06) && (regDesc <= 0x09)) || (regDesc == 0x0D));
+		return CGSHandler::RegisterWrite(static_cast<uint8>(regDesc), packet.nD0);
+	}
+}
+
+template <uint32 regCount, uint64 regList>
+void CGIF::ProcessPackedLoops(const uint8* memory, uint32 loopCount)
+{
+	//Register layout is known at compile time, the decoder's switch goes away once the inner loop is unrolled
+	auto writes = m_writeArena.current;
+	uint32 qtemp = m_qtemp;
+	for(uint32 loop = 0; loop < loopCount; loop++)
+	{
+		for(uint32 i = 0; i < regCount; i++)
+		{
+			const auto& packet = *reinterpret_cast<const uint128*>(memory);
+			new(writes++) CGSHandler::RegisterWrite(DecodePackedRegister((regList >> (i * 4)) & 0x0F, packet, qtemp));
+			memory += 0x10;
+		}
+	}
+	m_qtemp = qtemp;
+	m_writeArena.current = writes;
+}
+
+CGIF::PackedLoopsHandler CGIF::GetPackedLoopsHandler() const
+{
+	//Vertex layouts used by most games, register descriptors start from the lowest nibble
+	switch(m_regs)
+	{
+	case 2:
+		switch(m_regList & 0xFF)
+		{
+		case 0x41:
+			//RGBA, XYZF2
+			return &CGIF::ProcessPackedLoops<2, 0x41>;
+		case 0x51:
+			//RGBA, XYZ2
+			return &CGIF::ProcessPackedLoops<2, 0x51>;
+		}
+		break;
+	case 3:
+		switch(m_regList & 0xFFF)
+		{
+		case 0x412:
+			//ST, RGBA, XYZF2
+			return &CGIF::ProcessPackedLoops<3, 0x412>;
+		case 0x512:
+			//ST, RGBA, XYZ2
+			return &CGIF::ProcessPackedLoops<3, 0x512>;
+		case 0x413:
+			//UV, RGBA, XYZF2
+			return &CGIF::ProcessPackedLoops<3, 0x413>;
+		case 0x513:
+			//UV, RGBA, XYZ2
+			return &CGIF::ProcessPackedLoops<3, 0x513>;
+		}
+		break;
+	}
+	return nullptr;
+}
+
+uint32 CGIF::ProcessPacked(const uint8* memory, uint32 address, uint32 end)
 {
 	uint32 start = address;
+	auto packedLoopsHandler = GetPackedLoopsHandler();
 
 	while((m_loops != 0) && (address < end))
 	{
+		if(packedLoopsHandler && (m_regsTemp == m_regs))
+		{
+			uint32 loopSize = m_regs * 0x10;
+			uint32 loopCount = std::min<uint32>(m_loops, (end - address) / loopSize);
+			loopCount = std::min<uint32>(loopCount, GetFreeRegisterWriteCount() / m_regs);
+			if(loopCount != 0)
+			{
+				(this->*packedLoopsHandler)(memory + address, loopCount);
+				address += loopCount * loopSize;
+				m_loops -= loopCount;
+				continue;
+			}
+		}
+
 		while((m_regsTemp != 0) && (address < end))
 		{
-			uint64 temp = 0;
+			if(m_writeArena.current == m_writeArena.end)
+			{
+				//Out of room, we'll be called again once new space has been reserved
+				return address - start;
+			}
+
 			uint32 regDesc = (uint32)((m_regList >> ((m_regs - m_regsTemp) * 4)) & 0x0F);
 
 			uint128 packet = *reinterpret_cast<const uint128*>(memory + address);
 
 			switch(regDesc)
 			{
-			case 0x00:
-				//PRIM
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_PRIM, packet.nV0));
-				break;
-			case 0x01:
-				//RGBA
-				temp = (packet.nV[0] & 0xFF);
-				temp |= (packet.nV[1] & 0xFF) << 8;
-				temp |= (packet.nV[2] & 0xFF) << 16;
-				temp |= (packet.nV[3] & 0xFF) << 24;
-				temp |= ((uint64)m_qtemp << 32);
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_RGBAQ, temp));
-				break;
-			case 0x02:
-				//ST
-				m_qtemp = packet.nV2;
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_ST, packet.nD0));
-				break;
-			case 0x03:
-				//UV
-				temp = (packet.nV[0] & 0x7FFF);
-				temp |= (packet.nV[1] & 0x7FFF) << 16;
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_UV, temp));
-				break;
-			case 0x04:
-				//XYZF2
-				temp = (packet.nV[0] & 0xFFFF);
-				temp |= (packet.nV[1] & 0xFFFF) << 16;
-				temp |= (uint64)(packet.nV[2] & 0x0FFFFFF0) << 28;
-				temp |= (uint64)(packet.nV[3] & 0x00000FF0) << 52;
-				if(packet.nV[3] & 0x8000)
-				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZF3, temp));
-				}
-				else
-				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZF2, temp));
-				}
-				break;
-			case 0x05:
-				//XYZ2
-				temp = (packet.nV[0] & 0xFFFF);
-				temp |= (packet.nV[1] & 0xFFFF) << 16;
-				temp |= (uint64)(packet.nV[2] & 0xFFFFFFFF) << 32;
-				if(packet.nV[3] & 0x8000)
-				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZ3, temp));
-				}
-				else
-				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZ2, temp));
-				}
-				break;
-			case 0x06:
-				//TEX0_1
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_TEX0_1, packet.nD0));
-				break;
-			case 0x07:
-				//TEX0_2
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_TEX0_2, packet.nD0));
-				break;
-			case 0x08:
-				//CLAMP_1
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_CLAMP_1, packet.nD0));
-				break;
-			case 0x09:
-				//CLAMP_2
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_CLAMP_2, packet.nD0));
-				break;
-			case 0x0A:
-				//FOG
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_FOG, (packet.nD1 >> 36) << 56));
-				break;
-			case 0x0D:
-				//XYZ3
-				writeList.push_back(CGSHandler::RegisterWrite(GS_REG_XYZ3, packet.nD0));
+			case 0x0B:
+			case 0x0C:
+				assert(0);
 				break;
 			case 0x0E:
 				//A + D
@@ -182,14 +259,14 @@ uint32 CGIF::ProcessPacked(CGSHandler::RegisterWriteList& writeList, const uint8
 						}
 						m_signalState = SIGNAL_STATE_ENCOUNTERED;
 					}
-					writeList.push_back(CGSHandler::RegisterWrite(reg, packet.nD0));
+					new(m_writeArena.current++) CGSHandler::RegisterWrite(reg, packet.nD0);
 				}
 				break;
 			case 0x0F:
 				//NOP
 				break;
 			default:
-				assert(0);
+				new(m_writeArena.current++) CGSHandler::RegisterWrite(DecodePackedRegister(regDesc, packet, m_qtemp));
 				break;
 			}
 
@@ -207,7 +284,7 @@ uint32 CGIF::ProcessPacked(CGSHandler::RegisterWriteList& writeList, const uint8
 	return address - start;
 }
 
-uint32 CGIF::ProcessRegList(CGSHandler::RegisterWriteList& writeList, const uint8* memory, uint32 address, uint32 end)
+uint32 CGIF::ProcessRegList(const uint8* memory, uint32 address, uint32 end)
 {
 	uint32 start = address;
 
@@ -218,27 +295,32 @@ uint32 CGIF::ProcessRegList(CGSHandler::RegisterWriteList& writeList, const uint
 			break;
 		}
 
+		if(GetFreeRegisterWriteCount() < m_regs)
+		{
+			//Out of room, we'll be called again once new space has been reserved
+			break;
+		}
+
+		auto writes = m_writeArena.current;
 		for(uint32 j = 0; j < m_regs; j++)
 		{
 			assert(address < end);
 
-			uint128 packet;
 			uint32 nRegDesc = (uint32)((m_regList >> (j * 4)) & 0x0F);
-
-			packet.nV[0] = *(uint32*)&memory[address + 0x00];
-			packet.nV[1] = *(uint32*)&memory[address + 0x04];
+			uint64 value = *reinterpret_cast<const uint64*>(memory + address);
 			address += 0x08;
 
 			if(nRegDesc == 0x0F) continue;
 
-			writeList.push_back(CGSHandler::RegisterWrite(static_cast<uint8>(nRegDesc), packet.nD0));
+			new(writes++) CGSHandler::RegisterWrite(static_cast<uint8>(nRegDesc), value);
 		}
+		m_writeArena.current = writes;
 
 		m_loops--;
 	}
 
-	//Align on qword boundary
-	if(address & 0x0F)
+	//Align on qword boundary once all loops are done, we might be stopping in the middle of a qword otherwise
+	if((m_loops == 0) && (address & 0x0F))
 	{
 		address += 8;
 	}
@@ -272,17 +354,6 @@ uint32 CGIF::ProcessImage(const uint8* memory, uint32 memorySize, uint32 address
 
 uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 memorySize, uint32 address, uint32 end, const CGsPacketMetadata& packetMetadata)
 {
-	static CGSHandler::RegisterWriteList writeList;
-	static const auto flushWriteList =
-	    [](CGSHandler* gs, const CGsPacketMetadata& packetMetadata) {
-		    if(!writeList.empty())
-		    {
-			    auto currentCapacity = writeList.capacity();
-			    gs->WriteRegisterMassively(std::move(writeList), &packetMetadata);
-			    writeList.reserve(currentCapacity);
-		    }
-	    };
-
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_gifProfilerZone);
 #endif
@@ -294,7 +365,7 @@ uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 memorySize, uint32
 
 	assert((m_activePath == 0) || (m_activePath == packetMetadata.pathIndex));
 	m_signalState = SIGNAL_STATE_NONE;
-	writeList.clear();
+	assert(m_writeArena.begin == nullptr);
 
 	uint32 start = address;
 	while(address < end)
@@ -308,6 +379,8 @@ uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 memorySize, uint32
 				break;
 			}
 
+			ReserveRegisterWrites(end - address, packetMetadata);
+
 			//We need to update the registers
 			auto tag = *reinterpret_cast<const TAG*>(&memory[address]);
 			address += 0x10;
@@ -327,7 +400,7 @@ uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 memorySize, uint32
 			{
 				if(tag.pre != 0)
 				{
-					writeList.push_back(CGSHandler::RegisterWrite(GS_REG_PRIM, static_cast<uint64>(tag.prim)));
+					new(m_writeArena.current++) CGSHandler::RegisterWrite(GS_REG_PRIM, static_cast<uint64>(tag.prim));
 				}
 			}
 
@@ -339,17 +412,19 @@ uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 memorySize, uint32
 		switch(m_cmd)
 		{
 		case 0x00:
-			address += ProcessPacked(writeList, memory, address, end);
+			ReserveRegisterWrites(end - address, packetMetadata);
+			address += ProcessPacked(memory, address, end);
 			break;
 		case 0x01:
-			address += ProcessRegList(writeList, memory, address, end);
+			ReserveRegisterWrites(end - address, packetMetadata);
+			address += ProcessRegList(memory, address, end);
 			break;
 		case 0x02:
 		case 0x03:
 			//We need to flush our list here because image data can be embedded in a GIF packet
 			//that specifies pixel transfer information in GS registers (and that has to be send first)
 			//This is done by FFX
-			flushWriteList(m_gs, packetMetadata);
+			EndRegisterWrites(packetMetadata);
 			address += ProcessImage(memory, memorySize, address, end);
 			break;
 		}
@@ -369,7 +444,7 @@ uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 memorySize, uint32
 		}
 	}
 
-	flushWriteList(m_gs, packetMetadata);
+	EndRegisterWrites(packetMetadata);
 
 #ifdef _DEBUG
 	CLog::GetInstance().Print(LOG_NAME, "Processed 0x%08X bytes.\r\n", address - start);
@@ -378,6 +453,42 @@ uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 memorySize, uint32
 	return address - start;
 }
 
+void CGIF::ReserveRegisterWrites(uint32 remainingSize, const CGsPacketMetadata& packetMetadata)
+{
+	if(GetFreeRegisterWriteCount() >= REGISTERWRITE_ARENA_MIN_COUNT)
+	{
+		return;
+	}
+
+	EndRegisterWrites(packetMetadata);
+
+	//Each 8 bytes of data produce at most one write (REGLIST), the tag's PRIM write is the only extra one
+	uint32 count = (remainingSize / 8) + 1;
+	count = std::max<uint32>(count, REGISTERWRITE_ARENA_MIN_COUNT);
+
+	m_gs->BeginRegisterWrites(m_writeReservation, count);
+	assert(m_writeReservation.GetCount() >= REGISTERWRITE_ARENA_MIN_COUNT);
+	m_writeArena.begin = m_writeReservation.GetWrites();
+	m_writeArena.current = m_writeArena.begin;
+	m_writeArena.end = m_writeArena.begin + m_writeReservation.GetCount();
+}
+
+void CGIF::EndRegisterWrites(const CGsPacketMetadata& packetMetadata)
+{
+	if(m_writeArena.begin == nullptr)
+	{
+		return;
+	}
+
+	m_gs->EndRegisterWrites(m_writeReservation, static_cast<uint32>(m_writeArena.current - m_writeArena.begin), &packetMetadata);
+	m_writeArena = REGISTERWRITE_ARENA();
+}
+
+uint32 CGIF::GetFreeRegisterWriteCount() const
+{
+	return static_cast<uint32>(m_writeArena.end - m_writeArena.current);
+}
+
 uint32 CGIF::ProcessMultiplePackets(const uint8* memory, uint32 memorySize, uint32 address, uint32 end, const CGsPacketMetadata& packetMetadata)
 {
 	//This will attempt to process everything from [address, end[ even if it contains multiple GIF packets
@@ -67,8 +67,32 @@ private:
 		SIGNAL_STATE_PENDING,
 	};
 
-	uint32 ProcessPacked(CGSHandler::RegisterWriteList&, const uint8*, uint32, uint32);
-	uint32 ProcessRegList(CGSHandler::RegisterWriteList&, const uint8*, uint32, uint32);
+	enum
+	{
+		//Register writes are decoded in place in the GS command ring, in chunks the GS handler caps.
+		//Chunks are at least big enough for a full REGLIST loop or a tag's PRIM write
+		REGISTERWRITE_ARENA_MIN_COUNT = 0x11,
+	};
+
+	struct REGISTERWRITE_ARENA
+	{
+		CGSHandler::RegisterWrite* begin = nullptr;
+		CGSHandler::RegisterWrite* current = nullptr;
+		CGSHandler::RegisterWrite* end = nullptr;
+	};
+
+	typedef void (CGIF::*PackedLoopsHandler)(const uint8*, uint32);
+
+	void ReserveRegisterWrites(uint32, const CGsPacketMetadata&);
+	void EndRegisterWrites(const CGsPacketMetadata&);
+	uint32 GetFreeRegisterWriteCount() const;
+
+	PackedLoopsHandler GetPackedLoopsHandler() const;
+	template <uint32, uint64>
+	void ProcessPackedLoops(const uint8*, uint32);
+
+	uint32 ProcessPacked(const uint8*, uint32, uint32);
+	uint32 ProcessRegList(const uint8*, uint32, uint32);
 	uint32 ProcessImage(const uint8*, uint32, uint32, uint32);
 
 	void DisassembleGet(uint32);
@@ -88,6 +112,8 @@ private:
 	uint8* m_ram;
 	uint8* m_spr;
 	CGSHandler*& m_gs;
+	CGSHandler::CRegisterWriteReservation m_writeReservation;
+	REGISTERWRITE_ARENA m_writeArena;
 
 	CProfiler::ZoneHandle m_gifProfilerZone = 0;
 };
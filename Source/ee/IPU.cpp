@@ -15,10 +15,6 @@
 #include "mpeg2/DctCoefficientTable0.h"
 #include "mpeg2/DctCoefficientTable1.h"
 #include "mpeg2/CodedBlockPatternTable.h"
-#include "mpeg2/QuantiserScaleTable.h"
-#include "mpeg2/InverseScanTable.h"
-#include "idct/TrivialC.h"
-#include "idct/IEEE1180.h"
 #include "../Log.h"
 #include "DMAC.h"
 #include "INTC.h"
@@ -324,6 +320,30 @@ void CIPU::FlushOUTFIFOData()
 	m_OUT_FIFO.Flush();
 }
 
+bool CIPU::IsSimdKernelsEnabled() const
+{
+	return m_simdKernelsEnabled;
+}
+
+void CIPU::SetSimdKernelsEnabled(bool enabled)
+{
+	m_simdKernelsEnabled = enabled;
+	auto kernels = enabled ? &IPU::GetDefaultKernels() : &IPU::GetScalarKernels();
+	m_BDECCommand.SetKernels(kernels);
+	m_CSCCommand.SetKernels(kernels);
+}
+
+bool CIPU::IsFastDecodingEnabled() const
+{
+	return m_fastDecodingEnabled;
+}
+
+void CIPU::SetFastDecodingEnabled(bool enabled)
+{
+	m_fastDecodingEnabled = enabled;
+	m_BDECCommand.SetFastDecodingEnabled(enabled);
+}
+
 void CIPU::InitializeCommand(uint32 value)
 {
 	unsigned int nCmd = (value >> 28);
@@ -471,123 +491,6 @@ bool CIPU::GetIsZigZagScan()
 	return (m_IPU_CTRL & 0x00100000) == 0;
 }
 
-void CIPU::DequantiseBlock(int16* pBlock, uint8 nMBI, uint8 nQSC, bool isLinearQScale, uint32 dcPrecision, uint8* intraIq, uint8* nonIntraIq)
-{
-	int16 nQuantScale;
-
-	if(isLinearQScale)
-	{
-		nQuantScale = (int16)CQuantiserScaleTable::m_nTable0[nQSC];
-	}
-	else
-	{
-		nQuantScale = (int16)CQuantiserScaleTable::m_nTable1[nQSC];
-	}
-
-	if(nMBI == 1)
-	{
-		int16 nIntraDcMult = 0;
-
-		switch(dcPrecision)
-		{
-		case 0:
-			nIntraDcMult = 8;
-			break;
-		case 1:
-			nIntraDcMult = 4;
-			break;
-		case 2:
-			nIntraDcMult = 2;
-			break;
-		}
-
-		pBlock[0] = nIntraDcMult * pBlock[0];
-
-		for(unsigned int i = 1; i < 64; i++)
-		{
-			int16 nSign = 0;
-
-			if(pBlock[i] == 0)
-			{
-				nSign = 0;
-			}
-			else
-			{
-				nSign = (pBlock[i] > 0) ? 0x0001 : 0xFFFF;
-			}
-
-			pBlock[i] = (pBlock[i] * static_cast<int16>(intraIq[i]) * nQuantScale * 2) / 32;
-
-			if(nSign != 0)
-			{
-				if((pBlock[i] & 1) == 0)
-				{
-					pBlock[i] = (pBlock[i] - nSign) | 1;
-				}
-			}
-		}
-	}
-	else
-	{
-		for(unsigned int i = 0; i < 64; i++)
-		{
-			int16 nSign = 0;
-
-			if(pBlock[i] == 0)
-			{
-				nSign = 0;
-			}
-			else
-			{
-				nSign = (pBlock[i] > 0) ? 0x0001 : 0xFFFF;
-			}
-
-			pBlock[i] = (((pBlock[i] * 2) + nSign) * static_cast<int16>(nonIntraIq[i]) * nQuantScale) / 32;
-
-			if(nSign != 0)
-			{
-				if((pBlock[i] & 1) == 0)
-				{
-					pBlock[i] = (pBlock[i] - nSign) | 1;
-				}
-			}
-		}
-	}
-
-	//Saturate
-	int16 nSum = 0;
-
-	for(unsigned int i = 0; i < 64; i++)
-	{
-		if(pBlock[i] > 2047)
-		{
-			pBlock[i] = 2047;
-		}
-		if(pBlock[i] < -2048)
-		{
-			pBlock[i] = -2048;
-		}
-		nSum += pBlock[i];
-	}
-
-	if(nSum & 1)
-	{
-	}
-}
-
-void CIPU::InverseScan(int16* pBlock, bool isZigZag)
-{
-	int16 nTemp[0x40];
-
-	memcpy(nTemp, pBlock, sizeof(int16) * 0x40);
-	unsigned int* pTable = isZigZag ? CInverseScanTable::m_nTable0 : CInverseScanTable::m_nTable1;
-
-	for(unsigned int i = 0; i < 64; i++)
-	{
-		pBlock[i] = nTemp[pTable[i]];
-	}
-}
-
 uint32 CIPU::GetBusyBit(bool condition) const
 {
 	return condition ? 0x80000000 : 0x00000000;
@@ -905,6 +808,11 @@ void CIPU::CINFIFO::SetBitPosition(unsigned int position)
 	m_bitPosition = position;
 }
 
+const uint8* CIPU::CINFIFO::GetBuffer() const
+{
+	return m_buffer;
+}
+
 unsigned int CIPU::CINFIFO::GetSize() const
 {
 	return m_size;
@@ -1228,6 +1136,16 @@ void CIPU::CBDECCommand::Initialize(CINFIFO* inFifo, COUTFIFO* outFifo, uint32 c
 	m_currentBlockIndex = 0;
 }
 
+void CIPU::CBDECCommand::SetKernels(const IPU::KERNELS* kernels)
+{
+	m_kernels = kernels;
+}
+
+void CIPU::CBDECCommand::SetFastDecodingEnabled(bool enabled)
+{
+	m_readDctCoeffsCommand.SetFastDecodingEnabled(enabled);
+}
+
 bool CIPU::CBDECCommand::Execute()
 {
 	while(1)
@@ -1319,13 +1237,13 @@ bool CIPU::CBDECCommand::Execute()
 			BLOCKENTRY& blockInfo(m_blocks[m_currentBlockIndex]);
 			int16 blockTemp[0x40];
 
-			InverseScan(blockInfo.block, m_context.isZigZag);
-			DequantiseBlock(blockInfo.block, (m_command.mbi != 0), m_command.qsc,
-			                m_context.isLinearQScale, m_context.dcPrecision, m_context.intraIq, m_context.nonIntraIq);
+			m_kernels->inverseScan(blockInfo.block, m_context.isZigZag);
+			m_kernels->dequantiseBlock(blockInfo.block, (m_command.mbi != 0), m_command.qsc,
+			                           m_context.isLinearQScale, m_context.dcPrecision, m_context.intraIq, m_context.nonIntraIq);
 
 			memcpy(blockTemp, blockInfo.block, sizeof(int16) * 0x40);
 
-			IDCT::CIEEE1180::GetInstance()->Transform(blockTemp, blockInfo.block);
+			m_kernels->idct(blockTemp, blockInfo.block);
 
 			m_state = STATE_DECODEBLOCK_GOTONEXT;
 		}
@@ -1415,7 +1333,8 @@ void CIPU::CBDECCommand_ReadDct::Initialize(CINFIFO* fifo, int16* block, unsigne
 	m_blockIndex = 0;
 	m_dcDiff = 0;
 
-	if(m_mbi && !m_isMpeg1CoeffVLCTable)
+	bool isTable1 = m_mbi && !m_isMpeg1CoeffVLCTable;
+	if(isTable1)
 	{
 		m_coeffTable = &CDctCoefficientTable1::GetInstance();
 	}
@@ -1423,6 +1342,12 @@ void CIPU::CBDECCommand_ReadDct::Initialize(CINFIFO* fifo, int16* block, unsigne
 	{
 		m_coeffTable = &CDctCoefficientTable0::GetInstance();
 	}
+	m_fastCoeffTable = &GetFastCoeffTable(isTable1, m_isMpeg2);
+}
+
+void CIPU::CBDECCommand_ReadDct::SetFastDecodingEnabled(bool enabled)
+{
+	m_fastDecodingEnabled = enabled;
 }
 
 bool CIPU::CBDECCommand_ReadDct::Execute()
@@ -1466,6 +1391,11 @@ bool CIPU::CBDECCommand_ReadDct::Execute()
 		break;
 		case STATE_CHECKEOB:
 		{
+			if(m_fastDecodingEnabled && (m_blockIndex != 0) && DecodeCoeffsFast())
+			{
+				m_state = STATE_SKIPEOB;
+				break;
+			}
 			bool isEob = false;
 			if(m_coeffTable->TryIsEndOfBlock(m_IN_FIFO, isEob) != CVLCTable::DECODE_STATUS_SUCCESS)
 			{
@@ -1530,6 +1460,121 @@ bool CIPU::CBDECCommand_ReadDct::Execute()
 	}
 }
 
+//Decodes coefficients straight from the FIFO's buffer while enough bits are buffered to look up a whole code.
+//Stops at escape codes, long codes and when the FIFO runs low, the state machine takes over from there.
+//Returns true if the end of block code was reached (but not consumed).
+bool CIPU::CBDECCommand_ReadDct::DecodeCoeffsFast()
+{
+	const uint8* buffer = m_IN_FIFO->GetBuffer();
+	uint32 startPosition = m_IN_FIFO->GetBitIndex();
+	uint32 endPosition = startPosition + m_IN_FIFO->GetAvailableBits();
+	uint32 bitPosition = startPosition;
+	bool isEob = false;
+	bool hasOverflow = false;
+
+	while((endPosition - bitPosition) >= FAST_COEFF_WINDOW_BITS)
+	{
+		const uint8* bytes = buffer + (bitPosition / 8);
+		uint32 window = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+		window <<= (bitPosition & 7);
+		const auto& coeff = m_fastCoeffTable->entries[(window >> (FAST_COEFF_WINDOW_BITS - FAST_COEFF_BITS)) & ((1 << FAST_COEFF_BITS) - 1)];
+		if(coeff.isEob)
+		{
+			isEob = true;
+			break;
+		}
+		if(coeff.length == 0)
+		{
+			break;
+		}
+		bitPosition += coeff.length;
+		m_blockIndex += coeff.run;
+		if(m_blockIndex >= 0x40)
+		{
+			hasOverflow = true;
+			break;
+		}
+		m_block[m_blockIndex] = coeff.level;
+#ifdef _DECODE_LOGGING
+		CLog::GetInstance().Print(DECODE_LOG_NAME, "[%d]: %d ", m_blockIndex, coeff.level);
+#endif
+		m_blockIndex++;
+	}
+
+	uint32 consumedBits = bitPosition - startPosition;
+	while(consumedBits != 0)
+	{
+		uint8 advanceBits = static_cast<uint8>(std::min<uint32>(consumedBits, 0x80));
+		m_IN_FIFO->Advance(advanceBits);
+		consumedBits -= advanceBits;
+	}
+
+	if(hasOverflow)
+	{
+		throw CVLCTable::CVLCTableException();
+	}
+
+	return isEob;
+}
+
+const CIPU::CBDECCommand_ReadDct::FAST_COEFF_TABLE& CIPU::CBDECCommand_ReadDct::GetFastCoeffTable(bool isTable1, bool isMpeg2)
+{
+	static const FAST_COEFF_TABLE table0[2] = {BuildFastCoeffTable(&CDctCoefficientTable0::GetInstance(), false), BuildFastCoeffTable(&CDctCoefficientTable0::GetInstance(), true)};
+	static const FAST_COEFF_TABLE table1[2] = {BuildFastCoeffTable(&CDctCoefficientTable1::GetInstance(), false), BuildFastCoeffTable(&CDctCoefficientTable1::GetInstance(), true)};
+	return isTable1 ? table1[isMpeg2 ? 1 : 0] : table0[isMpeg2 ? 1 : 0];
+}
+
+//Feeds every possible prefix to the VLC table's decoder and keeps the results of the codes that fit in the prefix,
+//this makes sure the fast path decodes exactly like the state machine does.
+CIPU::CBDECCommand_ReadDct::FAST_COEFF_TABLE CIPU::CBDECCommand_ReadDct::BuildFastCoeffTable(MPEG2::CDctCoefficientTable* coeffTable, bool isMpeg2)
+{
+	FAST_COEFF_TABLE table;
+	for(uint32 prefix = 0; prefix < (1 << FAST_COEFF_BITS); prefix++)
+	{
+		auto& coeff = table.entries[prefix];
+
+		uint32 prefixBits = prefix << (32 - FAST_COEFF_BITS);
+		uint8 data[0x10] = {};
+		data[0] = static_cast<uint8>(prefixBits >> 24);
+		data[1] = static_cast<uint8>(prefixBits >> 16);
+
+		CINFIFO fifo;
+		fifo.Reset();
+		fifo.Write(data, sizeof(data));
+
+		bool isEob = false;
+		if((coeffTable->TryIsEndOfBlock(&fifo, isEob) == CVLCTable::DECODE_STATUS_SUCCESS) && isEob)
+		{
+			coeff.isEob = true;
+			continue;
+		}
+
+		MPEG2::RUNLEVELPAIR runLevelPair;
+		try
+		{
+			if(coeffTable->TryGetRunLevelPair(&fifo, &runLevelPair, isMpeg2) != CVLCTable::DECODE_STATUS_SUCCESS)
+			{
+				continue;
+			}
+		}
+		catch(const CVLCTable::CVLCTableException&)
+		{
+			continue;
+		}
+
+		uint32 length = fifo.GetBitIndex();
+		if((length == 0) || (length > FAST_COEFF_BITS))
+		{
+			continue;
+		}
+
+		coeff.length = static_cast<uint8>(length);
+		coeff.run = static_cast<uint8>(runLevelPair.run);
+		coeff.level = static_cast<int16>(runLevelPair.level);
+	}
+	return table;
+}
+
 /////////////////////////////////////////////
 //BDEC ReadDcDiff subcommand implementation
 /////////////////////////////////////////////
@@ -1836,7 +1881,6 @@ bool CIPU::CSETVQCommand::Execute()
 
 CIPU::CCSCCommand::CCSCCommand()
 {
-	GenerateCbCrMap();
 }
 
 void CIPU::CCSCCommand::Initialize(CINFIFO* input, COUTFIFO* output, uint32 commandCode, uint16 TH0, uint16 TH1)
@@ -1894,79 +1938,18 @@ bool CIPU::CCSCCommand::Execute()
 		break;
 		case STATE_CONVERTBLOCK:
 		{
-			uint32 nPixel[0x100];
-
-			uint8* pY = m_block;
-			uint8* nBlockCb = m_block + 0x100;
-			uint8* nBlockCr = m_block + 0x140;
-
-			uint32* pPixel = nPixel;
-			unsigned int* pCbCrMap = m_nCbCrMap;
-
-			uint32 alphaTh0 = (m_TH0 & 0xFF) | ((m_TH0 & 0xFF) << 8) | ((m_TH0 & 0xFF) << 16);
-			uint32 alphaTh1 = (m_TH1 & 0xFF) | ((m_TH1 & 0xFF) << 8) | ((m_TH1 & 0xFF) << 16);
-
-			for(unsigned int i = 0; i < 16; i++)
+			if(m_command.ofm)
 			{
-				for(unsigned int j = 0; j < 16; j++)
-				{
-					float nY = pY[j];
-					float nCb = nBlockCb[pCbCrMap[j]];
-					float nCr = nBlockCr[pCbCrMap[j]];
-
-					float nR = nY + 1.402f * (nCr - 128);
-					float nG = nY - 0.34414f * (nCb - 128) - 0.71414f * (nCr - 128);
-					float nB = nY + 1.772f * (nCb - 128);
-
-					if(nR < 0)
-					{
-						nR = 0;
-					}
-					if(nR > 255)
-					{
-						nR = 255;
-					}
-					if(nG < 0)
-					{
-						nG = 0;
-					}
-					if(nG > 255)
-					{
-						nG = 255;
-					}
-					if(nB < 0)
-					{
-						nB = 0;
-					}
-					if(nB > 255)
-					{
-						nB = 255;
-					}
-
-					uint8 a = 0;
-					uint32 rgb = (static_cast<uint8>(nB) << 16) | (static_cast<uint8>(nG) << 8) | (static_cast<uint8>(nR) << 0);
-					if(rgb < alphaTh0)
-					{
-						a = 0;
-					}
-					else if(rgb < alphaTh1)
-					{
-						a = 0x40;
-					}
-					else
-					{
-						a = 0x80;
-					}
-
-					pPixel[j] = (a << 24) | rgb;
-				}
-
-				pY += 0x10;
-				pCbCrMap += 0x10;
-				pPixel += 0x10;
+				uint16 pixels[0x100];
+				m_kernels->convertRgba16(m_block, pixels, m_TH0, m_TH1);
+				m_OUT_FIFO->Write(pixels, sizeof(uint16) * 0x100);
+			}
+			else
+			{
+				uint32 pixels[0x100];
+				m_kernels->convertRgba32(m_block, pixels, m_TH0, m_TH1);
+				m_OUT_FIFO->Write(pixels, sizeof(uint32) * 0x100);
 			}
-
-			m_OUT_FIFO->Write(nPixel, sizeof(uint32) * 0x100);
 
 			m_mbCount--;
 			m_state = STATE_FLUSHBLOCK;
@@ -1989,22 +1972,9 @@ bool CIPU::CCSCCommand::Execute()
 	}
 }
 
-void CIPU::CCSCCommand::GenerateCbCrMap()
+void CIPU::CCSCCommand::SetKernels(const IPU::KERNELS* kernels)
 {
-	unsigned int* pCbCrMap = m_nCbCrMap;
-	for(unsigned int i = 0; i < 0x40; i += 0x8)
-	{
-		for(unsigned int j = 0; j < 0x10; j += 2)
-		{
-			pCbCrMap[j + 0x00] = (j / 2) + i;
-			pCbCrMap[j + 0x01] = (j / 2) + i;
-
-			pCbCrMap[j + 0x10] = (j / 2) + i;
-			pCbCrMap[j + 0x11] = (j / 2) + i;
-		}
-
-		pCbCrMap += 0x20;
-	}
+	m_kernels = kernels;
 }
 
 /////////////////////////////////////////////
@@ -8,6 +8,7 @@
 #include "mpeg2/DctCoefficientTable.h"
 #include "../MailBox.h"
 #include "Convertible.h"
+#include "IPU_Kernels.h"
 
 class CINTC;
 
@@ -42,6 +43,12 @@ public:
 	bool HasPendingOUTFIFOData() const;
 	void FlushOUTFIFOData();
 
+	bool IsSimdKernelsEnabled() const;
+	void SetSimdKernelsEnabled(bool);
+
+	bool IsFastDecodingEnabled() const;
+	void SetFastDecodingEnabled(bool);
+
 private:
 	enum IPU_CTRL_BITS
 	{
@@ -162,6 +169,8 @@ private:
 		bool TryPeekBits_MSBF(uint8, uint32&) override;
 
 		void SetBitPosition(unsigned int);
+		//Buffered bytes, for decoders that consume many symbols at once
+		const uint8* GetBuffer() const;
 		unsigned int GetSize() const;
 		unsigned int GetAvailableBits() const;
 		void Reset();
@@ -305,6 +314,8 @@ private:
 		void Initialize(CINFIFO*, int16* block, unsigned int channelId, int16* dcPredictor, bool mbi, bool isMpeg1CoeffVLCTable, bool isMpeg2);
 		bool Execute() override;
 
+		void SetFastDecodingEnabled(bool);
+
 	private:
 		enum STATE
 		{
@@ -315,6 +326,32 @@ private:
 			STATE_SKIPEOB
 		};
 
+		enum
+		{
+			FAST_COEFF_BITS = 11,
+			//Bits that must be buffered to look up a code, the bit position within the first byte is added to FAST_COEFF_BITS
+			FAST_COEFF_WINDOW_BITS = 24,
+		};
+
+		//Run/level pairs decoded from every possible FAST_COEFF_BITS long prefix
+		struct FAST_COEFF
+		{
+			//Length of the code (sign included), 0 if the code is longer than FAST_COEFF_BITS or is an escape code
+			uint8 length = 0;
+			uint8 run = 0;
+			int16 level = 0;
+			bool isEob = false;
+		};
+
+		struct FAST_COEFF_TABLE
+		{
+			FAST_COEFF entries[1 << FAST_COEFF_BITS];
+		};
+
+		static const FAST_COEFF_TABLE& GetFastCoeffTable(bool isTable1, bool isMpeg2);
+		static FAST_COEFF_TABLE BuildFastCoeffTable(MPEG2::CDctCoefficientTable*, bool isMpeg2);
+		bool DecodeCoeffsFast();
+
 		CINFIFO* m_IN_FIFO;
 		STATE m_state;
 		int16* m_block;
@@ -327,6 +364,8 @@ private:
 		int16* m_dcPredictor;
 		int16 m_dcDiff;
 		CBDECCommand_ReadDcDiff m_readDcDiffCommand;
+		const FAST_COEFF_TABLE* m_fastCoeffTable = nullptr;
+		bool m_fastDecodingEnabled = true;
 	};
 
 	class CBDECCommand : public CCommand
@@ -337,6 +376,9 @@ private:
 		void Initialize(CINFIFO*, COUTFIFO*, uint32, bool, const DECODER_CONTEXT&);
 		bool Execute() override;
 
+		void SetKernels(const IPU::KERNELS*);
+		void SetFastDecodingEnabled(bool);
+
 	private:
 		enum STATE
 		{
@@ -374,6 +416,7 @@ private:
 
 		DECODER_CONTEXT m_context;
 		CBDECCommand_ReadDct m_readDctCoeffsCommand;
+		const IPU::KERNELS* m_kernels = &IPU::GetDefaultKernels();
 	};
 
 	//0x03 ------------------------------------------------------------
@@ -467,6 +510,8 @@ private:
 		void Initialize(CINFIFO*, COUTFIFO*, uint32, uint16, uint16);
 		bool Execute() override;
 
+		void SetKernels(const IPU::KERNELS*);
+
 	private:
 		enum STATE
 		{
@@ -477,8 +522,6 @@ private:
 			STATE_DONE,
 		};
 
-		void GenerateCbCrMap();
-
 		STATE m_state = STATE_DONE;
 		CMD_CSC m_command = make_convertible<CMD_CSC>(0);
 
@@ -490,9 +533,8 @@ private:
 		unsigned int m_currentIndex = 0;
 		unsigned int m_mbCount = 0;
 
-		unsigned int m_nCbCrMap[0x100];
-
 		uint8 m_block[BLOCK_SIZE];
+		const IPU::KERNELS* m_kernels = &IPU::GetDefaultKernels();
 	};
 
 	//0x09 ------------------------------------------------------------
@@ -520,9 +562,6 @@ private:
 	bool GetIsZigZagScan();
 	bool GetIsMPEG1CoeffVLCTable();
 
-	static void DequantiseBlock(int16*, uint8, uint8, bool isLinearQScale, uint32 dcPrecision, uint8* intraIq, uint8* nonIntraIq);
-	static void InverseScan(int16*, bool isZigZag);
-
 	uint32 GetBusyBit(bool) const;
 	FIFO_STATE GetFifoState() const;
 
@@ -546,6 +585,8 @@ private:
 	CINFIFO m_IN_FIFO;
 	uint32 m_lastCmd;
 	bool m_isBusy;
+	bool m_simdKernelsEnabled = true;
+	bool m_fastDecodingEnabled = true;
 
 	CCommand* m_currentCmd;
 	CBCLRCommand m_BCLRCommand;
@@ -0,0 +1,901 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "IPU_Kernels.h"
+#include "mpeg2/QuantiserScaleTable.h"
+#include "mpeg2/InverseScanTable.h"
+#include "idct/IEEE1180.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IPU_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define IPU_USE_NEON
+#include <arm_neon.h>
+#endif
+
+//The SIMD kernels must give the exact same results as the scalar ones:
+//- IDCT does the reference's double precision computations in the same order, two or four columns at a time.
+//  Products of rows that are entirely zero are skipped, those can only change the sign of a zero sum.
+//- CSC does the same single precision computations on four pixels at a time.
+//- Dequantisation is done with 32-bit products and wraps to 16 bits like the scalar version.
+//Multiplies and adds must not be fused for this to hold (see -ffp-contract in CMakeLists.txt).
+
+using namespace IPU;
+using namespace MPEG2;
+
+enum
+{
+	MACROBLOCK_CB_OFFSET = 0x100,
+	MACROBLOCK_CR_OFFSET = 0x140,
+};
+
+static uint16 ConvertPixelToRgba16(uint32 pixel)
+{
+	uint32 r = (pixel >> 3) & 0x1F;
+	uint32 g = (pixel >> 11) & 0x1F;
+	uint32 b = (pixel >> 19) & 0x1F;
+	uint32 a = ((pixel >> 24) == 0x40) ? 1 : 0;
+	return static_cast<uint16>(r | (g << 5) | (b << 10) | (a << 15));
+}
+
+/////////////////////////////////////////////
+//Scalar kernels
+/////////////////////////////////////////////
+
+static void InverseScan_Scalar(int16* pBlock, bool isZigZag)
+{
+	int16 nTemp[0x40];
+
+	memcpy(nTemp, pBlock, sizeof(int16) * 0x40);
+	unsigned int* pTable = isZigZag ? CInverseScanTable::m_nTable0 : CInverseScanTable::m_nTable1;
+
+	for(unsigned int i = 0; i < 64; i++)
+	{
+		pBlock[i] = nTemp[pTable[i]];
+	}
+}
+
+static void DequantiseBlock_Scalar(int16* pBlock, bool isIntra, uint8 nQSC, bool isLinearQScale, uint32 dcPrecision, const uint8* intraIq, const uint8* nonIntraIq)
+{
+	int16 nQuantScale;
+
+	if(isLinearQScale)
+	{
+		nQuantScale = (int16)CQuantiserScaleTable::m_nTable0[nQSC];
+	}
+	else
+	{
+		nQuantScale = (int16)CQuantiserScaleTable::m_nTable1[nQSC];
+	}
+
+	if(isIntra)
+	{
+		int16 nIntraDcMult = 0;
+
+		switch(dcPrecision)
+		{
+		case 0:
+			nIntraDcMult = 8;
+			break;
+		case 1:
+			nIntraDcMult = 4;
+			break;
+		case 2:
+			nIntraDcMult = 2;
+			break;
+		}
+
+		pBlock[0] = nIntraDcMult * pBlock[0];
+
+		for(unsigned int i = 1; i < 64; i++)
+		{
+			int16 nSign = 0;
+
+			if(pBlock[i] == 0)
+			{
+				nSign = 0;
+			}
+			else
+			{
+				nSign = (pBlock[i] > 0) ? 0x0001 : 0xFFFF;
+			}
+
+			pBlock[i] = (pBlock[i] * static_cast<int16>(intraIq[i]) * nQuantScale * 2) / 32;
+
+			if(nSign != 0)
+			{
+				if((pBlock[i] & 1) == 0)
+				{
+					pBlock[i] = (pBlock[i] - nSign) | 1;
+				}
+			}
+		}
+	}
+	else
+	{
+		for(unsigned int i = 0; i < 64; i++)
+		{
+			int16 nSign = 0;
+
+			if(pBlock[i] == 0)
+			{
+				nSign = 0;
+			}
+			else
+			{
+				nSign = (pBlock[i] > 0) ? 0x0001 : 0xFFFF;
+			}
+
+			pBlock[i] = (((pBlock[i] * 2) + nSign) * static_cast<int16>(nonIntraIq[i]) * nQuantScale) / 32;
+
+			if(nSign != 0)
+			{
+				if((pBlock[i] & 1) == 0)
+				{
+					pBlock[i] = (pBlock[i] - nSign) | 1;
+				}
+			}
+		}
+	}
+
+	//Saturate
+	for(unsigned int i = 0; i < 64; i++)
+	{
+		if(pBlock[i] > 2047)
+		{
+			pBlock[i] = 2047;
+		}
+		if(pBlock[i] < -2048)
+		{
+			pBlock[i] = -2048;
+		}
+	}
+}
+
+static void Idct_Scalar(const int16* input, int16* output)
+{
+	IDCT::CIEEE1180::GetInstance()->Transform(const_cast<int16*>(input), output);
+}
+
+struct CBCR_MAP
+{
+	CBCR_MAP()
+	{
+		unsigned int* pCbCrMap = values;
+		for(unsigned int i = 0; i < 0x40; i += 0x8)
+		{
+			for(unsigned int j = 0; j < 0x10; j += 2)
+			{
+				pCbCrMap[j + 0x00] = (j / 2) + i;
+				pCbCrMap[j + 0x01] = (j / 2) + i;
+
+				pCbCrMap[j + 0x10] = (j / 2) + i;
+				pCbCrMap[j + 0x11] = (j / 2) + i;
+			}
+
+			pCbCrMap += 0x20;
+		}
+	}
+
+	unsigned int values[0x100];
+};
+
+static void ConvertRgba32_Scalar(const uint8* block, uint32* pPixel, uint16 th0, uint16 th1)
+{
+	static const CBCR_MAP cbCrMap;
+
+	const uint8* pY = block;
+	const uint8* nBlockCb = block + MACROBLOCK_CB_OFFSET;
+	const uint8* nBlockCr = block + MACROBLOCK_CR_OFFSET;
+
+	const unsigned int* pCbCrMap = cbCrMap.values;
+
+	uint32 alphaTh0 = (th0 & 0xFF) | ((th0 & 0xFF) << 8) | ((th0 & 0xFF) << 16);
+	uint32 alphaTh1 = (th1 & 0xFF) | ((th1 & 0xFF) << 8) | ((th1 & 0xFF) << 16);
+
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		for(unsigned int j = 0; j < 16; j++)
+		{
+			float nY = pY[j];
+			float nCb = nBlockCb[pCbCrMap[j]];
+			float nCr = nBlockCr[pCbCrMap[j]];
+
+			float nR = nY + 1.402f * (nCr - 128);
+			float nG = nY - 0.34414f * (nCb - 128) - 0.71414f * (nCr - 128);
+			float nB = nY + 1.772f * (nCb - 128);
+
+			if(nR < 0)
+			{
+				nR = 0;
+			}
+			if(nR > 255)
+			{
+				nR = 255;
+			}
+			if(nG < 0)
+			{
+				nG = 0;
+			}
+			if(nG > 255)
+			{
+				nG = 255;
+			}
+			if(nB < 0)
+			{
+				nB = 0;
+			}
+			if(nB > 255)
+			{
+				nB = 255;
+			}
+
+			uint8 a = 0;
+			uint32 rgb = (static_cast<uint8>(nB) << 16) | (static_cast<uint8>(nG) << 8) | (static_cast<uint8>(nR) << 0);
+			if(rgb < alphaTh0)
+			{
+				a = 0;
+			}
+			else if(rgb < alphaTh1)
+			{
+				a = 0x40;
+			}
+			else
+			{
+				a = 0x80;
+			}
+
+			pPixel[j] = (a << 24) | rgb;
+		}
+
+		pY += 0x10;
+		pCbCrMap += 0x10;
+		pPixel += 0x10;
+	}
+}
+
+static void ConvertRgba16_Scalar(const uint8* block, uint16* pixels, uint16 th0, uint16 th1)
+{
+	uint32 pixels32[0x100];
+	ConvertRgba32_Scalar(block, pixels32, th0, th1);
+	for(unsigned int i = 0; i < 0x100; i++)
+	{
+		pixels[i] = ConvertPixelToRgba16(pixels32[i]);
+	}
+}
+
+/////////////////////////////////////////////
+//SIMD kernels
+/////////////////////////////////////////////
+
+#if defined(IPU_USE_SSE2) || defined(IPU_USE_NEON)
+
+struct INVERSE_SCAN_TABLES
+{
+	INVERSE_SCAN_TABLES()
+	{
+		//Position of every coefficient in the scanned block
+		for(unsigned int i = 0; i < 64; i++)
+		{
+			zigZag[CInverseScanTable::m_nTable0[i]] = static_cast<uint8>(i);
+			alternate[CInverseScanTable::m_nTable1[i]] = static_cast<uint8>(i);
+		}
+	}
+
+	uint8 zigZag[64];
+	uint8 alternate[64];
+};
+
+struct IDCT_TABLE
+{
+	IDCT_TABLE()
+	{
+		//Same as the reference implementation
+		static const double pi = 3.14159265358979323846;
+		for(unsigned int freq = 0; freq < 8; freq++)
+		{
+			double scale = (freq == 0) ? sqrt(0.125) : 0.5;
+			for(unsigned int time = 0; time < 8; time++)
+			{
+				c[freq][time] = scale * cos((pi / 8.0) * freq * (time + 0.5));
+			}
+		}
+	}
+
+	alignas(16) double c[8][8];
+};
+
+static const IDCT_TABLE g_idctTable;
+
+static int16 GetQuantiserScale(uint8 qsc, bool isLinearQScale)
+{
+	return static_cast<int16>(isLinearQScale ? CQuantiserScaleTable::m_nTable0[qsc] : CQuantiserScaleTable::m_nTable1[qsc]);
+}
+
+static int16 GetIntraDcMultiplier(uint32 dcPrecision)
+{
+	switch(dcPrecision)
+	{
+	case 0:
+		return 8;
+	case 1:
+		return 4;
+	case 2:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+static int16 SaturateCoefficient(int16 value)
+{
+	return std::min<int16>(std::max<int16>(value, -2048), 2047);
+}
+
+//Coefficients after the last non-zero group of 8 are not moved, the rest of the block is cleared in bulk
+template <typename IsGroupZeroFunction>
+static void InverseScan_Sparse(int16* block, bool isZigZag, const IsGroupZeroFunction& isGroupZero)
+{
+	static const INVERSE_SCAN_TABLES tables;
+	const uint8* positions = isZigZag ? tables.zigZag : tables.alternate;
+
+	alignas(16) int16 temp[0x40];
+	memcpy(temp, block, sizeof(temp));
+	memset(block, 0, sizeof(temp));
+
+	unsigned int coeffCount = 64;
+	while((coeffCount != 0) && isGroupZero(temp + coeffCount - 8))
+	{
+		coeffCount -= 8;
+	}
+
+	for(unsigned int i = 0; i < coeffCount; i++)
+	{
+		block[positions[i]] = temp[i];
+	}
+}
+
+#endif
+
+#ifdef IPU_USE_SSE2
+
+static bool IsGroupZero_Sse2(const int16* values)
+{
+	__m128i group = _mm_load_si128(reinterpret_cast<const __m128i*>(values));
+	return _mm_movemask_epi8(_mm_cmpeq_epi16(group, _mm_setzero_si128())) == 0xFFFF;
+}
+
+static void InverseScan_Sse2(int16* block, bool isZigZag)
+{
+	InverseScan_Sparse(block, isZigZag, IsGroupZero_Sse2);
+}
+
+//Computes the low 32 bits of (a * b) for 8 lanes of 16-bit values
+static void MultiplyWiden_Sse2(__m128i a, __m128i b, __m128i& productLo, __m128i& productHi)
+{
+	__m128i lo = _mm_mullo_epi16(a, b);
+	__m128i hi = _mm_mulhi_epi16(a, b);
+	productLo = _mm_unpacklo_epi16(lo, hi);
+	productHi = _mm_unpackhi_epi16(lo, hi);
+}
+
+//Signed division by (1 << shift), rounding towards zero like C does
+template <int shift>
+static __m128i DivideTruncate_Sse2(__m128i value)
+{
+	__m128i bias = _mm_and_si128(_mm_srai_epi32(value, 31), _mm_set1_epi32((1 << shift) - 1));
+	return _mm_srai_epi32(_mm_add_epi32(value, bias), shift);
+}
+
+//Narrows 32-bit values to 16 bits, wrapping around like a conversion to int16 does
+static __m128i NarrowWrap_Sse2(__m128i lo, __m128i hi)
+{
+	lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+	hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+	return _mm_packs_epi32(lo, hi);
+}
+
+static void DequantiseBlock_Sse2(int16* block, bool isIntra, uint8 qsc, bool isLinearQScale, uint32 dcPrecision, const uint8* intraIq, const uint8* nonIntraIq)
+{
+	__m128i quantScale = _mm_set1_epi16(GetQuantiserScale(qsc, isLinearQScale));
+	const uint8* iq = isIntra ? intraIq : nonIntraIq;
+	int16 dcValue = block[0];
+
+	__m128i zero = _mm_setzero_si128();
+	__m128i one = _mm_set1_epi16(1);
+	__m128i minValue = _mm_set1_epi16(-2048);
+	__m128i maxValue = _mm_set1_epi16(2047);
+
+	for(unsigned int i = 0; i < 64; i += 8)
+	{
+		__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i));
+		//(iq * quantScale) is at most 255 * 112 and fits in 16 bits
+		__m128i scale = _mm_mullo_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(iq + i)), zero), quantScale);
+
+		__m128i isPositive = _mm_cmpgt_epi16(value, zero);
+		__m128i isNegative = _mm_cmplt_epi16(value, zero);
+		__m128i sign = _mm_or_si128(_mm_and_si128(isPositive, one), isNegative);
+
+		__m128i productLo, productHi;
+		MultiplyWiden_Sse2(value, scale, productLo, productHi);
+
+		if(isIntra)
+		{
+			//((value * scale * 2) / 32)
+			productLo = DivideTruncate_Sse2<4>(productLo);
+			productHi = DivideTruncate_Sse2<4>(productHi);
+		}
+		else
+		{
+			//(((value * 2) + sign) * scale) / 32, sign * scale is added separately to stay within 32 bits
+			__m128i scaleLo = _mm_unpacklo_epi16(scale, zero);
+			__m128i scaleHi = _mm_unpackhi_epi16(scale, zero);
+			__m128i signScaleLo = _mm_sub_epi32(_mm_and_si128(_mm_unpacklo_epi16(isPositive, isPositive), scaleLo), _mm_and_si128(_mm_unpacklo_epi16(isNegative, isNegative), scaleLo));
+			__m128i signScaleHi = _mm_sub_epi32(_mm_and_si128(_mm_unpackhi_epi16(isPositive, isPositive), scaleHi), _mm_and_si128(_mm_unpackhi_epi16(isNegative, isNegative), scaleHi));
+			productLo = DivideTruncate_Sse2<5>(_mm_add_epi32(_mm_add_epi32(productLo, productLo), signScaleLo));
+			productHi = DivideTruncate_Sse2<5>(_mm_add_epi32(_mm_add_epi32(productHi, productHi), signScaleHi));
+		}
+
+		__m128i result = NarrowWrap_Sse2(productLo, productHi);
+
+		//Make non-zero coefficients odd (mismatch control)
+		__m128i isNonZero = _mm_or_si128(isPositive, isNegative);
+		__m128i isEven = _mm_cmpeq_epi16(_mm_and_si128(result, one), zero);
+		__m128i oddResult = _mm_or_si128(_mm_sub_epi16(result, sign), one);
+		__m128i useOdd = _mm_and_si128(isNonZero, isEven);
+		result = _mm_or_si128(_mm_and_si128(useOdd, oddResult), _mm_andnot_si128(useOdd, result));
+
+		result = _mm_min_epi16(_mm_max_epi16(result, minValue), maxValue);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(block + i), result);
+	}
+
+	if(isIntra)
+	{
+		block[0] = SaturateCoefficient(static_cast<int16>(GetIntraDcMultiplier(dcPrecision) * dcValue));
+	}
+}
+
+//Rounds down two doubles to 32-bit integers (in the two lower lanes)
+static __m128i Floor_Sse2(__m128d value)
+{
+	__m128i truncated = _mm_cvttpd_epi32(value);
+	__m128d isBelow = _mm_cmplt_pd(value, _mm_cvtepi32_pd(truncated));
+	return _mm_add_epi32(truncated, _mm_shuffle_epi32(_mm_castpd_si128(isBelow), _MM_SHUFFLE(3, 3, 2, 0)));
+}
+
+static void Idct_Sse2(const int16* input, int16* output)
+{
+	const auto& c = g_idctTable.c;
+	alignas(16) double temp[64];
+	uint32 nonZeroRows = 0;
+
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		const int16* row = input + (i * 8);
+		__m128i rowValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row));
+		if(_mm_movemask_epi8(_mm_cmpeq_epi16(rowValues, _mm_setzero_si128())) == 0xFFFF) continue;
+		nonZeroRows |= (1 << i);
+
+		__m128d sum0 = _mm_setzero_pd();
+		__m128d sum1 = _mm_setzero_pd();
+		__m128d sum2 = _mm_setzero_pd();
+		__m128d sum3 = _mm_setzero_pd();
+		for(unsigned int k = 0; k < 8; k++)
+		{
+			__m128d value = _mm_set1_pd(row[k]);
+			sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_load_pd(c[k] + 0), value));
+			sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_load_pd(c[k] + 2), value));
+			sum2 = _mm_add_pd(sum2, _mm_mul_pd(_mm_load_pd(c[k] + 4), value));
+			sum3 = _mm_add_pd(sum3, _mm_mul_pd(_mm_load_pd(c[k] + 6), value));
+		}
+		_mm_store_pd(temp + (i * 8) + 0, sum0);
+		_mm_store_pd(temp + (i * 8) + 2, sum1);
+		_mm_store_pd(temp + (i * 8) + 4, sum2);
+		_mm_store_pd(temp + (i * 8) + 6, sum3);
+	}
+
+	if(nonZeroRows == 0)
+	{
+		memset(output, 0, sizeof(int16) * 0x40);
+		return;
+	}
+
+	__m128d half = _mm_set1_pd(0.5);
+	__m128i minValue = _mm_set1_epi16(-256);
+	__m128i maxValue = _mm_set1_epi16(255);
+
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		__m128d sum0 = _mm_setzero_pd();
+		__m128d sum1 = _mm_setzero_pd();
+		__m128d sum2 = _mm_setzero_pd();
+		__m128d sum3 = _mm_setzero_pd();
+		for(unsigned int k = 0; k < 8; k++)
+		{
+			if((nonZeroRows & (1 << k)) == 0) continue;
+			__m128d coeff = _mm_set1_pd(c[k][i]);
+			sum0 = _mm_add_pd(sum0, _mm_mul_pd(coeff, _mm_load_pd(temp + (k * 8) + 0)));
+			sum1 = _mm_add_pd(sum1, _mm_mul_pd(coeff, _mm_load_pd(temp + (k * 8) + 2)));
+			sum2 = _mm_add_pd(sum2, _mm_mul_pd(coeff, _mm_load_pd(temp + (k * 8) + 4)));
+			sum3 = _mm_add_pd(sum3, _mm_mul_pd(coeff, _mm_load_pd(temp + (k * 8) + 6)));
+		}
+
+		__m128i result0 = _mm_unpacklo_epi64(Floor_Sse2(_mm_add_pd(sum0, half)), Floor_Sse2(_mm_add_pd(sum1, half)));
+		__m128i result1 = _mm_unpacklo_epi64(Floor_Sse2(_mm_add_pd(sum2, half)), Floor_Sse2(_mm_add_pd(sum3, half)));
+		__m128i result = _mm_min_epi16(_mm_max_epi16(_mm_packs_epi32(result0, result1), minValue), maxValue);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(output + (i * 8)), result);
+	}
+}
+
+//Converts 4 pixels, inputs are 32-bit lanes holding 8-bit values
+static __m128i ConvertPixels_Sse2(__m128i y, __m128i cb, __m128i cr, __m128i alphaTh0, __m128i alphaTh1)
+{
+	__m128 bias = _mm_set1_ps(128.0f);
+	__m128 minValue = _mm_setzero_ps();
+	__m128 maxValue = _mm_set1_ps(255.0f);
+
+	__m128 nY = _mm_cvtepi32_ps(y);
+	__m128 nCb = _mm_sub_ps(_mm_cvtepi32_ps(cb), bias);
+	__m128 nCr = _mm_sub_ps(_mm_cvtepi32_ps(cr), bias);
+
+	__m128 nR = _mm_add_ps(nY, _mm_mul_ps(_mm_set1_ps(1.402f), nCr));
+	__m128 nG = _mm_sub_ps(_mm_sub_ps(nY, _mm_mul_ps(_mm_set1_ps(0.34414f), nCb)), _mm_mul_ps(_mm_set1_ps(0.71414f), nCr));
+	__m128 nB = _mm_add_ps(nY, _mm_mul_ps(_mm_set1_ps(1.772f), nCb));
+
+	__m128i r = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(nR, minValue), maxValue));
+	__m128i g = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(nG, minValue), maxValue));
+	__m128i b = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(nB, minValue), maxValue));
+	__m128i rgb = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_slli_epi32(b, 16));
+
+	__m128i belowTh0 = _mm_cmplt_epi32(rgb, alphaTh0);
+	__m128i belowTh1 = _mm_cmplt_epi32(rgb, alphaTh1);
+	__m128i alpha = _mm_or_si128(_mm_and_si128(belowTh1, _mm_set1_epi32(0x40 << 24)), _mm_andnot_si128(belowTh1, _mm_set1_epi32(0x80 << 24)));
+	alpha = _mm_andnot_si128(belowTh0, alpha);
+
+	return _mm_or_si128(rgb, alpha);
+}
+
+template <typename PixelWriter>
+static void ConvertMacroblock_Sse2(const uint8* block, uint16 th0, uint16 th1, const PixelWriter& writePixels)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i alphaTh0 = _mm_set1_epi32((th0 & 0xFF) * 0x010101);
+	__m128i alphaTh1 = _mm_set1_epi32((th1 & 0xFF) * 0x010101);
+
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		__m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + (i * 0x10)));
+		__m128i cb = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block + MACROBLOCK_CB_OFFSET + ((i / 2) * 8)));
+		__m128i cr = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(block + MACROBLOCK_CR_OFFSET + ((i / 2) * 8)));
+
+		//Chroma is shared by pairs of pixels
+		cb = _mm_unpacklo_epi8(cb, cb);
+		cr = _mm_unpacklo_epi8(cr, cr);
+
+		__m128i y16[2] = {_mm_unpacklo_epi8(y, zero), _mm_unpackhi_epi8(y, zero)};
+		__m128i cb16[2] = {_mm_unpacklo_epi8(cb, zero), _mm_unpackhi_epi8(cb, zero)};
+		__m128i cr16[2] = {_mm_unpacklo_epi8(cr, zero), _mm_unpackhi_epi8(cr, zero)};
+
+		__m128i pixels[4];
+		for(unsigned int j = 0; j < 2; j++)
+		{
+			pixels[(j * 2) + 0] = ConvertPixels_Sse2(
+			    _mm_unpacklo_epi16(y16[j], zero), _mm_unpacklo_epi16(cb16[j], zero), _mm_unpacklo_epi16(cr16[j], zero), alphaTh0, alphaTh1);
+			pixels[(j * 2) + 1] = ConvertPixels_Sse2(
+			    _mm_unpackhi_epi16(y16[j], zero), _mm_unpackhi_epi16(cb16[j], zero), _mm_unpackhi_epi16(cr16[j], zero), alphaTh0, alphaTh1);
+		}
+
+		writePixels(i, pixels);
+	}
+}
+
+static void ConvertRgba32_Sse2(const uint8* block, uint32* pixels, uint16 th0, uint16 th1)
+{
+	ConvertMacroblock_Sse2(block, th0, th1,
+	                       [pixels](unsigned int row, const __m128i* rowPixels) {
+		                       for(unsigned int i = 0; i < 4; i++)
+		                       {
+			                       _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + (row * 0x10) + (i * 4)), rowPixels[i]);
+		                       }
+	                       });
+}
+
+static __m128i ConvertPixelsToRgba16_Sse2(__m128i pixels)
+{
+	__m128i mask = _mm_set1_epi32(0x1F);
+	__m128i r = _mm_and_si128(_mm_srli_epi32(pixels, 3), mask);
+	__m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 11), mask);
+	__m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 19), mask);
+	__m128i a = _mm_and_si128(_mm_cmpeq_epi32(_mm_srli_epi32(pixels, 24), _mm_set1_epi32(0x40)), _mm_set1_epi32(0x8000));
+	return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 5)), _mm_or_si128(_mm_slli_epi32(b, 10), a));
+}
+
+static void ConvertRgba16_Sse2(const uint8* block, uint16* pixels, uint16 th0, uint16 th1)
+{
+	ConvertMacroblock_Sse2(block, th0, th1,
+	                       [pixels](unsigned int row, const __m128i* rowPixels) {
+		                       for(unsigned int i = 0; i < 4; i += 2)
+		                       {
+			                       __m128i result = NarrowWrap_Sse2(ConvertPixelsToRgba16_Sse2(rowPixels[i + 0]), ConvertPixelsToRgba16_Sse2(rowPixels[i + 1]));
+			                       _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + (row * 0x10) + (i * 4)), result);
+		                       }
+	                       });
+}
+
+static const KERNELS g_simdKernels =
+    {
+        "SSE2",
+        &InverseScan_Sse2,
+        &DequantiseBlock_Sse2,
+        &Idct_Sse2,
+        &ConvertRgba32_Sse2,
+        &ConvertRgba16_Sse2,
+};
+
+#endif
+
+#ifdef IPU_USE_NEON
+
+static bool IsGroupZero_Neon(const int16* values)
+{
+	return vmaxvq_u16(vreinterpretq_u16_s16(vld1q_s16(values))) == 0;
+}
+
+static void InverseScan_Neon(int16* block, bool isZigZag)
+{
+	InverseScan_Sparse(block, isZigZag, IsGroupZero_Neon);
+}
+
+//Signed division by (1 << shift), rounding towards zero like C does
+template <int shift>
+static int32x4_t DivideTruncate_Neon(int32x4_t value)
+{
+	int32x4_t bias = vandq_s32(vshrq_n_s32(value, 31), vdupq_n_s32((1 << shift) - 1));
+	return vshrq_n_s32(vaddq_s32(value, bias), shift);
+}
+
+static void DequantiseBlock_Neon(int16* block, bool isIntra, uint8 qsc, bool isLinearQScale, uint32 dcPrecision, const uint8* intraIq, const uint8* nonIntraIq)
+{
+	int16x8_t quantScale = vdupq_n_s16(GetQuantiserScale(qsc, isLinearQScale));
+	const uint8* iq = isIntra ? intraIq : nonIntraIq;
+	int16 dcValue = block[0];
+
+	int16x8_t zero = vdupq_n_s16(0);
+	int16x8_t one = vdupq_n_s16(1);
+
+	for(unsigned int i = 0; i < 64; i += 8)
+	{
+		int16x8_t value = vld1q_s16(block + i);
+		//(iq * quantScale) is at most 255 * 112 and fits in 16 bits
+		int16x8_t scale = vmulq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(iq + i))), quantScale);
+
+		int16x8_t isPositive = vreinterpretq_s16_u16(vcgtq_s16(value, zero));
+		int16x8_t isNegative = vreinterpretq_s16_u16(vcltq_s16(value, zero));
+		int16x8_t sign = vorrq_s16(vandq_s16(isPositive, one), isNegative);
+
+		int32x4_t productLo = vmull_s16(vget_low_s16(value), vget_low_s16(scale));
+		int32x4_t productHi = vmull_s16(vget_high_s16(value), vget_high_s16(scale));
+
+		if(isIntra)
+		{
+			//((value * scale * 2) / 32)
+			productLo = DivideTruncate_Neon<4>(productLo);
+			productHi = DivideTruncate_Neon<4>(productHi);
+		}
+		else
+		{
+			//(((value * 2) + sign) * scale) / 32
+			productLo = DivideTruncate_Neon<5>(vmlal_s16(vaddq_s32(productLo, productLo), vget_low_s16(sign), vget_low_s16(scale)));
+			productHi = DivideTruncate_Neon<5>(vmlal_s16(vaddq_s32(productHi, productHi), vget_high_s16(sign), vget_high_s16(scale)));
+		}
+
+		int16x8_t result = vcombine_s16(vmovn_s32(productLo), vmovn_s32(productHi));
+
+		//Make non-zero coefficients odd (mismatch control)
+		uint16x8_t isNonZero = vreinterpretq_u16_s16(vorrq_s16(isPositive, isNegative));
+		uint16x8_t isEven = vceqq_s16(vandq_s16(result, one), zero);
+		int16x8_t oddResult = vorrq_s16(vsubq_s16(result, sign), one);
+		result = vbslq_s16(vandq_u16(isNonZero, isEven), oddResult, result);
+
+		result = vminq_s16(vmaxq_s16(result, vdupq_n_s16(-2048)), vdupq_n_s16(2047));
+		vst1q_s16(block + i, result);
+	}
+
+	if(isIntra)
+	{
+		block[0] = SaturateCoefficient(static_cast<int16>(GetIntraDcMultiplier(dcPrecision) * dcValue));
+	}
+}
+
+static int16x4_t Floor_Neon(float64x2_t value0, float64x2_t value1)
+{
+	int32x4_t result = vcombine_s32(vmovn_s64(vcvtmq_s64_f64(value0)), vmovn_s64(vcvtmq_s64_f64(value1)));
+	return vqmovn_s32(result);
+}
+
+static void Idct_Neon(const int16* input, int16* output)
+{
+	const auto& c = g_idctTable.c;
+	alignas(16) double temp[64];
+	uint32 nonZeroRows = 0;
+
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		const int16* row = input + (i * 8);
+		if(vmaxvq_u16(vreinterpretq_u16_s16(vld1q_s16(row))) == 0) continue;
+		nonZeroRows |= (1 << i);
+
+		float64x2_t sum[4] = {vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0)};
+		for(unsigned int k = 0; k < 8; k++)
+		{
+			float64x2_t value = vdupq_n_f64(row[k]);
+			for(unsigned int j = 0; j < 4; j++)
+			{
+				sum[j] = vaddq_f64(sum[j], vmulq_f64(vld1q_f64(c[k] + (j * 2)), value));
+			}
+		}
+		for(unsigned int j = 0; j < 4; j++)
+		{
+			vst1q_f64(temp + (i * 8) + (j * 2), sum[j]);
+		}
+	}
+
+	if(nonZeroRows == 0)
+	{
+		memset(output, 0, sizeof(int16) * 0x40);
+		return;
+	}
+
+	float64x2_t half = vdupq_n_f64(0.5);
+
+	for(unsigned int i = 0; i < 8; i++)
+	{
+		float64x2_t sum[4] = {vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0), vdupq_n_f64(0)};
+		for(unsigned int k = 0; k < 8; k++)
+		{
+			if((nonZeroRows & (1 << k)) == 0) continue;
+			float64x2_t coeff = vdupq_n_f64(c[k][i]);
+			for(unsigned int j = 0; j < 4; j++)
+			{
+				sum[j] = vaddq_f64(sum[j], vmulq_f64(coeff, vld1q_f64(temp + (k * 8) + (j * 2))));
+			}
+		}
+
+		int16x8_t result = vcombine_s16(
+		    Floor_Neon(vaddq_f64(sum[0], half), vaddq_f64(sum[1], half)),
+		    Floor_Neon(vaddq_f64(sum[2], half), vaddq_f64(sum[3], half)));
+		result = vminq_s16(vmaxq_s16(result, vdupq_n_s16(-256)), vdupq_n_s16(255));
+		vst1q_s16(output + (i * 8), result);
+	}
+}
+
+//Converts 4 pixels, inputs are 32-bit lanes holding 8-bit values
+static uint32x4_t ConvertPixels_Neon(uint32x4_t y, uint32x4_t cb, uint32x4_t cr, uint32x4_t alphaTh0, uint32x4_t alphaTh1)
+{
+	float32x4_t bias = vdupq_n_f32(128.0f);
+	float32x4_t minValue = vdupq_n_f32(0.0f);
+	float32x4_t maxValue = vdupq_n_f32(255.0f);
+
+	float32x4_t nY = vcvtq_f32_u32(y);
+	float32x4_t nCb = vsubq_f32(vcvtq_f32_u32(cb), bias);
+	float32x4_t nCr = vsubq_f32(vcvtq_f32_u32(cr), bias);
+
+	float32x4_t nR = vaddq_f32(nY, vmulq_f32(vdupq_n_f32(1.402f), nCr));
+	float32x4_t nG = vsubq_f32(vsubq_f32(nY, vmulq_f32(vdupq_n_f32(0.34414f), nCb)), vmulq_f32(vdupq_n_f32(0.71414f), nCr));
+	float32x4_t nB = vaddq_f32(nY, vmulq_f32(vdupq_n_f32(1.772f), nCb));
+
+	uint32x4_t r = vcvtq_u32_f32(vminq_f32(vmaxq_f32(nR, minValue), maxValue));
+	uint32x4_t g = vcvtq_u32_f32(vminq_f32(vmaxq_f32(nG, minValue), maxValue));
+	uint32x4_t b = vcvtq_u32_f32(vminq_f32(vmaxq_f32(nB, minValue), maxValue));
+	uint32x4_t rgb = vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 8)), vshlq_n_u32(b, 16));
+
+	uint32x4_t alpha = vbslq_u32(vcltq_u32(rgb, alphaTh1), vdupq_n_u32(0x40 << 24), vdupq_n_u32(0x80U << 24));
+	alpha = vbicq_u32(alpha, vcltq_u32(rgb, alphaTh0));
+
+	return vorrq_u32(rgb, alpha);
+}
+
+template <typename PixelWriter>
+static void ConvertMacroblock_Neon(const uint8* block, uint16 th0, uint16 th1, const PixelWriter& writePixels)
+{
+	uint32x4_t alphaTh0 = vdupq_n_u32((th0 & 0xFF) * 0x010101);
+	uint32x4_t alphaTh1 = vdupq_n_u32((th1 & 0xFF) * 0x010101);
+
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		uint8x16_t y = vld1q_u8(block + (i * 0x10));
+		uint8x8_t cb = vld1_u8(block + MACROBLOCK_CB_OFFSET + ((i / 2) * 8));
+		uint8x8_t cr = vld1_u8(block + MACROBLOCK_CR_OFFSET + ((i / 2) * 8));
+
+		//Chroma is shared by pairs of pixels
+		uint16x8_t y16[2] = {vmovl_u8(vget_low_u8(y)), vmovl_u8(vget_high_u8(y))};
+		uint16x8_t cb16[2] = {vmovl_u8(vzip1_u8(cb, cb)), vmovl_u8(vzip2_u8(cb, cb))};
+		uint16x8_t cr16[2] = {vmovl_u8(vzip1_u8(cr, cr)), vmovl_u8(vzip2_u8(cr, cr))};
+
+		uint32x4_t pixels[4];
+		for(unsigned int j = 0; j < 2; j++)
+		{
+			pixels[(j * 2) + 0] = ConvertPixels_Neon(
+			    vmovl_u16(vget_low_u16(y16[j])), vmovl_u16(vget_low_u16(cb16[j])), vmovl_u16(vget_low_u16(cr16[j])), alphaTh0, alphaTh1);
+			pixels[(j * 2) + 1] = ConvertPixels_Neon(
+			    vmovl_u16(vget_high_u16(y16[j])), vmovl_u16(vget_high_u16(cb16[j])), vmovl_u16(vget_high_u16(cr16[j])), alphaTh0, alphaTh1);
+		}
+
+		writePixels(i, pixels);
+	}
+}
+
+static void ConvertRgba32_Neon(const uint8* block, uint32* pixels, uint16 th0, uint16 th1)
+{
+	ConvertMacroblock_Neon(block, th0, th1,
+	                       [pixels](unsigned int row, const uint32x4_t* rowPixels) {
+		                       for(unsigned int i = 0; i < 4; i++)
+		                       {
+			                       vst1q_u32(pixels + (row * 0x10) + (i * 4), rowPixels[i]);
+		                       }
+	                       });
+}
+
+static uint16x4_t ConvertPixelsToRgba16_Neon(uint32x4_t pixels)
+{
+	uint32x4_t mask = vdupq_n_u32(0x1F);
+	uint32x4_t r = vandq_u32(vshrq_n_u32(pixels, 3), mask);
+	uint32x4_t g = vandq_u32(vshrq_n_u32(pixels, 11), mask);
+	uint32x4_t b = vandq_u32(vshrq_n_u32(pixels, 19), mask);
+	uint32x4_t a = vandq_u32(vceqq_u32(vshrq_n_u32(pixels, 24), vdupq_n_u32(0x40)), vdupq_n_u32(0x8000));
+	return vmovn_u32(vorrq_u32(vorrq_u32(r, vshlq_n_u32(g, 5)), vorrq_u32(vshlq_n_u32(b, 10), a)));
+}
+
+static void ConvertRgba16_Neon(const uint8* block, uint16* pixels, uint16 th0, uint16 th1)
+{
+	ConvertMacroblock_Neon(block, th0, th1,
+	                       [pixels](unsigned int row, const uint32x4_t* rowPixels) {
+		                       for(unsigned int i = 0; i < 4; i++)
+		                       {
+			                       vst1_u16(pixels + (row * 0x10) + (i * 4), ConvertPixelsToRgba16_Neon(rowPixels[i]));
+		                       }
+	                       });
+}
+
+static const KERNELS g_simdKernels =
+    {
+        "NEON",
+        &InverseScan_Neon,
+        &DequantiseBlock_Neon,
+        &Idct_Neon,
+        &ConvertRgba32_Neon,
+        &ConvertRgba16_Neon,
+};
+
+#endif
+
+static const KERNELS g_scalarKernels =
+    {
+        "Scalar",
+        &InverseScan_Scalar,
+        &DequantiseBlock_Scalar,
+        &Idct_Scalar,
+        &ConvertRgba32_Scalar,
+        &ConvertRgba16_Scalar,
+};
+
+const KERNELS& IPU::GetScalarKernels()
+{
+	return g_scalarKernels;
+}
+
+const KERNELS* IPU::GetSimdKernels()
+{
+#if defined(IPU_USE_SSE2) || defined(IPU_USE_NEON)
+	return &g_simdKernels;
+#else
+	return nullptr;
+#endif
+}
+
+const KERNELS& IPU::GetDefaultKernels()
+{
+	auto simdKernels = GetSimdKernels();
+	return simdKernels ? *simdKernels : g_scalarKernels;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Types.h"
+
+namespace IPU
+{
+	//Block and macroblock operations used by the BDEC, IDEC and CSC commands.
+	//The SIMD set gives the exact same results as the scalar set, which is kept as a reference and as a fallback.
+	struct KERNELS
+	{
+		typedef void (*InverseScanFunction)(int16*, bool isZigZag);
+		typedef void (*DequantiseBlockFunction)(int16*, bool isIntra, uint8 qsc, bool isLinearQScale, uint32 dcPrecision, const uint8* intraIq, const uint8* nonIntraIq);
+		typedef void (*IdctFunction)(const int16*, int16*);
+		//Converts a RAW8 macroblock (256 Y, 64 Cb, 64 Cr) to 256 pixels
+		typedef void (*ConvertRgba32Function)(const uint8*, uint32*, uint16 th0, uint16 th1);
+		typedef void (*ConvertRgba16Function)(const uint8*, uint16*, uint16 th0, uint16 th1);
+
+		const char* name;
+		InverseScanFunction inverseScan;
+		DequantiseBlockFunction dequantiseBlock;
+		IdctFunction idct;
+		ConvertRgba32Function convertRgba32;
+		ConvertRgba16Function convertRgba16;
+	};
+
+	const KERNELS& GetScalarKernels();
+	//Returns nullptr if there is no SIMD implementation for the target
+	const KERNELS* GetSimdKernels();
+	const KERNELS& GetDefaultKernels();
+}
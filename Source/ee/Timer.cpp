@@ -1,4 +1,5 @@
 #include <cstring>
+#include <algorithm>
 #include <stdio.h>
 #include "../Log.h"
 #include "../states/RegisterStateFile.h"
@@ -30,23 +31,7 @@ void CTimer::Count(unsigned int ticks)
 		uint32 previousCount = timer.nCOUNT;
 		uint32 nextCount = timer.nCOUNT;
 
-		uint32 divider = 1;
-		//BUSCLOCK runs at half EE frequency
-		switch(timer.nMODE & MODE_CLOCK_SELECT)
-		{
-		case MODE_CLOCK_SELECT_BUSCLOCK:
-			divider = 1 * 2;
-			break;
-		case MODE_CLOCK_SELECT_BUSCLOCK16:
-			divider = 16 * 2;
-			break;
-		case MODE_CLOCK_SELECT_BUSCLOCK256:
-			divider = 256 * 2;
-			break;
-		case MODE_CLOCK_SELECT_EXTERNAL:
-			divider = 9437; // PAL
-			break;
-		}
+		uint32 divider = GetClockDivider(timer);
 
 		//Compute increment
 		uint32 totalTicks = timer.clockRemain + ticks;
@@ -91,6 +76,55 @@ void CTimer::Count(unsigned int ticks)
 	}
 }
 
+uint32 CTimer::GetTicksUntilNextInterrupt() const
+{
+	//Only an estimate used to end execution slices close to timer interrupts,
+	//Count is still what raises them
+	uint32 result = UINT32_MAX;
+	for(unsigned int i = 0; i < MAX_TIMER; i++)
+	{
+		const auto& timer = m_timer[i];
+
+		if(!(timer.nMODE & MODE_COUNT_ENABLE)) continue;
+
+		uint32 divider = GetClockDivider(timer);
+		uint32 compare = (timer.nCOMP == 0) ? 0x10000 : timer.nCOMP;
+		uint32 count = timer.nCOUNT & 0xFFFF;
+
+		uint32 targetCount = UINT32_MAX;
+		if((timer.nMODE & MODE_EQUAL_INTERRUPT) && (count < compare))
+		{
+			targetCount = compare;
+		}
+		if(timer.nMODE & MODE_OVERFLOW_INTERRUPT)
+		{
+			targetCount = std::min<uint32>(targetCount, 0xFFFF);
+		}
+		if((targetCount == UINT32_MAX) || (targetCount <= count)) continue;
+
+		uint32 ticks = ((targetCount - count) * divider) - std::min(timer.clockRemain, divider - 1);
+		result = std::min(result, ticks);
+	}
+	return result;
+}
+
+uint32 CTimer::GetClockDivider(const TIMER& timer)
+{
+	//BUSCLOCK runs at half EE frequency
+	switch(timer.nMODE & MODE_CLOCK_SELECT)
+	{
+	default:
+	case MODE_CLOCK_SELECT_BUSCLOCK:
+		return 1 * 2;
+	case MODE_CLOCK_SELECT_BUSCLOCK16:
+		return 16 * 2;
+	case MODE_CLOCK_SELECT_BUSCLOCK256:
+		return 256 * 2;
+	case MODE_CLOCK_SELECT_EXTERNAL:
+		return 9437; // PAL
+	}
+}
+
 uint32 CTimer::GetRegister(uint32 nAddress)
 {
 	DisassembleGet(nAddress);
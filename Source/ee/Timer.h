@@ -31,6 +31,8 @@ public:
 
 		MODE_ZERO_RETURN = 0x040,
 		MODE_COUNT_ENABLE = 0x080,
+		MODE_EQUAL_INTERRUPT = 0x100,
+		MODE_OVERFLOW_INTERRUPT = 0x200,
 		MODE_EQUAL_FLAG = 0x400,
 		MODE_OVERFLOW_FLAG = 0x800,
 	};
@@ -46,6 +48,7 @@ public:
 	void Reset();
 
 	void Count(unsigned int);
+	uint32 GetTicksUntilNextInterrupt() const;
 
 	uint32 GetRegister(uint32);
 	void SetRegister(uint32, uint32);
@@ -77,6 +80,8 @@ private:
 		uint32 clockRemain;
 	};
 
+	static uint32 GetClockDivider(const TIMER&);
+
 	TIMER m_timer[MAX_TIMER];
 	CINTC& m_intc;
 };
@@ -11,6 +11,14 @@
 #include "Vif.h"
 #include "INTC.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define VIF_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define VIF_USE_NEON
+#include <arm_neon.h>
+#endif
+
 #define LOG_NAME ("ee_vif")
 
 #define STATE_PATH_REGS_FORMAT ("vpu/vif_%d.xml")
@@ -37,6 +45,396 @@
 #define STATE_REGS_WRITETICK ("writeTick")
 #define STATE_REGS_FIFOINDEX ("fifoIndex")
 
+//Helpers used by bulk unpackers, 4 lanes of 32 bits
+#ifdef VIF_USE_SSE2
+
+typedef __m128i UnpackVector;
+
+static inline UnpackVector UnpackVector_Load(const void* src)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+static inline void UnpackVector_Store(void* dst, UnpackVector value)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value);
+}
+
+static inline UnpackVector UnpackVector_Set(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	return _mm_setr_epi32(x, y, z, w);
+}
+
+static inline UnpackVector UnpackVector_Splat(uint32 value)
+{
+	return _mm_set1_epi32(value);
+}
+
+static inline UnpackVector UnpackVector_Add(UnpackVector a, UnpackVector b)
+{
+	return _mm_add_epi32(a, b);
+}
+
+//Returns (mask ? a : b) for every bit
+static inline UnpackVector UnpackVector_Select(UnpackVector mask, UnpackVector a, UnpackVector b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static inline UnpackVector UnpackVector_And(UnpackVector a, UnpackVector b)
+{
+	return _mm_and_si128(a, b);
+}
+
+static inline UnpackVector UnpackVector_Or(UnpackVector a, UnpackVector b)
+{
+	return _mm_or_si128(a, b);
+}
+
+template <bool zeroExtend>
+static inline UnpackVector UnpackVector_ExpandBytes(uint32 bytes)
+{
+	auto value = _mm_cvtsi32_si128(bytes);
+	if(zeroExtend)
+	{
+		auto zero = _mm_setzero_si128();
+		return _mm_unpacklo_epi16(_mm_unpacklo_epi8(value, zero), zero);
+	}
+	else
+	{
+		value = _mm_unpacklo_epi8(value, value);
+		return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 24);
+	}
+}
+
+//Loads 2 or 3 words, other fields are cleared
+template <uint32 fieldCount>
+static inline UnpackVector UnpackVector_LoadFields(const uint8* src)
+{
+	auto value = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+	if(fieldCount == 3)
+	{
+		uint32 field = 0;
+		memcpy(&field, src + 8, 4);
+		value = _mm_unpacklo_epi64(value, _mm_cvtsi32_si128(field));
+	}
+	return value;
+}
+
+template <bool zeroExtend>
+static inline UnpackVector UnpackVector_ExpandHalves(uint32 lowHalves, uint32 highHalves)
+{
+	//Built in registers, going through memory would stall on store forwarding
+	auto value = _mm_unpacklo_epi32(_mm_cvtsi32_si128(lowHalves), _mm_cvtsi32_si128(highHalves));
+	if(zeroExtend)
+	{
+		return _mm_unpacklo_epi16(value, _mm_setzero_si128());
+	}
+	else
+	{
+		return _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+	}
+}
+
+#elif defined(VIF_USE_NEON)
+
+typedef uint32x4_t UnpackVector;
+
+static inline UnpackVector UnpackVector_Load(const void* src)
+{
+	return vld1q_u32(reinterpret_cast<const uint32_t*>(src));
+}
+
+static inline void UnpackVector_Store(void* dst, UnpackVector value)
+{
+	vst1q_u32(reinterpret_cast<uint32_t*>(dst), value);
+}
+
+static inline UnpackVector UnpackVector_Set(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	uint32 values[4] = {x, y, z, w};
+	return vld1q_u32(values);
+}
+
+static inline UnpackVector UnpackVector_Splat(uint32 value)
+{
+	return vdupq_n_u32(value);
+}
+
+static inline UnpackVector UnpackVector_Add(UnpackVector a, UnpackVector b)
+{
+	return vaddq_u32(a, b);
+}
+
+//Returns (mask ? a : b) for every bit
+static inline UnpackVector UnpackVector_Select(UnpackVector mask, UnpackVector a, UnpackVector b)
+{
+	return vbslq_u32(mask, a, b);
+}
+
+static inline UnpackVector UnpackVector_And(UnpackVector a, UnpackVector b)
+{
+	return vandq_u32(a, b);
+}
+
+static inline UnpackVector UnpackVector_Or(UnpackVector a, UnpackVector b)
+{
+	return vorrq_u32(a, b);
+}
+
+template <bool zeroExtend>
+static inline UnpackVector UnpackVector_ExpandBytes(uint32 bytes)
+{
+	auto value = vdup_n_u32(bytes);
+	if(zeroExtend)
+	{
+		return vmovl_u16(vget_low_u16(vmovl_u8(vreinterpret_u8_u32(value))));
+	}
+	else
+	{
+		return vreinterpretq_u32_s32(vmovl_s16(vget_low_s16(vmovl_s8(vreinterpret_s8_u32(value)))));
+	}
+}
+
+//Loads 2 or 3 words, other fields are cleared
+template <uint32 fieldCount>
+static inline UnpackVector UnpackVector_LoadFields(const uint8* src)
+{
+	auto value = vcombine_u32(vld1_u32(reinterpret_cast<const uint32_t*>(src)), vdup_n_u32(0));
+	if(fieldCount == 3)
+	{
+		uint32 field = 0;
+		memcpy(&field, src + 8, 4);
+		value = vsetq_lane_u32(field, value, 2);
+	}
+	return value;
+}
+
+template <bool zeroExtend>
+static inline UnpackVector UnpackVector_ExpandHalves(uint32 lowHalves, uint32 highHalves)
+{
+	auto value = vset_lane_u32(highHalves, vdup_n_u32(lowHalves), 1);
+	if(zeroExtend)
+	{
+		return vmovl_u16(vreinterpret_u16_u32(value));
+	}
+	else
+	{
+		return vreinterpretq_u32_s32(vmovl_s16(vreinterpret_s16_u32(value)));
+	}
+}
+
+#else
+
+struct UnpackVector
+{
+	uint32 v[4];
+};
+
+static inline UnpackVector UnpackVector_Load(const void* src)
+{
+	UnpackVector result;
+	memcpy(result.v, src, sizeof(result.v));
+	return result;
+}
+
+static inline void UnpackVector_Store(void* dst, UnpackVector value)
+{
+	memcpy(dst, value.v, sizeof(value.v));
+}
+
+static inline UnpackVector UnpackVector_Set(uint32 x, uint32 y, uint32 z, uint32 w)
+{
+	return UnpackVector{{x, y, z, w}};
+}
+
+static inline UnpackVector UnpackVector_Splat(uint32 value)
+{
+	return UnpackVector{{value, value, value, value}};
+}
+
+static inline UnpackVector UnpackVector_Add(UnpackVector a, UnpackVector b)
+{
+	return UnpackVector{{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]}};
+}
+
+static inline UnpackVector UnpackVector_Select(UnpackVector mask, UnpackVector a, UnpackVector b)
+{
+	UnpackVector result;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		result.v[i] = (mask.v[i] & a.v[i]) | (~mask.v[i] & b.v[i]);
+	}
+	return result;
+}
+
+static inline UnpackVector UnpackVector_And(UnpackVector a, UnpackVector b)
+{
+	return UnpackVector{{a.v[0] & b.v[0], a.v[1] & b.v[1], a.v[2] & b.v[2], a.v[3] & b.v[3]}};
+}
+
+static inline UnpackVector UnpackVector_Or(UnpackVector a, UnpackVector b)
+{
+	return UnpackVector{{a.v[0] | b.v[0], a.v[1] | b.v[1], a.v[2] | b.v[2], a.v[3] | b.v[3]}};
+}
+
+template <bool zeroExtend>
+static inline UnpackVector UnpackVector_ExpandBytes(uint32 bytes)
+{
+	UnpackVector result;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		uint8 value = static_cast<uint8>(bytes >> (i * 8));
+		result.v[i] = zeroExtend ? value : static_cast<int8>(value);
+	}
+	return result;
+}
+
+template <uint32 fieldCount>
+static inline UnpackVector UnpackVector_LoadFields(const uint8* src)
+{
+	UnpackVector result = {};
+	memcpy(result.v, src, fieldCount * 4);
+	return result;
+}
+
+template <bool zeroExtend>
+static inline UnpackVector UnpackVector_ExpandHalves(uint32 lowHalves, uint32 highHalves)
+{
+	UnpackVector result;
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		uint16 value = static_cast<uint16>(((i < 2) ? lowHalves : highHalves) >> ((i & 1) * 16));
+		result.v[i] = zeroExtend ? value : static_cast<int16>(value);
+	}
+	return result;
+}
+
+#endif
+
+//Decodes a single UNPACK element, unused fields are cleared
+template <uint32 dataType, bool zeroExtend>
+static inline UnpackVector UnpackVector_ReadElement(const uint8* src)
+{
+	switch(dataType)
+	{
+	case 0x00:
+	{
+		//S-32
+		uint32 value = 0;
+		memcpy(&value, src, 4);
+		return UnpackVector_Splat(value);
+	}
+	case 0x01:
+	{
+		//S-16
+		uint16 value = 0;
+		memcpy(&value, src, 2);
+		return UnpackVector_Splat(zeroExtend ? value : static_cast<int16>(value));
+	}
+	case 0x02:
+	{
+		//S-8
+		uint8 value = src[0];
+		return UnpackVector_Splat(zeroExtend ? value : static_cast<int8>(value));
+	}
+	case 0x04:
+		//V2-32
+		return UnpackVector_LoadFields<2>(src);
+	case 0x08:
+		//V3-32
+		return UnpackVector_LoadFields<3>(src);
+	case 0x0C:
+		//V4-32
+		return UnpackVector_Load(src);
+	case 0x05:
+	case 0x09:
+	case 0x0D:
+	{
+		//V2-16, V3-16, V4-16
+		uint32 lowHalves = 0;
+		uint32 highHalves = 0;
+		memcpy(&lowHalves, src, 4);
+		if(dataType != 0x05)
+		{
+			memcpy(&highHalves, src + 4, (dataType == 0x09) ? 2 : 4);
+		}
+		return UnpackVector_ExpandHalves<zeroExtend>(lowHalves, highHalves);
+	}
+	case 0x06:
+	case 0x0A:
+	case 0x0E:
+	{
+		//V2-8, V3-8, V4-8
+		uint32 bytes = 0;
+		if(dataType == 0x0E)
+		{
+			memcpy(&bytes, src, 4);
+		}
+		else
+		{
+			bytes = src[0] | (src[1] << 8);
+			if(dataType == 0x0A)
+			{
+				bytes |= (src[2] << 16);
+			}
+		}
+		return UnpackVector_ExpandBytes<zeroExtend>(bytes);
+	}
+	case 0x0F:
+	{
+		//V4-5
+		uint16 color = 0;
+		memcpy(&color, src, 2);
+		return UnpackVector_Set(
+		    ((color >> 0) & 0x1F) << 3,
+		    ((color >> 5) & 0x1F) << 3,
+		    ((color >> 10) & 0x1F) << 3,
+		    ((color >> 15) & 0x01) << 7);
+	}
+	default:
+		assert(0);
+		return UnpackVector_Splat(0);
+	}
+}
+
+#define UNPACK_BULK_MODES(type, usn, mask)                                  \
+	{                                                                       \
+		&CVif::Unpack_BulkImpl<type, usn, mask, CVif::MODE_NORMAL>,         \
+		    &CVif::Unpack_BulkImpl<type, usn, mask, CVif::MODE_OFFSET>,     \
+		    &CVif::Unpack_BulkImpl<type, usn, mask, CVif::MODE_DIFFERENCE>, \
+	}
+
+#define UNPACK_BULK_MASKS(type, usn)                                 \
+	{                                                                \
+		UNPACK_BULK_MODES(type, usn, false), UNPACK_BULK_MODES(type, usn, true) \
+	}
+
+#define UNPACK_BULK_TYPE(type)                                   \
+	{                                                            \
+		UNPACK_BULK_MASKS(type, false), UNPACK_BULK_MASKS(type, true) \
+	}
+
+const CVif::UnpackBulkFunction CVif::m_unpackBulkFunctions[0x10][2][2][3] =
+    {
+        UNPACK_BULK_TYPE(0x00),
+        UNPACK_BULK_TYPE(0x01),
+        UNPACK_BULK_TYPE(0x02),
+        UNPACK_BULK_TYPE(0x03),
+        UNPACK_BULK_TYPE(0x04),
+        UNPACK_BULK_TYPE(0x05),
+        UNPACK_BULK_TYPE(0x06),
+        UNPACK_BULK_TYPE(0x07),
+        UNPACK_BULK_TYPE(0x08),
+        UNPACK_BULK_TYPE(0x09),
+        UNPACK_BULK_TYPE(0x0A),
+        UNPACK_BULK_TYPE(0x0B),
+        UNPACK_BULK_TYPE(0x0C),
+        UNPACK_BULK_TYPE(0x0D),
+        UNPACK_BULK_TYPE(0x0E),
+        UNPACK_BULK_TYPE(0x0F),
+};
+
 CVif::CVif(unsigned int number, CVpu& vpu, CINTC& intc, uint8* ram, uint8* spr)
     : m_number(number)
     , m_ram(ram)
@@ -286,6 +684,16 @@ bool CVif::IsWaitingForProgramEnd() const
 	return (m_STAT.nVEW != 0);
 }
 
+bool CVif::IsBulkUnpackEnabled() const
+{
+	return m_bulkUnpackEnabled;
+}
+
+void CVif::SetBulkUnpackEnabled(bool enabled)
+{
+	m_bulkUnpackEnabled = enabled;
+}
+
 void CVif::ProcessFifoWrite(uint32 address, uint32 value)
 {
 	assert(m_fifoIndex != FIFO_SIZE);
@@ -636,6 +1044,11 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 	assert(nDstAddr < vuMemSize);
 	nDstAddr &= (vuMemSize - 1);
 
+	if((transfered == 0) && Unpack_Bulk(stream, nCommand, nDstAddr, currentNum, usn, useMask))
+	{
+		currentNum = 0;
+	}
+
 	while(currentNum != 0)
 	{
 		bool mustWrite = false;
@@ -746,6 +1159,126 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 	m_NUM = static_cast<uint8>(currentNum);
 }
 
+bool CVif::Unpack_Bulk(StreamType& stream, const CODE& command, uint32 dstAddr, uint32 count, bool usn, bool useMask)
+{
+	//Only handles whole transfers that are already available in contiguous memory with a
+	//CL >= WL write cycle, everything else (stalls, partial transfers, filling) goes through
+	//the generic path.
+	if(!m_bulkUnpackEnabled) return false;
+
+	uint32 cl = m_CYCLE.nCL;
+	uint32 wl = m_CYCLE.nWL;
+	if((wl == 0) || (cl < wl)) return false;
+
+	uint32 dataType = command.nCMD & 0x0F;
+	uint32 elementSize = GetUnpackElementSize(dataType);
+	if(elementSize == 0) return false;
+
+	uint32 readSize = count * elementSize;
+	if(stream.GetAvailableReadBytes() < readSize) return false;
+
+	uint32 mode = (m_MODE <= MODE_DIFFERENCE) ? m_MODE : MODE_NORMAL;
+	auto unpackFunction = m_unpackBulkFunctions[dataType][usn ? 1 : 0][useMask ? 1 : 0][mode];
+	(this->*unpackFunction)(stream.GetDirectPointer(), dstAddr, count, cl, wl);
+	stream.Skip(readSize);
+
+	//Leave tick counters as the generic path would have
+	uint32 cyclePosition = ((count - 1) % wl) + 1;
+	m_writeTick = (cyclePosition == cl) ? 0 : cyclePosition;
+	m_readTick = m_writeTick;
+
+	return true;
+}
+
+template <uint32 dataType, bool usn, bool useMask, uint32 mode>
+void CVif::Unpack_BulkImpl(const uint8* src, uint32 dstAddr, uint32 count, uint32 cl, uint32 wl)
+{
+	const auto vuMem = m_vpu.GetVuMemory();
+	const uint32 vuMemMask = m_vpu.GetVuMemorySize() - 1;
+	const uint32 elementSize = GetUnpackElementSize(dataType);
+	const uint32 skipSize = (cl - wl) * 0x10;
+
+	auto row = UnpackVector_Load(m_R);
+
+	//Lane selection masks for every column of the MASK register
+	UnpackVector dataMasks[4];
+	UnpackVector rowMasks[4];
+	UnpackVector keepMasks[4];
+	UnpackVector colValues[4];
+	if(useMask)
+	{
+		for(unsigned int col = 0; col < 4; col++)
+		{
+			uint32 laneMasks[4][4] = {};
+			for(unsigned int i = 0; i < 4; i++)
+			{
+				laneMasks[GetMaskOp(i, col)][i] = ~0U;
+			}
+			dataMasks[col] = UnpackVector_Load(laneMasks[MASK_DATA]);
+			rowMasks[col] = UnpackVector_Load(laneMasks[MASK_ROW]);
+			keepMasks[col] = UnpackVector_Load(laneMasks[MASK_MASK]);
+			colValues[col] = UnpackVector_And(UnpackVector_Load(laneMasks[MASK_COL]), UnpackVector_Splat(m_C[col]));
+		}
+	}
+
+	uint32 writeTick = 0;
+	for(uint32 i = 0; i < count; i++)
+	{
+		auto value = UnpackVector_ReadElement<dataType, usn>(src);
+		src += elementSize;
+
+		unsigned int col = std::min<uint32>(writeTick, 3);
+		if(mode == MODE_OFFSET)
+		{
+			value = UnpackVector_Add(value, row);
+		}
+		else if(mode == MODE_DIFFERENCE)
+		{
+			value = UnpackVector_Add(value, row);
+			row = useMask ? UnpackVector_Select(dataMasks[col], value, row) : value;
+		}
+
+		auto dst = vuMem + dstAddr;
+		if(useMask)
+		{
+			auto result = UnpackVector_Or(
+			    UnpackVector_Or(UnpackVector_And(dataMasks[col], value), UnpackVector_And(rowMasks[col], row)),
+			    UnpackVector_Or(colValues[col], UnpackVector_And(keepMasks[col], UnpackVector_Load(dst))));
+			UnpackVector_Store(dst, result);
+		}
+		else
+		{
+			UnpackVector_Store(dst, value);
+		}
+
+		dstAddr += 0x10;
+		writeTick++;
+		if(writeTick == wl)
+		{
+			writeTick = 0;
+			dstAddr += skipSize;
+		}
+		dstAddr &= vuMemMask;
+	}
+
+	if(mode == MODE_DIFFERENCE)
+	{
+		UnpackVector_Store(m_R, row);
+	}
+}
+
+uint32 CVif::GetUnpackElementSize(uint32 dataType)
+{
+	//Size in bytes of one element for every UNPACK type, 0 for invalid ones
+	static const uint32 elementSizes[0x10] =
+	    {
+	        4, 2, 1, 0,
+	        8, 4, 2, 0,
+	        12, 6, 3, 0,
+	        16, 8, 4, 2};
+	return elementSizes[dataType & 0x0F];
+}
+
 bool CVif::Unpack_ReadValue(const CODE& nCommand, StreamType& stream, uint128& writeValue, bool usn)
 {
 	bool success = false;
@@ -1290,6 +1823,28 @@ void CVif::CFifoStream::Advance(uint32 size)
 	}
 }
 
+void CVif::CFifoStream::Skip(uint32 size)
+{
+	assert(!m_tagIncluded);
+	uint32 bufferRemain = BUFFERSIZE - m_bufferPosition;
+	if(size <= bufferRemain)
+	{
+		m_bufferPosition += size;
+		return;
+	}
+	size -= bufferRemain;
+	//Move over whole quadwords without loading them, the remainder needs the buffer to be filled
+	m_nextAddress += size & ~(BUFFERSIZE - 1);
+	assert(m_nextAddress <= m_endAddress);
+	m_bufferPosition = BUFFERSIZE;
+	uint32 remainSize = size & (BUFFERSIZE - 1);
+	if(remainSize != 0)
+	{
+		SyncBuffer();
+		m_bufferPosition = remainSize;
+	}
+}
+
 void CVif::CFifoStream::SyncBuffer()
 {
 	assert(m_bufferPosition <= BUFFERSIZE);
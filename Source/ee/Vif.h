@@ -69,6 +69,9 @@ public:
 
 	bool IsWaitingForProgramEnd() const;
 
+	bool IsBulkUnpackEnabled() const;
+	void SetBulkUnpackEnabled(bool);
+
 protected:
 	enum
 	{
@@ -109,6 +112,7 @@ protected:
 
 		uint8* GetDirectPointer() const;
 		void Advance(uint32);
+		void Skip(uint32);
 
 	private:
 		void SyncBuffer();
@@ -204,6 +208,13 @@ protected:
 	bool Unpack_V32(StreamType&, uint128&, unsigned int);
 	bool Unpack_V45(StreamType&, uint128&);
 
+	typedef void (CVif::*UnpackBulkFunction)(const uint8*, uint32, uint32, uint32, uint32);
+
+	bool Unpack_Bulk(StreamType&, const CODE&, uint32, uint32, bool, bool);
+	template <uint32, bool, bool, uint32>
+	void Unpack_BulkImpl(const uint8*, uint32, uint32, uint32, uint32);
+	static uint32 GetUnpackElementSize(uint32);
+
 	uint32 GetMaskOp(unsigned int, unsigned int) const;
 
 	virtual void PrepareMicroProgram();
@@ -240,10 +251,14 @@ protected:
 	uint32 m_ITOPS;
 	uint32 m_readTick;
 	uint32 m_writeTick;
+	bool m_bulkUnpackEnabled = true;
 #ifdef DELAYED_MSCAL
 	uint32 m_pendingMicroProgram;
 	CODE m_previousCODE;
 #endif
 
 	CProfiler::ZoneHandle m_vifProfilerZone = 0;
+
+	//Indexed by UNPACK type, USN, mask and MODE
+	static const UnpackBulkFunction m_unpackBulkFunctions[0x10][2][2][3];
 };
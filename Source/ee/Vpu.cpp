@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "make_unique.h"
 #include "../Log.h"
 #include "../states/RegisterStateFile.h"
@@ -30,6 +31,7 @@ CVpu::CVpu(unsigned int number, const VPUINIT& vpuInit, CGIF& gif, CINTC& intc,
 
 CVpu::~CVpu()
 {
+	StopThread();
 #ifdef DEBUGGER_INCLUDED
 	delete[] m_microMemMiniState;
 	delete[] m_vuMemMiniState;
@@ -38,6 +40,20 @@ CVpu::~CVpu()
 
 void CVpu::Execute(int32 quota)
 {
+	if(m_threaded)
+	{
+		//Microprogram runs on its own thread, only forward its output and check if it's done
+		if(m_running && !m_threadBusy)
+		{
+			CompleteMicroProgram();
+		}
+		else
+		{
+			ProcessPendingXgKicks();
+		}
+		return;
+	}
+
 	if(!m_running) return;
 
 #ifdef PROFILE
@@ -93,11 +109,27 @@ uint32 CVpu::GetVuItopMiniState() const
 
 void CVpu::Reset()
 {
+	if(m_threaded)
+	{
+		m_threadAbort = true;
+		WaitForThread();
+		m_threadAbort = false;
+		std::lock_guard<std::mutex> xgKickLock(m_xgKickMutex);
+		m_xgKickPackets.Clear();
+		m_xgKickPending = false;
+	}
 	m_running = false;
 	m_ctx->m_executor->Reset();
 	m_vif->Reset();
 }
 
+void CVpu::Sync()
+{
+	if(!m_threaded || !m_running) return;
+	WaitForThread();
+	CompleteMicroProgram();
+}
+
 void CVpu::SaveState(Framework::CZipArchiveWriter& archive)
 {
 	m_vif->SaveState(archive);
@@ -133,6 +165,38 @@ bool CVpu::IsVuRunning() const
 	return m_running;
 }
 
+bool CVpu::IsThreaded() const
+{
+	return m_threaded;
+}
+
+void CVpu::SetThreaded(bool threaded)
+{
+#ifdef DEBUGGER_INCLUDED
+	//Single stepping and mini states require the VU to run on the EE thread
+	threaded = false;
+#endif
+	//VU0 is too tightly coupled with the EE (macro mode, shared registers)
+	if(m_number == 0)
+	{
+		threaded = false;
+	}
+
+	if(threaded == m_threaded) return;
+
+	Sync();
+	assert(!m_running);
+	m_threaded = threaded;
+	if(m_threaded)
+	{
+		StartThread();
+	}
+	else
+	{
+		StopThread();
+	}
+}
+
 CVif& CVpu::GetVif()
 {
 	return *m_vif.get();
@@ -153,6 +217,16 @@ void CVpu::ExecuteMicroProgram(uint32 nAddress)
 	assert(!m_running);
 	m_running = true;
 	VuStateChanged(m_running);
+
+	if(m_threaded)
+	{
+		std::lock_guard<std::mutex> threadLock(m_threadMutex);
+		m_threadBusy = true;
+		m_threadStartPending = true;
+		m_threadCondition.notify_one();
+		return;
+	}
+
 	for(unsigned int i = 0; i < 100; i++)
 	{
 		Execute(5000);
@@ -162,11 +236,13 @@ void CVpu::ExecuteMicroProgram(uint32 nAddress)
 
 void CVpu::InvalidateMicroProgram()
 {
+	Sync();
 	m_ctx->m_executor->ClearActiveBlocksInRange(0, (m_number == 0) ? PS2::MICROMEM0SIZE : PS2::MICROMEM1SIZE, false);
 }
 
 void CVpu::InvalidateMicroProgram(uint32 start, uint32 end)
 {
+	Sync();
 	m_ctx->m_executor->ClearActiveBlocksInRange(start, end, false);
 }
 
@@ -177,6 +253,19 @@ void CVpu::ProcessXgKick(uint32 address)
 
 	//	assert(nAddress < PS2::VUMEM1SIZE);
 
+	if(m_threaded)
+	{
+		//We're on the VU thread, the GIF belongs to the EE thread. Copy the packet as it is
+		//right now since the microprogram is free to overwrite it after the kick.
+		uint32 packetSize = GetXgKickPacketSize(GetVuMemory(), address);
+		auto packetStart = GetVuMemory() + address;
+		std::lock_guard<std::mutex> xgKickLock(m_xgKickMutex);
+		m_xgKickPackets.data.insert(m_xgKickPackets.data.end(), packetStart, packetStart + packetSize);
+		m_xgKickPackets.sizes.push_back(packetSize);
+		m_xgKickPending = true;
+		return;
+	}
+
 	CGsPacketMetadata metadata;
 	metadata.pathIndex = 1;
 #ifdef DEBUGGER_INCLUDED
@@ -194,3 +283,112 @@ void CVpu::ProcessXgKick(uint32 address)
 	SaveMiniState();
 #endif
 }
+
+uint32 CVpu::GetXgKickPacketSize(const uint8* vuMem, uint32 address)
+{
+	//Walk GIF tags until EOP, packets processed from VU memory never wrap around
+	uint32 start = address;
+	while(address < PS2::VUMEM1SIZE)
+	{
+		auto tag = *reinterpret_cast<const CGIF::TAG*>(vuMem + address);
+		address += 0x10;
+
+		uint32 regCount = (tag.nreg == 0) ? 0x10 : tag.nreg;
+		switch(tag.cmd)
+		{
+		case 0:
+			//PACKED
+			address += tag.loops * regCount * 0x10;
+			break;
+		case 1:
+			//REGLIST
+			address += ((tag.loops * regCount * 8) + 0xF) & ~0xF;
+			break;
+		default:
+			//IMAGE
+			address += tag.loops * 0x10;
+			break;
+		}
+
+		if(tag.eop) break;
+	}
+	return std::min<uint32>(address, PS2::VUMEM1SIZE) - start;
+}
+
+void CVpu::ProcessPendingXgKicks()
+{
+	if(!m_xgKickPending) return;
+
+	{
+		std::lock_guard<std::mutex> xgKickLock(m_xgKickMutex);
+		std::swap(m_xgKickPackets, m_xgKickPacketsProcessing);
+		m_xgKickPending = false;
+	}
+
+	CGsPacketMetadata metadata;
+	metadata.pathIndex = 1;
+	const uint8* packet = m_xgKickPacketsProcessing.data.data();
+	for(uint32 packetSize : m_xgKickPacketsProcessing.sizes)
+	{
+		m_gif.ProcessSinglePacket(packet, packetSize, 0, packetSize, metadata);
+		packet += packetSize;
+	}
+	m_xgKickPacketsProcessing.Clear();
+}
+
+void CVpu::CompleteMicroProgram()
+{
+	assert(m_running && !m_threadBusy);
+	ProcessPendingXgKicks();
+	m_running = false;
+	VuStateChanged(m_running);
+}
+
+void CVpu::StartThread()
+{
+	assert(!m_thread.joinable());
+	m_threadDone = false;
+	m_thread = std::thread([this]() { ThreadProc(); });
+}
+
+void CVpu::StopThread()
+{
+	if(!m_thread.joinable()) return;
+	m_threadAbort = true;
+	{
+		std::lock_guard<std::mutex> threadLock(m_threadMutex);
+		m_threadDone = true;
+		m_threadCondition.notify_one();
+	}
+	m_thread.join();
+	m_threadAbort = false;
+	m_threadStartPending = false;
+	m_threadBusy = false;
+}
+
+void CVpu::WaitForThread()
+{
+	std::unique_lock<std::mutex> threadLock(m_threadMutex);
+	m_threadIdleCondition.wait(threadLock, [this]() { return !m_threadBusy; });
+}
+
+void CVpu::ThreadProc()
+{
+	std::unique_lock<std::mutex> threadLock(m_threadMutex);
+	while(1)
+	{
+		m_threadCondition.wait(threadLock, [this]() { return m_threadStartPending || m_threadDone; });
+		if(m_threadDone) break;
+		m_threadStartPending = false;
+		threadLock.unlock();
+
+		while(!m_ctx->m_State.nHasException && !m_threadAbort)
+		{
+			m_ctx->m_executor->Execute(THREAD_EXECUTION_QUOTA);
+		}
+
+		threadLock.lock();
+		m_threadBusy = false;
+		m_threadIdleCondition.notify_all();
+	}
+}
@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "Types.h"
 #include "../MIPS.h"
 #include "../Profiler.h"
@@ -43,6 +48,7 @@ public:
 
 	void Execute(int32);
 	void Reset();
+	void Sync();
 	void SaveState(Framework::CZipArchiveWriter&);
 	void LoadState(Framework::CZipArchiveReader&);
 
@@ -52,6 +58,9 @@ public:
 	uint32 GetVuMemorySize() const;
 	bool IsVuRunning() const;
 
+	bool IsThreaded() const;
+	void SetThreaded(bool);
+
 	CVif& GetVif();
 
 	void ExecuteMicroProgram(uint32);
@@ -74,6 +83,32 @@ public:
 protected:
 	typedef std::unique_ptr<CVif> VifPtr;
 
+	//Packets are stored back to back, buffers keep their capacity to avoid allocating on every kick
+	struct XGKICK_PACKETS
+	{
+		void Clear()
+		{
+			data.clear();
+			sizes.clear();
+		}
+
+		std::vector<uint8> data;
+		std::vector<uint32> sizes;
+	};
+
+	enum
+	{
+		THREAD_EXECUTION_QUOTA = 5000,
+	};
+
+	void StartThread();
+	void StopThread();
+	void ThreadProc();
+	void WaitForThread();
+	void CompleteMicroProgram();
+	void ProcessPendingXgKicks();
+	static uint32 GetXgKickPacketSize(const uint8*, uint32);
+
 	uint8* m_microMem = nullptr;
 	uint8* m_vuMem = nullptr;
 	uint32 m_vuMemSize = 0;
@@ -92,5 +127,23 @@ protected:
 	unsigned int m_number = 0;
 	bool m_running = false;
 
+	//Threaded mode, m_running is only changed by the EE thread, m_threadBusy tells if the
+	//VU thread is still executing the microprogram started by ExecuteMicroProgram.
+	bool m_threaded = false;
+	std::thread m_thread;
+	std::mutex m_threadMutex;
+	std::condition_variable m_threadCondition;
+	std::condition_variable m_threadIdleCondition;
+	bool m_threadStartPending = false;
+	bool m_threadDone = false;
+	std::atomic<bool> m_threadBusy = {false};
+	std::atomic<bool> m_threadAbort = {false};
+
+	//GIF packets kicked by the VU thread, sent to the GIF by the EE thread
+	std::mutex m_xgKickMutex;
+	XGKICK_PACKETS m_xgKickPackets;
+	XGKICK_PACKETS m_xgKickPacketsProcessing;
+	std::atomic<bool> m_xgKickPending = {false};
+
 	CProfiler::ZoneHandle m_vuProfilerZone = 0;
 };
@@ -49,8 +49,8 @@ BasicBlockPtr CVuExecutor::BlockFactory(CMIPS& context, uint32 begin, uint32 end
 		}
 	}
 
-	auto result = std::make_shared<CVuBasicBlock>(context, begin, end);
-	result->Compile();
+	auto result = AllocateBlock<CVuBasicBlock>(context, begin, end);
+	CompileBlock(*result, checksum);
 	m_cachedBlocks.insert(std::make_pair(checksum, result));
 	return result;
 }
@@ -11,6 +11,15 @@ public:
 
 	void Reset() override;
 
+	//VU microcode can't be interpreted or traced, blocks are always compiled right away
+	void SetBackgroundCompilationEnabled(bool) override
+	{
+	}
+
+	void SetTieredCompilationEnabled(bool) override
+	{
+	}
+
 protected:
 	typedef std::unordered_multimap<uint32, BasicBlockPtr> CachedBlockMap;
 
@@ -168,6 +168,11 @@ void CGSH_Direct3D9::ReadFramebuffer(uint32, uint32, void*)
 {
 }
 
+CGSHandler::TEXTURECACHE_STATS CGSH_Direct3D9::GetTextureCacheStats() const
+{
+	return m_textureCache.GetStats();
+}
+
 bool CGSH_Direct3D9::GetDepthTestingEnabled() const
 {
 	return m_depthTestingEnabled;
@@ -31,6 +31,7 @@ public:
 	void ProcessLocalToLocalTransfer() override;
 	void ProcessClutTransfer(uint32, uint32) override;
 	void ReadFramebuffer(uint32, uint32, void*) override;
+	TEXTURECACHE_STATS GetTextureCacheStats() const override;
 
 	bool GetDepthTestingEnabled() const;
 	void SetDepthTestingEnabled(bool);
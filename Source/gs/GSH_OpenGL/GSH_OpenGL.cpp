@@ -237,9 +237,9 @@ void CGSH_OpenGL::FlipImpl()
 	CGSHandler::FlipImpl();
 }
 
-void CGSH_OpenGL::LoadState(Framework::CZipArchiveReader& archive)
+void CGSH_OpenGL::LoadState(Framework::CZipArchiveReader& archive, bool includeRam)
 {
-	CGSHandler::LoadState(archive);
+	CGSHandler::LoadState(archive, includeRam);
 	SendGSCall(
 	    [this]() {
 		    m_textureCache.InvalidateRange(0, RAMSIZE);
@@ -251,6 +251,7 @@ void CGSH_OpenGL::RegisterPreferences()
 	CGSHandler::RegisterPreferences();
 	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_CGSH_OPENGL_RESOLUTION_FACTOR, 1);
 	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_CGSH_OPENGL_FORCEBILINEARTEXTURES, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_CGSH_OPENGL_TEXTURECACHE_SIZE, TextureCache::DEFAULT_TEXTURE_CACHE_SIZE);
 }
 
 void CGSH_OpenGL::NotifyPreferencesChangedImpl()
@@ -267,6 +268,7 @@ void CGSH_OpenGL::LoadPreferences()
 {
 	m_fbScale = CAppConfig::GetInstance().GetPreferenceInteger(PREF_CGSH_OPENGL_RESOLUTION_FACTOR);
 	m_forceBilinearTextures = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_CGSH_OPENGL_FORCEBILINEARTEXTURES);
+	m_textureCache.SetCapacity(CAppConfig::GetInstance().GetPreferenceInteger(PREF_CGSH_OPENGL_TEXTURECACHE_SIZE));
 }
 
 void CGSH_OpenGL::InitializeRC()
@@ -2129,6 +2131,11 @@ Framework::CBitmap CGSH_OpenGL::GetScreenshot()
 	return imgbuffer;
 }
 
+CGSHandler::TEXTURECACHE_STATS CGSH_OpenGL::GetTextureCacheStats() const
+{
+	return m_textureCache.GetStats();
+}
+
 /////////////////////////////////////////////////////////////
 // Framebuffer
 /////////////////////////////////////////////////////////////
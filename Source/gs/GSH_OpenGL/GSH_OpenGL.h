@@ -12,6 +12,7 @@
 
 #define PREF_CGSH_OPENGL_RESOLUTION_FACTOR "renderer.opengl.resfactor"
 #define PREF_CGSH_OPENGL_FORCEBILINEARTEXTURES "renderer.opengl.forcebilineartextures"
+#define PREF_CGSH_OPENGL_TEXTURECACHE_SIZE "renderer.opengl.texturecachesize"
 
 #if !defined(GLES_COMPATIBILITY) && !defined(__APPLE__)
 //- Dual source blending is disabled on macOS because it seems to be problematic on
@@ -27,7 +28,7 @@ public:
 
 	static void RegisterPreferences();
 
-	void LoadState(Framework::CZipArchiveReader&) override;
+	void LoadState(Framework::CZipArchiveReader&, bool) override;
 
 	void ProcessHostToLocalTransfer() override;
 	void ProcessLocalToHostTransfer() override;
@@ -36,6 +37,7 @@ public:
 	void ReadFramebuffer(uint32, uint32, void*) override;
 
 	Framework::CBitmap GetScreenshot() override;
+	TEXTURECACHE_STATS GetTextureCacheStats() const override;
 
 protected:
 	void PalCache_Flush();
@@ -179,10 +179,9 @@ CGSH_OpenGL::TEXTURE_INFO CGSH_OpenGL::PrepareTexture(const TEX0& tex0)
 			glBindTexture(GL_TEXTURE_2D, textureHandle);
 			glTexStorage2D(GL_TEXTURE_2D, 1, texFormat.internalFormat, texWidth, texHeight);
 			CHECKGLERROR();
-			m_textureCache.Insert(tex0, std::move(textureHandle));
+			texture = m_textureCache.Insert(tex0, std::move(textureHandle));
 		}
 
-		texture = m_textureCache.Search(tex0);
 		texture->m_cachedArea.Invalidate(0, RAMSIZE);
 	}
 
@@ -279,16 +278,8 @@ void CGSH_OpenGL::TexUpdater_Psm32(uint32 bufPtr, uint32 bufWidth, unsigned int
 {
 	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, bufPtr, bufWidth);
 
-	uint32* dst = reinterpret_cast<uint32*>(m_pCvtBuffer);
-	for(unsigned int y = 0; y < texHeight; y++)
-	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			dst[x] = indexor.GetPixel(texX + x, texY + y);
-		}
-
-		dst += texWidth;
-	}
+	auto dst = reinterpret_cast<uint32*>(m_pCvtBuffer);
+	indexor.ReadRect(texX, texY, texWidth, texHeight, dst, texWidth);
 
 	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RGBA, GL_UNSIGNED_BYTE, m_pCvtBuffer);
 	CHECKGLERROR();
@@ -300,20 +291,17 @@ void CGSH_OpenGL::TexUpdater_Psm16(uint32 bufPtr, uint32 bufWidth, unsigned int
 	IndexorType indexor(m_pRAM, bufPtr, bufWidth);
 
 	auto dst = reinterpret_cast<uint16*>(m_pCvtBuffer);
-	for(unsigned int y = 0; y < texHeight; y++)
-	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			auto pixel = indexor.GetPixel(texX + x, texY + y);
-			auto cvtPixel =
-			    (((pixel & 0x001F) >> 0) << 11) | //R
-			    (((pixel & 0x03E0) >> 5) << 6) |  //G
-			    (((pixel & 0x7C00) >> 10) << 1) | //B
-			    (pixel >> 15);                    //A
-			dst[x] = cvtPixel;
-		}
+	indexor.ReadRect(texX, texY, texWidth, texHeight, dst, texWidth);
 
-		dst += texWidth;
+	for(unsigned int i = 0; i < (texWidth * texHeight); i++)
+	{
+		auto pixel = dst[i];
+		auto cvtPixel =
+		    (((pixel & 0x001F) >> 0) << 11) | //R
+		    (((pixel & 0x03E0) >> 5) << 6) |  //G
+		    (((pixel & 0x7C00) >> 10) << 1) | //B
+		    (pixel >> 15);                    //A
+		dst[i] = cvtPixel;
 	}
 
 	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RGBA, GL_UNSIGNED_SHORT_5_5_5_1, m_pCvtBuffer);
@@ -325,17 +313,7 @@ void CGSH_OpenGL::TexUpdater_Psm48(uint32 bufPtr, uint32 bufWidth, unsigned int
 {
 	IndexorType indexor(m_pRAM, bufPtr, bufWidth);
 
-	uint8* dst = m_pCvtBuffer;
-	for(unsigned int y = 0; y < texHeight; y++)
-	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			uint8 pixel = indexor.GetPixel(texX + x, texY + y);
-			dst[x] = pixel;
-		}
-
-		dst += texWidth;
-	}
+	indexor.ReadRect(texX, texY, texWidth, texHeight, m_pCvtBuffer, texWidth);
 
 	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RED, GL_UNSIGNED_BYTE, m_pCvtBuffer);
 	CHECKGLERROR();
@@ -346,17 +324,16 @@ void CGSH_OpenGL::TexUpdater_Psm48H(uint32 bufPtr, uint32 bufWidth, unsigned int
 {
 	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, bufPtr, bufWidth);
 
+	//Pixels are read as 32-bit words and then narrowed in place, each byte is written after the word it comes from was read
+	auto pixels = reinterpret_cast<uint32*>(m_pCvtBuffer);
+	indexor.ReadRect(texX, texY, texWidth, texHeight, pixels, texWidth);
+
 	uint8* dst = m_pCvtBuffer;
-	for(unsigned int y = 0; y < texHeight; y++)
+	for(unsigned int i = 0; i < (texWidth * texHeight); i++)
 	{
-		for(unsigned int x = 0; x < texWidth; x++)
-		{
-			uint32 pixel = indexor.GetPixel(texX + x, texY + y);
-			pixel = (pixel >> shiftAmount) & mask;
-			dst[x] = static_cast<uint8>(pixel);
-		}
-
-		dst += texWidth;
+		uint32 pixel = pixels[i];
+		pixel = (pixel >> shiftAmount) & mask;
+		dst[i] = static_cast<uint8>(pixel);
 	}
 
 	glTexSubImage2D(GL_TEXTURE_2D, 0, texX, texY, texWidth, texHeight, GL_RED, GL_UNSIGNED_BYTE, m_pCvtBuffer);
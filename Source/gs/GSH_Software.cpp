@@ -0,0 +1,1900 @@
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include "GSH_Software.h"
+#include "GsPixelFormats.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define GSH_SOFTWARE_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+//Registers that affect rasterization, context specific ones are given for context 1
+static const uint8 g_contextStateRegisters[] =
+    {
+        GS_REG_TEX0_1,
+        GS_REG_CLAMP_1,
+        GS_REG_TEX1_1,
+        GS_REG_SCISSOR_1,
+        GS_REG_ALPHA_1,
+        GS_REG_TEST_1,
+        GS_REG_FBA_1,
+        GS_REG_FRAME_1,
+        GS_REG_ZBUF_1,
+};
+
+static const uint8 g_globalStateRegisters[] =
+    {
+        GS_REG_TEXA,
+        GS_REG_FOGCOL,
+        GS_REG_PABE,
+        GS_REG_COLCLAMP,
+};
+
+static int32 ClampToInt(float value, float minValue, float maxValue)
+{
+	//Also catches NaNs coming from divisions by a null Q
+	if(!(value > minValue)) return static_cast<int32>(minValue);
+	if(!(value < maxValue)) return static_cast<int32>(maxValue);
+	return static_cast<int32>(value);
+}
+
+static int32 WrapTexCoord(int32 coord, uint32 mode, int32 size, int32 minValue, int32 maxValue)
+{
+	switch(mode)
+	{
+	default:
+	case CGSHandler::CLAMP_MODE_REPEAT:
+		return coord & (size - 1);
+	case CGSHandler::CLAMP_MODE_CLAMP:
+		return std::clamp(coord, 0, size - 1);
+	case CGSHandler::CLAMP_MODE_REGION_CLAMP:
+		return std::clamp(coord, minValue, std::max(minValue, maxValue));
+	case CGSHandler::CLAMP_MODE_REGION_REPEAT:
+		return (coord & minValue) | maxValue;
+	}
+}
+
+static uint32 ExpandColor16(uint16 color, const CGSHandler::TEXA& texa)
+{
+	uint32 rgb = ((color & 0x7C00) << 9) | ((color & 0x03E0) << 6) | ((color & 0x001F) << 3);
+	uint32 alpha = 0;
+	if(color & 0x8000)
+	{
+		alpha = texa.nTA1;
+	}
+	else if(!texa.nAEM || (rgb != 0))
+	{
+		alpha = texa.nTA0;
+	}
+	return rgb | (alpha << 24);
+}
+
+static uint32 ExpandColor24(uint32 color, const CGSHandler::TEXA& texa)
+{
+	uint32 rgb = color & 0x00FFFFFF;
+	uint32 alpha = (texa.nAEM && (rgb == 0)) ? 0 : texa.nTA0;
+	return rgb | (alpha << 24);
+}
+
+//Conversions used for frame buffers, alpha is 0x80 when the alpha bit is set
+static uint32 RGBA16ToRGBA32(uint16 color)
+{
+	return ((color & 0x8000) ? 0x80000000 : 0) | ((color & 0x7C00) << 9) | ((color & 0x03E0) << 6) | ((color & 0x001F) << 3);
+}
+
+static uint16 RGBA32ToRGBA16(uint32 color)
+{
+	return static_cast<uint16>(
+	    ((color >> 3) & 0x001F) |
+	    ((color >> 6) & 0x03E0) |
+	    ((color >> 9) & 0x7C00) |
+	    ((color >> 16) & 0x8000));
+}
+
+static bool AlphaTestPasses(uint32 method, uint32 alpha, uint32 alphaRef)
+{
+	switch(method)
+	{
+	default:
+	case CGSHandler::ALPHA_TEST_NEVER:
+		return false;
+	case CGSHandler::ALPHA_TEST_ALWAYS:
+		return true;
+	case CGSHandler::ALPHA_TEST_LESS:
+		return alpha < alphaRef;
+	case CGSHandler::ALPHA_TEST_LEQUAL:
+		return alpha <= alphaRef;
+	case CGSHandler::ALPHA_TEST_EQUAL:
+		return alpha == alphaRef;
+	case CGSHandler::ALPHA_TEST_GEQUAL:
+		return alpha >= alphaRef;
+	case CGSHandler::ALPHA_TEST_GREATER:
+		return alpha > alphaRef;
+	case CGSHandler::ALPHA_TEST_NOTEQUAL:
+		return alpha != alphaRef;
+	}
+}
+
+bool CGSH_Software::MEMORY_RANGE::Overlaps(const MEMORY_RANGE& range) const
+{
+	return (start < range.end) && (range.start < end);
+}
+
+void CGSH_Software::MEMORY_RANGE::Merge(const MEMORY_RANGE& range)
+{
+	start = std::min(start, range.start);
+	end = std::max(end, range.end);
+}
+
+CGSH_Software::CGSH_Software(bool gsThreaded, uint32 workerCount)
+    : CGSHandler(gsThreaded)
+    , m_tiles(TILE_COUNT)
+    , m_workerCount(workerCount)
+{
+	static_assert((sizeof(g_contextStateRegisters) + sizeof(g_globalStateRegisters)) == STATE_REGISTER_COUNT,
+	              "STATE_REGISTER_COUNT doesn't match state register lists.");
+
+	if(m_workerCount == 0)
+	{
+		//The GS thread rasterizes tiles along with the workers
+		uint32 threadCount = std::max<uint32>(std::thread::hardware_concurrency(), 1);
+		m_workerCount = std::min<uint32>(threadCount - 1, MAX_DEFAULT_WORKER_COUNT);
+	}
+
+	//Make sure page offset tables are not built lazily from worker threads
+	CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMCT32>::GetPageOffsets();
+	CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMCT16>::GetPageOffsets();
+	CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMCT16S>::GetPageOffsets();
+	CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32>::GetPageOffsets();
+	CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ16>::GetPageOffsets();
+	CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMT8>::GetPageOffsets();
+	CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMT4>::GetPageOffsets();
+
+	m_primitives.reserve(MAX_PRIMITIVES);
+}
+
+CGSH_Software::~CGSH_Software()
+{
+	StopWorkerThreads();
+}
+
+CGSHandler::FactoryFunction CGSH_Software::GetFactoryFunction()
+{
+	return std::bind(&CGSH_Software::GSHandlerFactory);
+}
+
+CGSHandler* CGSH_Software::GSHandlerFactory()
+{
+	return new CGSH_Software();
+}
+
+void CGSH_Software::InitializeImpl()
+{
+	m_workerThreadsDone = false;
+	for(uint32 i = 0; i < m_workerCount; i++)
+	{
+		uint32 generation = m_workerGeneration;
+		m_workerThreads.emplace_back([this, generation]() { WorkerThreadProc(generation); });
+	}
+}
+
+void CGSH_Software::ReleaseImpl()
+{
+	ClearBatch();
+	StopWorkerThreads();
+}
+
+void CGSH_Software::ResetImpl()
+{
+	ClearBatch();
+	m_primitiveType = PRIM_INVALID;
+	m_vtxCount = 0;
+}
+
+void CGSH_Software::FlipImpl()
+{
+	FlushPrimitives();
+	CGSHandler::FlipImpl();
+}
+
+void CGSH_Software::WriteRegisterImpl(uint8 registerId, uint64 value)
+{
+	CGSHandler::WriteRegisterImpl(registerId, value);
+
+	switch(registerId)
+	{
+	case GS_REG_PRIM:
+		m_primitiveType = static_cast<uint32>(value & 0x07);
+		switch(m_primitiveType)
+		{
+		case PRIM_POINT:
+			m_vtxCount = 1;
+			break;
+		case PRIM_LINE:
+		case PRIM_LINESTRIP:
+			m_vtxCount = 2;
+			break;
+		case PRIM_TRIANGLE:
+		case PRIM_TRIANGLESTRIP:
+		case PRIM_TRIANGLEFAN:
+			m_vtxCount = 3;
+			break;
+		case PRIM_SPRITE:
+			m_vtxCount = 2;
+			break;
+		default:
+			m_vtxCount = 0;
+			break;
+		}
+		break;
+
+	case GS_REG_XYZ2:
+	case GS_REG_XYZ3:
+	case GS_REG_XYZF2:
+	case GS_REG_XYZF3:
+		VertexKick(registerId, value);
+		break;
+	}
+}
+
+void CGSH_Software::VertexKick(uint8 registerId, uint64 value)
+{
+	if(m_vtxCount == 0) return;
+
+	bool drawingKick = (registerId == GS_REG_XYZ2) || (registerId == GS_REG_XYZF2);
+	bool fog = (registerId == GS_REG_XYZF2) || (registerId == GS_REG_XYZF3);
+
+	if(!m_drawEnabled) drawingKick = false;
+
+	auto& vertex = m_vtxBuffer[m_vtxCount - 1];
+	vertex.position = fog ? (value & 0x00FFFFFFFFFFFFFFULL) : value;
+	vertex.rgbaq = m_nReg[GS_REG_RGBAQ];
+	vertex.uv = m_nReg[GS_REG_UV];
+	vertex.st = m_nReg[GS_REG_ST];
+	vertex.fog = fog ? static_cast<uint8>(value >> 56) : static_cast<uint8>(m_nReg[GS_REG_FOG] >> 56);
+
+	m_vtxCount--;
+
+	if(m_vtxCount != 0) return;
+
+	if(drawingKick)
+	{
+		uint64 primitiveMode = ((m_nReg[GS_REG_PRMODECONT] & 1) != 0) ? m_nReg[GS_REG_PRIM] : m_nReg[GS_REG_PRMODE];
+		if(m_primitives.size() == MAX_PRIMITIVES)
+		{
+			FlushPrimitives();
+		}
+		m_drawStateIndex = PrepareDrawState(primitiveMode);
+	}
+
+	switch(m_primitiveType)
+	{
+	case PRIM_POINT:
+		if(drawingKick) Prim_Point();
+		m_vtxCount = 1;
+		break;
+	case PRIM_LINE:
+		if(drawingKick) Prim_Line();
+		m_vtxCount = 2;
+		break;
+	case PRIM_LINESTRIP:
+		if(drawingKick) Prim_Line();
+		m_vtxBuffer[1] = m_vtxBuffer[0];
+		m_vtxCount = 1;
+		break;
+	case PRIM_TRIANGLE:
+		if(drawingKick) Prim_Triangle();
+		m_vtxCount = 3;
+		break;
+	case PRIM_TRIANGLESTRIP:
+		if(drawingKick) Prim_Triangle();
+		m_vtxBuffer[2] = m_vtxBuffer[1];
+		m_vtxBuffer[1] = m_vtxBuffer[0];
+		m_vtxCount = 1;
+		break;
+	case PRIM_TRIANGLEFAN:
+		if(drawingKick) Prim_Triangle();
+		m_vtxBuffer[1] = m_vtxBuffer[0];
+		m_vtxCount = 1;
+		break;
+	case PRIM_SPRITE:
+		if(drawingKick) Prim_Sprite();
+		m_vtxCount = 2;
+		break;
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Draw State
+/////////////////////////////////////////////////////////////
+
+bool CGSH_Software::IsDrawStateCurrent(const DRAW_STATE& state, uint64 primitiveMode) const
+{
+	if(state.primitiveMode != (primitiveMode & ~0x07ULL)) return false;
+	uint32 registerIndex = 0;
+	for(auto contextRegister : g_contextStateRegisters)
+	{
+		if(state.registers[registerIndex++] != m_nReg[contextRegister + state.context]) return false;
+	}
+	for(auto globalRegister : g_globalStateRegisters)
+	{
+		if(state.registers[registerIndex++] != m_nReg[globalRegister]) return false;
+	}
+	return true;
+}
+
+uint32 CGSH_Software::PrepareDrawState(uint64 primitiveMode)
+{
+	if(!m_drawStateDirty && !m_drawStates.empty() && IsDrawStateCurrent(m_drawStates.back(), primitiveMode))
+	{
+		return static_cast<uint32>(m_drawStates.size() - 1);
+	}
+
+	DRAW_STATE state;
+	BuildDrawState(primitiveMode, state);
+	m_drawStateDirty = false;
+
+	auto writeRange = GetDrawStateWriteRange(state);
+	auto readRange = GetDrawStateReadRange(state);
+
+	if(!m_primitives.empty())
+	{
+		//Tiles of a batch are drawn in parallel: every primitive must target the same buffers and
+		//no primitive can read something that another one writes.
+		bool needsFlush =
+		    (static_cast<uint32>(state.frame) != m_batchFrame) ||
+		    (static_cast<uint32>(state.zbuf) != m_batchZbuf) ||
+		    readRange.Overlaps(m_batchWriteRange) ||
+		    writeRange.Overlaps(m_batchReadRange);
+		if(needsFlush)
+		{
+			FlushPrimitives();
+		}
+	}
+
+	if(m_primitives.empty())
+	{
+		m_batchFrame = static_cast<uint32>(state.frame);
+		m_batchZbuf = static_cast<uint32>(state.zbuf);
+	}
+
+	m_batchWriteRange.Merge(writeRange);
+	m_batchReadRange.Merge(readRange);
+
+	m_drawStates.push_back(state);
+	return static_cast<uint32>(m_drawStates.size() - 1);
+}
+
+void CGSH_Software::BuildDrawState(uint64 primitiveMode, DRAW_STATE& state) const
+{
+	auto prim = make_convertible<PRMODE>(primitiveMode);
+	state.primitiveMode = primitiveMode & ~0x07ULL;
+	state.context = prim.nContext;
+
+	uint32 registerIndex = 0;
+	for(auto contextRegister : g_contextStateRegisters)
+	{
+		state.registers[registerIndex++] = m_nReg[contextRegister + state.context];
+	}
+	for(auto globalRegister : g_globalStateRegisters)
+	{
+		state.registers[registerIndex++] = m_nReg[globalRegister];
+	}
+
+	state.gouraud = prim.nShading;
+	state.textured = prim.nTexture;
+	state.fogged = prim.nFog;
+	state.blended = prim.nAlpha;
+	state.fst = prim.nUseUV;
+
+	state.tex0 <<= m_nReg[GS_REG_TEX0_1 + state.context];
+	state.clamp <<= m_nReg[GS_REG_CLAMP_1 + state.context];
+	state.tex1 <<= m_nReg[GS_REG_TEX1_1 + state.context];
+	state.scissor <<= m_nReg[GS_REG_SCISSOR_1 + state.context];
+	state.alpha <<= m_nReg[GS_REG_ALPHA_1 + state.context];
+	state.test <<= m_nReg[GS_REG_TEST_1 + state.context];
+	state.frame <<= m_nReg[GS_REG_FRAME_1 + state.context];
+	state.zbuf <<= m_nReg[GS_REG_ZBUF_1 + state.context];
+	state.texa <<= m_nReg[GS_REG_TEXA];
+	state.fogCol <<= m_nReg[GS_REG_FOGCOL];
+	state.fba = (m_nReg[GS_REG_FBA_1 + state.context] & 1) != 0;
+	state.pabe = (m_nReg[GS_REG_PABE] & 1) != 0;
+	state.colClamp = (m_nReg[GS_REG_COLCLAMP] & 1) != 0;
+
+	state.framePsm = state.frame.nPsm;
+	state.depthPsm = PSMZ32 | state.zbuf.nPsm;
+	state.textureWidth = std::min<uint32>(state.tex0.GetWidth(), 1024);
+	state.textureHeight = std::min<uint32>(state.tex0.GetHeight(), 1024);
+
+	if(state.textured && CGsPixelFormats::IsPsmIDTEX(state.tex0.nPsm))
+	{
+		MakeLinearCLUT(state.tex0, state.clut);
+		if((state.tex0.nCPSM == PSMCT16) || (state.tex0.nCPSM == PSMCT16S))
+		{
+			//Alpha of 16-bit CLUT entries is expanded through TEXA
+			for(auto& color : state.clut)
+			{
+				uint32 rgb = color & 0x00FFFFFF;
+				uint32 alpha = 0;
+				if(color & 0x80000000)
+				{
+					alpha = state.texa.nTA1;
+				}
+				else if(!state.texa.nAEM || (rgb != 0))
+				{
+					alpha = state.texa.nTA0;
+				}
+				color = rgb | (alpha << 24);
+			}
+		}
+	}
+}
+
+CGSH_Software::MEMORY_RANGE CGSH_Software::GetBufferRange(uint32 basePtr, uint32 width, uint32 psm, uint32 height)
+{
+	auto pageSize = CGsPixelFormats::GetPsmPageSize(psm);
+	uint32 pageCountX = std::max<uint32>((width + pageSize.first - 1) / pageSize.first, 1);
+	uint32 pageCountY = (height + pageSize.second - 1) / pageSize.second;
+
+	MEMORY_RANGE range;
+	range.start = basePtr;
+	range.end = basePtr + (pageCountX * pageCountY * CGsPixelFormats::PAGESIZE);
+	return range;
+}
+
+CGSH_Software::MEMORY_RANGE CGSH_Software::GetDrawStateWriteRange(const DRAW_STATE& state) const
+{
+	uint32 height = state.scissor.scay1 + 1;
+	auto range = GetBufferRange(state.frame.GetBasePtr(), state.frame.GetWidth(), state.framePsm, height);
+	if(state.test.nDepthEnabled && !state.zbuf.nMask)
+	{
+		range.Merge(GetBufferRange(state.zbuf.GetBasePtr(), state.frame.GetWidth(), state.depthPsm, height));
+	}
+	return range;
+}
+
+CGSH_Software::MEMORY_RANGE CGSH_Software::GetDrawStateReadRange(const DRAW_STATE& state) const
+{
+	if(!state.textured) return MEMORY_RANGE();
+	return GetBufferRange(state.tex0.GetBufPtr(), state.tex0.GetBufWidth(), state.tex0.nPsm, state.textureHeight);
+}
+
+/////////////////////////////////////////////////////////////
+// Primitive Setup
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::SetupVertex(const VERTEX& vertex, const DRAW_STATE& state, SETUP_VERTEX& result) const
+{
+	auto xyz = make_convertible<XYZ>(vertex.position);
+	auto offset = make_convertible<XYOFFSET>(m_nReg[GS_REG_XYOFFSET_1 + state.context]);
+	auto rgbaq = make_convertible<RGBAQ>(vertex.rgbaq);
+
+	result.x = static_cast<float>(static_cast<int32>(xyz.nX) - static_cast<int32>(offset.nOffsetX)) / 16.0f;
+	result.y = static_cast<float>(static_cast<int32>(xyz.nY) - static_cast<int32>(offset.nOffsetY)) / 16.0f;
+	result.z = static_cast<double>(xyz.nZ);
+
+	result.attributes[ATTRIBUTE_R] = rgbaq.nR;
+	result.attributes[ATTRIBUTE_G] = rgbaq.nG;
+	result.attributes[ATTRIBUTE_B] = rgbaq.nB;
+	result.attributes[ATTRIBUTE_A] = rgbaq.nA;
+
+	if(state.fst)
+	{
+		auto uv = make_convertible<UV>(vertex.uv);
+		result.attributes[ATTRIBUTE_S] = uv.GetU();
+		result.attributes[ATTRIBUTE_T] = uv.GetV();
+		result.attributes[ATTRIBUTE_Q] = 1.0f;
+	}
+	else
+	{
+		//Texture coordinates are kept in texels, U = S / Q
+		auto st = make_convertible<ST>(vertex.st);
+		result.attributes[ATTRIBUTE_S] = st.nS * static_cast<float>(state.textureWidth);
+		result.attributes[ATTRIBUTE_T] = st.nT * static_cast<float>(state.textureHeight);
+		result.attributes[ATTRIBUTE_Q] = rgbaq.nQ;
+	}
+
+	result.attributes[ATTRIBUTE_FOG] = vertex.fog;
+}
+
+bool CGSH_Software::ClipPrimitiveBounds(PRIMITIVE& primitive, const DRAW_STATE& state, int32 minX, int32 minY, int32 maxX, int32 maxY) const
+{
+	primitive.minX = std::max<int32>(minX, state.scissor.scax0);
+	primitive.minY = std::max<int32>(minY, state.scissor.scay0);
+	primitive.maxX = std::min<int32>(maxX, state.scissor.scax1);
+	primitive.maxY = std::min<int32>(maxY, state.scissor.scay1);
+	return (primitive.minX <= primitive.maxX) && (primitive.minY <= primitive.maxY);
+}
+
+void CGSH_Software::SetConstantPlanes(PRIMITIVE& primitive, const SETUP_VERTEX& vertex)
+{
+	for(uint32 i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		primitive.planes[i].base = vertex.attributes[i];
+		primitive.planes[i].dx = 0;
+		primitive.planes[i].dy = 0;
+	}
+	primitive.depth.base = vertex.z;
+	primitive.depth.dx = 0;
+	primitive.depth.dy = 0;
+}
+
+void CGSH_Software::Prim_Point()
+{
+	const auto& state = m_drawStates[m_drawStateIndex];
+
+	SETUP_VERTEX vertex;
+	SetupVertex(m_vtxBuffer[0], state, vertex);
+
+	PRIMITIVE primitive;
+	primitive.shape = PRIMITIVE_SHAPE_POINT;
+	primitive.stateIndex = m_drawStateIndex;
+	primitive.originX = vertex.x;
+	primitive.originY = vertex.y;
+	SetConstantPlanes(primitive, vertex);
+
+	int32 x = static_cast<int32>(std::floor(vertex.x + 0.5f));
+	int32 y = static_cast<int32>(std::floor(vertex.y + 0.5f));
+	if(!ClipPrimitiveBounds(primitive, state, x, y, x, y)) return;
+
+	QueuePrimitive(primitive);
+}
+
+void CGSH_Software::Prim_Line()
+{
+	const auto& state = m_drawStates[m_drawStateIndex];
+
+	SETUP_VERTEX vertices[2];
+	SetupVertex(m_vtxBuffer[1], state, vertices[0]);
+	SetupVertex(m_vtxBuffer[0], state, vertices[1]);
+
+	const auto& v0 = vertices[0];
+	const auto& v1 = vertices[1];
+
+	PRIMITIVE primitive;
+	primitive.shape = PRIMITIVE_SHAPE_LINE;
+	primitive.stateIndex = m_drawStateIndex;
+	primitive.originX = v0.x;
+	primitive.originY = v0.y;
+	primitive.line[0] = v0.x;
+	primitive.line[1] = v0.y;
+	primitive.line[2] = v1.x;
+	primitive.line[3] = v1.y;
+
+	//Attributes only vary along the major axis
+	float deltaX = v1.x - v0.x;
+	float deltaY = v1.y - v0.y;
+	bool xMajor = std::abs(deltaX) >= std::abs(deltaY);
+	float length = xMajor ? deltaX : deltaY;
+	if(length == 0) return;
+
+	for(uint32 i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		auto& plane = primitive.planes[i];
+		float delta = v1.attributes[i] - v0.attributes[i];
+		plane.base = v0.attributes[i];
+		plane.dx = xMajor ? (delta / length) : 0;
+		plane.dy = xMajor ? 0 : (delta / length);
+	}
+	double depthDelta = v1.z - v0.z;
+	primitive.depth.base = v0.z;
+	primitive.depth.dx = xMajor ? (depthDelta / length) : 0;
+	primitive.depth.dy = xMajor ? 0 : (depthDelta / length);
+
+	if(!state.gouraud)
+	{
+		for(uint32 i = ATTRIBUTE_R; i <= ATTRIBUTE_A; i++)
+		{
+			primitive.planes[i].base = v1.attributes[i];
+			primitive.planes[i].dx = 0;
+			primitive.planes[i].dy = 0;
+		}
+	}
+
+	int32 minX = static_cast<int32>(std::floor(std::min(v0.x, v1.x)));
+	int32 minY = static_cast<int32>(std::floor(std::min(v0.y, v1.y)));
+	int32 maxX = static_cast<int32>(std::ceil(std::max(v0.x, v1.x)));
+	int32 maxY = static_cast<int32>(std::ceil(std::max(v0.y, v1.y)));
+	if(!ClipPrimitiveBounds(primitive, state, minX, minY, maxX, maxY)) return;
+
+	QueuePrimitive(primitive);
+}
+
+void CGSH_Software::Prim_Triangle()
+{
+	const auto& state = m_drawStates[m_drawStateIndex];
+
+	SETUP_VERTEX vertices[3];
+	SetupVertex(m_vtxBuffer[2], state, vertices[0]);
+	SetupVertex(m_vtxBuffer[1], state, vertices[1]);
+	SetupVertex(m_vtxBuffer[0], state, vertices[2]);
+
+	if(!state.gouraud)
+	{
+		//Flat shading uses the color of the last vertex
+		for(uint32 i = ATTRIBUTE_R; i <= ATTRIBUTE_A; i++)
+		{
+			vertices[0].attributes[i] = vertices[2].attributes[i];
+			vertices[1].attributes[i] = vertices[2].attributes[i];
+		}
+	}
+
+	const auto& v0 = vertices[0];
+	const auto& v1 = vertices[1];
+	const auto& v2 = vertices[2];
+
+	double dx1 = v1.x - v0.x;
+	double dy1 = v1.y - v0.y;
+	double dx2 = v2.x - v0.x;
+	double dy2 = v2.y - v0.y;
+	double area = (dx1 * dy2) - (dx2 * dy1);
+	if(area == 0) return;
+
+	PRIMITIVE primitive;
+	primitive.shape = PRIMITIVE_SHAPE_TRIANGLE;
+	primitive.stateIndex = m_drawStateIndex;
+	primitive.originX = v0.x;
+	primitive.originY = v0.y;
+
+	//Pixels are sampled at integer coordinates
+	float minX = std::min(v0.x, std::min(v1.x, v2.x));
+	float minY = std::min(v0.y, std::min(v1.y, v2.y));
+	float maxX = std::max(v0.x, std::max(v1.x, v2.x));
+	float maxY = std::max(v0.y, std::max(v1.y, v2.y));
+	bool visible = ClipPrimitiveBounds(primitive, state,
+	                                   static_cast<int32>(std::ceil(minX)), static_cast<int32>(std::ceil(minY)),
+	                                   static_cast<int32>(std::ceil(maxX)) - 1, static_cast<int32>(std::ceil(maxY)) - 1);
+	if(!visible) return;
+
+	for(uint32 i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		auto& plane = primitive.planes[i];
+		double da1 = v1.attributes[i] - v0.attributes[i];
+		double da2 = v2.attributes[i] - v0.attributes[i];
+		plane.base = v0.attributes[i];
+		plane.dx = static_cast<float>(((da1 * dy2) - (da2 * dy1)) / area);
+		plane.dy = static_cast<float>(((da2 * dx1) - (da1 * dx2)) / area);
+	}
+
+	{
+		double dz1 = v1.z - v0.z;
+		double dz2 = v2.z - v0.z;
+		primitive.depth.base = v0.z;
+		primitive.depth.dx = ((dz1 * dy2) - (dz2 * dy1)) / area;
+		primitive.depth.dy = ((dz2 * dx1) - (dz1 * dx2)) / area;
+	}
+
+	const SETUP_VERTEX* edgeVertices[3] = {&v0, &v1, &v2};
+	for(uint32 i = 0; i < 3; i++)
+	{
+		const auto& a = *edgeVertices[i];
+		const auto& b = *edgeVertices[(i + 1) % 3];
+		const auto& c = *edgeVertices[(i + 2) % 3];
+		auto& edge = primitive.edges[i];
+		edge.a = static_cast<double>(b.y) - static_cast<double>(a.y);
+		edge.b = static_cast<double>(a.x) - static_cast<double>(b.x);
+		edge.c = (edge.a * (static_cast<double>(v0.x) - a.x)) + (edge.b * (static_cast<double>(v0.y) - a.y));
+		double side = (edge.a * (static_cast<double>(c.x) - v0.x)) + (edge.b * (static_cast<double>(c.y) - v0.y)) + edge.c;
+		if(side < 0)
+		{
+			edge.a = -edge.a;
+			edge.b = -edge.b;
+			edge.c = -edge.c;
+		}
+	}
+
+	QueuePrimitive(primitive);
+}
+
+void CGSH_Software::Prim_Sprite()
+{
+	const auto& state = m_drawStates[m_drawStateIndex];
+
+	SETUP_VERTEX vertices[2];
+	SetupVertex(m_vtxBuffer[1], state, vertices[0]);
+	SetupVertex(m_vtxBuffer[0], state, vertices[1]);
+
+	auto& v0 = vertices[0];
+	auto& v1 = vertices[1];
+
+	if(!state.fst)
+	{
+		//Sprites are not perspective corrected
+		for(auto vertex : {&v0, &v1})
+		{
+			float q = vertex->attributes[ATTRIBUTE_Q];
+			vertex->attributes[ATTRIBUTE_S] /= q;
+			vertex->attributes[ATTRIBUTE_T] /= q;
+			vertex->attributes[ATTRIBUTE_Q] = 1.0f;
+		}
+	}
+
+	float width = v1.x - v0.x;
+	float height = v1.y - v0.y;
+	if((width == 0) || (height == 0)) return;
+
+	PRIMITIVE primitive;
+	primitive.shape = PRIMITIVE_SHAPE_SPRITE;
+	primitive.stateIndex = m_drawStateIndex;
+	primitive.originX = v0.x;
+	primitive.originY = v0.y;
+
+	//Everything but texture coordinates comes from the last vertex
+	SetConstantPlanes(primitive, v1);
+	primitive.planes[ATTRIBUTE_S].base = v0.attributes[ATTRIBUTE_S];
+	primitive.planes[ATTRIBUTE_S].dx = (v1.attributes[ATTRIBUTE_S] - v0.attributes[ATTRIBUTE_S]) / width;
+	primitive.planes[ATTRIBUTE_T].base = v0.attributes[ATTRIBUTE_T];
+	primitive.planes[ATTRIBUTE_T].dy = (v1.attributes[ATTRIBUTE_T] - v0.attributes[ATTRIBUTE_T]) / height;
+
+	bool visible = ClipPrimitiveBounds(primitive, state,
+	                                   static_cast<int32>(std::ceil(std::min(v0.x, v1.x))), static_cast<int32>(std::ceil(std::min(v0.y, v1.y))),
+	                                   static_cast<int32>(std::ceil(std::max(v0.x, v1.x))) - 1, static_cast<int32>(std::ceil(std::max(v0.y, v1.y))) - 1);
+	if(!visible) return;
+
+	QueuePrimitive(primitive);
+}
+
+void CGSH_Software::QueuePrimitive(const PRIMITIVE& primitive)
+{
+	assert(m_primitives.size() < MAX_PRIMITIVES);
+	uint32 primitiveIndex = static_cast<uint32>(m_primitives.size());
+	m_primitives.push_back(primitive);
+
+	uint32 tileX0 = primitive.minX >> TILE_SIZE_LOG2;
+	uint32 tileY0 = primitive.minY >> TILE_SIZE_LOG2;
+	uint32 tileX1 = primitive.maxX >> TILE_SIZE_LOG2;
+	uint32 tileY1 = primitive.maxY >> TILE_SIZE_LOG2;
+	for(uint32 tileY = tileY0; tileY <= tileY1; tileY++)
+	{
+		for(uint32 tileX = tileX0; tileX <= tileX1; tileX++)
+		{
+			uint32 tileIndex = tileX + (tileY * TILE_COUNT_X);
+			auto& tile = m_tiles[tileIndex];
+			if(tile.empty())
+			{
+				m_activeTiles.push_back(tileIndex);
+			}
+			tile.push_back(primitiveIndex);
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Batch Processing
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::ClearBatch()
+{
+	for(auto tileIndex : m_activeTiles)
+	{
+		m_tiles[tileIndex].clear();
+	}
+	m_activeTiles.clear();
+	m_primitives.clear();
+	m_drawStates.clear();
+	m_batchWriteRange = MEMORY_RANGE();
+	m_batchReadRange = MEMORY_RANGE();
+	m_drawStateDirty = true;
+}
+
+void CGSH_Software::FlushPrimitives()
+{
+	if(m_primitives.empty()) return;
+
+	m_nextTileIndex = 0;
+	if(m_workerThreads.empty() || (m_activeTiles.size() < 2))
+	{
+		ProcessTiles();
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> workerLock(m_workerMutex);
+			m_busyWorkerCount = static_cast<uint32>(m_workerThreads.size());
+			m_workerGeneration++;
+		}
+		m_workerCondition.notify_all();
+		ProcessTiles();
+		std::unique_lock<std::mutex> workerLock(m_workerMutex);
+		m_workerDoneCondition.wait(workerLock, [this]() { return m_busyWorkerCount == 0; });
+	}
+
+	m_drawCallCount++;
+	ClearBatch();
+}
+
+void CGSH_Software::StopWorkerThreads()
+{
+	{
+		std::lock_guard<std::mutex> workerLock(m_workerMutex);
+		m_workerThreadsDone = true;
+	}
+	m_workerCondition.notify_all();
+	for(auto& workerThread : m_workerThreads)
+	{
+		workerThread.join();
+	}
+	m_workerThreads.clear();
+}
+
+void CGSH_Software::WorkerThreadProc(uint32 generation)
+{
+	while(1)
+	{
+		{
+			std::unique_lock<std::mutex> workerLock(m_workerMutex);
+			m_workerCondition.wait(workerLock, [&]() { return m_workerThreadsDone || (m_workerGeneration != generation); });
+			if(m_workerThreadsDone) break;
+			generation = m_workerGeneration;
+		}
+		ProcessTiles();
+		{
+			std::lock_guard<std::mutex> workerLock(m_workerMutex);
+			m_busyWorkerCount--;
+		}
+		m_workerDoneCondition.notify_one();
+	}
+}
+
+void CGSH_Software::ProcessTiles()
+{
+	while(1)
+	{
+		uint32 activeTileIndex = m_nextTileIndex++;
+		if(activeTileIndex >= m_activeTiles.size()) break;
+		DrawTile(m_activeTiles[activeTileIndex]);
+	}
+}
+
+void CGSH_Software::DrawTile(uint32 tileIndex)
+{
+	int32 tileX0 = (tileIndex % TILE_COUNT_X) * TILE_SIZE;
+	int32 tileY0 = (tileIndex / TILE_COUNT_X) * TILE_SIZE;
+	int32 tileX1 = tileX0 + TILE_SIZE - 1;
+	int32 tileY1 = tileY0 + TILE_SIZE - 1;
+
+	for(auto primitiveIndex : m_tiles[tileIndex])
+	{
+		const auto& primitive = m_primitives[primitiveIndex];
+		int32 x0 = std::max(primitive.minX, tileX0);
+		int32 y0 = std::max(primitive.minY, tileY0);
+		int32 x1 = std::min(primitive.maxX, tileX1);
+		int32 y1 = std::min(primitive.maxY, tileY1);
+		assert((x0 <= x1) && (y0 <= y1));
+
+		switch(primitive.shape)
+		{
+		case PRIMITIVE_SHAPE_POINT:
+			DrawSpan(primitive, y0, x0, x0 + 1);
+			break;
+		case PRIMITIVE_SHAPE_LINE:
+			DrawLine(primitive, x0, y0, x1, y1);
+			break;
+		case PRIMITIVE_SHAPE_TRIANGLE:
+			DrawTriangle(primitive, x0, y0, x1, y1);
+			break;
+		case PRIMITIVE_SHAPE_SPRITE:
+			for(int32 y = y0; y <= y1; y++)
+			{
+				DrawSpan(primitive, y, x0, x1 + 1);
+			}
+			break;
+		}
+	}
+}
+
+void CGSH_Software::DrawLine(const PRIMITIVE& primitive, int32 clipX0, int32 clipY0, int32 clipX1, int32 clipY1)
+{
+	float startX = primitive.line[0];
+	float startY = primitive.line[1];
+	float endX = primitive.line[2];
+	float endY = primitive.line[3];
+	bool xMajor = std::abs(endX - startX) >= std::abs(endY - startY);
+
+	if(!xMajor)
+	{
+		std::swap(startX, startY);
+		std::swap(endX, endY);
+		std::swap(clipX0, clipY0);
+		std::swap(clipX1, clipY1);
+	}
+	if(startX > endX)
+	{
+		std::swap(startX, endX);
+		std::swap(startY, endY);
+	}
+
+	float slope = (endY - startY) / (endX - startX);
+	int32 major0 = std::max(static_cast<int32>(std::ceil(startX)), clipX0);
+	int32 major1 = std::min(static_cast<int32>(std::ceil(endX)) - 1, clipX1);
+	for(int32 major = major0; major <= major1; major++)
+	{
+		int32 minor = static_cast<int32>(std::floor(startY + ((static_cast<float>(major) - startX) * slope) + 0.5f));
+		if((minor < clipY0) || (minor > clipY1)) continue;
+		if(xMajor)
+		{
+			DrawSpan(primitive, minor, major, major + 1);
+		}
+		else
+		{
+			DrawSpan(primitive, major, minor, minor + 1);
+		}
+	}
+}
+
+void CGSH_Software::DrawTriangle(const PRIMITIVE& primitive, int32 clipX0, int32 clipY0, int32 clipX1, int32 clipY1)
+{
+	double originX = primitive.originX;
+	double originY = primitive.originY;
+
+	for(int32 y = clipY0; y <= clipY1; y++)
+	{
+		double relativeY = static_cast<double>(y) - originY;
+		double left = clipX0;
+		double right = clipX1 + 1;
+		bool empty = false;
+
+		//Top-left fill convention: left and top edges are inclusive
+		for(const auto& edge : primitive.edges)
+		{
+			double k = (edge.b * relativeY) + edge.c;
+			if(edge.a > 0)
+			{
+				left = std::max(left, std::ceil(originX - (k / edge.a)));
+			}
+			else if(edge.a < 0)
+			{
+				right = std::min(right, std::ceil(originX - (k / edge.a)));
+			}
+			else if((k < 0) || ((k == 0) && (edge.b < 0)))
+			{
+				empty = true;
+			}
+		}
+
+		if(empty || (left >= right)) continue;
+		DrawSpan(primitive, y, static_cast<int32>(left), static_cast<int32>(right));
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Pixel Pipeline
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::DrawSpan(const PRIMITIVE& primitive, int32 y, int32 xStart, int32 xEnd)
+{
+	const auto& state = m_drawStates[primitive.stateIndex];
+
+	float relativeX = static_cast<float>(xStart) - primitive.originX;
+	float relativeY = static_cast<float>(y) - primitive.originY;
+
+	float attributes[ATTRIBUTE_COUNT];
+	float gradients[ATTRIBUTE_COUNT];
+	for(uint32 i = 0; i < ATTRIBUTE_COUNT; i++)
+	{
+		const auto& plane = primitive.planes[i];
+		attributes[i] = plane.base + (plane.dx * relativeX) + (plane.dy * relativeY);
+		gradients[i] = plane.dx;
+	}
+	double depth = primitive.depth.base + (primitive.depth.dx * relativeX) + (primitive.depth.dy * relativeY);
+
+	bool depthTest = state.test.nDepthEnabled != 0;
+	bool depthWrite = depthTest && !state.zbuf.nMask;
+	double maxDepth = 0;
+	switch(state.depthPsm)
+	{
+	case PSMZ32:
+		maxDepth = 0xFFFFFFFF;
+		break;
+	case PSMZ24:
+		maxDepth = 0x00FFFFFF;
+		break;
+	default:
+		maxDepth = 0x0000FFFF;
+		break;
+	}
+
+	bool destAlphaTest = state.test.nDestAlphaEnabled != 0;
+	bool needsDestColor = state.blended || destAlphaTest;
+
+	QUAD quad;
+	for(int32 x = xStart; x < xEnd; x += SPAN_CHUNK_SIZE)
+	{
+		quad.count = std::min<uint32>(SPAN_CHUNK_SIZE, xEnd - x);
+		InterpolateQuad(state, attributes, gradients, quad);
+		if(state.textured)
+		{
+			SampleQuad(state, quad);
+			CombineQuad(state, quad);
+		}
+		if(state.fogged)
+		{
+			FogQuad(state, quad);
+		}
+
+		uint32 depths[SPAN_CHUNK_SIZE] = {};
+		uint32 destColors[SPAN_CHUNK_SIZE] = {};
+		uint32 frameWriteMask = 0;
+		uint32 depthWriteMask = 0;
+		uint32 alphaWriteMask = 0;
+
+		for(uint32 i = 0; i < quad.count; i++)
+		{
+			uint32 pixelX = x + i;
+			depths[i] = static_cast<uint32>(std::clamp(depth + (primitive.depth.dx * i), 0.0, maxDepth));
+
+			if(depthTest)
+			{
+				uint32 storedDepth = ReadDepthPixel(state, pixelX, y);
+				bool depthPassed = true;
+				switch(state.test.nDepthMethod)
+				{
+				case DEPTH_TEST_NEVER:
+					depthPassed = false;
+					break;
+				case DEPTH_TEST_ALWAYS:
+					break;
+				case DEPTH_TEST_GEQUAL:
+					depthPassed = depths[i] >= storedDepth;
+					break;
+				case DEPTH_TEST_GREATER:
+					depthPassed = depths[i] > storedDepth;
+					break;
+				}
+				if(!depthPassed) continue;
+			}
+
+			bool frameWrite = true;
+			bool depthWritePixel = depthWrite;
+			bool alphaWrite = true;
+			if(state.test.nAlphaEnabled && !AlphaTestPasses(state.test.nAlphaMethod, quad.colors[i] >> 24, state.test.nAlphaRef))
+			{
+				switch(state.test.nAlphaFail)
+				{
+				case ALPHA_TEST_FAIL_KEEP:
+					frameWrite = false;
+					depthWritePixel = false;
+					break;
+				case ALPHA_TEST_FAIL_FBONLY:
+					depthWritePixel = false;
+					break;
+				case ALPHA_TEST_FAIL_ZBONLY:
+					frameWrite = false;
+					break;
+				case ALPHA_TEST_FAIL_RGBONLY:
+					depthWritePixel = false;
+					alphaWrite = false;
+					break;
+				}
+			}
+
+			if(frameWrite && needsDestColor)
+			{
+				destColors[i] = ReadFramePixel(state, pixelX, y);
+				if(destAlphaTest && ((destColors[i] >> 31) != state.test.nDestAlphaMode))
+				{
+					continue;
+				}
+			}
+
+			if(frameWrite) frameWriteMask |= (1 << i);
+			if(depthWritePixel) depthWriteMask |= (1 << i);
+			if(alphaWrite) alphaWriteMask |= (1 << i);
+		}
+
+		if(frameWriteMask && state.blended)
+		{
+			BlendQuad(state, quad.colors, destColors, quad.colors);
+		}
+
+		for(uint32 i = 0; i < quad.count; i++)
+		{
+			uint32 pixelX = x + i;
+			if(frameWriteMask & (1 << i))
+			{
+				uint32 writeMask = (alphaWriteMask & (1 << i)) ? ~0U : 0x00FFFFFF;
+				WriteFramePixel(state, pixelX, y, quad.colors[i], writeMask);
+			}
+			if(depthWriteMask & (1 << i))
+			{
+				WriteDepthPixel(state, pixelX, y, depths[i]);
+			}
+		}
+
+		for(uint32 i = 0; i < ATTRIBUTE_COUNT; i++)
+		{
+			attributes[i] += gradients[i] * static_cast<float>(quad.count);
+		}
+		depth += primitive.depth.dx * quad.count;
+	}
+}
+
+#ifdef GSH_SOFTWARE_USE_SSE2
+
+//Packs 4 vectors of R, G, B, A values into 4 RGBA pixels, saturating components to [0, 255]
+static __m128i PackColors(__m128i r, __m128i g, __m128i b, __m128i a)
+{
+	__m128i components = _mm_packus_epi16(_mm_packs_epi32(r, g), _mm_packs_epi32(b, a));
+	__m128i rg = _mm_unpacklo_epi8(components, _mm_srli_si128(components, 4));
+	__m128i ba = _mm_unpacklo_epi8(_mm_srli_si128(components, 8), _mm_srli_si128(components, 12));
+	return _mm_unpacklo_epi16(rg, ba);
+}
+
+static __m128i FloorToInt(__m128 value)
+{
+	__m128i result = _mm_cvttps_epi32(value);
+	//Truncation rounds negative values up, compensate
+	__m128i adjust = _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(result), value));
+	return _mm_add_epi32(result, adjust);
+}
+
+//Computes (a * b) >> shift on signed 16-bit lanes using 32-bit intermediate results
+template <int shift>
+static __m128i MultiplyShift(__m128i a, __m128i b)
+{
+	__m128i productLo = _mm_mullo_epi16(a, b);
+	__m128i productHi = _mm_mulhi_epi16(a, b);
+	__m128i result0 = _mm_srai_epi32(_mm_unpacklo_epi16(productLo, productHi), shift);
+	__m128i result1 = _mm_srai_epi32(_mm_unpackhi_epi16(productLo, productHi), shift);
+	return _mm_packs_epi32(result0, result1);
+}
+
+static __m128i BroadcastAlpha(__m128i colors16)
+{
+	return _mm_shufflehi_epi16(_mm_shufflelo_epi16(colors16, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+void CGSH_Software::InterpolateQuad(const DRAW_STATE& state, const float* attributes, const float* gradients, QUAD& quad) const
+{
+	const __m128 steps = _mm_set_ps(3, 2, 1, 0);
+
+	auto interpolate =
+	    [&](uint32 attribute) {
+		    return _mm_add_ps(_mm_set1_ps(attributes[attribute]), _mm_mul_ps(_mm_set1_ps(gradients[attribute]), steps));
+	    };
+
+	__m128i r = _mm_cvttps_epi32(interpolate(ATTRIBUTE_R));
+	__m128i g = _mm_cvttps_epi32(interpolate(ATTRIBUTE_G));
+	__m128i b = _mm_cvttps_epi32(interpolate(ATTRIBUTE_B));
+	__m128i a = _mm_cvttps_epi32(interpolate(ATTRIBUTE_A));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(quad.colors), PackColors(r, g, b, a));
+
+	if(state.textured)
+	{
+		//Texture coordinates are kept with 4 bits of fraction for filtering
+		const __m128 fixedScale = _mm_set1_ps(16.0f);
+		const __m128 minCoord = _mm_set1_ps(-32768.0f * 16.0f);
+		const __m128 maxCoord = _mm_set1_ps(32767.0f * 16.0f);
+		__m128 q = interpolate(ATTRIBUTE_Q);
+		__m128 u = _mm_mul_ps(_mm_div_ps(interpolate(ATTRIBUTE_S), q), fixedScale);
+		__m128 v = _mm_mul_ps(_mm_div_ps(interpolate(ATTRIBUTE_T), q), fixedScale);
+		u = _mm_min_ps(_mm_max_ps(u, minCoord), maxCoord);
+		v = _mm_min_ps(_mm_max_ps(v, minCoord), maxCoord);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(quad.texCoordsU), FloorToInt(u));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(quad.texCoordsV), FloorToInt(v));
+	}
+
+	if(state.fogged)
+	{
+		__m128i fog = _mm_cvttps_epi32(interpolate(ATTRIBUTE_FOG));
+		fog = _mm_packs_epi32(fog, fog);
+		fog = _mm_packus_epi16(fog, fog);
+		fog = _mm_unpacklo_epi16(_mm_unpacklo_epi8(fog, _mm_setzero_si128()), _mm_setzero_si128());
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(quad.fogs), fog);
+	}
+}
+
+void CGSH_Software::CombineQuad(const DRAW_STATE& state, QUAD& quad)
+{
+	const __m128i zero = _mm_setzero_si128();
+	uint32 colorValues[SPAN_CHUNK_SIZE];
+	memcpy(colorValues, quad.colors, sizeof(colorValues));
+
+	__m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quad.texels));
+	__m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colorValues));
+
+	__m128i result = texels;
+	if(state.tex0.nFunction != TEX0_FUNCTION_DECAL)
+	{
+		__m128i texels0 = _mm_unpacklo_epi8(texels, zero);
+		__m128i texels1 = _mm_unpackhi_epi8(texels, zero);
+		__m128i colors0 = _mm_unpacklo_epi8(colors, zero);
+		__m128i colors1 = _mm_unpackhi_epi8(colors, zero);
+		//Products fit in unsigned 16-bit lanes
+		__m128i result0 = _mm_srli_epi16(_mm_mullo_epi16(texels0, colors0), 7);
+		__m128i result1 = _mm_srli_epi16(_mm_mullo_epi16(texels1, colors1), 7);
+		if(state.tex0.nFunction != TEX0_FUNCTION_MODULATE)
+		{
+			result0 = _mm_add_epi16(result0, BroadcastAlpha(colors0));
+			result1 = _mm_add_epi16(result1, BroadcastAlpha(colors1));
+		}
+		result = _mm_packus_epi16(result0, result1);
+	}
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(quad.colors), result);
+
+	CombineQuadAlpha(state, quad, colorValues);
+}
+
+void CGSH_Software::FogQuad(const DRAW_STATE& state, QUAD& quad)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+	__m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quad.colors));
+	__m128i fogs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(quad.fogs));
+	__m128i fogColor = _mm_unpacklo_epi8(_mm_set1_epi32(static_cast<uint32>(state.fogCol) & 0x00FFFFFF), zero);
+
+	//Spread fog factors to every component of their pixel
+	fogs = _mm_or_si128(fogs, _mm_slli_epi32(fogs, 16));
+	__m128i fogs0 = _mm_unpacklo_epi32(fogs, fogs);
+	__m128i fogs1 = _mm_unpackhi_epi32(fogs, fogs);
+	__m128i inverseFogs0 = _mm_sub_epi16(_mm_set1_epi16(0xFF), fogs0);
+	__m128i inverseFogs1 = _mm_sub_epi16(_mm_set1_epi16(0xFF), fogs1);
+
+	//(F * C + (255 - F) * FOGCOL) >> 8, both products are summed by madd
+	auto fogPixels =
+	    [&](__m128i colors16, __m128i fogs16, __m128i inverseFogs16) {
+		    __m128i sum0 = _mm_madd_epi16(_mm_unpacklo_epi16(colors16, fogColor), _mm_unpacklo_epi16(fogs16, inverseFogs16));
+		    __m128i sum1 = _mm_madd_epi16(_mm_unpackhi_epi16(colors16, fogColor), _mm_unpackhi_epi16(fogs16, inverseFogs16));
+		    return _mm_packs_epi32(_mm_srli_epi32(sum0, 8), _mm_srli_epi32(sum1, 8));
+	    };
+
+	__m128i result0 = fogPixels(_mm_unpacklo_epi8(colors, zero), fogs0, inverseFogs0);
+	__m128i result1 = fogPixels(_mm_unpackhi_epi8(colors, zero), fogs1, inverseFogs1);
+	__m128i result = _mm_packus_epi16(result0, result1);
+	result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, colors));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(quad.colors), result);
+}
+
+void CGSH_Software::BlendQuad(const DRAW_STATE& state, const uint32* srcColors, const uint32* dstColors, uint32* outColors)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+	__m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(srcColors));
+	__m128i dst = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dstColors));
+
+	auto blendPixels =
+	    [&](__m128i src16, __m128i dst16) {
+		    const __m128i colors[ALPHABLEND_ABD_INVALID + 1] = {src16, dst16, zero, zero};
+		    const __m128i alphas[ALPHABLEND_C_INVALID + 1] = {BroadcastAlpha(src16), BroadcastAlpha(dst16), _mm_set1_epi16(state.alpha.nFix), _mm_set1_epi16(state.alpha.nFix)};
+		    __m128i difference = _mm_sub_epi16(colors[state.alpha.nA], colors[state.alpha.nB]);
+		    __m128i result = _mm_add_epi16(MultiplyShift<7>(difference, alphas[state.alpha.nC]), colors[state.alpha.nD]);
+		    if(!state.colClamp)
+		    {
+			    result = _mm_and_si128(result, _mm_set1_epi16(0xFF));
+		    }
+		    return result;
+	    };
+
+	__m128i result0 = blendPixels(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero));
+	__m128i result1 = blendPixels(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero));
+	__m128i result = _mm_packus_epi16(result0, result1);
+
+	//Blending doesn't affect alpha
+	result = _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(alphaMask, src));
+
+	if(state.pabe)
+	{
+		//Only blend pixels with the MSB of alpha set
+		__m128i blendMask = _mm_srai_epi32(src, 31);
+		result = _mm_or_si128(_mm_and_si128(blendMask, result), _mm_andnot_si128(blendMask, src));
+	}
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(outColors), result);
+}
+
+#else
+
+void CGSH_Software::InterpolateQuad(const DRAW_STATE& state, const float* attributes, const float* gradients, QUAD& quad) const
+{
+	for(uint32 i = 0; i < SPAN_CHUNK_SIZE; i++)
+	{
+		float step = static_cast<float>(i);
+		uint32 color = 0;
+		for(uint32 component = 0; component < 4; component++)
+		{
+			uint32 attribute = ATTRIBUTE_R + component;
+			int32 value = ClampToInt(attributes[attribute] + (gradients[attribute] * step), 0, 255);
+			color |= value << (component * 8);
+		}
+		quad.colors[i] = color;
+
+		if(state.textured)
+		{
+			float q = attributes[ATTRIBUTE_Q] + (gradients[ATTRIBUTE_Q] * step);
+			float u = (attributes[ATTRIBUTE_S] + (gradients[ATTRIBUTE_S] * step)) / q;
+			float v = (attributes[ATTRIBUTE_T] + (gradients[ATTRIBUTE_T] * step)) / q;
+			quad.texCoordsU[i] = ClampToInt(std::floor(u * 16.0f), -32768.0f * 16.0f, 32767.0f * 16.0f);
+			quad.texCoordsV[i] = ClampToInt(std::floor(v * 16.0f), -32768.0f * 16.0f, 32767.0f * 16.0f);
+		}
+
+		if(state.fogged)
+		{
+			quad.fogs[i] = ClampToInt(attributes[ATTRIBUTE_FOG] + (gradients[ATTRIBUTE_FOG] * step), 0, 255);
+		}
+	}
+}
+
+void CGSH_Software::CombineQuad(const DRAW_STATE& state, QUAD& quad)
+{
+	uint32 colors[SPAN_CHUNK_SIZE];
+	memcpy(colors, quad.colors, sizeof(colors));
+
+	for(uint32 i = 0; i < SPAN_CHUNK_SIZE; i++)
+	{
+		uint32 texel = quad.texels[i];
+		uint32 color = colors[i];
+		uint32 colorAlpha = color >> 24;
+		uint32 result = 0;
+		for(uint32 shift = 0; shift < 24; shift += 8)
+		{
+			uint32 texelComponent = (texel >> shift) & 0xFF;
+			uint32 colorComponent = (color >> shift) & 0xFF;
+			uint32 value = texelComponent;
+			if(state.tex0.nFunction != TEX0_FUNCTION_DECAL)
+			{
+				value = (texelComponent * colorComponent) >> 7;
+				if(state.tex0.nFunction != TEX0_FUNCTION_MODULATE)
+				{
+					value += colorAlpha;
+				}
+				value = std::min<uint32>(value, 0xFF);
+			}
+			result |= value << shift;
+		}
+		quad.colors[i] = result;
+	}
+
+	CombineQuadAlpha(state, quad, colors);
+}
+
+void CGSH_Software::FogQuad(const DRAW_STATE& state, QUAD& quad)
+{
+	uint32 fogColor = static_cast<uint32>(state.fogCol);
+	for(uint32 i = 0; i < SPAN_CHUNK_SIZE; i++)
+	{
+		uint32 fog = quad.fogs[i];
+		uint32 color = quad.colors[i];
+		uint32 result = color & 0xFF000000;
+		for(uint32 shift = 0; shift < 24; shift += 8)
+		{
+			uint32 colorComponent = (color >> shift) & 0xFF;
+			uint32 fogComponent = (fogColor >> shift) & 0xFF;
+			uint32 value = ((fog * colorComponent) + ((0xFF - fog) * fogComponent)) >> 8;
+			result |= value << shift;
+		}
+		quad.colors[i] = result;
+	}
+}
+
+void CGSH_Software::BlendQuad(const DRAW_STATE& state, const uint32* srcColors, const uint32* dstColors, uint32* outColors)
+{
+	for(uint32 i = 0; i < SPAN_CHUNK_SIZE; i++)
+	{
+		uint32 src = srcColors[i];
+		uint32 dst = dstColors[i];
+		uint32 srcAlpha = src >> 24;
+		if(state.pabe && !(srcAlpha & 0x80))
+		{
+			outColors[i] = src;
+			continue;
+		}
+		const int32 alphas[ALPHABLEND_C_INVALID + 1] = {static_cast<int32>(srcAlpha), static_cast<int32>(dst >> 24), static_cast<int32>(state.alpha.nFix), static_cast<int32>(state.alpha.nFix)};
+		int32 c = alphas[state.alpha.nC];
+		uint32 result = src & 0xFF000000;
+		for(uint32 shift = 0; shift < 24; shift += 8)
+		{
+			const int32 colors[ALPHABLEND_ABD_INVALID + 1] = {static_cast<int32>((src >> shift) & 0xFF), static_cast<int32>((dst >> shift) & 0xFF), 0, 0};
+			int32 value = (((colors[state.alpha.nA] - colors[state.alpha.nB]) * c) >> 7) + colors[state.alpha.nD];
+			value = state.colClamp ? std::clamp(value, 0, 0xFF) : (value & 0xFF);
+			result |= static_cast<uint32>(value) << shift;
+		}
+		outColors[i] = result;
+	}
+}
+
+#endif
+
+void CGSH_Software::CombineQuadAlpha(const DRAW_STATE& state, QUAD& quad, const uint32* colors)
+{
+	bool hasTextureAlpha = state.tex0.nColorComp != 0;
+	for(uint32 i = 0; i < SPAN_CHUNK_SIZE; i++)
+	{
+		uint32 colorAlpha = colors[i] >> 24;
+		uint32 texelAlpha = quad.texels[i] >> 24;
+		uint32 alpha = colorAlpha;
+		if(hasTextureAlpha)
+		{
+			switch(state.tex0.nFunction)
+			{
+			case TEX0_FUNCTION_MODULATE:
+				alpha = std::min<uint32>((texelAlpha * colorAlpha) >> 7, 0xFF);
+				break;
+			case TEX0_FUNCTION_DECAL:
+			case TEX0_FUNCTION_HIGHLIGHT2:
+				alpha = texelAlpha;
+				break;
+			case TEX0_FUNCTION_HIGHLIGHT:
+				alpha = std::min<uint32>(texelAlpha + colorAlpha, 0xFF);
+				break;
+			}
+		}
+		quad.colors[i] = (quad.colors[i] & 0x00FFFFFF) | (alpha << 24);
+	}
+}
+
+void CGSH_Software::SampleQuad(const DRAW_STATE& state, QUAD& quad) const
+{
+	bool bilinear = state.tex1.nMagFilter == MAG_FILTER_LINEAR;
+	for(uint32 i = 0; i < quad.count; i++)
+	{
+		int32 u = quad.texCoordsU[i];
+		int32 v = quad.texCoordsV[i];
+		if(!bilinear)
+		{
+			quad.texels[i] = FetchTexel(state, u >> 4, v >> 4);
+			continue;
+		}
+
+		//Texel centers are at half coordinates
+		u -= 8;
+		v -= 8;
+		int32 u0 = u >> 4;
+		int32 v0 = v >> 4;
+		uint32 fracU = u & 0xF;
+		uint32 fracV = v & 0xF;
+		uint32 texels[4] =
+		    {
+		        FetchTexel(state, u0, v0),
+		        FetchTexel(state, u0 + 1, v0),
+		        FetchTexel(state, u0, v0 + 1),
+		        FetchTexel(state, u0 + 1, v0 + 1),
+		    };
+		uint32 result = 0;
+		for(uint32 shift = 0; shift < 32; shift += 8)
+		{
+			uint32 top = (((texels[0] >> shift) & 0xFF) * (16 - fracU)) + (((texels[1] >> shift) & 0xFF) * fracU);
+			uint32 bottom = (((texels[2] >> shift) & 0xFF) * (16 - fracU)) + (((texels[3] >> shift) & 0xFF) * fracU);
+			uint32 value = ((top * (16 - fracV)) + (bottom * fracV)) >> 8;
+			result |= value << shift;
+		}
+		quad.texels[i] = result;
+	}
+}
+
+uint32 CGSH_Software::FetchTexel(const DRAW_STATE& state, int32 u, int32 v) const
+{
+	const auto& tex0 = state.tex0;
+	auto clamp = state.clamp;
+	u = WrapTexCoord(u, clamp.nWMS, state.textureWidth, clamp.GetMinU(), clamp.GetMaxU());
+	v = WrapTexCoord(v, clamp.nWMT, state.textureHeight, clamp.GetMinV(), clamp.GetMaxV());
+
+	switch(tex0.nPsm)
+	{
+	case PSMCT32:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return indexor.GetPixel(u, v);
+	}
+	case PSMCT24:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return ExpandColor24(indexor.GetPixel(u, v), state.texa);
+	}
+	case PSMCT16:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT16 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return ExpandColor16(indexor.GetPixel(u, v), state.texa);
+	}
+	case PSMCT16S:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT16S indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return ExpandColor16(indexor.GetPixel(u, v), state.texa);
+	}
+	case PSMT8:
+	{
+		CGsPixelFormats::CPixelIndexorPSMT8 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return state.clut[indexor.GetPixel(u, v)];
+	}
+	case PSMT4:
+	{
+		CGsPixelFormats::CPixelIndexorPSMT4 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return state.clut[indexor.GetPixel(u, v)];
+	}
+	case PSMT8H:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return state.clut[indexor.GetPixel(u, v) >> 24];
+	}
+	case PSMT4HL:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return state.clut[(indexor.GetPixel(u, v) >> 24) & 0x0F];
+	}
+	case PSMT4HH:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT32 indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return state.clut[indexor.GetPixel(u, v) >> 28];
+	}
+	case PSMZ32:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32> indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return indexor.GetPixel(u, v);
+	}
+	case PSMZ24:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32> indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return ExpandColor24(indexor.GetPixel(u, v), state.texa);
+	}
+	case PSMZ16:
+	case PSMZ16S:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ16> indexor(m_pRAM, tex0.GetBufPtr(), tex0.nBufWidth);
+		return ExpandColor16(indexor.GetPixel(u, v), state.texa);
+	}
+	default:
+		return 0;
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Memory Access
+/////////////////////////////////////////////////////////////
+
+uint32 CGSH_Software::ReadColor(uint8* ram, uint32 psm, uint32 basePtr, uint32 bufWidth, uint32 x, uint32 y)
+{
+	switch(psm)
+	{
+	case PSMCT32:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT32 indexor(ram, basePtr, bufWidth);
+		return indexor.GetPixel(x, y);
+	}
+	case PSMCT24:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT32 indexor(ram, basePtr, bufWidth);
+		return (indexor.GetPixel(x, y) & 0x00FFFFFF) | 0x80000000;
+	}
+	case PSMCT16:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT16 indexor(ram, basePtr, bufWidth);
+		return RGBA16ToRGBA32(indexor.GetPixel(x, y));
+	}
+	case PSMCT16S:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT16S indexor(ram, basePtr, bufWidth);
+		return RGBA16ToRGBA32(indexor.GetPixel(x, y));
+	}
+	case PSMZ32:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32> indexor(ram, basePtr, bufWidth);
+		return indexor.GetPixel(x, y);
+	}
+	case PSMZ24:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32> indexor(ram, basePtr, bufWidth);
+		return (indexor.GetPixel(x, y) & 0x00FFFFFF) | 0x80000000;
+	}
+	case PSMZ16:
+	case PSMZ16S:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ16> indexor(ram, basePtr, bufWidth);
+		return RGBA16ToRGBA32(indexor.GetPixel(x, y));
+	}
+	default:
+		return 0;
+	}
+}
+
+void CGSH_Software::WriteColor(uint8* ram, uint32 psm, uint32 basePtr, uint32 bufWidth, uint32 x, uint32 y, uint32 color, uint32 mask)
+{
+	auto writeColor32 =
+	    [&](uint32* pixel) {
+		    (*pixel) = ((*pixel) & ~mask) | (color & mask);
+	    };
+
+	auto writeColor16 =
+	    [&](uint16* pixel) {
+		    uint16 mask16 = RGBA32ToRGBA16(mask);
+		    (*pixel) = ((*pixel) & ~mask16) | (RGBA32ToRGBA16(color) & mask16);
+	    };
+
+	switch(psm)
+	{
+	case PSMCT24:
+	case PSMZ24:
+		mask &= 0x00FFFFFF;
+		[[fallthrough]];
+	case PSMCT32:
+	case PSMZ32:
+	{
+		if((psm == PSMZ32) || (psm == PSMZ24))
+		{
+			CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32> indexor(ram, basePtr, bufWidth);
+			writeColor32(indexor.GetPixelAddress(x, y));
+		}
+		else
+		{
+			CGsPixelFormats::CPixelIndexorPSMCT32 indexor(ram, basePtr, bufWidth);
+			writeColor32(indexor.GetPixelAddress(x, y));
+		}
+	}
+	break;
+	case PSMCT16:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT16 indexor(ram, basePtr, bufWidth);
+		writeColor16(indexor.GetPixelAddress(x, y));
+	}
+	break;
+	case PSMCT16S:
+	{
+		CGsPixelFormats::CPixelIndexorPSMCT16S indexor(ram, basePtr, bufWidth);
+		writeColor16(indexor.GetPixelAddress(x, y));
+	}
+	break;
+	case PSMZ16:
+	case PSMZ16S:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ16> indexor(ram, basePtr, bufWidth);
+		writeColor16(indexor.GetPixelAddress(x, y));
+	}
+	break;
+	}
+}
+
+uint32 CGSH_Software::ReadFramePixel(const DRAW_STATE& state, uint32 x, uint32 y) const
+{
+	return ReadColor(m_pRAM, state.framePsm, state.frame.GetBasePtr(), state.frame.nWidth, x, y);
+}
+
+void CGSH_Software::WriteFramePixel(const DRAW_STATE& state, uint32 x, uint32 y, uint32 color, uint32 mask) const
+{
+	if(state.fba)
+	{
+		color |= 0x80000000;
+	}
+	mask &= ~state.frame.nMask;
+	WriteColor(m_pRAM, state.framePsm, state.frame.GetBasePtr(), state.frame.nWidth, x, y, color, mask);
+}
+
+uint32 CGSH_Software::ReadDepthPixel(const DRAW_STATE& state, uint32 x, uint32 y) const
+{
+	switch(state.depthPsm)
+	{
+	case PSMZ32:
+	case PSMZ24:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32> indexor(m_pRAM, state.zbuf.GetBasePtr(), state.frame.nWidth);
+		uint32 depth = indexor.GetPixel(x, y);
+		return (state.depthPsm == PSMZ24) ? (depth & 0x00FFFFFF) : depth;
+	}
+	default:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ16> indexor(m_pRAM, state.zbuf.GetBasePtr(), state.frame.nWidth);
+		return indexor.GetPixel(x, y);
+	}
+	}
+}
+
+void CGSH_Software::WriteDepthPixel(const DRAW_STATE& state, uint32 x, uint32 y, uint32 depth) const
+{
+	switch(state.depthPsm)
+	{
+	case PSMZ32:
+	case PSMZ24:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ32> indexor(m_pRAM, state.zbuf.GetBasePtr(), state.frame.nWidth);
+		auto pixel = indexor.GetPixelAddress(x, y);
+		(*pixel) = (state.depthPsm == PSMZ24) ? (((*pixel) & 0xFF000000) | depth) : depth;
+	}
+	break;
+	default:
+	{
+		CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMZ16> indexor(m_pRAM, state.zbuf.GetBasePtr(), state.frame.nWidth);
+		indexor.SetPixel(x, y, static_cast<uint16>(depth));
+	}
+	break;
+	}
+}
+
+/////////////////////////////////////////////////////////////
+// Transfers
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::TransferWrite(const uint8* imageData, uint32 length)
+{
+	if(!m_primitives.empty())
+	{
+		auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+		auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+		auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+		auto [transferAddress, transferSize] = GetTransferInvalidationRange(bltBuf, trxReg, trxPos);
+
+		MEMORY_RANGE transferRange;
+		transferRange.start = transferAddress;
+		transferRange.end = transferAddress + transferSize;
+		if(transferRange.Overlaps(m_batchWriteRange) || transferRange.Overlaps(m_batchReadRange))
+		{
+			FlushPrimitives();
+		}
+	}
+	CGSHandler::TransferWrite(imageData, length);
+}
+
+void CGSH_Software::SyncCLUT(const TEX0& tex0)
+{
+	if(!m_primitives.empty() && (tex0.nCLD != 0))
+	{
+		//CLUT can be loaded from something that is being drawn
+		MEMORY_RANGE clutRange;
+		clutRange.start = tex0.GetCLUTPtr();
+		clutRange.end = clutRange.start + CGsPixelFormats::PAGESIZE;
+		if(clutRange.Overlaps(m_batchWriteRange))
+		{
+			FlushPrimitives();
+		}
+	}
+	CGSHandler::SyncCLUT(tex0);
+}
+
+void CGSH_Software::ProcessHostToLocalTransfer()
+{
+	//Data is already in GS memory, TransferWrite took care of pending primitives
+}
+
+void CGSH_Software::ProcessLocalToHostTransfer()
+{
+	FlushPrimitives();
+}
+
+void CGSH_Software::ProcessLocalToLocalTransfer()
+{
+	FlushPrimitives();
+
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+	switch(bltBuf.nSrcPsm)
+	{
+	case PSMCT32:
+	case PSMZ32:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT32>(~0U);
+		break;
+	case PSMCT24:
+	case PSMZ24:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT32>(0x00FFFFFF);
+		break;
+	case PSMT8H:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT32>(0xFF000000);
+		break;
+	case PSMT4HL:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT32>(0x0F000000);
+		break;
+	case PSMT4HH:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT32>(0xF0000000);
+		break;
+	case PSMCT16:
+	case PSMZ16:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT16>(~0U);
+		break;
+	case PSMCT16S:
+	case PSMZ16S:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMCT16S>(~0U);
+		break;
+	case PSMT8:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMT8>(~0U);
+		break;
+	case PSMT4:
+		TransferLocalToLocal<CGsPixelFormats::STORAGEPSMT4>(~0U);
+		break;
+	default:
+		assert(false);
+		break;
+	}
+}
+
+template <typename Storage>
+void CGSH_Software::TransferLocalToLocal(uint32 mask)
+{
+	typedef typename Storage::Unit Unit;
+
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+
+	CGsPixelFormats::CPixelIndexor<Storage> srcIndexor(m_pRAM, bltBuf.GetSrcPtr(), bltBuf.nSrcWidth);
+	CGsPixelFormats::CPixelIndexor<Storage> dstIndexor(m_pRAM, bltBuf.GetDstPtr(), bltBuf.nDstWidth);
+
+	//Read everything first in case source and destination overlap
+	std::vector<Unit> pixels(trxReg.nRRW * trxReg.nRRH);
+	auto pixel = pixels.begin();
+	for(uint32 y = 0; y < trxReg.nRRH; y++)
+	{
+		for(uint32 x = 0; x < trxReg.nRRW; x++)
+		{
+			*(pixel++) = srcIndexor.GetPixel((trxPos.nSSAX + x) % 2048, (trxPos.nSSAY + y) % 2048);
+		}
+	}
+
+	Unit unitMask = static_cast<Unit>(mask);
+	pixel = pixels.begin();
+	for(uint32 y = 0; y < trxReg.nRRH; y++)
+	{
+		for(uint32 x = 0; x < trxReg.nRRW; x++)
+		{
+			uint32 dstX = (trxPos.nDSAX + x) % 2048;
+			uint32 dstY = (trxPos.nDSAY + y) % 2048;
+			Unit value = *(pixel++);
+			if(unitMask != static_cast<Unit>(~0U))
+			{
+				value = (dstIndexor.GetPixel(dstX, dstY) & ~unitMask) | (value & unitMask);
+			}
+			dstIndexor.SetPixel(dstX, dstY, value);
+		}
+	}
+}
+
+void CGSH_Software::ProcessClutTransfer(uint32, uint32)
+{
+	m_drawStateDirty = true;
+}
+
+/////////////////////////////////////////////////////////////
+// Display
+/////////////////////////////////////////////////////////////
+
+void CGSH_Software::ReadFramebuffer(uint32 width, uint32 height, void* buffer)
+{
+	FlushPrimitives();
+
+	auto dispInfo = GetCurrentDisplayInfo();
+	auto fb = make_convertible<DISPFB>(dispInfo.first);
+
+	//24-bit BGR, bottom row first, same layout as what the OpenGL handler returns
+	auto pixels = reinterpret_cast<uint8*>(buffer);
+	for(uint32 y = 0; y < height; y++)
+	{
+		auto row = pixels + ((height - y - 1) * width * 3);
+		for(uint32 x = 0; x < width; x++)
+		{
+			uint32 color = ReadColor(m_pRAM, fb.nPSM, fb.GetBufPtr(), fb.nBufWidth, fb.nX + x, fb.nY + y);
+			row[(x * 3) + 0] = static_cast<uint8>(color >> 16);
+			row[(x * 3) + 1] = static_cast<uint8>(color >> 8);
+			row[(x * 3) + 2] = static_cast<uint8>(color >> 0);
+		}
+	}
+}
+
+Framework::CBitmap CGSH_Software::GetScreenshot()
+{
+	FlushPrimitives();
+
+	auto dispInfo = GetCurrentDisplayInfo();
+	auto fb = make_convertible<DISPFB>(dispInfo.first);
+	auto d = make_convertible<DISPLAY>(dispInfo.second);
+
+	unsigned int dispWidth = (d.nW + 1) / (d.nMagX + 1);
+	unsigned int dispHeight = (d.nH + 1);
+
+	bool halfHeight = GetCrtIsInterlaced() && GetCrtIsFrameMode();
+	if(halfHeight) dispHeight /= 2;
+
+	auto imgbuffer = Framework::CBitmap(dispWidth, dispHeight, 32);
+	auto pixels = imgbuffer.GetPixels();
+	for(uint32 y = 0; y < dispHeight; y++)
+	{
+		auto row = pixels + (y * imgbuffer.GetPitch());
+		for(uint32 x = 0; x < dispWidth; x++)
+		{
+			uint32 color = ReadColor(m_pRAM, fb.nPSM, fb.GetBufPtr(), fb.nBufWidth, fb.nX + x, fb.nY + y);
+			row[(x * 4) + 0] = static_cast<uint8>(color >> 0);
+			row[(x * 4) + 1] = static_cast<uint8>(color >> 8);
+			row[(x * 4) + 2] = static_cast<uint8>(color >> 16);
+			row[(x * 4) + 3] = 0xFF;
+		}
+	}
+	if(halfHeight)
+	{
+		return imgbuffer.Resize(dispWidth, dispHeight * 2);
+	}
+	return imgbuffer;
+}
@@ -0,0 +1,269 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "GSHandler.h"
+
+//Software rasterizer working directly on GS memory
+//Primitives are set up on the GS thread and binned into screen tiles. Tiles are rasterized in
+//parallel by a pool of worker threads when the batch is flushed, which happens before anything
+//else reads or writes GS memory (transfers, CLUT loads, flips, screenshots).
+class CGSH_Software : public CGSHandler
+{
+public:
+	CGSH_Software(bool = true, uint32 = 0);
+	virtual ~CGSH_Software();
+
+	void ProcessHostToLocalTransfer() override;
+	void ProcessLocalToHostTransfer() override;
+	void ProcessLocalToLocalTransfer() override;
+	void ProcessClutTransfer(uint32, uint32) override;
+	void ReadFramebuffer(uint32, uint32, void*) override;
+
+	Framework::CBitmap GetScreenshot() override;
+
+	static FactoryFunction GetFactoryFunction();
+
+protected:
+	void InitializeImpl() override;
+	void ReleaseImpl() override;
+	void ResetImpl() override;
+	void FlipImpl() override;
+	void WriteRegisterImpl(uint8, uint64) override;
+	void TransferWrite(const uint8*, uint32) override;
+	void SyncCLUT(const TEX0&) override;
+
+private:
+	enum
+	{
+		TILE_SIZE_LOG2 = 6,
+		TILE_SIZE = (1 << TILE_SIZE_LOG2),
+		TILE_COUNT_X = (2048 / TILE_SIZE),
+		TILE_COUNT_Y = (2048 / TILE_SIZE),
+		TILE_COUNT = (TILE_COUNT_X * TILE_COUNT_Y),
+	};
+
+	enum
+	{
+		MAX_PRIMITIVES = 0x4000,
+		SPAN_CHUNK_SIZE = 4,
+		MAX_DEFAULT_WORKER_COUNT = 7,
+	};
+
+	enum
+	{
+		STATE_REGISTER_COUNT = 13,
+	};
+
+	enum ATTRIBUTE
+	{
+		ATTRIBUTE_R,
+		ATTRIBUTE_G,
+		ATTRIBUTE_B,
+		ATTRIBUTE_A,
+		ATTRIBUTE_S,
+		ATTRIBUTE_T,
+		ATTRIBUTE_Q,
+		ATTRIBUTE_FOG,
+		ATTRIBUTE_COUNT,
+	};
+
+	enum PRIMITIVE_SHAPE
+	{
+		PRIMITIVE_SHAPE_POINT,
+		PRIMITIVE_SHAPE_LINE,
+		PRIMITIVE_SHAPE_TRIANGLE,
+		PRIMITIVE_SHAPE_SPRITE,
+	};
+
+	struct VERTEX
+	{
+		uint64 position;
+		uint64 rgbaq;
+		uint64 uv;
+		uint64 st;
+		uint8 fog;
+	};
+
+	struct SETUP_VERTEX
+	{
+		float x;
+		float y;
+		double z;
+		float attributes[ATTRIBUTE_COUNT];
+	};
+
+	//Attribute value at (x, y) is base + dx * (x - originX) + dy * (y - originY)
+	struct PLANE
+	{
+		float base;
+		float dx;
+		float dy;
+	};
+
+	struct DEPTH_PLANE
+	{
+		double base;
+		double dx;
+		double dy;
+	};
+
+	//Edge function a * (x - originX) + b * (y - originY) + c, positive inside
+	struct EDGE
+	{
+		double a;
+		double b;
+		double c;
+	};
+
+	struct PRIMITIVE
+	{
+		uint32 shape;
+		uint32 stateIndex;
+		int32 minX;
+		int32 minY;
+		int32 maxX;
+		int32 maxY;
+		float originX;
+		float originY;
+		PLANE planes[ATTRIBUTE_COUNT];
+		DEPTH_PLANE depth;
+		union
+		{
+			EDGE edges[3];
+			float line[4];
+		};
+	};
+
+	struct DRAW_STATE
+	{
+		//Values used to find out if the state changed
+		uint64 primitiveMode;
+		uint32 context;
+		std::array<uint64, STATE_REGISTER_COUNT> registers;
+
+		//Decoded values used by the rasterizer
+		bool gouraud;
+		bool textured;
+		bool fogged;
+		bool blended;
+		bool fst;
+		TEX0 tex0;
+		CLAMP clamp;
+		TEX1 tex1;
+		SCISSOR scissor;
+		ALPHA alpha;
+		TEST test;
+		FRAME frame;
+		ZBUF zbuf;
+		TEXA texa;
+		FOGCOL fogCol;
+		uint32 framePsm;
+		uint32 depthPsm;
+		uint32 textureWidth;
+		uint32 textureHeight;
+		bool fba;
+		bool pabe;
+		bool colClamp;
+		std::array<uint32, 256> clut;
+	};
+
+	struct QUAD
+	{
+		uint32 count;
+		uint32 colors[SPAN_CHUNK_SIZE];
+		int32 texCoordsU[SPAN_CHUNK_SIZE];
+		int32 texCoordsV[SPAN_CHUNK_SIZE];
+		uint32 texels[SPAN_CHUNK_SIZE];
+		uint32 fogs[SPAN_CHUNK_SIZE];
+	};
+
+	struct MEMORY_RANGE
+	{
+		uint32 start = ~0U;
+		uint32 end = 0;
+
+		bool Overlaps(const MEMORY_RANGE&) const;
+		void Merge(const MEMORY_RANGE&);
+	};
+
+	typedef std::vector<uint32> TilePrimitiveList;
+
+	static CGSHandler* GSHandlerFactory();
+
+	void VertexKick(uint8, uint64);
+	void SetupVertex(const VERTEX&, const DRAW_STATE&, SETUP_VERTEX&) const;
+	bool IsDrawStateCurrent(const DRAW_STATE&, uint64) const;
+	uint32 PrepareDrawState(uint64);
+	void BuildDrawState(uint64, DRAW_STATE&) const;
+	MEMORY_RANGE GetDrawStateWriteRange(const DRAW_STATE&) const;
+	MEMORY_RANGE GetDrawStateReadRange(const DRAW_STATE&) const;
+	static MEMORY_RANGE GetBufferRange(uint32, uint32, uint32, uint32);
+
+	void Prim_Point();
+	void Prim_Line();
+	void Prim_Triangle();
+	void Prim_Sprite();
+	static void SetConstantPlanes(PRIMITIVE&, const SETUP_VERTEX&);
+	bool ClipPrimitiveBounds(PRIMITIVE&, const DRAW_STATE&, int32, int32, int32, int32) const;
+	void QueuePrimitive(const PRIMITIVE&);
+
+	void ClearBatch();
+	void FlushPrimitives();
+	void StopWorkerThreads();
+	void WorkerThreadProc(uint32);
+	void ProcessTiles();
+	void DrawTile(uint32);
+	void DrawLine(const PRIMITIVE&, int32, int32, int32, int32);
+	void DrawTriangle(const PRIMITIVE&, int32, int32, int32, int32);
+	void DrawSpan(const PRIMITIVE&, int32, int32, int32);
+
+	void InterpolateQuad(const DRAW_STATE&, const float*, const float*, QUAD&) const;
+	void SampleQuad(const DRAW_STATE&, QUAD&) const;
+	uint32 FetchTexel(const DRAW_STATE&, int32, int32) const;
+	static void CombineQuad(const DRAW_STATE&, QUAD&);
+	static void CombineQuadAlpha(const DRAW_STATE&, QUAD&, const uint32*);
+	static void FogQuad(const DRAW_STATE&, QUAD&);
+	static void BlendQuad(const DRAW_STATE&, const uint32*, const uint32*, uint32*);
+
+	static uint32 ReadColor(uint8*, uint32, uint32, uint32, uint32, uint32);
+	static void WriteColor(uint8*, uint32, uint32, uint32, uint32, uint32, uint32, uint32);
+	uint32 ReadFramePixel(const DRAW_STATE&, uint32, uint32) const;
+	void WriteFramePixel(const DRAW_STATE&, uint32, uint32, uint32, uint32) const;
+	uint32 ReadDepthPixel(const DRAW_STATE&, uint32, uint32) const;
+	void WriteDepthPixel(const DRAW_STATE&, uint32, uint32, uint32) const;
+
+	template <typename>
+	void TransferLocalToLocal(uint32);
+
+	uint32 m_primitiveType = PRIM_INVALID;
+	uint32 m_vtxCount = 0;
+	VERTEX m_vtxBuffer[3];
+
+	//Current batch
+	std::vector<PRIMITIVE> m_primitives;
+	std::vector<DRAW_STATE> m_drawStates;
+	std::vector<TilePrimitiveList> m_tiles;
+	std::vector<uint32> m_activeTiles;
+	MEMORY_RANGE m_batchWriteRange;
+	MEMORY_RANGE m_batchReadRange;
+	uint32 m_batchFrame = 0;
+	uint32 m_batchZbuf = 0;
+	uint32 m_drawStateIndex = 0;
+	bool m_drawStateDirty = true;
+
+	//Worker pool
+	uint32 m_workerCount = 0;
+	std::vector<std::thread> m_workerThreads;
+	std::mutex m_workerMutex;
+	std::condition_variable m_workerCondition;
+	std::condition_variable m_workerDoneCondition;
+	uint32 m_workerGeneration = 0;
+	uint32 m_busyWorkerCount = 0;
+	bool m_workerThreadsDone = false;
+	std::atomic<uint32> m_nextTileIndex = {0};
+};
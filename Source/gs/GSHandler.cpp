@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
+#include <algorithm>
 #include <functional>
+#include <memory>
 #include "../AppConfig.h"
 #include "../Log.h"
 #include "../states/MemoryStateFile.h"
@@ -57,14 +59,21 @@
 
 #define LOG_NAME ("gs")
 
-struct MASSIVEWRITE_INFO
+struct WRITEREGISTERS_COMMAND
 {
+	uint32 count = 0;
 #ifdef DEBUGGER_INCLUDED
 	CGsPacketMetadata metadata;
 #endif
-	CGSHandler::RegisterWriteList writes;
 };
 
+//Register writes follow the command header
+static const uint32 WRITEREGISTERS_COMMAND_HEADER_SIZE = (sizeof(WRITEREGISTERS_COMMAND) + 0xF) & ~0xF;
+//Image data comes after a header containing its length and is followed by padding to allow
+//transfer handlers to read beyond the actual length of the buffer (ie.: PSMCT24)
+static const uint32 FEEDIMAGEDATA_COMMAND_HEADER_SIZE = 0x10;
+static const uint32 FEEDIMAGEDATA_COMMAND_PADDING_SIZE = 0x10;
+
 CGSHandler::CGSHandler(bool gsThreaded)
     : m_threadDone(false)
     , m_drawCallCount(0)
@@ -73,6 +82,7 @@ CGSHandler::CGSHandler(bool gsThreaded)
     , m_frameDump(nullptr)
     , m_loggingEnabled(true)
     , m_gsThreaded(gsThreaded)
+    , m_commandRing(COMMAND_RING_SIZE)
 {
 	RegisterPreferences();
 
@@ -119,6 +129,17 @@ CGSHandler::~CGSHandler()
 		SendGSCall([this]() { m_threadDone = true; });
 		m_thread.join();
 	}
+	//Release calls that were never processed
+	while(auto header = m_commandRing.PeekPacket())
+	{
+		if(header->type == COMMAND_TYPE_CALL)
+		{
+			auto call = *reinterpret_cast<GSCALL* const*>(CCommandRing::GetPayload(header));
+			assert(!call->sync);
+			delete call;
+		}
+		m_commandRing.ReleasePacket();
+	}
 	delete[] m_pRAM;
 	delete[] m_pCLUT;
 }
@@ -239,9 +260,12 @@ CGSHandler::PRESENTATION_VIEWPORT CGSHandler::GetPresentationViewport() const
 	return viewport;
 }
 
-void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive)
+void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive, bool includeRam)
 {
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM, GetRam(), RAMSIZE));
+	if(includeRam)
+	{
+		archive.InsertFile(new CMemoryStateFile(STATE_RAM, GetRam(), RAMSIZE));
+	}
 	archive.InsertFile(new CMemoryStateFile(STATE_REGS, m_nReg, sizeof(uint64) * CGSHandler::REGISTER_MAX));
 	archive.InsertFile(new CMemoryStateFile(STATE_TRXCTX, &m_trxCtx, sizeof(TRXCONTEXT)));
 
@@ -265,9 +289,12 @@ void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive)
 	}
 }
 
-void CGSHandler::LoadState(Framework::CZipArchiveReader& archive)
+void CGSHandler::LoadState(Framework::CZipArchiveReader& archive, bool includeRam)
 {
-	archive.BeginReadFile(STATE_RAM)->Read(GetRam(), RAMSIZE);
+	if(includeRam)
+	{
+		archive.BeginReadFile(STATE_RAM)->Read(GetRam(), RAMSIZE);
+	}
 	archive.BeginReadFile(STATE_REGS)->Read(m_nReg, sizeof(uint64) * CGSHandler::REGISTER_MAX);
 	archive.BeginReadFile(STATE_TRXCTX)->Read(&m_trxCtx, sizeof(TRXCONTEXT));
 
@@ -526,33 +553,162 @@ void CGSHandler::SetSMODE2(uint64 value)
 
 void CGSHandler::WriteRegister(uint8 registerId, uint64 value)
 {
-	SendGSCall(std::bind(&CGSHandler::WriteRegisterImpl, this, registerId, value));
+	std::lock_guard<std::mutex> commandLock(m_commandMutex);
+	auto payload = m_commandRing.BeginPacket(COMMAND_TYPE_WRITE_REGISTER, sizeof(RegisterWrite));
+	new(payload) RegisterWrite(registerId, value);
+	m_commandRing.EndPacket();
 }
 
 void CGSHandler::FeedImageData(const void* data, uint32 length)
 {
-	m_transferCount++;
+	uint32 maxChunkSize = (m_commandRing.GetMaxPayloadSize() - FEEDIMAGEDATA_COMMAND_HEADER_SIZE - FEEDIMAGEDATA_COMMAND_PADDING_SIZE) & ~0xF;
+	auto imageData = reinterpret_cast<const uint8*>(data);
 
-	//Allocate 0x10 more bytes to allow transfer handlers
-	//to read beyond the actual length of the buffer (ie.: PSMCT24)
+	std::lock_guard<std::mutex> commandLock(m_commandMutex);
+	//Big transfers are split in several commands
+	do
+	{
+		uint32 chunkSize = std::min<uint32>(length, maxChunkSize);
+		m_transferCount++;
+
+		auto payload = reinterpret_cast<uint8*>(m_commandRing.BeginPacket(COMMAND_TYPE_FEED_IMAGE_DATA,
+		                                                                   FEEDIMAGEDATA_COMMAND_HEADER_SIZE + chunkSize + FEEDIMAGEDATA_COMMAND_PADDING_SIZE));
+		*reinterpret_cast<uint32*>(payload) = chunkSize;
+		memcpy(payload + FEEDIMAGEDATA_COMMAND_HEADER_SIZE, imageData, chunkSize);
+		memset(payload + FEEDIMAGEDATA_COMMAND_HEADER_SIZE + chunkSize, 0, FEEDIMAGEDATA_COMMAND_PADDING_SIZE);
+		m_commandRing.EndPacket();
 
-	std::vector<uint8> imageData(length + 0x10);
-	memcpy(imageData.data(), data, length);
-	SendGSCall(
-	    [this, imageData = std::move(imageData), length]() {
-		    FeedImageDataImpl(imageData.data(), length);
-	    });
+		imageData += chunkSize;
+		length -= chunkSize;
+	} while(length != 0);
 }
 
 void CGSHandler::ReadImageData(void* data, uint32 length)
 {
-	SendGSCall([this, data, length]() { ReadImageDataImpl(data, length); }, true);
+	//Destination (ie.: EE RAM) might be write protected and faults might only be handled on this thread,
+	//the GS thread reads into a buffer of its own that is copied once the transfer is done
+	m_imageReadBuffer.resize(length);
+	SendGSCall([this, length]() { ReadImageDataImpl(m_imageReadBuffer.data(), length); }, true, true);
+	memcpy(data, m_imageReadBuffer.data(), length);
+}
+
+void CGSHandler::WriteRegisterMassively(const RegisterWriteList& registerWrites, const CGsPacketMetadata* metadata)
+{
+	uint32 maxChunkCount = GetMaxRegisterWriteCount();
+	auto writeIterator = registerWrites.begin();
+	uint32 writeCount = static_cast<uint32>(registerWrites.size());
+
+	//Big lists are split in several commands
+	while(writeCount != 0)
+	{
+		uint32 chunkCount = std::min<uint32>(writeCount, maxChunkCount);
+		CRegisterWriteReservation reservation;
+		BeginRegisterWrites(reservation, chunkCount);
+		std::uninitialized_copy(writeIterator, writeIterator + chunkCount, reservation.GetWrites());
+		EndRegisterWrites(reservation, chunkCount, metadata);
+
+		writeIterator += chunkCount;
+		writeCount -= chunkCount;
+	}
+}
+
+uint32 CGSHandler::GetMaxRegisterWriteCount() const
+{
+	uint32 maxPayloadSize = std::min<uint32>(m_commandRing.GetMaxPayloadSize(), REGISTERWRITE_RESERVATION_MAX_SIZE);
+	return (maxPayloadSize - WRITEREGISTERS_COMMAND_HEADER_SIZE) / sizeof(RegisterWrite);
+}
+
+void CGSHandler::BeginRegisterWrites(CRegisterWriteReservation& reservation, uint32 maxCount)
+{
+	assert(!reservation.IsActive());
+	uint32 count = std::min<uint32>(maxCount, GetMaxRegisterWriteCount());
+	uint32 payloadSize = WRITEREGISTERS_COMMAND_HEADER_SIZE + (count * sizeof(RegisterWrite));
+
+	//Wait for the GS thread to make room before taking the lock, other threads can send commands meanwhile
+	m_commandRing.WaitForSpace(payloadSize);
+
+	reservation.m_commandLock = std::unique_lock<std::mutex>(m_commandMutex);
+	auto payload = reinterpret_cast<uint8*>(m_commandRing.BeginPacket(COMMAND_TYPE_WRITE_REGISTERS, payloadSize));
+	reservation.m_gs = this;
+	reservation.m_writes = reinterpret_cast<RegisterWrite*>(payload + WRITEREGISTERS_COMMAND_HEADER_SIZE);
+	reservation.m_count = count;
+}
+
+void CGSHandler::EndRegisterWrites(CRegisterWriteReservation& reservation, uint32 count, const CGsPacketMetadata* metadata)
+{
+	assert(reservation.m_gs == this);
+	assert(count <= reservation.m_count);
+
+	if(count == 0)
+	{
+		CancelRegisterWrites(reservation);
+		return;
+	}
+
+	auto writes = reservation.m_writes;
+	auto payload = reinterpret_cast<uint8*>(writes) - WRITEREGISTERS_COMMAND_HEADER_SIZE;
+	ProcessEventRegisterWrites(writes, count);
+
+	auto command = new(payload) WRITEREGISTERS_COMMAND();
+	command->count = count;
+#ifdef DEBUGGER_INCLUDED
+	if(metadata != nullptr)
+	{
+		memcpy(&command->metadata, metadata, sizeof(CGsPacketMetadata));
+	}
+#endif
+
+	m_transferCount++;
+	m_commandRing.EndPacket(WRITEREGISTERS_COMMAND_HEADER_SIZE + (count * sizeof(RegisterWrite)));
+
+	reservation.Clear();
+}
+
+void CGSHandler::CancelRegisterWrites(CRegisterWriteReservation& reservation)
+{
+	assert(reservation.m_gs == this);
+	m_commandRing.CancelPacket();
+	reservation.Clear();
+}
+
+CGSHandler::CRegisterWriteReservation::~CRegisterWriteReservation()
+{
+	if(IsActive())
+	{
+		m_gs->CancelRegisterWrites(*this);
+	}
+}
+
+bool CGSHandler::CRegisterWriteReservation::IsActive() const
+{
+	return (m_gs != nullptr);
 }
 
-void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const CGsPacketMetadata* metadata)
+CGSHandler::RegisterWrite* CGSHandler::CRegisterWriteReservation::GetWrites() const
 {
-	for(const auto& write : registerWrites)
+	return m_writes;
+}
+
+uint32 CGSHandler::CRegisterWriteReservation::GetCount() const
+{
+	return m_count;
+}
+
+void CGSHandler::CRegisterWriteReservation::Clear()
+{
+	m_gs = nullptr;
+	m_writes = nullptr;
+	m_count = 0;
+	//Releases the command lock
+	m_commandLock = std::unique_lock<std::mutex>();
+}
+
+void CGSHandler::ProcessEventRegisterWrites(const RegisterWrite* writes, uint32 count)
+{
+	//Registers that raise events need to be visible to the EE right away
+	for(uint32 i = 0; i < count; i++)
 	{
+		const auto& write = writes[i];
 		switch(write.first)
 		{
 		case GS_REG_SIGNAL:
@@ -582,26 +738,6 @@ void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const
 		break;
 		}
 	}
-
-	m_transferCount++;
-
-	MASSIVEWRITE_INFO massiveWrite;
-	massiveWrite.writes = std::move(registerWrites);
-#ifdef DEBUGGER_INCLUDED
-	if(metadata != nullptr)
-	{
-		memcpy(&massiveWrite.metadata, metadata, sizeof(CGsPacketMetadata));
-	}
-	else
-	{
-		massiveWrite.metadata = CGsPacketMetadata();
-	}
-#endif
-
-	SendGSCall(
-	    [this, massiveWrite = std::move(massiveWrite)]() {
-		    WriteRegisterMassivelyImpl(massiveWrite);
-	    });
 }
 
 void CGSHandler::WriteRegisterImpl(uint8 nRegister, uint64 nData)
@@ -649,12 +785,10 @@ void CGSHandler::WriteRegisterImpl(uint8 nRegister, uint64 nData)
 
 void CGSHandler::FeedImageDataImpl(const uint8* imageData, uint32 length)
 {
-#ifdef DEBUGGER_INCLUDED
 	if(m_frameDump)
 	{
 		m_frameDump->AddImagePacket(imageData, length);
 	}
-#endif
 
 	if(m_trxCtx.nSize == 0)
 	{
@@ -702,17 +836,16 @@ void CGSHandler::ReadImageDataImpl(void* ptr, uint32 size)
 	((this)->*(m_transferReadHandlers[bltBuf.nSrcPsm]))(ptr, size);
 }
 
-void CGSHandler::WriteRegisterMassivelyImpl(const MASSIVEWRITE_INFO& massiveWrite)
+void CGSHandler::WriteRegisterMassivelyImpl(const RegisterWrite* writes, uint32 count, const CGsPacketMetadata* metadata)
 {
-#ifdef DEBUGGER_INCLUDED
 	if(m_frameDump)
 	{
-		m_frameDump->AddRegisterPacket(massiveWrite.writes.data(), massiveWrite.writes.size(), &massiveWrite.metadata);
+		m_frameDump->AddRegisterPacket(writes, count, metadata);
 	}
-#endif
 
-	for(const auto& write : massiveWrite.writes)
+	for(uint32 i = 0; i < count; i++)
 	{
+		const auto& write = writes[i];
 		WriteRegisterImpl(write.first, write.second);
 	}
 
@@ -824,6 +957,47 @@ void CGSHandler::TransferWrite(const uint8* imageData, uint32 length)
 	m_trxCtx.nDirty |= ((this)->*(m_transferWriteHandlers[bltBuf.nDstPsm]))(imageData, length);
 }
 
+//Splits a run of transferred pixels in rectangles: the end of the current row, as many whole rows
+//as possible and then the start of the next row. The rectangle function receives the position of the
+//rectangle inside the transfer area, its size, where its pixels start in the run and the run's pitch.
+template <typename RectFunction>
+void CGSHandler::ProcessTransferRects(uint32 pixelCount, const RectFunction& rectFunction)
+{
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+	uint32 rowWidth = trxReg.nRRW;
+	if(m_trxCtx.nRRX >= rowWidth) return;
+
+	uint32 pixelOffset = 0;
+
+	if(m_trxCtx.nRRX != 0)
+	{
+		uint32 width = std::min<uint32>(rowWidth - m_trxCtx.nRRX, pixelCount);
+		rectFunction(m_trxCtx.nRRX, m_trxCtx.nRRY, width, 1, pixelOffset, rowWidth);
+		pixelOffset += width;
+		m_trxCtx.nRRX += width;
+		if(m_trxCtx.nRRX == rowWidth)
+		{
+			m_trxCtx.nRRX = 0;
+			m_trxCtx.nRRY++;
+		}
+	}
+
+	uint32 rowCount = (pixelCount - pixelOffset) / rowWidth;
+	if(rowCount != 0)
+	{
+		rectFunction(0, m_trxCtx.nRRY, rowWidth, rowCount, pixelOffset, rowWidth);
+		pixelOffset += rowCount * rowWidth;
+		m_trxCtx.nRRY += rowCount;
+	}
+
+	uint32 remaining = pixelCount - pixelOffset;
+	if(remaining != 0)
+	{
+		rectFunction(0, m_trxCtx.nRRY, remaining, 1, pixelOffset, rowWidth);
+		m_trxCtx.nRRX = remaining;
+	}
+}
+
 bool CGSHandler::TransferWriteHandlerInvalid(const void* pData, uint32 nLength)
 {
 	assert(0);
@@ -835,7 +1009,6 @@ bool CGSHandler::TransferWriteHandlerGeneric(const void* pData, uint32 nLength)
 {
 	bool nDirty = false;
 	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
-	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
 	auto trxBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
 
 	nLength /= sizeof(typename Storage::Unit);
@@ -844,26 +1017,10 @@ bool CGSHandler::TransferWriteHandlerGeneric(const void* pData, uint32 nLength)
 
 	auto pSrc = reinterpret_cast<const typename Storage::Unit*>(pData);
 
-	for(unsigned int i = 0; i < nLength; i++)
-	{
-		uint32 nX = (m_trxCtx.nRRX + trxPos.nDSAX) % 2048;
-		uint32 nY = (m_trxCtx.nRRY + trxPos.nDSAY) % 2048;
-
-		auto pPixel = Indexor.GetPixelAddress(nX, nY);
-
-		if((*pPixel) != pSrc[i])
-		{
-			(*pPixel) = pSrc[i];
-			nDirty = true;
-		}
-
-		m_trxCtx.nRRX++;
-		if(m_trxCtx.nRRX == trxReg.nRRW)
-		{
-			m_trxCtx.nRRX = 0;
-			m_trxCtx.nRRY++;
-		}
-	}
+	ProcessTransferRects(nLength,
+	                     [&](uint32 nX, uint32 nY, uint32 nWidth, uint32 nHeight, uint32 nOffset, uint32 nPitch) {
+		                     nDirty |= Indexor.WriteRect(nX + trxPos.nDSAX, nY + trxPos.nDSAY, nWidth, nHeight, pSrc + nOffset, nPitch);
+	                     });
 
 	return nDirty;
 }
@@ -903,39 +1060,29 @@ bool CGSHandler::TransferWriteHandlerPSMT4(const void* pData, uint32 nLength)
 {
 	bool dirty = false;
 	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
-	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
 	auto trxBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
 
 	CGsPixelFormats::CPixelIndexorPSMT4 Indexor(m_pRAM, trxBuf.GetDstPtr(), trxBuf.nDstWidth);
 
 	auto pSrc = reinterpret_cast<const uint8*>(pData);
 
-	for(unsigned int i = 0; i < nLength; i++)
-	{
-		uint8 nPixel[2];
+	//Pixels are unpacked to one byte each before being written, a chunk at a time
+	static const uint32 chunkSize = 0x800;
+	uint8 pixels[chunkSize * 2];
 
-		nPixel[0] = (pSrc[i] >> 0) & 0x0F;
-		nPixel[1] = (pSrc[i] >> 4) & 0x0F;
-
-		for(unsigned int j = 0; j < 2; j++)
+	for(unsigned int i = 0; i < nLength; i += chunkSize)
+	{
+		uint32 byteCount = std::min<uint32>(chunkSize, nLength - i);
+		for(unsigned int j = 0; j < byteCount; j++)
 		{
-			uint32 nX = (m_trxCtx.nRRX + trxPos.nDSAX) % 2048;
-			uint32 nY = (m_trxCtx.nRRY + trxPos.nDSAY) % 2048;
-
-			uint8 currentPixel = Indexor.GetPixel(nX, nY);
-			if(currentPixel != nPixel[j])
-			{
-				Indexor.SetPixel(nX, nY, nPixel[j]);
-				dirty = true;
-			}
-
-			m_trxCtx.nRRX++;
-			if(m_trxCtx.nRRX == trxReg.nRRW)
-			{
-				m_trxCtx.nRRX = 0;
-				m_trxCtx.nRRY++;
-			}
+			pixels[(j * 2) + 0] = (pSrc[i + j] >> 0) & 0x0F;
+			pixels[(j * 2) + 1] = (pSrc[i + j] >> 4) & 0x0F;
 		}
+
+		ProcessTransferRects(byteCount * 2,
+		                     [&](uint32 x, uint32 y, uint32 width, uint32 height, uint32 offset, uint32 pitch) {
+			                     dirty |= Indexor.WriteRect(x + trxPos.nDSAX, y + trxPos.nDSAY, width, height, pixels + offset, pitch);
+		                     });
 	}
 
 	return dirty;
@@ -1033,26 +1180,16 @@ template <typename Storage>
 void CGSHandler::TransferReadHandlerGeneric(void* buffer, uint32 length)
 {
 	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
-	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
 	auto trxBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
 
 	uint32 typedLength = length / sizeof(typename Storage::Unit);
 	auto typedBuffer = reinterpret_cast<typename Storage::Unit*>(buffer);
 
 	CGsPixelFormats::CPixelIndexor<Storage> indexor(GetRam(), trxBuf.GetSrcPtr(), trxBuf.nSrcWidth);
-	for(uint32 i = 0; i < typedLength; i++)
-	{
-		uint32 x = (m_trxCtx.nRRX + trxPos.nSSAX) % 2048;
-		uint32 y = (m_trxCtx.nRRY + trxPos.nSSAY) % 2048;
-		auto pixel = indexor.GetPixel(x, y);
-		typedBuffer[i] = pixel;
-		m_trxCtx.nRRX++;
-		if(m_trxCtx.nRRX == trxReg.nRRW)
-		{
-			m_trxCtx.nRRX = 0;
-			m_trxCtx.nRRY++;
-		}
-	}
+	ProcessTransferRects(typedLength,
+	                     [&](uint32 x, uint32 y, uint32 width, uint32 height, uint32 offset, uint32 pitch) {
+		                     indexor.ReadRect(x + trxPos.nSSAX, y + trxPos.nSSAY, width, height, typedBuffer + offset, pitch);
+	                     });
 }
 
 void CGSHandler::TransferReadHandlerPSMCT24(void* buffer, uint32 length)
@@ -1248,19 +1385,19 @@ bool CGSHandler::ReadCLUT4_16(const TEX0& tex0)
 	uint32 clutOffset = tex0.nCSA * 16;
 	uint16* pDst = m_pCLUT + clutOffset;
 
-	for(unsigned int j = 0; j < 2; j++)
-	{
-		for(unsigned int i = 0; i < 8; i++)
-		{
-			uint16 color = indexor.GetPixel(i, j);
+	uint16 colors[16];
+	indexor.ReadRect(0, 0, 8, 2, colors, 8);
 
-			if(*pDst != color)
-			{
-				changed = true;
-			}
+	for(unsigned int i = 0; i < 16; i++)
+	{
+		uint16 color = colors[i];
 
-			(*pDst++) = color;
+		if(*pDst != color)
+		{
+			changed = true;
 		}
+
+		(*pDst++) = color;
 	}
 
 	return changed;
@@ -1273,11 +1410,14 @@ bool CGSHandler::ReadCLUT8_16(const TEX0& tex0)
 
 	Indexor indexor(m_pRAM, tex0.GetCLUTPtr(), 1);
 
+	uint16 colors[0x100];
+	indexor.ReadRect(0, 0, 16, 16, colors, 16);
+
 	for(unsigned int j = 0; j < 16; j++)
 	{
 		for(unsigned int i = 0; i < 16; i++)
 		{
-			uint16 color = indexor.GetPixel(i, j);
+			uint16 color = colors[i + (j * 16)];
 
 			uint8 index = i + (j * 16);
 			index = (index & ~0x18) | ((index & 0x08) << 1) | ((index & 0x10) >> 1);
@@ -1309,25 +1449,25 @@ void CGSHandler::ReadCLUT4(const TEX0& tex0)
 			uint32 clutOffset = (tex0.nCSA & 0x0F) * 16;
 			uint16* pDst = m_pCLUT + clutOffset;
 
-			for(unsigned int j = 0; j < 2; j++)
-			{
-				for(unsigned int i = 0; i < 8; i++)
-				{
-					uint32 color = Indexor.GetPixel(i, j);
-					uint16 colorLo = static_cast<uint16>(color & 0xFFFF);
-					uint16 colorHi = static_cast<uint16>(color >> 16);
+			uint32 colors[16];
+			Indexor.ReadRect(0, 0, 8, 2, colors, 8);
 
-					if(
-					    (pDst[0x000] != colorLo) ||
-					    (pDst[0x100] != colorHi))
-					{
-						changed = true;
-					}
+			for(unsigned int i = 0; i < 16; i++)
+			{
+				uint32 color = colors[i];
+				uint16 colorLo = static_cast<uint16>(color & 0xFFFF);
+				uint16 colorHi = static_cast<uint16>(color >> 16);
 
-					pDst[0x000] = colorLo;
-					pDst[0x100] = colorHi;
-					pDst++;
+				if(
+				    (pDst[0x000] != colorLo) ||
+				    (pDst[0x100] != colorHi))
+				{
+					changed = true;
 				}
+
+				pDst[0x000] = colorLo;
+				pDst[0x100] = colorHi;
+				pDst++;
 			}
 		}
 		else if(tex0.nCPSM == PSMCT16)
@@ -1356,9 +1496,12 @@ void CGSHandler::ReadCLUT4(const TEX0& tex0)
 		unsigned int nOffsetY = texClut.GetOffsetV();
 		uint16* pDst = m_pCLUT;
 
+		uint16 colors[0x10];
+		Indexor.ReadRect(nOffsetX, nOffsetY, 0x10, 1, colors, 0x10);
+
 		for(unsigned int i = 0; i < 0x10; i++)
 		{
-			uint16 color = Indexor.GetPixel(nOffsetX + i, nOffsetY);
+			uint16 color = colors[i];
 
 			if(*pDst != color)
 			{
@@ -1387,11 +1530,14 @@ void CGSHandler::ReadCLUT8(const TEX0& tex0)
 		{
 			CGsPixelFormats::CPixelIndexorPSMCT32 Indexor(m_pRAM, tex0.GetCLUTPtr(), 1);
 
+			uint32 colors[0x100];
+			Indexor.ReadRect(0, 0, 16, 16, colors, 16);
+
 			for(unsigned int j = 0; j < 16; j++)
 			{
 				for(unsigned int i = 0; i < 16; i++)
 				{
-					uint32 color = Indexor.GetPixel(i, j);
+					uint32 color = colors[i + (j * 16)];
 					uint16 colorLo = static_cast<uint16>(color & 0xFFFF);
 					uint16 colorHi = static_cast<uint16>(color >> 16);
 
@@ -1435,9 +1581,12 @@ void CGSHandler::ReadCLUT8(const TEX0& tex0)
 		unsigned int offsetY = texClut.GetOffsetV();
 		uint16* dst = m_pCLUT;
 
+		uint16 colors[0x100];
+		indexor.ReadRect(offsetX, offsetY, 0x100, 1, colors, 0x100);
+
 		for(unsigned int i = 0; i < 0x100; i++)
 		{
-			uint16 color = indexor.GetPixel(offsetX + i, offsetY);
+			uint16 color = colors[i];
 
 			if(*dst != color)
 			{
@@ -1882,14 +2031,65 @@ void CGSHandler::ThreadProc()
 {
 	while(!m_threadDone)
 	{
-		m_mailBox.WaitForCall();
-		while(m_mailBox.IsPending())
+		m_commandRing.WaitForPackets();
+		while(auto header = m_commandRing.PeekPacket())
 		{
-			m_mailBox.ReceiveCall();
+			ProcessCommand(header);
+			m_commandRing.ReleasePacket();
 		}
 	}
 }
 
+void CGSHandler::ProcessCommand(const CCommandRing::PACKET_HEADER* header)
+{
+	auto payload = reinterpret_cast<const uint8*>(CCommandRing::GetPayload(header));
+	switch(header->type)
+	{
+	case COMMAND_TYPE_CALL:
+	{
+		auto call = *reinterpret_cast<GSCALL* const*>(payload);
+		call->function();
+		if(call->sync)
+		{
+			std::lock_guard<std::mutex> callLock(m_callMutex);
+			call->done = true;
+			m_callFinished.notify_all();
+		}
+		else
+		{
+			delete call;
+		}
+	}
+	break;
+	case COMMAND_TYPE_WRITE_REGISTER:
+	{
+		auto write = reinterpret_cast<const RegisterWrite*>(payload);
+		WriteRegisterImpl(write->first, write->second);
+	}
+	break;
+	case COMMAND_TYPE_WRITE_REGISTERS:
+	{
+		auto command = reinterpret_cast<const WRITEREGISTERS_COMMAND*>(payload);
+		auto writes = reinterpret_cast<const RegisterWrite*>(payload + WRITEREGISTERS_COMMAND_HEADER_SIZE);
+#ifdef DEBUGGER_INCLUDED
+		WriteRegisterMassivelyImpl(writes, command->count, &command->metadata);
+#else
+		WriteRegisterMassivelyImpl(writes, command->count, nullptr);
+#endif
+	}
+	break;
+	case COMMAND_TYPE_FEED_IMAGE_DATA:
+	{
+		uint32 length = *reinterpret_cast<const uint32*>(payload);
+		FeedImageDataImpl(payload + FEEDIMAGEDATA_COMMAND_HEADER_SIZE, length);
+	}
+	break;
+	default:
+		assert(false);
+		break;
+	}
+}
+
 void CGSHandler::SendGSCall(const CMailBox::FunctionType& function, bool waitForCompletion, bool forceWaitForCompletion)
 {
 	if(!m_gsThreaded)
@@ -1897,12 +2097,37 @@ void CGSHandler::SendGSCall(const CMailBox::FunctionType& function, bool waitFor
 		waitForCompletion = false;
 	}
 	waitForCompletion |= forceWaitForCompletion;
-	m_mailBox.SendCall(function, waitForCompletion);
+	if(waitForCompletion)
+	{
+		GSCALL call;
+		call.function = function;
+		call.sync = true;
+		SendGSCallInternal(&call);
+
+		std::unique_lock<std::mutex> callLock(m_callMutex);
+		m_callFinished.wait(callLock, [&]() { return call.done; });
+	}
+	else
+	{
+		auto call = new GSCALL();
+		call->function = function;
+		SendGSCallInternal(call);
+	}
 }
 
 void CGSHandler::SendGSCall(CMailBox::FunctionType&& function)
 {
-	m_mailBox.SendCall(std::move(function));
+	auto call = new GSCALL();
+	call->function = std::move(function);
+	SendGSCallInternal(call);
+}
+
+void CGSHandler::SendGSCallInternal(GSCALL* call)
+{
+	std::lock_guard<std::mutex> commandLock(m_commandMutex);
+	auto payload = m_commandRing.BeginPacket(COMMAND_TYPE_CALL, sizeof(GSCALL*));
+	*reinterpret_cast<GSCALL**>(payload) = call;
+	m_commandRing.EndPacket();
 }
 
 void CGSHandler::ProcessSingleFrame()
@@ -1910,10 +2135,13 @@ void CGSHandler::ProcessSingleFrame()
 	assert(!m_gsThreaded);
 	while(!m_flipped)
 	{
-		m_mailBox.WaitForCall();
-		while(m_mailBox.IsPending() && !m_flipped)
+		m_commandRing.WaitForPackets();
+		while(!m_flipped)
 		{
-			m_mailBox.ReceiveCall();
+			auto header = m_commandRing.PeekPacket();
+			if(!header) break;
+			ProcessCommand(header);
+			m_commandRing.ReleasePacket();
 		}
 	}
 	m_flipped = false;
@@ -1923,3 +2151,8 @@ Framework::CBitmap CGSHandler::GetScreenshot()
 {
 	throw std::runtime_error("Screenshot feature is not implemented in current backend.");
 }
+
+CGSHandler::TEXTURECACHE_STATS CGSHandler::GetTextureCacheStats() const
+{
+	return TEXTURECACHE_STATS();
+}
@@ -5,12 +5,14 @@
 #include <functional>
 #include <atomic>
 #include <array>
+#include <mutex>
 #include "signal/Signal.h"
 
 #include "bitmap/Bitmap.h"
 #include "Types.h"
 #include "Convertible.h"
 #include "../MailBox.h"
+#include "../CommandRing.h"
 #include "../Integer64.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
@@ -18,7 +20,6 @@
 class CFrameDump;
 class CGsPacketMetadata;
 class CINTC;
-struct MASSIVEWRITE_INFO;
 
 #define PREF_CGSHANDLER_PRESENTATION_MODE "renderer.presentationmode"
 
@@ -760,6 +761,38 @@ public:
 	typedef Framework::CSignal<void()> FlipCompleteEvent;
 	typedef Framework::CSignal<void(uint32)> NewFrameEvent;
 
+	//Room for register writes produced in place in the command ring, see BeginRegisterWrites.
+	//Holds the command lock while active, writes are dropped if it goes away without being ended.
+	class CRegisterWriteReservation
+	{
+	public:
+		CRegisterWriteReservation() = default;
+		~CRegisterWriteReservation();
+
+		CRegisterWriteReservation(const CRegisterWriteReservation&) = delete;
+		CRegisterWriteReservation& operator=(const CRegisterWriteReservation&) = delete;
+
+		bool IsActive() const;
+		RegisterWrite* GetWrites() const;
+		uint32 GetCount() const;
+
+	private:
+		friend class CGSHandler;
+
+		void Clear();
+
+		CGSHandler* m_gs = nullptr;
+		std::unique_lock<std::mutex> m_commandLock;
+		RegisterWrite* m_writes = nullptr;
+		uint32 m_count = 0;
+	};
+
+	struct TEXTURECACHE_STATS
+	{
+		uint64 hitCount = 0;
+		uint64 missCount = 0;
+	};
+
 	CGSHandler(bool = true);
 	virtual ~CGSHandler();
 
@@ -770,8 +803,9 @@ public:
 	void Reset();
 	virtual void SetPresentationParams(const PRESENTATION_PARAMS&);
 
-	virtual void SaveState(Framework::CZipArchiveWriter&);
-	virtual void LoadState(Framework::CZipArchiveReader&);
+	//RAM can be left out for it to be saved and restored separately (ie.: rewind snapshots)
+	virtual void SaveState(Framework::CZipArchiveWriter&, bool = true);
+	virtual void LoadState(Framework::CZipArchiveReader&, bool = true);
 	void Copy(const CGSHandler*);
 
 	void SetFrameDump(CFrameDump*);
@@ -791,7 +825,14 @@ public:
 	void WriteRegister(uint8, uint64);
 	void FeedImageData(const void*, uint32);
 	void ReadImageData(void*, uint32);
-	void WriteRegisterMassively(RegisterWriteList, const CGsPacketMetadata*);
+	void WriteRegisterMassively(const RegisterWriteList&, const CGsPacketMetadata*);
+
+	//Register writes can be produced in place in the command ring. Begin reserves room for at most the given
+	//number of writes, capped to GetMaxRegisterWriteCount, End sends the ones that were actually written.
+	//No other command can be sent while a reservation is active.
+	uint32 GetMaxRegisterWriteCount() const;
+	void BeginRegisterWrites(CRegisterWriteReservation&, uint32);
+	void EndRegisterWrites(CRegisterWriteReservation&, uint32, const CGsPacketMetadata*);
 
 	virtual void SetCrt(bool, unsigned int, bool);
 	void Initialize();
@@ -826,6 +867,9 @@ public:
 	virtual Framework::CBitmap GetScreenshot();
 	void ProcessSingleFrame();
 
+	//Cumulative texture cache lookups, handlers without a texture cache report none
+	virtual TEXTURECACHE_STATS GetTextureCacheStats() const;
+
 	FlipCompleteEvent OnFlipComplete;
 	NewFrameEvent OnNewFrame;
 
@@ -938,7 +982,7 @@ protected:
 	virtual void WriteRegisterImpl(uint8, uint64);
 	void FeedImageDataImpl(const uint8*, uint32);
 	void ReadImageDataImpl(void*, uint32);
-	void WriteRegisterMassivelyImpl(const MASSIVEWRITE_INFO&);
+	void WriteRegisterMassivelyImpl(const RegisterWrite*, uint32, const CGsPacketMetadata*);
 
 	void BeginTransfer();
 
@@ -962,6 +1006,9 @@ protected:
 	void TransferReadHandlerGeneric(void*, uint32);
 	void TransferReadHandlerPSMCT24(void*, uint32);
 
+	template <typename RectFunction>
+	void ProcessTransferRects(uint32, const RectFunction&);
+
 	virtual void SyncCLUT(const TEX0&);
 	bool ProcessCLD(const TEX0&);
 	template <typename Indexor>
@@ -993,6 +1040,8 @@ protected:
 	PRESENTATION_PARAMS m_presentationParams;
 
 	TRXCONTEXT m_trxCtx;
+	//Local to host transfers are read in here on the GS thread
+	std::vector<uint8> m_imageReadBuffer;
 
 	uint64 m_nReg[REGISTER_MAX];
 
@@ -1016,5 +1065,37 @@ protected:
 	bool m_flipped = false;
 
 private:
-	CMailBox m_mailBox;
+	enum
+	{
+		COMMAND_RING_SIZE = 0x800000,
+		//Keeps reservations small enough for the GS thread to make room for them quickly
+		REGISTERWRITE_RESERVATION_MAX_SIZE = 0x40000,
+	};
+
+	enum COMMAND_TYPE
+	{
+		COMMAND_TYPE_CALL,
+		COMMAND_TYPE_WRITE_REGISTER,
+		COMMAND_TYPE_WRITE_REGISTERS,
+		COMMAND_TYPE_FEED_IMAGE_DATA,
+	};
+
+	struct GSCALL
+	{
+		CMailBox::FunctionType function;
+		bool sync = false;
+		bool done = false;
+	};
+
+	void SendGSCallInternal(GSCALL*);
+	void ProcessCommand(const CCommandRing::PACKET_HEADER*);
+	void ProcessEventRegisterWrites(const RegisterWrite*, uint32);
+	void CancelRegisterWrites(CRegisterWriteReservation&);
+
+	//Serializes producers, only the emulation thread sends commands in the hot paths
+	std::mutex m_commandMutex;
+	CCommandRing m_commandRing;
+
+	std::mutex m_callMutex;
+	std::condition_variable m_callFinished;
 };
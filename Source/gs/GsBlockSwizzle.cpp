@@ -0,0 +1,684 @@
+#include <cstring>
+#include <utility>
+#include "GsBlockSwizzle.h"
+#include "GsPixelFormats.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define GSSWIZZLE_USE_SSE2
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define GSSWIZZLE_USE_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace GsBlockSwizzle;
+
+//Offset of every pixel of a block, relative to the start of the block
+struct BLOCK_OFFSETS
+{
+	uint16 offsets32[8][8];
+	uint16 offsets16[8][16];
+	uint16 offsets8[16][16];
+	//PSMT4 offsets are in nibbles
+	uint16 offsets4[16][32];
+	//Position in the block (y * 32 + x) of the pixels held by the low and high nibbles of every byte
+	uint16 pixels4[CGsPixelFormats::BLOCKSIZE][2];
+};
+
+static BLOCK_OFFSETS BuildBlockOffsets()
+{
+	typedef CGsPixelFormats::STORAGEPSMCT32 Storage32;
+	typedef CGsPixelFormats::STORAGEPSMCT16 Storage16;
+	typedef CGsPixelFormats::STORAGEPSMT8 Storage8;
+	typedef CGsPixelFormats::STORAGEPSMT4 Storage4;
+
+	BLOCK_OFFSETS result;
+
+	for(uint32 y = 0; y < Storage32::BLOCKHEIGHT; y++)
+	{
+		for(uint32 x = 0; x < Storage32::BLOCKWIDTH; x++)
+		{
+			uint32 columnNum = y / Storage32::COLUMNHEIGHT;
+			result.offsets32[y][x] = (columnNum * CGsPixelFormats::COLUMNSIZE) + (Storage32::m_nColumnSwizzleTable[y % 2][x] * 4);
+		}
+	}
+
+	for(uint32 y = 0; y < Storage16::BLOCKHEIGHT; y++)
+	{
+		for(uint32 x = 0; x < Storage16::BLOCKWIDTH; x++)
+		{
+			uint32 columnNum = y / Storage16::COLUMNHEIGHT;
+			result.offsets16[y][x] = (columnNum * CGsPixelFormats::COLUMNSIZE) + (Storage16::m_nColumnSwizzleTable[y % 2][x] * 2);
+		}
+	}
+
+	for(uint32 y = 0; y < Storage8::BLOCKHEIGHT; y++)
+	{
+		for(uint32 x = 0; x < Storage8::BLOCKWIDTH; x++)
+		{
+			uint32 columnNum = y / Storage8::COLUMNHEIGHT;
+			uint32 columnY = y % Storage8::COLUMNHEIGHT;
+
+			uint32 table = ((columnY & 0x02) >> 1) ^ (columnNum & 1);
+			uint32 byte = ((x & 0x08) >> 2) + ((columnY & 0x02) >> 1);
+			uint32 word = Storage8::m_nColumnWordTable[table][columnY & 1][x & 7];
+			result.offsets8[y][x] = (columnNum * CGsPixelFormats::COLUMNSIZE) + (word * 4) + byte;
+		}
+	}
+
+	for(uint32 y = 0; y < Storage4::BLOCKHEIGHT; y++)
+	{
+		for(uint32 x = 0; x < Storage4::BLOCKWIDTH; x++)
+		{
+			uint32 columnNum = y / Storage4::COLUMNHEIGHT;
+			uint32 columnY = y % Storage4::COLUMNHEIGHT;
+
+			uint32 nibble = ((x & 0x18) + ((columnY & 0x02) << 1)) / 4;
+			uint32 table = ((columnY & 0x02) >> 1) ^ (columnNum & 1);
+			uint32 word = Storage4::m_nColumnWordTable[table][columnY & 1][x & 7];
+			uint32 offset = (((columnNum * CGsPixelFormats::COLUMNSIZE) + (word * 4)) * 2) + nibble;
+			result.offsets4[y][x] = offset;
+			result.pixels4[offset / 2][offset & 1] = (y * Storage4::BLOCKWIDTH) + x;
+		}
+	}
+
+	return result;
+}
+
+static const BLOCK_OFFSETS& GetBlockOffsets()
+{
+	static const BLOCK_OFFSETS offsets = BuildBlockOffsets();
+	return offsets;
+}
+
+template <typename UnitType, uint32 blockWidth, uint32 blockHeight>
+static void ReadBlock_Scalar(const uint8* block, void* dst, uint32 dstPitch, const uint16 (&offsets)[blockHeight][blockWidth])
+{
+	auto dstPixels = reinterpret_cast<UnitType*>(dst);
+	for(uint32 y = 0; y < blockHeight; y++)
+	{
+		for(uint32 x = 0; x < blockWidth; x++)
+		{
+			memcpy(dstPixels + x, block + offsets[y][x], sizeof(UnitType));
+		}
+		dstPixels += dstPitch;
+	}
+}
+
+template <typename UnitType, uint32 blockWidth, uint32 blockHeight>
+static bool WriteBlock_Scalar(uint8* block, const void* src, uint32 srcPitch, const uint16 (&offsets)[blockHeight][blockWidth])
+{
+	bool changed = false;
+	auto srcPixels = reinterpret_cast<const UnitType*>(src);
+	for(uint32 y = 0; y < blockHeight; y++)
+	{
+		for(uint32 x = 0; x < blockWidth; x++)
+		{
+			UnitType pixel = 0;
+			memcpy(&pixel, block + offsets[y][x], sizeof(UnitType));
+			if(pixel != srcPixels[x])
+			{
+				memcpy(block + offsets[y][x], srcPixels + x, sizeof(UnitType));
+				changed = true;
+			}
+		}
+		srcPixels += srcPitch;
+	}
+	return changed;
+}
+
+static void ReadBlock32_Scalar(const uint8* block, void* dst, uint32 dstPitch)
+{
+	ReadBlock_Scalar<uint32>(block, dst, dstPitch, GetBlockOffsets().offsets32);
+}
+
+static bool WriteBlock32_Scalar(uint8* block, const void* src, uint32 srcPitch)
+{
+	return WriteBlock_Scalar<uint32>(block, src, srcPitch, GetBlockOffsets().offsets32);
+}
+
+static void ReadBlock16_Scalar(const uint8* block, void* dst, uint32 dstPitch)
+{
+	ReadBlock_Scalar<uint16>(block, dst, dstPitch, GetBlockOffsets().offsets16);
+}
+
+static bool WriteBlock16_Scalar(uint8* block, const void* src, uint32 srcPitch)
+{
+	return WriteBlock_Scalar<uint16>(block, src, srcPitch, GetBlockOffsets().offsets16);
+}
+
+static void ReadBlock8_Scalar(const uint8* block, void* dst, uint32 dstPitch)
+{
+	ReadBlock_Scalar<uint8>(block, dst, dstPitch, GetBlockOffsets().offsets8);
+}
+
+static bool WriteBlock8_Scalar(uint8* block, const void* src, uint32 srcPitch)
+{
+	return WriteBlock_Scalar<uint8>(block, src, srcPitch, GetBlockOffsets().offsets8);
+}
+
+static void ReadBlock4_Scalar(const uint8* block, void* dst, uint32 dstPitch)
+{
+	const auto& pixels = GetBlockOffsets().pixels4;
+	auto dstPixels = reinterpret_cast<uint8*>(dst);
+	for(uint32 i = 0; i < CGsPixelFormats::BLOCKSIZE; i++)
+	{
+		uint32 pixelLo = pixels[i][0];
+		uint32 pixelHi = pixels[i][1];
+		dstPixels[((pixelLo / 32) * dstPitch) + (pixelLo % 32)] = block[i] & 0x0F;
+		dstPixels[((pixelHi / 32) * dstPitch) + (pixelHi % 32)] = block[i] >> 4;
+	}
+}
+
+static bool WriteBlock4_Scalar(uint8* block, const void* src, uint32 srcPitch)
+{
+	const auto& pixels = GetBlockOffsets().pixels4;
+	auto srcPixels = reinterpret_cast<const uint8*>(src);
+	uint8 changed = 0;
+	for(uint32 i = 0; i < CGsPixelFormats::BLOCKSIZE; i++)
+	{
+		uint32 pixelLo = pixels[i][0];
+		uint32 pixelHi = pixels[i][1];
+		uint8 byte = (srcPixels[((pixelLo / 32) * srcPitch) + (pixelLo % 32)] & 0x0F) |
+		             (srcPixels[((pixelHi / 32) * srcPitch) + (pixelHi % 32)] << 4);
+		changed |= block[i] ^ byte;
+		block[i] = byte;
+	}
+	return changed != 0;
+}
+
+#ifdef GSSWIZZLE_USE_SSE2
+
+//Blocks are made of 4 columns of 64 bytes. For 32-bit and 16-bit formats, a column holds 2 rows and its 32-bit words
+//are ordered in pairs alternating between the two rows. 16-bit formats store pixels x and x + 8 in the same word.
+//PSMT8 columns hold 4 rows, bytes 0 and 2 of each word belong to one row and bytes 1 and 3 to the other row of a pair.
+
+static inline bool StoreColumn_Sse2(uint8* column, __m128i v0, __m128i v1, __m128i v2, __m128i v3)
+{
+	auto columnVectors = reinterpret_cast<__m128i*>(column);
+	__m128i changed = _mm_xor_si128(_mm_loadu_si128(columnVectors + 0), v0);
+	changed = _mm_or_si128(changed, _mm_xor_si128(_mm_loadu_si128(columnVectors + 1), v1));
+	changed = _mm_or_si128(changed, _mm_xor_si128(_mm_loadu_si128(columnVectors + 2), v2));
+	changed = _mm_or_si128(changed, _mm_xor_si128(_mm_loadu_si128(columnVectors + 3), v3));
+	_mm_storeu_si128(columnVectors + 0, v0);
+	_mm_storeu_si128(columnVectors + 1, v1);
+	_mm_storeu_si128(columnVectors + 2, v2);
+	_mm_storeu_si128(columnVectors + 3, v3);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(changed, _mm_setzero_si128())) != 0xFFFF;
+}
+
+static void ReadBlock32_Sse2(const uint8* block, void* dst, uint32 dstPitch)
+{
+	auto dstPixels = reinterpret_cast<uint32*>(dst);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto column = reinterpret_cast<const __m128i*>(block + (columnNum * CGsPixelFormats::COLUMNSIZE));
+		__m128i v0 = _mm_loadu_si128(column + 0);
+		__m128i v1 = _mm_loadu_si128(column + 1);
+		__m128i v2 = _mm_loadu_si128(column + 2);
+		__m128i v3 = _mm_loadu_si128(column + 3);
+
+		auto row0 = dstPixels + (columnNum * 2 * dstPitch);
+		auto row1 = row0 + dstPitch;
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row0 + 0), _mm_unpacklo_epi64(v0, v1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row0 + 4), _mm_unpacklo_epi64(v2, v3));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row1 + 0), _mm_unpackhi_epi64(v0, v1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row1 + 4), _mm_unpackhi_epi64(v2, v3));
+	}
+}
+
+static bool WriteBlock32_Sse2(uint8* block, const void* src, uint32 srcPitch)
+{
+	bool changed = false;
+	auto srcPixels = reinterpret_cast<const uint32*>(src);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto row0 = srcPixels + (columnNum * 2 * srcPitch);
+		auto row1 = row0 + srcPitch;
+		__m128i row0a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 0));
+		__m128i row0b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 4));
+		__m128i row1a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 0));
+		__m128i row1b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 4));
+
+		changed |= StoreColumn_Sse2(block + (columnNum * CGsPixelFormats::COLUMNSIZE),
+		                            _mm_unpacklo_epi64(row0a, row1a), _mm_unpackhi_epi64(row0a, row1a),
+		                            _mm_unpacklo_epi64(row0b, row1b), _mm_unpackhi_epi64(row0b, row1b));
+	}
+	return changed;
+}
+
+//Splits words holding pixels (x, x + 8) into pixels 0-7 and 8-15
+static inline void Deinterleave16_Sse2(__m128i wordsA, __m128i wordsB, __m128i& pixelsLo, __m128i& pixelsHi)
+{
+	wordsA = _mm_shufflelo_epi16(wordsA, _MM_SHUFFLE(3, 1, 2, 0));
+	wordsA = _mm_shufflehi_epi16(wordsA, _MM_SHUFFLE(3, 1, 2, 0));
+	wordsA = _mm_shuffle_epi32(wordsA, _MM_SHUFFLE(3, 1, 2, 0));
+	wordsB = _mm_shufflelo_epi16(wordsB, _MM_SHUFFLE(3, 1, 2, 0));
+	wordsB = _mm_shufflehi_epi16(wordsB, _MM_SHUFFLE(3, 1, 2, 0));
+	wordsB = _mm_shuffle_epi32(wordsB, _MM_SHUFFLE(3, 1, 2, 0));
+	pixelsLo = _mm_unpacklo_epi64(wordsA, wordsB);
+	pixelsHi = _mm_unpackhi_epi64(wordsA, wordsB);
+}
+
+static void ReadBlock16_Sse2(const uint8* block, void* dst, uint32 dstPitch)
+{
+	auto dstPixels = reinterpret_cast<uint16*>(dst);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto column = reinterpret_cast<const __m128i*>(block + (columnNum * CGsPixelFormats::COLUMNSIZE));
+		__m128i v0 = _mm_loadu_si128(column + 0);
+		__m128i v1 = _mm_loadu_si128(column + 1);
+		__m128i v2 = _mm_loadu_si128(column + 2);
+		__m128i v3 = _mm_loadu_si128(column + 3);
+
+		__m128i pixelsLo, pixelsHi;
+		auto row0 = dstPixels + (columnNum * 2 * dstPitch);
+		auto row1 = row0 + dstPitch;
+
+		Deinterleave16_Sse2(_mm_unpacklo_epi64(v0, v1), _mm_unpacklo_epi64(v2, v3), pixelsLo, pixelsHi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row0 + 0), pixelsLo);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row0 + 8), pixelsHi);
+
+		Deinterleave16_Sse2(_mm_unpackhi_epi64(v0, v1), _mm_unpackhi_epi64(v2, v3), pixelsLo, pixelsHi);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row1 + 0), pixelsLo);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row1 + 8), pixelsHi);
+	}
+}
+
+static bool WriteBlock16_Sse2(uint8* block, const void* src, uint32 srcPitch)
+{
+	bool changed = false;
+	auto srcPixels = reinterpret_cast<const uint16*>(src);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto row0 = srcPixels + (columnNum * 2 * srcPitch);
+		auto row1 = row0 + srcPitch;
+		__m128i row0Lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 0));
+		__m128i row0Hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 8));
+		__m128i row1Lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 0));
+		__m128i row1Hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 8));
+
+		__m128i row0A = _mm_unpacklo_epi16(row0Lo, row0Hi);
+		__m128i row0B = _mm_unpackhi_epi16(row0Lo, row0Hi);
+		__m128i row1A = _mm_unpacklo_epi16(row1Lo, row1Hi);
+		__m128i row1B = _mm_unpackhi_epi16(row1Lo, row1Hi);
+
+		changed |= StoreColumn_Sse2(block + (columnNum * CGsPixelFormats::COLUMNSIZE),
+		                            _mm_unpacklo_epi64(row0A, row1A), _mm_unpackhi_epi64(row0A, row1A),
+		                            _mm_unpacklo_epi64(row0B, row1B), _mm_unpackhi_epi64(row0B, row1B));
+	}
+	return changed;
+}
+
+//Bytes come in as (x, x + 8) pairs, reorders them as pixels 0-15
+static inline __m128i DeinterleaveBytes_Sse2(__m128i pairs)
+{
+	const __m128i byteMask = _mm_set1_epi16(0xFF);
+	return _mm_packus_epi16(_mm_and_si128(pairs, byteMask), _mm_srli_epi16(pairs, 8));
+}
+
+static inline __m128i InterleaveBytes_Sse2(__m128i pixels)
+{
+	return _mm_unpacklo_epi8(pixels, _mm_srli_si128(pixels, 8));
+}
+
+//Converts a PSMT8 column between its swizzled layout and 4 rows of 16 pixels
+static inline void ReadColumn8_Sse2(__m128i v0, __m128i v1, __m128i v2, __m128i v3, bool oddColumn, __m128i* rows)
+{
+	const __m128i byteMask = _mm_set1_epi16(0xFF);
+
+	//Words for rows 0 and 2 and words for rows 1 and 3
+	__m128i rows02A = _mm_unpacklo_epi64(v0, v1);
+	__m128i rows02B = _mm_unpacklo_epi64(v2, v3);
+	__m128i rows13A = _mm_unpackhi_epi64(v0, v1);
+	__m128i rows13B = _mm_unpackhi_epi64(v2, v3);
+	if(oddColumn)
+	{
+		std::swap(rows02A, rows02B);
+		std::swap(rows13A, rows13B);
+	}
+
+	rows[0] = DeinterleaveBytes_Sse2(_mm_packus_epi16(_mm_and_si128(rows02A, byteMask), _mm_and_si128(rows02B, byteMask)));
+	rows[1] = DeinterleaveBytes_Sse2(_mm_packus_epi16(_mm_and_si128(rows13A, byteMask), _mm_and_si128(rows13B, byteMask)));
+	rows[2] = DeinterleaveBytes_Sse2(_mm_packus_epi16(_mm_srli_epi16(rows02B, 8), _mm_srli_epi16(rows02A, 8)));
+	rows[3] = DeinterleaveBytes_Sse2(_mm_packus_epi16(_mm_srli_epi16(rows13B, 8), _mm_srli_epi16(rows13A, 8)));
+}
+
+static inline void WriteColumn8_Sse2(const __m128i* rows, bool oddColumn, __m128i* v)
+{
+	__m128i row0 = InterleaveBytes_Sse2(rows[0]);
+	__m128i row1 = InterleaveBytes_Sse2(rows[1]);
+	__m128i row2 = InterleaveBytes_Sse2(rows[2]);
+	__m128i row3 = InterleaveBytes_Sse2(rows[3]);
+
+	__m128i rows02A = _mm_unpacklo_epi8(row0, _mm_srli_si128(row2, 8));
+	__m128i rows02B = _mm_unpacklo_epi8(_mm_srli_si128(row0, 8), row2);
+	__m128i rows13A = _mm_unpacklo_epi8(row1, _mm_srli_si128(row3, 8));
+	__m128i rows13B = _mm_unpacklo_epi8(_mm_srli_si128(row1, 8), row3);
+	if(oddColumn)
+	{
+		std::swap(rows02A, rows02B);
+		std::swap(rows13A, rows13B);
+	}
+
+	v[0] = _mm_unpacklo_epi64(rows02A, rows13A);
+	v[1] = _mm_unpackhi_epi64(rows02A, rows13A);
+	v[2] = _mm_unpacklo_epi64(rows02B, rows13B);
+	v[3] = _mm_unpackhi_epi64(rows02B, rows13B);
+}
+
+static void ReadBlock8_Sse2(const uint8* block, void* dst, uint32 dstPitch)
+{
+	auto dstPixels = reinterpret_cast<uint8*>(dst);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto column = reinterpret_cast<const __m128i*>(block + (columnNum * CGsPixelFormats::COLUMNSIZE));
+
+		__m128i rows[4];
+		ReadColumn8_Sse2(_mm_loadu_si128(column + 0), _mm_loadu_si128(column + 1), _mm_loadu_si128(column + 2), _mm_loadu_si128(column + 3),
+		                 (columnNum & 1) != 0, rows);
+
+		auto columnDst = dstPixels + (columnNum * 4 * dstPitch);
+		for(uint32 i = 0; i < 4; i++)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(columnDst + (i * dstPitch)), rows[i]);
+		}
+	}
+}
+
+static bool WriteBlock8_Sse2(uint8* block, const void* src, uint32 srcPitch)
+{
+	bool changed = false;
+	auto srcPixels = reinterpret_cast<const uint8*>(src);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto columnSrc = srcPixels + (columnNum * 4 * srcPitch);
+
+		__m128i rows[4];
+		for(uint32 i = 0; i < 4; i++)
+		{
+			rows[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(columnSrc + (i * srcPitch)));
+		}
+
+		__m128i v[4];
+		WriteColumn8_Sse2(rows, (columnNum & 1) != 0, v);
+		changed |= StoreColumn_Sse2(block + (columnNum * CGsPixelFormats::COLUMNSIZE), v[0], v[1], v[2], v[3]);
+	}
+	return changed;
+}
+
+//PSMT4 columns hold 4 rows of 32 pixels. Once every nibble of a column is expanded to a byte, the first half of
+//each 32-bit word holds pixels 0-15 and the second half pixels 16-31, both laid out like a PSMT8 column.
+static void ReadBlock4_Sse2(const uint8* block, void* dst, uint32 dstPitch)
+{
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	auto dstPixels = reinterpret_cast<uint8*>(dst);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto column = reinterpret_cast<const __m128i*>(block + (columnNum * CGsPixelFormats::COLUMNSIZE));
+
+		__m128i halvesLo[4];
+		__m128i halvesHi[4];
+		for(uint32 i = 0; i < 4; i++)
+		{
+			__m128i words = _mm_loadu_si128(column + i);
+			__m128i nibblesLo = _mm_and_si128(words, nibbleMask);
+			__m128i nibblesHi = _mm_and_si128(_mm_srli_epi16(words, 4), nibbleMask);
+			__m128i expandedA = _mm_shuffle_epi32(_mm_unpacklo_epi8(nibblesLo, nibblesHi), _MM_SHUFFLE(3, 1, 2, 0));
+			__m128i expandedB = _mm_shuffle_epi32(_mm_unpackhi_epi8(nibblesLo, nibblesHi), _MM_SHUFFLE(3, 1, 2, 0));
+			halvesLo[i] = _mm_unpacklo_epi64(expandedA, expandedB);
+			halvesHi[i] = _mm_unpackhi_epi64(expandedA, expandedB);
+		}
+
+		__m128i rowsLo[4];
+		__m128i rowsHi[4];
+		ReadColumn8_Sse2(halvesLo[0], halvesLo[1], halvesLo[2], halvesLo[3], (columnNum & 1) != 0, rowsLo);
+		ReadColumn8_Sse2(halvesHi[0], halvesHi[1], halvesHi[2], halvesHi[3], (columnNum & 1) != 0, rowsHi);
+
+		auto columnDst = dstPixels + (columnNum * 4 * dstPitch);
+		for(uint32 i = 0; i < 4; i++)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(columnDst + (i * dstPitch) + 0x00), rowsLo[i]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(columnDst + (i * dstPitch) + 0x10), rowsHi[i]);
+		}
+	}
+}
+
+static bool WriteBlock4_Sse2(uint8* block, const void* src, uint32 srcPitch)
+{
+	const __m128i nibbleMask = _mm_set1_epi8(0x0F);
+	const __m128i byteMask = _mm_set1_epi16(0xFF);
+	bool changed = false;
+	auto srcPixels = reinterpret_cast<const uint8*>(src);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto columnSrc = srcPixels + (columnNum * 4 * srcPitch);
+
+		__m128i rowsLo[4];
+		__m128i rowsHi[4];
+		for(uint32 i = 0; i < 4; i++)
+		{
+			rowsLo[i] = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(columnSrc + (i * srcPitch) + 0x00)), nibbleMask);
+			rowsHi[i] = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(columnSrc + (i * srcPitch) + 0x10)), nibbleMask);
+		}
+
+		__m128i halvesLo[4];
+		__m128i halvesHi[4];
+		WriteColumn8_Sse2(rowsLo, (columnNum & 1) != 0, halvesLo);
+		WriteColumn8_Sse2(rowsHi, (columnNum & 1) != 0, halvesHi);
+
+		__m128i v[4];
+		for(uint32 i = 0; i < 4; i++)
+		{
+			__m128i expandedA = _mm_shuffle_epi32(_mm_unpacklo_epi64(halvesLo[i], halvesHi[i]), _MM_SHUFFLE(3, 1, 2, 0));
+			__m128i expandedB = _mm_shuffle_epi32(_mm_unpackhi_epi64(halvesLo[i], halvesHi[i]), _MM_SHUFFLE(3, 1, 2, 0));
+			__m128i bytesA = _mm_and_si128(_mm_or_si128(expandedA, _mm_srli_epi16(expandedA, 4)), byteMask);
+			__m128i bytesB = _mm_and_si128(_mm_or_si128(expandedB, _mm_srli_epi16(expandedB, 4)), byteMask);
+			v[i] = _mm_packus_epi16(bytesA, bytesB);
+		}
+
+		changed |= StoreColumn_Sse2(block + (columnNum * CGsPixelFormats::COLUMNSIZE), v[0], v[1], v[2], v[3]);
+	}
+	return changed;
+}
+
+static const KERNELS g_simdKernels =
+    {
+        "SSE2",
+        {
+            &ReadBlock32_Sse2,
+            &ReadBlock16_Sse2,
+            &ReadBlock8_Sse2,
+            &ReadBlock4_Sse2,
+        },
+        {
+            &WriteBlock32_Sse2,
+            &WriteBlock16_Sse2,
+            &WriteBlock8_Sse2,
+            &WriteBlock4_Sse2,
+        },
+};
+
+#endif
+
+#ifdef GSSWIZZLE_USE_NEON
+
+//Columns are 64 bytes, which is what a single table lookup can index. Every byte of a linear column (its rows
+//put one after the other) is gathered from the swizzled column and the other way around.
+struct COLUMN_INDICES
+{
+	uint8 read[4][CGsPixelFormats::COLUMNSIZE];
+	uint8 write[4][CGsPixelFormats::COLUMNSIZE];
+};
+
+template <uint32 unitSize, uint32 blockWidth, uint32 blockHeight>
+static COLUMN_INDICES BuildColumnIndices(const uint16 (&offsets)[blockHeight][blockWidth])
+{
+	COLUMN_INDICES result;
+	const uint32 rowSize = blockWidth * unitSize;
+	const uint32 columnHeight = blockHeight / 4;
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		for(uint32 i = 0; i < CGsPixelFormats::COLUMNSIZE; i++)
+		{
+			uint32 y = (columnNum * columnHeight) + (i / rowSize);
+			uint32 x = (i % rowSize) / unitSize;
+			uint32 swizzledIndex = offsets[y][x] + (i % unitSize) - (columnNum * CGsPixelFormats::COLUMNSIZE);
+			result.read[columnNum][i] = static_cast<uint8>(swizzledIndex);
+			result.write[columnNum][swizzledIndex] = static_cast<uint8>(i);
+		}
+	}
+	return result;
+}
+
+template <uint32 rowSize>
+static void ReadBlock_Neon(const uint8* block, uint8* dst, uint32 dstPitch, const COLUMN_INDICES& indices)
+{
+	const uint32 columnHeight = CGsPixelFormats::COLUMNSIZE / rowSize;
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto column = block + (columnNum * CGsPixelFormats::COLUMNSIZE);
+		uint8x16x4_t swizzled;
+		swizzled.val[0] = vld1q_u8(column + 0x00);
+		swizzled.val[1] = vld1q_u8(column + 0x10);
+		swizzled.val[2] = vld1q_u8(column + 0x20);
+		swizzled.val[3] = vld1q_u8(column + 0x30);
+
+		auto columnDst = dst + (columnNum * columnHeight * dstPitch);
+		for(uint32 i = 0; i < CGsPixelFormats::COLUMNSIZE; i += 0x10)
+		{
+			uint8x16_t linear = vqtbl4q_u8(swizzled, vld1q_u8(indices.read[columnNum] + i));
+			vst1q_u8(columnDst + ((i / rowSize) * dstPitch) + (i % rowSize), linear);
+		}
+	}
+}
+
+template <uint32 rowSize>
+static bool WriteBlock_Neon(uint8* block, const uint8* src, uint32 srcPitch, const COLUMN_INDICES& indices)
+{
+	const uint32 columnHeight = CGsPixelFormats::COLUMNSIZE / rowSize;
+	uint8x16_t changed = vdupq_n_u8(0);
+	for(uint32 columnNum = 0; columnNum < 4; columnNum++)
+	{
+		auto columnSrc = src + (columnNum * columnHeight * srcPitch);
+		uint8x16x4_t linear;
+		for(uint32 i = 0; i < 4; i++)
+		{
+			uint32 offset = i * 0x10;
+			linear.val[i] = vld1q_u8(columnSrc + ((offset / rowSize) * srcPitch) + (offset % rowSize));
+		}
+
+		auto column = block + (columnNum * CGsPixelFormats::COLUMNSIZE);
+		for(uint32 i = 0; i < CGsPixelFormats::COLUMNSIZE; i += 0x10)
+		{
+			uint8x16_t swizzled = vqtbl4q_u8(linear, vld1q_u8(indices.write[columnNum] + i));
+			changed = vorrq_u8(changed, veorq_u8(vld1q_u8(column + i), swizzled));
+			vst1q_u8(column + i, swizzled);
+		}
+	}
+	return vmaxvq_u8(changed) != 0;
+}
+
+static const COLUMN_INDICES& GetColumnIndices32()
+{
+	static const COLUMN_INDICES indices = BuildColumnIndices<4>(GetBlockOffsets().offsets32);
+	return indices;
+}
+
+static const COLUMN_INDICES& GetColumnIndices16()
+{
+	static const COLUMN_INDICES indices = BuildColumnIndices<2>(GetBlockOffsets().offsets16);
+	return indices;
+}
+
+static const COLUMN_INDICES& GetColumnIndices8()
+{
+	static const COLUMN_INDICES indices = BuildColumnIndices<1>(GetBlockOffsets().offsets8);
+	return indices;
+}
+
+static void ReadBlock32_Neon(const uint8* block, void* dst, uint32 dstPitch)
+{
+	ReadBlock_Neon<32>(block, reinterpret_cast<uint8*>(dst), dstPitch * 4, GetColumnIndices32());
+}
+
+static bool WriteBlock32_Neon(uint8* block, const void* src, uint32 srcPitch)
+{
+	return WriteBlock_Neon<32>(block, reinterpret_cast<const uint8*>(src), srcPitch * 4, GetColumnIndices32());
+}
+
+static void ReadBlock16_Neon(const uint8* block, void* dst, uint32 dstPitch)
+{
+	ReadBlock_Neon<32>(block, reinterpret_cast<uint8*>(dst), dstPitch * 2, GetColumnIndices16());
+}
+
+static bool WriteBlock16_Neon(uint8* block, const void* src, uint32 srcPitch)
+{
+	return WriteBlock_Neon<32>(block, reinterpret_cast<const uint8*>(src), srcPitch * 2, GetColumnIndices16());
+}
+
+static void ReadBlock8_Neon(const uint8* block, void* dst, uint32 dstPitch)
+{
+	ReadBlock_Neon<16>(block, reinterpret_cast<uint8*>(dst), dstPitch, GetColumnIndices8());
+}
+
+static bool WriteBlock8_Neon(uint8* block, const void* src, uint32 srcPitch)
+{
+	return WriteBlock_Neon<16>(block, reinterpret_cast<const uint8*>(src), srcPitch, GetColumnIndices8());
+}
+
+static const KERNELS g_simdKernels =
+    {
+        "NEON",
+        {
+            &ReadBlock32_Neon,
+            &ReadBlock16_Neon,
+            &ReadBlock8_Neon,
+            &ReadBlock4_Scalar,
+        },
+        {
+            &WriteBlock32_Neon,
+            &WriteBlock16_Neon,
+            &WriteBlock8_Neon,
+            &WriteBlock4_Scalar,
+        },
+};
+
+#endif
+
+static const KERNELS g_scalarKernels =
+    {
+        "Scalar",
+        {
+            &ReadBlock32_Scalar,
+            &ReadBlock16_Scalar,
+            &ReadBlock8_Scalar,
+            &ReadBlock4_Scalar,
+        },
+        {
+            &WriteBlock32_Scalar,
+            &WriteBlock16_Scalar,
+            &WriteBlock8_Scalar,
+            &WriteBlock4_Scalar,
+        },
+};
+
+const KERNELS& GsBlockSwizzle::GetScalarKernels()
+{
+	return g_scalarKernels;
+}
+
+const KERNELS* GsBlockSwizzle::GetSimdKernels()
+{
+#if defined(GSSWIZZLE_USE_SSE2) || defined(GSSWIZZLE_USE_NEON)
+	return &g_simdKernels;
+#else
+	return nullptr;
+#endif
+}
+
+const KERNELS& GsBlockSwizzle::GetDefaultKernels()
+{
+	auto simdKernels = GetSimdKernels();
+	return simdKernels ? *simdKernels : g_scalarKernels;
+}
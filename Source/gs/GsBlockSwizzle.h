@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Types.h"
+
+namespace GsBlockSwizzle
+{
+	//Storage formats that share the same layout inside a block
+	enum BLOCK_FORMAT
+	{
+		BLOCK_FORMAT_32, //PSMCT32, PSMZ32 (8x8 pixels)
+		BLOCK_FORMAT_16, //PSMCT16, PSMCT16S, PSMZ16 (16x8 pixels)
+		BLOCK_FORMAT_8,  //PSMT8 (16x16 pixels)
+		BLOCK_FORMAT_4,  //PSMT4 (32x16 pixels, one pixel per byte in linear buffers)
+		BLOCK_FORMAT_COUNT,
+	};
+
+	//Converts whole GS blocks between their swizzled layout in GS memory and a linear layout.
+	//The SIMD set gives the exact same results as the scalar set, which is kept as a reference and as a fallback.
+	struct KERNELS
+	{
+		//Linear buffers hold rows of pixels of the storage format's unit type, pitch is in pixels
+		typedef void (*ReadBlockFunction)(const uint8*, void*, uint32);
+		//Returns true if the contents of the block changed
+		typedef bool (*WriteBlockFunction)(uint8*, const void*, uint32);
+
+		const char* name;
+		ReadBlockFunction readBlock[BLOCK_FORMAT_COUNT];
+		WriteBlockFunction writeBlock[BLOCK_FORMAT_COUNT];
+	};
+
+	const KERNELS& GetScalarKernels();
+	//Returns nullptr if there is no SIMD implementation for the target
+	const KERNELS* GetSimdKernels();
+	const KERNELS& GetDefaultKernels();
+}
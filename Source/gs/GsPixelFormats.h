@@ -3,6 +3,7 @@
 #include <algorithm>
 #include "Types.h"
 #include "GSHandler.h"
+#include "GsBlockSwizzle.h"
 
 //defined in limits.h
 #undef PAGESIZE
@@ -52,6 +53,10 @@ public:
 		{
 			COLUMNHEIGHT = 2
 		};
+		enum BLOCKFORMAT
+		{
+			BLOCKFORMAT = GsBlockSwizzle::BLOCK_FORMAT_32
+		};
 
 		static const int m_nBlockSwizzleTable[4][8];
 		static const int m_nColumnSwizzleTable[2][8];
@@ -85,6 +90,10 @@ public:
 		{
 			COLUMNHEIGHT = 2
 		};
+		enum BLOCKFORMAT
+		{
+			BLOCKFORMAT = GsBlockSwizzle::BLOCK_FORMAT_32
+		};
 
 		static const int m_nBlockSwizzleTable[4][8];
 		static const int m_nColumnSwizzleTable[2][8];
@@ -118,6 +127,10 @@ public:
 		{
 			COLUMNHEIGHT = 2
 		};
+		enum BLOCKFORMAT
+		{
+			BLOCKFORMAT = GsBlockSwizzle::BLOCK_FORMAT_16
+		};
 
 		static const int m_nBlockSwizzleTable[8][4];
 		static const int m_nColumnSwizzleTable[2][16];
@@ -151,6 +164,10 @@ public:
 		{
 			COLUMNHEIGHT = 2
 		};
+		enum BLOCKFORMAT
+		{
+			BLOCKFORMAT = GsBlockSwizzle::BLOCK_FORMAT_16
+		};
 
 		static const int m_nBlockSwizzleTable[8][4];
 		static const int m_nColumnSwizzleTable[2][16];
@@ -184,6 +201,10 @@ public:
 		{
 			COLUMNHEIGHT = 2
 		};
+		enum BLOCKFORMAT
+		{
+			BLOCKFORMAT = GsBlockSwizzle::BLOCK_FORMAT_16
+		};
 
 		static const int m_nBlockSwizzleTable[8][4];
 		static const int m_nColumnSwizzleTable[2][16];
@@ -217,6 +238,10 @@ public:
 		{
 			COLUMNHEIGHT = 4
 		};
+		enum BLOCKFORMAT
+		{
+			BLOCKFORMAT = GsBlockSwizzle::BLOCK_FORMAT_8
+		};
 
 		static const int m_nBlockSwizzleTable[4][8];
 		static const int m_nColumnWordTable[2][2][8];
@@ -250,6 +275,10 @@ public:
 		{
 			COLUMNHEIGHT = 4
 		};
+		enum BLOCKFORMAT
+		{
+			BLOCKFORMAT = GsBlockSwizzle::BLOCK_FORMAT_4
+		};
 
 		static const int m_nBlockSwizzleTable[8][4];
 		static const int m_nColumnWordTable[2][2][8];
@@ -303,7 +332,92 @@ public:
 			return reinterpret_cast<uint32*>(m_pageOffsets);
 		}
 
+		//Copies a rectangle of pixels to a linear buffer (pitch in pixels). Coordinates wrap around at 2048
+		//like transfer coordinates do. Whole blocks are converted at once, edges fall back to GetPixel.
+		void ReadRect(uint32 nX, uint32 nY, uint32 nWidth, uint32 nHeight, typename Storage::Unit* pDst, uint32 nDstPitch)
+		{
+			auto readBlock = GsBlockSwizzle::GetDefaultKernels().readBlock[Storage::BLOCKFORMAT];
+			for(uint32 rectY = 0; rectY < nHeight;)
+			{
+				uint32 pixelY = (nY + rectY) % 2048;
+				uint32 rowCount = std::min<uint32>(Storage::BLOCKHEIGHT - (pixelY % Storage::BLOCKHEIGHT), nHeight - rectY);
+				for(uint32 rectX = 0; rectX < nWidth;)
+				{
+					uint32 pixelX = (nX + rectX) % 2048;
+					uint32 columnCount = std::min<uint32>(Storage::BLOCKWIDTH - (pixelX % Storage::BLOCKWIDTH), nWidth - rectX);
+					auto blockDst = pDst + (rectY * nDstPitch) + rectX;
+					if((rowCount == Storage::BLOCKHEIGHT) && (columnCount == Storage::BLOCKWIDTH))
+					{
+						readBlock(GetBlockAddress(pixelX, pixelY), blockDst, nDstPitch);
+					}
+					else
+					{
+						for(uint32 y = 0; y < rowCount; y++)
+						{
+							for(uint32 x = 0; x < columnCount; x++)
+							{
+								blockDst[(y * nDstPitch) + x] = GetPixel(pixelX + x, pixelY + y);
+							}
+						}
+					}
+					rectX += columnCount;
+				}
+				rectY += rowCount;
+			}
+		}
+
+		//Same as ReadRect, the other way around. Returns true if anything in memory changed.
+		bool WriteRect(uint32 nX, uint32 nY, uint32 nWidth, uint32 nHeight, const typename Storage::Unit* pSrc, uint32 nSrcPitch)
+		{
+			bool changed = false;
+			auto writeBlock = GsBlockSwizzle::GetDefaultKernels().writeBlock[Storage::BLOCKFORMAT];
+			for(uint32 rectY = 0; rectY < nHeight;)
+			{
+				uint32 pixelY = (nY + rectY) % 2048;
+				uint32 rowCount = std::min<uint32>(Storage::BLOCKHEIGHT - (pixelY % Storage::BLOCKHEIGHT), nHeight - rectY);
+				for(uint32 rectX = 0; rectX < nWidth;)
+				{
+					uint32 pixelX = (nX + rectX) % 2048;
+					uint32 columnCount = std::min<uint32>(Storage::BLOCKWIDTH - (pixelX % Storage::BLOCKWIDTH), nWidth - rectX);
+					auto blockSrc = pSrc + (rectY * nSrcPitch) + rectX;
+					if((rowCount == Storage::BLOCKHEIGHT) && (columnCount == Storage::BLOCKWIDTH))
+					{
+						changed |= writeBlock(GetBlockAddress(pixelX, pixelY), blockSrc, nSrcPitch);
+					}
+					else
+					{
+						for(uint32 y = 0; y < rowCount; y++)
+						{
+							for(uint32 x = 0; x < columnCount; x++)
+							{
+								auto pixel = blockSrc[(y * nSrcPitch) + x];
+								if(GetPixel(pixelX + x, pixelY + y) != pixel)
+								{
+									SetPixel(pixelX + x, pixelY + y, pixel);
+									changed = true;
+								}
+							}
+						}
+					}
+					rectX += columnCount;
+				}
+				rectY += rowCount;
+			}
+			return changed;
+		}
+
 	private:
+		uint8* GetBlockAddress(unsigned int nX, unsigned int nY)
+		{
+			uint32 pageNum = (nX / Storage::PAGEWIDTH) + (nY / Storage::PAGEHEIGHT) * (m_nWidth * 64) / Storage::PAGEWIDTH;
+
+			nX %= Storage::PAGEWIDTH;
+			nY %= Storage::PAGEHEIGHT;
+
+			uint32 blockNum = Storage::m_nBlockSwizzleTable[nY / Storage::BLOCKHEIGHT][nX / Storage::BLOCKWIDTH];
+			return m_pMemory + ((m_nPointer + (pageNum * PAGESIZE) + (blockNum * BLOCKSIZE)) & (CGSHandler::RAMSIZE - 1));
+		}
+
 		static void BuildPageOffsetTable()
 		{
 			if(m_pageOffsetsInitialized) return;
@@ -426,6 +540,8 @@ inline void CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMT4>::Build
 {
 	typedef STORAGEPSMT4 Storage;
 
+	if(m_pageOffsetsInitialized) return;
+
 	for(uint32 y = 0; y < Storage::PAGEHEIGHT; y++)
 	{
 		for(uint32 x = 0; x < Storage::PAGEWIDTH; x++)
@@ -458,6 +574,8 @@ inline void CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMT4>::Build
 			m_pageOffsets[y][x] = offset;
 		}
 	}
+
+	m_pageOffsetsInitialized = true;
 }
 
 template <>
@@ -465,6 +583,8 @@ inline void CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMT8>::Build
 {
 	typedef CGsPixelFormats::STORAGEPSMT8 Storage;
 
+	if(m_pageOffsetsInitialized) return;
+
 	for(uint32 y = 0; y < Storage::PAGEHEIGHT; y++)
 	{
 		for(uint32 x = 0; x < Storage::PAGEWIDTH; x++)
@@ -493,4 +613,6 @@ inline void CGsPixelFormats::CPixelIndexor<CGsPixelFormats::STORAGEPSMT8>::Build
 			m_pageOffsets[y][x] = offset;
 		}
 	}
+
+	m_pageOffsetsInitialized = true;
 }
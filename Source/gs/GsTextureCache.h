@@ -1,11 +1,19 @@
 #pragma once
 
-#include <list>
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 #include "GSHandler.h"
 #include "GsCachedArea.h"
+#include "GsPixelFormats.h"
 
 #define TEX0_CLUTINFO_MASK (~0xFFFFFFE000000000ULL)
 
+//Textures are found through a hash map keyed on TEX0 (without CLUT info) and are kept in a LRU
+//list, the least recently used one gets recycled when inserting. Every GS memory page holds a
+//bit mask of the textures overlapping it, invalidations only visit textures touched by a transfer.
 template <typename TextureHandleType>
 class CGsTextureCache
 {
@@ -26,43 +34,84 @@ public:
 
 		//Platform specific
 		TextureHandleType m_textureHandle;
+
+	private:
+		friend class CGsTextureCache;
+
+		CTexture* m_prev = nullptr;
+		CTexture* m_next = nullptr;
+		uint32 m_index = 0;
+		uint32 m_pageStart = 0;
+		uint32 m_pageEnd = 0;
 	};
 
 	enum
 	{
-		MAX_TEXTURE_CACHE = 256,
+		DEFAULT_TEXTURE_CACHE_SIZE = 256,
 	};
 
-	CGsTextureCache()
+	CGsTextureCache(uint32 capacity = DEFAULT_TEXTURE_CACHE_SIZE)
+	{
+		SetCapacity(capacity);
+	}
+
+	uint32 GetCapacity() const
+	{
+		return static_cast<uint32>(m_textures.size());
+	}
+
+	//Changing the capacity discards every cached texture
+	void SetCapacity(uint32 capacity)
 	{
-		for(unsigned int i = 0; i < MAX_TEXTURE_CACHE; i++)
+		capacity = std::max<uint32>(capacity, 1);
+		if(capacity == m_textures.size()) return;
+
+		m_textureMap.clear();
+		m_textures.clear();
+		m_lruHead = nullptr;
+		m_lruTail = nullptr;
+
+		m_pageMaskWordCount = (capacity + 63) / 64;
+		m_pageMasks.assign(PAGE_COUNT * m_pageMaskWordCount, 0);
+		m_invalidationMask.resize(m_pageMaskWordCount);
+
+		m_textures.reserve(capacity);
+		for(uint32 i = 0; i < capacity; i++)
 		{
-			m_textureCache.push_back(std::make_shared<CTexture>());
+			auto texture = std::make_unique<CTexture>();
+			texture->m_index = i;
+			LinkBack(texture.get());
+			m_textures.push_back(std::move(texture));
 		}
+		m_textureMap.reserve(capacity);
 	}
 
 	CTexture* Search(const CGSHandler::TEX0& tex0)
 	{
 		uint64 maskedTex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
 
-		for(auto textureIterator(m_textureCache.begin());
-		    textureIterator != m_textureCache.end(); textureIterator++)
+		auto textureIterator = m_textureMap.find(maskedTex0);
+		if(textureIterator == std::end(m_textureMap))
 		{
-			auto texture = *textureIterator;
-			if(!texture->m_live) continue;
-			if(maskedTex0 != texture->m_tex0) continue;
-			m_textureCache.erase(textureIterator);
-			m_textureCache.push_front(texture);
-			return texture.get();
+			m_stats.missCount++;
+			return nullptr;
 		}
 
-		return nullptr;
+		m_stats.hitCount++;
+		auto texture = textureIterator->second;
+		assert(texture->m_live);
+		Unlink(texture);
+		LinkFront(texture);
+		return texture;
 	}
 
-	void Insert(const CGSHandler::TEX0& tex0, TextureHandleType textureHandle)
+	CTexture* Insert(const CGSHandler::TEX0& tex0, TextureHandleType textureHandle)
 	{
-		auto texture = *m_textureCache.rbegin();
-		texture->Reset();
+		uint64 maskedTex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
+
+		auto textureIterator = m_textureMap.find(maskedTex0);
+		auto texture = (textureIterator != std::end(m_textureMap)) ? textureIterator->second : m_lruTail;
+		ReleaseTexture(texture);
 
 		// DBZ Budokai Tenkaichi 2 and 3 use invalid (empty) buffer sizes.
 		// Account for that, by assuming image width.
@@ -74,29 +123,133 @@ public:
 
 		texture->m_cachedArea.SetArea(tex0.nPsm, tex0.GetBufPtr(), bufSize, tex0.GetHeight());
 
-		texture->m_tex0 = static_cast<uint64>(tex0) & TEX0_CLUTINFO_MASK;
+		texture->m_tex0 = maskedTex0;
 		texture->m_textureHandle = std::move(textureHandle);
 		texture->m_live = true;
 
-		m_textureCache.pop_back();
-		m_textureCache.push_front(texture);
+		uint32 areaStart = tex0.GetBufPtr();
+		uint32 areaEnd = areaStart + texture->m_cachedArea.GetSize();
+		texture->m_pageStart = std::min<uint32>(areaStart / CGsPixelFormats::PAGESIZE, PAGE_COUNT);
+		texture->m_pageEnd = std::min<uint32>((areaEnd + CGsPixelFormats::PAGESIZE - 1) / CGsPixelFormats::PAGESIZE, PAGE_COUNT);
+		UpdatePageMasks(texture, true);
+
+		m_textureMap.emplace(maskedTex0, texture);
+		Unlink(texture);
+		LinkFront(texture);
+		return texture;
 	}
 
 	void InvalidateRange(uint32 start, uint32 size)
 	{
-		std::for_each(std::begin(m_textureCache), std::end(m_textureCache),
-		              [start, size](TexturePtr& texture) { if(texture->m_live) { texture->m_cachedArea.Invalidate(start, size); } });
+		if(size == 0) return;
+
+		uint32 pageStart = std::min<uint32>(start / CGsPixelFormats::PAGESIZE, PAGE_COUNT);
+		uint32 pageEnd = std::min<uint64>((static_cast<uint64>(start) + size + CGsPixelFormats::PAGESIZE - 1) / CGsPixelFormats::PAGESIZE, PAGE_COUNT);
+
+		std::fill(std::begin(m_invalidationMask), std::end(m_invalidationMask), 0);
+		for(uint32 page = pageStart; page < pageEnd; page++)
+		{
+			const auto pageMask = m_pageMasks.data() + (page * m_pageMaskWordCount);
+			for(uint32 word = 0; word < m_pageMaskWordCount; word++)
+			{
+				m_invalidationMask[word] |= pageMask[word];
+			}
+		}
+
+		for(uint32 word = 0; word < m_pageMaskWordCount; word++)
+		{
+			uint64 textureBits = m_invalidationMask[word];
+			for(uint32 bit = 0; textureBits != 0; bit++, textureBits >>= 1)
+			{
+				if((textureBits & 1) == 0) continue;
+				auto& texture = m_textures[(word * 64) + bit];
+				assert(texture->m_live);
+				texture->m_cachedArea.Invalidate(start, size);
+			}
+		}
 	}
 
 	void Flush()
 	{
-		std::for_each(std::begin(m_textureCache), std::end(m_textureCache),
-		              [](TexturePtr& texture) { texture->Reset(); });
+		for(auto& texture : m_textures)
+		{
+			ReleaseTexture(texture.get());
+		}
+	}
+
+	const CGSHandler::TEXTURECACHE_STATS& GetStats() const
+	{
+		return m_stats;
 	}
 
 private:
-	typedef std::shared_ptr<CTexture> TexturePtr;
-	typedef std::list<TexturePtr> TextureList;
+	typedef std::unique_ptr<CTexture> TexturePtr;
+	typedef std::vector<TexturePtr> TextureArray;
+	typedef std::unordered_map<uint64, CTexture*> TextureMap;
+
+	enum
+	{
+		PAGE_COUNT = CGSHandler::RAMSIZE / CGsPixelFormats::PAGESIZE,
+	};
+
+	void ReleaseTexture(CTexture* texture)
+	{
+		if(!texture->m_live) return;
+		m_textureMap.erase(texture->m_tex0);
+		UpdatePageMasks(texture, false);
+		texture->Reset();
+
+		//Free textures get reused first
+		Unlink(texture);
+		LinkBack(texture);
+	}
+
+	void UpdatePageMasks(const CTexture* texture, bool set)
+	{
+		uint32 word = texture->m_index / 64;
+		uint64 bit = 1ULL << (texture->m_index % 64);
+		for(uint32 page = texture->m_pageStart; page < texture->m_pageEnd; page++)
+		{
+			auto& pageMask = m_pageMasks[(page * m_pageMaskWordCount) + word];
+			pageMask = set ? (pageMask | bit) : (pageMask & ~bit);
+		}
+	}
+
+	void Unlink(CTexture* texture)
+	{
+		(texture->m_prev ? texture->m_prev->m_next : m_lruHead) = texture->m_next;
+		(texture->m_next ? texture->m_next->m_prev : m_lruTail) = texture->m_prev;
+		texture->m_prev = nullptr;
+		texture->m_next = nullptr;
+	}
+
+	void LinkFront(CTexture* texture)
+	{
+		texture->m_prev = nullptr;
+		texture->m_next = m_lruHead;
+		(m_lruHead ? m_lruHead->m_prev : m_lruTail) = texture;
+		m_lruHead = texture;
+	}
+
+	void LinkBack(CTexture* texture)
+	{
+		texture->m_prev = m_lruTail;
+		texture->m_next = nullptr;
+		(m_lruTail ? m_lruTail->m_next : m_lruHead) = texture;
+		m_lruTail = texture;
+	}
+
+	TextureArray m_textures;
+	TextureMap m_textureMap;
+
+	//Most recently used texture is at the head
+	CTexture* m_lruHead = nullptr;
+	CTexture* m_lruTail = nullptr;
+
+	//Bit masks of textures overlapping each GS page, m_pageMaskWordCount words per page
+	std::vector<uint64> m_pageMasks;
+	std::vector<uint64> m_invalidationMask;
+	uint32 m_pageMaskWordCount = 0;
 
-	TextureList m_textureCache;
+	CGSHandler::TEXTURECACHE_STATS m_stats;
 };
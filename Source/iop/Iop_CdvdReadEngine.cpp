@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "../Log.h"
+#include "../Ps2Const.h"
+#include "Iop_CdvdReadEngine.h"
+
+#define LOG_NAME "iop_cdvdreadengine"
+
+//Drive model, 4x DVD and 24x CD read speeds
+#define DVD_BYTES_PER_SECOND (4 * 1385000)
+#define CD_BYTES_PER_SECOND (24 * 153600)
+//Seeks take a minimum amount of time plus a part of the full stroke time proportional to the distance
+#define SEEK_MIN_TIME_US 2000
+#define SEEK_FULL_STROKE_TIME_US 120000
+#define SEEK_FULL_STROKE_SECTORS 2295104
+
+using namespace Iop;
+
+CCdvdReadEngine::CCdvdReadEngine(TimeSource timeSource)
+    : m_timeSource(std::move(timeSource))
+{
+	m_thread = std::thread([this]() { ThreadProc(); });
+}
+
+CCdvdReadEngine::~CCdvdReadEngine()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_threadDone = true;
+		m_ioCondition.notify_one();
+	}
+	m_thread.join();
+}
+
+void CCdvdReadEngine::SetOpticalMedia(COpticalMedia* opticalMedia)
+{
+	//Don't let the media go away while the I/O thread is reading from it
+	//Requests still in the queue will be served by the new media
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_progressCondition.wait(lock, [this]() { return !m_ioBusy; });
+	m_opticalMedia = opticalMedia;
+}
+
+CCdvdReadEngine::RequestId CCdvdReadEngine::BeginRead(uint32 sector, uint32 count)
+{
+	uint64 currentTime = m_timeSource();
+	uint64 startTime = std::max(currentTime, m_driveBusyUntil);
+
+	auto request = std::make_shared<REQUEST>();
+	request->id = m_nextRequestId++;
+	if(m_nextRequestId == INVALID_REQUEST_ID) m_nextRequestId++;
+	request->sector = sector;
+	request->count = count;
+	request->transferStartTime = startTime + ComputeSeekTime(sector);
+	request->sectorTransferTime = ComputeSectorTransferTime();
+	request->data.resize(static_cast<size_t>(count) * SECTOR_SIZE);
+
+	m_headSector = sector + count;
+	m_driveBusyUntil = request->transferStartTime + (request->sectorTransferTime * count);
+	m_requests.emplace(request->id, request);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_ioQueue.push_back(request);
+		m_ioCondition.notify_one();
+	}
+
+	return request->id;
+}
+
+bool CCdvdReadEngine::Update(RequestId requestId, uint8* dest)
+{
+	auto requestIterator = m_requests.find(requestId);
+	if(requestIterator == std::end(m_requests)) return true;
+
+	auto& request = *requestIterator->second;
+	uint64 currentTime = m_timeSource();
+	uint64 transferredCount = 0;
+	if(currentTime > request.transferStartTime)
+	{
+		transferredCount = (currentTime - request.transferStartTime) / std::max<uint64>(request.sectorTransferTime, 1);
+	}
+
+	uint32 readCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		readCount = request.readCount;
+	}
+
+	uint32 deliverCount = static_cast<uint32>(std::min<uint64>(readCount, transferredCount));
+	Deliver(request, deliverCount, dest);
+	if(request.deliveredCount != request.count) return false;
+
+	m_requests.erase(requestIterator);
+	return true;
+}
+
+void CCdvdReadEngine::Complete(RequestId requestId, uint8* dest)
+{
+	auto requestIterator = m_requests.find(requestId);
+	if(requestIterator == std::end(m_requests)) return;
+
+	auto& request = *requestIterator->second;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_progressCondition.wait(lock, [&]() { return request.readCount == request.count; });
+	}
+
+	Deliver(request, request.count, dest);
+	m_requests.erase(requestIterator);
+}
+
+void CCdvdReadEngine::Cancel(RequestId requestId)
+{
+	auto requestIterator = m_requests.find(requestId);
+	if(requestIterator == std::end(m_requests)) return;
+
+	{
+		//The I/O thread skips it when it gets to it (or after the chunk it's currently reading)
+		std::lock_guard<std::mutex> lock(m_mutex);
+		requestIterator->second->cancelled = true;
+	}
+	m_requests.erase(requestIterator);
+}
+
+uint32 CCdvdReadEngine::GetDeliveredCount(RequestId requestId) const
+{
+	auto requestIterator = m_requests.find(requestId);
+	if(requestIterator == std::end(m_requests)) return 0;
+	return requestIterator->second->deliveredCount;
+}
+
+uint64 CCdvdReadEngine::ComputeSeekTime(uint32 sector) const
+{
+	if(sector == m_headSector) return 0;
+	uint64 distance = (sector > m_headSector) ? (sector - m_headSector) : (m_headSector - sector);
+	distance = std::min<uint64>(distance, SEEK_FULL_STROKE_SECTORS);
+	uint64 seekTimeUs = SEEK_MIN_TIME_US + ((distance * (SEEK_FULL_STROKE_TIME_US - SEEK_MIN_TIME_US)) / SEEK_FULL_STROKE_SECTORS);
+	return (seekTimeUs * PS2::IOP_CLOCK_OVER_FREQ) / 1000000;
+}
+
+uint64 CCdvdReadEngine::ComputeSectorTransferTime() const
+{
+	bool isCd = m_opticalMedia && (m_opticalMedia->GetTrackDataType(0) == COpticalMedia::TRACK_DATA_TYPE_MODE2_2352);
+	uint64 bytesPerSecond = isCd ? CD_BYTES_PER_SECOND : DVD_BYTES_PER_SECOND;
+	return (static_cast<uint64>(SECTOR_SIZE) * PS2::IOP_CLOCK_OVER_FREQ) / bytesPerSecond;
+}
+
+void CCdvdReadEngine::Deliver(REQUEST& request, uint32 deliverCount, uint8* dest)
+{
+	assert(deliverCount <= request.count);
+	if(deliverCount <= request.deliveredCount) return;
+	if(dest)
+	{
+		size_t offset = static_cast<size_t>(request.deliveredCount) * SECTOR_SIZE;
+		size_t size = static_cast<size_t>(deliverCount - request.deliveredCount) * SECTOR_SIZE;
+		memcpy(dest + offset, request.data.data() + offset, size);
+	}
+	request.deliveredCount = deliverCount;
+}
+
+void CCdvdReadEngine::ThreadProc()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(1)
+	{
+		m_ioCondition.wait(lock, [this]() { return !m_ioQueue.empty() || m_threadDone; });
+		if(m_threadDone) break;
+
+		auto request = m_ioQueue.front();
+		if(request->cancelled || (request->readCount == request->count))
+		{
+			m_ioQueue.pop_front();
+			continue;
+		}
+
+		uint32 sector = request->sector + request->readCount;
+		uint32 count = std::min<uint32>(request->count - request->readCount, CHUNK_SECTOR_COUNT);
+		uint8* chunk = request->data.data() + (static_cast<size_t>(request->readCount) * SECTOR_SIZE);
+		auto opticalMedia = m_opticalMedia;
+		m_ioBusy = true;
+		lock.unlock();
+
+		try
+		{
+			if(opticalMedia)
+			{
+				opticalMedia->GetFileSystem()->ReadBlocks(sector, count, chunk);
+			}
+			else
+			{
+				memset(chunk, 0, static_cast<size_t>(count) * SECTOR_SIZE);
+			}
+		}
+		catch(const std::exception& exception)
+		{
+			//Nothing much we can do, the guest gets zeroes for those sectors
+			CLog::GetInstance().Warn(LOG_NAME, "Failed to read sectors 0x%08X-0x%08X: %s\r\n",
+			                         sector, sector + count, exception.what());
+			memset(chunk, 0, static_cast<size_t>(count) * SECTOR_SIZE);
+		}
+
+		lock.lock();
+		request->readCount += count;
+		m_ioBusy = false;
+		m_progressCondition.notify_all();
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Types.h"
+#include "../OpticalMedia.h"
+
+namespace Iop
+{
+	//Reads sectors from the optical media on an I/O thread, guest memory is only written on the emulation thread
+	//Sectors are delivered when they've been read from the host and when the drive would have transferred them,
+	//according to a simple seek and transfer rate model. Completing a request before that forces the wait.
+	class CCdvdReadEngine
+	{
+	public:
+		typedef uint32 RequestId;
+		//Returns the current IOP time, in IOP clock ticks
+		typedef std::function<uint64()> TimeSource;
+
+		enum : RequestId
+		{
+			INVALID_REQUEST_ID = 0,
+		};
+
+		CCdvdReadEngine(TimeSource);
+		~CCdvdReadEngine();
+
+		CCdvdReadEngine(const CCdvdReadEngine&) = delete;
+		CCdvdReadEngine& operator=(const CCdvdReadEngine&) = delete;
+
+		void SetOpticalMedia(COpticalMedia*);
+
+		RequestId BeginRead(uint32 sector, uint32 count);
+
+		//Copies sectors that are ready to the destination (can be null), returns true once the request is done
+		bool Update(RequestId, uint8* dest);
+
+		//Waits for every sector to be read from the host and copies them to the destination (can be null)
+		void Complete(RequestId, uint8* dest);
+
+		//Drops a request, nothing more will be delivered
+		void Cancel(RequestId);
+
+		uint32 GetDeliveredCount(RequestId) const;
+
+	private:
+		enum
+		{
+			SECTOR_SIZE = 0x800,
+			CHUNK_SECTOR_COUNT = 0x20,
+		};
+
+		struct REQUEST
+		{
+			RequestId id = INVALID_REQUEST_ID;
+			uint32 sector = 0;
+			uint32 count = 0;
+			uint64 transferStartTime = 0;
+			uint64 sectorTransferTime = 0;
+			std::vector<uint8> data;
+
+			//Protected by m_mutex
+			uint32 readCount = 0;
+			bool cancelled = false;
+
+			//Only touched by the emulation thread
+			uint32 deliveredCount = 0;
+		};
+		typedef std::shared_ptr<REQUEST> RequestPtr;
+		typedef std::unordered_map<RequestId, RequestPtr> RequestMap;
+
+		uint64 ComputeSeekTime(uint32) const;
+		uint64 ComputeSectorTransferTime() const;
+		void Deliver(REQUEST&, uint32, uint8*);
+
+		void ThreadProc();
+
+		TimeSource m_timeSource;
+
+		//Emulation thread state
+		RequestMap m_requests;
+		RequestId m_nextRequestId = INVALID_REQUEST_ID + 1;
+		uint32 m_headSector = 0;
+		uint64 m_driveBusyUntil = 0;
+
+		//Shared with the I/O thread, protected by m_mutex
+		std::mutex m_mutex;
+		COpticalMedia* m_opticalMedia = nullptr;
+		std::deque<RequestPtr> m_ioQueue;
+		bool m_ioBusy = false;
+		bool m_threadDone = false;
+		std::condition_variable m_ioCondition;
+		std::condition_variable m_progressCondition;
+		std::thread m_thread;
+	};
+}
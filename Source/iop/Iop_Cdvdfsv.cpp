@@ -62,53 +62,44 @@ void CCdvdfsv::ProcessCommands(CSifMan* sifMan)
 {
 	if(m_pendingCommand != COMMAND_NONE)
 	{
-		static const uint32 sectorSize = 0x800;
-
 		uint8* eeRam = nullptr;
 		if(auto sifManPs2 = dynamic_cast<CSifManPs2*>(sifMan))
 		{
 			eeRam = sifManPs2->GetEeRam();
 		}
 
+		//Reads only reply once the drive is done with them
+		uint8* readDest = nullptr;
 		if(m_pendingCommand == COMMAND_READ)
 		{
-			if(m_opticalMedia != nullptr)
-			{
-				auto fileSystem = m_opticalMedia->GetFileSystem();
-				for(unsigned int i = 0; i < m_pendingReadCount; i++)
-				{
-					fileSystem->ReadBlock(m_pendingReadSector + i, eeRam + (m_pendingReadAddr + (i * sectorSize)));
-				}
-			}
+			readDest = eeRam + m_pendingReadAddr;
 		}
 		else if(m_pendingCommand == COMMAND_READIOP)
 		{
-			if(m_opticalMedia != nullptr)
-			{
-				auto fileSystem = m_opticalMedia->GetFileSystem();
-				for(unsigned int i = 0; i < m_pendingReadCount; i++)
-				{
-					fileSystem->ReadBlock(m_pendingReadSector + i, m_iopRam + (m_pendingReadAddr + (i * sectorSize)));
-				}
-			}
+			readDest = m_iopRam + m_pendingReadAddr;
 		}
 		else if(m_pendingCommand == COMMAND_STREAM_READ)
 		{
-			if(m_opticalMedia != nullptr)
-			{
-				auto fileSystem = m_opticalMedia->GetFileSystem();
-				for(unsigned int i = 0; i < m_pendingReadCount; i++)
-				{
-					fileSystem->ReadBlock(m_streamPos, eeRam + (m_pendingReadAddr + (i * sectorSize)));
-					m_streamPos++;
-				}
-			}
+			readDest = eeRam + m_pendingReadAddr;
 		}
 		else if(m_pendingCommand == COMMAND_NDISKREADY)
 		{
 			//Result already set, just return normally
 		}
 
+		if(m_pendingReadId != CCdvdReadEngine::INVALID_REQUEST_ID)
+		{
+			if(!m_cdvdman.GetReadEngine().Update(m_pendingReadId, readDest))
+			{
+				return;
+			}
+			m_pendingReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+			if(m_pendingCommand == COMMAND_STREAM_READ)
+			{
+				m_streamPos += m_pendingReadCount;
+			}
+		}
+
 		m_pendingCommand = COMMAND_NONE;
 		sifMan->SendCallReply(MODULE_ID_4, nullptr);
 	}
@@ -131,6 +122,11 @@ void CCdvdfsv::LoadState(Framework::CZipArchiveReader& archive)
 	m_streaming = registerFile.GetRegister32(STATE_STREAMING) != 0;
 	m_streamPos = registerFile.GetRegister32(STATE_STREAMPOS);
 	m_streamBufferSize = registerFile.GetRegister32(STATE_STREAMBUFFERSIZE);
+
+	//Data that was still in flight isn't saved, read it again
+	m_cdvdman.GetReadEngine().Cancel(m_pendingReadId);
+	m_pendingReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+	BeginPendingRead();
 }
 
 void CCdvdfsv::SaveState(Framework::CZipArchiveWriter& archive)
@@ -380,6 +376,7 @@ void CCdvdfsv::Read(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 	m_pendingReadSector = sector;
 	m_pendingReadCount = count;
 	m_pendingReadAddr = dstAddr & 0x1FFFFFFF;
+	BeginPendingRead();
 }
 
 void CCdvdfsv::ReadIopMem(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
@@ -402,6 +399,7 @@ void CCdvdfsv::ReadIopMem(uint32* args, uint32 argsSize, uint32* ret, uint32 ret
 	m_pendingReadSector = sector;
 	m_pendingReadCount = count;
 	m_pendingReadAddr = dstAddr & 0x1FFFFFFF;
+	BeginPendingRead();
 }
 
 bool CCdvdfsv::StreamCmd(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
@@ -434,6 +432,7 @@ bool CCdvdfsv::StreamCmd(uint32* args, uint32 argsSize, uint32* ret, uint32 retS
 		m_pendingReadSector = 0;
 		m_pendingReadCount = count;
 		m_pendingReadAddr = dstAddr & (PS2::EE_RAM_SIZE - 1);
+		BeginPendingRead();
 		ret[0] = count;
 		immediateReply = false;
 		CLog::GetInstance().Print(LOG_NAME, "StreamRead(count = 0x%08X, dest = 0x%08X);\r\n",
@@ -577,3 +576,28 @@ void CCdvdfsv::SearchFile(uint32* args, uint32 argsSize, uint32* ret, uint32 ret
 
 	ret[0] = 1;
 }
+
+void CCdvdfsv::BeginPendingRead()
+{
+	if(m_pendingReadId != CCdvdReadEngine::INVALID_REQUEST_ID)
+	{
+		//Previous read never completed, it's superseded by this one
+		CLog::GetInstance().Warn(LOG_NAME, "Starting a read while another one is still in flight.\r\n");
+		m_cdvdman.GetReadEngine().Cancel(m_pendingReadId);
+		m_pendingReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+	}
+	if(m_opticalMedia == nullptr) return;
+	switch(m_pendingCommand)
+	{
+	case COMMAND_READ:
+	case COMMAND_READIOP:
+		m_pendingReadId = m_cdvdman.GetReadEngine().BeginRead(m_pendingReadSector, m_pendingReadCount);
+		break;
+	case COMMAND_STREAM_READ:
+		//Stream position only moves forward when the read completes
+		m_pendingReadId = m_cdvdman.GetReadEngine().BeginRead(m_streamPos, m_pendingReadCount);
+		break;
+	default:
+		break;
+	}
+}
@@ -2,6 +2,7 @@
 
 #include "Iop_Module.h"
 #include "Iop_SifMan.h"
+#include "Iop_CdvdReadEngine.h"
 #include "../SifModuleAdapter.h"
 #include "../OpticalMedia.h"
 #include "zip/ZipArchiveWriter.h"
@@ -64,6 +65,8 @@ namespace Iop
 		bool NDiskReady(uint32*, uint32, uint32*, uint32, uint8*);
 		void SearchFile(uint32*, uint32, uint32*, uint32, uint8*);
 
+		void BeginPendingRead();
+
 		CCdvdman& m_cdvdman;
 		uint8* m_iopRam = nullptr;
 		COpticalMedia* m_opticalMedia = nullptr;
@@ -72,6 +75,7 @@ namespace Iop
 		uint32 m_pendingReadSector = 0;
 		uint32 m_pendingReadCount = 0;
 		uint32 m_pendingReadAddr = 0;
+		CCdvdReadEngine::RequestId m_pendingReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
 
 		bool m_streaming = false;
 		uint32 m_streamPos = 0;
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include "../Log.h"
 #include "../states/RegisterStateFile.h"
@@ -10,6 +11,9 @@
 #define STATE_CALLBACK_ADDRESS ("CallbackAddress")
 #define STATE_STATUS ("Status")
 #define STATE_PENDING_COMMAND ("PendingCommand")
+#define STATE_PENDING_READ_SECTOR ("PendingReadSector")
+#define STATE_PENDING_READ_COUNT ("PendingReadCount")
+#define STATE_PENDING_READ_BUFFER_PTR ("PendingReadBufferPtr")
 
 #define FUNCTION_CDINIT "CdInit"
 #define FUNCTION_CDREAD "CdRead"
@@ -39,6 +43,7 @@ using namespace Iop;
 CCdvdman::CCdvdman(CIopBios& bios, uint8* ram)
     : m_bios(bios)
     , m_ram(ram)
+    , m_readEngine([&bios]() { return bios.GetCurrentTime(); })
 {
 }
 
@@ -48,6 +53,18 @@ void CCdvdman::LoadState(Framework::CZipArchiveReader& archive)
 	m_callbackPtr = registerFile.GetRegister32(STATE_CALLBACK_ADDRESS);
 	m_status = registerFile.GetRegister32(STATE_STATUS);
 	m_pendingCommand = static_cast<COMMAND>(registerFile.GetRegister32(STATE_PENDING_COMMAND));
+	m_pendingReadSector = registerFile.GetRegister32(STATE_PENDING_READ_SECTOR);
+	m_pendingReadCount = registerFile.GetRegister32(STATE_PENDING_READ_COUNT);
+	m_pendingReadBufferPtr = registerFile.GetRegister32(STATE_PENDING_READ_BUFFER_PTR);
+
+	//Data that was still in flight isn't saved, read it again
+	m_readEngine.Cancel(m_pendingReadId);
+	m_pendingReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+	if((m_pendingCommand == COMMAND_READ) && (m_pendingReadCount != 0))
+	{
+		m_pendingReadId = m_readEngine.BeginRead(m_pendingReadSector, m_pendingReadCount);
+	}
+	CancelStreamRead();
 }
 
 void CCdvdman::SaveState(Framework::CZipArchiveWriter& archive)
@@ -56,6 +73,9 @@ void CCdvdman::SaveState(Framework::CZipArchiveWriter& archive)
 	registerFile->SetRegister32(STATE_CALLBACK_ADDRESS, m_callbackPtr);
 	registerFile->SetRegister32(STATE_STATUS, m_status);
 	registerFile->SetRegister32(STATE_PENDING_COMMAND, m_pendingCommand);
+	registerFile->SetRegister32(STATE_PENDING_READ_SECTOR, m_pendingReadSector);
+	registerFile->SetRegister32(STATE_PENDING_READ_COUNT, m_pendingReadCount);
+	registerFile->SetRegister32(STATE_PENDING_READ_BUFFER_PTR, m_pendingReadBufferPtr);
 	archive.InsertFile(registerFile);
 }
 
@@ -99,6 +119,11 @@ uint32 CCdvdman::CdGetDiskTypeDirect(COpticalMedia* opticalMedia)
 	}
 }
 
+CCdvdReadEngine& CCdvdman::GetReadEngine()
+{
+	return m_readEngine;
+}
+
 std::string CCdvdman::GetId() const
 {
 	return "cdvdman";
@@ -288,6 +313,13 @@ void CCdvdman::ProcessCommands()
 		switch(m_pendingCommand)
 		{
 		case COMMAND_READ:
+			//Wait until the drive is done with it
+			if(!m_readEngine.Update(m_pendingReadId, GetPendingReadBuffer()))
+			{
+				return;
+			}
+			m_pendingReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+			m_pendingReadCount = 0;
 			if(m_callbackPtr != 0)
 			{
 				m_bios.TriggerCallback(m_callbackPtr, CDVD_FUNCTION_READ);
@@ -310,6 +342,7 @@ void CCdvdman::ProcessCommands()
 void CCdvdman::SetOpticalMedia(COpticalMedia* opticalMedia)
 {
 	m_opticalMedia = opticalMedia;
+	m_readEngine.SetOpticalMedia(opticalMedia);
 }
 
 uint32 CCdvdman::CdInit(uint32 mode)
@@ -338,16 +371,13 @@ uint32 CCdvdman::CdRead(uint32 startSector, uint32 sectorCount, uint32 bufferPtr
 		//Does that make sure it's 2048 byte mode?
 		assert(mode[2] == 0);
 	}
-	if(m_opticalMedia && (bufferPtr != 0))
+	if(m_opticalMedia)
 	{
-		uint8* buffer = &m_ram[bufferPtr];
-		static const uint32 sectorSize = 2048;
-		auto fileSystem = m_opticalMedia->GetFileSystem();
-		for(unsigned int i = 0; i < sectorCount; i++)
-		{
-			fileSystem->ReadBlock(startSector + i, buffer);
-			buffer += sectorSize;
-		}
+		//Sectors get copied to the buffer as the read progresses, the command completes when it's done
+		m_pendingReadId = m_readEngine.BeginRead(startSector, sectorCount);
+		m_pendingReadSector = startSector;
+		m_pendingReadCount = sectorCount;
+		m_pendingReadBufferPtr = bufferPtr;
 	}
 	m_pendingCommand = COMMAND_READ;
 	m_status = CDVD_STATUS_READING;
@@ -436,6 +466,11 @@ uint32 CCdvdman::CdSync(uint32 mode)
 	    (mode == 0x10) || (mode == 0x11));
 	if((mode == 0x00) || (mode == 0x10))
 	{
+		//Blocking, make sure everything arrived
+		if(m_pendingCommand == COMMAND_READ)
+		{
+			m_readEngine.Complete(m_pendingReadId, GetPendingReadBuffer());
+		}
 		ProcessCommands();
 		assert(m_pendingCommand == COMMAND_NONE);
 	}
@@ -500,14 +535,15 @@ uint32 CCdvdman::CdGetReadPos()
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_CDGETREADPOS "();\r\n");
 
-	//If we're reading, report that we've read 1 sector for now
-	return (m_pendingCommand == COMMAND_READ) ? 0x800 : 0;
+	if(m_pendingCommand != COMMAND_READ) return 0;
+	return m_readEngine.GetDeliveredCount(m_pendingReadId) * 0x800;
 }
 
 uint32 CCdvdman::CdStInit(uint32 bufMax, uint32 bankMax, uint32 bufPtr)
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_CDSTINIT "(bufMax = %d, bankMax = %d, bufPtr = 0x%08X);\r\n",
 	                          bufMax, bankMax, bufPtr);
+	CancelStreamRead();
 	m_streamPos = 0;
 	m_streamBufferSize = bufMax;
 	return 1;
@@ -517,25 +553,27 @@ uint32 CCdvdman::CdStRead(uint32 sectors, uint32 bufPtr, uint32 mode, uint32 err
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_CDSTREAD "(sectors = %d, bufPtr = 0x%08X, mode = %d, errPtr = 0x%08X);\r\n",
 	                          sectors, bufPtr, mode, errPtr);
-	auto fileSystem = m_opticalMedia->GetFileSystem();
-	for(unsigned int i = 0; i < sectors; i++)
-	{
-		fileSystem->ReadBlock(m_streamPos, m_ram + (bufPtr + (i * 0x800)));
-		m_streamPos++;
-	}
+	//Mode 0 only returns what the drive has delivered so far, mode 1 waits for every sector
+	bool blocking = (mode != 0);
+	uint32 readCount = ReadStreamSectors(m_ram + bufPtr, sectors, blocking);
 	if(errPtr != 0)
 	{
 		auto err = reinterpret_cast<uint32*>(m_ram + errPtr);
 		(*err) = 0; //No error
 	}
-	return sectors;
+	return readCount;
 }
 
 uint32 CCdvdman::CdStStart(uint32 sector, uint32 modePtr)
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_CDSTSTART "(sector = %d, modePtr = 0x%08X);\r\n",
 	                          sector, modePtr);
+	CancelStreamRead();
 	m_streamPos = sector;
+	if(m_streamBufferSize != 0)
+	{
+		BeginStreamRead(m_streamBufferSize);
+	}
 	return 1;
 }
 
@@ -548,6 +586,7 @@ uint32 CCdvdman::CdStStat()
 uint32 CCdvdman::CdStStop()
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_CDSTSTOP "();\r\n");
+	CancelStreamRead();
 	return 1;
 }
 
@@ -561,6 +600,7 @@ uint32 CCdvdman::CdStSeekF(uint32 sector)
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_CDSTSEEKF "(sector = %d);\r\n",
 	                          sector);
+	CancelStreamRead();
 	m_streamPos = sector;
 	return 1;
 }
@@ -585,3 +625,76 @@ uint32 CCdvdman::CdLayerSearchFile(uint32 fileInfoPtr, uint32 namePtr, uint32 la
 	assert(layer == 0);
 	return CdSearchFile(fileInfoPtr, namePtr);
 }
+
+uint8* CCdvdman::GetPendingReadBuffer()
+{
+	return (m_pendingReadBufferPtr != 0) ? (m_ram + m_pendingReadBufferPtr) : nullptr;
+}
+
+void CCdvdman::BeginStreamRead(uint32 sectorCount)
+{
+	assert(m_streamReadId == CCdvdReadEngine::INVALID_REQUEST_ID);
+	m_streamReadId = m_readEngine.BeginRead(m_streamPos, sectorCount);
+	m_streamReadBuffer.resize(static_cast<size_t>(sectorCount) * 0x800);
+	m_streamReadCount = sectorCount;
+	m_streamReadDelivered = 0;
+	m_streamReadConsumed = 0;
+}
+
+uint32 CCdvdman::ReadStreamSectors(uint8* dest, uint32 sectorCount, bool blocking)
+{
+	uint32 readCount = 0;
+	while(readCount < sectorCount)
+	{
+		if(m_streamReadId == CCdvdReadEngine::INVALID_REQUEST_ID)
+		{
+			BeginStreamRead(std::max(m_streamBufferSize, sectorCount - readCount));
+		}
+
+		//Request is gone from the engine once everything has been delivered
+		if(m_readEngine.Update(m_streamReadId, m_streamReadBuffer.data()))
+		{
+			m_streamReadDelivered = m_streamReadCount;
+		}
+		else
+		{
+			m_streamReadDelivered = m_readEngine.GetDeliveredCount(m_streamReadId);
+		}
+
+		uint32 copyCount = std::min(m_streamReadDelivered - m_streamReadConsumed, sectorCount - readCount);
+		if(copyCount == 0)
+		{
+			if(!blocking) break;
+			m_readEngine.Complete(m_streamReadId, m_streamReadBuffer.data());
+			m_streamReadDelivered = m_streamReadCount;
+			continue;
+		}
+
+		memcpy(dest + (static_cast<size_t>(readCount) * 0x800),
+		       m_streamReadBuffer.data() + (static_cast<size_t>(m_streamReadConsumed) * 0x800),
+		       static_cast<size_t>(copyCount) * 0x800);
+		m_streamReadConsumed += copyCount;
+		m_streamPos += copyCount;
+		readCount += copyCount;
+		if(m_streamReadConsumed == m_streamReadCount)
+		{
+			CancelStreamRead();
+		}
+	}
+
+	//Keep the drive busy while the guest goes through what it got
+	if((m_streamReadId == CCdvdReadEngine::INVALID_REQUEST_ID) && (m_streamBufferSize != 0))
+	{
+		BeginStreamRead(m_streamBufferSize);
+	}
+	return readCount;
+}
+
+void CCdvdman::CancelStreamRead()
+{
+	m_readEngine.Cancel(m_streamReadId);
+	m_streamReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+	m_streamReadCount = 0;
+	m_streamReadDelivered = 0;
+	m_streamReadConsumed = 0;
+}
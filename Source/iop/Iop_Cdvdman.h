@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Iop_Module.h"
+#include "Iop_CdvdReadEngine.h"
 #include "../OpticalMedia.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
@@ -43,6 +44,8 @@ namespace Iop
 		uint32 CdReadClockDirect(uint8*);
 		uint32 CdGetDiskTypeDirect(COpticalMedia*);
 
+		CCdvdReadEngine& GetReadEngine();
+
 	private:
 		enum COMMAND : uint32
 		{
@@ -80,6 +83,11 @@ namespace Iop
 		uint32 CdReadDvdDualInfo(uint32, uint32);
 		uint32 CdLayerSearchFile(uint32, uint32, uint32);
 
+		uint8* GetPendingReadBuffer();
+		void BeginStreamRead(uint32);
+		uint32 ReadStreamSectors(uint8*, uint32, bool);
+		void CancelStreamRead();
+
 		CIopBios& m_bios;
 		COpticalMedia* m_opticalMedia = nullptr;
 		uint8* m_ram = nullptr;
@@ -89,6 +97,19 @@ namespace Iop
 		uint32 m_streamPos = 0;
 		uint32 m_streamBufferSize = 0;
 		COMMAND m_pendingCommand = COMMAND_NONE;
+
+		CCdvdReadEngine m_readEngine;
+		CCdvdReadEngine::RequestId m_pendingReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+		uint32 m_pendingReadSector = 0;
+		uint32 m_pendingReadCount = 0;
+		uint32 m_pendingReadBufferPtr = 0;
+
+		//Stream reads are served from a request that reads ahead into a host buffer
+		CCdvdReadEngine::RequestId m_streamReadId = CCdvdReadEngine::INVALID_REQUEST_ID;
+		std::vector<uint8> m_streamReadBuffer;
+		uint32 m_streamReadCount = 0;
+		uint32 m_streamReadDelivered = 0;
+		uint32 m_streamReadConsumed = 0;
 	};
 
 	typedef std::shared_ptr<CCdvdman> CdvdmanPtr;
@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <cstring>
+#include <algorithm>
 #include "Iop_RootCounters.h"
 #include "Iop_Intc.h"
 #include "string_format.h"
@@ -115,50 +116,12 @@ void CRootCounters::Update(unsigned int ticks)
 		COUNTER& counter = m_counter[i];
 		if(i == 2 && counter.mode.en) continue;
 		//Compute count increment
-		unsigned int clockRatio = 1;
-		if(i == 0 && counter.mode.clc)
-		{
-			clockRatio = m_pixelClocks;
-		}
-		if(i == 1 && counter.mode.clc)
-		{
-			clockRatio = m_hsyncClocks;
-		}
-		if(i == 2 && (counter.mode.div != COUNTER_SCALE_1))
-		{
-			assert(counter.mode.div == COUNTER_SCALE_8);
-			clockRatio = 8;
-		}
-		if(
-		    ((i == 4) || (i == 5)) &&
-		    (counter.mode.div != COUNTER_SCALE_1))
-		{
-			switch(counter.mode.div)
-			{
-			case COUNTER_SCALE_8:
-				clockRatio = 8;
-				break;
-			case COUNTER_SCALE_16:
-				clockRatio = 16;
-				break;
-			case COUNTER_SCALE_256:
-				clockRatio = 256;
-				break;
-			}
-		}
+		unsigned int clockRatio = GetClockRatio(i);
 		unsigned int totalTicks = counter.clockRemain + ticks;
 		unsigned int countAdd = totalTicks / clockRatio;
 		counter.clockRemain = totalTicks % clockRatio;
 		//Update count
-		uint32 counterMax = 0;
-		if(g_counterSizes[i] == 16)
-		{
-			counterMax = counter.mode.tar ? static_cast<uint16>(counter.target) : 0xFFFF;
-		}
-		else
-		{
-			counterMax = counter.mode.tar ? counter.target : 0xFFFFFFFF;
-		}
+		uint32 counterMax = GetCounterMax(i);
 		uint32 counterTemp = counter.count + countAdd;
 		if(counterTemp >= counterMax)
 		{
@@ -179,6 +142,75 @@ void CRootCounters::Update(unsigned int ticks)
 	}
 }
 
+uint32 CRootCounters::GetTicksUntilNextInterrupt() const
+{
+	//Only an estimate used to end execution slices close to counter interrupts,
+	//Update is still what raises them
+	uint32 result = UINT32_MAX;
+	for(unsigned int i = 0; i < MAX_COUNTERS; i++)
+	{
+		const auto& counter = m_counter[i];
+		if(i == 2 && counter.mode.en) continue;
+		if(!(counter.mode.iq1 && counter.mode.iq2)) continue;
+		uint32 counterMax = GetCounterMax(i);
+		if(counter.count >= counterMax) continue;
+		uint64 clockRatio = GetClockRatio(i);
+		uint64 ticks = (static_cast<uint64>(counterMax - counter.count) * clockRatio) - std::min<uint64>(counter.clockRemain, clockRatio - 1);
+		result = static_cast<uint32>(std::min<uint64>(result, ticks));
+	}
+	return result;
+}
+
+unsigned int CRootCounters::GetClockRatio(unsigned int counterId) const
+{
+	const auto& counter = m_counter[counterId];
+	unsigned int clockRatio = 1;
+	if(counterId == 0 && counter.mode.clc)
+	{
+		clockRatio = m_pixelClocks;
+	}
+	if(counterId == 1 && counter.mode.clc)
+	{
+		clockRatio = m_hsyncClocks;
+	}
+	if(counterId == 2 && (counter.mode.div != COUNTER_SCALE_1))
+	{
+		assert(counter.mode.div == COUNTER_SCALE_8);
+		clockRatio = 8;
+	}
+	if(
+	    ((counterId == 4) || (counterId == 5)) &&
+	    (counter.mode.div != COUNTER_SCALE_1))
+	{
+		switch(counter.mode.div)
+		{
+		case COUNTER_SCALE_8:
+			clockRatio = 8;
+			break;
+		case COUNTER_SCALE_16:
+			clockRatio = 16;
+			break;
+		case COUNTER_SCALE_256:
+			clockRatio = 256;
+			break;
+		}
+	}
+	return clockRatio;
+}
+
+uint32 CRootCounters::GetCounterMax(unsigned int counterId) const
+{
+	const auto& counter = m_counter[counterId];
+	if(g_counterSizes[counterId] == 16)
+	{
+		return counter.mode.tar ? static_cast<uint16>(counter.target) : 0xFFFF;
+	}
+	else
+	{
+		return counter.mode.tar ? counter.target : 0xFFFFFFFF;
+	}
+}
+
 uint32 CRootCounters::ReadRegister(uint32 address)
 {
 #ifdef _DEBUG
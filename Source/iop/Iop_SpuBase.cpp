@@ -7,6 +7,11 @@
 #include "../states/RegisterStateFile.h"
 #include "Iop_SpuBase.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SPU_USE_SSE2
+#include <emmintrin.h>
+#endif
+
 using namespace Iop;
 
 #define INIT_SAMPLE_RATE (44100)
@@ -91,6 +96,47 @@ bool CSpuBase::g_reverbParamIsAddress[REVERB_PARAM_COUNT] =
         false,
         false};
 
+#ifdef SPU_USE_SSE2
+
+//Computes (a * b) / 0x7FFF like the scalar code does, rounding towards zero.
+//x / 0x7FFF == (x + (x >> 15) + 1) >> 15 holds for every product of two 16-bit operands.
+static __m128i DivideBy7FFF(__m128i value)
+{
+	__m128i sign = _mm_srai_epi32(value, 31);
+	__m128i absValue = _mm_sub_epi32(_mm_xor_si128(value, sign), sign);
+	__m128i quotient = _mm_add_epi32(absValue, _mm_srli_epi32(absValue, 15));
+	quotient = _mm_srli_epi32(_mm_add_epi32(quotient, _mm_set1_epi32(1)), 15);
+	return _mm_sub_epi32(_mm_xor_si128(quotient, sign), sign);
+}
+
+static void MulDivideSamples(__m128i a, __m128i b, __m128i& resultLo, __m128i& resultHi)
+{
+	__m128i zero = _mm_setzero_si128();
+	resultLo = DivideBy7FFF(_mm_madd_epi16(_mm_unpacklo_epi16(a, zero), _mm_unpacklo_epi16(b, zero)));
+	resultHi = DivideBy7FFF(_mm_madd_epi16(_mm_unpackhi_epi16(a, zero), _mm_unpackhi_epi16(b, zero)));
+}
+
+static __m128i MulDivideSamples(__m128i a, __m128i b)
+{
+	__m128i resultLo, resultHi;
+	MulDivideSamples(a, b, resultLo, resultHi);
+	return _mm_packs_epi32(resultLo, resultHi);
+}
+
+//Adds (input * volume) / 0x7FFF to 8 output samples with saturation
+static void AccumulateSamples(int16* output, __m128i inputSample, __m128i volume)
+{
+	__m128i mixedLo, mixedHi;
+	MulDivideSamples(inputSample, volume, mixedLo, mixedHi);
+	__m128i outputSample = _mm_loadu_si128(reinterpret_cast<const __m128i*>(output));
+	__m128i outputLo = _mm_srai_epi32(_mm_unpacklo_epi16(outputSample, outputSample), 16);
+	__m128i outputHi = _mm_srai_epi32(_mm_unpackhi_epi16(outputSample, outputSample), 16);
+	outputSample = _mm_packs_epi32(_mm_add_epi32(outputLo, mixedLo), _mm_add_epi32(outputHi, mixedHi));
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(output), outputSample);
+}
+
+#endif
+
 const uint32 CSpuBase::g_linearIncreaseSweepDeltas[0x80] =
     {
         0x3A0CC55E, 0x305FF9CE, 0x2976D61E, 0x203FFBDE, 0x1D0662AF, 0x182FFCE7, 0x1359971F, 0x101FFDEF,
@@ -588,6 +634,34 @@ int32 CSpuBase::ComputeChannelVolume(const CHANNEL_VOLUME& volume, int32 current
 	return volumeLevel;
 }
 
+void CSpuBase::ComputeChannelVolumeBlock(const CHANNEL_VOLUME& volume, int32& currentVolume, int32* adjustedVolumes, unsigned int tickCount)
+{
+	if(tickCount == 0) return;
+	if(!volume.mode.mode)
+	{
+		//Fixed volume, the same for every tick
+		currentVolume = ComputeChannelVolume(volume, currentVolume);
+		int32 adjustedVolume = GetAdjustedVolume(currentVolume);
+		for(unsigned int i = 0; i < tickCount; i++)
+		{
+			adjustedVolumes[i] = adjustedVolume;
+		}
+	}
+	else
+	{
+		for(unsigned int i = 0; i < tickCount; i++)
+		{
+			currentVolume = ComputeChannelVolume(volume, currentVolume);
+			adjustedVolumes[i] = GetAdjustedVolume(currentVolume);
+		}
+	}
+}
+
+int32 CSpuBase::GetAdjustedVolume(int32 volume) const
+{
+	return std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(volume >> 16) * m_volumeAdjust));
+}
+
 void CSpuBase::MixSamples(int32 inputSample, int32 volumeLevel, int16* output)
 {
 	inputSample = (inputSample * volumeLevel) / 0x7FFF;
@@ -597,10 +671,96 @@ void CSpuBase::MixSamples(int32 inputSample, int32 volumeLevel, int16* output)
 	*output = static_cast<int16>(resultSample);
 }
 
+void CSpuBase::MixChannelBlock(const int16* samples, const int32* adsrVolumes, const int32* leftVolumes, const int32* rightVolumes,
+                               int16* outputLeft, int16* outputRight, int16* reverbLeft, int16* reverbRight, unsigned int tickCount)
+{
+	unsigned int tick = 0;
+
+#ifdef SPU_USE_SSE2
+	//Envelope and volumes are packed to 16-bits, they always fit unless the channel's state is invalid
+	bool canUseSimd = true;
+	{
+		__m128i outOfRange = _mm_setzero_si128();
+		for(unsigned int i = 0; i < (tickCount & ~3U); i += 4)
+		{
+			__m128i adsrVolume = _mm_loadu_si128(reinterpret_cast<const __m128i*>(adsrVolumes + i));
+			__m128i leftVolume = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(leftVolumes + i)), _mm_set1_epi32(0x8000));
+			__m128i rightVolume = _mm_add_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rightVolumes + i)), _mm_set1_epi32(0x8000));
+			outOfRange = _mm_or_si128(outOfRange, _mm_andnot_si128(_mm_set1_epi32(0x7FFF), adsrVolume));
+			outOfRange = _mm_or_si128(outOfRange, _mm_andnot_si128(_mm_set1_epi32(0xFFFF), _mm_or_si128(leftVolume, rightVolume)));
+		}
+		canUseSimd = _mm_movemask_epi8(_mm_cmpeq_epi32(outOfRange, _mm_setzero_si128())) == 0xFFFF;
+	}
+
+	if(canUseSimd)
+	{
+		for(; (tick + 8) <= tickCount; tick += 8)
+		{
+			__m128i sample = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + tick));
+			__m128i adsrVolume = _mm_packs_epi32(
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(adsrVolumes + tick + 0)),
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(adsrVolumes + tick + 4)));
+			__m128i leftVolume = _mm_packs_epi32(
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(leftVolumes + tick + 0)),
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(leftVolumes + tick + 4)));
+			__m128i rightVolume = _mm_packs_epi32(
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(rightVolumes + tick + 0)),
+			    _mm_loadu_si128(reinterpret_cast<const __m128i*>(rightVolumes + tick + 4)));
+
+			__m128i inputSample = MulDivideSamples(sample, adsrVolume);
+			AccumulateSamples(outputLeft + tick, inputSample, leftVolume);
+			AccumulateSamples(outputRight + tick, inputSample, rightVolume);
+			if(reverbLeft)
+			{
+				AccumulateSamples(reverbLeft + tick, inputSample, leftVolume);
+				AccumulateSamples(reverbRight + tick, inputSample, rightVolume);
+			}
+		}
+	}
+#endif
+
+	for(; tick < tickCount; tick++)
+	{
+		int32 inputSample = static_cast<int32>(samples[tick]);
+		inputSample = (inputSample * adsrVolumes[tick]) / static_cast<int32>(MAX_ADSR_VOLUME >> 16);
+		MixSamples(inputSample, leftVolumes[tick], outputLeft + tick);
+		MixSamples(inputSample, rightVolumes[tick], outputRight + tick);
+		if(reverbLeft)
+		{
+			MixSamples(inputSample, leftVolumes[tick], reverbLeft + tick);
+			MixSamples(inputSample, rightVolumes[tick], reverbRight + tick);
+		}
+	}
+}
+
+
 void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sampleRate)
+{
+	if(m_blockMixingEnabled)
+	{
+		RenderBlocks(samples, sampleCount, sampleRate);
+	}
+	else
+	{
+		RenderTicks(samples, sampleCount, sampleRate);
+	}
+}
+
+bool CSpuBase::IsBlockMixingEnabled() const
+{
+	return m_blockMixingEnabled;
+}
+
+void CSpuBase::SetBlockMixingEnabled(bool enabled)
+{
+	m_blockMixingEnabled = enabled;
+}
+
+void CSpuBase::RenderTicks(int16* samples, unsigned int sampleCount, unsigned int sampleRate)
 {
 	bool updateReverb = m_reverbEnabled && (m_ctrl & CONTROL_REVERB) && (m_reverbWorkAddrStart < m_reverbWorkAddrEnd);
 	bool checkIrqs = (m_ctrl & CONTROL_IRQ) && (m_irqAddr != INVALID_ADDRESS);
+	auto reverbCoefs = GetReverbCoefs();
 
 	assert((sampleCount & 0x01) == 0);
 	//ticks are 44100Hz ticks
@@ -667,8 +827,8 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 			channel.volumeLeftAbs = ComputeChannelVolume(channel.volumeLeft, channel.volumeLeftAbs);
 			channel.volumeRightAbs = ComputeChannelVolume(channel.volumeRight, channel.volumeRightAbs);
 
-			int32 adjustedLeftVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeLeftAbs >> 16) * m_volumeAdjust));
-			int32 adjustedRightVolume = std::min<int32>(0x7FFF, static_cast<int32>(static_cast<float>(channel.volumeRightAbs >> 16) * m_volumeAdjust));
+			int32 adjustedLeftVolume = GetAdjustedVolume(channel.volumeLeftAbs);
+			int32 adjustedRightVolume = GetAdjustedVolume(channel.volumeRightAbs);
 			MixSamples(inputSample, adjustedLeftVolume, samples + 0);
 			MixSamples(inputSample, adjustedRightVolume, samples + 1);
 			//Mix in reverb if enabled for this channel
@@ -696,133 +856,296 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 			MixSamples(sampleR, 0x3FFF, samples + 1);
 		}
 
-		//Update reverb
 		if(updateReverb)
 		{
-			//Feed samples to FIR filter
-			if(m_reverbTicks & 1)
+			UpdateReverb(reverbCoefs, reverbSample[0], reverbSample[1], samples + 0, samples + 1);
+		}
+		samples += 2;
+	}
+}
+
+void CSpuBase::RenderBlocks(int16* samples, unsigned int sampleCount, unsigned int sampleRate)
+{
+	//Same output as RenderTicks, but every channel goes through a whole block of ticks at once.
+	//Channels don't depend on each other during a tick and are still mixed in the same order,
+	//so the clamping done after each channel is mixed gives the same results.
+	bool updateReverb = m_reverbEnabled && (m_ctrl & CONTROL_REVERB) && (m_reverbWorkAddrStart < m_reverbWorkAddrEnd);
+	bool checkIrqs = (m_ctrl & CONTROL_IRQ) && (m_irqAddr != INVALID_ADDRESS);
+	auto reverbCoefs = GetReverbCoefs();
+
+	assert((sampleCount & 0x01) == 0);
+	//ticks are 44100Hz ticks
+	unsigned int ticks = sampleCount / 2;
+
+	for(unsigned int blockTick = 0; blockTick < ticks; blockTick += RENDER_BLOCK_TICKS)
+	{
+		unsigned int blockTickCount = std::min<unsigned int>(ticks - blockTick, RENDER_BLOCK_TICKS);
+
+		alignas(16) int16 outputLeft[RENDER_BLOCK_TICKS] = {};
+		alignas(16) int16 outputRight[RENDER_BLOCK_TICKS] = {};
+		alignas(16) int16 reverbLeft[RENDER_BLOCK_TICKS] = {};
+		alignas(16) int16 reverbRight[RENDER_BLOCK_TICKS] = {};
+
+		for(unsigned int i = 0; i < MAX_CHANNEL; i++)
+		{
+			bool reverbChannel = updateReverb && (m_channelReverb.f & (1 << i));
+			RenderChannelBlock(i, outputLeft, outputRight, reverbChannel ? reverbLeft : nullptr, reverbChannel ? reverbRight : nullptr,
+			                   blockTickCount, sampleRate, checkIrqs);
+		}
+
+		for(unsigned int j = 0; j < blockTickCount; j++)
+		{
+			if(!m_blockReader.CanReadSamples() && (m_blockWritePtr == SOUND_INPUT_DATA_SIZE))
 			{
-				//IIR_INPUT_A0 = buffer[IIR_SRC_A0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
-				//IIR_INPUT_A1 = buffer[IIR_SRC_A1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
-				//IIR_INPUT_B0 = buffer[IIR_SRC_B0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
-				//IIR_INPUT_B1 = buffer[IIR_SRC_B1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
-
-				float input_sample_l = static_cast<float>(reverbSample[0]) * 0.5f;
-				float input_sample_r = static_cast<float>(reverbSample[1]) * 0.5f;
-
-				float irr_coef = GetReverbCoef(IIR_COEF);
-				float in_coef_l = GetReverbCoef(IN_COEF_L);
-				float in_coef_r = GetReverbCoef(IN_COEF_R);
-
-				float iir_input_a0 = GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * irr_coef + input_sample_l * in_coef_l;
-				float iir_input_a1 = GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * irr_coef + input_sample_r * in_coef_r;
-				float iir_input_b0 = GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * irr_coef + input_sample_l * in_coef_l;
-				float iir_input_b1 = GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * irr_coef + input_sample_r * in_coef_r;
-
-				//IIR_A0 = IIR_INPUT_A0 * IIR_ALPHA + buffer[IIR_DEST_A0] * (1.0 - IIR_ALPHA);
-				//IIR_A1 = IIR_INPUT_A1 * IIR_ALPHA + buffer[IIR_DEST_A1] * (1.0 - IIR_ALPHA);
-				//IIR_B0 = IIR_INPUT_B0 * IIR_ALPHA + buffer[IIR_DEST_B0] * (1.0 - IIR_ALPHA);
-				//IIR_B1 = IIR_INPUT_B1 * IIR_ALPHA + buffer[IIR_DEST_B1] * (1.0 - IIR_ALPHA);
-
-				float iir_alpha = GetReverbCoef(IIR_ALPHA);
-
-				float iir_a0 = iir_input_a0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A0)) * (1.0f - iir_alpha);
-				float iir_a1 = iir_input_a1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A1)) * (1.0f - iir_alpha);
-				float iir_b0 = iir_input_b0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B0)) * (1.0f - iir_alpha);
-				float iir_b1 = iir_input_b1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B1)) * (1.0f - iir_alpha);
-
-				//buffer[IIR_DEST_A0 + 1sample] = IIR_A0;
-				//buffer[IIR_DEST_A1 + 1sample] = IIR_A1;
-				//buffer[IIR_DEST_B0 + 1sample] = IIR_B0;
-				//buffer[IIR_DEST_B1 + 1sample] = IIR_B1;
-
-				SetReverbSample(GetReverbOffset(IIR_DEST_A0) + 2, iir_a0);
-				SetReverbSample(GetReverbOffset(IIR_DEST_A1) + 2, iir_a1);
-				SetReverbSample(GetReverbOffset(IIR_DEST_B0) + 2, iir_b0);
-				SetReverbSample(GetReverbOffset(IIR_DEST_B1) + 2, iir_b1);
-
-				//ACC0 = buffer[ACC_SRC_A0] * ACC_COEF_A +
-				//	   buffer[ACC_SRC_B0] * ACC_COEF_B +
-				//	   buffer[ACC_SRC_C0] * ACC_COEF_C +
-				//	   buffer[ACC_SRC_D0] * ACC_COEF_D;
-				//ACC1 = buffer[ACC_SRC_A1] * ACC_COEF_A +
-				//	   buffer[ACC_SRC_B1] * ACC_COEF_B +
-				//	   buffer[ACC_SRC_C1] * ACC_COEF_C +
-				//	   buffer[ACC_SRC_D1] * ACC_COEF_D;
-
-				float acc_coef_a = GetReverbCoef(ACC_COEF_A);
-				float acc_coef_b = GetReverbCoef(ACC_COEF_B);
-				float acc_coef_c = GetReverbCoef(ACC_COEF_C);
-				float acc_coef_d = GetReverbCoef(ACC_COEF_D);
-
-				float acc0 =
-				    GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * acc_coef_a +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * acc_coef_b +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_C0)) * acc_coef_c +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_D0)) * acc_coef_d;
-
-				float acc1 =
-				    GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * acc_coef_a +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * acc_coef_b +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_C1)) * acc_coef_c +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_D1)) * acc_coef_d;
-
-				//FB_A0 = buffer[MIX_DEST_A0 - FB_SRC_A];
-				//FB_A1 = buffer[MIX_DEST_A1 - FB_SRC_A];
-				//FB_B0 = buffer[MIX_DEST_B0 - FB_SRC_B];
-				//FB_B1 = buffer[MIX_DEST_B1 - FB_SRC_B];
-
-				float fb_a0 = GetReverbSample(GetReverbOffset(MIX_DEST_A0) - GetReverbOffset(FB_SRC_A));
-				float fb_a1 = GetReverbSample(GetReverbOffset(MIX_DEST_A1) - GetReverbOffset(FB_SRC_A));
-				float fb_b0 = GetReverbSample(GetReverbOffset(MIX_DEST_B0) - GetReverbOffset(FB_SRC_B));
-				float fb_b1 = GetReverbSample(GetReverbOffset(MIX_DEST_B1) - GetReverbOffset(FB_SRC_B));
-
-				//buffer[MIX_DEST_A0] = ACC0 - FB_A0 * FB_ALPHA;
-				//buffer[MIX_DEST_A1] = ACC1 - FB_A1 * FB_ALPHA;
-				//buffer[MIX_DEST_B0] = (FB_ALPHA * ACC0) - FB_A0 * (FB_ALPHA^0x8000) - FB_B0 * FB_X;
-				//buffer[MIX_DEST_B1] = (FB_ALPHA * ACC1) - FB_A1 * (FB_ALPHA^0x8000) - FB_B1 * FB_X;
-
-				float fb_alpha = GetReverbCoef(FB_ALPHA);
-				float fb_x = GetReverbCoef(FB_X);
-
-				SetReverbSample(GetReverbOffset(MIX_DEST_A0), acc0 - fb_a0 * fb_alpha);
-				SetReverbSample(GetReverbOffset(MIX_DEST_A1), acc1 - fb_a1 * fb_alpha);
-				SetReverbSample(GetReverbOffset(MIX_DEST_B0), (fb_alpha * acc0) - fb_a0 * -fb_alpha - fb_b0 * fb_x);
-				SetReverbSample(GetReverbOffset(MIX_DEST_B1), (fb_alpha * acc1) - fb_a1 * -fb_alpha - fb_b1 * fb_x);
-
-				m_reverbCurrAddr += 2;
-				if(m_reverbCurrAddr >= m_reverbWorkAddrEnd)
-				{
-					m_reverbCurrAddr = m_reverbWorkAddrStart;
-				}
+				//We're ready to consume some data
+				m_blockReader.FillBlock(m_ram + m_soundInputDataAddr);
+				m_blockWritePtr = 0;
 			}
 
-			if(m_reverbWorkAddrStart != 0)
+			if(m_blockReader.CanReadSamples())
 			{
-				float sampleL = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A0)) + GetReverbSample(GetReverbOffset(MIX_DEST_B0)));
-				float sampleR = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A1)) + GetReverbSample(GetReverbOffset(MIX_DEST_B1)));
+				int16 sampleL = 0;
+				int16 sampleR = 0;
+				m_blockReader.GetSamples(sampleL, sampleR, sampleRate);
 
-				{
-					int16* output = samples + 0;
-					int32 resultSample = static_cast<int32>(sampleL) + static_cast<int32>(*output);
-					resultSample = std::max<int32>(resultSample, SHRT_MIN);
-					resultSample = std::min<int32>(resultSample, SHRT_MAX);
-					*output = static_cast<int16>(resultSample);
-				}
+				MixSamples(sampleL, 0x3FFF, outputLeft + j);
+				MixSamples(sampleR, 0x3FFF, outputRight + j);
+			}
 
-				{
-					int16* output = samples + 1;
-					int32 resultSample = static_cast<int32>(sampleR) + static_cast<int32>(*output);
-					resultSample = std::max<int32>(resultSample, SHRT_MIN);
-					resultSample = std::min<int32>(resultSample, SHRT_MAX);
-					*output = static_cast<int16>(resultSample);
-				}
+			//Reverb feeds back on itself through its work area, it needs to be updated one tick at a time
+			if(updateReverb)
+			{
+				UpdateReverb(reverbCoefs, reverbLeft[j], reverbRight[j], outputLeft + j, outputRight + j);
 			}
 
-			m_reverbTicks++;
+			samples[0] = outputLeft[j];
+			samples[1] = outputRight[j];
+			samples += 2;
+		}
+	}
+}
+
+void CSpuBase::RenderChannelBlock(unsigned int channelIndex, int16* outputLeft, int16* outputRight, int16* reverbLeft, int16* reverbRight,
+                                  unsigned int tickCount, unsigned int sampleRate, bool checkIrqs)
+{
+	auto& channel(m_channel[channelIndex]);
+	auto& reader(m_reader[channelIndex]);
+
+	alignas(16) int16 readSamples[RENDER_BLOCK_TICKS];
+	alignas(16) int32 adsrVolumes[RENDER_BLOCK_TICKS];
+	alignas(16) int32 leftVolumes[RENDER_BLOCK_TICKS];
+	alignas(16) int32 rightVolumes[RENDER_BLOCK_TICKS];
+
+	//The block is split in runs of ticks where the channel's status only changes on the last tick.
+	//A run ends when the channel is done playing its sample or when its envelope has reached the end of its release.
+	unsigned int tick = 0;
+	bool readerStoppedFirst = false;
+	while(tick < tickCount)
+	{
+		if((channel.status == STOPPED) && !checkIrqs)
+		{
+			//The envelope runs ahead of the reader. If the reader reached the end of its data first,
+			//the per-tick path would have seen it on the next tick, before the envelope stopped the channel.
+			if(readerStoppedFirst)
+			{
+				reader.ClearIsDone();
+			}
+			break;
+		}
+		if(channel.status == KEY_ON)
+		{
+			reader.SetParams(channel.address, channel.repeat);
+			reader.ClearEndFlag();
+			channel.status = ATTACK;
+			channel.adsrVolume = 0;
+		}
+		else
+		{
+			if(reader.IsDone())
+			{
+				channel.status = STOPPED;
+				channel.adsrVolume = 0;
+				reader.ClearIsDone();
+				//No point in continuing if we don't need to check interrupts
+				if(!checkIrqs) break;
+			}
+			if(reader.DidChangeRepeat())
+			{
+				channel.repeat = reader.GetRepeat();
+				reader.ClearDidChangeRepeat();
+			}
+			//Update repeat in case it has been changed externally (needed for FFX)
+			reader.SetRepeat(channel.repeat);
+		}
+
+		reader.SetIrqAddress(m_irqAddr);
+		reader.SetPitch(m_baseSamplingRate, channel.pitch);
+
+		//The envelope doesn't depend on samples. If the reader stops before the end of the run,
+		//the envelope state is reset by the next run, so going ahead of the reader is harmless.
+		unsigned int adsrTickCount = UpdateAdsrBlock(channel, adsrVolumes + tick, tickCount - tick, !checkIrqs);
+		unsigned int runTickCount = reader.GetSamples(readSamples + tick, adsrTickCount, sampleRate);
+		readerStoppedFirst = (runTickCount < adsrTickCount);
+		channel.current = reader.GetCurrent();
+
+		//IRQ address hits are still checked on every sample block the reader decodes
+		if(checkIrqs && reader.GetIrqPending())
+		{
+			m_irqPending = true;
+		}
+
+		reader.ClearIrqPending();
+
+		ComputeChannelVolumeBlock(channel.volumeLeft, channel.volumeLeftAbs, leftVolumes + tick, runTickCount);
+		ComputeChannelVolumeBlock(channel.volumeRight, channel.volumeRightAbs, rightVolumes + tick, runTickCount);
+
+		tick += runTickCount;
+	}
+
+	if(tick == 0) return;
+
+	MixChannelBlock(readSamples, adsrVolumes, leftVolumes, rightVolumes, outputLeft, outputRight, reverbLeft, reverbRight, tick);
+}
+
+CSpuBase::REVERB_COEFS CSpuBase::GetReverbCoefs() const
+{
+	REVERB_COEFS coefs;
+	coefs.iirCoef = GetReverbCoef(IIR_COEF);
+	coefs.inCoefL = GetReverbCoef(IN_COEF_L);
+	coefs.inCoefR = GetReverbCoef(IN_COEF_R);
+	coefs.iirAlpha = GetReverbCoef(IIR_ALPHA);
+	coefs.accCoefA = GetReverbCoef(ACC_COEF_A);
+	coefs.accCoefB = GetReverbCoef(ACC_COEF_B);
+	coefs.accCoefC = GetReverbCoef(ACC_COEF_C);
+	coefs.accCoefD = GetReverbCoef(ACC_COEF_D);
+	coefs.fbAlpha = GetReverbCoef(FB_ALPHA);
+	coefs.fbX = GetReverbCoef(FB_X);
+	return coefs;
+}
+
+void CSpuBase::UpdateReverb(const REVERB_COEFS& coefs, int16 reverbSampleL, int16 reverbSampleR, int16* outputL, int16* outputR)
+{
+	//Feed samples to FIR filter
+	if(m_reverbTicks & 1)
+	{
+		//IIR_INPUT_A0 = buffer[IIR_SRC_A0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
+		//IIR_INPUT_A1 = buffer[IIR_SRC_A1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
+		//IIR_INPUT_B0 = buffer[IIR_SRC_B0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
+		//IIR_INPUT_B1 = buffer[IIR_SRC_B1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
+
+		float input_sample_l = static_cast<float>(reverbSampleL) * 0.5f;
+		float input_sample_r = static_cast<float>(reverbSampleR) * 0.5f;
+
+		float irr_coef = coefs.iirCoef;
+		float in_coef_l = coefs.inCoefL;
+		float in_coef_r = coefs.inCoefR;
+
+		float iir_input_a0 = GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * irr_coef + input_sample_l * in_coef_l;
+		float iir_input_a1 = GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * irr_coef + input_sample_r * in_coef_r;
+		float iir_input_b0 = GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * irr_coef + input_sample_l * in_coef_l;
+		float iir_input_b1 = GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * irr_coef + input_sample_r * in_coef_r;
+
+		//IIR_A0 = IIR_INPUT_A0 * IIR_ALPHA + buffer[IIR_DEST_A0] * (1.0 - IIR_ALPHA);
+		//IIR_A1 = IIR_INPUT_A1 * IIR_ALPHA + buffer[IIR_DEST_A1] * (1.0 - IIR_ALPHA);
+		//IIR_B0 = IIR_INPUT_B0 * IIR_ALPHA + buffer[IIR_DEST_B0] * (1.0 - IIR_ALPHA);
+		//IIR_B1 = IIR_INPUT_B1 * IIR_ALPHA + buffer[IIR_DEST_B1] * (1.0 - IIR_ALPHA);
+
+		float iir_alpha = coefs.iirAlpha;
+
+		float iir_a0 = iir_input_a0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A0)) * (1.0f - iir_alpha);
+		float iir_a1 = iir_input_a1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A1)) * (1.0f - iir_alpha);
+		float iir_b0 = iir_input_b0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B0)) * (1.0f - iir_alpha);
+		float iir_b1 = iir_input_b1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B1)) * (1.0f - iir_alpha);
+
+		//buffer[IIR_DEST_A0 + 1sample] = IIR_A0;
+		//buffer[IIR_DEST_A1 + 1sample] = IIR_A1;
+		//buffer[IIR_DEST_B0 + 1sample] = IIR_B0;
+		//buffer[IIR_DEST_B1 + 1sample] = IIR_B1;
+
+		SetReverbSample(GetReverbOffset(IIR_DEST_A0) + 2, iir_a0);
+		SetReverbSample(GetReverbOffset(IIR_DEST_A1) + 2, iir_a1);
+		SetReverbSample(GetReverbOffset(IIR_DEST_B0) + 2, iir_b0);
+		SetReverbSample(GetReverbOffset(IIR_DEST_B1) + 2, iir_b1);
+
+		//ACC0 = buffer[ACC_SRC_A0] * ACC_COEF_A +
+		//	   buffer[ACC_SRC_B0] * ACC_COEF_B +
+		//	   buffer[ACC_SRC_C0] * ACC_COEF_C +
+		//	   buffer[ACC_SRC_D0] * ACC_COEF_D;
+		//ACC1 = buffer[ACC_SRC_A1] * ACC_COEF_A +
+		//	   buffer[ACC_SRC_B1] * ACC_COEF_B +
+		//	   buffer[ACC_SRC_C1] * ACC_COEF_C +
+		//	   buffer[ACC_SRC_D1] * ACC_COEF_D;
+
+		float acc_coef_a = coefs.accCoefA;
+		float acc_coef_b = coefs.accCoefB;
+		float acc_coef_c = coefs.accCoefC;
+		float acc_coef_d = coefs.accCoefD;
+
+		float acc0 =
+		    GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * acc_coef_a +
+		    GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * acc_coef_b +
+		    GetReverbSample(GetReverbOffset(ACC_SRC_C0)) * acc_coef_c +
+		    GetReverbSample(GetReverbOffset(ACC_SRC_D0)) * acc_coef_d;
+
+		float acc1 =
+		    GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * acc_coef_a +
+		    GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * acc_coef_b +
+		    GetReverbSample(GetReverbOffset(ACC_SRC_C1)) * acc_coef_c +
+		    GetReverbSample(GetReverbOffset(ACC_SRC_D1)) * acc_coef_d;
+
+		//FB_A0 = buffer[MIX_DEST_A0 - FB_SRC_A];
+		//FB_A1 = buffer[MIX_DEST_A1 - FB_SRC_A];
+		//FB_B0 = buffer[MIX_DEST_B0 - FB_SRC_B];
+		//FB_B1 = buffer[MIX_DEST_B1 - FB_SRC_B];
+
+		float fb_a0 = GetReverbSample(GetReverbOffset(MIX_DEST_A0) - GetReverbOffset(FB_SRC_A));
+		float fb_a1 = GetReverbSample(GetReverbOffset(MIX_DEST_A1) - GetReverbOffset(FB_SRC_A));
+		float fb_b0 = GetReverbSample(GetReverbOffset(MIX_DEST_B0) - GetReverbOffset(FB_SRC_B));
+		float fb_b1 = GetReverbSample(GetReverbOffset(MIX_DEST_B1) - GetReverbOffset(FB_SRC_B));
+
+		//buffer[MIX_DEST_A0] = ACC0 - FB_A0 * FB_ALPHA;
+		//buffer[MIX_DEST_A1] = ACC1 - FB_A1 * FB_ALPHA;
+		//buffer[MIX_DEST_B0] = (FB_ALPHA * ACC0) - FB_A0 * (FB_ALPHA^0x8000) - FB_B0 * FB_X;
+		//buffer[MIX_DEST_B1] = (FB_ALPHA * ACC1) - FB_A1 * (FB_ALPHA^0x8000) - FB_B1 * FB_X;
+
+		float fb_alpha = coefs.fbAlpha;
+		float fb_x = coefs.fbX;
+
+		SetReverbSample(GetReverbOffset(MIX_DEST_A0), acc0 - fb_a0 * fb_alpha);
+		SetReverbSample(GetReverbOffset(MIX_DEST_A1), acc1 - fb_a1 * fb_alpha);
+		SetReverbSample(GetReverbOffset(MIX_DEST_B0), (fb_alpha * acc0) - fb_a0 * -fb_alpha - fb_b0 * fb_x);
+		SetReverbSample(GetReverbOffset(MIX_DEST_B1), (fb_alpha * acc1) - fb_a1 * -fb_alpha - fb_b1 * fb_x);
+
+		m_reverbCurrAddr += 2;
+		if(m_reverbCurrAddr >= m_reverbWorkAddrEnd)
+		{
+			m_reverbCurrAddr = m_reverbWorkAddrStart;
+		}
+	}
+
+	if(m_reverbWorkAddrStart != 0)
+	{
+		float sampleL = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A0)) + GetReverbSample(GetReverbOffset(MIX_DEST_B0)));
+		float sampleR = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A1)) + GetReverbSample(GetReverbOffset(MIX_DEST_B1)));
+
+		{
+			int16* output = outputL;
+			int32 resultSample = static_cast<int32>(sampleL) + static_cast<int32>(*output);
+			resultSample = std::max<int32>(resultSample, SHRT_MIN);
+			resultSample = std::min<int32>(resultSample, SHRT_MAX);
+			*output = static_cast<int16>(resultSample);
+		}
+
+		{
+			int16* output = outputR;
+			int32 resultSample = static_cast<int32>(sampleR) + static_cast<int32>(*output);
+			resultSample = std::max<int32>(resultSample, SHRT_MIN);
+			resultSample = std::min<int32>(resultSample, SHRT_MAX);
+			*output = static_cast<int16>(resultSample);
 		}
-		samples += 2;
 	}
+
+	m_reverbTicks++;
 }
 
 uint32 CSpuBase::GetAdsrDelta(unsigned int index) const
@@ -973,6 +1296,96 @@ void CSpuBase::UpdateAdsr(CHANNEL& channel)
 	channel.adsrVolume = static_cast<uint32>(currentAdsrLevel);
 }
 
+unsigned int CSpuBase::UpdateAdsrBlock(CHANNEL& channel, int32* adsrVolumes, unsigned int tickCount, bool stopWhenStopped)
+{
+	unsigned int tick = 0;
+	while(tick < tickCount)
+	{
+		//Linear phases add the same delta on every tick, evaluate all the ticks that won't end the phase at once
+		int32 delta = 0;
+		uint32 runTickCount = std::min<uint32>(GetAdsrLinearRun(channel, delta), tickCount - tick);
+		if(runTickCount != 0)
+		{
+			int32 currentAdsrLevel = channel.adsrVolume;
+			for(unsigned int i = 0; i < runTickCount; i++)
+			{
+				currentAdsrLevel += delta;
+				adsrVolumes[tick + i] = currentAdsrLevel >> 16;
+			}
+			channel.adsrVolume = static_cast<uint32>(currentAdsrLevel);
+			tick += runTickCount;
+			continue;
+		}
+		UpdateAdsr(channel);
+		adsrVolumes[tick++] = static_cast<int32>(channel.adsrVolume >> 16);
+		if(stopWhenStopped && (channel.status == STOPPED)) break;
+	}
+	return tick;
+}
+
+uint32 CSpuBase::GetAdsrLinearRun(const CHANNEL& channel, int32& delta) const
+{
+	//Returns the amount of ticks the envelope can be moved by a constant delta
+	//without reaching a phase transition or a clamp, 0 if UpdateAdsr needs to be used.
+	int32 currentAdsrLevel = channel.adsrVolume;
+	if(channel.status == STOPPED)
+	{
+		delta = 0;
+		return UINT32_MAX;
+	}
+	if(currentAdsrLevel < 0) return 0;
+	uint32 increment = 0;
+	uint32 decrement = 0;
+	if((channel.status == ATTACK) && (channel.adsrLevel.attackMode == 0))
+	{
+		increment = GetAdsrDelta((channel.adsrLevel.attackRate ^ 0x7F) - 0x10);
+	}
+	else if((channel.status == SUSTAIN) && (channel.adsrRate.sustainMode == 0))
+	{
+		if(channel.adsrRate.sustainDirection == 0)
+		{
+			increment = GetAdsrDelta((channel.adsrRate.sustainRate ^ 0x7F) - 0x10);
+		}
+		else
+		{
+			decrement = GetAdsrDelta((channel.adsrRate.sustainRate ^ 0x7F) - 0x0F);
+		}
+	}
+	else if((channel.status == RELEASE) && (channel.adsrRate.releaseMode == 0))
+	{
+		decrement = GetAdsrDelta((4 * (channel.adsrRate.releaseRate ^ 0x1F)) - 0x0C);
+	}
+	else
+	{
+		return 0;
+	}
+	assert((increment <= MAX_ADSR_VOLUME) && (decrement <= MAX_ADSR_VOLUME));
+	if(channel.status == SUSTAIN)
+	{
+		//Sustain clamps instead of ending, an envelope sitting on its limit stays there
+		bool isAtLimit =
+		    ((increment != 0) && (currentAdsrLevel == MAX_ADSR_VOLUME)) ||
+		    ((decrement != 0) && (currentAdsrLevel == 0));
+		if(isAtLimit)
+		{
+			delta = 0;
+			return UINT32_MAX;
+		}
+	}
+	if(increment != 0)
+	{
+		delta = increment;
+		return (MAX_ADSR_VOLUME - currentAdsrLevel) / increment;
+	}
+	else if(decrement != 0)
+	{
+		delta = -static_cast<int32>(decrement);
+		return currentAdsrLevel / decrement;
+	}
+	delta = 0;
+	return UINT32_MAX;
+}
+
 ///////////////////////////////////////////////////////
 // CSampleReader
 ///////////////////////////////////////////////////////
@@ -1073,15 +1486,20 @@ void CSpuBase::CSampleReader::SetPitch(uint32 baseSamplingRate, uint16 pitch)
 	m_srcSamplingRate = baseSamplingRate * pitch / 4096;
 }
 
-void CSpuBase::CSampleReader::GetSamples(int16* samples, unsigned int sampleCount, unsigned int dstSamplingRate)
+unsigned int CSpuBase::CSampleReader::GetSamples(int16* samples, unsigned int sampleCount, unsigned int dstSamplingRate)
 {
+	uint32 sampleStep = (m_srcSamplingRate * TIME_SCALE) / dstSamplingRate;
+	//Stops after the sample that made the reader reach the end of its data,
+	//the channel needs to be stopped before anything else is read
 	for(unsigned int i = 0; i < sampleCount; i++)
 	{
-		samples[i] = GetSample(dstSamplingRate);
+		samples[i] = GetSample(sampleStep);
+		if(m_done) return i + 1;
 	}
+	return sampleCount;
 }
 
-int16 CSpuBase::CSampleReader::GetSample(unsigned int dstSamplingRate)
+int16 CSpuBase::CSampleReader::GetSample(uint32 sampleStep)
 {
 	uint32 srcSampleIdx = m_srcSampleIdx / TIME_SCALE;
 	int32 srcSampleAlpha = m_srcSampleIdx % TIME_SCALE;
@@ -1089,7 +1507,7 @@ int16 CSpuBase::CSampleReader::GetSample(unsigned int dstSamplingRate)
 	int32 nextSample = m_buffer[srcSampleIdx + 1];
 	int32 resultSample = (currentSample * (TIME_SCALE - srcSampleAlpha) / TIME_SCALE) +
 	                     (nextSample * srcSampleAlpha / TIME_SCALE);
-	m_srcSampleIdx += (m_srcSamplingRate * TIME_SCALE) / dstSamplingRate;
+	m_srcSampleIdx += sampleStep;
 	if(srcSampleIdx >= BUFFER_SAMPLES)
 	{
 		m_srcSampleIdx -= BUFFER_SAMPLES * TIME_SCALE;
@@ -217,6 +217,9 @@ namespace Iop
 
 		void Render(int16*, unsigned int, unsigned int);
 
+		bool IsBlockMixingEnabled() const;
+		void SetBlockMixingEnabled(bool);
+
 		static bool g_reverbParamIsAddress[REVERB_PARAM_COUNT];
 
 	private:
@@ -242,7 +245,7 @@ namespace Iop
 
 			void SetParams(uint32, uint32);
 			void SetPitch(uint32, uint16);
-			void GetSamples(int16*, unsigned int, unsigned int);
+			unsigned int GetSamples(int16*, unsigned int, unsigned int);
 			uint32 GetRepeat() const;
 			void SetRepeat(uint32);
 			uint32 GetCurrent() const;
@@ -265,7 +268,7 @@ namespace Iop
 
 			void UnpackSamples(int16*);
 			void AdvanceBuffer();
-			int16 GetSample(unsigned int);
+			int16 GetSample(uint32);
 
 			uint8* m_ram = nullptr;
 			uint32 m_ramSize = 0;
@@ -312,15 +315,45 @@ namespace Iop
 			MAX_ADSR_VOLUME = 0x7FFFFFFF,
 		};
 
+		enum
+		{
+			RENDER_BLOCK_TICKS = 64,
+		};
+
+		struct REVERB_COEFS
+		{
+			float iirCoef;
+			float inCoefL;
+			float inCoefR;
+			float iirAlpha;
+			float accCoefA;
+			float accCoefB;
+			float accCoefC;
+			float accCoefD;
+			float fbAlpha;
+			float fbX;
+		};
+
+		void RenderTicks(int16*, unsigned int, unsigned int);
+		void RenderBlocks(int16*, unsigned int, unsigned int);
+		void RenderChannelBlock(unsigned int, int16*, int16*, int16*, int16*, unsigned int, unsigned int, bool);
+
 		void UpdateAdsr(CHANNEL&);
+		unsigned int UpdateAdsrBlock(CHANNEL&, int32*, unsigned int, bool);
+		uint32 GetAdsrLinearRun(const CHANNEL&, int32&) const;
 		uint32 GetAdsrDelta(unsigned int) const;
+		REVERB_COEFS GetReverbCoefs() const;
+		void UpdateReverb(const REVERB_COEFS&, int16, int16, int16*, int16*);
 		float GetReverbSample(uint32) const;
 		void SetReverbSample(uint32, float);
 		uint32 GetReverbOffset(unsigned int) const;
 		float GetReverbCoef(unsigned int) const;
 
 		static void MixSamples(int32, int32, int16*);
+		static void MixChannelBlock(const int16*, const int32*, const int32*, const int32*, int16*, int16*, int16*, int16*, unsigned int);
 		int32 ComputeChannelVolume(const CHANNEL_VOLUME&, int32);
+		void ComputeChannelVolumeBlock(const CHANNEL_VOLUME&, int32&, int32*, unsigned int);
+		int32 GetAdjustedVolume(int32) const;
 
 		static const uint32 g_linearIncreaseSweepDeltas[0x80];
 		static const uint32 g_linearDecreaseSweepDeltas[0x80];
@@ -347,6 +380,7 @@ namespace Iop
 		uint32 m_adsrLogTable[160];
 		bool m_reverbEnabled;
 		float m_volumeAdjust;
+		bool m_blockMixingEnabled = true;
 
 		CBlockSampleReader m_blockReader;
 		uint32 m_soundInputDataAddr = 0;
@@ -0,0 +1,198 @@
+#include <cassert>
+#include <climits>
+#include <algorithm>
+#include "Iop_SpuRenderThread.h"
+
+using namespace Iop;
+
+CSpuRenderThread::CSpuRenderThread(CSpuBase& spuCore0, CSpuBase& spuCore1, const WriteRegisterFunction& writeRegister)
+    : m_spuCore0(spuCore0)
+    , m_spuCore1(spuCore1)
+    , m_writeRegister(writeRegister)
+{
+}
+
+CSpuRenderThread::~CSpuRenderThread()
+{
+	StopThread();
+}
+
+bool CSpuRenderThread::IsThreaded() const
+{
+	return m_threaded;
+}
+
+void CSpuRenderThread::SetThreaded(bool threaded)
+{
+#ifdef DEBUGGER_INCLUDED
+	//Debugger views read the SPU state at any time
+	threaded = false;
+#endif
+
+	if(threaded == m_threaded) return;
+
+	Sync();
+	m_threaded = threaded;
+	if(m_threaded)
+	{
+		StartThread();
+	}
+	else
+	{
+		StopThread();
+	}
+}
+
+bool CSpuRenderThread::IsRendering() const
+{
+	return m_rendering;
+}
+
+bool CSpuRenderThread::GetIrqPending()
+{
+	if(!m_rendering)
+	{
+		m_irqPending = m_spuCore0.GetIrqPending() || m_spuCore1.GetIrqPending();
+	}
+	return m_irqPending;
+}
+
+void CSpuRenderThread::Render(int16* samples, unsigned int sampleCount, unsigned int sampleRate)
+{
+	if(!m_threaded)
+	{
+		RenderCores(samples, sampleCount, sampleRate);
+		return;
+	}
+
+	Sync();
+	//Keeps the state the IOP sees while the block renders
+	GetIrqPending();
+
+	{
+		std::lock_guard<std::mutex> threadLock(m_threadMutex);
+		m_renderSamples = samples;
+		m_renderSampleCount = sampleCount;
+		m_renderSampleRate = sampleRate;
+		m_threadBusy = true;
+		m_threadStartPending = true;
+		m_threadCondition.notify_one();
+	}
+	m_rendering = true;
+}
+
+void CSpuRenderThread::Sync()
+{
+	if(!m_rendering) return;
+	WaitForThread();
+	m_rendering = false;
+	//Writes that came in after the render thread was done with the queue
+	ApplyEvents();
+}
+
+void CSpuRenderThread::WriteRegister(uint32 address, uint32 value)
+{
+	if(m_rendering)
+	{
+		if(PushEvent(address, value)) return;
+		//Queue is full, wait for the render to complete
+		Sync();
+	}
+	m_writeRegister(address, value);
+}
+
+void CSpuRenderThread::RenderCores(int16* samples, unsigned int sampleCount, unsigned int sampleRate)
+{
+	m_spuCore0.Render(samples, sampleCount, sampleRate);
+
+	if(m_spuCore1.IsEnabled())
+	{
+		m_samplesSpu1.resize(sampleCount);
+		int16* samplesSpu1 = m_samplesSpu1.data();
+		m_spuCore1.Render(samplesSpu1, sampleCount, sampleRate);
+
+		for(unsigned int i = 0; i < sampleCount; i++)
+		{
+			int32 resultSample = static_cast<int32>(samples[i]) + static_cast<int32>(samplesSpu1[i]);
+			resultSample = std::max<int32>(resultSample, SHRT_MIN);
+			resultSample = std::min<int32>(resultSample, SHRT_MAX);
+			samples[i] = static_cast<int16>(resultSample);
+		}
+	}
+}
+
+bool CSpuRenderThread::PushEvent(uint32 address, uint32 value)
+{
+	uint32 writeIndex = m_eventWriteIndex.load(std::memory_order_relaxed);
+	uint32 readIndex = m_eventReadIndex.load(std::memory_order_acquire);
+	if((writeIndex - readIndex) == EVENT_QUEUE_SIZE)
+	{
+		return false;
+	}
+	auto& event = m_events[writeIndex % EVENT_QUEUE_SIZE];
+	event.address = address;
+	event.value = value;
+	m_eventWriteIndex.store(writeIndex + 1, std::memory_order_release);
+	return true;
+}
+
+void CSpuRenderThread::ApplyEvents()
+{
+	uint32 readIndex = m_eventReadIndex.load(std::memory_order_relaxed);
+	while(readIndex != m_eventWriteIndex.load(std::memory_order_acquire))
+	{
+		const auto& event = m_events[readIndex % EVENT_QUEUE_SIZE];
+		m_writeRegister(event.address, event.value);
+		readIndex++;
+		m_eventReadIndex.store(readIndex, std::memory_order_release);
+	}
+}
+
+void CSpuRenderThread::StartThread()
+{
+	assert(!m_thread.joinable());
+	m_threadDone = false;
+	m_thread = std::thread([this]() { ThreadProc(); });
+}
+
+void CSpuRenderThread::StopThread()
+{
+	if(!m_thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> threadLock(m_threadMutex);
+		m_threadDone = true;
+		m_threadCondition.notify_one();
+	}
+	m_thread.join();
+	m_threadStartPending = false;
+	m_threadBusy = false;
+}
+
+void CSpuRenderThread::WaitForThread()
+{
+	std::unique_lock<std::mutex> threadLock(m_threadMutex);
+	m_threadIdleCondition.wait(threadLock, [this]() { return !m_threadBusy; });
+}
+
+void CSpuRenderThread::ThreadProc()
+{
+	std::unique_lock<std::mutex> threadLock(m_threadMutex);
+	while(1)
+	{
+		m_threadCondition.wait(threadLock, [this]() { return m_threadStartPending || m_threadDone; });
+		if(m_threadStartPending)
+		{
+			m_threadStartPending = false;
+			threadLock.unlock();
+
+			RenderCores(m_renderSamples, m_renderSampleCount, m_renderSampleRate);
+			//Apply the writes queued so far here to take that work off the IOP thread
+			ApplyEvents();
+
+			threadLock.lock();
+			m_threadBusy = false;
+			m_threadIdleCondition.notify_all();
+		}
+		if(m_threadDone) break;
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Types.h"
+#include "Iop_SpuBase.h"
+
+namespace Iop
+{
+	//Renders both SPU cores on a dedicated thread.
+	//While a block is rendering, the SPU state belongs to the render thread. Register writes made by the IOP
+	//in the meantime are queued and applied once the block is done, which is what would happen between two
+	//synchronous renders. Anything else that touches the SPU state (register reads, DMA, save states) must call
+	//Sync first. IRQs raised by a block only become visible to the IOP once it has been synced, until then
+	//GetIrqPending keeps returning the state latched the last time the SPU state belonged to the IOP thread.
+	class CSpuRenderThread
+	{
+	public:
+		typedef std::function<void(uint32, uint32)> WriteRegisterFunction;
+
+		CSpuRenderThread(CSpuBase&, CSpuBase&, const WriteRegisterFunction&);
+		virtual ~CSpuRenderThread();
+
+		bool IsThreaded() const;
+		void SetThreaded(bool);
+
+		bool IsRendering() const;
+		bool GetIrqPending();
+
+		void Render(int16*, unsigned int, unsigned int);
+		void Sync();
+
+		void WriteRegister(uint32, uint32);
+
+	private:
+		enum
+		{
+			EVENT_QUEUE_SIZE = 0x1000,
+		};
+
+		struct REGISTER_EVENT
+		{
+			uint32 address;
+			uint32 value;
+		};
+
+		void RenderCores(int16*, unsigned int, unsigned int);
+
+		bool PushEvent(uint32, uint32);
+		void ApplyEvents();
+
+		void StartThread();
+		void StopThread();
+		void WaitForThread();
+		void ThreadProc();
+
+		CSpuBase& m_spuCore0;
+		CSpuBase& m_spuCore1;
+		WriteRegisterFunction m_writeRegister;
+		std::vector<int16> m_samplesSpu1;
+
+		//m_rendering is only used by the IOP thread, it stays set until the render is synced
+		bool m_threaded = false;
+		bool m_rendering = false;
+		bool m_irqPending = false;
+
+		std::thread m_thread;
+		std::mutex m_threadMutex;
+		std::condition_variable m_threadCondition;
+		std::condition_variable m_threadIdleCondition;
+		bool m_threadStartPending = false;
+		bool m_threadDone = false;
+		bool m_threadBusy = false;
+
+		int16* m_renderSamples = nullptr;
+		unsigned int m_renderSampleCount = 0;
+		unsigned int m_renderSampleRate = 0;
+
+		//Single producer (IOP thread), single consumer queue. The consumer is the render thread when it
+		//completes a block and the IOP thread once it has synced, never both at the same time.
+		REGISTER_EVENT m_events[EVENT_QUEUE_SIZE];
+		std::atomic<uint32> m_eventWriteIndex = {0};
+		std::atomic<uint32> m_eventReadIndex = {0};
+	};
+}
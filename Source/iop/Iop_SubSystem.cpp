@@ -28,6 +28,7 @@ CSubSystem::CSubSystem(bool ps2Mode)
     , m_spuCore1(m_spuRam, SPU_RAM_SIZE, 1)
     , m_spu(m_spuCore0)
     , m_spu2(m_spuCore0, m_spuCore1)
+    , m_spuRenderThread(m_spuCore0, m_spuCore1, std::bind(&CSubSystem::WriteSpuRegister, this, std::placeholders::_1, std::placeholders::_2))
 #ifdef _IOP_EMULATE_MODULES
     , m_sio2(m_intc)
 #endif
@@ -72,8 +73,8 @@ CSubSystem::CSubSystem(bool ps2Mode)
 	m_cpu.m_pCOP[0] = &m_copScu;
 	m_cpu.m_pAddrTranslator = &CMIPS::TranslateAddress64;
 
-	m_dmac.SetReceiveFunction(CDmac::CHANNEL_SPU0, std::bind(&CSpuBase::ReceiveDma, &m_spuCore0, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
-	m_dmac.SetReceiveFunction(CDmac::CHANNEL_SPU1, std::bind(&CSpuBase::ReceiveDma, &m_spuCore1, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
+	m_dmac.SetReceiveFunction(CDmac::CHANNEL_SPU0, std::bind(&CSubSystem::ReceiveSpuDma, this, std::ref(m_spuCore0), PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
+	m_dmac.SetReceiveFunction(CDmac::CHANNEL_SPU1, std::bind(&CSubSystem::ReceiveSpuDma, this, std::ref(m_spuCore1), PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
 	m_dmac.SetReceiveFunction(CDmac::CHANNEL_SIO2in, std::bind(&CSio2::ReceiveDmaIn, &m_sio2, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
 	m_dmac.SetReceiveFunction(CDmac::CHANNEL_SIO2out, std::bind(&CSio2::ReceiveDmaOut, &m_sio2, PLACEHOLDER_1, PLACEHOLDER_2, PLACEHOLDER_3));
 
@@ -82,6 +83,7 @@ CSubSystem::CSubSystem(bool ps2Mode)
 
 CSubSystem::~CSubSystem()
 {
+	m_spuRenderThread.SetThreaded(false);
 	m_bios.reset();
 	delete[] m_ram;
 	delete[] m_scratchPad;
@@ -100,12 +102,16 @@ void CSubSystem::NotifyVBlankEnd()
 	m_intc.AssertLine(Iop::CIntc::LINE_EVBLANK);
 }
 
-void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
+void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive, bool includeRam)
 {
+	m_spuRenderThread.Sync();
 	archive.InsertFile(new CMemoryStateFile(STATE_CPU, &m_cpu.m_State, sizeof(MIPSSTATE)));
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_ram, IOP_RAM_SIZE));
 	archive.InsertFile(new CMemoryStateFile(STATE_SCRATCH, m_scratchPad, IOP_SCRATCH_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_SPURAM, m_spuRam, SPU_RAM_SIZE));
+	if(includeRam)
+	{
+		archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_ram, IOP_RAM_SIZE));
+		archive.InsertFile(new CMemoryStateFile(STATE_SPURAM, m_spuRam, SPU_RAM_SIZE));
+	}
 	m_intc.SaveState(archive);
 	m_dmac.SaveState(archive);
 	m_counters.SaveState(archive);
@@ -117,12 +123,16 @@ void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 	m_bios->SaveState(archive);
 }
 
-void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
+void CSubSystem::LoadState(Framework::CZipArchiveReader& archive, bool includeRam)
 {
+	m_spuRenderThread.Sync();
 	archive.BeginReadFile(STATE_CPU)->Read(&m_cpu.m_State, sizeof(MIPSSTATE));
-	archive.BeginReadFile(STATE_RAM)->Read(m_ram, IOP_RAM_SIZE);
 	archive.BeginReadFile(STATE_SCRATCH)->Read(m_scratchPad, IOP_SCRATCH_SIZE);
-	archive.BeginReadFile(STATE_SPURAM)->Read(m_spuRam, SPU_RAM_SIZE);
+	if(includeRam)
+	{
+		archive.BeginReadFile(STATE_RAM)->Read(m_ram, IOP_RAM_SIZE);
+		archive.BeginReadFile(STATE_SPURAM)->Read(m_spuRam, SPU_RAM_SIZE);
+	}
 	m_intc.LoadState(archive);
 	m_dmac.LoadState(archive);
 	m_counters.LoadState(archive);
@@ -136,6 +146,7 @@ void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
 
 void CSubSystem::Reset()
 {
+	m_spuRenderThread.Sync();
 	memset(m_ram, 0, IOP_RAM_SIZE);
 	memset(m_scratchPad, 0, IOP_SCRATCH_SIZE);
 	memset(m_spuRam, 0, SPU_RAM_SIZE);
@@ -182,6 +193,7 @@ uint32 CSubSystem::ReadIoRegister(uint32 address)
 	}
 	else if(address >= CSpu::SPU_BEGIN && address <= CSpu::SPU_END)
 	{
+		m_spuRenderThread.Sync();
 		return m_spu.ReadRegister(address);
 	}
 	else if(address >= CDmac::DMAC_ZONE1_START && address <= CDmac::DMAC_ZONE1_END)
@@ -210,6 +222,7 @@ uint32 CSubSystem::ReadIoRegister(uint32 address)
 #endif
 	else if(address >= CSpu2::REGS_BEGIN && address <= CSpu2::REGS_END)
 	{
+		m_spuRenderThread.Sync();
 		return m_spu2.ReadRegister(address);
 	}
 	else if(address >= 0x1F808400 && address <= 0x1F808500)
@@ -232,7 +245,7 @@ uint32 CSubSystem::WriteIoRegister(uint32 address, uint32 value)
 	}
 	else if(address >= CSpu::SPU_BEGIN && address <= CSpu::SPU_END)
 	{
-		m_spu.WriteRegister(address, static_cast<uint16>(value));
+		m_spuRenderThread.WriteRegister(address, value);
 	}
 	else if(address >= CDmac::DMAC_ZONE2_START && address <= CDmac::DMAC_ZONE2_END)
 	{
@@ -256,7 +269,8 @@ uint32 CSubSystem::WriteIoRegister(uint32 address, uint32 value)
 #endif
 	else if(address >= CSpu2::REGS_BEGIN && address <= CSpu2::REGS_END)
 	{
-		return m_spu2.WriteRegister(address, value);
+		m_spuRenderThread.WriteRegister(address, value);
+		return 0;
 	}
 	else
 	{
@@ -274,6 +288,25 @@ uint32 CSubSystem::WriteIoRegister(uint32 address, uint32 value)
 	return 0;
 }
 
+void CSubSystem::WriteSpuRegister(uint32 address, uint32 value)
+{
+	if(address >= CSpu::SPU_BEGIN && address <= CSpu::SPU_END)
+	{
+		m_spu.WriteRegister(address, static_cast<uint16>(value));
+	}
+	else
+	{
+		assert(address >= CSpu2::REGS_BEGIN && address <= CSpu2::REGS_END);
+		m_spu2.WriteRegister(address, value);
+	}
+}
+
+uint32 CSubSystem::ReceiveSpuDma(CSpuBase& spuCore, uint8* buffer, uint32 blockSize, uint32 blockAmount)
+{
+	m_spuRenderThread.Sync();
+	return spuCore.ReceiveDma(buffer, blockSize, blockAmount);
+}
+
 void CSubSystem::CheckPendingInterrupts()
 {
 	if(!m_cpu.m_State.nHasException)
@@ -302,18 +335,14 @@ void CSubSystem::CountTicks(int ticks)
 		m_dmac.ResumeDma(8);
 		m_dmaUpdateTicks -= g_dmaUpdateDelay;
 	}
+	//State is latched while a block renders on the SPU thread, IRQs it raises show up once it's synced
+	if(m_spuRenderThread.GetIrqPending())
 	{
-		bool irqPending = false;
-		irqPending |= m_spuCore0.GetIrqPending();
-		irqPending |= m_spuCore1.GetIrqPending();
-		if(irqPending)
-		{
-			m_intc.AssertLine(CIntc::LINE_SPU2);
-		}
-		else
-		{
-			m_intc.ClearLine(CIntc::LINE_SPU2);
-		}
+		m_intc.AssertLine(CIntc::LINE_SPU2);
+	}
+	else
+	{
+		m_intc.ClearLine(CIntc::LINE_SPU2);
 	}
 }
 
@@ -6,6 +6,7 @@
 #include "Iop_SpuBase.h"
 #include "Iop_Spu.h"
 #include "Iop_Spu2.h"
+#include "Iop_SpuRenderThread.h"
 #include "Iop_Sio2.h"
 #include "Iop_Dmac.h"
 #include "Iop_Intc.h"
@@ -30,8 +31,9 @@ namespace Iop
 		void NotifyVBlankStart();
 		void NotifyVBlankEnd();
 
-		void SaveState(Framework::CZipArchiveWriter&);
-		void LoadState(Framework::CZipArchiveReader&);
+		//RAM and SPU RAM can be left out for it to be saved and restored separately (ie.: rewind snapshots)
+		void SaveState(Framework::CZipArchiveWriter&, bool = true);
+		void LoadState(Framework::CZipArchiveReader&, bool = true);
 
 		uint8* m_ram;
 		uint8* m_scratchPad;
@@ -43,6 +45,7 @@ namespace Iop
 		CSpuBase m_spuCore1;
 		CSpu m_spu;
 		CSpu2 m_spu2;
+		CSpuRenderThread m_spuRenderThread;
 #ifdef _IOP_EMULATE_MODULES
 		CSio2 m_sio2;
 #endif
@@ -62,6 +65,8 @@ namespace Iop
 
 		uint32 ReadIoRegister(uint32);
 		uint32 WriteIoRegister(uint32, uint32);
+		void WriteSpuRegister(uint32, uint32);
+		uint32 ReceiveSpuDma(CSpuBase&, uint8*, uint32, uint32);
 
 		void CheckPendingInterrupts();
 
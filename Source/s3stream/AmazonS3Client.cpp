@@ -132,10 +132,11 @@ std::string timeToString(const tm* timeInfo)
 	return std::string(output);
 }
 
-CAmazonS3Client::CAmazonS3Client(std::string accessKeyId, std::string secretAccessKey, std::string region)
+CAmazonS3Client::CAmazonS3Client(std::string accessKeyId, std::string secretAccessKey, std::string region, std::string endpoint)
     : m_accessKeyId(std::move(accessKeyId))
     , m_secretAccessKey(std::move(secretAccessKey))
     , m_region(std::move(region))
+    , m_endpoint(std::move(endpoint))
 {
 }
 
@@ -143,6 +144,7 @@ GetBucketLocationResult CAmazonS3Client::GetBucketLocation(const GetBucketLocati
 {
 	Request rq;
 	rq.method = Framework::Http::HTTP_VERB::GET;
+	rq.bucket = request.bucket;
 	rq.host = string_format("%s." S3_HOSTNAME, request.bucket.c_str());
 	rq.urlHost = S3_HOSTNAME;
 	rq.uri = "/";
@@ -171,6 +173,7 @@ GetObjectResult CAmazonS3Client::GetObject(const GetObjectRequest& request)
 {
 	Request rq;
 	rq.method = Framework::Http::HTTP_VERB::GET;
+	rq.bucket = request.bucket;
 	rq.uri = "/" + Framework::Http::CHttpClient::UrlEncode(request.object);
 	rq.host = string_format("%s.s3-%s.amazonaws.com", request.bucket.c_str(), m_region.c_str());
 	rq.urlHost = rq.host;
@@ -200,6 +203,7 @@ HeadObjectResult CAmazonS3Client::HeadObject(const HeadObjectRequest& request)
 {
 	Request rq;
 	rq.method = Framework::Http::HTTP_VERB::HEAD;
+	rq.bucket = request.bucket;
 	rq.uri = "/" + Framework::Http::CHttpClient::UrlEncode(request.object);
 	rq.host = string_format("%s.s3-%s.amazonaws.com", request.bucket.c_str(), m_region.c_str());
 	rq.urlHost = rq.host;
@@ -232,6 +236,7 @@ ListObjectsResult CAmazonS3Client::ListObjects(std::string bucket)
 {
 	Request rq;
 	rq.method = Framework::Http::HTTP_VERB::GET;
+	rq.bucket = bucket;
 	rq.uri = "/";
 	rq.host = string_format("%s.s3-%s.amazonaws.com", bucket.c_str(), m_region.c_str());
 	rq.urlHost = rq.host;
@@ -266,11 +271,29 @@ Framework::Http::RequestResult CAmazonS3Client::ExecuteRequest(const Request& re
 	assert(!request.host.empty());
 	assert(!request.urlHost.empty());
 
+	auto host = request.host;
+	auto uri = request.uri;
+	auto url = string_format("https://%s%s", request.urlHost.c_str(), request.uri.c_str());
+	if(!m_endpoint.empty())
+	{
+		//Path style request, bucket is part of the URI
+		auto schemePos = m_endpoint.find("://");
+		host = (schemePos == std::string::npos) ? m_endpoint : m_endpoint.substr(schemePos + 3);
+		uri = "/" + request.bucket + request.uri;
+		url = m_endpoint + uri;
+	}
+
+	//Requests can be made from many threads at once, can't use gmtime's shared buffer
 	time_t rawTime;
 	time(&rawTime);
-	auto timeInfo = gmtime(&rawTime);
+	tm timeInfo = {};
+#ifdef _WIN32
+	gmtime_s(&timeInfo, &rawTime);
+#else
+	gmtime_r(&rawTime, &timeInfo);
+#endif
 
-	auto date = string_format("%04d%02d%02d", timeInfo->tm_year + 1900, timeInfo->tm_mon + 1, timeInfo->tm_mday);
+	auto date = string_format("%04d%02d%02d", timeInfo.tm_year + 1900, timeInfo.tm_mon + 1, timeInfo.tm_mday);
 	auto service = std::string("s3");
 	auto requestType = std::string("aws4_request");
 
@@ -278,14 +301,14 @@ Framework::Http::RequestResult CAmazonS3Client::ExecuteRequest(const Request& re
 	auto contentHashString = hashToString(Framework::HashUtils::ComputeSha256(content.data(), content.size()));
 
 	auto scope = string_format("%s/%s/%s/%s", date.c_str(), m_region.c_str(), service.c_str(), requestType.c_str());
-	auto timestamp = timeToString(timeInfo);
+	auto timestamp = timeToString(&timeInfo);
 
 	Framework::Http::HeaderMap headers;
-	headers.insert(std::make_pair("Host", request.host));
+	headers.insert(std::make_pair("Host", host));
 	headers.insert(std::make_pair("x-amz-content-sha256", contentHashString));
 	headers.insert(std::make_pair("x-amz-date", timestamp));
 
-	auto canonicalRequest = buildCanonicalRequest(request.method, request.uri, request.query, contentHashString, headers);
+	auto canonicalRequest = buildCanonicalRequest(request.method, uri, request.query, contentHashString, headers);
 #ifdef DEBUG_REQUEST
 	printf("canonicalRequest:\n%s\n\n", canonicalRequest.c_str());
 #endif
@@ -303,7 +326,6 @@ Framework::Http::RequestResult CAmazonS3Client::ExecuteRequest(const Request& re
 	headers.insert(std::make_pair("Authorization", authorizationString));
 	headers.insert(request.headers.begin(), request.headers.end());
 
-	auto url = string_format("https://%s%s", request.urlHost.c_str(), request.uri.c_str());
 	if(!request.query.empty())
 	{
 		url += "?";
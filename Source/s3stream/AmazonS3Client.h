@@ -51,7 +51,8 @@ struct ListObjectsResult
 class CAmazonS3Client
 {
 public:
-	CAmazonS3Client(std::string, std::string, std::string = "us-east-1");
+	//Endpoint is an S3 compatible server to use instead of AWS (ex.: "http://localhost:9000"), requests are path style then
+	CAmazonS3Client(std::string, std::string, std::string = "us-east-1", std::string = std::string());
 
 	GetBucketLocationResult GetBucketLocation(const GetBucketLocationRequest&);
 	GetObjectResult GetObject(const GetObjectRequest&);
@@ -62,6 +63,7 @@ private:
 	struct Request
 	{
 		Framework::Http::HTTP_VERB method;
+		std::string bucket;
 		std::string host;
 		std::string urlHost;
 		std::string uri;
@@ -74,4 +76,5 @@ private:
 	std::string m_accessKeyId;
 	std::string m_secretAccessKey;
 	std::string m_region;
+	std::string m_endpoint;
 };
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <vector>
+#include "S3ChunkCache.h"
+#include "PathUtils.h"
+#include "StdStreamUtils.h"
+#include "Log.h"
+
+#define LOG_NAME "s3chunkcache"
+
+#define INDEX_FILENAME "index.dat"
+#define INDEX_MAGIC 0x49433353 //'S3CI'
+#define INDEX_VERSION 1
+//Index is saved every few writes so that not everything is lost if we don't get to exit cleanly
+#define INDEX_SAVE_INTERVAL 32
+
+CS3ChunkCache::CS3ChunkCache(fs::path path, uint64 maxSize)
+    : m_path(std::move(path))
+    , m_maxSize(maxSize)
+{
+	Framework::PathUtils::EnsurePathExists(m_path);
+	LoadIndex();
+	RemoveStrayFiles();
+	Evict();
+}
+
+CS3ChunkCache::~CS3ChunkCache()
+{
+	SaveIndex();
+}
+
+std::shared_ptr<CS3ChunkCache> CS3ChunkCache::GetShared(const fs::path& path, uint64 maxSize)
+{
+	static std::mutex sharedCachesMutex;
+	static std::map<fs::path, std::weak_ptr<CS3ChunkCache>> sharedCaches;
+
+	std::lock_guard<std::mutex> sharedCachesLock(sharedCachesMutex);
+	auto cache = sharedCaches[path].lock();
+	if(!cache)
+	{
+		cache = std::make_shared<CS3ChunkCache>(path, maxSize);
+		sharedCaches[path] = cache;
+	}
+	return cache;
+}
+
+bool CS3ChunkCache::Read(const std::string& key, uint8* dest, uint64 size)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto entryIterator = m_entries.find(key);
+		if(entryIterator == std::end(m_entries)) return false;
+		if(entryIterator->second.size != size) return false;
+		entryIterator->second.lastUse = ++m_useCounter;
+	}
+
+	try
+	{
+		auto stream = Framework::CreateInputStdStream((m_path / key).native());
+		if(stream.Read(dest, size) == size)
+		{
+			return true;
+		}
+		CLog::GetInstance().Warn(LOG_NAME, "Chunk '%s' is truncated.\r\n", key.c_str());
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to read chunk '%s': %s\r\n", key.c_str(), exception.what());
+	}
+
+	//Forget about it, it will be fetched and written again
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto entryIterator = m_entries.find(key);
+	if(entryIterator != std::end(m_entries))
+	{
+		RemoveEntry(entryIterator);
+	}
+	return false;
+}
+
+void CS3ChunkCache::Write(const std::string& key, const uint8* data, uint64 size)
+{
+	if(size > m_maxSize) return;
+
+	//Write to a temporary file first to never leave a partial chunk behind
+	auto chunkPath = m_path / key;
+	auto tempChunkPath = chunkPath;
+	tempChunkPath += ".tmp";
+	try
+	{
+		auto stream = Framework::CreateOutputStdStream(tempChunkPath.native());
+		if(stream.Write(data, size) != size)
+		{
+			throw std::runtime_error("Failed to write chunk data.");
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to write chunk '%s': %s\r\n", key.c_str(), exception.what());
+		std::error_code errorCode;
+		fs::remove(tempChunkPath, errorCode);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::error_code errorCode;
+	fs::rename(tempChunkPath, chunkPath, errorCode);
+	if(errorCode)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to write chunk '%s': %s\r\n", key.c_str(), errorCode.message().c_str());
+		fs::remove(tempChunkPath, errorCode);
+		return;
+	}
+
+	auto& entry = m_entries[key];
+	m_totalSize -= entry.size;
+	m_totalSize += size;
+	entry.size = size;
+	entry.lastUse = ++m_useCounter;
+	Evict();
+
+	m_unsavedWriteCount++;
+	if(m_unsavedWriteCount == INDEX_SAVE_INTERVAL)
+	{
+		SaveIndex();
+	}
+}
+
+uint64 CS3ChunkCache::GetTotalSize()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_totalSize;
+}
+
+void CS3ChunkCache::LoadIndex()
+{
+	auto indexPath = m_path / INDEX_FILENAME;
+	std::error_code errorCode;
+	if(!fs::exists(indexPath, errorCode)) return;
+
+	try
+	{
+		auto stream = Framework::CreateInputStdStream(indexPath.native());
+		if(stream.Read32() != INDEX_MAGIC) throw std::runtime_error("Invalid index.");
+		if(stream.Read32() != INDEX_VERSION) throw std::runtime_error("Unsupported index version.");
+		m_useCounter = stream.Read64();
+		uint32 entryCount = stream.Read32();
+		for(uint32 i = 0; i < entryCount; i++)
+		{
+			uint32 keySize = stream.Read32();
+			auto key = stream.ReadString(keySize);
+			ENTRY entry;
+			entry.size = stream.Read64();
+			entry.lastUse = stream.Read64();
+			if(stream.IsEOF()) throw std::runtime_error("Index is truncated.");
+			m_entries[key] = entry;
+			m_totalSize += entry.size;
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		//Start from scratch, files that were in there will be removed
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to load index: %s\r\n", exception.what());
+		m_entries.clear();
+		m_totalSize = 0;
+		m_useCounter = 0;
+	}
+}
+
+void CS3ChunkCache::SaveIndex()
+{
+	//Must be called with m_mutex held (or from the destructor)
+	auto indexPath = m_path / INDEX_FILENAME;
+	auto tempIndexPath = indexPath;
+	tempIndexPath += ".tmp";
+	try
+	{
+		{
+			auto stream = Framework::CreateOutputStdStream(tempIndexPath.native());
+			stream.Write32(INDEX_MAGIC);
+			stream.Write32(INDEX_VERSION);
+			stream.Write64(m_useCounter);
+			stream.Write32(static_cast<uint32>(m_entries.size()));
+			for(const auto& entryPair : m_entries)
+			{
+				stream.Write32(static_cast<uint32>(entryPair.first.size()));
+				stream.Write(entryPair.first.data(), entryPair.first.size());
+				stream.Write64(entryPair.second.size);
+				stream.Write64(entryPair.second.lastUse);
+			}
+		}
+		fs::rename(tempIndexPath, indexPath);
+		m_unsavedWriteCount = 0;
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to save index: %s\r\n", exception.what());
+	}
+}
+
+void CS3ChunkCache::RemoveStrayFiles()
+{
+	//Files that aren't in the index (leftovers from a crash or from older versions) are removed,
+	//entries for files that went away are forgotten
+	std::error_code errorCode;
+	std::vector<fs::path> strayPaths;
+	for(auto pathIterator = fs::directory_iterator(m_path, errorCode);
+	    pathIterator != fs::directory_iterator(); pathIterator.increment(errorCode))
+	{
+		if(errorCode) break;
+		auto fileName = pathIterator->path().filename().string();
+		if(fileName == INDEX_FILENAME) continue;
+		if(m_entries.find(fileName) == std::end(m_entries))
+		{
+			strayPaths.push_back(pathIterator->path());
+		}
+	}
+	for(const auto& strayPath : strayPaths)
+	{
+		fs::remove(strayPath, errorCode);
+	}
+
+	for(auto entryIterator = std::begin(m_entries); entryIterator != std::end(m_entries);)
+	{
+		if(fs::exists(m_path / entryIterator->first, errorCode))
+		{
+			entryIterator++;
+			continue;
+		}
+		m_totalSize -= entryIterator->second.size;
+		entryIterator = m_entries.erase(entryIterator);
+	}
+}
+
+void CS3ChunkCache::Evict()
+{
+	//Must be called with m_mutex held
+	while((m_totalSize > m_maxSize) && !m_entries.empty())
+	{
+		auto oldestIterator = std::min_element(std::begin(m_entries), std::end(m_entries),
+		                                       [](const EntryMap::value_type& lhs, const EntryMap::value_type& rhs) { return lhs.second.lastUse < rhs.second.lastUse; });
+		RemoveEntry(oldestIterator);
+	}
+}
+
+void CS3ChunkCache::RemoveEntry(EntryMap::iterator entryIterator)
+{
+	//Must be called with m_mutex held
+	std::error_code errorCode;
+	fs::remove(m_path / entryIterator->first, errorCode);
+	assert(m_totalSize >= entryIterator->second.size);
+	m_totalSize -= entryIterator->second.size;
+	m_entries.erase(entryIterator);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "Types.h"
+#include "filesystem_def.h"
+
+//On-disk store for object chunks, one file per chunk with an index keeping track of their size and use
+//Least recently used chunks are removed when the store grows past its maximum size
+class CS3ChunkCache
+{
+public:
+	CS3ChunkCache(fs::path, uint64 maxSize);
+	~CS3ChunkCache();
+
+	CS3ChunkCache(const CS3ChunkCache&) = delete;
+	CS3ChunkCache& operator=(const CS3ChunkCache&) = delete;
+
+	//Streams using the same directory need to share the same store
+	static std::shared_ptr<CS3ChunkCache> GetShared(const fs::path&, uint64 maxSize);
+
+	bool Read(const std::string& key, uint8* dest, uint64 size);
+	void Write(const std::string& key, const uint8* data, uint64 size);
+
+	uint64 GetTotalSize();
+
+private:
+	struct ENTRY
+	{
+		uint64 size = 0;
+		uint64 lastUse = 0;
+	};
+	typedef std::unordered_map<std::string, ENTRY> EntryMap;
+
+	void LoadIndex();
+	void SaveIndex();
+	void RemoveStrayFiles();
+	void Evict();
+	void RemoveEntry(EntryMap::iterator);
+
+	fs::path m_path;
+	uint64 m_maxSize = 0;
+
+	std::mutex m_mutex;
+	EntryMap m_entries;
+	uint64 m_totalSize = 0;
+	uint64 m_useCounter = 0;
+	uint32 m_unsavedWriteCount = 0;
+};
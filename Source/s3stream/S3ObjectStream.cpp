@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include "S3ObjectStream.h"
@@ -6,21 +7,25 @@
 #include "AppConfig.h"
 #include "PathUtils.h"
 #include "string_format.h"
-#include "StdStreamUtils.h"
 #include "Log.h"
 
 #define PREF_S3_OBJECTSTREAM_ACCESSKEYID "s3.objectstream.accesskeyid"
 #define PREF_S3_OBJECTSTREAM_SECRETACCESSKEY "s3.objectstream.secretaccesskey"
+#define PREF_S3_OBJECTSTREAM_ENDPOINT "s3.objectstream.endpoint"
+#define PREF_S3_OBJECTSTREAM_CACHESIZE "s3.objectstream.cachesize"
 #define CACHE_PATH "Play Data Files/s3objectstream_cache"
 
 #define LOG_NAME "s3objectstream"
 
-#define BUFFERSIZE 0x40000
+//In megabytes
+#define DEFAULT_CACHE_SIZE 1024
 
 CS3ObjectStream::CConfig::CConfig()
 {
 	CAppConfig::GetInstance().RegisterPreferenceString(PREF_S3_OBJECTSTREAM_ACCESSKEYID, "");
 	CAppConfig::GetInstance().RegisterPreferenceString(PREF_S3_OBJECTSTREAM_SECRETACCESSKEY, "");
+	CAppConfig::GetInstance().RegisterPreferenceString(PREF_S3_OBJECTSTREAM_ENDPOINT, "");
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_S3_OBJECTSTREAM_CACHESIZE, DEFAULT_CACHE_SIZE);
 }
 
 std::string CS3ObjectStream::CConfig::GetAccessKeyId()
@@ -33,45 +38,88 @@ std::string CS3ObjectStream::CConfig::GetSecretAccessKey()
 	return CAppConfig::GetInstance().GetPreferenceString(PREF_S3_OBJECTSTREAM_SECRETACCESSKEY);
 }
 
+std::string CS3ObjectStream::CConfig::GetEndpoint()
+{
+	return CAppConfig::GetInstance().GetPreferenceString(PREF_S3_OBJECTSTREAM_ENDPOINT);
+}
+
+uint64 CS3ObjectStream::CConfig::GetCacheSize()
+{
+	int cacheSize = CAppConfig::GetInstance().GetPreferenceInteger(PREF_S3_OBJECTSTREAM_CACHESIZE);
+	return static_cast<uint64>(std::max(cacheSize, 0)) * 1024 * 1024;
+}
+
 CS3ObjectStream::CS3ObjectStream(const char* bucketName, const char* objectName)
-    : m_bucketName(bucketName)
+    : CS3ObjectStream(bucketName, objectName, GetDefaultSettings())
+{
+}
+
+CS3ObjectStream::CS3ObjectStream(const char* bucketName, const char* objectName, SETTINGS settings)
+    : m_settings(std::move(settings))
+    , m_bucketName(bucketName)
     , m_objectName(objectName)
 {
-	m_buffer.resize(BUFFERSIZE);
-	Framework::PathUtils::EnsurePathExists(GetCachePath());
+	m_diskCache = CS3ChunkCache::GetShared(m_settings.cachePath, m_settings.cacheSize);
 	GetObjectInfo();
+	for(uint32 i = 0; i < FETCH_THREAD_COUNT; i++)
+	{
+		m_fetchThreads.emplace_back([this]() { FetchThreadProc(); });
+	}
+}
+
+CS3ObjectStream::~CS3ObjectStream()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fetchThreadsDone = true;
+		m_fetchCondition.notify_all();
+	}
+	for(auto& fetchThread : m_fetchThreads)
+	{
+		fetchThread.join();
+	}
+
+	CLog::GetInstance().Print(LOG_NAME, "%llu requests (at most %u at once), %llu chunks read from disk cache.\r\n",
+	                          m_stats.requestCount, m_stats.maxConcurrentRequestCount, m_stats.diskCacheHitCount);
 }
 
 uint64 CS3ObjectStream::Read(void* buffer, uint64 size)
 {
 	assert(m_objectPosition <= m_objectSize);
 
-	uint64 adjSize = std::min(size, m_objectSize - m_objectPosition);
+	uint64 readSize = std::min(size, m_objectSize - m_objectPosition);
+	uint64 adjSize = readSize;
 	auto outBuffer = reinterpret_cast<uint8*>(buffer);
 
+	std::unique_lock<std::mutex> lock(m_mutex);
 	while(adjSize != 0)
 	{
-		//Read if we're inside buffer size
-		if((m_bufferPosition / BUFFERSIZE) == (m_objectPosition / BUFFERSIZE))
+		uint32 chunkIndex = static_cast<uint32>(m_objectPosition / CHUNK_SIZE);
+		if(chunkIndex != m_lastChunkIndex)
 		{
-			uint64 bufferOffset = m_objectPosition % BUFFERSIZE;
-			uint64 remainSize = BUFFERSIZE - bufferOffset;
-			assert(remainSize <= BUFFERSIZE);
-			auto copySize = std::min(remainSize, adjSize);
-			assert(copySize <= adjSize);
-			memcpy(outBuffer, m_buffer.data() + bufferOffset, copySize);
-			m_objectPosition += copySize;
-			outBuffer += copySize;
-			adjSize -= copySize;
+			UpdateReadahead(chunkIndex);
 		}
-		else
+
+		auto chunk = RequestChunk(chunkIndex);
+		m_chunkCondition.wait(lock, [&]() { return (chunk->state == CHUNK_STATE_READY) || (chunk->state == CHUNK_STATE_FAILED); });
+		if(chunk->state == CHUNK_STATE_FAILED)
 		{
-			SyncBuffer();
+			//Let a later read try again
+			m_chunks.erase(chunkIndex);
+			throw std::runtime_error(chunk->error);
 		}
+		chunk->lastUse = ++m_useCounter;
+
+		uint64 chunkOffset = m_objectPosition % CHUNK_SIZE;
+		auto copySize = std::min<uint64>(chunk->data.size() - chunkOffset, adjSize);
+		memcpy(outBuffer, chunk->data.data() + chunkOffset, copySize);
+		m_objectPosition += copySize;
+		outBuffer += copySize;
+		adjSize -= copySize;
 	}
 
 	assert(m_objectPosition <= m_objectSize);
-	return size;
+	return readSize;
 }
 
 uint64 CS3ObjectStream::Write(const void*, uint64)
@@ -106,14 +154,31 @@ bool CS3ObjectStream::IsEOF()
 	return (m_objectPosition == m_objectSize);
 }
 
+CS3ObjectStream::STATS CS3ObjectStream::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+CS3ObjectStream::SETTINGS CS3ObjectStream::GetDefaultSettings()
+{
+	SETTINGS settings;
+	settings.accessKeyId = CConfig::GetInstance().GetAccessKeyId();
+	settings.secretAccessKey = CConfig::GetInstance().GetSecretAccessKey();
+	settings.endpoint = CConfig::GetInstance().GetEndpoint();
+	settings.cachePath = GetCachePath();
+	settings.cacheSize = CConfig::GetInstance().GetCacheSize();
+	return settings;
+}
+
 fs::path CS3ObjectStream::GetCachePath()
 {
 	return Framework::PathUtils::GetCachePath() / CACHE_PATH;
 }
 
-std::string CS3ObjectStream::GenerateReadCacheKey(const std::pair<uint64, uint64>& range) const
+std::string CS3ObjectStream::GenerateChunkCacheKey(uint32 chunkIndex) const
 {
-	return string_format("%s-%llu-%llu", m_objectEtag.c_str(), range.first, range.second);
+	return string_format("%s-%08x-%08x", m_objectEtag.c_str(), CHUNK_SIZE, chunkIndex);
 }
 
 static std::string TrimQuotes(std::string input)
@@ -134,8 +199,9 @@ static std::string TrimQuotes(std::string input)
 void CS3ObjectStream::GetObjectInfo()
 {
 	//Obtain bucket region
+	if(m_settings.endpoint.empty())
 	{
-		CAmazonS3Client client(CConfig::GetInstance().GetAccessKeyId(), CConfig::GetInstance().GetSecretAccessKey());
+		CAmazonS3Client client(m_settings.accessKeyId, m_settings.secretAccessKey);
 
 		GetBucketLocationRequest request;
 		request.bucket = m_bucketName;
@@ -143,10 +209,14 @@ void CS3ObjectStream::GetObjectInfo()
 		auto result = client.GetBucketLocation(request);
 		m_bucketRegion = result.locationConstraint;
 	}
+	else
+	{
+		m_bucketRegion = "us-east-1";
+	}
 
 	//Obtain object info
 	{
-		CAmazonS3Client client(CConfig::GetInstance().GetAccessKeyId(), CConfig::GetInstance().GetSecretAccessKey(), m_bucketRegion);
+		CAmazonS3Client client(m_settings.accessKeyId, m_settings.secretAccessKey, m_bucketRegion, m_settings.endpoint);
 
 		HeadObjectRequest request;
 		request.bucket = m_bucketName;
@@ -158,13 +228,145 @@ void CS3ObjectStream::GetObjectInfo()
 	}
 }
 
-void CS3ObjectStream::SyncBuffer()
+uint32 CS3ObjectStream::GetChunkCount() const
+{
+	return static_cast<uint32>((m_objectSize + CHUNK_SIZE - 1) / CHUNK_SIZE);
+}
+
+CS3ObjectStream::ChunkPtr CS3ObjectStream::RequestChunk(uint32 chunkIndex)
+{
+	//Must be called with m_mutex held
+	auto chunkIterator = m_chunks.find(chunkIndex);
+	if(chunkIterator != std::end(m_chunks))
+	{
+		auto chunk = chunkIterator->second;
+		if(chunk->state == CHUNK_STATE_QUEUED)
+		{
+			//Someone's waiting for it, move it to the front of the queue
+			m_fetchQueue.erase(std::remove(std::begin(m_fetchQueue), std::end(m_fetchQueue), chunkIndex), std::end(m_fetchQueue));
+			m_fetchQueue.push_front(chunkIndex);
+			m_fetchCondition.notify_one();
+		}
+		return chunk;
+	}
+
+	auto chunk = std::make_shared<CHUNK>();
+	chunk->lastUse = ++m_useCounter;
+	m_chunks.emplace(chunkIndex, chunk);
+	m_fetchQueue.push_front(chunkIndex);
+	m_fetchCondition.notify_one();
+	EvictChunks();
+	return chunk;
+}
+
+void CS3ObjectStream::UpdateReadahead(uint32 chunkIndex)
+{
+	//Must be called with m_mutex held
+	bool sequential = (chunkIndex == (m_lastChunkIndex + 1));
+	m_lastChunkIndex = chunkIndex;
+
+	if(!sequential)
+	{
+		//Whatever was queued for readahead won't be needed anytime soon
+		for(auto queuedChunkIndex : m_fetchQueue)
+		{
+			m_chunks.erase(queuedChunkIndex);
+		}
+		m_fetchQueue.clear();
+		m_readaheadCount = 0;
+		return;
+	}
+
+	m_readaheadCount = std::min<uint32>(std::max<uint32>(m_readaheadCount * 2, 1), MAX_READAHEAD_CHUNK_COUNT);
+	uint32 readaheadEnd = std::min<uint32>(chunkIndex + 1 + m_readaheadCount, GetChunkCount());
+	for(uint32 readaheadChunkIndex = chunkIndex + 1; readaheadChunkIndex < readaheadEnd; readaheadChunkIndex++)
+	{
+		if(m_chunks.find(readaheadChunkIndex) != std::end(m_chunks)) continue;
+		auto chunk = std::make_shared<CHUNK>();
+		chunk->lastUse = ++m_useCounter;
+		m_chunks.emplace(readaheadChunkIndex, chunk);
+		m_fetchQueue.push_back(readaheadChunkIndex);
+	}
+	m_fetchCondition.notify_all();
+	EvictChunks();
+}
+
+void CS3ObjectStream::EvictChunks()
+{
+	//Must be called with m_mutex held
+	//Only chunks that are done can go, readahead never asks for more than what fits
+	while(m_chunks.size() > MEMORY_CHUNK_COUNT)
+	{
+		auto oldestIterator = std::end(m_chunks);
+		for(auto chunkIterator = std::begin(m_chunks); chunkIterator != std::end(m_chunks); chunkIterator++)
+		{
+			const auto& chunk = chunkIterator->second;
+			if((chunk->state != CHUNK_STATE_READY) && (chunk->state != CHUNK_STATE_FAILED)) continue;
+			if((oldestIterator == std::end(m_chunks)) || (chunk->lastUse < oldestIterator->second->lastUse))
+			{
+				oldestIterator = chunkIterator;
+			}
+		}
+		if(oldestIterator == std::end(m_chunks)) break;
+		m_chunks.erase(oldestIterator);
+	}
+}
+
+void CS3ObjectStream::FetchThreadProc()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(1)
+	{
+		m_fetchCondition.wait(lock, [this]() { return !m_fetchQueue.empty() || m_fetchThreadsDone; });
+		if(m_fetchThreadsDone) break;
+
+		uint32 chunkIndex = m_fetchQueue.front();
+		m_fetchQueue.pop_front();
+		auto chunkIterator = m_chunks.find(chunkIndex);
+		if((chunkIterator == std::end(m_chunks)) || (chunkIterator->second->state != CHUNK_STATE_QUEUED)) continue;
+
+		auto chunk = chunkIterator->second;
+		chunk->state = CHUNK_STATE_LOADING;
+		lock.unlock();
+
+		std::vector<uint8> data;
+		std::string error;
+		try
+		{
+			data = FetchChunk(chunkIndex);
+		}
+		catch(const std::exception& exception)
+		{
+			CLog::GetInstance().Warn(LOG_NAME, "Failed to fetch chunk %u: %s\r\n", chunkIndex, exception.what());
+			error = exception.what();
+		}
+
+		lock.lock();
+		chunk->data = std::move(data);
+		chunk->error = std::move(error);
+		chunk->state = chunk->error.empty() ? CHUNK_STATE_READY : CHUNK_STATE_FAILED;
+		m_chunkCondition.notify_all();
+	}
+}
+
+std::vector<uint8> CS3ObjectStream::FetchChunk(uint32 chunkIndex)
 {
-	m_bufferPosition = (m_objectPosition / BUFFERSIZE) * BUFFERSIZE;
+	uint64 position = static_cast<uint64>(chunkIndex) * CHUNK_SIZE;
+	uint64 size = std::min<uint64>(CHUNK_SIZE, m_objectSize - position);
+	assert(size > 0);
+
+	std::vector<uint8> data(size);
+	//Without an etag, we can't tell if the object changed since we cached its chunks
+	bool cacheable = !m_objectEtag.empty();
+	auto cacheKey = cacheable ? GenerateChunkCacheKey(chunkIndex) : std::string();
+	if(cacheable && m_diskCache->Read(cacheKey, data.data(), size))
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.diskCacheHitCount++;
+		return data;
+	}
 
-	uint64 size = std::min<uint64>(BUFFERSIZE, m_objectSize - m_bufferPosition);
-	auto range = std::make_pair(m_bufferPosition, m_bufferPosition + size - 1);
-	auto readCacheFilePath = GetCachePath() / GenerateReadCacheKey(range);
+	auto range = std::make_pair(position, position + size - 1);
 
 #ifdef _TRACEGET
 	static FILE* output = fopen("getobject.log", "wb");
@@ -172,47 +374,43 @@ void CS3ObjectStream::SyncBuffer()
 	fflush(output);
 #endif
 
-	bool cachedReadSucceeded =
-	    [&]() {
-		    try
-		    {
-			    if(fs::exists(readCacheFilePath))
-			    {
-				    auto readCacheFileStream = Framework::CreateInputStdStream(readCacheFilePath.native());
-				    auto cacheRead = readCacheFileStream.Read(m_buffer.data(), size);
-				    assert(cacheRead == size);
-				    return true;
-			    }
-		    }
-		    catch(const std::exception& exception)
-		    {
-			    //Not a problem if we failed to read cache
-			    CLog::GetInstance().Print(LOG_NAME, "Failed to read cache: '%s'.\r\n", exception.what());
-		    }
-		    return false;
-	    }();
-
-	if(!cachedReadSucceeded)
-	{
-		assert(size > 0);
-		CAmazonS3Client client(CConfig::GetInstance().GetAccessKeyId(), CConfig::GetInstance().GetSecretAccessKey(), m_bucketRegion);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_activeRequestCount++;
+		m_stats.requestCount++;
+		m_stats.maxConcurrentRequestCount = std::max(m_stats.maxConcurrentRequestCount, m_activeRequestCount);
+	}
+
+	GetObjectResult objectContent;
+	try
+	{
+		CAmazonS3Client client(m_settings.accessKeyId, m_settings.secretAccessKey, m_bucketRegion, m_settings.endpoint);
 		GetObjectRequest request;
 		request.object = m_objectName;
 		request.bucket = m_bucketName;
 		request.range = range;
-		auto objectContent = client.GetObject(request);
-		assert(objectContent.data.size() == size);
-		memcpy(m_buffer.data(), objectContent.data.data(), size);
+		objectContent = client.GetObject(request);
+	}
+	catch(...)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_activeRequestCount--;
+		throw;
+	}
 
-		try
-		{
-			auto readCacheFileStream = Framework::CreateOutputStdStream(readCacheFilePath.native());
-			readCacheFileStream.Write(objectContent.data.data(), size);
-		}
-		catch(const std::exception& exception)
-		{
-			//Not a problem if we failed to write cache
-			CLog::GetInstance().Print(LOG_NAME, "Failed to write cache: '%s'.\r\n", exception.what());
-		}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_activeRequestCount--;
+	}
+
+	if(objectContent.data.size() != size)
+	{
+		throw std::runtime_error("Received an incomplete object range.");
+	}
+
+	if(cacheable)
+	{
+		m_diskCache->Write(cacheKey, objectContent.data.data(), size);
 	}
+	return std::move(objectContent.data);
 }
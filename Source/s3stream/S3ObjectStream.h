@@ -1,10 +1,19 @@
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #include "Singleton.h"
 #include "Stream.h"
 #include "filesystem_def.h"
+#include "S3ChunkCache.h"
 
+//Object is read in chunks fetched by a pool of threads, so that many range requests can be in flight at once.
+//Chunks ahead of sequential reads are fetched in advance, the more the reads stay sequential, the further ahead.
 class CS3ObjectStream : public Framework::CStream
 {
 public:
@@ -14,9 +23,30 @@ public:
 		CConfig();
 		std::string GetAccessKeyId();
 		std::string GetSecretAccessKey();
+		std::string GetEndpoint();
+		uint64 GetCacheSize();
+	};
+
+	struct SETTINGS
+	{
+		std::string accessKeyId;
+		std::string secretAccessKey;
+		//S3 compatible server to use instead of AWS (ex.: "http://localhost:9000"), bucket region isn't queried then
+		std::string endpoint;
+		fs::path cachePath;
+		uint64 cacheSize = 0;
+	};
+
+	struct STATS
+	{
+		uint64 requestCount = 0;
+		uint64 diskCacheHitCount = 0;
+		uint32 maxConcurrentRequestCount = 0;
 	};
 
 	CS3ObjectStream(const char*, const char*);
+	CS3ObjectStream(const char*, const char*, SETTINGS);
+	virtual ~CS3ObjectStream();
 
 	uint64 Read(void*, uint64) override;
 	uint64 Write(const void*, uint64) override;
@@ -24,15 +54,53 @@ public:
 	uint64 Tell() override;
 	bool IsEOF() override;
 
+	STATS GetStats();
+
 private:
+	enum
+	{
+		CHUNK_SIZE = 0x40000,
+		MEMORY_CHUNK_COUNT = 64,
+		FETCH_THREAD_COUNT = 4,
+		MAX_READAHEAD_CHUNK_COUNT = 16,
+	};
+
+	enum CHUNK_STATE
+	{
+		CHUNK_STATE_QUEUED,
+		CHUNK_STATE_LOADING,
+		CHUNK_STATE_READY,
+		CHUNK_STATE_FAILED,
+	};
+
+	struct CHUNK
+	{
+		CHUNK_STATE state = CHUNK_STATE_QUEUED;
+		std::vector<uint8> data;
+		std::string error;
+		uint64 lastUse = 0;
+	};
+	typedef std::shared_ptr<CHUNK> ChunkPtr;
+	typedef std::unordered_map<uint32, ChunkPtr> ChunkMap;
+
+	static SETTINGS GetDefaultSettings();
 	static fs::path GetCachePath();
-	std::string GenerateReadCacheKey(const std::pair<uint64, uint64>&) const;
+	std::string GenerateChunkCacheKey(uint32) const;
 	void GetObjectInfo();
-	void SyncBuffer();
+	uint32 GetChunkCount() const;
+
+	ChunkPtr RequestChunk(uint32);
+	void UpdateReadahead(uint32);
+	void EvictChunks();
+
+	void FetchThreadProc();
+	std::vector<uint8> FetchChunk(uint32);
 
+	SETTINGS m_settings;
 	std::string m_bucketName;
 	std::string m_bucketRegion;
 	std::string m_objectName;
+	std::shared_ptr<CS3ChunkCache> m_diskCache;
 
 	//Object Metadata
 	uint64 m_objectSize = 0;
@@ -40,6 +108,17 @@ private:
 
 	uint64 m_objectPosition = 0;
 
-	std::vector<uint8> m_buffer;
-	uint64 m_bufferPosition = ~0ULL;
+	//Shared with the fetch threads, protected by m_mutex
+	std::mutex m_mutex;
+	ChunkMap m_chunks;
+	std::deque<uint32> m_fetchQueue;
+	uint64 m_useCounter = 0;
+	uint32 m_lastChunkIndex = ~0U;
+	uint32 m_readaheadCount = 0;
+	uint32 m_activeRequestCount = 0;
+	STATS m_stats;
+	bool m_fetchThreadsDone = false;
+	std::condition_variable m_fetchCondition;
+	std::condition_variable m_chunkCondition;
+	std::vector<std::thread> m_fetchThreads;
 };
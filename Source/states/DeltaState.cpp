@@ -0,0 +1,166 @@
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <zlib.h>
+#include "DeltaState.h"
+#include "MemoryStateFile.h"
+#include "zip/ZipArchiveWriter.h"
+
+#define STATE_BASE "delta/base"
+#define STATE_PAGES_PREFIX "delta/pages/"
+
+bool CDeltaState::IsDeltaState(Framework::CZipArchiveReader& archive)
+{
+	return archive.GetFileHeader(STATE_BASE) != nullptr;
+}
+
+std::string CDeltaState::GetBaseStateName(Framework::CZipArchiveReader& archive)
+{
+	FileData baseStateName;
+	if(!ReadFile(archive, STATE_BASE, baseStateName))
+	{
+		throw std::runtime_error("Not a delta state.");
+	}
+	return std::string(baseStateName.begin(), baseStateName.end());
+}
+
+void CDeltaState::Write(Framework::CStream& output, Framework::CZipArchiveReader& state, Framework::CZipArchiveReader& baseState, const std::string& baseStateName)
+{
+	Framework::CZipArchiveWriter archive;
+	archive.InsertFile(new CMemoryStateFile(STATE_BASE, FileData(baseStateName.begin(), baseStateName.end())));
+
+	FileData data;
+	FileData baseData;
+	for(const auto& fileHeader : state.GetFileHeaders())
+	{
+		const auto& fileName = fileHeader.first;
+		ReadFile(state, fileName, data);
+
+		bool hasBase = (data.size() >= PAGE_SIZE) && ReadFile(baseState, fileName, baseData) && (baseData.size() == data.size());
+		if(!hasBase)
+		{
+			archive.InsertFile(new CMemoryStateFile(fileName.c_str(), std::move(data)));
+			data = FileData();
+			continue;
+		}
+
+		uint32 size = static_cast<uint32>(data.size());
+		std::vector<uint32> changedPages;
+		for(uint32 pageOffset = 0; pageOffset < size; pageOffset += PAGE_SIZE)
+		{
+			uint32 pageSize = std::min<uint32>(PAGE_SIZE, size - pageOffset);
+			if(memcmp(data.data() + pageOffset, baseData.data() + pageOffset, pageSize) == 0) continue;
+			changedPages.push_back(pageOffset / PAGE_SIZE);
+		}
+
+		PAGEDELTA_HEADER header;
+		header.size = size;
+		header.baseChecksum = ComputeChecksum(baseData);
+		header.pageCount = static_cast<uint32>(changedPages.size());
+
+		//Header, then the index of every changed page, then the content of those pages
+		FileData delta(sizeof(PAGEDELTA_HEADER) + (changedPages.size() * sizeof(uint32)));
+		memcpy(delta.data(), &header, sizeof(PAGEDELTA_HEADER));
+		if(!changedPages.empty())
+		{
+			memcpy(delta.data() + sizeof(PAGEDELTA_HEADER), changedPages.data(), changedPages.size() * sizeof(uint32));
+		}
+		for(uint32 pageIndex : changedPages)
+		{
+			uint32 pageOffset = pageIndex * PAGE_SIZE;
+			uint32 pageSize = std::min<uint32>(PAGE_SIZE, size - pageOffset);
+			delta.insert(std::end(delta), data.begin() + pageOffset, data.begin() + pageOffset + pageSize);
+		}
+
+		auto deltaFileName = STATE_PAGES_PREFIX + fileName;
+		archive.InsertFile(new CMemoryStateFile(deltaFileName.c_str(), std::move(delta)));
+	}
+
+	archive.Write(output);
+}
+
+void CDeltaState::Rebuild(Framework::CStream& output, Framework::CZipArchiveReader& deltaState, Framework::CZipArchiveReader& baseState)
+{
+	static const size_t pagesPrefixLength = strlen(STATE_PAGES_PREFIX);
+
+	Framework::CZipArchiveWriter archive;
+
+	FileData data;
+	FileData baseData;
+	for(const auto& fileHeader : deltaState.GetFileHeaders())
+	{
+		const auto& fileName = fileHeader.first;
+		if(fileName == STATE_BASE) continue;
+
+		ReadFile(deltaState, fileName, data);
+		if(fileName.compare(0, pagesPrefixLength, STATE_PAGES_PREFIX) != 0)
+		{
+			archive.InsertFile(new CMemoryStateFile(fileName.c_str(), std::move(data)));
+			data = FileData();
+			continue;
+		}
+
+		auto baseFileName = fileName.substr(pagesPrefixLength);
+
+		PAGEDELTA_HEADER header;
+		if(data.size() < sizeof(PAGEDELTA_HEADER))
+		{
+			throw std::runtime_error("Invalid page delta.");
+		}
+		memcpy(&header, data.data(), sizeof(PAGEDELTA_HEADER));
+
+		if(!ReadFile(baseState, baseFileName, baseData) ||
+		   (baseData.size() != header.size) ||
+		   (ComputeChecksum(baseData) != header.baseChecksum))
+		{
+			throw CBaseStateMismatchException("Base state doesn't match the one the delta state was made from.");
+		}
+
+		size_t indexOffset = sizeof(PAGEDELTA_HEADER);
+		size_t pageDataOffset = indexOffset + (header.pageCount * sizeof(uint32));
+		if(pageDataOffset > data.size())
+		{
+			throw std::runtime_error("Invalid page delta.");
+		}
+
+		for(uint32 i = 0; i < header.pageCount; i++)
+		{
+			uint32 pageIndex = 0;
+			memcpy(&pageIndex, data.data() + indexOffset + (i * sizeof(uint32)), sizeof(uint32));
+			uint32 pageOffset = pageIndex * PAGE_SIZE;
+			if(pageOffset >= header.size)
+			{
+				throw std::runtime_error("Invalid page delta.");
+			}
+			uint32 pageSize = std::min<uint32>(PAGE_SIZE, header.size - pageOffset);
+			if((pageDataOffset + pageSize) > data.size())
+			{
+				throw std::runtime_error("Invalid page delta.");
+			}
+			memcpy(baseData.data() + pageOffset, data.data() + pageDataOffset, pageSize);
+			pageDataOffset += pageSize;
+		}
+
+		archive.InsertFile(new CMemoryStateFile(baseFileName.c_str(), std::move(baseData)));
+		baseData = FileData();
+	}
+
+	archive.Write(output);
+}
+
+bool CDeltaState::ReadFile(Framework::CZipArchiveReader& archive, const std::string& fileName, FileData& data)
+{
+	auto fileHeader = archive.GetFileHeader(fileName.c_str());
+	if(fileHeader == nullptr) return false;
+	data.resize(fileHeader->uncompressedSize);
+	if(!data.empty())
+	{
+		archive.BeginReadFile(fileName.c_str())->Read(data.data(), data.size());
+	}
+	return true;
+}
+
+uint32 CDeltaState::ComputeChecksum(const FileData& data)
+{
+	return crc32(0, data.data(), static_cast<uInt>(data.size()));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+#include "zip/ZipArchiveReader.h"
+
+//Delta states only hold the memory pages that changed since a base state. Every file of a state that
+//also exists in the base state with the same size is split in pages and only the pages that differ are
+//stored, along with a checksum of the base file to make sure the base state didn't change in the meantime.
+//Other files are stored as is. A delta state is rebuilt into a regular state before being loaded.
+class CDeltaState
+{
+public:
+	enum
+	{
+		PAGE_SIZE = 0x1000,
+	};
+
+	//Thrown by Rebuild when the base state isn't the one the delta state was made from anymore
+	class CBaseStateMismatchException : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	static bool IsDeltaState(Framework::CZipArchiveReader&);
+	static std::string GetBaseStateName(Framework::CZipArchiveReader&);
+
+	static void Write(Framework::CStream&, Framework::CZipArchiveReader&, Framework::CZipArchiveReader&, const std::string&);
+	static void Rebuild(Framework::CStream&, Framework::CZipArchiveReader&, Framework::CZipArchiveReader&);
+
+private:
+	struct PAGEDELTA_HEADER
+	{
+		uint32 size = 0;
+		uint32 baseChecksum = 0;
+		uint32 pageCount = 0;
+	};
+	static_assert(sizeof(PAGEDELTA_HEADER) == 0x0C, "Size of PAGEDELTA_HEADER must be 12 bytes.");
+
+	typedef std::vector<uint8> FileData;
+
+	static bool ReadFile(Framework::CZipArchiveReader&, const std::string&, FileData&);
+	static uint32 ComputeChecksum(const FileData&);
+};
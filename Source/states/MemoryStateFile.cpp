@@ -2,12 +2,17 @@
 
 CMemoryStateFile::CMemoryStateFile(const char* name, const void* memory, size_t size)
     : CZipFile(name)
-    , m_memory(memory)
-    , m_size(size)
+    , m_data(reinterpret_cast<const uint8*>(memory), reinterpret_cast<const uint8*>(memory) + size)
+{
+}
+
+CMemoryStateFile::CMemoryStateFile(const char* name, std::vector<uint8> data)
+    : CZipFile(name)
+    , m_data(std::move(data))
 {
 }
 
 void CMemoryStateFile::Write(Framework::CStream& stream)
 {
-	stream.Write(m_memory, m_size);
+	stream.Write(m_data.data(), m_data.size());
 }
@@ -1,16 +1,20 @@
 #pragma once
 
+#include <vector>
+#include "Types.h"
 #include "zip/ZipFile.h"
 
+//Memory is copied when the file is created, the archive can be written later on (ie.: on another thread)
+//while the original memory keeps changing.
 class CMemoryStateFile : public Framework::CZipFile
 {
 public:
 	CMemoryStateFile(const char*, const void*, size_t);
+	CMemoryStateFile(const char*, std::vector<uint8>);
 	virtual ~CMemoryStateFile() = default;
 
 	void Write(Framework::CStream&) override;
 
 private:
-	const void* m_memory = nullptr;
-	size_t m_size = 0;
+	std::vector<uint8> m_data;
 };
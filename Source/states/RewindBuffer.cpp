@@ -0,0 +1,321 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <zlib.h>
+#include "RewindBuffer.h"
+
+#define PAGE_WORD_COUNT (CRewindBuffer::PAGE_SIZE / sizeof(uint32))
+
+struct CRewindBuffer::SNAPSHOT
+{
+	//Index of every page that changed, counted from the beginning of the first region
+	std::vector<uint32> pages;
+	//XOR of the pages that changed, run-length encoded and compressed once the snapshot is encoded
+	StateData delta;
+	uint32 encodedDeltaSize = 0;
+	StateData state;
+	bool encoded = false;
+	size_t size = 0;
+};
+
+void CRewindBuffer::SetMemoryBudget(size_t memoryBudget)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_memoryBudget = memoryBudget;
+	EnforceMemoryBudget();
+}
+
+//Drops every snapshot and makes the shadow copy match memory, captures don't need to compare every page after this
+void CRewindBuffer::Reset(const MemoryRegionArray& regions)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	PrepareShadow(regions);
+	m_snapshots.clear();
+	m_memoryUsage = 0;
+	uint8* shadow = m_shadow.data();
+	for(const auto& region : regions)
+	{
+		memcpy(shadow, region.memory, region.size);
+		shadow += region.size;
+	}
+	std::fill(std::begin(m_dirtyPages), std::end(m_dirtyPages), false);
+}
+
+void CRewindBuffer::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_snapshots.clear();
+	m_shadow = StateData();
+	m_dirtyPages.clear();
+	m_regionSizes.clear();
+	m_memoryUsage = 0;
+}
+
+uint32 CRewindBuffer::GetSnapshotCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return static_cast<uint32>(m_snapshots.size());
+}
+
+size_t CRewindBuffer::GetMemoryUsage() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_memoryUsage;
+}
+
+CRewindBuffer::SnapshotPtr CRewindBuffer::Capture(const MemoryRegionArray& regions)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	PrepareShadow(regions);
+
+	auto snapshot = std::make_shared<SNAPSHOT>();
+	uint8* shadow = m_shadow.data();
+	uint32 pageIndex = 0;
+	for(const auto& region : regions)
+	{
+		for(uint32 offset = 0; offset < region.size; offset += PAGE_SIZE, pageIndex++)
+		{
+			if(!IsPageDirty(region, offset, pageIndex)) continue;
+			m_dirtyPages[pageIndex] = false;
+
+			const uint8* page = region.memory + offset;
+			uint8* shadowPage = shadow + offset;
+			if(memcmp(page, shadowPage, PAGE_SIZE) == 0) continue;
+
+			size_t deltaOffset = snapshot->delta.size();
+			snapshot->delta.resize(deltaOffset + PAGE_SIZE);
+			auto deltaWords = reinterpret_cast<uint64*>(snapshot->delta.data() + deltaOffset);
+			auto pageWords = reinterpret_cast<const uint64*>(page);
+			auto shadowWords = reinterpret_cast<const uint64*>(shadowPage);
+			for(uint32 i = 0; i < (PAGE_SIZE / sizeof(uint64)); i++)
+			{
+				deltaWords[i] = pageWords[i] ^ shadowWords[i];
+			}
+			memcpy(shadowPage, page, PAGE_SIZE);
+			snapshot->pages.push_back(pageIndex);
+		}
+		shadow += region.size;
+	}
+
+	UpdateSnapshotSize(*snapshot);
+	m_snapshots.push_back(snapshot);
+	EnforceMemoryBudget();
+	return snapshot;
+}
+
+void CRewindBuffer::Encode(const SnapshotPtr& snapshot, StateData state)
+{
+	//Raw delta isn't modified after capture, it can be read without holding the lock
+	StateData encodedDelta;
+	StateData compressedDelta;
+	try
+	{
+		for(size_t offset = 0; offset < snapshot->delta.size(); offset += PAGE_SIZE)
+		{
+			EncodePage(snapshot->delta.data() + offset, encodedDelta);
+		}
+
+		uLongf compressedDeltaSize = compressBound(static_cast<uLong>(encodedDelta.size()));
+		compressedDelta.resize(compressedDeltaSize);
+		int result = compress2(compressedDelta.data(), &compressedDeltaSize, encodedDelta.data(), static_cast<uLong>(encodedDelta.size()), Z_BEST_SPEED);
+		if(result != Z_OK)
+		{
+			throw std::runtime_error("Failed to compress rewind snapshot.");
+		}
+		compressedDelta.resize(compressedDeltaSize);
+	}
+	catch(...)
+	{
+		Discard(snapshot);
+		throw;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	snapshot->delta = std::move(compressedDelta);
+	snapshot->encodedDeltaSize = static_cast<uint32>(encodedDelta.size());
+	snapshot->state = std::move(state);
+	snapshot->encoded = true;
+
+	//Snapshot might have been dropped in the meantime
+	if(std::find(std::begin(m_snapshots), std::end(m_snapshots), snapshot) == std::end(m_snapshots)) return;
+	UpdateSnapshotSize(*snapshot);
+	EnforceMemoryBudget();
+}
+
+//Snapshot can't be restored without going through older ones, they're dropped along with it
+void CRewindBuffer::Discard(const SnapshotPtr& snapshot)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto snapshotIterator = std::find(std::begin(m_snapshots), std::end(m_snapshots), snapshot);
+	if(snapshotIterator == std::end(m_snapshots)) return;
+	for(auto discardedIterator = std::begin(m_snapshots); discardedIterator != std::next(snapshotIterator); discardedIterator++)
+	{
+		m_memoryUsage -= (*discardedIterator)->size;
+	}
+	m_snapshots.erase(std::begin(m_snapshots), std::next(snapshotIterator));
+}
+
+bool CRewindBuffer::Restore(const MemoryRegionArray& regions, StateData& state)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_snapshots.empty()) return false;
+
+	//Snapshot is only complete once it has been encoded along with the machine state
+	auto snapshot = m_snapshots.back();
+	if(!snapshot->encoded) return false;
+
+	if(regions.size() != m_regionSizes.size()) return false;
+	for(uint32 i = 0; i < regions.size(); i++)
+	{
+		if(regions[i].size != m_regionSizes[i]) return false;
+	}
+
+	//Only pages that might have changed since the newest snapshot need to be copied back
+	const uint8* shadow = m_shadow.data();
+	uint32 pageIndex = 0;
+	for(const auto& region : regions)
+	{
+		for(uint32 offset = 0; offset < region.size; offset += PAGE_SIZE, pageIndex++)
+		{
+			if(!IsPageDirty(region, offset, pageIndex)) continue;
+			m_dirtyPages[pageIndex] = false;
+			memcpy(region.memory + offset, shadow + offset, PAGE_SIZE);
+		}
+		shadow += region.size;
+	}
+	state = snapshot->state;
+
+	//Undo the newest delta, shadow then matches the previous snapshot
+	if(!snapshot->pages.empty())
+	{
+		StateData encodedDelta(snapshot->encodedDeltaSize);
+		uLongf encodedDeltaSize = snapshot->encodedDeltaSize;
+		int result = uncompress(encodedDelta.data(), &encodedDeltaSize, snapshot->delta.data(), static_cast<uLong>(snapshot->delta.size()));
+		if((result != Z_OK) || (encodedDeltaSize != snapshot->encodedDeltaSize))
+		{
+			throw std::runtime_error("Failed to decompress rewind snapshot.");
+		}
+
+		size_t offset = 0;
+		for(uint32 pageIndex : snapshot->pages)
+		{
+			size_t pageSize = DecodePage(encodedDelta.data() + offset, encodedDelta.size() - offset, m_shadow.data() + (pageIndex * PAGE_SIZE));
+			if(pageSize == 0)
+			{
+				throw std::runtime_error("Invalid rewind snapshot.");
+			}
+			offset += pageSize;
+			m_dirtyPages[pageIndex] = true;
+		}
+	}
+
+	m_snapshots.pop_back();
+	m_memoryUsage -= snapshot->size;
+	return true;
+}
+
+void CRewindBuffer::PrepareShadow(const MemoryRegionArray& regions)
+{
+	bool sameLayout = (regions.size() == m_regionSizes.size());
+	size_t shadowSize = 0;
+	for(uint32 i = 0; i < regions.size(); i++)
+	{
+		assert((regions[i].size % PAGE_SIZE) == 0);
+		sameLayout = sameLayout && (regions[i].size == m_regionSizes[i]);
+		shadowSize += regions[i].size;
+	}
+	if(sameLayout) return;
+
+	//Previous snapshots don't apply to these regions, start over from empty memory
+	m_snapshots.clear();
+	m_memoryUsage = 0;
+	m_shadow = StateData(shadowSize);
+	m_dirtyPages.assign(shadowSize / PAGE_SIZE, true);
+	m_regionSizes.clear();
+	for(const auto& region : regions)
+	{
+		m_regionSizes.push_back(region.size);
+	}
+}
+
+bool CRewindBuffer::IsPageDirty(const MEMORY_REGION& region, uint32 offset, uint32 pageIndex) const
+{
+	return m_dirtyPages[pageIndex] || !region.isPageWritten || region.isPageWritten(offset / PAGE_SIZE);
+}
+
+void CRewindBuffer::UpdateSnapshotSize(SNAPSHOT& snapshot)
+{
+	m_memoryUsage -= snapshot.size;
+	snapshot.size = (snapshot.pages.size() * sizeof(uint32)) + snapshot.delta.size() + snapshot.state.size();
+	m_memoryUsage += snapshot.size;
+}
+
+void CRewindBuffer::EnforceMemoryBudget()
+{
+	//Newest snapshot is always kept
+	while((m_memoryUsage > m_memoryBudget) && (m_snapshots.size() > 1))
+	{
+		m_memoryUsage -= m_snapshots.front()->size;
+		m_snapshots.pop_front();
+	}
+}
+
+void CRewindBuffer::EncodePage(const uint8* page, StateData& output)
+{
+	//Alternates between a run of zero words and a run of literal words, each preceded by their lengths
+	auto words = reinterpret_cast<const uint32*>(page);
+	uint32 index = 0;
+	while(index < PAGE_WORD_COUNT)
+	{
+		uint32 zeroStart = index;
+		while((index < PAGE_WORD_COUNT) && (words[index] == 0))
+		{
+			index++;
+		}
+		uint32 literalStart = index;
+		while((index < PAGE_WORD_COUNT) && (words[index] != 0))
+		{
+			index++;
+		}
+
+		uint16 runLengths[2] =
+		    {
+		        static_cast<uint16>(literalStart - zeroStart),
+		        static_cast<uint16>(index - literalStart),
+		    };
+		size_t outputOffset = output.size();
+		output.resize(outputOffset + sizeof(runLengths) + (runLengths[1] * sizeof(uint32)));
+		memcpy(output.data() + outputOffset, runLengths, sizeof(runLengths));
+		memcpy(output.data() + outputOffset + sizeof(runLengths), words + literalStart, runLengths[1] * sizeof(uint32));
+	}
+}
+
+//XORs an encoded page into the output page, returns the size of the encoded page or 0 if it's invalid
+size_t CRewindBuffer::DecodePage(const uint8* input, size_t inputSize, uint8* page)
+{
+	auto words = reinterpret_cast<uint32*>(page);
+	size_t inputOffset = 0;
+	uint32 index = 0;
+	while(index < PAGE_WORD_COUNT)
+	{
+		uint16 runLengths[2] = {};
+		if((inputOffset + sizeof(runLengths)) > inputSize) return 0;
+		memcpy(runLengths, input + inputOffset, sizeof(runLengths));
+		inputOffset += sizeof(runLengths);
+
+		if((runLengths[0] == 0) && (runLengths[1] == 0)) return 0;
+		index += runLengths[0];
+		if((index + runLengths[1]) > PAGE_WORD_COUNT) return 0;
+		if((inputOffset + (runLengths[1] * sizeof(uint32))) > inputSize) return 0;
+
+		for(uint32 i = 0; i < runLengths[1]; i++)
+		{
+			uint32 literal = 0;
+			memcpy(&literal, input + inputOffset, sizeof(uint32));
+			words[index++] ^= literal;
+			inputOffset += sizeof(uint32);
+		}
+	}
+	return inputOffset;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Types.h"
+
+//Keeps a bounded history of machine snapshots in memory. Memory regions are compared page by page against
+//a shadow copy of the newest snapshot and only the XOR of the pages that changed is kept. XOR being its own
+//inverse, applying the newest snapshot's delta to the shadow copy brings it back to the previous snapshot.
+//Regions that track writes only get the pages written since memory last matched the shadow copy compared,
+//the owner of the memory forgets about written pages after every capture and restore.
+//Capturing only does the page compare, deltas are run-length encoded and compressed later on (ie.: on another
+//thread) along with the rest of the machine state. The memory budget covers snapshots, not the shadow copy.
+class CRewindBuffer
+{
+public:
+	enum
+	{
+		PAGE_SIZE = 0x1000,
+	};
+
+	struct MEMORY_REGION
+	{
+		uint8* memory;
+		uint32 size;
+		//Tells if a page (index in the region) was written, every page is compared if not set
+		std::function<bool(uint32)> isPageWritten;
+	};
+	typedef std::vector<MEMORY_REGION> MemoryRegionArray;
+	typedef std::vector<uint8> StateData;
+
+	struct SNAPSHOT;
+	typedef std::shared_ptr<SNAPSHOT> SnapshotPtr;
+
+	void SetMemoryBudget(size_t);
+	void Reset(const MemoryRegionArray&);
+	void Clear();
+
+	uint32 GetSnapshotCount() const;
+	size_t GetMemoryUsage() const;
+
+	SnapshotPtr Capture(const MemoryRegionArray&);
+	void Encode(const SnapshotPtr&, StateData);
+	void Discard(const SnapshotPtr&);
+	bool Restore(const MemoryRegionArray&, StateData&);
+
+private:
+	typedef std::deque<SnapshotPtr> SnapshotArray;
+
+	void PrepareShadow(const MemoryRegionArray&);
+	bool IsPageDirty(const MEMORY_REGION&, uint32, uint32) const;
+	void UpdateSnapshotSize(SNAPSHOT&);
+	void EnforceMemoryBudget();
+
+	static void EncodePage(const uint8*, StateData&);
+	static size_t DecodePage(const uint8*, size_t, uint8*);
+
+	mutable std::mutex m_mutex;
+	SnapshotArray m_snapshots;
+	StateData m_shadow;
+	//Pages that might not match the shadow copy whether they were written or not
+	std::vector<bool> m_dirtyPages;
+	std::vector<uint32> m_regionSizes;
+	size_t m_memoryBudget = 0;
+	size_t m_memoryUsage = 0;
+};
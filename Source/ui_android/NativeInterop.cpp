@@ -119,10 +119,12 @@ extern "C" JNIEXPORT void JNICALL Java_com_virtualapplications_play_NativeIntero
 	if(g_virtualMachine == nullptr) return;
 	auto stateFilePath = g_virtualMachine->GenerateStatePath(slot);
 	auto resultFuture = g_virtualMachine->LoadState(stateFilePath);
-	if(!resultFuture.get())
+	auto result = resultFuture.get();
+	if(result != CPS2VM::LOAD_STATE_RESULT::SUCCEEDED)
 	{
+		auto message = (result == CPS2VM::LOAD_STATE_RESULT::BASE_STATE_CHANGED) ? "LoadState failed: base state of delta state changed." : "LoadState failed.";
 		jclass exceptionClass = env->FindClass("java/lang/Exception");
-		env->ThrowNew(exceptionClass, "LoadState failed.");
+		env->ThrowNew(exceptionClass, message);
 		return;
 	}
 }
@@ -486,6 +486,7 @@ bool IsBootableDiscImagePath(const fs::path& filePath)
 	return (extension == ".iso") ||
 	       (extension == ".isz") ||
 	       (extension == ".cso") ||
+	       (extension == ".zsi") ||
 	       (extension == ".bin");
 }
 
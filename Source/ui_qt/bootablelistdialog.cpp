@@ -130,7 +130,7 @@ void BootableListDialog::on_add_games_button_clicked()
 {
 	QFileDialog dialog(this);
 	dialog.setFileMode(QFileDialog::ExistingFile);
-	dialog.setNameFilter(tr("All supported types(*.iso *.bin *.isz *.cso *.elf);;UltraISO Compressed Disk Images (*.isz);;CISO Compressed Disk Images (*.cso);;ELF files (*.elf);;All files (*.*)"));
+	dialog.setNameFilter(tr("All supported types(*.iso *.bin *.isz *.cso *.zsi *.elf);;UltraISO Compressed Disk Images (*.isz);;CISO Compressed Disk Images (*.cso);;ZSI Compressed Disk Images (*.zsi);;ELF files (*.elf);;All files (*.*)"));
 	if(dialog.exec())
 	{
 		auto filePath = QStringToPath(dialog.selectedFiles().first()).parent_path();
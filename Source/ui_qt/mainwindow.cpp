@@ -274,7 +274,7 @@ void MainWindow::on_actionBoot_DiscImage_triggered()
 	QFileDialog dialog(this);
 	dialog.setDirectory(PathToQString(m_lastPath));
 	dialog.setFileMode(QFileDialog::ExistingFile);
-	dialog.setNameFilter(tr("All supported types(*.iso *.bin *.isz *.cso);;UltraISO Compressed Disk Images (*.isz);;CISO Compressed Disk Images (*.cso);;All files (*.*)"));
+	dialog.setNameFilter(tr("All supported types(*.iso *.bin *.isz *.cso *.zsi);;UltraISO Compressed Disk Images (*.isz);;CISO Compressed Disk Images (*.cso);;ZSI Compressed Disk Images (*.zsi);;All files (*.*)"));
 	if(dialog.exec())
 	{
 		auto filePath = QStringToPath(dialog.selectedFiles().first());
@@ -477,7 +477,24 @@ void MainWindow::updateStats()
 #ifdef PROFILE
 	m_profileStatsLabel->setText(QString::fromStdString(CStatsManager::GetInstance().GetProfilingInfo()));
 #endif
-	m_fpsLabel->setText(QString("%1 f/s, %2 dc/f").arg(frames).arg(dcpf));
+	auto stats = QString("%1 f/s, %2 dc/f").arg(frames).arg(dcpf);
+	if(m_virtualMachine != nullptr)
+	{
+		auto stateLatency = m_virtualMachine->GetStateLatencyInfo();
+		if(stateLatency.lastSaveTime != 0)
+		{
+			stats += QString(", save %1/%2 ms").arg(stateLatency.lastSaveStagingTime, 0, 'f', 1).arg(stateLatency.lastSaveTime, 0, 'f', 0);
+		}
+		if(stateLatency.lastLoadTime != 0)
+		{
+			stats += QString(", load %1 ms").arg(stateLatency.lastLoadTime, 0, 'f', 0);
+		}
+		if(stateLatency.lastRewindCaptureTime != 0)
+		{
+			stats += QString(", rewind %1 ms").arg(stateLatency.lastRewindCaptureTime, 0, 'f', 1);
+		}
+	}
+	m_fpsLabel->setText(stats);
 	CStatsManager::GetInstance().ClearStats();
 }
 
@@ -533,12 +550,32 @@ void MainWindow::SetupSaveLoadStateSlots()
 			connect(loadaction, &QAction::triggered, std::bind(&MainWindow::loadState, this, i));
 		}
 	}
+
+	//When checked, saving to other slots only stores what changed since the state in the base slot
+	ui->menuSave_States->addSeparator();
+	QAction* deltaaction = new QAction(this);
+	deltaaction->setText(QString("Save as Delta of Slot %1").arg(DELTA_BASE_STATE_SLOT));
+	deltaaction->setCheckable(true);
+	deltaaction->setChecked(m_saveDeltaStates);
+	deltaaction->setEnabled(enable);
+	ui->menuSave_States->addAction(deltaaction);
+	connect(deltaaction, &QAction::toggled, [this](bool checked) { m_saveDeltaStates = checked; });
 }
 
 void MainWindow::saveState(int stateSlot)
 {
 	auto stateFilePath = m_virtualMachine->GenerateStatePath(stateSlot);
-	auto future = m_virtualMachine->SaveState(stateFilePath);
+	fs::path baseStateFilePath;
+	if(m_saveDeltaStates && (stateSlot != DELTA_BASE_STATE_SLOT))
+	{
+		//Full state is saved if there's nothing to make a delta from
+		auto deltaBaseStateFilePath = m_virtualMachine->GenerateStatePath(DELTA_BASE_STATE_SLOT);
+		if(fs::exists(deltaBaseStateFilePath))
+		{
+			baseStateFilePath = deltaBaseStateFilePath;
+		}
+	}
+	auto future = m_virtualMachine->SaveState(stateFilePath, baseStateFilePath);
 	m_continuationChecker->GetContinuationManager().Register(std::move(future),
 	                                                         [this, stateSlot = stateSlot](const bool& succeeded) {
 		                                                         if(succeeded)
@@ -560,17 +597,21 @@ void MainWindow::loadState(int stateSlot)
 	auto stateFilePath = m_virtualMachine->GenerateStatePath(stateSlot);
 	auto future = m_virtualMachine->LoadState(stateFilePath);
 	m_continuationChecker->GetContinuationManager().Register(std::move(future),
-	                                                         [this, stateSlot = stateSlot](const bool& succeeded) {
-		                                                         if(succeeded)
+	                                                         [this, stateSlot = stateSlot](const CPS2VM::LOAD_STATE_RESULT& result) {
+		                                                         switch(result)
 		                                                         {
+		                                                         case CPS2VM::LOAD_STATE_RESULT::SUCCEEDED:
 			                                                         m_msgLabel->setText(QString("Loaded state from slot %1.").arg(stateSlot));
 #ifndef DEBUGGER_INCLUDED
 			                                                         m_virtualMachine->Resume();
 #endif
-		                                                         }
-		                                                         else
-		                                                         {
+			                                                         break;
+		                                                         case CPS2VM::LOAD_STATE_RESULT::BASE_STATE_CHANGED:
+			                                                         m_msgLabel->setText(QString("Error loading state from slot %1: it was saved as a delta and its base state changed since.").arg(stateSlot));
+			                                                         break;
+		                                                         default:
 			                                                         m_msgLabel->setText(QString("Error loading state from slot %1.").arg(stateSlot));
+			                                                         break;
 		                                                         }
 	                                                         });
 }
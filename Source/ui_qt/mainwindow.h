@@ -74,6 +74,11 @@ private:
 		fs::path path;
 	};
 
+	enum
+	{
+		DELTA_BASE_STATE_SLOT = 0,
+	};
+
 	void SetOutputWindowSize();
 	void CreateStatusBar();
 	void InitVirtualMachine();
@@ -109,6 +114,7 @@ private:
 	std::shared_ptr<CInputProviderQtKey> m_qtKeyInputProvider;
 	LastOpenCommand m_lastOpenCommand;
 	fs::path m_lastPath;
+	bool m_saveDeltaStates = false;
 
 	Framework::CSignal<void()>::Connection m_OnExecutableChangeConnection;
 	CGSHandler::NewFrameEvent::Connection m_OnNewFrameConnection;
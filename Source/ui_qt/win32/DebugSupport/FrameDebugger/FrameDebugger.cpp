@@ -242,9 +242,8 @@ void CFrameDebugger::UpdateDisplay(int32 targetCmdIndex)
 
 	const auto flushRegisterWrites =
 	    [&]() {
-		    auto currentCapacity = registerWrites.capacity();
-		    m_gs->WriteRegisterMassively(std::move(registerWrites), nullptr);
-		    registerWrites.reserve(currentCapacity);
+		    m_gs->WriteRegisterMassively(registerWrites, nullptr);
+		    registerWrites.clear();
 	    };
 
 	int32 cmdIndex = 0;
@@ -48,6 +48,7 @@ bool IsBootableDiscImagePath(const fs::path& filePath)
 	return (extension == ".iso") ||
 	       (extension == ".isz") ||
 	       (extension == ".cso") ||
+	       (extension == ".zsi") ||
 	       (extension == ".bin");
 }
 
@@ -2,6 +2,7 @@
 #include "StatsManager.h"
 #include "string_format.h"
 #include "PS2VM.h"
+#include "ee/EeExecutor.h"
 
 void CStatsManager::OnNewFrame(uint32 drawCalls)
 {
@@ -47,8 +48,10 @@ std::string CStatsManager::GetProfilingInfo()
 		float avgMsSpent = (m_frames != 0) ? static_cast<double>(zoneInfo.currentValue) / static_cast<double>(m_frames * timeScale) : 0;
 		float minMsSpent = (zoneInfo.minValue != ~0ULL) ? static_cast<double>(zoneInfo.minValue) / static_cast<double>(timeScale) : 0;
 		float maxMsSpent = static_cast<double>(zoneInfo.maxValue) / static_cast<double>(timeScale);
-		result += string_format("%10s %6.2f%% %6.2fms %6.2fms %6.2fms\r\n",
-		                        zonePair.first.c_str(), avgRatioSpent * 100.f, avgMsSpent, minMsSpent, maxMsSpent);
+		//Time spent in the zone for each execution slice, to compare slicing strategies
+		float avgUsPerSlice = (m_cpuUtilisation.sliceCount != 0) ? static_cast<double>(zoneInfo.currentValue) / static_cast<double>(m_cpuUtilisation.sliceCount * 1000ULL) : 0;
+		result += string_format("%10s %6.2f%% %6.2fms %6.2fms %6.2fms %7.2fus\r\n",
+		                        zonePair.first.c_str(), avgRatioSpent * 100.f, avgMsSpent, minMsSpent, maxMsSpent, avgUsPerSlice);
 	}
 
 	if(!m_profilerZones.empty())
@@ -69,6 +72,20 @@ std::string CStatsManager::GetProfilingInfo()
 
 		result += string_format("EE Usage:  %6.2f%%\r\n", (1.f - eeIdleRatio) * 100.f);
 		result += string_format("IOP Usage: %6.2f%%\r\n", (1.f - iopIdleRatio) * 100.f);
+
+		float slicesPerFrame = (m_frames != 0) ? static_cast<float>(m_cpuUtilisation.sliceCount) / static_cast<float>(m_frames) : 0;
+		result += string_format("Slices:    %6.0f/frame\r\n", slicesPerFrame);
+	}
+
+	{
+		result += string_format("\r\nEE Faults:        %d\r\n", m_eeCodeInfo.faults);
+		result += string_format("EE Invalidations: %d\r\n", m_eeCodeInfo.invalidations);
+		result += string_format("EE Recompiles:    %d\r\n", m_eeCodeInfo.recompiles);
+		result += string_format("EE Checked Pages: %d\r\n", m_eeCodeInfo.checkedPages);
+		if(m_eeCodeInfo.hotPageInvalidations != 0)
+		{
+			result += string_format("EE Hot Page:      0x%08X (%d)\r\n", m_eeCodeInfo.hotPageAddress, m_eeCodeInfo.hotPageInvalidations);
+		}
 	}
 
 	return result;
@@ -112,6 +129,28 @@ void CStatsManager::OnProfileFrameDone(CPS2VM* virtualMachine, const CProfiler::
 	m_cpuUtilisation.eeIdleTicks += cpuUtilisation.eeIdleTicks;
 	m_cpuUtilisation.iopTotalTicks += cpuUtilisation.iopTotalTicks;
 	m_cpuUtilisation.iopIdleTicks += cpuUtilisation.iopIdleTicks;
+	m_cpuUtilisation.sliceCount += cpuUtilisation.sliceCount;
+
+	//Counters are already cumulative, only keep the latest totals
+	auto eeExecutor = static_cast<CEeExecutor*>(virtualMachine->m_ee->m_EE.m_executor.get());
+	auto pageStats = eeExecutor->GetPageStats();
+	m_eeCodeInfo = EE_CODE_INFO();
+	for(uint32 pageIndex = 0; pageIndex < pageStats.size(); pageIndex++)
+	{
+		const auto& stats = pageStats[pageIndex];
+		m_eeCodeInfo.faults += stats.faults;
+		m_eeCodeInfo.invalidations += stats.invalidations;
+		m_eeCodeInfo.recompiles += stats.recompiles;
+		if(stats.checked)
+		{
+			m_eeCodeInfo.checkedPages++;
+		}
+		if(stats.invalidations > m_eeCodeInfo.hotPageInvalidations)
+		{
+			m_eeCodeInfo.hotPageAddress = pageIndex * static_cast<uint32>(eeExecutor->GetPageSize());
+			m_eeCodeInfo.hotPageInvalidations = stats.invalidations;
+		}
+	}
 }
 
 #endif
@@ -40,7 +40,19 @@ private:
 
 	typedef std::map<std::string, ZONEINFO> ZoneMap;
 
+	//Totals for EE RAM pages since the executor was last reset
+	struct EE_CODE_INFO
+	{
+		uint32 faults = 0;
+		uint32 invalidations = 0;
+		uint32 recompiles = 0;
+		uint32 checkedPages = 0;
+		uint32 hotPageAddress = 0;
+		uint32 hotPageInvalidations = 0;
+	};
+
 	CPS2VM::CPU_UTILISATION_INFO m_cpuUtilisation;
+	EE_CODE_INFO m_eeCodeInfo;
 
 	std::mutex m_profilerZonesMutex;
 	ZoneMap m_profilerZones;
@@ -1,4 +1,5 @@
 #include "PS2VM.h"
+#include "FrameDump.h"
 #include "filesystem_def.h"
 #include "StdStream.h"
 #include "StdStreamUtils.h"
@@ -110,7 +111,7 @@ TESTRESULT GetTestResult(const fs::path& testFilePath)
 	return result;
 }
 
-void ExecuteEeTest(const fs::path& testFilePath, const std::string& gsHandlerName)
+void ExecuteEeTest(const fs::path& testFilePath, const std::string& gsHandlerName, unsigned int frameDumpCount)
 {
 	auto resultFilePath = testFilePath;
 	resultFilePath.replace_extension(".result");
@@ -132,6 +133,32 @@ void ExecuteEeTest(const fs::path& testFilePath, const std::string& gsHandlerNam
 		auto iopOs = dynamic_cast<CIopBios*>(virtualMachine.m_iop->m_bios.get());
 		iopOs->GetIoman()->SetFileStream(Iop::CIoman::FID_STDOUT, resultStream);
 	}
+
+	//Frames are dumped next to the test, the next dump is requested once the previous one is written
+	unsigned int frameDumpIndex = 0;
+	CPS2VM::FrameDumpCallback frameDumpCallback =
+	    [&](const CFrameDump& frameDump) {
+		    auto frameDumpPath = testFilePath;
+		    frameDumpPath.replace_filename(testFilePath.stem().string() + "_frame" + std::to_string(frameDumpIndex) + ".dmp.zip");
+		    try
+		    {
+			    auto dumpStream = Framework::CreateOutputStdStream(frameDumpPath.native());
+			    frameDump.Write(dumpStream);
+		    }
+		    catch(const std::exception& exception)
+		    {
+			    printf("Warning: Failed to write frame dump '%s': %s\r\n", frameDumpPath.string().c_str(), exception.what());
+		    }
+		    frameDumpIndex++;
+		    if(frameDumpIndex < frameDumpCount)
+		    {
+			    virtualMachine.TriggerFrameDump(frameDumpCallback);
+		    }
+	    };
+	if(frameDumpCount != 0)
+	{
+		virtualMachine.TriggerFrameDump(frameDumpCallback);
+	}
 	virtualMachine.Resume();
 
 	while(!executionOver)
@@ -189,7 +216,7 @@ void ExecuteIopTest(const fs::path& testFilePath)
 	virtualMachine.Destroy();
 }
 
-void ScanAndExecuteTests(const fs::path& testDirPath, const TestReportWriterPtr& testReportWriter, const std::string& gsHandlerName)
+void ScanAndExecuteTests(const fs::path& testDirPath, const TestReportWriterPtr& testReportWriter, const std::string& gsHandlerName, unsigned int frameDumpCount)
 {
 	fs::directory_iterator endIterator;
 	for(auto testPathIterator = fs::directory_iterator(testDirPath);
@@ -198,13 +225,13 @@ void ScanAndExecuteTests(const fs::path& testDirPath, const TestReportWriterPtr&
 		auto testPath = testPathIterator->path();
 		if(fs::is_directory(testPath))
 		{
-			ScanAndExecuteTests(testPath, testReportWriter, gsHandlerName);
+			ScanAndExecuteTests(testPath, testReportWriter, gsHandlerName, frameDumpCount);
 			continue;
 		}
 		if(testPath.extension() == ".elf")
 		{
 			printf("Testing '%s': ", testPath.string().c_str());
-			ExecuteEeTest(testPath, gsHandlerName);
+			ExecuteEeTest(testPath, gsHandlerName, frameDumpCount);
 			auto result = GetTestResult(testPath);
 			printf("%s.\r\n", result.succeeded ? "SUCCEEDED" : "FAILED");
 			if(testReportWriter)
@@ -250,6 +277,7 @@ int main(int argc, const char** argv)
 		printf("\t --junitreport <path>\t Writes JUnit format report at <path>.\r\n");
 		printf("\t --gshandler <%s>\tSelects which GS handler to instantiate (default is '%s').\r\n",
 		       validGsHandlerNamesString.c_str(), DEFAULT_GS_HANDLER_NAME);
+		printf("\t --framedump <count>\t Dumps up to <count> frames of every EE test next to it, for use with GsReplay.\r\n");
 		return -1;
 	}
 
@@ -257,6 +285,7 @@ int main(int argc, const char** argv)
 	fs::path autoTestRoot;
 	fs::path reportPath;
 	std::string gsHandlerName = DEFAULT_GS_HANDLER_NAME;
+	unsigned int frameDumpCount = 0;
 	assert(g_validGsHandlersNames.find(gsHandlerName) != std::end(g_validGsHandlersNames));
 
 	for(int i = 1; i < argc; i++)
@@ -287,6 +316,16 @@ int main(int argc, const char** argv)
 			}
 			i++;
 		}
+		else if(!strcmp(argv[i], "--framedump"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Frame count must be specified for --framedump option.\r\n");
+				return -1;
+			}
+			frameDumpCount = atoi(argv[i + 1]);
+			i++;
+		}
 		else
 		{
 			autoTestRoot = argv[i];
@@ -302,7 +341,7 @@ int main(int argc, const char** argv)
 
 	try
 	{
-		ScanAndExecuteTests(autoTestRoot, testReportWriter, gsHandlerName);
+		ScanAndExecuteTests(autoTestRoot, testReportWriter, gsHandlerName, frameDumpCount);
 	}
 	catch(const std::exception& exception)
 	{
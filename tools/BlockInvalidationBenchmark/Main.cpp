@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <memory>
+#include "MIPS.h"
+#include "MA_MIPSIV.h"
+#include "COP_SCU.h"
+#include "GenericMipsExecutor.h"
+
+//Measures the cost of invalidating and recompiling lots of linked blocks, as happens
+//when games reload overlays or modify their own code.
+
+static const uint32 RAM_SIZE = 0x100000;
+static const uint32 CODE_BASE = 0x1000;
+//Each block is 4 instructions long
+static const uint32 BLOCK_SIZE = 0x10;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static uint32 MakeAddiu(uint32 rt, uint32 rs, uint16 immediate)
+{
+	return 0x24000000 | (rs << 21) | (rt << 16) | immediate;
+}
+
+//Fills memory with a chain of blocks that link to the next one, the last block jumps back to the first one
+static void WriteCode(uint8* ram, uint32 blockCount)
+{
+	auto code = reinterpret_cast<uint32*>(ram + CODE_BASE);
+	for(uint32 i = 0; i < blockCount; i++)
+	{
+		bool isLast = (i + 1) == blockCount;
+		code[0] = MakeAddiu(CMIPS::T0, CMIPS::T0, 1);
+		code[1] = MakeAddiu(CMIPS::T1, CMIPS::T1, i);
+		//BNE T0, R0, next block or J to beginning
+		code[2] = isLast ? (0x08000000 | (CODE_BASE / 4)) : (0x14000000 | (CMIPS::T0 << 21) | 1);
+		code[3] = 0;
+		code += 4;
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 blockCount = 4096;
+	uint32 iterationCount = 50;
+	if(argc > 1) blockCount = atoi(argv[1]);
+	if(argc > 2) iterationCount = atoi(argv[2]);
+	if((blockCount == 0) || ((CODE_BASE + (blockCount * BLOCK_SIZE)) > RAM_SIZE))
+	{
+		printf("Usage: BlockInvalidationBenchmark [blockCount] [iterationCount]\r\n");
+		return -1;
+	}
+
+	auto ram = std::make_unique<uint8[]>(RAM_SIZE);
+	WriteCode(ram.get(), blockCount);
+
+	CMIPS cpu(MEMORYMAP_ENDIAN_LSBF);
+	CMA_MIPSIV cpuArch(MIPS_REGSIZE_32);
+	CCOP_SCU copScu(MIPS_REGSIZE_32);
+	cpu.m_pMemoryMap->InsertReadMap(0, RAM_SIZE - 1, ram.get(), 0x01);
+	cpu.m_pMemoryMap->InsertWriteMap(0, RAM_SIZE - 1, ram.get(), 0x01);
+	cpu.m_pMemoryMap->InsertInstructionMap(0, RAM_SIZE - 1, ram.get(), 0x01);
+	cpu.m_pArch = &cpuArch;
+	cpu.m_pCOP[0] = &copScu;
+	cpu.m_pAddrTranslator = &CMIPS::TranslateAddress64;
+	cpu.m_executor = std::make_unique<CGenericMipsExecutor<BlockLookupOneWay>>(cpu, RAM_SIZE);
+
+	cpu.Reset();
+	cpu.m_State.nPC = CODE_BASE;
+
+	uint32 codeEnd = CODE_BASE + (blockCount * BLOCK_SIZE);
+	uint32 lapCount = 0;
+	//One lap runs every block once and ends at the beginning of the chain
+	auto runLap =
+	    [&]() {
+		    cpu.m_executor->Execute(blockCount * 4);
+		    lapCount++;
+	    };
+
+	runLap();
+
+	Clock::duration wholeRangeTime = Clock::duration::zero();
+	Clock::duration singleBlockTime = Clock::duration::zero();
+
+	for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+	{
+		//Invalidate everything at once
+		{
+			auto startTime = Clock::now();
+			cpu.m_executor->ClearActiveBlocksInRange(CODE_BASE, codeEnd, false);
+			runLap();
+			wholeRangeTime += Clock::now() - startTime;
+		}
+
+		//Invalidate every other block, one at a time
+		{
+			auto startTime = Clock::now();
+			for(uint32 i = iteration & 1; i < blockCount; i += 2)
+			{
+				uint32 blockAddress = CODE_BASE + (i * BLOCK_SIZE);
+				cpu.m_executor->ClearActiveBlocksInRange(blockAddress, blockAddress + BLOCK_SIZE, false);
+			}
+			runLap();
+			singleBlockTime += Clock::now() - startTime;
+		}
+	}
+
+	uint32 expectedCount = lapCount * blockCount;
+	if((cpu.m_State.nGPR[CMIPS::T0].nV0 != expectedCount) || (cpu.m_State.nPC != CODE_BASE))
+	{
+		printf("Failed: executed %d blocks, expected %d.\r\n", cpu.m_State.nGPR[CMIPS::T0].nV0, expectedCount);
+		return 1;
+	}
+
+	auto toMilliseconds = [](Clock::duration duration) { return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count(); };
+	printf("Blocks: %d, iterations: %d.\r\n", blockCount, iterationCount);
+	printf("Whole range invalidation + recompile: %d ms.\r\n", static_cast<int>(toMilliseconds(wholeRangeTime)));
+	printf("Single block invalidations + recompile: %d ms.\r\n", static_cast<int>(toMilliseconds(singleBlockTime)));
+	return 0;
+}
@@ -0,0 +1,181 @@
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#include <vector>
+#include "MemStream.h"
+#include "OpticalMedia.h"
+#include "Ps2Const.h"
+#include "iop/Iop_CdvdReadEngine.h"
+
+//Reads sectors from a generated disc image through the CDVD read engine while moving the IOP time forward
+//by hand and checks that sectors only show up once the drive would have transferred them, that they match
+//the image and that cancelled or completed requests behave.
+
+static const uint32 SECTOR_SIZE = 0x800;
+static const uint32 IMAGE_SECTOR_COUNT = 0x800;
+static const uint32 VOLUME_DESCRIPTOR_SECTOR = 16;
+static const uint32 PATH_TABLE_SECTOR = 18;
+//Time moves forward by 100us at a time
+static const uint64 TIME_STEP = PS2::IOP_CLOCK_OVER_FREQ / 10000;
+//Destination bytes that weren't written by the engine keep this value
+static const uint8 UNTOUCHED_BYTE = 0xCC;
+
+static std::vector<uint8> GenerateImage()
+{
+	std::vector<uint8> image(IMAGE_SECTOR_COUNT * SECTOR_SIZE);
+	for(uint32 i = 0; i < image.size(); i += sizeof(uint32))
+	{
+		uint32 value = (i * 0x9E3779B1) ^ (i >> 11);
+		memcpy(image.data() + i, &value, sizeof(uint32));
+	}
+
+	//Minimal ISO9660 volume descriptor with an empty path table, enough to mount the image
+	uint8* volumeDescriptor = image.data() + (VOLUME_DESCRIPTOR_SECTOR * SECTOR_SIZE);
+	memset(volumeDescriptor, 0, SECTOR_SIZE);
+	volumeDescriptor[0] = 0x01;
+	memcpy(volumeDescriptor + 1, "CD001", 5);
+	uint32 pathTableSector = PATH_TABLE_SECTOR;
+	memcpy(volumeDescriptor + 140, &pathTableSector, sizeof(uint32));
+	memset(image.data() + (PATH_TABLE_SECTOR * SECTOR_SIZE), 0, SECTOR_SIZE);
+
+	return image;
+}
+
+static bool CheckSectors(const std::vector<uint8>& dest, const std::vector<uint8>& image, uint32 sector, uint32 deliveredCount, uint32 count)
+{
+	if(memcmp(dest.data(), image.data() + (sector * SECTOR_SIZE), deliveredCount * SECTOR_SIZE) != 0)
+	{
+		printf("Failed: sectors delivered from 0x%X don't match the image.\r\n", sector);
+		return false;
+	}
+	for(uint32 i = deliveredCount * SECTOR_SIZE; i < count * SECTOR_SIZE; i++)
+	{
+		if(dest[i] != UNTOUCHED_BYTE)
+		{
+			printf("Failed: sectors from 0x%X were written before being delivered.\r\n", sector);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, const char** argv)
+{
+	auto image = GenerateImage();
+	COpticalMedia::StreamPtr stream = std::make_shared<Framework::CMemStream>();
+	stream->Write(image.data(), image.size());
+	std::unique_ptr<COpticalMedia> opticalMedia(COpticalMedia::CreateDvd(stream));
+
+	uint64 currentTime = 0;
+	Iop::CCdvdReadEngine readEngine([&currentTime]() { return currentTime; });
+	readEngine.SetOpticalMedia(opticalMedia.get());
+	bool succeeded = true;
+
+	{
+		//Sectors trickle in as time goes by
+		const uint32 sector = 0x100;
+		const uint32 count = 0x40;
+		std::vector<uint8> dest(count * SECTOR_SIZE, UNTOUCHED_BYTE);
+		auto readId = readEngine.BeginRead(sector, count);
+
+		//Later request is read after this one, waiting for it makes sure the host is done with the first
+		auto syncReadId = readEngine.BeginRead(0x400, 1);
+		readEngine.Complete(syncReadId, nullptr);
+
+		//Drive needs to seek first, nothing can be there yet
+		if(readEngine.Update(readId, dest.data()) || (readEngine.GetDeliveredCount(readId) != 0))
+		{
+			printf("Failed: sectors were delivered before the drive could have read them.\r\n");
+			succeeded = false;
+		}
+
+		bool partialDeliverySeen = false;
+		uint32 lastDeliveredCount = 0;
+		for(uint32 step = 0; step < 0x10000; step++)
+		{
+			currentTime += TIME_STEP;
+			bool done = readEngine.Update(readId, dest.data());
+			uint32 deliveredCount = done ? count : readEngine.GetDeliveredCount(readId);
+			if(deliveredCount < lastDeliveredCount)
+			{
+				printf("Failed: delivered sector count went backwards.\r\n");
+				succeeded = false;
+				break;
+			}
+			partialDeliverySeen |= (deliveredCount != 0) && (deliveredCount != count);
+			succeeded &= CheckSectors(dest, image, sector, deliveredCount, count);
+			lastDeliveredCount = deliveredCount;
+			if(done) break;
+		}
+		if(lastDeliveredCount != count)
+		{
+			printf("Failed: request never completed.\r\n");
+			succeeded = false;
+		}
+		if(!partialDeliverySeen)
+		{
+			printf("Failed: request was delivered all at once.\r\n");
+			succeeded = false;
+		}
+	}
+
+	{
+		//Completing a request doesn't wait for the drive, everything is there when it returns
+		const uint32 sector = 0x600;
+		const uint32 count = 0x80;
+		std::vector<uint8> dest(count * SECTOR_SIZE, UNTOUCHED_BYTE);
+		auto readId = readEngine.BeginRead(sector, count);
+		readEngine.Complete(readId, dest.data());
+		succeeded &= CheckSectors(dest, image, sector, count, count);
+		if(!readEngine.Update(readId, dest.data()))
+		{
+			printf("Failed: completed request is still around.\r\n");
+			succeeded = false;
+		}
+	}
+
+	{
+		//Cancelled requests don't deliver anything, even once their time has come
+		const uint32 sector = 0x200;
+		const uint32 count = 0x100;
+		std::vector<uint8> dest(count * SECTOR_SIZE, UNTOUCHED_BYTE);
+		auto readId = readEngine.BeginRead(sector, count);
+		readEngine.Cancel(readId);
+		currentTime += PS2::IOP_CLOCK_OVER_FREQ;
+		if(!readEngine.Update(readId, dest.data()) || (readEngine.GetDeliveredCount(readId) != 0))
+		{
+			printf("Failed: cancelled request is still around.\r\n");
+			succeeded = false;
+		}
+		succeeded &= CheckSectors(dest, image, sector, 0, count);
+
+		//Engine keeps serving requests after a cancel
+		auto nextReadId = readEngine.BeginRead(sector, count);
+		readEngine.Complete(nextReadId, dest.data());
+		succeeded &= CheckSectors(dest, image, sector, count, count);
+	}
+
+	{
+		//Without media, sectors read as zeroes
+		const uint32 count = 0x10;
+		readEngine.SetOpticalMedia(nullptr);
+		std::vector<uint8> dest(count * SECTOR_SIZE, UNTOUCHED_BYTE);
+		auto readId = readEngine.BeginRead(0, count);
+		readEngine.Complete(readId, dest.data());
+		for(auto value : dest)
+		{
+			if(value != 0)
+			{
+				printf("Failed: read without media didn't return zeroes.\r\n");
+				succeeded = false;
+				break;
+			}
+		}
+	}
+
+	if(succeeded)
+	{
+		printf("Passed.\r\n");
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "MemStream.h"
+#include "states/DeltaState.h"
+#include "states/MemoryStateFile.h"
+#include "zip/ZipArchiveReader.h"
+#include "zip/ZipArchiveWriter.h"
+
+//Writes random states as deltas of a base state and rebuilds them, the rebuilt state must hold exactly the
+//same files as the original one. Rebuilding must fail once the base state doesn't match the one the delta
+//was made from anymore.
+
+#define BASE_STATE_NAME "base.st0.zip"
+
+//Number of pages modified between the base state and the state
+static const uint32 DIRTY_PAGE_COUNT = 16;
+
+typedef std::vector<uint8> FileData;
+typedef std::map<std::string, FileData> FileMap;
+
+static FileData GenerateFileData(std::mt19937& random, uint32 size)
+{
+	FileData data(size);
+	for(auto& value : data)
+	{
+		value = static_cast<uint8>(random());
+	}
+	return data;
+}
+
+static FileMap GenerateBaseState(std::mt19937& random)
+{
+	FileMap files;
+	files["memory/ram"] = GenerateFileData(random, 0x40000);
+	//Last page isn't full
+	files["memory/vram"] = GenerateFileData(random, 0x20000 + 0x123);
+	files["memory/resized"] = GenerateFileData(random, 0x8000);
+	files["memory/removed"] = GenerateFileData(random, 0x2000);
+	//Files smaller than a page are never stored as deltas
+	files["registers"] = GenerateFileData(random, 0x200);
+	return files;
+}
+
+static FileMap GenerateState(std::mt19937& random, const FileMap& baseFiles)
+{
+	auto files = baseFiles;
+	for(uint32 i = 0; i < DIRTY_PAGE_COUNT; i++)
+	{
+		auto& data = (random() & 1) ? files["memory/ram"] : files["memory/vram"];
+		uint32 pageOffset = (random() % ((data.size() + CDeltaState::PAGE_SIZE - 1) / CDeltaState::PAGE_SIZE)) * CDeltaState::PAGE_SIZE;
+		uint32 pageSize = std::min<uint32>(CDeltaState::PAGE_SIZE, static_cast<uint32>(data.size()) - pageOffset);
+		data[pageOffset + (random() % pageSize)] ^= 0xFF;
+	}
+	files["memory/resized"] = GenerateFileData(random, 0x9000);
+	files.erase("memory/removed");
+	files["memory/added"] = GenerateFileData(random, 0x3000);
+	files["registers"] = GenerateFileData(random, 0x200);
+	return files;
+}
+
+static void WriteArchive(Framework::CStream& stream, const FileMap& files)
+{
+	Framework::CZipArchiveWriter archive;
+	for(const auto& filePair : files)
+	{
+		archive.InsertFile(new CMemoryStateFile(filePair.first.c_str(), filePair.second));
+	}
+	archive.Write(stream);
+	stream.Seek(0, Framework::STREAM_SEEK_DIRECTION::STREAM_SEEK_SET);
+}
+
+static FileMap ReadArchive(Framework::CZipArchiveReader& archive)
+{
+	FileMap files;
+	for(const auto& fileHeader : archive.GetFileHeaders())
+	{
+		FileData data(fileHeader.second.uncompressedSize);
+		if(!data.empty())
+		{
+			archive.BeginReadFile(fileHeader.first.c_str())->Read(data.data(), data.size());
+		}
+		files[fileHeader.first] = std::move(data);
+	}
+	return files;
+}
+
+static bool RunIteration(std::mt19937& random, uint32 iteration)
+{
+	auto baseFiles = GenerateBaseState(random);
+	auto stateFiles = GenerateState(random, baseFiles);
+
+	Framework::CMemStream baseStream;
+	WriteArchive(baseStream, baseFiles);
+	Framework::CZipArchiveReader baseArchive(baseStream);
+
+	Framework::CMemStream stateStream;
+	WriteArchive(stateStream, stateFiles);
+	Framework::CZipArchiveReader stateArchive(stateStream);
+
+	Framework::CMemStream deltaStream;
+	CDeltaState::Write(deltaStream, stateArchive, baseArchive, BASE_STATE_NAME);
+	deltaStream.Seek(0, Framework::STREAM_SEEK_DIRECTION::STREAM_SEEK_SET);
+	Framework::CZipArchiveReader deltaArchive(deltaStream);
+
+	if(!CDeltaState::IsDeltaState(deltaArchive) || CDeltaState::IsDeltaState(stateArchive) ||
+	   (CDeltaState::GetBaseStateName(deltaArchive) != BASE_STATE_NAME))
+	{
+		printf("Failed: delta state wasn't recognized (iteration %d).\r\n", iteration);
+		return false;
+	}
+	if(deltaStream.GetSize() >= stateStream.GetSize())
+	{
+		printf("Failed: delta state isn't smaller than the state (iteration %d).\r\n", iteration);
+		return false;
+	}
+
+	Framework::CMemStream rebuiltStream;
+	CDeltaState::Rebuild(rebuiltStream, deltaArchive, baseArchive);
+	rebuiltStream.Seek(0, Framework::STREAM_SEEK_DIRECTION::STREAM_SEEK_SET);
+	Framework::CZipArchiveReader rebuiltArchive(rebuiltStream);
+	if(ReadArchive(rebuiltArchive) != stateFiles)
+	{
+		printf("Failed: rebuilt state doesn't match the state (iteration %d).\r\n", iteration);
+		return false;
+	}
+
+	//A single byte changed anywhere in a file of the base state is enough to make it unusable
+	auto changedBaseFiles = baseFiles;
+	changedBaseFiles["memory/ram"][random() % changedBaseFiles["memory/ram"].size()] ^= 0x01;
+	Framework::CMemStream changedBaseStream;
+	WriteArchive(changedBaseStream, changedBaseFiles);
+	Framework::CZipArchiveReader changedBaseArchive(changedBaseStream);
+	try
+	{
+		Framework::CMemStream rejectedStream;
+		CDeltaState::Rebuild(rejectedStream, deltaArchive, changedBaseArchive);
+		printf("Failed: delta state was rebuilt from a changed base state (iteration %d).\r\n", iteration);
+		return false;
+	}
+	catch(const CDeltaState::CBaseStateMismatchException&)
+	{
+	}
+
+	return true;
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 iterationCount = 4;
+	if(argc > 1) iterationCount = atoi(argv[1]);
+	if(iterationCount == 0)
+	{
+		printf("Usage: DeltaStateTest [iterationCount]\r\n");
+		return -1;
+	}
+
+	std::mt19937 random;
+	for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+	{
+		if(!RunIteration(random, iteration))
+		{
+			return 1;
+		}
+	}
+
+	printf("Passed.\r\n");
+	return 0;
+}
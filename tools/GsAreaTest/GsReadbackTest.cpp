@@ -0,0 +1,112 @@
+#include "GsReadbackTest.h"
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "gs/GSH_Null.h"
+#include "gs/GsPixelFormats.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <signal.h>
+#include <sys/mman.h>
+#define HAS_WRITE_PROTECTION
+#endif
+
+static const uint32 TRANSFER_WIDTH = 64;
+static const uint32 TRANSFER_HEIGHT = 32;
+static const uint32 TRANSFER_SIZE = TRANSFER_WIDTH * TRANSFER_HEIGHT * sizeof(uint32);
+
+#ifdef HAS_WRITE_PROTECTION
+
+static uint8* s_protectedBuffer = nullptr;
+static std::thread::id s_faultThreadId;
+
+static void HandleFault(int, siginfo_t* info, void*)
+{
+	auto address = reinterpret_cast<uint8*>(info->si_addr);
+	if((address < s_protectedBuffer) || (address >= (s_protectedBuffer + TRANSFER_SIZE)))
+	{
+		abort();
+	}
+	s_faultThreadId = std::this_thread::get_id();
+	mprotect(s_protectedBuffer, TRANSFER_SIZE, PROT_READ | PROT_WRITE);
+}
+
+#endif
+
+static void ReadImage(CGSHandler& gs, void* buffer)
+{
+	auto bltBuf = make_convertible<CGSHandler::BITBLTBUF>(0);
+	bltBuf.nSrcPsm = CGSHandler::PSMCT32;
+	bltBuf.nSrcPtr = 0;
+	bltBuf.nSrcWidth = TRANSFER_WIDTH / 0x40;
+
+	auto trxReg = make_convertible<CGSHandler::TRXREG>(0);
+	trxReg.nRRW = TRANSFER_WIDTH;
+	trxReg.nRRH = TRANSFER_HEIGHT;
+
+	gs.WriteRegister(GS_REG_BITBLTBUF, bltBuf);
+	gs.WriteRegister(GS_REG_TRXPOS, 0);
+	gs.WriteRegister(GS_REG_TRXREG, trxReg);
+	gs.WriteRegister(GS_REG_TRXDIR, 1);
+	gs.ReadImageData(buffer, TRANSFER_SIZE);
+}
+
+void CGsReadbackTest::Execute()
+{
+	auto gs = std::make_unique<CGSH_Null>();
+
+	CGsPixelFormats::CPixelIndexorPSMCT32 indexor(gs->GetRam(), 0, TRANSFER_WIDTH / 0x40);
+	for(uint32 y = 0; y < TRANSFER_HEIGHT; y++)
+	{
+		for(uint32 x = 0; x < TRANSFER_WIDTH; x++)
+		{
+			indexor.SetPixel(x, y, (y << 16) | x);
+		}
+	}
+
+	auto checkImage =
+	    [](const uint32* pixels) {
+		    for(uint32 y = 0; y < TRANSFER_HEIGHT; y++)
+		    {
+			    for(uint32 x = 0; x < TRANSFER_WIDTH; x++)
+			    {
+				    TEST_VERIFY(pixels[x + (y * TRANSFER_WIDTH)] == ((y << 16) | x));
+			    }
+		    }
+	    };
+
+	{
+		std::vector<uint32> pixels(TRANSFER_WIDTH * TRANSFER_HEIGHT);
+		ReadImage(*gs, pixels.data());
+		checkImage(pixels.data());
+	}
+
+#ifdef HAS_WRITE_PROTECTION
+	{
+		void* buffer = mmap(nullptr, TRANSFER_SIZE, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		TEST_VERIFY(buffer != MAP_FAILED);
+		s_protectedBuffer = reinterpret_cast<uint8*>(buffer);
+		s_faultThreadId = std::thread::id();
+
+		struct sigaction faultAction = {};
+		faultAction.sa_sigaction = &HandleFault;
+		faultAction.sa_flags = SA_SIGINFO;
+		sigemptyset(&faultAction.sa_mask);
+		struct sigaction prevSegvAction = {};
+		struct sigaction prevBusAction = {};
+		sigaction(SIGSEGV, &faultAction, &prevSegvAction);
+		sigaction(SIGBUS, &faultAction, &prevBusAction);
+
+		ReadImage(*gs, buffer);
+
+		sigaction(SIGSEGV, &prevSegvAction, nullptr);
+		sigaction(SIGBUS, &prevBusAction, nullptr);
+
+		TEST_VERIFY(s_faultThreadId == std::this_thread::get_id());
+		checkImage(reinterpret_cast<const uint32*>(buffer));
+		munmap(buffer, TRANSFER_SIZE);
+		s_protectedBuffer = nullptr;
+	}
+#endif
+}
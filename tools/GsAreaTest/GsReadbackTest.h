@@ -0,0 +1,11 @@
+#pragma once
+
+#include "Test.h"
+
+//Local to host transfers must only write to the destination from the thread that asked for the data,
+//the destination might be write protected (ie.: EE RAM while rewind is tracking writes)
+class CGsReadbackTest : public CTest
+{
+public:
+	void Execute() override;
+};
@@ -0,0 +1,62 @@
+#include <chrono>
+#include <cstdio>
+#include "GsTextureCacheBenchmark.h"
+#include "gs/GsTextureCache.h"
+#include "gs/GsPixelFormats.h"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+void CGsTextureCacheBenchmark::Execute()
+{
+	static const uint32 textureCount = CGsTextureCache<uint32>::DEFAULT_TEXTURE_CACHE_SIZE;
+	static const uint32 iterationCount = 10000;
+
+	CGsTextureCache<uint32> cache;
+
+	//Fill the cache with 64x64 textures spread over GS memory
+	CGSHandler::TEX0 tex0s[textureCount];
+	for(uint32 i = 0; i < textureCount; i++)
+	{
+		auto tex0 = make_convertible<CGSHandler::TEX0>(0);
+		tex0.nPsm = CGSHandler::PSMCT32;
+		tex0.nBufPtr = (i * 2 * CGsPixelFormats::PAGESIZE) / 0x100;
+		tex0.nBufWidth = 1;
+		tex0.nWidth = 6;
+		tex0.nPad0 = 2;
+		tex0.nPad1 = 1;
+		tex0s[i] = tex0;
+		cache.Insert(tex0, i);
+	}
+
+	uint32 hitCount = 0;
+	auto searchStart = Clock::now();
+	for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+	{
+		for(uint32 i = 0; i < textureCount; i++)
+		{
+			//Jump around to not only hit the head of the LRU list
+			uint32 index = (i * 97) % textureCount;
+			if(cache.Search(tex0s[index])) hitCount++;
+		}
+	}
+	auto searchEnd = Clock::now();
+	TEST_VERIFY(hitCount == (textureCount * iterationCount));
+
+	//Small transfers, as done by games uploading CLUTs or small textures
+	auto invalidateStart = Clock::now();
+	for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+	{
+		for(uint32 i = 0; i < 16; i++)
+		{
+			uint32 address = ((iteration * 16) + i) * 0x2000 % CGSHandler::RAMSIZE;
+			cache.InvalidateRange(address, 0x400);
+		}
+	}
+	auto invalidateEnd = Clock::now();
+
+	auto searchTime = std::chrono::duration_cast<std::chrono::microseconds>(searchEnd - searchStart).count();
+	auto invalidateTime = std::chrono::duration_cast<std::chrono::microseconds>(invalidateEnd - invalidateStart).count();
+	printf("Texture cache: %d searches in %dus, %d invalidations in %dus.\r\n",
+	       textureCount * iterationCount, static_cast<int>(searchTime),
+	       16 * iterationCount, static_cast<int>(invalidateTime));
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "Test.h"
+
+//Measures lookup and invalidation throughput of the texture cache with a full cache
+class CGsTextureCacheBenchmark : public CTest
+{
+public:
+	void Execute() override;
+};
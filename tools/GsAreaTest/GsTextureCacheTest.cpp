@@ -0,0 +1,143 @@
+#include "GsTextureCacheTest.h"
+#include "gs/GsTextureCache.h"
+#include "gs/GsPixelFormats.h"
+
+typedef CGsTextureCache<uint32> TextureCache;
+
+static CGSHandler::TEX0 MakeTex0(uint32 psm, uint32 bufPtr, uint32 bufWidth, uint32 widthLog2, uint32 heightLog2)
+{
+	auto tex0 = make_convertible<CGSHandler::TEX0>(0);
+	tex0.nPsm = psm;
+	tex0.nBufPtr = bufPtr / 0x100;
+	tex0.nBufWidth = bufWidth / 0x40;
+	tex0.nWidth = widthLog2;
+	tex0.nPad0 = heightLog2 & 0x03;
+	tex0.nPad1 = heightLog2 >> 2;
+	return tex0;
+}
+
+void CGsTextureCacheTest::Execute()
+{
+	CheckSearchInsert();
+	CheckLruEviction();
+	CheckInvalidateRange();
+	CheckCapacityChange();
+}
+
+void CGsTextureCacheTest::CheckSearchInsert()
+{
+	TextureCache cache;
+	auto tex0 = MakeTex0(CGSHandler::PSMCT32, 0x100000, 256, 8, 8);
+	TEST_VERIFY(cache.Search(tex0) == nullptr);
+
+	auto texture = cache.Insert(tex0, 1);
+	TEST_VERIFY(texture != nullptr);
+	TEST_VERIFY(texture->m_live);
+	TEST_VERIFY(cache.Search(tex0) == texture);
+
+	//CLUT info is not part of the key
+	auto clutTex0 = tex0;
+	clutTex0.nCBP = 0x100;
+	clutTex0.nCLD = 1;
+	TEST_VERIFY(cache.Search(clutTex0) == texture);
+
+	//Inserting an existing key replaces the texture
+	auto replacedTexture = cache.Insert(tex0, 2);
+	TEST_VERIFY(replacedTexture == texture);
+	TEST_VERIFY(replacedTexture->m_textureHandle == 2);
+
+	cache.Flush();
+	TEST_VERIFY(cache.Search(tex0) == nullptr);
+}
+
+void CGsTextureCacheTest::CheckLruEviction()
+{
+	static const uint32 capacity = 4;
+	TextureCache cache(capacity);
+
+	CGSHandler::TEX0 tex0s[capacity + 1];
+	for(uint32 i = 0; i < (capacity + 1); i++)
+	{
+		tex0s[i] = MakeTex0(CGSHandler::PSMCT32, i * CGsPixelFormats::PAGESIZE, 64, 6, 5);
+	}
+
+	for(uint32 i = 0; i < capacity; i++)
+	{
+		cache.Insert(tex0s[i], i + 1);
+	}
+
+	//Use the first texture, the second one becomes the least recently used
+	TEST_VERIFY(cache.Search(tex0s[0]) != nullptr);
+	cache.Insert(tex0s[capacity], capacity + 1);
+
+	TEST_VERIFY(cache.Search(tex0s[0]) != nullptr);
+	TEST_VERIFY(cache.Search(tex0s[1]) == nullptr);
+	for(uint32 i = 2; i < (capacity + 1); i++)
+	{
+		TEST_VERIFY(cache.Search(tex0s[i]) != nullptr);
+	}
+}
+
+void CGsTextureCacheTest::CheckInvalidateRange()
+{
+	TextureCache cache;
+
+	//One page each, far away from each other
+	auto tex0A = MakeTex0(CGSHandler::PSMCT32, 0x000000, 64, 6, 5);
+	auto tex0B = MakeTex0(CGSHandler::PSMCT32, 0x200000, 64, 6, 5);
+	auto textureA = cache.Insert(tex0A, 1);
+	auto textureB = cache.Insert(tex0B, 2);
+	TEST_VERIFY(!textureA->m_cachedArea.HasDirtyPages());
+	TEST_VERIFY(!textureB->m_cachedArea.HasDirtyPages());
+
+	cache.InvalidateRange(0x200000, 0x100);
+	TEST_VERIFY(!textureA->m_cachedArea.HasDirtyPages());
+	TEST_VERIFY(textureB->m_cachedArea.HasDirtyPages());
+	textureB->m_cachedArea.ClearDirtyPages();
+
+	//Range ending right before a texture doesn't touch it
+	cache.InvalidateRange(0x1FE000, CGsPixelFormats::PAGESIZE);
+	TEST_VERIFY(!textureA->m_cachedArea.HasDirtyPages());
+	TEST_VERIFY(!textureB->m_cachedArea.HasDirtyPages());
+
+	cache.InvalidateRange(0, CGSHandler::RAMSIZE);
+	TEST_VERIFY(textureA->m_cachedArea.HasDirtyPages());
+	TEST_VERIFY(textureB->m_cachedArea.HasDirtyPages());
+	textureA->m_cachedArea.ClearDirtyPages();
+	textureB->m_cachedArea.ClearDirtyPages();
+
+	//Evicted textures are not visited anymore
+	cache.Flush();
+	cache.InvalidateRange(0, CGSHandler::RAMSIZE);
+	TEST_VERIFY(!textureA->m_cachedArea.HasDirtyPages());
+	TEST_VERIFY(!textureB->m_cachedArea.HasDirtyPages());
+}
+
+void CGsTextureCacheTest::CheckCapacityChange()
+{
+	TextureCache cache(16);
+	TEST_VERIFY(cache.GetCapacity() == 16);
+
+	auto tex0 = MakeTex0(CGSHandler::PSMT8, 0x80000, 128, 7, 7);
+	cache.Insert(tex0, 1);
+	cache.SetCapacity(100);
+	TEST_VERIFY(cache.GetCapacity() == 100);
+	TEST_VERIFY(cache.Search(tex0) == nullptr);
+
+	//Textures beyond the first 64 use another word of the page masks
+	for(uint32 i = 0; i < 100; i++)
+	{
+		cache.Insert(MakeTex0(CGSHandler::PSMCT32, i * CGsPixelFormats::PAGESIZE, 64, 6, 5), i);
+	}
+	for(uint32 target = 0; target < 100; target += 33)
+	{
+		cache.InvalidateRange(target * CGsPixelFormats::PAGESIZE, 0x100);
+		for(uint32 i = 0; i < 100; i++)
+		{
+			auto texture = cache.Search(MakeTex0(CGSHandler::PSMCT32, i * CGsPixelFormats::PAGESIZE, 64, 6, 5));
+			TEST_VERIFY(texture != nullptr);
+			TEST_VERIFY(texture->m_cachedArea.HasDirtyPages() == (i == target));
+			texture->m_cachedArea.ClearDirtyPages();
+		}
+	}
+}
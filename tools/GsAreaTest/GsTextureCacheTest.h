@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Test.h"
+
+class CGsTextureCacheTest : public CTest
+{
+public:
+	void Execute() override;
+
+private:
+	void CheckSearchInsert();
+	void CheckLruEviction();
+	void CheckInvalidateRange();
+	void CheckCapacityChange();
+};
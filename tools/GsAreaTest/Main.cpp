@@ -1,5 +1,8 @@
 #include <functional>
 #include "GsCachedAreaTest.h"
+#include "GsReadbackTest.h"
+#include "GsTextureCacheBenchmark.h"
+#include "GsTextureCacheTest.h"
 #include "GsTransferInvalidationTest.h"
 
 typedef std::function<CTest*()> TestFactoryFunction;
@@ -8,7 +11,10 @@ typedef std::function<CTest*()> TestFactoryFunction;
 static const TestFactoryFunction s_factories[] =
 {
 	[]() { return new CGsCachedAreaTest(); },
-	[]() { return new CGsTransferInvalidationTest(); }
+	[]() { return new CGsReadbackTest(); },
+	[]() { return new CGsTextureCacheTest(); },
+	[]() { return new CGsTransferInvalidationTest(); },
+	[]() { return new CGsTextureCacheBenchmark(); }
 };
 // clang-format on
 
@@ -0,0 +1,227 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "FrameDump.h"
+#include "filesystem_def.h"
+#include "StdStreamUtils.h"
+#include "gs/GSH_Null.h"
+#include "gs/GSH_Software.h"
+
+//Replays frame dumps (captured by the Qt UI or by AutoTest's --framedump option) against a GS handler
+//in a loop and reports how long each frame takes to go through it. Handlers needing a window (OpenGL,
+//Direct3D) are left out, the software renderer is the closest stand-in for them.
+
+#define GS_HANDLER_NAME_NULL "null"
+#define GS_HANDLER_NAME_SOFTWARE "software"
+
+#define DEFAULT_GS_HANDLER_NAME GS_HANDLER_NAME_NULL
+
+static const uint32 DEFAULT_ITERATION_COUNT = 100;
+
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::unique_ptr<CGSHandler> GsHandlerPtr;
+
+struct REPLAY_STATS
+{
+	double totalTime = 0;
+	double minTime = 0;
+	double maxTime = 0;
+	uint32 drawCallCount = 0;
+	CGSHandler::TEXTURECACHE_STATS textureCacheStats;
+};
+
+static CGSHandler::FactoryFunction GetGsHandlerFactoryFunction(const std::string& gsHandlerName)
+{
+	if(gsHandlerName == GS_HANDLER_NAME_NULL)
+	{
+		return CGSH_Null::GetFactoryFunction();
+	}
+	else if(gsHandlerName == GS_HANDLER_NAME_SOFTWARE)
+	{
+		return CGSH_Software::GetFactoryFunction();
+	}
+	else
+	{
+		return CGSHandler::FactoryFunction();
+	}
+}
+
+static void ReplayFrame(CGSHandler* gs, CFrameDump& frameDump)
+{
+	gs->Reset();
+
+	memcpy(gs->GetRam(), frameDump.GetInitialGsRam(), CGSHandler::RAMSIZE);
+	memcpy(gs->GetRegisters(), frameDump.GetInitialGsRegisters(), CGSHandler::REGISTER_MAX * sizeof(uint64));
+	gs->SetSMODE2(frameDump.GetInitialSMODE2());
+
+	CGsPacket::RegisterWriteArray registerWrites;
+	for(const auto& packet : frameDump.GetPackets())
+	{
+		if(packet.registerWrites.empty())
+		{
+			gs->WriteRegisterMassively(registerWrites, nullptr);
+			registerWrites.clear();
+			gs->FeedImageData(packet.imageData.data(), static_cast<uint32>(packet.imageData.size()));
+		}
+		else
+		{
+			registerWrites.insert(std::end(registerWrites), std::begin(packet.registerWrites), std::end(packet.registerWrites));
+		}
+	}
+	gs->WriteRegisterMassively(registerWrites, nullptr);
+
+	//Flip waits for the GS thread to be done with everything that was sent
+	gs->Flip();
+}
+
+static REPLAY_STATS ReplayFrameDump(CGSHandler* gs, CFrameDump& frameDump, uint32 iterationCount)
+{
+	REPLAY_STATS stats;
+
+	uint32 drawCallCount = 0;
+	auto newFrameConnection = gs->OnNewFrame.Connect(
+	    [&drawCallCount](uint32 frameDrawCallCount) {
+		    drawCallCount = frameDrawCallCount;
+	    });
+
+	//First run warms up the handler's caches and isn't measured
+	ReplayFrame(gs, frameDump);
+	auto startTextureCacheStats = gs->GetTextureCacheStats();
+
+	for(uint32 i = 0; i < iterationCount; i++)
+	{
+		auto startTime = Clock::now();
+		ReplayFrame(gs, frameDump);
+		auto endTime = Clock::now();
+
+		double frameTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		stats.totalTime += frameTime;
+		stats.minTime = (i == 0) ? frameTime : std::min(stats.minTime, frameTime);
+		stats.maxTime = std::max(stats.maxTime, frameTime);
+	}
+
+	auto endTextureCacheStats = gs->GetTextureCacheStats();
+	stats.textureCacheStats.hitCount = endTextureCacheStats.hitCount - startTextureCacheStats.hitCount;
+	stats.textureCacheStats.missCount = endTextureCacheStats.missCount - startTextureCacheStats.missCount;
+	stats.drawCallCount = drawCallCount;
+
+	return stats;
+}
+
+static uint64 GetTransferSize(const CFrameDump& frameDump)
+{
+	uint64 transferSize = 0;
+	for(const auto& packet : frameDump.GetPackets())
+	{
+		transferSize += packet.imageData.size();
+	}
+	return transferSize;
+}
+
+static void PrintStats(const char* dumpPath, const CFrameDump& frameDump, const REPLAY_STATS& stats, uint32 iterationCount)
+{
+	printf("%s\r\n", dumpPath);
+	printf("  %-16s avg %.3fms, min %.3fms, max %.3fms (%d iterations)\r\n", "frame time:",
+	       stats.totalTime / iterationCount, stats.minTime, stats.maxTime, iterationCount);
+	printf("  %-16s %d (%d drawing kicks)\r\n", "draw calls:",
+	       stats.drawCallCount, static_cast<uint32>(frameDump.GetDrawingKicks().size()));
+	printf("  %-16s %llu bytes in %d packets\r\n", "transfers:",
+	       static_cast<unsigned long long>(GetTransferSize(frameDump)), static_cast<uint32>(frameDump.GetPackets().size()));
+
+	uint64 lookupCount = stats.textureCacheStats.hitCount + stats.textureCacheStats.missCount;
+	if(lookupCount == 0)
+	{
+		printf("  %-16s n/a\r\n", "texture cache:");
+	}
+	else
+	{
+		printf("  %-16s %.1f%% hits (%llu lookups per frame)\r\n", "texture cache:",
+		       static_cast<double>(stats.textureCacheStats.hitCount) * 100.0 / static_cast<double>(lookupCount),
+		       static_cast<unsigned long long>(lookupCount / iterationCount));
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	std::string gsHandlerName = DEFAULT_GS_HANDLER_NAME;
+	uint32 iterationCount = DEFAULT_ITERATION_COUNT;
+	std::vector<const char*> dumpPaths;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--gshandler"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: GS handler name must be specified for --gshandler option.\r\n");
+				return -1;
+			}
+			gsHandlerName = argv[i + 1];
+			i++;
+		}
+		else if(!strcmp(argv[i], "--iterations"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Iteration count must be specified for --iterations option.\r\n");
+				return -1;
+			}
+			iterationCount = std::max(atoi(argv[i + 1]), 1);
+			i++;
+		}
+		else
+		{
+			dumpPaths.push_back(argv[i]);
+		}
+	}
+
+	if(dumpPaths.empty())
+	{
+		printf("Usage: GsReplay [options] dumpPath...\r\n");
+		printf("Options: \r\n");
+		printf("\t --gshandler <%s|%s>\t Selects which GS handler to replay against (default is '%s').\r\n",
+		       GS_HANDLER_NAME_NULL, GS_HANDLER_NAME_SOFTWARE, DEFAULT_GS_HANDLER_NAME);
+		printf("\t --iterations <count>\t Number of times each frame is replayed (default is %d).\r\n", DEFAULT_ITERATION_COUNT);
+		return -1;
+	}
+
+	auto gsHandlerFactory = GetGsHandlerFactoryFunction(gsHandlerName);
+	if(!gsHandlerFactory)
+	{
+		printf("Error: Invalid GS handler name '%s'.\r\n", gsHandlerName.c_str());
+		return -1;
+	}
+
+	GsHandlerPtr gs(gsHandlerFactory());
+	gs->Initialize();
+
+	int result = 0;
+	for(const auto& dumpPath : dumpPaths)
+	{
+		try
+		{
+			CFrameDump frameDump;
+			{
+				auto inputStream = Framework::CreateInputStdStream(fs::path(dumpPath).native());
+				frameDump.Read(inputStream);
+			}
+			frameDump.IdentifyDrawingKicks();
+
+			auto stats = ReplayFrameDump(gs.get(), frameDump, iterationCount);
+			PrintStats(dumpPath, frameDump, stats, iterationCount);
+		}
+		catch(const std::exception& exception)
+		{
+			printf("Error: Failed to replay '%s': %s\r\n", dumpPath, exception.what());
+			result = -1;
+		}
+	}
+
+	gs->Release();
+	return result;
+}
@@ -0,0 +1,365 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <vector>
+#include "gs/GsBlockSwizzle.h"
+#include "gs/GsPixelFormats.h"
+
+//Checks that the block swizzle kernels and the rectangle functions of CPixelIndexor give the exact same results
+//as reading and writing pixels one at a time, then measures the throughput of every kernel set.
+
+static const uint32 SAMPLE_COUNT = 0x1000;
+static const uint32 RECT_TEST_COUNT = 0x80;
+
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::vector<uint8> RamBuffer;
+
+static RamBuffer GenerateRam(std::mt19937& random)
+{
+	RamBuffer ram(CGSHandler::RAMSIZE);
+	for(auto& value : ram)
+	{
+		value = static_cast<uint8>(random());
+	}
+	return ram;
+}
+
+template <typename Storage>
+static typename Storage::Unit GeneratePixel(std::mt19937& random)
+{
+	auto pixel = static_cast<typename Storage::Unit>(random());
+	if(static_cast<uint32>(Storage::BLOCKFORMAT) == GsBlockSwizzle::BLOCK_FORMAT_4)
+	{
+		pixel &= 0x0F;
+	}
+	return pixel;
+}
+
+static uint32 GenerateBlockPointer(std::mt19937& random)
+{
+	return (random() % (CGSHandler::RAMSIZE / CGsPixelFormats::BLOCKSIZE)) * CGsPixelFormats::BLOCKSIZE;
+}
+
+//Reads and writes the first block of a buffer placed at a random block with the kernels and with the indexor
+template <typename Storage>
+static bool CheckBlockKernels(const GsBlockSwizzle::KERNELS& kernels, std::mt19937& random, const RamBuffer& ram)
+{
+	typedef typename Storage::Unit Unit;
+	static const uint32 pixelCount = Storage::BLOCKWIDTH * Storage::BLOCKHEIGHT;
+
+	auto readRam = ram;
+	auto kernelRam = ram;
+	auto indexorRam = ram;
+
+	for(uint32 i = 0; i < SAMPLE_COUNT; i++)
+	{
+		uint32 blockPointer = GenerateBlockPointer(random);
+
+		Unit kernelPixels[pixelCount];
+		kernels.readBlock[Storage::BLOCKFORMAT](readRam.data() + blockPointer, kernelPixels, Storage::BLOCKWIDTH);
+
+		CGsPixelFormats::CPixelIndexor<Storage> readIndexor(readRam.data(), blockPointer, 1);
+		for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+		{
+			for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+			{
+				if(kernelPixels[x + (y * Storage::BLOCKWIDTH)] != readIndexor.GetPixel(x, y))
+				{
+					printf("%s read kernel for block format %d gives a wrong pixel at (%d, %d).\r\n",
+					       kernels.name, Storage::BLOCKFORMAT, x, y);
+					return false;
+				}
+			}
+		}
+
+		Unit newPixels[pixelCount];
+		for(auto& pixel : newPixels)
+		{
+			pixel = GeneratePixel<Storage>(random);
+		}
+
+		bool changed = kernels.writeBlock[Storage::BLOCKFORMAT](kernelRam.data() + blockPointer, newPixels, Storage::BLOCKWIDTH);
+
+		bool expectedChanged = false;
+		CGsPixelFormats::CPixelIndexor<Storage> writeIndexor(indexorRam.data(), blockPointer, 1);
+		for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+		{
+			for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+			{
+				auto pixel = newPixels[x + (y * Storage::BLOCKWIDTH)];
+				if(writeIndexor.GetPixel(x, y) != pixel)
+				{
+					writeIndexor.SetPixel(x, y, pixel);
+					expectedChanged = true;
+				}
+			}
+		}
+
+		if(memcmp(kernelRam.data() + blockPointer, indexorRam.data() + blockPointer, CGsPixelFormats::BLOCKSIZE) || (changed != expectedChanged))
+		{
+			printf("%s write kernel for block format %d gives wrong results.\r\n", kernels.name, Storage::BLOCKFORMAT);
+			return false;
+		}
+
+		//Writing the same pixels again must not report any change
+		if(kernels.writeBlock[Storage::BLOCKFORMAT](kernelRam.data() + blockPointer, newPixels, Storage::BLOCKWIDTH))
+		{
+			printf("%s write kernel for block format %d reports changes when there are none.\r\n", kernels.name, Storage::BLOCKFORMAT);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//Reads and writes rectangles that are not aligned on blocks, some of them wrapping around at 2048
+template <typename Storage>
+static bool CheckRects(const char* psmName, std::mt19937& random, const RamBuffer& ram)
+{
+	typedef typename Storage::Unit Unit;
+
+	auto rectRam = ram;
+	auto indexorRam = ram;
+
+	for(uint32 i = 0; i < RECT_TEST_COUNT; i++)
+	{
+		//Buffer widths are kept even so that pages of 4-bit and 8-bit formats are whole
+		uint32 bufPointer = GenerateBlockPointer(random);
+		uint32 bufWidth = ((random() % 16) + 1) * 2;
+		uint32 bufPixelWidth = bufWidth * 64;
+
+		//Stay inside of the buffer's width unless the buffer is as wide as the transfer area,
+		//otherwise pixels on the right would alias pixels of the next rows of pages
+		uint32 x = random() % bufPixelWidth;
+		uint32 y = random() % 2048;
+		uint32 width = (random() % 256) + 1;
+		uint32 height = (random() % 128) + 1;
+		if(bufPixelWidth != 2048)
+		{
+			width = std::min(width, bufPixelWidth - x);
+		}
+
+		CGsPixelFormats::CPixelIndexor<Storage> rectIndexor(rectRam.data(), bufPointer, bufWidth);
+		CGsPixelFormats::CPixelIndexor<Storage> indexor(indexorRam.data(), bufPointer, bufWidth);
+
+		std::vector<Unit> pixels(width * height);
+		rectIndexor.ReadRect(x, y, width, height, pixels.data(), width);
+		for(uint32 rectY = 0; rectY < height; rectY++)
+		{
+			for(uint32 rectX = 0; rectX < width; rectX++)
+			{
+				if(pixels[rectX + (rectY * width)] != indexor.GetPixel((x + rectX) % 2048, (y + rectY) % 2048))
+				{
+					printf("%s ReadRect gives a wrong pixel at (%d, %d) in rect (%d, %d, %d, %d).\r\n",
+					       psmName, rectX, rectY, x, y, width, height);
+					return false;
+				}
+			}
+		}
+
+		for(auto& pixel : pixels)
+		{
+			pixel = GeneratePixel<Storage>(random);
+		}
+
+		bool changed = rectIndexor.WriteRect(x, y, width, height, pixels.data(), width);
+
+		bool expectedChanged = false;
+		for(uint32 rectY = 0; rectY < height; rectY++)
+		{
+			for(uint32 rectX = 0; rectX < width; rectX++)
+			{
+				uint32 pixelX = (x + rectX) % 2048;
+				uint32 pixelY = (y + rectY) % 2048;
+				auto pixel = pixels[rectX + (rectY * width)];
+				if(indexor.GetPixel(pixelX, pixelY) != pixel)
+				{
+					indexor.SetPixel(pixelX, pixelY, pixel);
+					expectedChanged = true;
+				}
+			}
+		}
+
+		if((rectRam != indexorRam) || (changed != expectedChanged))
+		{
+			printf("%s WriteRect gives wrong results in rect (%d, %d, %d, %d).\r\n", psmName, x, y, width, height);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool CheckKernels(const GsBlockSwizzle::KERNELS& kernels, std::mt19937& random, const RamBuffer& ram)
+{
+	bool succeeded = true;
+	succeeded &= CheckBlockKernels<CGsPixelFormats::STORAGEPSMCT32>(kernels, random, ram);
+	succeeded &= CheckBlockKernels<CGsPixelFormats::STORAGEPSMCT16>(kernels, random, ram);
+	succeeded &= CheckBlockKernels<CGsPixelFormats::STORAGEPSMT8>(kernels, random, ram);
+	succeeded &= CheckBlockKernels<CGsPixelFormats::STORAGEPSMT4>(kernels, random, ram);
+	return succeeded;
+}
+
+static bool CheckAllRects(std::mt19937& random, const RamBuffer& ram)
+{
+	bool succeeded = true;
+	succeeded &= CheckRects<CGsPixelFormats::STORAGEPSMCT32>("PSMCT32", random, ram);
+	succeeded &= CheckRects<CGsPixelFormats::STORAGEPSMZ32>("PSMZ32", random, ram);
+	succeeded &= CheckRects<CGsPixelFormats::STORAGEPSMCT16>("PSMCT16", random, ram);
+	succeeded &= CheckRects<CGsPixelFormats::STORAGEPSMCT16S>("PSMCT16S", random, ram);
+	succeeded &= CheckRects<CGsPixelFormats::STORAGEPSMZ16>("PSMZ16", random, ram);
+	succeeded &= CheckRects<CGsPixelFormats::STORAGEPSMT8>("PSMT8", random, ram);
+	succeeded &= CheckRects<CGsPixelFormats::STORAGEPSMT4>("PSMT4", random, ram);
+	return succeeded;
+}
+
+static double MeasureBlocks(uint32 iterationCount, const std::vector<uint32>& blockPointers, const std::function<void(uint32)>& blockFunction)
+{
+	auto startTime = Clock::now();
+	for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+	{
+		for(auto blockPointer : blockPointers)
+		{
+			blockFunction(blockPointer);
+		}
+	}
+	auto endTime = Clock::now();
+	double duration = std::chrono::duration<double, std::nano>(endTime - startTime).count();
+	return duration / (static_cast<double>(iterationCount) * blockPointers.size());
+}
+
+struct BLOCK_DURATIONS
+{
+	double indexorRead = 0;
+	double indexorWrite = 0;
+	double scalarRead = 0;
+	double scalarWrite = 0;
+	double simdRead = 0;
+	double simdWrite = 0;
+};
+
+template <typename Storage>
+static BLOCK_DURATIONS MeasureFormat(const GsBlockSwizzle::KERNELS* simdKernels, uint32 iterationCount, const std::vector<uint32>& blockPointers, RamBuffer& ram)
+{
+	typedef typename Storage::Unit Unit;
+
+	const auto& scalarKernels = GsBlockSwizzle::GetScalarKernels();
+	Unit pixels[Storage::BLOCKWIDTH * Storage::BLOCKHEIGHT] = {};
+	volatile Unit sink = 0;
+
+	BLOCK_DURATIONS durations;
+	durations.indexorRead = MeasureBlocks(iterationCount, blockPointers, [&](uint32 blockPointer) {
+		CGsPixelFormats::CPixelIndexor<Storage> indexor(ram.data(), blockPointer, 1);
+		for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+		{
+			for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+			{
+				pixels[x + (y * Storage::BLOCKWIDTH)] = indexor.GetPixel(x, y);
+			}
+		}
+		sink = pixels[0];
+	});
+	durations.indexorWrite = MeasureBlocks(iterationCount, blockPointers, [&](uint32 blockPointer) {
+		CGsPixelFormats::CPixelIndexor<Storage> indexor(ram.data(), blockPointer, 1);
+		for(uint32 y = 0; y < Storage::BLOCKHEIGHT; y++)
+		{
+			for(uint32 x = 0; x < Storage::BLOCKWIDTH; x++)
+			{
+				indexor.SetPixel(x, y, pixels[x + (y * Storage::BLOCKWIDTH)]);
+			}
+		}
+	});
+	durations.scalarRead = MeasureBlocks(iterationCount, blockPointers, [&](uint32 blockPointer) {
+		scalarKernels.readBlock[Storage::BLOCKFORMAT](ram.data() + blockPointer, pixels, Storage::BLOCKWIDTH);
+		sink = pixels[0];
+	});
+	durations.scalarWrite = MeasureBlocks(iterationCount, blockPointers, [&](uint32 blockPointer) {
+		scalarKernels.writeBlock[Storage::BLOCKFORMAT](ram.data() + blockPointer, pixels, Storage::BLOCKWIDTH);
+	});
+	if(simdKernels)
+	{
+		durations.simdRead = MeasureBlocks(iterationCount, blockPointers, [&](uint32 blockPointer) {
+			simdKernels->readBlock[Storage::BLOCKFORMAT](ram.data() + blockPointer, pixels, Storage::BLOCKWIDTH);
+			sink = pixels[0];
+		});
+		durations.simdWrite = MeasureBlocks(iterationCount, blockPointers, [&](uint32 blockPointer) {
+			simdKernels->writeBlock[Storage::BLOCKFORMAT](ram.data() + blockPointer, pixels, Storage::BLOCKWIDTH);
+		});
+	}
+	(void)sink;
+	return durations;
+}
+
+static void PrintDurations(const char* name, const char* simdName, double indexorDuration, double scalarDuration, double simdDuration)
+{
+	if(simdName)
+	{
+		printf("%-16s per pixel: %8.2f ns/block scalar: %8.2f ns/block %s: %8.2f ns/block speedup: %.2fx\r\n",
+		       name, indexorDuration, scalarDuration, simdName, simdDuration, indexorDuration / simdDuration);
+	}
+	else
+	{
+		printf("%-16s per pixel: %8.2f ns/block scalar: %8.2f ns/block speedup: %.2fx\r\n",
+		       name, indexorDuration, scalarDuration, indexorDuration / scalarDuration);
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 iterationCount = 50;
+	if(argc > 1) iterationCount = atoi(argv[1]);
+	if(iterationCount == 0)
+	{
+		printf("Usage: GsSwizzleBenchmark [iterationCount]\r\n");
+		return -1;
+	}
+
+	const auto& scalarKernels = GsBlockSwizzle::GetScalarKernels();
+	auto simdKernels = GsBlockSwizzle::GetSimdKernels();
+
+	std::mt19937 random;
+	auto ram = GenerateRam(random);
+
+	bool succeeded = true;
+	succeeded &= CheckKernels(scalarKernels, random, ram);
+	if(simdKernels)
+	{
+		succeeded &= CheckKernels(*simdKernels, random, ram);
+	}
+	succeeded &= CheckAllRects(random, ram);
+
+	std::vector<uint32> blockPointers(SAMPLE_COUNT);
+	for(auto& blockPointer : blockPointers)
+	{
+		blockPointer = GenerateBlockPointer(random);
+	}
+
+	const char* simdName = simdKernels ? simdKernels->name : nullptr;
+	static const char* formatNames[] = {"32-bit", "16-bit", "8-bit", "4-bit"};
+	BLOCK_DURATIONS durations[GsBlockSwizzle::BLOCK_FORMAT_COUNT];
+	durations[GsBlockSwizzle::BLOCK_FORMAT_32] = MeasureFormat<CGsPixelFormats::STORAGEPSMCT32>(simdKernels, iterationCount, blockPointers, ram);
+	durations[GsBlockSwizzle::BLOCK_FORMAT_16] = MeasureFormat<CGsPixelFormats::STORAGEPSMCT16>(simdKernels, iterationCount, blockPointers, ram);
+	durations[GsBlockSwizzle::BLOCK_FORMAT_8] = MeasureFormat<CGsPixelFormats::STORAGEPSMT8>(simdKernels, iterationCount, blockPointers, ram);
+	durations[GsBlockSwizzle::BLOCK_FORMAT_4] = MeasureFormat<CGsPixelFormats::STORAGEPSMT4>(simdKernels, iterationCount, blockPointers, ram);
+
+	for(uint32 i = 0; i < GsBlockSwizzle::BLOCK_FORMAT_COUNT; i++)
+	{
+		char name[32];
+		const auto& formatDurations = durations[i];
+		snprintf(name, sizeof(name), "%s read", formatNames[i]);
+		PrintDurations(name, simdName, formatDurations.indexorRead, formatDurations.scalarRead, formatDurations.simdRead);
+		snprintf(name, sizeof(name), "%s write", formatNames[i]);
+		PrintDurations(name, simdName, formatDurations.indexorWrite, formatDurations.scalarWrite, formatDurations.simdWrite);
+	}
+
+	if(!succeeded)
+	{
+		printf("Block swizzle results differ from per pixel results.\r\n");
+	}
+
+	return succeeded ? 0 : -1;
+}
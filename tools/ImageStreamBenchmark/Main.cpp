@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "zlib.h"
+#include "stricmp.h"
+#include "MemStream.h"
+#include "StdStream.h"
+#include "CsoImageStream.h"
+#include "IszImageStream.h"
+#include "SectorCacheStream.h"
+#ifdef HAS_ZSTD
+#include "ZsiImageStream.h"
+#include "ZsiImageWriter.h"
+#endif
+
+//Measures sequential and random read throughput of disc image streams. With no image path, CSO (and ZSI
+//if available) images are generated in memory and the data read back is checked against what was compressed.
+//Images are also read through the sector cache used by the emulator, its statistics are printed after the run.
+
+static const uint32 SECTOR_SIZE = 0x800;
+static const uint32 SEQUENTIAL_READ_SIZE = 0x10 * SECTOR_SIZE;
+static const uint32 SAMPLE_FRAME_SIZE = 0x800;
+static const uint32 SAMPLE_SECTOR_COUNT = 0x8000;
+
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::unique_ptr<Framework::CStream> StreamPtr;
+
+//Fills sectors with something that compresses about as well as typical game data
+static std::vector<uint8> GenerateSampleData(std::mt19937& random)
+{
+	std::vector<uint8> data(SAMPLE_SECTOR_COUNT * SECTOR_SIZE);
+	for(uint32 i = 0; i < data.size();)
+	{
+		uint32 runSize = std::min<uint32>((random() % 64) + 1, static_cast<uint32>(data.size()) - i);
+		bool repeat = (random() % 2) == 0;
+		uint8 value = static_cast<uint8>(random());
+		for(uint32 j = 0; j < runSize; j++)
+		{
+			data[i++] = repeat ? value : static_cast<uint8>(random() & 0x0F);
+		}
+	}
+	return data;
+}
+
+static Framework::CStream* CreateSampleCso(const std::vector<uint8>& data)
+{
+	uint32 frameCount = static_cast<uint32>(data.size() / SAMPLE_FRAME_SIZE);
+	uint32 headerSize = 0x18;
+	uint32 indexSize = (frameCount + 1) * 4;
+
+	auto stream = new Framework::CMemStream();
+	stream->Write("CISO", 4);
+	stream->Write32(headerSize);
+	stream->Write64(data.size());
+	stream->Write32(SAMPLE_FRAME_SIZE);
+	stream->Write8(1);
+	stream->Write8(0);
+	stream->Write16(0);
+
+	std::vector<uint32> index(frameCount + 1);
+	std::vector<uint8> payload;
+	std::vector<uint8> compressedFrame(compressBound(SAMPLE_FRAME_SIZE));
+	for(uint32 frame = 0; frame < frameCount; frame++)
+	{
+		index[frame] = headerSize + indexSize + static_cast<uint32>(payload.size());
+
+		z_stream z = {};
+		deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+		z.next_in = const_cast<uint8*>(data.data() + (frame * SAMPLE_FRAME_SIZE));
+		z.avail_in = SAMPLE_FRAME_SIZE;
+		z.next_out = compressedFrame.data();
+		z.avail_out = static_cast<uint32>(compressedFrame.size());
+		deflate(&z, Z_FINISH);
+		uint32 compressedSize = static_cast<uint32>(z.total_out);
+		deflateEnd(&z);
+
+		if(compressedSize < SAMPLE_FRAME_SIZE)
+		{
+			payload.insert(std::end(payload), compressedFrame.data(), compressedFrame.data() + compressedSize);
+		}
+		else
+		{
+			//Stored frame
+			index[frame] |= 0x80000000;
+			payload.insert(std::end(payload), data.data() + (frame * SAMPLE_FRAME_SIZE), data.data() + ((frame + 1) * SAMPLE_FRAME_SIZE));
+		}
+	}
+	index[frameCount] = headerSize + indexSize + static_cast<uint32>(payload.size());
+
+	stream->Write(index.data(), indexSize);
+	stream->Write(payload.data(), payload.size());
+	printf("CSO sample (0x%X byte frames): %llu bytes -> %llu bytes.\r\n", SAMPLE_FRAME_SIZE,
+	       static_cast<unsigned long long>(data.size()), static_cast<unsigned long long>(stream->GetSize()));
+	stream->Seek(0, Framework::STREAM_SEEK_SET);
+	return stream;
+}
+
+#ifdef HAS_ZSTD
+static Framework::CStream* CreateSampleZsi(const std::vector<uint8>& data, uint32 frameSize, uint32 dictionarySize)
+{
+	Framework::CMemStream input;
+	input.Write(data.data(), data.size());
+
+	CZsiImageWriter::OPTIONS options;
+	options.frameSize = frameSize;
+	options.dictionarySize = dictionarySize;
+
+	auto stream = new Framework::CMemStream();
+	CZsiImageWriter::Write(*stream, input, options);
+	printf("ZSI sample (0x%X byte frames, 0x%X byte dictionary): %llu bytes -> %llu bytes.\r\n", frameSize, dictionarySize,
+	       static_cast<unsigned long long>(data.size()), static_cast<unsigned long long>(stream->GetSize()));
+	stream->Seek(0, Framework::STREAM_SEEK_SET);
+	return stream;
+}
+#endif
+
+static StreamPtr OpenImage(const std::string& imagePath)
+{
+	auto extension = imagePath.substr(std::min(imagePath.find_last_of('.'), imagePath.size()));
+	auto baseStream = new Framework::CStdStream(imagePath.c_str(), "rb");
+	if(!stricmp(extension.c_str(), ".cso"))
+	{
+		return std::make_unique<CCsoImageStream>(baseStream);
+	}
+	else if(!stricmp(extension.c_str(), ".isz"))
+	{
+		return std::make_unique<CIszImageStream>(baseStream);
+	}
+#ifdef HAS_ZSTD
+	else if(!stricmp(extension.c_str(), ".zsi"))
+	{
+		return std::make_unique<CZsiImageStream>(baseStream);
+	}
+#endif
+	return StreamPtr(baseStream);
+}
+
+static double GetMegabytesPerSecond(uint64 size, Clock::duration duration)
+{
+	double seconds = std::chrono::duration<double>(duration).count();
+	return (static_cast<double>(size) / (1024.0 * 1024.0)) / seconds;
+}
+
+static bool RunBenchmark(const char* name, Framework::CStream& stream, const std::vector<uint8>& sampleData, uint32 randomReadCount)
+{
+	//Same random sequence for every image
+	std::mt19937 random;
+	bool succeeded = true;
+	uint64 imageSize = stream.GetLength();
+	uint32 sectorCount = static_cast<uint32>(imageSize / SECTOR_SIZE);
+	if(sectorCount == 0)
+	{
+		printf("Image is empty.\r\n");
+		return false;
+	}
+
+	std::vector<uint8> buffer(SEQUENTIAL_READ_SIZE);
+
+	{
+		uint64 totalSize = 0;
+		auto startTime = Clock::now();
+		stream.Seek(0, Framework::STREAM_SEEK_SET);
+		while(totalSize < imageSize)
+		{
+			uint64 readSize = stream.Read(buffer.data(), SEQUENTIAL_READ_SIZE);
+			if(readSize == 0) break;
+			if(!sampleData.empty() && memcmp(buffer.data(), sampleData.data() + totalSize, static_cast<size_t>(readSize)))
+			{
+				printf("Data mismatch at 0x%llx.\r\n", static_cast<unsigned long long>(totalSize));
+				succeeded = false;
+			}
+			totalSize += readSize;
+		}
+		auto endTime = Clock::now();
+		printf("%-8s Sequential: %llu bytes, %8.2f MB/s\r\n", name,
+		       static_cast<unsigned long long>(totalSize), GetMegabytesPerSecond(totalSize, endTime - startTime));
+	}
+
+	{
+		uint64 totalSize = 0;
+		auto startTime = Clock::now();
+		for(uint32 i = 0; i < randomReadCount; i++)
+		{
+			uint32 sector = random() % sectorCount;
+			stream.Seek(static_cast<uint64>(sector) * SECTOR_SIZE, Framework::STREAM_SEEK_SET);
+			uint64 readSize = stream.Read(buffer.data(), SECTOR_SIZE);
+			if(!sampleData.empty() && ((readSize != SECTOR_SIZE) || memcmp(buffer.data(), sampleData.data() + (sector * SECTOR_SIZE), SECTOR_SIZE)))
+			{
+				printf("Data mismatch at sector 0x%x.\r\n", sector);
+				succeeded = false;
+			}
+			totalSize += readSize;
+		}
+		auto endTime = Clock::now();
+		printf("%-8s Random:     %u sectors, %8.2f MB/s\r\n", name,
+		       randomReadCount, GetMegabytesPerSecond(totalSize, endTime - startTime));
+	}
+
+	return succeeded;
+}
+
+static bool RunCachedBenchmark(const char* name, const std::shared_ptr<Framework::CStream>& baseStream, const std::vector<uint8>& sampleData, uint32 randomReadCount)
+{
+	CSectorCacheStream stream(baseStream);
+	bool succeeded = RunBenchmark(name, stream, sampleData, randomReadCount);
+	auto stats = stream.GetStats();
+	printf("%-8s Cache:      %llu hits, %llu misses (%.1f%% hit rate), %llu readahead hits, %llu stalls (%.2f ms)\r\n", name,
+	       static_cast<unsigned long long>(stats.hitCount), static_cast<unsigned long long>(stats.missCount), stats.GetHitRate() * 100.0,
+	       static_cast<unsigned long long>(stats.readAheadHitCount), static_cast<unsigned long long>(stats.stallCount),
+	       static_cast<double>(stats.stallTime) / 1000.0);
+	return succeeded;
+}
+
+int main(int argc, const char** argv)
+{
+	if(argc > 3)
+	{
+		printf("Usage: ImageStreamBenchmark [imagePath [randomReadCount]]\r\n");
+		return -1;
+	}
+
+	uint32 randomReadCount = 0x1000;
+	if(argc > 1)
+	{
+		StreamPtr stream;
+		try
+		{
+			stream = OpenImage(argv[1]);
+		}
+		catch(const std::exception& exception)
+		{
+			printf("Failed to open image: %s\r\n", exception.what());
+			return -1;
+		}
+		if(argc > 2) randomReadCount = atoi(argv[2]);
+		std::shared_ptr<Framework::CStream> sharedStream = std::move(stream);
+		bool succeeded = RunBenchmark("Image", *sharedStream, std::vector<uint8>(), randomReadCount);
+		succeeded &= RunCachedBenchmark("Image+C", sharedStream, std::vector<uint8>(), randomReadCount);
+		return succeeded ? 0 : -1;
+	}
+
+	std::mt19937 random;
+	auto sampleData = GenerateSampleData(random);
+	bool succeeded = true;
+	try
+	{
+		{
+			auto stream = std::make_shared<CCsoImageStream>(CreateSampleCso(sampleData));
+			succeeded &= RunBenchmark("CSO", *stream, sampleData, randomReadCount);
+			succeeded &= RunCachedBenchmark("CSO+C", stream, sampleData, randomReadCount);
+		}
+#ifdef HAS_ZSTD
+		{
+			auto stream = std::make_unique<CZsiImageStream>(CreateSampleZsi(sampleData, CZsiImageWriter::DEFAULT_FRAME_SIZE, 0));
+			succeeded &= RunBenchmark("ZSI", *stream, sampleData, randomReadCount);
+		}
+		{
+			//Same frame size as the CSO sample, that's where a dictionary helps
+			auto stream = std::make_unique<CZsiImageStream>(CreateSampleZsi(sampleData, SAMPLE_FRAME_SIZE, CZsiImageWriter::DEFAULT_DICTIONARY_SIZE));
+			succeeded &= RunBenchmark("ZSI-2K", *stream, sampleData, randomReadCount);
+		}
+#endif
+	}
+	catch(const std::exception& exception)
+	{
+		printf("Failed to create sample image: %s\r\n", exception.what());
+		return -1;
+	}
+
+	return succeeded ? 0 : -1;
+}
@@ -0,0 +1,293 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "Ps2Const.h"
+#include "MIPS.h"
+#include "ee/DMAC.h"
+#include "ee/INTC.h"
+#include "ee/IPU.h"
+
+//Decodes random intra macroblocks with BDEC while feeding the IN FIFO in random-sized chunks, once with
+//the fast coefficient decoding path and once with the bit-by-bit state machine alone. Both must give the
+//same blocks and leave the IN FIFO at the same position after every macroblock, then both are timed.
+
+static const uint32 MACROBLOCK_COUNT = 0x1000;
+//IPU_CTRL bits
+static const uint32 IPU_CTRL_ECD = 0x00004000;
+static const uint32 IPU_CTRL_IVF = 0x00200000;
+//BDEC command fields
+static const uint32 IPU_CMD_BDEC = 0x20000000;
+static const uint32 IPU_CMD_BDEC_MBI = 0x08000000;
+static const uint32 IPU_CMD_BDEC_DCR = 0x04000000;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct COEFF_CODE
+{
+	const char* bits;
+	uint32 run;
+};
+
+//Part of the DCT coefficient tables (ISO/IEC 13818-2, tables B.14 and B.15), without the sign bit
+static const COEFF_CODE g_table0Codes[] =
+    {
+        {"11", 0}, {"011", 1}, {"0100", 0}, {"0101", 2}, {"00101", 0}, {"00111", 3}, {"00110", 4}, {"000110", 1},
+        {"000111", 5}, {"000101", 6}, {"000100", 7}, {"0000110", 0}, {"0000100", 2}, {"0000111", 8}, {"0000101", 9},
+        {"00100110", 0}, {"00100001", 0}, {"00100101", 1}, {"00100100", 3}, {"00100111", 10}, {"00100011", 11},
+        {"00100010", 12}, {"00100000", 13}, {"0000001010", 0}, {"0000001100", 1}, {"0000001011", 2}, {"0000001111", 4},
+        {"0000001001", 5}, {"0000001110", 14}, {"0000001101", 15}, {"0000001000", 16}, {"000000011101", 0},
+        {"0000000011010", 0}, {"00000000011111", 0}, {"000000000011111", 0}, {"0000000000011111", 1},
+};
+
+static const COEFF_CODE g_table1Codes[] =
+    {
+        {"10", 0}, {"010", 1}, {"110", 0}, {"00101", 2}, {"0111", 0}, {"00111", 3}, {"000110", 4}, {"00110", 1},
+        {"000111", 5}, {"0000110", 6}, {"0000100", 7}, {"11100", 0}, {"0000111", 2}, {"0000101", 8}, {"1111000", 9},
+        {"11101", 0}, {"000101", 0}, {"1111001", 1}, {"00100110", 3}, {"1111010", 10}, {"00100001", 11},
+        {"00100101", 12}, {"00100100", 13}, {"000100", 0}, {"00100111", 1}, {"11111100", 2}, {"11111101", 4},
+        {"0000000011010", 0}, {"00000000011111", 0}, {"0000000000011111", 1},
+};
+
+class CBitWriter
+{
+public:
+	void Write(uint32 value, uint32 length)
+	{
+		for(uint32 i = 0; i < length; i++)
+		{
+			if((m_bitCount & 7) == 0) m_bytes.push_back(0);
+			if((value >> (length - i - 1)) & 1)
+			{
+				m_bytes.back() |= (0x80 >> (m_bitCount & 7));
+			}
+			m_bitCount++;
+		}
+	}
+
+	void Write(const char* bits)
+	{
+		for(; *bits != 0; bits++)
+		{
+			Write((*bits == '1') ? 1 : 0, 1);
+		}
+	}
+
+	std::vector<uint8>& GetBytes()
+	{
+		return m_bytes;
+	}
+
+private:
+	std::vector<uint8> m_bytes;
+	uint32 m_bitCount = 0;
+};
+
+struct STREAM
+{
+	std::vector<uint8> data;
+	std::vector<uint32> commands;
+};
+
+struct DECODE_RESULT
+{
+	bool succeeded = true;
+	//Blocks written to the OUT FIFO
+	std::vector<uint8> output;
+	//IPU_BP after each macroblock
+	std::vector<uint32> positions;
+	double duration = 0;
+};
+
+static void WriteBlock(CBitWriter& writer, std::mt19937& random, bool isChrominance, bool isTable1)
+{
+	//Small DC sizes, codes of the first block can't be mistaken for a start code
+	if(random() & 1)
+	{
+		writer.Write(isChrominance ? "00" : "100");
+	}
+	else if(isChrominance)
+	{
+		writer.Write("01");
+		writer.Write(random() & 1, 1);
+	}
+	else
+	{
+		writer.Write("01");
+		writer.Write(random() & 3, 2);
+	}
+
+	const COEFF_CODE* codes = isTable1 ? g_table1Codes : g_table0Codes;
+	uint32 codeCount = isTable1 ? (sizeof(g_table1Codes) / sizeof(COEFF_CODE)) : (sizeof(g_table0Codes) / sizeof(COEFF_CODE));
+
+	//Most blocks only have a few coefficients, some have as many as they can
+	uint32 coeffCount = ((random() % 8) == 0) ? 63 : (random() % 12);
+	uint32 index = 1;
+	for(uint32 i = 0; (i < coeffCount) && (index < 64); i++)
+	{
+		if((random() % 16) == 0)
+		{
+			//Escape code, 6-bit run and 12-bit level
+			uint32 run = random() % std::min<uint32>(64 - index, 8);
+			int32 level = static_cast<int32>(random() % 4095) - 2047;
+			if(level == 0) level = 1;
+			writer.Write("000001");
+			writer.Write(run, 6);
+			writer.Write(level & 0xFFF, 12);
+			index += run + 1;
+		}
+		else
+		{
+			const auto& code = codes[random() % codeCount];
+			if((index + code.run) >= 64) break;
+			writer.Write(code.bits);
+			writer.Write(random() & 1, 1);
+			index += code.run + 1;
+		}
+	}
+
+	//End of block
+	writer.Write(isTable1 ? "0110" : "10");
+}
+
+static STREAM GenerateStream(std::mt19937& random, bool isTable1)
+{
+	STREAM stream;
+	CBitWriter writer;
+	for(uint32 i = 0; i < MACROBLOCK_COUNT; i++)
+	{
+		uint32 qsc = (random() % 31) + 1;
+		bool resetDc = (i == 0) || ((random() % 4) == 0);
+		stream.commands.push_back(IPU_CMD_BDEC | IPU_CMD_BDEC_MBI | (resetDc ? IPU_CMD_BDEC_DCR : 0) | (qsc << 16));
+		for(uint32 block = 0; block < 6; block++)
+		{
+			WriteBlock(writer, random, block >= 4, isTable1);
+		}
+	}
+
+	//Padding with ones doesn't look like a start code
+	auto& bytes = writer.GetBytes();
+	while((bytes.size() & 0xF) != 0)
+	{
+		writer.Write(1, 1);
+	}
+	bytes.resize(bytes.size() + 0x10, 0xFF);
+	stream.data = std::move(bytes);
+	return stream;
+}
+
+static DECODE_RESULT Decode(const STREAM& stream, uint32 ctrl, bool fastDecodingEnabled, uint32 feedSeed)
+{
+	std::vector<uint8> ram(PS2::EE_RAM_SIZE);
+	std::vector<uint8> spr(PS2::EE_SPR_SIZE);
+	std::vector<uint8> vuMem0(PS2::VUMEM0SIZE);
+	CMIPS ee(MEMORYMAP_ENDIAN_LSBF);
+	CDMAC dmac(ram.data(), spr.data(), vuMem0.data(), ee);
+	CINTC intc(dmac);
+	CIPU ipu(intc);
+	memcpy(ram.data(), stream.data.data(), stream.data.size());
+
+	DECODE_RESULT result;
+	ipu.Reset();
+	ipu.SetFastDecodingEnabled(fastDecodingEnabled);
+	ipu.SetRegister(CIPU::IPU_CTRL, ctrl);
+	ipu.SetDMA3ReceiveHandler(
+	    [&result](const void* data, uint32 qwc) {
+		    auto bytes = reinterpret_cast<const uint8*>(data);
+		    result.output.insert(result.output.end(), bytes, bytes + (qwc * 0x10));
+		    return qwc;
+	    });
+
+	//Same chunk sizes for both decoding modes
+	std::mt19937 feedRandom(feedSeed);
+	uint32 streamQwc = static_cast<uint32>(stream.data.size() / 0x10);
+	uint32 fedQwc = 0;
+	auto feed =
+	    [&]() {
+		    uint32 qwc = std::min<uint32>((feedRandom() % 4) + 1, streamQwc - fedQwc);
+		    fedQwc += ipu.ReceiveDMA4(fedQwc * 0x10, qwc, false, ram.data(), spr.data());
+	    };
+
+	for(auto command : stream.commands)
+	{
+		ipu.SetRegister(CIPU::IPU_CMD, command);
+		while(ipu.WillExecuteCommand())
+		{
+			auto startTime = Clock::now();
+			ipu.ExecuteCommand();
+			result.duration += std::chrono::duration<double, std::milli>(Clock::now() - startTime).count();
+			if(!ipu.WillExecuteCommand()) break;
+			if(fedQwc == streamQwc)
+			{
+				printf("Failed: BDEC ran out of data.\r\n");
+				result.succeeded = false;
+				return result;
+			}
+			feed();
+		}
+		if(ipu.GetRegister(CIPU::IPU_CTRL) & IPU_CTRL_ECD)
+		{
+			printf("Failed: BDEC reported a VLC error.\r\n");
+			result.succeeded = false;
+			return result;
+		}
+		result.positions.push_back(ipu.GetRegister(CIPU::IPU_BP));
+	}
+
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 iterationCount = 4;
+	if(argc > 1) iterationCount = atoi(argv[1]);
+	if(iterationCount == 0)
+	{
+		printf("Usage: IpuDecodeBenchmark [iterationCount]\r\n");
+		return -1;
+	}
+
+	std::mt19937 random;
+	bool succeeded = true;
+
+	for(uint32 tableIndex = 0; tableIndex < 2; tableIndex++)
+	{
+		bool isTable1 = (tableIndex != 0);
+		uint32 ctrl = isTable1 ? IPU_CTRL_IVF : 0;
+		auto stream = GenerateStream(random, isTable1);
+
+		double fastDuration = 0;
+		double slowDuration = 0;
+		for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+		{
+			uint32 feedSeed = random();
+			auto fastResult = Decode(stream, ctrl, true, feedSeed);
+			auto slowResult = Decode(stream, ctrl, false, feedSeed);
+			if(!fastResult.succeeded || !slowResult.succeeded)
+			{
+				succeeded = false;
+				break;
+			}
+			if(fastResult.output != slowResult.output)
+			{
+				printf("Failed: fast decoding gave different blocks (table %d).\r\n", tableIndex);
+				succeeded = false;
+			}
+			if(fastResult.positions != slowResult.positions)
+			{
+				printf("Failed: fast decoding left the IN FIFO at a different position (table %d).\r\n", tableIndex);
+				succeeded = false;
+			}
+			fastDuration += fastResult.duration;
+			slowDuration += slowResult.duration;
+		}
+
+		printf("Table %d: bit-by-bit: %8.2f ms fast: %8.2f ms speedup: %.2fx\r\n",
+		       tableIndex, slowDuration / iterationCount, fastDuration / iterationCount, slowDuration / fastDuration);
+	}
+
+	return succeeded ? 0 : -1;
+}
@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <vector>
+#include "ee/IPU_Kernels.h"
+
+//Checks that the SIMD IPU kernels give the exact same results as the scalar ones on random data
+//and on IDCT inputs chosen to stress the double precision computations, then measures the throughput of both sets.
+
+static const uint32 SAMPLE_COUNT = 0x1000;
+static const uint32 MACROBLOCK_SIZE = 0x180;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+struct DEQUANTISE_PARAMS
+{
+	bool isIntra;
+	uint8 qsc;
+	bool isLinearQScale;
+	uint32 dcPrecision;
+};
+
+struct SAMPLES
+{
+	//Decoded coefficients, most are zero like they would be in a real stream
+	std::vector<int16> coeffBlocks;
+	//Coefficients in the range of a dequantised block
+	std::vector<int16> dequantisedBlocks;
+	std::vector<DEQUANTISE_PARAMS> dequantiseParams;
+	std::vector<uint8> macroblocks;
+	uint8 intraIq[0x40];
+	uint8 nonIntraIq[0x40];
+	uint16 th0 = 0;
+	uint16 th1 = 0;
+};
+
+static SAMPLES GenerateSamples(std::mt19937& random)
+{
+	SAMPLES samples;
+	samples.coeffBlocks.resize(SAMPLE_COUNT * 0x40);
+	samples.dequantisedBlocks.resize(SAMPLE_COUNT * 0x40);
+	samples.dequantiseParams.resize(SAMPLE_COUNT);
+	samples.macroblocks.resize(SAMPLE_COUNT * MACROBLOCK_SIZE);
+
+	for(uint32 i = 0; i < SAMPLE_COUNT; i++)
+	{
+		int16* coeffBlock = samples.coeffBlocks.data() + (i * 0x40);
+		int16* dequantisedBlock = samples.dequantisedBlocks.data() + (i * 0x40);
+		//Some blocks use the whole 16-bit range to check for overflows
+		bool isFullRange = (i % 16) == 0;
+		uint32 coeffCount = (i % 8 == 0) ? 64 : (random() % 12);
+		for(uint32 j = 0; j < coeffCount; j++)
+		{
+			uint32 position = (coeffCount == 64) ? j : (random() % 24);
+			coeffBlock[position] = isFullRange ? static_cast<int16>(random()) : static_cast<int16>((random() % 4095) - 2047);
+			dequantisedBlock[position] = static_cast<int16>((random() % 4096) - 2048);
+		}
+
+		auto& params = samples.dequantiseParams[i];
+		params.isIntra = (random() & 1) != 0;
+		params.qsc = static_cast<uint8>(random() % 32);
+		params.isLinearQScale = (random() & 1) != 0;
+		params.dcPrecision = random() % 4;
+	}
+
+	for(auto& value : samples.macroblocks)
+	{
+		value = static_cast<uint8>(random());
+	}
+
+	for(uint32 i = 0; i < 0x40; i++)
+	{
+		samples.intraIq[i] = static_cast<uint8>(random());
+		samples.nonIntraIq[i] = static_cast<uint8>(random());
+	}
+
+	samples.th0 = static_cast<uint16>(random() % 0x200);
+	samples.th1 = static_cast<uint16>(random() % 0x200);
+
+	return samples;
+}
+
+//IDCT inputs that random sparse blocks don't cover well
+static std::vector<int16> GenerateIdctBlocks(std::mt19937& random)
+{
+	std::vector<int16> blocks;
+	int16 block[0x40];
+	auto appendBlock =
+	    [&blocks, &block]() {
+		    blocks.insert(blocks.end(), block, block + 0x40);
+	    };
+
+	//IEEE 1180 input ranges, with both signs
+	static const int32 ranges[][2] = {{-256, 255}, {-5, 5}, {-300, 300}};
+	for(const auto& range : ranges)
+	{
+		for(uint32 i = 0; i < 1000; i++)
+		{
+			for(auto& value : block)
+			{
+				value = static_cast<int16>(range[0] + static_cast<int32>(random() % (range[1] - range[0] + 1)));
+			}
+			appendBlock();
+			for(auto& value : block)
+			{
+				value = -value;
+			}
+			appendBlock();
+		}
+	}
+
+	//Single coefficient at every position, results are often exactly halfway between two integers
+	static const int16 amplitudes[] = {1, -1, 4, -4, 255, -256, 2047, -2048, 0x7FFF, -0x8000};
+	for(uint32 position = 0; position < 0x40; position++)
+	{
+		for(auto amplitude : amplitudes)
+		{
+			memset(block, 0, sizeof(block));
+			block[position] = amplitude;
+			appendBlock();
+		}
+	}
+
+	//Every combination of zero rows, which the SIMD IDCT skips, with values over the whole 16-bit range
+	for(uint32 rowMask = 0; rowMask < 0x100; rowMask++)
+	{
+		for(uint32 i = 0; i < 0x40; i++)
+		{
+			block[i] = (rowMask & (1 << (i / 8))) ? static_cast<int16>(random()) : 0;
+		}
+		appendBlock();
+	}
+
+	return blocks;
+}
+
+static bool CheckIdct(const IPU::KERNELS& kernels, const std::vector<int16>& blocks)
+{
+	const auto& scalarKernels = IPU::GetScalarKernels();
+	uint32 blockCount = static_cast<uint32>(blocks.size() / 0x40);
+	uint32 mismatchCount = 0;
+	for(uint32 i = 0; i < blockCount; i++)
+	{
+		int16 scalarOutput[0x40];
+		int16 output[0x40];
+		scalarKernels.idct(blocks.data() + (i * 0x40), scalarOutput);
+		kernels.idct(blocks.data() + (i * 0x40), output);
+		if(memcmp(scalarOutput, output, sizeof(output)) != 0)
+		{
+			mismatchCount++;
+		}
+	}
+	if(mismatchCount != 0)
+	{
+		printf("%s IDCT results differ from scalar IDCT on %d blocks out of %d.\r\n",
+		       kernels.name, mismatchCount, blockCount);
+	}
+	return mismatchCount == 0;
+}
+
+//Runs every kernel of a set on the samples and returns the concatenated results
+static std::vector<uint8> RunKernels(const IPU::KERNELS& kernels, const SAMPLES& samples)
+{
+	std::vector<uint8> results;
+	auto appendResult =
+	    [&results](const void* data, size_t size) {
+		    auto bytes = reinterpret_cast<const uint8*>(data);
+		    results.insert(results.end(), bytes, bytes + size);
+	    };
+
+	for(uint32 i = 0; i < SAMPLE_COUNT; i++)
+	{
+		int16 block[0x40];
+		int16 output[0x40];
+		const auto& params = samples.dequantiseParams[i];
+
+		memcpy(block, samples.coeffBlocks.data() + (i * 0x40), sizeof(block));
+		kernels.inverseScan(block, (i & 1) != 0);
+		appendResult(block, sizeof(block));
+
+		kernels.dequantiseBlock(block, params.isIntra, params.qsc, params.isLinearQScale, params.dcPrecision, samples.intraIq, samples.nonIntraIq);
+		appendResult(block, sizeof(block));
+
+		kernels.idct(samples.dequantisedBlocks.data() + (i * 0x40), output);
+		appendResult(output, sizeof(output));
+
+		uint32 pixels32[0x100];
+		uint16 pixels16[0x100];
+		const uint8* macroblock = samples.macroblocks.data() + (i * MACROBLOCK_SIZE);
+		kernels.convertRgba32(macroblock, pixels32, samples.th0, samples.th1);
+		kernels.convertRgba16(macroblock, pixels16, samples.th0, samples.th1);
+		appendResult(pixels32, sizeof(pixels32));
+		appendResult(pixels16, sizeof(pixels16));
+	}
+
+	return results;
+}
+
+static double MeasureKernel(uint32 iterationCount, const std::function<void(uint32)>& kernel)
+{
+	auto startTime = Clock::now();
+	for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+	{
+		for(uint32 i = 0; i < SAMPLE_COUNT; i++)
+		{
+			kernel(i);
+		}
+	}
+	auto endTime = Clock::now();
+	double duration = std::chrono::duration<double, std::nano>(endTime - startTime).count();
+	return duration / (static_cast<double>(iterationCount) * SAMPLE_COUNT);
+}
+
+static void MeasureKernels(const IPU::KERNELS& kernels, const SAMPLES& samples, uint32 iterationCount, double* durations)
+{
+	int16 block[0x40];
+	int16 output[0x40];
+	uint32 pixels32[0x100];
+	uint16 pixels16[0x100];
+
+	durations[0] = MeasureKernel(iterationCount, [&](uint32 i) {
+		memcpy(block, samples.coeffBlocks.data() + (i * 0x40), sizeof(block));
+		kernels.inverseScan(block, true);
+	});
+	durations[1] = MeasureKernel(iterationCount, [&](uint32 i) {
+		const auto& params = samples.dequantiseParams[i];
+		memcpy(block, samples.dequantisedBlocks.data() + (i * 0x40), sizeof(block));
+		kernels.dequantiseBlock(block, params.isIntra, params.qsc, params.isLinearQScale, params.dcPrecision, samples.intraIq, samples.nonIntraIq);
+	});
+	durations[2] = MeasureKernel(iterationCount, [&](uint32 i) {
+		kernels.idct(samples.dequantisedBlocks.data() + (i * 0x40), output);
+	});
+	durations[3] = MeasureKernel(iterationCount, [&](uint32 i) {
+		kernels.convertRgba32(samples.macroblocks.data() + (i * MACROBLOCK_SIZE), pixels32, samples.th0, samples.th1);
+	});
+	durations[4] = MeasureKernel(iterationCount, [&](uint32 i) {
+		kernels.convertRgba16(samples.macroblocks.data() + (i * MACROBLOCK_SIZE), pixels16, samples.th0, samples.th1);
+	});
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 iterationCount = 50;
+	if(argc > 1) iterationCount = atoi(argv[1]);
+	if(iterationCount == 0)
+	{
+		printf("Usage: IpuKernelBenchmark [iterationCount]\r\n");
+		return -1;
+	}
+
+	const auto& scalarKernels = IPU::GetScalarKernels();
+	auto simdKernels = IPU::GetSimdKernels();
+	if(!simdKernels)
+	{
+		printf("No SIMD kernels for this target, skipping.\r\n");
+		return 0;
+	}
+
+	std::mt19937 random;
+	auto samples = GenerateSamples(random);
+
+	bool succeeded = true;
+
+	//Results are checked for every set of thresholds, including ones that are above 0xFF
+	const uint16 thresholds[][2] = {{0, 0}, {0x40, 0x80}, {0x80, 0x40}, {0xFF, 0x100}, {samples.th0, samples.th1}};
+	for(const auto& threshold : thresholds)
+	{
+		samples.th0 = threshold[0];
+		samples.th1 = threshold[1];
+		if(RunKernels(scalarKernels, samples) != RunKernels(*simdKernels, samples))
+		{
+			printf("%s kernels results differ from scalar kernels (TH0: 0x%03X, TH1: 0x%03X).\r\n",
+			       simdKernels->name, samples.th0, samples.th1);
+			succeeded = false;
+		}
+	}
+
+	succeeded &= CheckIdct(*simdKernels, GenerateIdctBlocks(random));
+
+	static const char* kernelNames[] = {"Inverse Scan", "Dequantise", "IDCT", "CSC RGBA32", "CSC RGBA16"};
+	static const uint32 kernelCount = sizeof(kernelNames) / sizeof(kernelNames[0]);
+	double scalarDurations[kernelCount] = {};
+	double simdDurations[kernelCount] = {};
+	MeasureKernels(scalarKernels, samples, iterationCount, scalarDurations);
+	MeasureKernels(*simdKernels, samples, iterationCount, simdDurations);
+
+	for(uint32 i = 0; i < kernelCount; i++)
+	{
+		printf("%-16s scalar: %8.2f ns/block %s: %8.2f ns/block speedup: %.2fx\r\n",
+		       kernelNames[i], scalarDurations[i], simdKernels->name, simdDurations[i], scalarDurations[i] / simdDurations[i]);
+	}
+
+	return succeeded ? 0 : -1;
+}
@@ -0,0 +1,238 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <vector>
+#include <zlib.h>
+#include "Ps2Const.h"
+#include "gs/GSHandler.h"
+#include "states/RewindBuffer.h"
+
+//Captures rewind snapshots of memory regions laid out like the ones of the PS2 while a few pages get modified
+//between each of them, then steps back through snapshots to make sure memory is restored exactly. Like EE RAM
+//in the VM, writes to the first region are tracked, other regions have all their pages compared.
+//Capture is what runs on the emulation thread, encoding is done on the state thread.
+
+//Number of words modified in each dirty page
+static const uint32 DIRTY_WORD_COUNT = 32;
+
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::vector<uint8> RegionBuffer;
+
+struct SNAPSHOT_INFO
+{
+	double captureTime = 0;
+	double encodeTime = 0;
+};
+
+static uint32 ComputeChecksum(const CRewindBuffer::MemoryRegionArray& regions)
+{
+	uLong checksum = crc32(0, Z_NULL, 0);
+	for(const auto& region : regions)
+	{
+		checksum = crc32(checksum, region.memory, region.size);
+	}
+	return checksum;
+}
+
+static void ModifyPages(std::mt19937& random, const CRewindBuffer::MemoryRegionArray& regions, uint32 totalSize, uint32 dirtyPageCount, std::vector<bool>& writtenPages)
+{
+	for(uint32 i = 0; i < dirtyPageCount; i++)
+	{
+		uint32 pageOffset = (random() % (totalSize / CRewindBuffer::PAGE_SIZE)) * CRewindBuffer::PAGE_SIZE;
+		auto regionIterator = std::begin(regions);
+		while(pageOffset >= regionIterator->size)
+		{
+			pageOffset -= regionIterator->size;
+			regionIterator++;
+		}
+		if(regionIterator == std::begin(regions))
+		{
+			writtenPages[pageOffset / CRewindBuffer::PAGE_SIZE] = true;
+		}
+		auto words = reinterpret_cast<uint32*>(regionIterator->memory + pageOffset);
+		for(uint32 j = 0; j < DIRTY_WORD_COUNT; j++)
+		{
+			words[random() % (CRewindBuffer::PAGE_SIZE / sizeof(uint32))] = random();
+		}
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 dirtyPageCount = 2048;
+	uint32 snapshotCount = 60;
+	if(argc > 1) dirtyPageCount = atoi(argv[1]);
+	if(argc > 2) snapshotCount = atoi(argv[2]);
+	if(snapshotCount == 0)
+	{
+		printf("Usage: RewindBenchmark [dirtyPageCount] [snapshotCount]\r\n");
+		return -1;
+	}
+
+	std::vector<RegionBuffer> buffers;
+	buffers.emplace_back(PS2::EE_RAM_SIZE);
+	buffers.emplace_back(PS2::IOP_RAM_SIZE);
+	buffers.emplace_back(PS2::SPU_RAM_SIZE);
+	buffers.emplace_back(CGSHandler::RAMSIZE);
+
+	std::mt19937 random;
+	std::vector<bool> writtenPages(PS2::EE_RAM_SIZE / CRewindBuffer::PAGE_SIZE);
+	CRewindBuffer::MemoryRegionArray regions;
+	uint32 totalSize = 0;
+	for(auto& buffer : buffers)
+	{
+		//Leave some memory empty, as it is after boot
+		auto words = reinterpret_cast<uint32*>(buffer.data());
+		for(uint32 i = 0; i < (buffer.size() / 2) / sizeof(uint32); i++)
+		{
+			words[i] = random();
+		}
+		regions.push_back({buffer.data(), static_cast<uint32>(buffer.size())});
+		totalSize += static_cast<uint32>(buffer.size());
+	}
+	regions[0].isPageWritten = [&writtenPages](uint32 pageIndex) { return writtenPages[pageIndex]; };
+
+	CRewindBuffer rewindBuffer;
+	rewindBuffer.SetMemoryBudget(std::numeric_limits<size_t>::max());
+
+	//Memory matches the shadow copy after this, the first snapshot only holds what changed since then
+	rewindBuffer.Reset(regions);
+
+	//Checksum of memory for every snapshot, newest one last
+	std::vector<uint32> snapshotChecksums;
+	auto captureSnapshot =
+	    [&]() {
+		    ModifyPages(random, regions, totalSize, dirtyPageCount, writtenPages);
+		    snapshotChecksums.push_back(ComputeChecksum(regions));
+
+		    SNAPSHOT_INFO snapshotInfo;
+		    auto startTime = Clock::now();
+		    auto snapshot = rewindBuffer.Capture(regions);
+		    std::fill(std::begin(writtenPages), std::end(writtenPages), false);
+		    auto captureTime = Clock::now();
+		    rewindBuffer.Encode(snapshot, CRewindBuffer::StateData(1, static_cast<uint8>(snapshotChecksums.size())));
+		    auto encodeTime = Clock::now();
+
+		    snapshotInfo.captureTime = std::chrono::duration<double, std::milli>(captureTime - startTime).count();
+		    snapshotInfo.encodeTime = std::chrono::duration<double, std::milli>(encodeTime - captureTime).count();
+		    return snapshotInfo;
+	    };
+	//Every restore must bring memory back to what it was when the snapshot was captured
+	auto restoreSnapshot =
+	    [&]() {
+		    uint32 expectedChecksum = snapshotChecksums.back();
+		    uint8 expectedState = static_cast<uint8>(snapshotChecksums.size());
+		    snapshotChecksums.pop_back();
+		    CRewindBuffer::StateData state;
+		    bool succeeded = rewindBuffer.Restore(regions, state) &&
+		                     (state.size() == 1) && (state[0] == expectedState) &&
+		                     (ComputeChecksum(regions) == expectedChecksum);
+		    std::fill(std::begin(writtenPages), std::end(writtenPages), false);
+		    return succeeded;
+	    };
+
+	std::vector<SNAPSHOT_INFO> snapshotInfos;
+	for(uint32 i = 0; i < snapshotCount; i++)
+	{
+		snapshotInfos.push_back(captureSnapshot());
+	}
+
+	size_t snapshotsSize = rewindBuffer.GetMemoryUsage();
+
+	//Step back halfway, then capture again. Pages brought back by the restore weren't written since, they
+	//still need to be part of the next snapshot.
+	ModifyPages(random, regions, totalSize, dirtyPageCount, writtenPages);
+	for(uint32 i = 0; i < (snapshotCount + 1) / 2; i++)
+	{
+		if(!restoreSnapshot())
+		{
+			printf("Failed: snapshot %d wasn't restored properly.\r\n", static_cast<uint32>(snapshotChecksums.size()));
+			return 1;
+		}
+	}
+	for(uint32 i = 0; i < snapshotCount / 2; i++)
+	{
+		captureSnapshot();
+	}
+
+	ModifyPages(random, regions, totalSize, dirtyPageCount, writtenPages);
+	while(!snapshotChecksums.empty())
+	{
+		if(!restoreSnapshot())
+		{
+			printf("Failed: snapshot %d wasn't restored properly.\r\n", static_cast<uint32>(snapshotChecksums.size()));
+			return 1;
+		}
+	}
+	if(rewindBuffer.GetSnapshotCount() != 0)
+	{
+		printf("Failed: snapshots left after stepping back through all of them.\r\n");
+		return 1;
+	}
+
+	//Discarding a snapshot that couldn't be encoded drops the older ones, newer ones can still be restored
+	for(uint32 i = 0; i < 2; i++)
+	{
+		captureSnapshot();
+	}
+	ModifyPages(random, regions, totalSize, dirtyPageCount, writtenPages);
+	auto discardedSnapshot = rewindBuffer.Capture(regions);
+	std::fill(std::begin(writtenPages), std::end(writtenPages), false);
+	snapshotChecksums.clear();
+	for(uint32 i = 0; i < 2; i++)
+	{
+		captureSnapshot();
+	}
+	rewindBuffer.Discard(discardedSnapshot);
+	if(rewindBuffer.GetSnapshotCount() != 2)
+	{
+		printf("Failed: discarded snapshot or older ones were kept.\r\n");
+		return 1;
+	}
+	ModifyPages(random, regions, totalSize, dirtyPageCount, writtenPages);
+	while(!snapshotChecksums.empty())
+	{
+		if(!restoreSnapshot())
+		{
+			printf("Failed: snapshot captured after a discarded one wasn't restored properly.\r\n");
+			return 1;
+		}
+	}
+	CRewindBuffer::StateData state;
+	if(rewindBuffer.Restore(regions, state))
+	{
+		printf("Failed: snapshot older than a discarded one was restored.\r\n");
+		return 1;
+	}
+
+	//Older snapshots go away once the budget is exceeded, the newest one always stays
+	for(uint32 i = 0; i < 4; i++)
+	{
+		captureSnapshot();
+	}
+	rewindBuffer.SetMemoryBudget(0);
+	if(rewindBuffer.GetSnapshotCount() != 1)
+	{
+		printf("Failed: memory budget wasn't enforced.\r\n");
+		return 1;
+	}
+
+	double totalCaptureTime = 0;
+	double maxCaptureTime = 0;
+	double totalEncodeTime = 0;
+	for(const auto& snapshotInfo : snapshotInfos)
+	{
+		totalCaptureTime += snapshotInfo.captureTime;
+		maxCaptureTime = std::max(maxCaptureTime, snapshotInfo.captureTime);
+		totalEncodeTime += snapshotInfo.encodeTime;
+	}
+
+	printf("Memory: %d KB, dirty pages per snapshot: %d, snapshots: %d.\r\n", totalSize / 1024, dirtyPageCount, snapshotCount);
+	printf("Capture: avg %.3f ms, max %.3f ms.\r\n", totalCaptureTime / snapshotCount, maxCaptureTime);
+	printf("Encode: avg %.3f ms.\r\n", totalEncodeTime / snapshotCount);
+	printf("Snapshot size: avg %d KB.\r\n", static_cast<uint32>(snapshotsSize / snapshotCount / 1024));
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#ifdef HAS_AMAZON_S3
+#include "s3stream/S3ObjectStream.h"
+#include "S3StandInServer.h"
+#endif
+
+//Reads an object served by a local stand-in for S3 through CS3ObjectStream and checks what comes out.
+//Also checks that chunks come from the disk cache once fetched, and that the disk cache stays in its bounds.
+
+#ifdef HAS_AMAZON_S3
+
+#define BUCKET_NAME "bucket"
+#define OBJECT_NAME "game.iso"
+#define OBJECT_SIZE (0x800000 + 0x1234)
+#define SERVER_LATENCY_MS 20
+#define CACHE_SIZE 0x400000
+#define SEQUENTIAL_READ_SIZE 0x8000
+#define RANDOM_READ_COUNT 0x80
+#define RANDOM_READ_SIZE 0x800
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static bool CheckRead(CS3ObjectStream& stream, const std::vector<uint8>& objectData, uint64 position, uint64 size)
+{
+	std::vector<uint8> buffer(size);
+	stream.Seek(position, Framework::STREAM_SEEK_SET);
+	uint64 readSize = stream.Read(buffer.data(), size);
+	uint64 expectedSize = std::min<uint64>(size, objectData.size() - position);
+	if((readSize != expectedSize) || memcmp(buffer.data(), objectData.data() + position, static_cast<size_t>(readSize)))
+	{
+		printf("Data mismatch when reading 0x%llx bytes at 0x%llx.\r\n",
+		       static_cast<unsigned long long>(size), static_cast<unsigned long long>(position));
+		return false;
+	}
+	return true;
+}
+
+static int RunTest()
+{
+	std::mt19937 random;
+	std::vector<uint8> objectData(OBJECT_SIZE);
+	for(auto& value : objectData)
+	{
+		value = static_cast<uint8>(random());
+	}
+
+	CS3StandInServer server(BUCKET_NAME, OBJECT_NAME, objectData, SERVER_LATENCY_MS);
+
+	CS3ObjectStream::SETTINGS settings;
+	settings.accessKeyId = "accessKeyId";
+	settings.secretAccessKey = "secretAccessKey";
+	settings.endpoint = server.GetEndpoint();
+	settings.cachePath = fs::temp_directory_path() / "S3ObjectStreamTest";
+	settings.cacheSize = CACHE_SIZE;
+
+	std::error_code errorCode;
+	fs::remove_all(settings.cachePath, errorCode);
+
+	bool succeeded = true;
+
+	//Sequential read of the whole object
+	{
+		CS3ObjectStream stream(BUCKET_NAME, OBJECT_NAME, settings);
+		if(stream.GetLength() != objectData.size())
+		{
+			printf("Object size mismatch.\r\n");
+			return -1;
+		}
+
+		auto startTime = Clock::now();
+		for(uint64 position = 0; position < objectData.size(); position += SEQUENTIAL_READ_SIZE)
+		{
+			succeeded &= CheckRead(stream, objectData, position, SEQUENTIAL_READ_SIZE);
+		}
+		auto endTime = Clock::now();
+
+		auto stats = stream.GetStats();
+		printf("Sequential: %llu requests (at most %u at once) in %dms.\r\n",
+		       static_cast<unsigned long long>(stats.requestCount), stats.maxConcurrentRequestCount,
+		       static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()));
+		if(stats.maxConcurrentRequestCount < 2)
+		{
+			printf("Requests were not made concurrently.\r\n");
+			succeeded = false;
+		}
+	}
+
+	//Last chunks were just fetched, a new stream should find them in the disk cache
+	{
+		uint32 getCount = server.GetStats().getCount;
+		CS3ObjectStream stream(BUCKET_NAME, OBJECT_NAME, settings);
+		uint64 tailSize = CACHE_SIZE / 4;
+		succeeded &= CheckRead(stream, objectData, objectData.size() - tailSize, tailSize);
+		auto stats = stream.GetStats();
+		printf("Cached: %llu chunks read from disk cache.\r\n", static_cast<unsigned long long>(stats.diskCacheHitCount));
+		if((stats.diskCacheHitCount == 0) || (server.GetStats().getCount != getCount))
+		{
+			printf("Chunks were not read from disk cache.\r\n");
+			succeeded = false;
+		}
+	}
+
+	//Random reads
+	{
+		CS3ObjectStream stream(BUCKET_NAME, OBJECT_NAME, settings);
+		auto startTime = Clock::now();
+		for(uint32 i = 0; i < RANDOM_READ_COUNT; i++)
+		{
+			uint64 position = random() % objectData.size();
+			succeeded &= CheckRead(stream, objectData, position, RANDOM_READ_SIZE);
+		}
+		auto endTime = Clock::now();
+
+		auto stats = stream.GetStats();
+		printf("Random: %llu requests, %llu chunks read from disk cache in %dms.\r\n",
+		       static_cast<unsigned long long>(stats.requestCount), static_cast<unsigned long long>(stats.diskCacheHitCount),
+		       static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()));
+	}
+
+	{
+		auto diskCacheSize = CS3ChunkCache::GetShared(settings.cachePath, settings.cacheSize)->GetTotalSize();
+		if(diskCacheSize > CACHE_SIZE)
+		{
+			printf("Disk cache is over its maximum size (0x%llx bytes).\r\n", static_cast<unsigned long long>(diskCacheSize));
+			succeeded = false;
+		}
+	}
+
+	fs::remove_all(settings.cachePath, errorCode);
+	return succeeded ? 0 : -1;
+}
+
+#endif
+
+int main(int argc, const char** argv)
+{
+#ifdef HAS_AMAZON_S3
+	try
+	{
+		return RunTest();
+	}
+	catch(const std::exception& exception)
+	{
+		printf("Test failed: %s\r\n", exception.what());
+		return -1;
+	}
+#else
+	printf("S3 support was disabled during build configuration, skipping.\r\n");
+	return 0;
+#endif
+}
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <cstdlib>
+#include "S3StandInServer.h"
+#include "string_format.h"
+
+#ifdef _WIN32
+#include <ws2tcpip.h>
+typedef int socklen_t;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define INVALID_SOCKET (-1)
+#define closesocket close
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define OBJECT_ETAG "0123456789abcdef0123456789abcdef"
+
+CS3StandInServer::CS3StandInServer(std::string bucketName, std::string objectName, std::vector<uint8> objectData, uint32 latencyMs)
+    : m_objectPath("/" + bucketName + "/" + objectName)
+    , m_objectData(std::move(objectData))
+    , m_latencyMs(latencyMs)
+    , m_done(false)
+{
+#ifdef _WIN32
+	WSADATA wsaData = {};
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+	m_listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if(m_listenSocket == INVALID_SOCKET)
+	{
+		throw std::runtime_error("Failed to create socket.");
+	}
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+	socklen_t addressSize = sizeof(address);
+	if(
+	    (bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) ||
+	    (listen(m_listenSocket, SOMAXCONN) != 0) ||
+	    (getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &addressSize) != 0))
+	{
+		closesocket(m_listenSocket);
+		throw std::runtime_error("Failed to listen on loopback interface.");
+	}
+	m_port = ntohs(address.sin_port);
+
+	m_acceptThread = std::thread([this]() { AcceptProc(); });
+}
+
+CS3StandInServer::~CS3StandInServer()
+{
+	//Wake up the accept thread with a connection of our own
+	m_done = true;
+	{
+		SOCKET wakeSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		address.sin_port = htons(m_port);
+		connect(wakeSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+		closesocket(wakeSocket);
+	}
+	m_acceptThread.join();
+	closesocket(m_listenSocket);
+
+	for(auto& connectionThread : m_connectionThreads)
+	{
+		connectionThread.join();
+	}
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+}
+
+std::string CS3StandInServer::GetEndpoint() const
+{
+	return string_format("http://127.0.0.1:%d", m_port);
+}
+
+std::string CS3StandInServer::GetEtag() const
+{
+	return OBJECT_ETAG;
+}
+
+CS3StandInServer::STATS CS3StandInServer::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void CS3StandInServer::AcceptProc()
+{
+	while(1)
+	{
+		SOCKET connectionSocket = accept(m_listenSocket, nullptr, nullptr);
+		if(m_done)
+		{
+			if(connectionSocket != INVALID_SOCKET) closesocket(connectionSocket);
+			break;
+		}
+		if(connectionSocket == INVALID_SOCKET) continue;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_connectionThreads.emplace_back([this, connectionSocket]() { ServeConnection(connectionSocket); });
+	}
+}
+
+void CS3StandInServer::ServeConnection(SOCKET connectionSocket)
+{
+	std::string request;
+	char buffer[0x400];
+	while(request.find("\r\n\r\n") == std::string::npos)
+	{
+		int result = recv(connectionSocket, buffer, sizeof(buffer), 0);
+		if(result <= 0)
+		{
+			closesocket(connectionSocket);
+			return;
+		}
+		request.append(buffer, result);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_activeCount++;
+		m_stats.maxConcurrentCount = std::max(m_stats.maxConcurrentCount, m_activeCount);
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds(m_latencyMs));
+
+	auto methodEnd = request.find(' ');
+	auto pathEnd = request.find(' ', methodEnd + 1);
+	auto method = request.substr(0, methodEnd);
+	auto path = request.substr(methodEnd + 1, pathEnd - methodEnd - 1);
+
+	uint64 rangeStart = 0;
+	uint64 rangeEnd = m_objectData.size() - 1;
+	bool hasRange = false;
+	auto rangePos = request.find("\r\nRange: bytes=");
+	if(rangePos != std::string::npos)
+	{
+		const char* rangeString = request.c_str() + rangePos + strlen("\r\nRange: bytes=");
+		char* rangeStringEnd = nullptr;
+		rangeStart = strtoull(rangeString, &rangeStringEnd, 10);
+		rangeEnd = std::min<uint64>(strtoull(rangeStringEnd + 1, nullptr, 10), m_objectData.size() - 1);
+		hasRange = true;
+	}
+
+	if(path != m_objectPath)
+	{
+		SendResponse(connectionSocket, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n", nullptr, 0);
+	}
+	else if(method == "HEAD")
+	{
+		auto header = string_format("HTTP/1.1 200 OK\r\nContent-Length: %llu\r\nETag: \"%s\"\r\n",
+		                            static_cast<unsigned long long>(m_objectData.size()), OBJECT_ETAG);
+		SendResponse(connectionSocket, header, nullptr, 0);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.headCount++;
+	}
+	else if(method == "GET")
+	{
+		uint64 size = rangeEnd - rangeStart + 1;
+		auto header = hasRange ? string_format("HTTP/1.1 206 Partial Content\r\nContent-Length: %llu\r\nContent-Range: bytes %llu-%llu/%llu\r\n",
+		                                       static_cast<unsigned long long>(size), static_cast<unsigned long long>(rangeStart),
+		                                       static_cast<unsigned long long>(rangeEnd), static_cast<unsigned long long>(m_objectData.size()))
+		                       : string_format("HTTP/1.1 200 OK\r\nContent-Length: %llu\r\n", static_cast<unsigned long long>(size));
+		SendResponse(connectionSocket, header, m_objectData.data() + rangeStart, size);
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.getCount++;
+	}
+	else
+	{
+		SendResponse(connectionSocket, "HTTP/1.1 405 Method Not Allowed\r\nContent-Length: 0\r\n", nullptr, 0);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_activeCount--;
+	}
+
+	closesocket(connectionSocket);
+}
+
+void CS3StandInServer::SendResponse(SOCKET connectionSocket, const std::string& header, const uint8* body, uint64 bodySize)
+{
+	auto fullHeader = header + "Connection: close\r\n\r\n";
+	send(connectionSocket, fullHeader.c_str(), static_cast<int>(fullHeader.size()), MSG_NOSIGNAL);
+	while(bodySize != 0)
+	{
+		int sendSize = static_cast<int>(std::min<uint64>(bodySize, 0x10000));
+		int result = send(connectionSocket, reinterpret_cast<const char*>(body), sendSize, MSG_NOSIGNAL);
+		if(result <= 0) break;
+		body += result;
+		bodySize -= result;
+	}
+}
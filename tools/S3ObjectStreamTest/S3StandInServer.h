@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Types.h"
+
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+typedef int SOCKET;
+#endif
+
+//Minimal HTTP server that serves a single object like S3 would (path style HEAD and ranged GET requests)
+//Every response is delayed to simulate the round-trip time of the real thing
+class CS3StandInServer
+{
+public:
+	struct STATS
+	{
+		uint32 headCount = 0;
+		uint32 getCount = 0;
+		uint32 maxConcurrentCount = 0;
+	};
+
+	CS3StandInServer(std::string bucketName, std::string objectName, std::vector<uint8> objectData, uint32 latencyMs);
+	~CS3StandInServer();
+
+	std::string GetEndpoint() const;
+	std::string GetEtag() const;
+	STATS GetStats();
+
+private:
+	void AcceptProc();
+	void ServeConnection(SOCKET);
+	void SendResponse(SOCKET, const std::string& header, const uint8* body, uint64 bodySize);
+
+	std::string m_objectPath;
+	std::vector<uint8> m_objectData;
+	uint32 m_latencyMs = 0;
+
+	SOCKET m_listenSocket;
+	uint16 m_port = 0;
+	std::atomic<bool> m_done;
+	std::thread m_acceptThread;
+
+	std::mutex m_mutex;
+	std::vector<std::thread> m_connectionThreads;
+	uint32 m_activeCount = 0;
+	STATS m_stats;
+};
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+#include "SectorCacheStream.h"
+
+//Reads a generated disc image through the sector cache with sequential, random and seeking
+//access patterns and checks that what comes out matches the image.
+
+static const uint32 SECTOR_SIZE = CSectorCacheStream::SECTOR_SIZE;
+//Not a multiple of the sector size, last sector is incomplete
+static const uint32 IMAGE_SIZE = (0x2000 * SECTOR_SIZE) - 0x123;
+//Smaller than the image, forces sectors to be evicted
+static const uint32 CACHE_SECTOR_COUNT = 0x400;
+
+//Image stream that counts reads and can be slowed down to make the readahead worker race with the reader
+class CTestImageStream : public Framework::CStream
+{
+public:
+	CTestImageStream(const std::vector<uint8>& data)
+	    : m_data(data)
+	{
+	}
+
+	void Seek(int64 position, Framework::STREAM_SEEK_DIRECTION origin) override
+	{
+		switch(origin)
+		{
+		case Framework::STREAM_SEEK_CUR:
+			m_position += position;
+			break;
+		case Framework::STREAM_SEEK_SET:
+			m_position = position;
+			break;
+		case Framework::STREAM_SEEK_END:
+			m_position = m_data.size() + position;
+			break;
+		}
+	}
+
+	uint64 Tell() override
+	{
+		return m_position;
+	}
+
+	bool IsEOF() override
+	{
+		return m_position >= m_data.size();
+	}
+
+	uint64 Read(void* buffer, uint64 size) override
+	{
+		if(m_delay.count() != 0)
+		{
+			std::this_thread::sleep_for(m_delay);
+		}
+		m_readCount++;
+		size = std::min<uint64>(size, m_data.size() - std::min<uint64>(m_position, m_data.size()));
+		memcpy(buffer, m_data.data() + m_position, size);
+		m_position += size;
+		return size;
+	}
+
+	uint64 Write(const void*, uint64) override
+	{
+		return 0;
+	}
+
+	void SetDelay(std::chrono::microseconds delay)
+	{
+		m_delay = delay;
+	}
+
+	uint32 GetReadCount() const
+	{
+		return m_readCount;
+	}
+
+private:
+	const std::vector<uint8>& m_data;
+	uint64 m_position = 0;
+	std::chrono::microseconds m_delay = std::chrono::microseconds(0);
+	std::atomic<uint32> m_readCount = {0};
+};
+
+static bool CheckRead(CSectorCacheStream& stream, const std::vector<uint8>& image, uint64 position, uint32 size)
+{
+	std::vector<uint8> buffer(size);
+	stream.Seek(position, Framework::STREAM_SEEK_SET);
+	uint64 readSize = stream.Read(buffer.data(), size);
+	uint64 expectedSize = std::min<uint64>(size, image.size() - std::min<uint64>(position, image.size()));
+	if(readSize != expectedSize)
+	{
+		printf("Failed: read at 0x%llX returned %llu bytes, expected %llu.\r\n",
+		       static_cast<unsigned long long>(position), static_cast<unsigned long long>(readSize), static_cast<unsigned long long>(expectedSize));
+		return false;
+	}
+	if(memcmp(buffer.data(), image.data() + position, readSize) != 0)
+	{
+		printf("Failed: read at 0x%llX returned wrong data.\r\n", static_cast<unsigned long long>(position));
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, const char** argv)
+{
+	std::mt19937 random;
+	std::vector<uint8> image(IMAGE_SIZE);
+	for(auto& value : image)
+	{
+		value = static_cast<uint8>(random());
+	}
+
+	auto baseStream = std::make_shared<CTestImageStream>(image);
+	bool succeeded = true;
+
+	{
+		CSectorCacheStream stream(baseStream, CACHE_SECTOR_COUNT);
+
+		//Sequential reads, like a game streaming a file, readahead kicks in
+		for(uint64 position = 0; position < IMAGE_SIZE; position += 0x10 * SECTOR_SIZE)
+		{
+			succeeded &= CheckRead(stream, image, position, 0x10 * SECTOR_SIZE);
+		}
+
+		//Most of the sequential reads were served by readaheads
+		auto stats = stream.GetStats();
+		if((stats.readAheadHitCount == 0) || (stats.hitCount < stats.readAheadHitCount))
+		{
+			printf("Failed: sequential reads didn't use readaheads.\r\n");
+			succeeded = false;
+		}
+
+		//Reading the same range again right after comes from the cache
+		uint32 readCount = baseStream->GetReadCount();
+		uint64 lastPosition = IMAGE_SIZE - (0x40 * SECTOR_SIZE);
+		succeeded &= CheckRead(stream, image, lastPosition, 0x40 * SECTOR_SIZE);
+		if(baseStream->GetReadCount() != readCount)
+		{
+			printf("Failed: cached sectors were read again from the base stream.\r\n");
+			succeeded = false;
+		}
+
+		//Unaligned reads, reads crossing sectors and reads going past the end
+		for(uint32 i = 0; i < 0x400; i++)
+		{
+			uint64 position = random() % (IMAGE_SIZE + SECTOR_SIZE);
+			uint32 size = (random() % (4 * SECTOR_SIZE)) + 1;
+			succeeded &= CheckRead(stream, image, position, size);
+		}
+	}
+
+	{
+		//Slow base stream, reader keeps seeking away while readaheads are in flight or queued
+		baseStream->SetDelay(std::chrono::microseconds(200));
+		CSectorCacheStream stream(baseStream, CACHE_SECTOR_COUNT);
+		for(uint32 i = 0; i < 0x40; i++)
+		{
+			uint64 position = static_cast<uint64>(random() % (IMAGE_SIZE / SECTOR_SIZE)) * SECTOR_SIZE;
+			for(uint32 j = 0; j < 4; j++)
+			{
+				succeeded &= CheckRead(stream, image, position + (j * 2 * SECTOR_SIZE), 2 * SECTOR_SIZE);
+			}
+		}
+	}
+
+	if(succeeded)
+	{
+		printf("Passed.\r\n");
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,360 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "iop/Iop_SpuBase.h"
+
+//Plays canned SPU register traces, shaped after what PsfPlayer sees when playing sequenced music,
+//through the per-tick and the block mixing paths of CSpuBase. Checks that both paths give the exact same
+//output and channel states, then measures the time spent rendering with each of them.
+
+static const uint32 RAM_SIZE = 0x200000;
+static const uint32 SAMPLE_BASE = 0x5000;
+static const uint32 SAMPLE_COUNT = 32;
+static const uint32 REVERB_WORK_START = 0x1E0000;
+static const uint32 REVERB_WORK_END = 0x1FFFFF;
+static const uint32 SPU_BASE_SAMPLING_RATE = 48000;
+static const uint32 DST_SAMPLE_RATE = 44100;
+//Same amount of samples PsfPlayer renders at once
+static const uint32 RENDER_SAMPLE_COUNT = 44 * 2;
+static const uint32 RENDER_COUNT = 2000;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+enum EVENT_TYPE
+{
+	EVENT_KEY_ON,
+	EVENT_KEY_OFF,
+	EVENT_PITCH,
+	EVENT_VOLUME_LEFT,
+	EVENT_VOLUME_RIGHT,
+	EVENT_ADSR_LEVEL,
+	EVENT_ADSR_RATE,
+	EVENT_ADDRESS,
+	EVENT_REPEAT,
+	EVENT_STREAM_BLOCK,
+};
+
+struct TRACE_EVENT
+{
+	uint32 renderIndex;
+	EVENT_TYPE type;
+	uint32 channel;
+	uint32 value;
+};
+
+struct TRACE
+{
+	const char* name;
+	uint16 control;
+	uint32 irqAddress;
+	uint32 reverbChannels;
+	std::vector<TRACE_EVENT> events;
+};
+
+struct SAMPLE_INFO
+{
+	uint32 address;
+	uint32 repeat;
+};
+
+//Encodes random ADPCM blocks, some samples loop, others stop on their last block
+static std::vector<SAMPLE_INFO> WriteSamples(std::mt19937& random, uint8* ram)
+{
+	std::vector<SAMPLE_INFO> samples;
+	uint32 address = SAMPLE_BASE;
+	for(uint32 i = 0; i < SAMPLE_COUNT; i++)
+	{
+		uint32 blockCount = 4 + (random() % 60);
+		bool isLooping = (i % 3) != 0;
+		uint32 repeatBlock = isLooping ? (random() % blockCount) : 0;
+		samples.push_back({address, address + (repeatBlock * 0x10)});
+		for(uint32 block = 0; block < blockCount; block++)
+		{
+			uint8* blockData = ram + address;
+			uint8 flags = 0;
+			if(isLooping && (block == repeatBlock)) flags |= 0x04;
+			if(block == (blockCount - 1)) flags |= isLooping ? 0x03 : 0x01;
+			blockData[0] = static_cast<uint8>((4 + (random() % 9)) | ((random() % 5) << 4));
+			blockData[1] = flags;
+			for(uint32 j = 2; j < 0x10; j++)
+			{
+				blockData[j] = static_cast<uint8>(random());
+			}
+			address += 0x10;
+		}
+	}
+	return samples;
+}
+
+static uint16 GenerateVolume(std::mt19937& random, bool allowSweeps)
+{
+	if(allowSweeps && ((random() % 3) == 0))
+	{
+		//Linear sweep, increasing or decreasing
+		uint16 decrease = (random() & 1) ? 0x2000 : 0;
+		return static_cast<uint16>(0x8000 | decrease | (random() % 0x80));
+	}
+	return static_cast<uint16>(random() % 0x4000);
+}
+
+static TRACE GenerateTrace(std::mt19937& random, const std::vector<SAMPLE_INFO>& samples, const char* name,
+                           uint32 channelCount, uint32 noteLength, bool allowSweeps, bool checkIrqs, bool useStreaming)
+{
+	TRACE trace;
+	trace.name = name;
+	trace.control = 0x8000 | Iop::CSpuBase::CONTROL_REVERB | (checkIrqs ? Iop::CSpuBase::CONTROL_IRQ : 0);
+	trace.irqAddress = checkIrqs ? (samples[1].address + 0x20) : 0;
+	trace.reverbChannels = random() & 0xFFFFFF;
+
+	for(uint32 renderIndex = 0; renderIndex < RENDER_COUNT; renderIndex++)
+	{
+		if(useStreaming)
+		{
+			trace.events.push_back({renderIndex, EVENT_STREAM_BLOCK, 0, 0});
+		}
+		for(uint32 channel = 0; channel < channelCount; channel++)
+		{
+			//Notes start on a fixed grid like they would with a sequencer
+			uint32 phase = renderIndex + (channel * 7);
+			if((phase % noteLength) == 0)
+			{
+				const auto& sample = samples[random() % samples.size()];
+				//Attack, decay and sustain/release modes are picked from both linear and exponential ones
+				uint16 adsrLevel = static_cast<uint16>(random());
+				uint16 adsrRate = static_cast<uint16>(random());
+				trace.events.push_back({renderIndex, EVENT_ADDRESS, channel, sample.address});
+				trace.events.push_back({renderIndex, EVENT_REPEAT, channel, sample.repeat});
+				trace.events.push_back({renderIndex, EVENT_PITCH, channel, static_cast<uint32>(0x400 + (random() % 0x2000))});
+				trace.events.push_back({renderIndex, EVENT_ADSR_LEVEL, channel, adsrLevel});
+				trace.events.push_back({renderIndex, EVENT_ADSR_RATE, channel, adsrRate});
+				trace.events.push_back({renderIndex, EVENT_VOLUME_LEFT, channel, GenerateVolume(random, allowSweeps)});
+				trace.events.push_back({renderIndex, EVENT_VOLUME_RIGHT, channel, GenerateVolume(random, allowSweeps)});
+				trace.events.push_back({renderIndex, EVENT_KEY_ON, channel, 0});
+			}
+			else if((phase % noteLength) == ((noteLength * 3) / 4))
+			{
+				trace.events.push_back({renderIndex, EVENT_KEY_OFF, channel, 0});
+			}
+		}
+	}
+
+	return trace;
+}
+
+static void SetupSpu(Iop::CSpuBase& spu, std::mt19937& random, const TRACE& trace)
+{
+	spu.Reset();
+	spu.SetBaseSamplingRate(SPU_BASE_SAMPLING_RATE);
+	spu.SetControl(trace.control);
+	spu.SetIrqAddress(trace.irqAddress);
+	spu.SetChannelReverbLo(static_cast<uint16>(trace.reverbChannels));
+	spu.SetChannelReverbHi(static_cast<uint16>(trace.reverbChannels >> 16));
+	spu.SetReverbWorkAddressStart(REVERB_WORK_START);
+	spu.SetReverbWorkAddressEnd(REVERB_WORK_END);
+	for(unsigned int i = 0; i < Iop::CSpuBase::REVERB_PARAM_COUNT; i++)
+	{
+		uint32 value = Iop::CSpuBase::g_reverbParamIsAddress[i] ? ((random() % 0x4000) * 2) : (random() & 0xFFFF);
+		spu.SetReverbParam(i, value);
+	}
+	//Feedback sources are subtracted from mix destinations
+	spu.SetReverbParam(Iop::CSpuBase::FB_SRC_A, 0x100);
+	spu.SetReverbParam(Iop::CSpuBase::FB_SRC_B, 0x200);
+}
+
+static void ApplyEvent(Iop::CSpuBase& spu, const TRACE_EVENT& event, const uint8* streamBlock)
+{
+	auto& channel = spu.GetChannel(event.channel);
+	switch(event.type)
+	{
+	case EVENT_KEY_ON:
+		spu.SendKeyOn(1 << event.channel);
+		break;
+	case EVENT_KEY_OFF:
+		spu.SendKeyOff(1 << event.channel);
+		break;
+	case EVENT_PITCH:
+		channel.pitch = static_cast<uint16>(event.value);
+		break;
+	case EVENT_VOLUME_LEFT:
+		channel.volumeLeft <<= static_cast<uint16>(event.value);
+		if(channel.volumeLeft.mode.mode == 0)
+		{
+			channel.volumeLeftAbs = channel.volumeLeft.volume.volume << 17;
+		}
+		break;
+	case EVENT_VOLUME_RIGHT:
+		channel.volumeRight <<= static_cast<uint16>(event.value);
+		if(channel.volumeRight.mode.mode == 0)
+		{
+			channel.volumeRightAbs = channel.volumeRight.volume.volume << 17;
+		}
+		break;
+	case EVENT_ADSR_LEVEL:
+		channel.adsrLevel <<= static_cast<uint16>(event.value);
+		break;
+	case EVENT_ADSR_RATE:
+		channel.adsrRate <<= static_cast<uint16>(event.value);
+		break;
+	case EVENT_ADDRESS:
+		channel.address = event.value;
+		break;
+	case EVENT_REPEAT:
+		channel.repeat = event.value;
+		break;
+	case EVENT_STREAM_BLOCK:
+		spu.SetTransferMode(Iop::CSpuBase::TRANSFER_MODE_BLOCK_CORE0IN);
+		spu.SetTransferAddress(0);
+		spu.ReceiveDma(const_cast<uint8*>(streamBlock), 0x40, 0x10);
+		break;
+	}
+}
+
+struct PLAYER
+{
+	PLAYER(bool blockMixingEnabled, const std::vector<uint8>& initialRam)
+	    : ram(initialRam)
+	    , spu(ram.data(), RAM_SIZE, 0)
+	{
+		spu.SetBlockMixingEnabled(blockMixingEnabled);
+	}
+
+	std::vector<uint8> ram;
+	Iop::CSpuBase spu;
+	int16 output[RENDER_SAMPLE_COUNT];
+	uint32 irqCount = 0;
+};
+
+static void Render(PLAYER& player, const TRACE& trace, uint32 renderIndex, size_t& eventIndex, const uint8* streamBlock)
+{
+	for(; (eventIndex < trace.events.size()) && (trace.events[eventIndex].renderIndex == renderIndex); eventIndex++)
+	{
+		ApplyEvent(player.spu, trace.events[eventIndex], streamBlock);
+	}
+	player.spu.Render(player.output, RENDER_SAMPLE_COUNT, DST_SAMPLE_RATE);
+	if(player.spu.GetIrqPending())
+	{
+		player.irqCount++;
+		player.spu.ClearIrqPending();
+	}
+}
+
+static bool AreChannelsEqual(Iop::CSpuBase& spu0, Iop::CSpuBase& spu1)
+{
+	for(unsigned int i = 0; i < Iop::CSpuBase::MAX_CHANNEL; i++)
+	{
+		const auto& channel0 = spu0.GetChannel(i);
+		const auto& channel1 = spu1.GetChannel(i);
+		if(
+		    (channel0.status != channel1.status) ||
+		    (channel0.adsrVolume != channel1.adsrVolume) ||
+		    (channel0.volumeLeftAbs != channel1.volumeLeftAbs) ||
+		    (channel0.volumeRightAbs != channel1.volumeRightAbs) ||
+		    (channel0.current != channel1.current) ||
+		    (channel0.repeat != channel1.repeat))
+		{
+			return false;
+		}
+	}
+	return spu0.GetEndFlags().f == spu1.GetEndFlags().f;
+}
+
+static bool CheckTrace(const TRACE& trace, const std::vector<uint8>& ram, std::mt19937& random)
+{
+	PLAYER tickPlayer(false, ram);
+	PLAYER blockPlayer(true, ram);
+	{
+		auto setupRandom = random;
+		SetupSpu(tickPlayer.spu, setupRandom, trace);
+	}
+	SetupSpu(blockPlayer.spu, random, trace);
+
+	uint8 streamBlock[0x400];
+	size_t tickEventIndex = 0;
+	size_t blockEventIndex = 0;
+	for(uint32 renderIndex = 0; renderIndex < RENDER_COUNT; renderIndex++)
+	{
+		for(auto& value : streamBlock)
+		{
+			value = static_cast<uint8>(random());
+		}
+		Render(tickPlayer, trace, renderIndex, tickEventIndex, streamBlock);
+		Render(blockPlayer, trace, renderIndex, blockEventIndex, streamBlock);
+		if(memcmp(tickPlayer.output, blockPlayer.output, sizeof(tickPlayer.output)))
+		{
+			printf("%s: output differs at render %d.\r\n", trace.name, renderIndex);
+			return false;
+		}
+		if(!AreChannelsEqual(tickPlayer.spu, blockPlayer.spu) || (tickPlayer.irqCount != blockPlayer.irqCount))
+		{
+			printf("%s: channel state or IRQs differ at render %d.\r\n", trace.name, renderIndex);
+			return false;
+		}
+	}
+	if(tickPlayer.ram != blockPlayer.ram)
+	{
+		printf("%s: SPU RAM (reverb work area) differs.\r\n", trace.name);
+		return false;
+	}
+	return true;
+}
+
+static double MeasureTrace(const TRACE& trace, const std::vector<uint8>& ram, bool blockMixingEnabled, uint32 iterationCount)
+{
+	uint8 streamBlock[0x400] = {};
+	double duration = 0;
+	for(uint32 iteration = 0; iteration < iterationCount; iteration++)
+	{
+		std::mt19937 random;
+		PLAYER player(blockMixingEnabled, ram);
+		SetupSpu(player.spu, random, trace);
+		size_t eventIndex = 0;
+		auto startTime = Clock::now();
+		for(uint32 renderIndex = 0; renderIndex < RENDER_COUNT; renderIndex++)
+		{
+			Render(player, trace, renderIndex, eventIndex, streamBlock);
+		}
+		auto endTime = Clock::now();
+		duration += std::chrono::duration<double, std::micro>(endTime - startTime).count();
+	}
+	return duration / (static_cast<double>(iterationCount) * RENDER_COUNT);
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 iterationCount = 10;
+	if(argc > 1) iterationCount = atoi(argv[1]);
+	if(iterationCount == 0)
+	{
+		printf("Usage: SpuMixBenchmark [iterationCount]\r\n");
+		return -1;
+	}
+
+	std::mt19937 random;
+	std::vector<uint8> ram(RAM_SIZE);
+	auto samples = WriteSamples(random, ram.data());
+
+	std::vector<TRACE> traces;
+	traces.push_back(GenerateTrace(random, samples, "Sequence", 16, 150, false, false, false));
+	traces.push_back(GenerateTrace(random, samples, "Sweeps & IRQs", 24, 90, true, true, false));
+	traces.push_back(GenerateTrace(random, samples, "Dense & Streaming", 24, 400, true, false, true));
+
+	bool succeeded = true;
+	for(const auto& trace : traces)
+	{
+		std::mt19937 traceRandom;
+		succeeded &= CheckTrace(trace, ram, traceRandom);
+	}
+
+	for(const auto& trace : traces)
+	{
+		double tickDuration = MeasureTrace(trace, ram, false, iterationCount);
+		double blockDuration = MeasureTrace(trace, ram, true, iterationCount);
+		printf("%-20s per tick: %8.2f us/render block: %8.2f us/render speedup: %.2fx\r\n",
+		       trace.name, tickDuration, blockDuration, tickDuration / blockDuration);
+	}
+
+	return succeeded ? 0 : -1;
+}
@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+#include "iop/Iop_Spu2.h"
+#include "iop/Iop_Spu2_Core.h"
+#include "iop/Iop_SpuBase.h"
+#include "iop/Iop_SpuRenderThread.h"
+
+//Plays random SPU2 register traces through CSpuRenderThread, once rendering inline and twice rendering on the
+//SPU thread. Every run must give the same samples and register reads, and the IRQ state polled between writes
+//(like the IOP does on every tick) must stay latched while a block renders and match the inline one once synced.
+
+using namespace Iop;
+
+static const uint32 RAM_SIZE = 0x200000;
+static const uint32 SAMPLE_BASE = 0x5000;
+static const uint32 SAMPLE_COUNT = 32;
+static const uint32 SAMPLE_SIZE = 0x800;
+static const uint32 DST_SAMPLE_RATE = 44100;
+static const uint32 RENDER_SAMPLE_COUNT = 44 * 2;
+static const uint32 RENDER_COUNT = 3000;
+//Blocks between two explicit syncs
+static const uint32 SYNC_INTERVAL = 16;
+static const uint32 CORE_COUNT = 2;
+//Registers of the second core are right after the ones of the first one
+static const uint32 CORE_REGS_SIZE = 0x400;
+//Except for the ones starting at P_MVOLL
+static const uint32 CORE_MIX_REGS_SIZE = 0x28;
+static const uint32 CHANNEL_REGS_SIZE = 0x10;
+static const uint32 CHANNEL_ADDRESS_REGS_SIZE = 0x0C;
+//Enough writes to fill the render thread's queue
+static const uint32 BURST_WRITE_COUNT = 0x1100;
+
+struct RUN_RESULT
+{
+	std::vector<int16> samples;
+	std::vector<uint32> reads;
+	//IRQ state polled after every write
+	std::vector<uint8> irqStates;
+	//IRQ state at every explicit sync
+	std::vector<uint8> syncedIrqStates;
+	uint32 irqCount = 0;
+	bool irqChangedWhileRendering = false;
+};
+
+static void WriteSamples(uint8* ram, uint32 seed)
+{
+	std::mt19937 random(seed);
+	for(uint32 i = 0; i < SAMPLE_COUNT; i++)
+	{
+		for(uint32 offset = 0; offset < SAMPLE_SIZE; offset += 0x10)
+		{
+			uint8* blockData = ram + SAMPLE_BASE + (i * SAMPLE_SIZE) + offset;
+			bool isLastBlock = (offset == (SAMPLE_SIZE - 0x10));
+			blockData[0] = static_cast<uint8>((4 + (random() % 9)) | ((random() % 5) << 4));
+			blockData[1] = isLastBlock ? 0x03 : 0;
+			for(uint32 j = 2; j < 0x10; j++)
+			{
+				blockData[j] = static_cast<uint8>(random());
+			}
+		}
+	}
+}
+
+static RUN_RESULT Run(bool threaded, uint32 seed)
+{
+	std::vector<uint8> ram(RAM_SIZE);
+	WriteSamples(ram.data(), seed);
+
+	CSpuBase spuCore0(ram.data(), RAM_SIZE, 0);
+	CSpuBase spuCore1(ram.data(), RAM_SIZE, 1);
+	CSpu2 spu2(spuCore0, spuCore1);
+	spuCore0.Reset();
+	spuCore1.Reset();
+	spu2.Reset();
+
+	CSpuRenderThread renderThread(spuCore0, spuCore1,
+	                              [&spu2](uint32 address, uint32 value) { spu2.WriteRegister(address, value); });
+	renderThread.SetThreaded(threaded);
+
+	RUN_RESULT result;
+	result.samples.resize(RENDER_SAMPLE_COUNT * RENDER_COUNT);
+
+	//IRQ state seen since the block being rendered was started, -1 if there's no block in flight
+	int renderingIrqState = -1;
+	auto pollIrq =
+	    [&]() {
+		    uint8 irqState = renderThread.GetIrqPending() ? 1 : 0;
+		    if(!renderThread.IsRendering())
+		    {
+			    renderingIrqState = -1;
+		    }
+		    else if(renderingIrqState == -1)
+		    {
+			    renderingIrqState = irqState;
+		    }
+		    else if(renderingIrqState != irqState)
+		    {
+			    result.irqChangedWhileRendering = true;
+		    }
+		    result.irqStates.push_back(irqState);
+	    };
+	auto write =
+	    [&](uint32 address, uint32 value) {
+		    renderThread.WriteRegister(address, value);
+		    pollIrq();
+	    };
+	auto read =
+	    [&](uint32 address) {
+		    renderThread.Sync();
+		    uint32 value = spu2.ReadRegister(address);
+		    pollIrq();
+		    return value;
+	    };
+
+	std::mt19937 random(seed);
+	for(uint32 core = 0; core < CORE_COUNT; core++)
+	{
+		uint32 coreBase = core * CORE_REGS_SIZE;
+		uint32 irqAddress = (SAMPLE_BASE + ((core + 1) * SAMPLE_SIZE) + 0x100) / 2;
+		write(Spu2::CCore::CORE_ATTR + coreBase, 0x8000 | CSpuBase::CONTROL_IRQ);
+		write(Spu2::CCore::P_MVOLL + (core * CORE_MIX_REGS_SIZE), 0x3FFF);
+		write(Spu2::CCore::P_MVOLR + (core * CORE_MIX_REGS_SIZE), 0x3FFF);
+		write(Spu2::CCore::A_IRQA_HI + coreBase, irqAddress >> 16);
+		write(Spu2::CCore::A_IRQA_LO + coreBase, irqAddress & 0xFFFF);
+	}
+
+	for(uint32 renderIndex = 0; renderIndex < RENDER_COUNT; renderIndex++)
+	{
+		uint32 writeCount = ((random() % 256) == 0) ? BURST_WRITE_COUNT : (random() % 40);
+		for(uint32 i = 0; i < writeCount; i++)
+		{
+			uint32 coreBase = (random() % CORE_COUNT) * CORE_REGS_SIZE;
+			uint32 channel = random() % 24;
+			uint32 channelBase = coreBase + (channel * CHANNEL_REGS_SIZE);
+			uint32 channelAddressBase = coreBase + (channel * CHANNEL_ADDRESS_REGS_SIZE);
+			switch(random() % 8)
+			{
+			case 0:
+				write(Spu2::CCore::VP_PITCH + channelBase, random() % 0x3FFF);
+				break;
+			case 1:
+				write(Spu2::CCore::VP_VOLL + channelBase, random() % 0x3FFF);
+				write(Spu2::CCore::VP_VOLR + channelBase, random() % 0x3FFF);
+				break;
+			case 2:
+				write(Spu2::CCore::VP_ADSR1 + channelBase, random() & 0xFFFF);
+				write(Spu2::CCore::VP_ADSR2 + channelBase, random() & 0xFFFF);
+				break;
+			case 3:
+			{
+				uint32 address = (SAMPLE_BASE + ((random() % SAMPLE_COUNT) * SAMPLE_SIZE)) / 2;
+				write(Spu2::CCore::VA_SSA_HI + channelAddressBase, address >> 16);
+				write(Spu2::CCore::VA_SSA_LO + channelAddressBase, address & 0xFFFF);
+			}
+			break;
+			case 4:
+				write(Spu2::CCore::A_KON_HI + coreBase, 1 << (channel % 16));
+				break;
+			case 5:
+				write(Spu2::CCore::A_KOFF_HI + coreBase, 1 << (channel % 16));
+				break;
+			case 6:
+				result.reads.push_back(read(Spu2::CCore::S_ENDX_HI + coreBase));
+				result.reads.push_back(read(Spu2::CCore::VP_ENVX + channelBase));
+				break;
+			case 7:
+			{
+				//Acknowledges IRQs, like an IRQ handler would
+				uint32 irqInfo = read(CSpu2::C_IRQINFO);
+				result.reads.push_back(irqInfo);
+				result.irqCount += (irqInfo != 0) ? 1 : 0;
+			}
+			break;
+			}
+		}
+
+		renderingIrqState = -1;
+		renderThread.Render(result.samples.data() + (renderIndex * RENDER_SAMPLE_COUNT), RENDER_SAMPLE_COUNT, DST_SAMPLE_RATE);
+		pollIrq();
+
+		if((renderIndex % SYNC_INTERVAL) == (SYNC_INTERVAL - 1))
+		{
+			renderThread.Sync();
+			result.syncedIrqStates.push_back(renderThread.GetIrqPending() ? 1 : 0);
+		}
+	}
+
+	renderThread.Sync();
+	return result;
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 seedCount = 4;
+	if(argc > 1) seedCount = atoi(argv[1]);
+	if(seedCount == 0)
+	{
+		printf("Usage: SpuRenderThreadTest [seedCount]\r\n");
+		return -1;
+	}
+
+	bool succeeded = true;
+	for(uint32 seed = 1; seed <= seedCount; seed++)
+	{
+		auto inlineResult = Run(false, seed);
+		auto threadedResult = Run(true, seed);
+		auto threadedResult2 = Run(true, seed);
+
+		if(inlineResult.irqCount == 0)
+		{
+			printf("Failed: no IRQ was raised (seed %d).\r\n", seed);
+			succeeded = false;
+		}
+		if(threadedResult.samples != inlineResult.samples)
+		{
+			printf("Failed: threaded rendering gave different samples (seed %d).\r\n", seed);
+			succeeded = false;
+		}
+		if(threadedResult.reads != inlineResult.reads)
+		{
+			printf("Failed: threaded rendering gave different register reads (seed %d).\r\n", seed);
+			succeeded = false;
+		}
+		if(threadedResult.syncedIrqStates != inlineResult.syncedIrqStates)
+		{
+			printf("Failed: threaded rendering gave a different IRQ state once synced (seed %d).\r\n", seed);
+			succeeded = false;
+		}
+		if(threadedResult.irqChangedWhileRendering)
+		{
+			printf("Failed: IRQ state changed while a block was rendering (seed %d).\r\n", seed);
+			succeeded = false;
+		}
+		if((threadedResult2.samples != threadedResult.samples) || (threadedResult2.reads != threadedResult.reads) ||
+		   (threadedResult2.irqStates != threadedResult.irqStates))
+		{
+			printf("Failed: threaded rendering isn't deterministic (seed %d).\r\n", seed);
+			succeeded = false;
+		}
+		printf("Seed %d: %d IRQs.\r\n", seed, inlineResult.irqCount);
+	}
+
+	if(succeeded)
+	{
+		printf("Passed.\r\n");
+	}
+	return succeeded ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <vector>
+#include "MIPS.h"
+#include "Ps2Const.h"
+#include "ee/DMAC.h"
+#include "ee/GIF.h"
+#include "ee/INTC.h"
+#include "ee/Vif.h"
+#include "ee/Vpu.h"
+
+//Measures VIF1 UNPACK throughput with the bulk unpackers and with the generic path, and checks
+//that both paths leave VU memory, VIF registers and VU state in the same state.
+
+static const uint32 PACKET_ADDRESS = 0x100000;
+static const uint32 UNPACK_COUNT = 64;
+
+typedef std::chrono::high_resolution_clock Clock;
+
+//VIF registers that can be read without side effects (reading MARK clears STAT.MRK)
+static const uint32 g_vifRegisters[] =
+    {
+        CVif::VIF1_STAT,
+        CVif::VIF1_CYCLE,
+        CVif::VIF1_MODE,
+        CVif::VIF1_NUM,
+        CVif::VIF1_MASK,
+        CVif::VIF1_CODE,
+        CVif::VIF1_R0,
+        CVif::VIF1_R1,
+        CVif::VIF1_R2,
+        CVif::VIF1_R3,
+};
+
+struct MACHINE_STATE
+{
+	uint32 vifRegisters[sizeof(g_vifRegisters) / sizeof(g_vifRegisters[0])];
+	uint32 top;
+	uint32 itop;
+	MIPSSTATE vuState;
+};
+
+struct UNPACK_CASE
+{
+	const char* name;
+	uint32 dataType;
+	bool usn;
+	bool useMask;
+	uint32 mode;
+	uint32 cl;
+	uint32 wl;
+};
+
+static const UNPACK_CASE g_unpackCases[] =
+    {
+        {"V4-32", 0x0C, false, false, 0, 4, 4},
+        {"V3-32", 0x08, false, false, 0, 4, 4},
+        {"V2-32", 0x04, false, false, 0, 4, 4},
+        {"S-32", 0x00, false, false, 0, 4, 4},
+        {"V4-16", 0x0D, false, false, 0, 4, 4},
+        {"V3-16 USN", 0x09, true, false, 0, 4, 4},
+        {"V4-8 USN", 0x0E, true, false, 0, 4, 4},
+        {"V3-8", 0x0A, false, false, 0, 4, 4},
+        {"V4-5", 0x0F, false, false, 0, 4, 4},
+        {"V3-32 OFFSET", 0x08, false, false, 1, 4, 4},
+        {"V4-16 DIFFERENCE", 0x0D, false, false, 2, 4, 4},
+        {"V4-8 MASK", 0x0E, true, true, 0, 4, 4},
+        {"V3-16 MASK DIFFERENCE", 0x09, false, true, 2, 4, 4},
+        {"V4-32 SKIP", 0x0C, false, false, 0, 4, 2},
+        {"V2-16 MASK SKIP", 0x05, false, true, 1, 3, 1},
+};
+
+static uint32 GetElementSize(uint32 dataType)
+{
+	uint32 fieldCount = (dataType >> 2) + 1;
+	uint32 fieldSize = 4 >> (dataType & 3);
+	return (dataType == 0x0F) ? 2 : (fieldCount * fieldSize);
+}
+
+//Writes a VIF packet that sets up the unpack state and does UNPACK_COUNT unpacks of 256 elements,
+//returns its size in quadwords
+static uint32 WritePacket(uint8* ram, const UNPACK_CASE& unpackCase, std::mt19937& random)
+{
+	std::vector<uint32> packet;
+	//STCYCL
+	packet.push_back((0x01 << 24) | (unpackCase.wl << 8) | unpackCase.cl);
+	//STMOD
+	packet.push_back((0x05 << 24) | unpackCase.mode);
+	//STMASK
+	packet.push_back(0x20 << 24);
+	packet.push_back(random());
+	//STROW
+	packet.push_back(0x30 << 24);
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		packet.push_back(random());
+	}
+	//STCOL
+	packet.push_back(0x31 << 24);
+	for(unsigned int i = 0; i < 4; i++)
+	{
+		packet.push_back(random());
+	}
+
+	uint32 elementSize = GetElementSize(unpackCase.dataType);
+	uint32 dataWordCount = ((elementSize * 256) + 3) / 4;
+	for(uint32 unpack = 0; unpack < UNPACK_COUNT; unpack++)
+	{
+		uint32 command = 0x60 | unpackCase.dataType | (unpackCase.useMask ? 0x10 : 0);
+		uint32 imm = (unpack * 0x10) & 0x3FF;
+		if(unpackCase.usn) imm |= 0x4000;
+		packet.push_back((command << 24) | (0 << 16) | imm);
+		for(uint32 i = 0; i < dataWordCount; i++)
+		{
+			packet.push_back(random());
+		}
+	}
+
+	while(packet.size() & 3)
+	{
+		//NOP
+		packet.push_back(0);
+	}
+
+	memcpy(ram + PACKET_ADDRESS, packet.data(), packet.size() * 4);
+	return static_cast<uint32>(packet.size() / 4);
+}
+
+int main(int argc, const char** argv)
+{
+	uint32 iterationCount = 200;
+	if(argc > 1) iterationCount = atoi(argv[1]);
+	if(iterationCount == 0)
+	{
+		printf("Usage: VifUnpackBenchmark [iterationCount]\r\n");
+		return -1;
+	}
+
+	auto ram = std::make_unique<uint8[]>(PS2::EE_RAM_SIZE);
+	auto spr = std::make_unique<uint8[]>(PS2::EE_SPR_SIZE);
+	auto vuMem0 = std::make_unique<uint8[]>(PS2::VUMEM0SIZE);
+	auto vuMem1 = std::make_unique<uint8[]>(PS2::VUMEM1SIZE);
+	auto microMem1 = std::make_unique<uint8[]>(PS2::MICROMEM1SIZE);
+	auto referenceVuMem1 = std::make_unique<uint8[]>(PS2::VUMEM1SIZE);
+
+	CMIPS ee(MEMORYMAP_ENDIAN_LSBF);
+	CMIPS vu1(MEMORYMAP_ENDIAN_LSBF);
+	CDMAC dmac(ram.get(), spr.get(), vuMem0.get(), ee);
+	CINTC intc(dmac);
+	CGSHandler* gs = nullptr;
+	CGIF gif(gs, ram.get(), spr.get());
+	CVpu vpu(1, CVpu::VPUINIT(microMem1.get(), vuMem1.get(), &vu1), gif, intc, ram.get(), spr.get());
+	auto& vif = vpu.GetVif();
+
+	bool succeeded = true;
+	std::mt19937 random;
+
+	for(const auto& unpackCase : g_unpackCases)
+	{
+		uint32 qwc = WritePacket(ram.get(), unpackCase, random);
+
+		auto runPacket =
+		    [&](bool bulkUnpackEnabled) {
+			    vif.Reset();
+			    vif.SetBulkUnpackEnabled(bulkUnpackEnabled);
+			    memset(vuMem1.get(), 0xCC, PS2::VUMEM1SIZE);
+			    return vif.ReceiveDMA(PACKET_ADDRESS, qwc, Dmac::CChannel::CHCR_DIR_FROM, false) == qwc;
+		    };
+
+		auto getMachineState =
+		    [&]() {
+			    MACHINE_STATE state = {};
+			    for(unsigned int i = 0; i < sizeof(g_vifRegisters) / sizeof(g_vifRegisters[0]); i++)
+			    {
+				    state.vifRegisters[i] = vif.GetRegister(g_vifRegisters[i]);
+			    }
+			    state.top = vif.GetTOP();
+			    state.itop = vif.GetITOP();
+			    state.vuState = vu1.m_State;
+			    return state;
+		    };
+
+		bool processed = runPacket(false);
+		memcpy(referenceVuMem1.get(), vuMem1.get(), PS2::VUMEM1SIZE);
+		auto referenceState = getMachineState();
+		processed &= runPacket(true);
+		auto state = getMachineState();
+		if(!processed)
+		{
+			printf("%s: packet wasn't entirely processed.\r\n", unpackCase.name);
+			succeeded = false;
+			continue;
+		}
+		if(memcmp(referenceVuMem1.get(), vuMem1.get(), PS2::VUMEM1SIZE) != 0)
+		{
+			printf("%s: bulk unpack result differs from generic path.\r\n", unpackCase.name);
+			succeeded = false;
+			continue;
+		}
+		if(memcmp(referenceState.vifRegisters, state.vifRegisters, sizeof(state.vifRegisters)) != 0)
+		{
+			printf("%s: VIF registers differ from generic path.\r\n", unpackCase.name);
+			succeeded = false;
+			continue;
+		}
+		if((referenceState.top != state.top) || (referenceState.itop != state.itop) ||
+		   (memcmp(&referenceState.vuState, &state.vuState, sizeof(MIPSSTATE)) != 0))
+		{
+			printf("%s: VU registers or flags differ from generic path.\r\n", unpackCase.name);
+			succeeded = false;
+			continue;
+		}
+
+		double durations[2] = {};
+		for(unsigned int bulk = 0; bulk < 2; bulk++)
+		{
+			auto startTime = Clock::now();
+			for(uint32 i = 0; i < iterationCount; i++)
+			{
+				runPacket(bulk != 0);
+			}
+			auto endTime = Clock::now();
+			durations[bulk] = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+		}
+
+		double elementCount = static_cast<double>(iterationCount) * UNPACK_COUNT * 256;
+		printf("%-24s generic: %8.2fms (%6.2f ns/elem) bulk: %8.2fms (%6.2f ns/elem) speedup: %.2fx\r\n",
+		       unpackCase.name,
+		       durations[0], durations[0] * 1000000.0 / elementCount,
+		       durations[1], durations[1] * 1000000.0 / elementCount,
+		       durations[0] / durations[1]);
+	}
+
+	return succeeded ? 0 : -1;
+}
@@ -9,6 +9,7 @@
 #include "MinMaxTest.h"
 #include "StallTest.h"
 #include "StallTest2.h"
+#include "ThreadedVu1Test.h"
 #include "TriAceTest.h"
 
 typedef std::function<CTest*()> TestFactoryFunction;
@@ -23,6 +24,7 @@ static const TestFactoryFunction s_factories[] =
 	[]() { return new CMinMaxTest(); },
 	[]() { return new CStallTest(); },
 	[]() { return new CStallTest2(); },
+	[]() { return new CThreadedVu1Test(); },
 	[]() { return new CTriAceTest(); },
 };
 // clang-format on
@@ -0,0 +1,85 @@
+#include <vector>
+#include "ThreadedVu1Test.h"
+#include "VuAssembler.h"
+#include "Ps2Const.h"
+#include "ee/DMAC.h"
+#include "ee/GIF.h"
+#include "ee/INTC.h"
+#include "ee/Vpu.h"
+
+//Address (in quadwords) where the microprogram stores its result
+static const uint32 RESULT_ADDRESS = 0x10;
+//Number of stores done by the microprogram, keeps the VU thread busy for a little while
+static const uint32 STORE_COUNT = 0x100;
+
+void CThreadedVu1Test::Execute(CTestVm& virtualMachine)
+{
+	virtualMachine.Reset();
+
+	auto microMem = reinterpret_cast<uint32*>(virtualMachine.m_microMem);
+
+	CVuAssembler assembler(microMem);
+
+	for(uint32 i = 0; i < STORE_COUNT; i++)
+	{
+		assembler.Write(
+		    CVuAssembler::Upper::NOP(),
+		    CVuAssembler::Lower::SQ(CVuAssembler::DEST_XYZW, CVuAssembler::VF1, static_cast<uint16>(RESULT_ADDRESS + i), CVuAssembler::VI0));
+	}
+
+	assembler.Write(
+	    CVuAssembler::Upper::NOP() | CVuAssembler::Upper::E_BIT,
+	    CVuAssembler::Lower::NOP());
+
+	assembler.Write(
+	    CVuAssembler::Upper::NOP(),
+	    CVuAssembler::Lower::NOP());
+
+	//Both modes must leave VU memory in the same state once the EE has synchronized with VU1
+	RunMicroProgram(virtualMachine, false);
+	RunMicroProgram(virtualMachine, true);
+}
+
+void CThreadedVu1Test::RunMicroProgram(CTestVm& virtualMachine, bool threaded)
+{
+	std::vector<uint8> ram(PS2::EE_RAM_SIZE);
+	std::vector<uint8> spr(PS2::EE_SPR_SIZE);
+	std::vector<uint8> vuMem0(PS2::VUMEM0SIZE);
+	CGSHandler* gs = nullptr;
+
+	CDMAC dmac(ram.data(), spr.data(), vuMem0.data(), virtualMachine.m_cpu);
+	CINTC intc(dmac);
+	CGIF gif(gs, ram.data(), spr.data());
+
+	virtualMachine.m_cpu.m_executor = std::make_unique<CVuExecutor>(virtualMachine.m_cpu, PS2::MICROMEM1SIZE);
+	memset(virtualMachine.m_vuMem, 0, PS2::VUMEM1SIZE);
+
+	virtualMachine.m_cpu.m_State.nCOP2[1].nV0 = 0x11111111;
+	virtualMachine.m_cpu.m_State.nCOP2[1].nV1 = 0x22222222;
+	virtualMachine.m_cpu.m_State.nCOP2[1].nV2 = 0x33333333;
+	virtualMachine.m_cpu.m_State.nCOP2[1].nV3 = 0x44444444;
+
+	{
+		CVpu vpu(1, CVpu::VPUINIT(virtualMachine.m_microMem, virtualMachine.m_vuMem, &virtualMachine.m_cpu), gif, intc, ram.data(), spr.data());
+		vpu.SetThreaded(threaded);
+		TEST_VERIFY(vpu.IsThreaded() == threaded);
+
+		vpu.ExecuteMicroProgram(0);
+		vpu.Sync();
+		TEST_VERIFY(!vpu.IsVuRunning());
+
+		auto vuMem = reinterpret_cast<const uint32*>(virtualMachine.m_vuMem);
+		for(uint32 i = 0; i < STORE_COUNT; i++)
+		{
+			const uint32* result = vuMem + ((RESULT_ADDRESS + i) * 4);
+			TEST_VERIFY(result[0] == 0x11111111);
+			TEST_VERIFY(result[1] == 0x22222222);
+			TEST_VERIFY(result[2] == 0x33333333);
+			TEST_VERIFY(result[3] == 0x44444444);
+		}
+
+		vpu.SetThreaded(false);
+	}
+
+	virtualMachine.m_cpu.m_executor.reset();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Test.h"
+
+class CThreadedVu1Test : public CTest
+{
+public:
+	void Execute(CTestVm&) override;
+
+private:
+	void RunMicroProgram(CTestVm&, bool);
+};
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include "stricmp.h"
+#include "StdStream.h"
+#include "CsoImageStream.h"
+#include "IszImageStream.h"
+#ifdef HAS_ZSTD
+#include "ZsiImageWriter.h"
+#endif
+
+//Converts ISO, CSO and ISZ disc images to ZSI images
+
+typedef std::chrono::high_resolution_clock Clock;
+typedef std::unique_ptr<Framework::CStream> StreamPtr;
+
+#ifdef HAS_ZSTD
+
+static void PrintUsage()
+{
+	printf("Usage: ZsiConverter [options] inputPath outputPath\r\n");
+	printf("Options:\r\n");
+	printf("  -l level      zstd compression level (default: %d)\r\n", CZsiImageWriter::DEFAULT_COMPRESSION_LEVEL);
+	printf("  -f frameSize  Frame size in bytes, power of two (default: 0x%X)\r\n", CZsiImageWriter::DEFAULT_FRAME_SIZE);
+	printf("  -d [size]     Train a dictionary of that size (default: 0x%X)\r\n", CZsiImageWriter::DEFAULT_DICTIONARY_SIZE);
+	printf("  -j threads    Compression thread count (default: hardware thread count)\r\n");
+}
+
+static StreamPtr OpenImage(const std::string& imagePath)
+{
+	auto extension = imagePath.substr(std::min(imagePath.find_last_of('.'), imagePath.size()));
+	auto baseStream = new Framework::CStdStream(imagePath.c_str(), "rb");
+	if(!stricmp(extension.c_str(), ".cso"))
+	{
+		return std::make_unique<CCsoImageStream>(baseStream);
+	}
+	else if(!stricmp(extension.c_str(), ".isz"))
+	{
+		return std::make_unique<CIszImageStream>(baseStream);
+	}
+	return StreamPtr(baseStream);
+}
+
+#endif
+
+int main(int argc, const char** argv)
+{
+#ifdef HAS_ZSTD
+	CZsiImageWriter::OPTIONS options;
+	int argIndex = 1;
+	for(; argIndex < argc; argIndex++)
+	{
+		const char* arg = argv[argIndex];
+		bool hasValue = (argIndex + 1) < argc;
+		if(!strcmp(arg, "-l") && hasValue)
+		{
+			options.compressionLevel = atoi(argv[++argIndex]);
+		}
+		else if(!strcmp(arg, "-f") && hasValue)
+		{
+			options.frameSize = strtoul(argv[++argIndex], nullptr, 0);
+		}
+		else if(!strcmp(arg, "-d"))
+		{
+			options.dictionarySize = CZsiImageWriter::DEFAULT_DICTIONARY_SIZE;
+			if(hasValue && (argv[argIndex + 1][0] >= '0') && (argv[argIndex + 1][0] <= '9'))
+			{
+				options.dictionarySize = strtoul(argv[++argIndex], nullptr, 0);
+			}
+		}
+		else if(!strcmp(arg, "-j") && hasValue)
+		{
+			options.threadCount = atoi(argv[++argIndex]);
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if((argc - argIndex) != 2)
+	{
+		PrintUsage();
+		return -1;
+	}
+
+	const char* inputPath = argv[argIndex + 0];
+	const char* outputPath = argv[argIndex + 1];
+
+	try
+	{
+		auto input = OpenImage(inputPath);
+		Framework::CStdStream output(outputPath, "wb");
+
+		auto startTime = Clock::now();
+		CZsiImageWriter::Write(output, *input, options,
+		                       [](uint64 processed, uint64 total) {
+			                       printf("\r%3d%%", static_cast<int>((processed * 100) / std::max<uint64>(total, 1)));
+			                       fflush(stdout);
+		                       });
+		auto endTime = Clock::now();
+
+		uint64 inputSize = input->GetLength();
+		uint64 outputSize = output.Tell();
+		double seconds = std::chrono::duration<double>(endTime - startTime).count();
+		printf("\r%llu bytes -> %llu bytes (%.1f%%) in %.2fs, %.2f MB/s\r\n",
+		       static_cast<unsigned long long>(inputSize), static_cast<unsigned long long>(outputSize),
+		       (inputSize == 0) ? 0 : (static_cast<double>(outputSize) * 100.0) / static_cast<double>(inputSize),
+		       seconds, (static_cast<double>(inputSize) / (1024.0 * 1024.0)) / seconds);
+	}
+	catch(const std::exception& exception)
+	{
+		printf("Failed to convert image: %s\r\n", exception.what());
+		return -1;
+	}
+
+	return 0;
+#else
+	printf("ZSI support was disabled during build configuration.\r\n");
+	return -1;
+#endif
+}